@@ -1,4 +1,7 @@
+import 'dart:typed_data';
+
 import 'package:flutter/material.dart';
+import 'package:flutter/services.dart';
 
 void main() {
   runApp(const MyApp());
@@ -56,9 +59,28 @@ class MyHomePage extends StatefulWidget {
 
 int kMaxFlex = 12;
 
+// Announces the textures the runner shows platform views through when it is
+// started with --texture-views.
+const MethodChannel textureChannel = MethodChannel('runner/texture_views');
+
+// Tells the runner which rectangles of the window, in physical pixels, are
+// covered by widgets drawn over platform views, so it can clip the views'
+// windows around them.
+const MethodChannel overlayChannel = MethodChannel('runner/overlays');
+
+// Carries the parameters of the next platform view the app creates, which
+// the engine does not pass on to the runner. The reply is null, or why the
+// parameters were rejected.
+const BasicMessageChannel<Object?> creationParamsChannel =
+    BasicMessageChannel<Object?>(
+        'runner/platform_view_params', StandardMessageCodec());
+
 class _MyHomePageState extends State<MyHomePage> {
   int flex = 5;
-  late Widget view;
+  Widget view = const SizedBox.shrink();
+  int? textureId;
+  final GlobalKey _overlayKey = GlobalKey();
+  List<int> _reportedOverlays = const [];
   TextEditingController c1 = TextEditingController(text: 'lorem...');
   TextEditingController c2 = TextEditingController(text: 'ipsum...');
 
@@ -79,14 +101,62 @@ class _MyHomePageState extends State<MyHomePage> {
     });
   }
 
-  void _buildPlatformView() {
-    view = Win32View(viewType: "test");
+  Future<void> _buildPlatformView() async {
+    final Object? error = await creationParamsChannel.send(<String, Object?>{
+      'settings': <String, Object?>{
+        'contextMenusEnabled': false,
+        'zoomControlEnabled': false,
+      },
+      'scripts': <String>['window.runnerEmbedded = true;'],
+    });
+    if (error != null) {
+      debugPrint('Platform view parameters rejected: $error');
+    }
+    if (!mounted) return;
+    setState(() {
+      view = Win32View(viewType: "test");
+    });
+  }
+
+  // The texture is drawn over the platform view, whose own window stays
+  // hidden, so widgets stacked on top of the view can cover the page.
+  Future<void> _onTextureCall(MethodCall call) async {
+    final int texture = call.arguments['texture'] as int;
+    setState(() {
+      if (call.method == 'textureCreated') {
+        textureId = texture;
+      } else if (call.method == 'textureDestroyed' && textureId == texture) {
+        textureId = null;
+      }
+    });
+  }
+
+  // Reports the red box over the platform view after every frame in which
+  // it moved or resized. It is reported as its bounding rectangle, so the
+  // view is clipped under its rounded corners too.
+  void _reportOverlays(Duration timeStamp) {
+    if (!mounted) return;
+    final RenderObject? box = _overlayKey.currentContext?.findRenderObject();
+    if (box is! RenderBox || !box.hasSize) return;
+    final double ratio = View.of(context).devicePixelRatio;
+    final Rect rect = box.localToGlobal(Offset.zero) & box.size;
+    final List<int> overlays = [
+      (rect.left * ratio).floor(),
+      (rect.top * ratio).floor(),
+      (rect.right * ratio).ceil(),
+      (rect.bottom * ratio).ceil(),
+    ];
+    if (listEquals(overlays, _reportedOverlays)) return;
+    _reportedOverlays = overlays;
+    overlayChannel.invokeMethod('setOverlays', Int32List.fromList(overlays));
   }
 
   @override
   void initState() {
     super.initState();
     _buildPlatformView();
+    textureChannel.setMethodCallHandler(_onTextureCall);
+    WidgetsBinding.instance.addPersistentFrameCallback(_reportOverlays);
   }
 
   @override
@@ -137,7 +207,12 @@ class _MyHomePageState extends State<MyHomePage> {
                     children: [
                       Expanded(
                         flex: flex,
-                        child: view,
+                        child: textureId == null
+                            ? view
+                            : Stack(
+                                fit: StackFit.expand,
+                                children: [view, Texture(textureId: textureId!)],
+                              ),
                       ),
                       Expanded(
                         flex: kMaxFlex - flex,
@@ -147,6 +222,7 @@ class _MyHomePageState extends State<MyHomePage> {
                   ),
                 ),
                 Container(
+                  key: _overlayKey,
                   decoration: BoxDecoration(
                     border: Border.all(color: Colors.red),
                     borderRadius: const BorderRadius.all(Radius.circular(50)),
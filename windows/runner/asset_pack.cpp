@@ -0,0 +1,340 @@
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <numeric>
+
+#include "utf_transcoder.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'R', 'A', 'P', 'K'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kHashSize = 8;
+constexpr size_t kEntrySize = 32;
+constexpr size_t kDataAlignment = 16;
+
+// Field offsets within an entry.
+constexpr size_t kDataOffsetField = 0;
+constexpr size_t kDataSizeField = 8;
+constexpr size_t kPathOffsetField = 16;
+constexpr size_t kPathSizeField = 20;
+constexpr size_t kTypeOffsetField = 24;
+constexpr size_t kTypeSizeField = 28;
+
+// The archive is little-endian, like every platform the runner targets, so
+// fields are copied as they are. Copying also keeps unaligned reads legal.
+uint32_t Load32(const char* bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint64_t Load64(const char* bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+void Append32(std::string* out, uint32_t value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void Append64(std::string* out, uint64_t value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+size_t EntriesOffset(size_t count) {
+  return kHeaderSize + count * kHashSize;
+}
+
+// Returns whether [offset, offset + size) lies within |limit| bytes.
+bool InRange(uint64_t offset, uint64_t size, uint64_t limit) {
+  return offset <= limit && size <= limit - offset;
+}
+
+char ToLowerAscii(char16_t c) {
+  return static_cast<char>(c >= u'A' && c <= u'Z' ? c - u'A' + u'a' : c);
+}
+
+int HexValue(char16_t c) {
+  if (c >= u'0' && c <= u'9') {
+    return c - u'0';
+  }
+  if (c >= u'a' && c <= u'f') {
+    return c - u'a' + 10;
+  }
+  if (c >= u'A' && c <= u'F') {
+    return c - u'A' + 10;
+  }
+  return -1;
+}
+
+struct MimeType {
+  const char* extension;
+  const char* type;
+};
+
+constexpr MimeType kMimeTypes[] = {
+    {"html", "text/html"},
+    {"htm", "text/html"},
+    {"js", "text/javascript"},
+    {"mjs", "text/javascript"},
+    {"css", "text/css"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"wasm", "application/wasm"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"ico", "image/x-icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"txt", "text/plain"},
+    {"xml", "application/xml"},
+};
+
+}  // namespace
+
+uint64_t HashAssetPath(std::string_view path) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : path) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::string_view MimeTypeForPath(std::string_view path) {
+  size_t dot = path.rfind('.');
+  size_t slash = path.rfind('/');
+  if (dot != std::string_view::npos &&
+      (slash == std::string_view::npos || dot > slash)) {
+    std::string_view extension = path.substr(dot + 1);
+    for (const MimeType& mime : kMimeTypes) {
+      std::string_view known = mime.extension;
+      if (known.size() == extension.size() &&
+          std::equal(known.begin(), known.end(), extension.begin(),
+                     [](char a, char b) { return a == ToLowerAscii(b); })) {
+        return mime.type;
+      }
+    }
+  }
+  return "application/octet-stream";
+}
+
+bool AssetPathFromUrl(std::u16string_view url,
+                      std::string_view origin,
+                      std::string* path) {
+  if (url.size() < origin.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < origin.size(); ++i) {
+    if (url[i] >= 0x80 || ToLowerAscii(url[i]) != ToLowerAscii(origin[i])) {
+      return false;
+    }
+  }
+  std::u16string_view rest = url.substr(origin.size());
+  // Anything but a path here, like a port or a longer host name, is another
+  // origin.
+  if (!rest.empty() && rest[0] != u'/') {
+    return false;
+  }
+  rest = rest.substr(0, rest.find_first_of(u"?#"));
+  if (!rest.empty()) {
+    rest.remove_prefix(1);
+  }
+
+  path->clear();
+  for (size_t i = 0; i < rest.size(); ++i) {
+    char16_t c = rest[i];
+    if (c == u'%') {
+      int high = i + 2 < rest.size() ? HexValue(rest[i + 1]) : -1;
+      int low = high >= 0 ? HexValue(rest[i + 2]) : -1;
+      if (low < 0) {
+        return false;
+      }
+      path->push_back(static_cast<char>(high * 16 + low));
+      i += 2;
+    } else if (c < 0x80) {
+      path->push_back(static_cast<char>(c));
+    } else {
+      // Unescaped non-ASCII text is converted in one run.
+      size_t end = i;
+      while (end < rest.size() && rest[end] >= 0x80) {
+        ++end;
+      }
+      if (!AppendUtf16AsUtf8(rest.substr(i, end - i), path)) {
+        return false;
+      }
+      i = end - 1;
+    }
+  }
+  if (path->empty() || path->back() == '/') {
+    path->append("index.html");
+  }
+  return true;
+}
+
+bool AssetPackBuilder::Add(std::string_view path,
+                           std::string_view mime_type,
+                           std::string_view data) {
+  if (path.empty() || !paths_.emplace(path).second) {
+    return false;
+  }
+  assets_.push_back(PendingAsset{std::string(path), std::string(mime_type),
+                                 std::string(data)});
+  return true;
+}
+
+std::string AssetPackBuilder::Build() const {
+  const size_t count = assets_.size();
+  std::vector<uint64_t> hashes(count);
+  for (size_t i = 0; i < count; ++i) {
+    hashes[i] = HashAssetPath(assets_[i].path);
+  }
+  std::vector<size_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return hashes[a] != hashes[b] ? hashes[a] < hashes[b]
+                                  : assets_[a].path < assets_[b].path;
+  });
+
+  // Lay out the strings, sharing each MIME type, then the data.
+  std::string strings;
+  std::vector<uint32_t> path_offsets(count);
+  std::vector<uint32_t> type_offsets(count);
+  std::map<std::string_view, uint32_t> types;
+  size_t strings_offset = EntriesOffset(count) + count * kEntrySize;
+  for (size_t i : order) {
+    path_offsets[i] = static_cast<uint32_t>(strings_offset + strings.size());
+    strings.append(assets_[i].path);
+    auto [type, added] = types.try_emplace(
+        assets_[i].mime_type,
+        static_cast<uint32_t>(strings_offset + strings.size()));
+    if (added) {
+      strings.append(assets_[i].mime_type);
+    }
+    type_offsets[i] = type->second;
+  }
+  std::vector<uint64_t> data_offsets(count);
+  uint64_t data_end = strings_offset + strings.size();
+  for (size_t i : order) {
+    data_end = (data_end + kDataAlignment - 1) / kDataAlignment * kDataAlignment;
+    data_offsets[i] = data_end;
+    data_end += assets_[i].data.size();
+  }
+
+  std::string out;
+  out.reserve(static_cast<size_t>(data_end));
+  out.append(kMagic, sizeof(kMagic));
+  Append32(&out, kVersion);
+  Append32(&out, static_cast<uint32_t>(count));
+  Append32(&out, 0);
+  for (size_t i : order) {
+    Append64(&out, hashes[i]);
+  }
+  for (size_t i : order) {
+    Append64(&out, data_offsets[i]);
+    Append64(&out, assets_[i].data.size());
+    Append32(&out, path_offsets[i]);
+    Append32(&out, static_cast<uint32_t>(assets_[i].path.size()));
+    Append32(&out, type_offsets[i]);
+    Append32(&out, static_cast<uint32_t>(assets_[i].mime_type.size()));
+  }
+  out.append(strings);
+  for (size_t i : order) {
+    out.resize(static_cast<size_t>(data_offsets[i]), '\0');
+    out.append(assets_[i].data);
+  }
+  return out;
+}
+
+AssetPack::AssetPack(const char* bytes, size_t count)
+    : bytes_(bytes), count_(count) {}
+
+std::optional<AssetPack> AssetPack::Open(std::string_view bytes,
+                                         std::string* error) {
+  auto fail = [error](const char* message) -> std::optional<AssetPack> {
+    if (error != nullptr) {
+      *error = message;
+    }
+    return std::nullopt;
+  };
+  if (bytes.size() < kHeaderSize ||
+      std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) != 0) {
+    return fail("not an asset pack");
+  }
+  if (Load32(bytes.data() + 4) != kVersion) {
+    return fail("unsupported asset pack version");
+  }
+  size_t count = Load32(bytes.data() + 8);
+  if (count > (bytes.size() - kHeaderSize) / (kHashSize + kEntrySize)) {
+    return fail("asset index is truncated");
+  }
+
+  AssetPack pack(bytes.data(), count);
+  for (size_t i = 0; i < count; ++i) {
+    const char* entry = bytes.data() + EntriesOffset(count) + i * kEntrySize;
+    if (!InRange(Load64(entry + kDataOffsetField),
+                 Load64(entry + kDataSizeField), bytes.size()) ||
+        !InRange(Load32(entry + kPathOffsetField),
+                 Load32(entry + kPathSizeField), bytes.size()) ||
+        !InRange(Load32(entry + kTypeOffsetField),
+                 Load32(entry + kTypeSizeField), bytes.size())) {
+      return fail("asset entry points outside the pack");
+    }
+    if (i > 0 && pack.HashAt(i) < pack.HashAt(i - 1)) {
+      return fail("asset index is not sorted");
+    }
+    if (HashAssetPath(pack.PathAt(i)) != pack.HashAt(i)) {
+      return fail("asset path does not match its hash");
+    }
+  }
+  return pack;
+}
+
+std::optional<Asset> AssetPack::Find(std::string_view path) const {
+  uint64_t hash = HashAssetPath(path);
+  size_t low = 0;
+  size_t high = count_;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (HashAt(middle) < hash) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  for (; low < count_ && HashAt(low) == hash; ++low) {
+    if (PathAt(low) == path) {
+      return AssetAt(low);
+    }
+  }
+  return std::nullopt;
+}
+
+uint64_t AssetPack::HashAt(size_t index) const {
+  return Load64(bytes_ + kHeaderSize + index * kHashSize);
+}
+
+Asset AssetPack::AssetAt(size_t index) const {
+  const char* entry = bytes_ + EntriesOffset(count_) + index * kEntrySize;
+  return Asset{
+      std::string_view(bytes_ + Load64(entry + kDataOffsetField),
+                       static_cast<size_t>(Load64(entry + kDataSizeField))),
+      std::string_view(bytes_ + Load32(entry + kTypeOffsetField),
+                       Load32(entry + kTypeSizeField))};
+}
+
+std::string_view AssetPack::PathAt(size_t index) const {
+  const char* entry = bytes_ + EntriesOffset(count_) + index * kEntrySize;
+  return std::string_view(bytes_ + Load32(entry + kPathOffsetField),
+                          Load32(entry + kPathSizeField));
+}
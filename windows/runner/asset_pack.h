@@ -0,0 +1,107 @@
+#ifndef RUNNER_ASSET_PACK_H_
+#define RUNNER_ASSET_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A read-only archive of web assets, served to web views from a
+// memory-mapped file.
+//
+// The archive is one file, built ahead of time by |AssetPackBuilder|:
+//
+//   header    "RAPK", format version, asset count (16 bytes)
+//   hashes    the 64-bit FNV-1a hash of every asset path, sorted
+//   entries   per asset, in hash order: data offset and size, path offset
+//             and size, MIME type offset and size (32 bytes each)
+//   strings   the paths and the distinct MIME types
+//   data      the assets' bytes, each aligned to 16 bytes
+//
+// All integers are little-endian and all offsets are from the start of the
+// file. A lookup hashes the path, binary-searches the dense hash array and
+// compares paths only for matching hashes, so it touches a few cache lines
+// and never allocates. Assets are returned as views of the archive's bytes:
+// nothing is copied and nothing is read from disk per request.
+
+// Returns the hash assets are indexed by.
+uint64_t HashAssetPath(std::string_view path);
+
+// Returns the MIME type for |path|'s extension, or
+// "application/octet-stream" for unknown ones.
+std::string_view MimeTypeForPath(std::string_view path);
+
+// Extracts the asset path from |url| if it is on |origin|, e.g.
+// "https://appassets.local", and writes it to |path| percent-decoded and
+// without the leading slash, query or fragment. Directory URLs map to their
+// index.html. Returns false if |url| is on another origin or is malformed.
+// |path|'s storage is reused between calls.
+bool AssetPathFromUrl(std::u16string_view url,
+                      std::string_view origin,
+                      std::string* path);
+
+struct Asset {
+  std::string_view data;
+  std::string_view mime_type;
+};
+
+// Collects assets and lays them out in the archive format.
+class AssetPackBuilder {
+ public:
+  AssetPackBuilder() = default;
+
+  AssetPackBuilder(const AssetPackBuilder&) = delete;
+  AssetPackBuilder& operator=(const AssetPackBuilder&) = delete;
+
+  // Adds |data| as |path|, which is relative and uses '/' separators.
+  // Returns false if |path| is empty or was already added.
+  bool Add(std::string_view path,
+           std::string_view mime_type,
+           std::string_view data);
+
+  // Returns the archive.
+  std::string Build() const;
+
+  size_t size() const { return assets_.size(); }
+
+ private:
+  struct PendingAsset {
+    std::string path;
+    std::string mime_type;
+    std::string data;
+  };
+
+  std::vector<PendingAsset> assets_;
+  std::set<std::string, std::less<>> paths_;
+};
+
+// A view of an archive's bytes. The bytes must outlive it.
+class AssetPack {
+ public:
+  // Validates the archive in |bytes|, so that later lookups need no bounds
+  // checks. On failure returns nullopt and, if |error| is non-null, sets it
+  // to a description.
+  static std::optional<AssetPack> Open(std::string_view bytes,
+                                       std::string* error);
+
+  // Returns the asset at |path|, if there is one.
+  std::optional<Asset> Find(std::string_view path) const;
+
+  size_t size() const { return count_; }
+
+ private:
+  AssetPack(const char* bytes, size_t count);
+
+  uint64_t HashAt(size_t index) const;
+  Asset AssetAt(size_t index) const;
+  std::string_view PathAt(size_t index) const;
+
+  const char* bytes_;
+  size_t count_;
+};
+
+#endif  // RUNNER_ASSET_PACK_H_
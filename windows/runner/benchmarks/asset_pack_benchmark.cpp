@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "asset_pack.h"
+#include "benchmark.h"
+#include "mapped_file.h"
+
+namespace {
+
+constexpr size_t kAssetCount = 1000;
+constexpr size_t kChunkSize = 64 * 1024;
+constexpr char kOrigin[] = "https://appassets.local";
+
+std::string AssetPath(size_t index) {
+  static constexpr const char* kExtensions[] = {"html", "js", "css", "png",
+                                                "woff2"};
+  return "app/module" + std::to_string(index % 37) + "/asset" +
+         std::to_string(index) + "." + kExtensions[index % 5];
+}
+
+// |kAssetCount| assets of 1 to 64 KB, the size of a bundled web app.
+std::string BuildPack() {
+  std::mt19937 random(3);
+  AssetPackBuilder builder;
+  for (size_t i = 0; i < kAssetCount; ++i) {
+    std::string path = AssetPath(i);
+    std::string data(1024 + random() % (63 * 1024),
+                     static_cast<char>('a' + i % 26));
+    builder.Add(path, MimeTypeForPath(path), data);
+  }
+  return builder.Build();
+}
+
+std::vector<std::u16string> AssetUrls() {
+  std::vector<std::u16string> urls;
+  for (size_t i = 0; i < kAssetCount; ++i) {
+    std::string url = std::string(kOrigin) + "/" + AssetPath(i) + "?v=1";
+    urls.emplace_back(url.begin(), url.end());
+  }
+  std::shuffle(urls.begin(), urls.end(), std::mt19937(5));
+  return urls;
+}
+
+// Resolves |url| and streams the asset out in chunks the way the web view
+// reads a response stream. Returns the bytes served.
+size_t Serve(const AssetPack& pack,
+             std::u16string_view url,
+             std::string* path,
+             char* buffer) {
+  if (!AssetPathFromUrl(url, kOrigin, path)) {
+    return 0;
+  }
+  std::optional<Asset> asset = pack.Find(*path);
+  if (!asset) {
+    return 0;
+  }
+  for (size_t offset = 0; offset < asset->data.size(); offset += kChunkSize) {
+    size_t size = std::min(kChunkSize, asset->data.size() - offset);
+    std::copy_n(asset->data.data() + offset, size, buffer);
+    DoNotOptimize(buffer[0]);
+  }
+  return asset->data.size();
+}
+
+void ServeAll(BenchmarkState& state, const AssetPack& pack) {
+  std::vector<std::u16string> urls = AssetUrls();
+  std::vector<char> buffer(kChunkSize);
+  std::string path;
+  uint64_t total = 0;
+  for (const std::u16string& url : urls) {
+    total += Serve(pack, url, &path, buffer.data());
+  }
+  state.SetItemsPerIteration(urls.size());
+  state.SetBytesPerIteration(total);
+  while (state.KeepRunning()) {
+    for (const std::u16string& url : urls) {
+      DoNotOptimize(Serve(pack, url, &path, buffer.data()));
+    }
+  }
+}
+
+RUNNER_BENCHMARK(AssetPackOpen1K) {
+  std::string bytes = BuildPack();
+  state.SetItemsPerIteration(kAssetCount);
+  while (state.KeepRunning()) {
+    DoNotOptimize(AssetPack::Open(bytes, nullptr));
+  }
+}
+
+RUNNER_BENCHMARK(AssetPackFindHit1K) {
+  std::string bytes = BuildPack();
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, nullptr);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < kAssetCount; ++i) {
+    paths.push_back(AssetPath(i));
+  }
+  std::shuffle(paths.begin(), paths.end(), std::mt19937(5));
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    DoNotOptimize(pack->Find(paths[next]));
+    next = (next + 1) % paths.size();
+  }
+}
+
+RUNNER_BENCHMARK(AssetPackFindMiss1K) {
+  std::string bytes = BuildPack();
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, nullptr);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < kAssetCount; ++i) {
+    paths.push_back(AssetPath(i + kAssetCount));
+  }
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    DoNotOptimize(pack->Find(paths[next]));
+    next = (next + 1) % paths.size();
+  }
+}
+
+RUNNER_BENCHMARK(AssetUrlToPath) {
+  std::vector<std::u16string> urls = AssetUrls();
+  std::string path;
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    DoNotOptimize(AssetPathFromUrl(urls[next], kOrigin, &path));
+    next = (next + 1) % urls.size();
+  }
+}
+
+// Every asset once per iteration, from an in-memory pack.
+RUNNER_BENCHMARK(AssetPackServe1K) {
+  std::string bytes = BuildPack();
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, nullptr);
+  ServeAll(state, *pack);
+}
+
+// The same from a mapped file, as the runner serves it.
+RUNNER_BENCHMARK(AssetPackServeMapped1K) {
+  std::filesystem::path file =
+      std::filesystem::temp_directory_path() / "runner_benchmark_assets.pack";
+  {
+    std::string bytes = BuildPack();
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  }
+  std::unique_ptr<MappedFile> mapped = MappedFile::Open(file, nullptr);
+  if (mapped == nullptr) {
+    std::fprintf(stderr, "cannot map %s\n", file.string().c_str());
+    return;
+  }
+  std::optional<AssetPack> pack = AssetPack::Open(mapped->bytes(), nullptr);
+  ServeAll(state, *pack);
+  mapped.reset();
+  std::error_code error;
+  std::filesystem::remove(file, error);
+}
+
+}  // namespace
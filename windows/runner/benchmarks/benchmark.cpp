@@ -0,0 +1,376 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs the registered benchmarks.
+//
+//   runner_benchmarks [--filter=<text>] [--min-time-ms=<n>]
+//                     [--repetitions=<n>] [--json=<file>]
+//                     [--baseline=<file>] [--max-regression=<percent>]
+//                     [--list]
+//
+// --filter runs only benchmarks whose name contains <text>. --json writes
+// the results in the format below, which --baseline reads back: each
+// benchmark present in the baseline is compared by time per iteration, and
+// the exit code is 1 if any became slower by more than --max-regression
+// percent (10 by default).
+//
+//   {
+//     "min_time_ms": 200,
+//     "repetitions": 3,
+//     "benchmarks": [
+//       {"name": "...", "iterations": 1000, "ns_per_op": 12.5,
+//        "items_per_second": 8e7, "bytes_per_second": 0,
+//        "counters": {"p50_ns": 1200}},
+//       ...
+//     ]
+//   }
+
+namespace {
+
+struct Benchmark {
+  const char* name;
+  BenchmarkFunction function;
+  uint64_t max_iterations;
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations = 0;
+  double ns_per_op = 0;
+  double items_per_second = 0;
+  double bytes_per_second = 0;
+  std::vector<std::pair<std::string, double>> counters;
+};
+
+struct Options {
+  std::string filter;
+  std::chrono::milliseconds min_time{200};
+  int repetitions = 3;
+  std::string json_file;
+  std::string baseline_file;
+  double max_regression_percent = 10;
+  bool list = false;
+};
+
+// Function-local so registration from other translation units' static
+// initializers does not depend on initialization order.
+std::vector<Benchmark>& Registry() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+bool ParseFlag(std::string_view argument,
+               std::string_view flag,
+               std::string_view* value) {
+  if (argument.substr(0, flag.size()) != flag ||
+      argument.size() <= flag.size() || argument[flag.size()] != '=') {
+    return false;
+  }
+  *value = argument.substr(flag.size() + 1);
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view argument = argv[i];
+    std::string_view value;
+    if (argument == "--list") {
+      options->list = true;
+    } else if (ParseFlag(argument, "--filter", &value)) {
+      options->filter = std::string(value);
+    } else if (ParseFlag(argument, "--min-time-ms", &value)) {
+      options->min_time =
+          std::chrono::milliseconds(std::atol(std::string(value).c_str()));
+    } else if (ParseFlag(argument, "--repetitions", &value)) {
+      options->repetitions =
+          std::max(1, std::atoi(std::string(value).c_str()));
+    } else if (ParseFlag(argument, "--json", &value)) {
+      options->json_file = std::string(value);
+    } else if (ParseFlag(argument, "--baseline", &value)) {
+      options->baseline_file = std::string(value);
+    } else if (ParseFlag(argument, "--max-regression", &value)) {
+      options->max_regression_percent =
+          std::atof(std::string(value).c_str());
+    } else {
+      std::fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs |benchmark| for |iterations| and returns the state it left behind.
+Result RunOnce(const Benchmark& benchmark, uint64_t iterations) {
+  BenchmarkState state(iterations);
+  benchmark.function(state);
+  Result result;
+  result.name = benchmark.name;
+  result.iterations = state.iterations();
+  double seconds =
+      std::chrono::duration<double>(state.elapsed()).count();
+  result.ns_per_op = seconds * 1e9 / static_cast<double>(iterations);
+  if (seconds > 0) {
+    result.items_per_second = static_cast<double>(state.items_per_iteration()) *
+                              static_cast<double>(iterations) / seconds;
+    result.bytes_per_second = static_cast<double>(state.bytes_per_iteration()) *
+                              static_cast<double>(iterations) / seconds;
+  }
+  result.counters = state.counters();
+  return result;
+}
+
+// Grows the iteration count until a run takes |min_time| or reaches the
+// benchmark's cap, then repeats the run and keeps the fastest.
+Result Measure(const Benchmark& benchmark, const Options& options) {
+  double min_ns =
+      std::chrono::duration<double, std::nano>(options.min_time).count();
+  uint64_t max_iterations = benchmark.max_iterations != 0
+                                ? benchmark.max_iterations
+                                : uint64_t{1} << 40;
+  uint64_t iterations = 1;
+  Result result = RunOnce(benchmark, iterations);
+  while (result.ns_per_op * static_cast<double>(iterations) < min_ns &&
+         iterations < max_iterations) {
+    double total_ns = result.ns_per_op * static_cast<double>(iterations);
+    // Aim slightly past the minimum, and never grow by more than 100x at a
+    // time in case the first iterations were unusually slow.
+    double scale = total_ns > 0 ? min_ns * 1.2 / total_ns : 100.0;
+    scale = std::min(100.0, std::max(2.0, scale));
+    iterations = std::min(
+        max_iterations,
+        static_cast<uint64_t>(static_cast<double>(iterations) * scale));
+    result = RunOnce(benchmark, iterations);
+  }
+  for (int i = 1; i < options.repetitions; ++i) {
+    Result repeat = RunOnce(benchmark, iterations);
+    if (repeat.ns_per_op < result.ns_per_op) {
+      result = std::move(repeat);
+    }
+  }
+  return result;
+}
+
+// Formats |value| with an SI suffix, e.g. 1.25G.
+std::string Si(double value) {
+  static const char* const kSuffixes[] = {"", "k", "M", "G", "T"};
+  size_t suffix = 0;
+  while (value >= 1000 && suffix + 1 < std::size(kSuffixes)) {
+    value /= 1000;
+    ++suffix;
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3g%s", value, kSuffixes[suffix]);
+  return buffer;
+}
+
+void PrintResult(const Result& result) {
+  std::printf("%-44s %12.1f ns/op %12llu it", result.name.c_str(),
+              result.ns_per_op,
+              static_cast<unsigned long long>(result.iterations));
+  if (result.items_per_second > 0) {
+    std::printf("  %s items/s", Si(result.items_per_second).c_str());
+  }
+  if (result.bytes_per_second > 0) {
+    std::printf("  %sB/s", Si(result.bytes_per_second).c_str());
+  }
+  for (const auto& [name, value] : result.counters) {
+    std::printf("  %s=%s", name.c_str(), Si(value).c_str());
+  }
+  std::printf("\n");
+  std::fflush(stdout);
+}
+
+void AppendJsonString(std::string* json, std::string_view text) {
+  json->push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+    }
+    json->push_back(c);
+  }
+  json->push_back('"');
+}
+
+void AppendJsonNumber(std::string* json, double value) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+  json->append(buffer);
+}
+
+std::string ToJson(const std::vector<Result>& results,
+                   const Options& options) {
+  std::string json = "{\n  \"min_time_ms\": ";
+  json.append(std::to_string(options.min_time.count()));
+  json.append(",\n  \"repetitions\": ");
+  json.append(std::to_string(options.repetitions));
+  json.append(",\n  \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    json.append(i == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ");
+    AppendJsonString(&json, result.name);
+    json.append(", \"iterations\": ");
+    json.append(std::to_string(result.iterations));
+    json.append(", \"ns_per_op\": ");
+    AppendJsonNumber(&json, result.ns_per_op);
+    json.append(", \"items_per_second\": ");
+    AppendJsonNumber(&json, result.items_per_second);
+    json.append(", \"bytes_per_second\": ");
+    AppendJsonNumber(&json, result.bytes_per_second);
+    json.append(", \"counters\": {");
+    for (size_t c = 0; c < result.counters.size(); ++c) {
+      if (c > 0) {
+        json.append(", ");
+      }
+      AppendJsonString(&json, result.counters[c].first);
+      json.append(": ");
+      AppendJsonNumber(&json, result.counters[c].second);
+    }
+    json.append("}}");
+  }
+  json.append("\n  ]\n}\n");
+  return json;
+}
+
+bool ReadFile(const std::string& path, std::string* contents) {
+  FILE* file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  char buffer[4096];
+  size_t read;
+  while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents->append(buffer, read);
+  }
+  bool ok = !std::ferror(file);
+  std::fclose(file);
+  return ok;
+}
+
+bool WriteFile(const std::string& path, const std::string& contents) {
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool ok = std::fwrite(contents.data(), 1, contents.size(), file) ==
+            contents.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+// Reads the time per iteration of every benchmark from a file written with
+// --json. Only the "name" and "ns_per_op" members are looked at, so the
+// parser relies on the writer's layout rather than handling arbitrary JSON.
+bool ReadBaseline(const std::string& path,
+                  std::map<std::string, double>* baseline) {
+  std::string json;
+  if (!ReadFile(path, &json)) {
+    return false;
+  }
+  static constexpr std::string_view kName = "{\"name\": \"";
+  static constexpr std::string_view kNsPerOp = "\"ns_per_op\": ";
+  size_t pos = 0;
+  while ((pos = json.find(kName, pos)) != std::string::npos) {
+    pos += kName.size();
+    size_t name_end = json.find('"', pos);
+    size_t value = json.find(kNsPerOp, pos);
+    size_t next = json.find(kName, pos);
+    if (name_end == std::string::npos || value == std::string::npos ||
+        value > next) {
+      return false;
+    }
+    (*baseline)[json.substr(pos, name_end - pos)] =
+        std::strtod(json.c_str() + value + kNsPerOp.size(), nullptr);
+  }
+  return !baseline->empty();
+}
+
+// Prints how |results| compare to |baseline|. Returns the number of
+// regressions beyond |max_regression_percent|.
+int CompareToBaseline(const std::vector<Result>& results,
+                      const std::map<std::string, double>& baseline,
+                      double max_regression_percent) {
+  int regressions = 0;
+  std::printf("\n%-44s %12s %12s %8s\n", "Benchmark", "baseline ns",
+              "current ns", "change");
+  for (const Result& result : results) {
+    auto it = baseline.find(result.name);
+    if (it == baseline.end() || it->second <= 0) {
+      std::printf("%-44s %12s %12.1f %8s\n", result.name.c_str(), "-",
+                  result.ns_per_op, "new");
+      continue;
+    }
+    double change = (result.ns_per_op / it->second - 1) * 100;
+    bool regressed = change > max_regression_percent;
+    regressions += regressed ? 1 : 0;
+    std::printf("%-44s %12.1f %12.1f %+7.1f%%%s\n", result.name.c_str(),
+                it->second, result.ns_per_op, change,
+                regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+}  // namespace
+
+bool RegisterBenchmark(const char* name,
+                       BenchmarkFunction function,
+                       uint64_t max_iterations) {
+  Registry().push_back(Benchmark{name, function, max_iterations});
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    return 2;
+  }
+
+  std::vector<Benchmark> benchmarks = Registry();
+  std::sort(benchmarks.begin(), benchmarks.end(),
+            [](const Benchmark& a, const Benchmark& b) {
+              return std::strcmp(a.name, b.name) < 0;
+            });
+  if (options.list) {
+    for (const Benchmark& benchmark : benchmarks) {
+      std::printf("%s\n", benchmark.name);
+    }
+    return 0;
+  }
+
+  std::map<std::string, double> baseline;
+  if (!options.baseline_file.empty() &&
+      !ReadBaseline(options.baseline_file, &baseline)) {
+    std::fprintf(stderr, "Could not read baseline %s\n",
+                 options.baseline_file.c_str());
+    return 2;
+  }
+
+  std::vector<Result> results;
+  for (const Benchmark& benchmark : benchmarks) {
+    if (std::string_view(benchmark.name).find(options.filter) ==
+        std::string_view::npos) {
+      continue;
+    }
+    results.push_back(Measure(benchmark, options));
+    PrintResult(results.back());
+  }
+
+  if (!options.json_file.empty() &&
+      !WriteFile(options.json_file, ToJson(results, options))) {
+    std::fprintf(stderr, "Could not write %s\n", options.json_file.c_str());
+    return 2;
+  }
+  if (!baseline.empty() &&
+      CompareToBaseline(results, baseline, options.max_regression_percent) >
+          0) {
+    return 1;
+  }
+  return 0;
+}
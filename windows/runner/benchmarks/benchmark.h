@@ -0,0 +1,126 @@
+#ifndef RUNNER_BENCHMARKS_BENCHMARK_H_
+#define RUNNER_BENCHMARKS_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A minimal benchmark harness for the runner's platform-neutral components.
+//
+// A benchmark is a function that runs its measured loop while
+// |state.KeepRunning()| returns true:
+//
+//   RUNNER_BENCHMARK(SlotMapInsert) {
+//     SlotMap<int> map;
+//     while (state.KeepRunning()) {
+//       DoNotOptimize(map.Emplace(1));
+//     }
+//   }
+//
+// The harness picks the iteration count so that each run takes at least the
+// minimum time, repeats the run and reports the fastest. Setup before the
+// loop is not timed.
+
+class BenchmarkState {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit BenchmarkState(uint64_t iterations)
+      : iterations_(iterations), remaining_(iterations) {}
+
+  BenchmarkState(const BenchmarkState&) = delete;
+  BenchmarkState& operator=(const BenchmarkState&) = delete;
+
+  // Returns true while iterations remain. Starts the timer on the first
+  // call and stops it on the last.
+  bool KeepRunning() {
+    if (!started_) {
+      started_ = true;
+      ResumeTiming();
+    }
+    if (remaining_ == 0) {
+      PauseTiming();
+      return false;
+    }
+    --remaining_;
+    return true;
+  }
+
+  // Excludes the work between these calls from the measurement.
+  void PauseTiming() {
+    if (running_) {
+      elapsed_ += Clock::now() - start_;
+      running_ = false;
+    }
+  }
+  void ResumeTiming() {
+    if (!running_) {
+      start_ = Clock::now();
+      running_ = true;
+    }
+  }
+
+  // Units of work done per iteration, for throughput figures.
+  void SetItemsPerIteration(uint64_t items) { items_per_iteration_ = items; }
+  void SetBytesPerIteration(uint64_t bytes) { bytes_per_iteration_ = bytes; }
+
+  // Records an additional result, e.g. a latency percentile. Counters of
+  // the reported run are included in the output as they are.
+  void SetCounter(std::string name, double value) {
+    counters_.emplace_back(std::move(name), value);
+  }
+
+  uint64_t iterations() const { return iterations_; }
+  Clock::duration elapsed() const { return elapsed_; }
+  uint64_t items_per_iteration() const { return items_per_iteration_; }
+  uint64_t bytes_per_iteration() const { return bytes_per_iteration_; }
+  const std::vector<std::pair<std::string, double>>& counters() const {
+    return counters_;
+  }
+
+ private:
+  uint64_t iterations_;
+  uint64_t remaining_;
+  bool started_ = false;
+  bool running_ = false;
+  Clock::time_point start_;
+  Clock::duration elapsed_{0};
+  uint64_t items_per_iteration_ = 0;
+  uint64_t bytes_per_iteration_ = 0;
+  std::vector<std::pair<std::string, double>> counters_;
+};
+
+using BenchmarkFunction = void (*)(BenchmarkState& state);
+
+// Adds |function| to the benchmarks run by the harness's main. A non-zero
+// |max_iterations| caps a run, for benchmarks that fill a fixed-size
+// buffer. Returns true so it can initialize a static.
+bool RegisterBenchmark(const char* name,
+                       BenchmarkFunction function,
+                       uint64_t max_iterations = 0);
+
+// Keeps the compiler from discarding |value| or the work that produced it.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r"(&value) : "memory");
+#else
+  static const void* volatile sink;
+  sink = &value;
+#endif
+}
+
+// Defines and registers a benchmark. Use it at namespace scope, normally
+// inside an anonymous namespace.
+#define RUNNER_BENCHMARK(name) RUNNER_BENCHMARK_CAPPED(name, 0)
+
+// Like RUNNER_BENCHMARK, running at most |max_iterations| per run.
+#define RUNNER_BENCHMARK_CAPPED(name, max_iterations)               \
+  void RunnerBenchmark##name(BenchmarkState& state);                \
+  [[maybe_unused]] const bool runner_benchmark_##name =             \
+      RegisterBenchmark(#name, RunnerBenchmark##name, max_iterations); \
+  void RunnerBenchmark##name(BenchmarkState& state)
+
+#endif  // RUNNER_BENCHMARKS_BENCHMARK_H_
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "bounds_coalescer.h"
+
+namespace {
+
+// A window being drag-resized: 32 size changes arrive between frames, each
+// a few pixels larger, and one flush applies the last.
+RUNNER_BENCHMARK(BoundsCoalescerResizeStorm) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  int32_t width = 800;
+  state.SetItemsPerIteration(32);
+  while (state.KeepRunning()) {
+    for (int i = 0; i < 32; ++i) {
+      width = width >= 1600 ? 800 : width + 3;
+      coalescer.Submit(IntRect{0, 0, width, 600});
+    }
+    now += std::chrono::milliseconds(16);
+    DoNotOptimize(coalescer.Flush(now));
+  }
+  const BoundsCoalescerStats& stats = coalescer.stats();
+  state.SetCounter("applied_ratio",
+                   static_cast<double>(stats.applied) /
+                       static_cast<double>(stats.received));
+}
+
+// A synthetic trace of an animated layout: each 16 ms frame brings a
+// handful of WM_SIZEs, some repeating the current size, and the flex
+// animation settles for a while between runs. Applies are limited to one
+// per 32 ms.
+std::vector<IntRect> AnimatedLayoutTrace() {
+  std::mt19937 random(11);
+  std::vector<IntRect> trace;
+  int32_t width = 600;
+  for (int frame = 0; frame < 4096; ++frame) {
+    bool animating = frame % 120 < 40;
+    int messages = 1 + static_cast<int>(random() % 6);
+    for (int i = 0; i < messages; ++i) {
+      if (animating && random() % 2 == 0) {
+        width += static_cast<int32_t>(random() % 9) - 4;
+      }
+      trace.push_back(IntRect{0, 0, width, 400});
+    }
+    // Frame boundaries are marked with an empty rect.
+    trace.push_back(IntRect{});
+  }
+  return trace;
+}
+
+RUNNER_BENCHMARK(BoundsCoalescerAnimatedReplay) {
+  std::vector<IntRect> trace = AnimatedLayoutTrace();
+  BoundsCoalescer coalescer(std::chrono::milliseconds(32));
+  BoundsCoalescer::Clock::time_point now;
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    const IntRect& bounds = trace[next];
+    next = next + 1 == trace.size() ? 0 : next + 1;
+    if (bounds == IntRect{}) {
+      now += std::chrono::milliseconds(16);
+      DoNotOptimize(coalescer.Flush(now));
+    } else {
+      DoNotOptimize(coalescer.Submit(bounds));
+    }
+  }
+  const BoundsCoalescerStats& stats = coalescer.stats();
+  double received = static_cast<double>(stats.received);
+  state.SetCounter("applied_ratio",
+                   static_cast<double>(stats.applied) / received);
+  state.SetCounter("unchanged_ratio",
+                   static_cast<double>(stats.unchanged) / received);
+}
+
+}  // namespace
@@ -0,0 +1,30 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark.h"
+#include "command_line.h"
+
+namespace {
+
+// A typical command line from `flutter run`, plus a runner flag.
+RUNNER_BENCHMARK(ParseCommandLine) {
+  std::vector<std::u16string_view> arguments = {
+      u"--enable-dart-profiling",
+      u"--observatory-port=0",
+      u"--disable-service-auth-codes",
+      u"--trace-startup=C:\\Users\\dev\\AppData\\Local\\Temp\\trace.json",
+      u"--dart-entrypoint-args=--route=/settings",
+      u"--verbose-logging",
+      u"--cache-sksl",
+      u"--purge-persistent-cache",
+  };
+  state.SetItemsPerIteration(arguments.size());
+  while (state.KeepRunning()) {
+    RunnerFlags flags;
+    DoNotOptimize(ParseCommandLine(arguments, &flags));
+    DoNotOptimize(flags);
+  }
+}
+
+}  // namespace
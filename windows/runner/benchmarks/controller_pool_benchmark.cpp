@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+#include "benchmark.h"
+#include "controller_pool.h"
+
+namespace {
+
+// A controller handle that is empty when zero.
+struct FakeController {
+  uint64_t id = 0;
+
+  explicit operator bool() const { return id != 0; }
+};
+
+// Creates controllers after |latency| calls to |Pump|, standing in for the
+// asynchronous WebView2 environment. A latency of zero completes
+// synchronously.
+class FakeControllerSource : public ControllerSource<FakeController> {
+ public:
+  explicit FakeControllerSource(uint64_t latency) : latency_(latency) {}
+
+  // ControllerSource:
+  void CreateController(CreateCallback callback) override {
+    if (latency_ == 0) {
+      callback(FakeController{next_id_++});
+      return;
+    }
+    pending_.push_back(Pending{tick_ + latency_, std::move(callback)});
+  }
+  void DestroyController(FakeController controller) override {
+    DoNotOptimize(controller);
+  }
+
+  // Advances time by one step and completes creations that are due.
+  void Pump() {
+    ++tick_;
+    while (!pending_.empty() && pending_.front().ready_at <= tick_) {
+      CreateCallback callback = std::move(pending_.front().callback);
+      pending_.pop_front();
+      callback(FakeController{next_id_++});
+    }
+  }
+
+ private:
+  struct Pending {
+    uint64_t ready_at;
+    CreateCallback callback;
+  };
+
+  uint64_t latency_;
+  uint64_t tick_ = 0;
+  uint64_t next_id_ = 1;
+  std::deque<Pending> pending_;
+};
+
+// Views are created in bursts of |burst| and then destroyed again, each
+// claiming a surface and returning it to the pool, while creation takes
+// |latency| steps. Bursts larger than the idle capacity miss.
+void Churn(BenchmarkState& state, uint64_t latency, uint64_t burst) {
+  FakeControllerSource source(latency);
+  ControllerPool<FakeController>::Options options;
+  options.idle_capacity = 4;
+  options.warm_count = 1;
+  ControllerPool<FakeController> pool(&source, options);
+  pool.Prewarm();
+  std::deque<FakeController> attached;
+  uint64_t step = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    if (step++ / burst % 2 == 0) {
+      pool.Claim([&attached](FakeController controller) {
+        attached.push_back(controller);
+      });
+    } else if (!attached.empty()) {
+      pool.Return(attached.front());
+      attached.pop_front();
+    }
+    source.Pump();
+  }
+  const ControllerPoolStats& stats = pool.stats();
+  state.SetCounter("hit_ratio", static_cast<double>(stats.hits) /
+                                    static_cast<double>(stats.hits +
+                                                        stats.misses));
+}
+
+RUNNER_BENCHMARK(ControllerPoolChurnSync) {
+  Churn(state, 0, 8);
+}
+
+RUNNER_BENCHMARK(ControllerPoolChurnLatency4) {
+  Churn(state, 4, 8);
+}
+
+}  // namespace
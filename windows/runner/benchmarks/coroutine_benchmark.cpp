@@ -0,0 +1,289 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#include "benchmark.h"
+#include "coroutine.h"
+#include "portable_run_loop.h"
+
+// Counts heap allocations, so benchmarks can report allocations per
+// operation. Most of them are made by std::function and the scheduler, not
+// the frame pool, so counting takes replacing the allocation functions.
+// This file is built into runner_coroutine_benchmarks alone, which keeps
+// the increment out of the other benchmarks. Every form is replaced, so
+// that memory is always freed by the function matching the one that
+// allocated it, which sanitizers check.
+namespace {
+
+std::atomic<uint64_t> g_heap_allocations{0};
+
+void* Allocate(std::size_t size) noexcept {
+  g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void* AllocateAligned(std::size_t size, std::align_val_t alignment) noexcept {
+  g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  std::size_t align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a non-zero multiple of the alignment.
+  size = (size + align - 1) / align * align;
+#if defined(_MSC_VER)
+  return _aligned_malloc(size ? size : align, align);
+#else
+  return std::aligned_alloc(align, size ? size : align);
+#endif
+}
+
+void FreeAligned(void* block) noexcept {
+#if defined(_MSC_VER)
+  _aligned_free(block);
+#else
+  std::free(block);
+#endif
+}
+
+void* AllocateOrAbort(void* block) {
+  if (block == nullptr) {
+    std::abort();
+  }
+  return block;
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return AllocateOrAbort(Allocate(size));
+}
+void* operator new[](std::size_t size) {
+  return AllocateOrAbort(Allocate(size));
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return AllocateOrAbort(AllocateAligned(size, alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return AllocateOrAbort(AllocateAligned(size, alignment));
+}
+void* operator new(std::size_t size,
+                   std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  return AllocateAligned(size, alignment);
+}
+void* operator new[](std::size_t size,
+                     std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* block) noexcept {
+  std::free(block);
+}
+void operator delete[](void* block) noexcept {
+  std::free(block);
+}
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+  std::free(block);
+}
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+  std::free(block);
+}
+void operator delete(void* block, std::size_t) noexcept {
+  std::free(block);
+}
+void operator delete[](void* block, std::size_t) noexcept {
+  std::free(block);
+}
+void operator delete(void* block, std::align_val_t) noexcept {
+  FreeAligned(block);
+}
+void operator delete[](void* block, std::align_val_t) noexcept {
+  FreeAligned(block);
+}
+void operator delete(void* block,
+                     std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  FreeAligned(block);
+}
+void operator delete[](void* block,
+                       std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  FreeAligned(block);
+}
+void operator delete(void* block, std::size_t, std::align_val_t) noexcept {
+  FreeAligned(block);
+}
+void operator delete[](void* block, std::size_t, std::align_val_t) noexcept {
+  FreeAligned(block);
+}
+
+namespace {
+
+// Reports the heap allocations made by the measured loop, per iteration.
+class AllocationCounter {
+ public:
+  explicit AllocationCounter(BenchmarkState& state)
+      : state_(state),
+        start_(g_heap_allocations.load(std::memory_order_relaxed)) {}
+
+  ~AllocationCounter() {
+    uint64_t allocations =
+        g_heap_allocations.load(std::memory_order_relaxed) - start_;
+    state_.SetCounter("allocs_per_op",
+                      static_cast<double>(allocations) /
+                          static_cast<double>(state_.iterations()));
+  }
+
+ private:
+  BenchmarkState& state_;
+  uint64_t start_;
+};
+
+// A fake asynchronous operation: completions are queued and delivered when
+// the source is drained, the way WebView2 completions arrive from the run
+// loop. The queue keeps its capacity, so it does not allocate once warm.
+class FakeAsyncSource {
+ public:
+  using Callback = std::function<void(int result)>;
+
+  // Completes with |input| + 1.
+  void Start(int input, Callback callback) {
+    pending_.push_back({input, std::move(callback)});
+  }
+
+  void Drain() {
+    while (!pending_.empty()) {
+      Operation operation = std::move(pending_.back());
+      pending_.pop_back();
+      operation.callback(operation.input + 1);
+    }
+  }
+
+ private:
+  struct Operation {
+    int input;
+    Callback callback;
+  };
+
+  std::vector<Operation> pending_;
+};
+
+// Three dependent operations, the shape of creating a controller, running
+// a script and suspending, written as nested callbacks.
+void CallbackSequence(FakeAsyncSource* source,
+                      std::function<void(int)> done) {
+  source->Start(0, [source, done = std::move(done)](int first) {
+    source->Start(first, [source, done, first](int second) {
+      source->Start(second, [done, first, second](int third) {
+        done(first + second + third);
+      });
+    });
+  });
+}
+
+// The same sequence as a coroutine.
+Task<int> Step(FakeAsyncSource* source, int input) {
+  std::optional<int> result =
+      co_await Async<int>([source, input](Resolver<int> resolve) {
+        source->Start(input, [resolve](int value) { resolve(value); });
+      });
+  co_return result.value_or(-1);
+}
+
+Task<> CoroutineSequence(FakeAsyncSource* source, int* out) {
+  int first = co_await Step(source, 0);
+  int second = co_await Step(source, first);
+  int third = co_await Step(source, second);
+  *out = first + second + third;
+}
+
+RUNNER_BENCHMARK(AsyncSequenceCallbacks) {
+  FakeAsyncSource source;
+  int sum = 0;
+  std::function<void(int)> done = [&sum](int result) { sum += result; };
+  AllocationCounter allocations(state);
+  while (state.KeepRunning()) {
+    CallbackSequence(&source, done);
+    source.Drain();
+  }
+  DoNotOptimize(sum);
+}
+
+RUNNER_BENCHMARK(AsyncSequenceCoroutine) {
+  FakeAsyncSource source;
+  int sum = 0;
+  AllocationCounter allocations(state);
+  while (state.KeepRunning()) {
+    int result = 0;
+    Spawn(CoroutineSequence(&source, &result), TaskContext());
+    source.Drain();
+    sum += result;
+  }
+  DoNotOptimize(sum);
+}
+
+// A task yielding to the run loop, the cost of hopping back onto the
+// scheduler between steps.
+Task<> YieldTimes(int count, int* done) {
+  for (int i = 0; i < count; ++i) {
+    co_await Yield();
+  }
+  ++*done;
+}
+
+RUNNER_BENCHMARK(CoroutineYield) {
+  PortableRunLoop loop;
+  TaskContext context{&loop.scheduler(), CancellationToken()};
+  int done = 0;
+  state.SetItemsPerIteration(16);
+  AllocationCounter allocations(state);
+  while (state.KeepRunning()) {
+    Spawn(YieldTimes(16, &done), context);
+    loop.RunUntilIdle();
+  }
+  DoNotOptimize(done);
+}
+
+// Cancelling 64 tasks blocked on operations that never complete.
+Task<> AwaitForever(std::vector<Resolver<int>>* pending, int* cancelled) {
+  std::optional<int> result =
+      co_await Async<int>([pending](Resolver<int> resolve) {
+        pending->push_back(std::move(resolve));
+      });
+  if (!result) {
+    ++*cancelled;
+  }
+}
+
+RUNNER_BENCHMARK(CoroutineCancel64) {
+  std::vector<Resolver<int>> pending;
+  pending.reserve(64);
+  int cancelled = 0;
+  state.SetItemsPerIteration(64);
+  AllocationCounter allocations(state);
+  while (state.KeepRunning()) {
+    CancellationSource source;
+    for (int i = 0; i < 64; ++i) {
+      Spawn(AwaitForever(&pending, &cancelled),
+            TaskContext{nullptr, source.token()});
+    }
+    source.Cancel();
+    pending.clear();
+  }
+  DoNotOptimize(cancelled);
+}
+
+}  // namespace
@@ -0,0 +1,97 @@
+#include <random>
+
+#include "benchmark.h"
+#include "focus_graph.h"
+#include "task_scheduler.h"
+
+namespace {
+
+constexpr FocusNodeId kNodeCount = 1000;
+
+// Lays out |kNodeCount| nodes in a grid of 40 columns.
+IntRect GridBounds(FocusNodeId node, int32_t scroll) {
+  int32_t column = static_cast<int32_t>(node % 40);
+  int32_t row = static_cast<int32_t>(node / 40);
+  int32_t top = row * 30 - scroll;
+  return IntRect{column * 50, top, column * 50 + 48, top + 28};
+}
+
+void AddGrid(FocusGraph* graph) {
+  for (FocusNodeId node = 1; node <= kNodeCount; ++node) {
+    graph->AddNode(node, GridBounds(node, 0));
+  }
+}
+
+// Tabbing through every focusable node and wrapping around.
+RUNNER_BENCHMARK(FocusGraphNext1K) {
+  TaskScheduler scheduler([] {});
+  FocusGraph graph(&scheduler, nullptr);
+  AddGrid(&graph);
+  FocusNodeId node = kNoFocusNode;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    node = graph.Next(node);
+    DoNotOptimize(node);
+  }
+}
+
+RUNNER_BENCHMARK(FocusGraphPrevious1K) {
+  TaskScheduler scheduler([] {});
+  FocusGraph graph(&scheduler, nullptr);
+  AddGrid(&graph);
+  FocusNodeId node = kNoFocusNode;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    node = graph.Previous(node);
+    DoNotOptimize(node);
+  }
+}
+
+// Views moving as the page scrolls, each re-sorted on its own.
+RUNNER_BENCHMARK(FocusGraphMove1K) {
+  TaskScheduler scheduler([] {});
+  FocusGraph graph(&scheduler, nullptr);
+  AddGrid(&graph);
+  std::mt19937 random(5);
+  int32_t scroll = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    FocusNodeId node = 1 + random() % kNodeCount;
+    scroll = (scroll + 3) % 600;
+    graph.MoveNode(node, GridBounds(node, scroll));
+  }
+}
+
+// A view destroyed and recreated at another position.
+RUNNER_BENCHMARK(FocusGraphRemoveAdd1K) {
+  TaskScheduler scheduler([] {});
+  FocusGraph graph(&scheduler, nullptr);
+  AddGrid(&graph);
+  std::mt19937 random(9);
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    FocusNodeId node = 1 + random() % kNodeCount;
+    graph.RemoveNode(node);
+    graph.AddNode(node, GridBounds(1 + random() % kNodeCount, 0));
+  }
+}
+
+// Focus moving between views, reported once per loop pass.
+RUNNER_BENCHMARK(FocusGraphSetFocusAndReport) {
+  TaskScheduler scheduler([] {});
+  uint64_t reports = 0;
+  FocusGraph graph(&scheduler, [&reports](FocusNodeId, FocusNodeId) {
+    ++reports;
+  });
+  AddGrid(&graph);
+  FocusNodeId node = kNoFocusNode;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    node = graph.Next(node);
+    graph.SetFocus(node);
+    scheduler.RunUntil(TaskScheduler::Clock::now());
+  }
+  DoNotOptimize(reports);
+}
+
+}  // namespace
@@ -0,0 +1,53 @@
+#include <chrono>
+
+#include "benchmark.h"
+#include "geometry_transaction.h"
+
+namespace {
+
+constexpr GeometryViewId kViewCount = 64;
+
+// One frame of a scrolling layout: every view moves, a few are shown or
+// hidden, and the frame's changes are committed together.
+RUNNER_BENCHMARK(GeometryTransactionFrame64) {
+  GeometryTransaction transaction;
+  GeometryTransaction::Clock::time_point now;
+  int32_t scroll = 0;
+  state.SetItemsPerIteration(kViewCount);
+  while (state.KeepRunning()) {
+    scroll = (scroll + 7) % 4000;
+    for (GeometryViewId view = 1; view <= kViewCount; ++view) {
+      int32_t top = static_cast<int32_t>(view) * 120 - scroll;
+      transaction.SetBounds(view, IntRect{0, top, 800, top + 100}, now);
+      if ((view + static_cast<GeometryViewId>(scroll)) % 16 == 0) {
+        transaction.SetVisible(view, top > -100 && top < 1200, now);
+      }
+    }
+    now += std::chrono::milliseconds(16);
+    transaction.OnFramePresented();
+    DoNotOptimize(transaction.Commit(now, true));
+  }
+}
+
+// The engine laying out several times before a frame is presented; later
+// changes merge into the pending ones.
+RUNNER_BENCHMARK(GeometryTransactionMerge) {
+  GeometryTransaction transaction;
+  GeometryTransaction::Clock::time_point now;
+  int32_t offset = 0;
+  state.SetItemsPerIteration(4 * kViewCount);
+  while (state.KeepRunning()) {
+    for (int pass = 0; pass < 4; ++pass) {
+      ++offset;
+      for (GeometryViewId view = 1; view <= kViewCount; ++view) {
+        transaction.SetBounds(view, IntRect{offset, 0, offset + 100, 100},
+                              now);
+      }
+    }
+    now += std::chrono::milliseconds(16);
+    transaction.OnFramePresented();
+    DoNotOptimize(transaction.Commit(now, true));
+  }
+}
+
+}  // namespace
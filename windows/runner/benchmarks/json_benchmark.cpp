@@ -0,0 +1,156 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "json.h"
+
+namespace {
+
+// RPC requests as runnerRpc.call() posts them, of a few common shapes.
+std::vector<std::string> SmallRequests() {
+  std::vector<std::string> requests;
+  for (int id = 1; id <= 64; ++id) {
+    std::string id_text = std::to_string(id);
+    switch (id % 4) {
+      case 0:
+        requests.push_back("{\"id\":" + id_text +
+                           ",\"method\":\"ping\",\"params\":[]}");
+        break;
+      case 1:
+        requests.push_back("{\"id\":" + id_text +
+                           ",\"method\":\"echo\",\"params\":[\"message " +
+                           id_text + "\"]}");
+        break;
+      case 2:
+        requests.push_back("{\"id\":" + id_text +
+                           ",\"method\":\"view.setBounds\",\"params\":[" +
+                           id_text + ",12.5,-3,1280,720]}");
+        break;
+      default:
+        requests.push_back("{\"id\":\"call-" + id_text +
+                           "\",\"method\":\"settings.update\",\"params\":"
+                           "[{\"theme\":\"dark\",\"zoom\":1.25,"
+                           "\"notifications\":true,\"tags\":null}]}");
+        break;
+    }
+  }
+  return requests;
+}
+
+// A page reporting structured state: records with nested objects, arrays
+// and a mix of numbers, about |length| bytes.
+std::string NestedPayload(size_t length) {
+  std::string json = "{\"id\":1,\"method\":\"state.report\",\"params\":[[";
+  for (int record = 0; json.size() < length; ++record) {
+    if (record > 0) {
+      json.push_back(',');
+    }
+    std::string index = std::to_string(record);
+    json += "{\"id\":" + index + ",\"name\":\"item-" + index +
+            "\",\"visible\":" + (record % 3 ? "true" : "false") +
+            ",\"bounds\":{\"x\":" + index + ".5,\"y\":-" + index +
+            ",\"width\":320,\"height\":240.25},\"children\":[" + index +
+            ",1e3,-0.001,{\"depth\":[[[" + index + "]]]}],\"parent\":null}";
+  }
+  json += "]]}";
+  return json;
+}
+
+// Long text as a page might send it: mostly plain strings, a few with
+// escapes, some beyond ASCII.
+std::string StringPayload(size_t length) {
+  std::string json = "{\"id\":2,\"method\":\"log.append\",\"params\":[[";
+  for (int line = 0; json.size() < length; ++line) {
+    if (line > 0) {
+      json.push_back(',');
+    }
+    json += "\"[info] Loaded https://example.com/assets/bundle-" +
+            std::to_string(line) +
+            ".js in 12ms; cache hit ratio 0.97, renderer pid 4242\"";
+    if (line % 8 == 0) {
+      json += ",\"Grüße aus Köln \\u00e9\\t\\\"quoted\\\"\\n"
+              "\\ud83d\\ude00\"";
+    }
+  }
+  json += "]]}";
+  return json;
+}
+
+void ParseCorpus(BenchmarkState& state,
+                 const std::vector<std::string>& corpus) {
+  JsonDocument document;
+  size_t bytes = 0;
+  for (const std::string& json : corpus) {
+    bytes += json.size();
+  }
+  state.SetBytesPerIteration(bytes);
+  state.SetItemsPerIteration(corpus.size());
+  while (state.KeepRunning()) {
+    for (const std::string& json : corpus) {
+      DoNotOptimize(document.Parse(json, nullptr));
+    }
+  }
+}
+
+RUNNER_BENCHMARK(JsonParseSmallRequests) {
+  ParseCorpus(state, SmallRequests());
+}
+
+RUNNER_BENCHMARK(JsonParseNested64K) {
+  ParseCorpus(state, {NestedPayload(64 * 1024)});
+}
+
+RUNNER_BENCHMARK(JsonParseStrings64K) {
+  ParseCorpus(state, {StringPayload(64 * 1024)});
+}
+
+// Parsing and then reading every member, as a handler converting params
+// does.
+RUNNER_BENCHMARK(JsonParseAndWalkNested64K) {
+  std::string json = NestedPayload(64 * 1024);
+  JsonDocument document;
+  state.SetBytesPerIteration(json.size());
+  while (state.KeepRunning()) {
+    document.Parse(json, nullptr);
+    double sum = 0;
+    JsonValue records = document.root().Find("params").At(0);
+    records.ForEachElement([&sum](JsonValue record) {
+      sum += record.Find("bounds").Find("x").GetNumber();
+      sum += static_cast<double>(record.Find("name").GetString().size());
+    });
+    DoNotOptimize(sum);
+  }
+}
+
+// A reply listing 100 records, about 8KB.
+RUNNER_BENCHMARK(JsonWriteReply100) {
+  std::string output;
+  while (state.KeepRunning()) {
+    output.clear();
+    JsonWriter writer(&output);
+    writer.BeginObject();
+    writer.Key("id");
+    writer.Int(7);
+    writer.Key("result");
+    writer.BeginArray();
+    for (int record = 0; record < 100; ++record) {
+      writer.BeginObject();
+      writer.Key("id");
+      writer.Int(record);
+      writer.Key("title");
+      writer.String("Platform view – Köln");
+      writer.Key("scale");
+      writer.Double(1.25 * record);
+      writer.Key("visible");
+      writer.Bool(record % 2 == 0);
+      writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    DoNotOptimize(output.data());
+  }
+  state.SetBytesPerIteration(output.size());
+}
+
+}  // namespace
@@ -0,0 +1,111 @@
+#include <cstdio>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#include "benchmark.h"
+#include "logging.h"
+
+namespace {
+
+// Discards everything written to it, so the std::ostream baseline pays
+// for formatting but not for I/O.
+class NullBuffer : public std::streambuf {
+ protected:
+  int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+  std::streamsize xsputn(const char*, std::streamsize count) override {
+    return count;
+  }
+};
+
+// Hands every write straight to a stdio stream, as libstdc++ and the MSVC
+// runtime do for std::cerr while it is synchronized with stdio.
+class StdioBuffer : public std::streambuf {
+ public:
+  explicit StdioBuffer(FILE* file) : file_(file) {}
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    return std::fputc(c, file_) == EOF ? traits_type::eof() : c;
+  }
+  std::streamsize xsputn(const char* data, std::streamsize count) override {
+    return static_cast<std::streamsize>(
+        std::fwrite(data, 1, static_cast<size_t>(count), file_));
+  }
+  int sync() override { return std::fflush(file_) == 0 ? 0 : -1; }
+
+ private:
+  FILE* file_;
+};
+
+// The cost of a log call on the calling thread. The ring is drained to a
+// temporary file, untimed, before it can fill up, so every call takes the
+// recording path rather than the drop path.
+RUNNER_BENCHMARK(LogInfoCall) {
+  FILE* sink = std::tmpfile();
+  SetLogStream(sink);
+  uint64_t dropped = DroppedLogRecordCount();
+  std::string url = "https://example.com/index.html";
+  int64_t i = 0;
+  while (state.KeepRunning()) {
+    RUNNER_LOG_INFO("Navigating view {} to {} ({} bytes)", ++i, url,
+                    url.size());
+    if (i % 256 == 0) {
+      state.PauseTiming();
+      FlushLogs();
+      state.ResumeTiming();
+    }
+  }
+  FlushLogs();
+  SetLogStream(nullptr);
+  if (sink != nullptr) {
+    std::fclose(sink);
+  }
+  state.SetCounter("dropped_ratio",
+                   static_cast<double>(DroppedLogRecordCount() - dropped) /
+                       static_cast<double>(state.iterations()));
+}
+
+// The same message formatted synchronously through a std::ostream, as the
+// runner did with std::cerr.
+RUNNER_BENCHMARK(LogOstreamCall) {
+  NullBuffer buffer;
+  std::ostream stream(&buffer);
+  std::string url = "https://example.com/index.html";
+  int64_t i = 0;
+  while (state.KeepRunning()) {
+    stream << "Navigating view " << ++i << " to " << url << " ("
+           << url.size() << " bytes)" << std::endl;
+  }
+}
+
+// The same message written the way std::cerr writes it: the stream is
+// unit-buffered and stderr is unbuffered, so every insertion reaches the
+// file. A temporary file stands in for the console.
+RUNNER_BENCHMARK(LogCerrCall) {
+  FILE* sink = std::tmpfile();
+  if (sink == nullptr) {
+    return;
+  }
+  std::setvbuf(sink, nullptr, _IONBF, 0);
+  StdioBuffer buffer(sink);
+  std::ostream stream(&buffer);
+  stream.setf(std::ios::unitbuf);
+  std::string url = "https://example.com/index.html";
+  int64_t i = 0;
+  while (state.KeepRunning()) {
+    stream << "Navigating view " << ++i << " to " << url << " ("
+           << url.size() << " bytes)" << std::endl;
+    if (i % 4096 == 0) {
+      state.PauseTiming();
+      std::rewind(sink);
+      state.ResumeTiming();
+    }
+  }
+  std::fclose(sink);
+}
+
+}  // namespace
@@ -0,0 +1,123 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "metrics.h"
+
+namespace {
+
+// Runs |update| on |threads| - 1 background threads for as long as the
+// measured loop runs |update| on this one, so the loop's time per
+// iteration is the cost of one update under contention.
+template <typename Update>
+void Contended(BenchmarkState& state, size_t threads, Update update) {
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> started{0};
+  std::vector<std::thread> others;
+  for (size_t i = 1; i < threads; ++i) {
+    others.emplace_back([&] {
+      started.fetch_add(1);
+      uint64_t value = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        update(++value);
+      }
+    });
+  }
+  while (started.load() + 1 < threads) {
+    std::this_thread::yield();
+  }
+  uint64_t value = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    update(++value);
+  }
+  stop.store(true);
+  for (std::thread& thread : others) {
+    thread.join();
+  }
+}
+
+// A single atomic shared by every thread: the baseline sharding avoids.
+void SharedAtomic(BenchmarkState& state, size_t threads) {
+  std::atomic<uint64_t> counter{0};
+  Contended(state, threads, [&counter](uint64_t) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  });
+  DoNotOptimize(counter.load());
+}
+
+void ShardedCounter(BenchmarkState& state, size_t threads) {
+  Counter counter;
+  Contended(state, threads, [&counter](uint64_t) { counter.Increment(); });
+  DoNotOptimize(counter.Value());
+}
+
+// Latencies of up to about 4ms in microseconds, spread over ~100 buckets.
+void HistogramRecord(BenchmarkState& state, size_t threads) {
+  Histogram histogram;
+  Contended(state, threads, [&histogram](uint64_t value) {
+    histogram.Record((value * 2654435761u) % 4096);
+  });
+  DoNotOptimize(histogram.Snapshot().count);
+}
+
+RUNNER_BENCHMARK(MetricsAtomicShared1Thread) {
+  SharedAtomic(state, 1);
+}
+
+RUNNER_BENCHMARK(MetricsAtomicShared4Threads) {
+  SharedAtomic(state, 4);
+}
+
+RUNNER_BENCHMARK(MetricsCounter1Thread) {
+  ShardedCounter(state, 1);
+}
+
+RUNNER_BENCHMARK(MetricsCounter4Threads) {
+  ShardedCounter(state, 4);
+}
+
+RUNNER_BENCHMARK(MetricsCounter8Threads) {
+  ShardedCounter(state, 8);
+}
+
+RUNNER_BENCHMARK(MetricsGaugeSet) {
+  Gauge gauge;
+  int64_t value = 0;
+  while (state.KeepRunning()) {
+    gauge.Set(++value);
+  }
+  DoNotOptimize(gauge.Value());
+}
+
+RUNNER_BENCHMARK(MetricsHistogram1Thread) {
+  HistogramRecord(state, 1);
+}
+
+RUNNER_BENCHMARK(MetricsHistogram4Threads) {
+  HistogramRecord(state, 4);
+}
+
+// A snapshot of a registry the size of the runner's, as written
+// periodically with --metrics.
+RUNNER_BENCHMARK(MetricsToJson) {
+  MetricsRegistry registry;
+  for (int i = 0; i < 16; ++i) {
+    registry.GetCounter("counter." + std::to_string(i))->Increment(i);
+  }
+  for (int i = 0; i < 4; ++i) {
+    registry.GetGauge("gauge." + std::to_string(i))->Set(i);
+    Histogram* histogram =
+        registry.GetHistogram("histogram." + std::to_string(i));
+    for (uint64_t value = 1; value < 100000; value = value * 3 / 2 + 1) {
+      histogram->Record(value);
+    }
+  }
+  while (state.KeepRunning()) {
+    DoNotOptimize(registry.ToJson());
+  }
+}
+
+}  // namespace
@@ -0,0 +1,97 @@
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "navigation_policy.h"
+
+namespace {
+
+constexpr size_t kRuleCount = 10000;
+constexpr size_t kUrlCount = 4096;
+
+// |kRuleCount| rules over distinct domains, mixing subdomain, exact host,
+// port and path rules the way a large allow list does.
+std::string LargePolicy() {
+  std::string config = "# Generated\n";
+  for (size_t i = 0; i < kRuleCount; ++i) {
+    std::string domain = "site" + std::to_string(i) + ".example.com";
+    switch (i % 4) {
+      case 0:
+        config += "allow https://*." + domain + "\n";
+        break;
+      case 1:
+        config += "deny *://" + domain + "/ads/\n";
+        break;
+      case 2:
+        config += "allow http://" + domain + ":8080/app/\n";
+        break;
+      case 3:
+        config += "allow " + domain + "\n";
+        break;
+    }
+  }
+  config += "default deny\n";
+  return config;
+}
+
+// URLs that hit rules, miss every host, or fail on scheme, port or path.
+std::vector<std::u16string> Urls() {
+  std::mt19937 random(7);
+  std::vector<std::u16string> urls;
+  for (size_t i = 0; i < kUrlCount; ++i) {
+    std::string site = std::to_string(random() % (kRuleCount * 2));
+    std::string url;
+    switch (random() % 4) {
+      case 0:
+        url = "https://www.site" + site + ".example.com/index.html";
+        break;
+      case 1:
+        url = "http://site" + site + ".example.com/ads/banner.png";
+        break;
+      case 2:
+        url = "http://site" + site + ".example.com:8080/app/main.js";
+        break;
+      case 3:
+        url = "https://cdn.unrelated" + site + ".net/lib.js";
+        break;
+    }
+    urls.emplace_back(url.begin(), url.end());
+  }
+  return urls;
+}
+
+RUNNER_BENCHMARK(NavigationPolicyCompile10K) {
+  std::string config = LargePolicy();
+  state.SetItemsPerIteration(kRuleCount);
+  while (state.KeepRunning()) {
+    DoNotOptimize(NavigationPolicy::Compile(config, nullptr));
+  }
+}
+
+RUNNER_BENCHMARK(NavigationPolicyCheck10K) {
+  std::optional<NavigationPolicy> policy =
+      NavigationPolicy::Compile(LargePolicy(), nullptr);
+  std::vector<std::u16string> urls = Urls();
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    DoNotOptimize(policy->Check(urls[next]));
+    next = (next + 1) % urls.size();
+  }
+}
+
+RUNNER_BENCHMARK(NavigationPolicyCheckDefault) {
+  std::optional<NavigationPolicy> policy =
+      NavigationPolicy::Compile(kDefaultNavigationPolicy, nullptr);
+  std::vector<std::u16string> urls = Urls();
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    DoNotOptimize(policy->Check(urls[next]));
+    next = (next + 1) % urls.size();
+  }
+}
+
+}  // namespace
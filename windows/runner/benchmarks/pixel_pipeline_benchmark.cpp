@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "pixel_pipeline.h"
+
+namespace {
+
+constexpr int32_t kFrameWidth = 1280;
+constexpr int32_t kFrameHeight = 720;
+constexpr size_t kFrameBytes =
+    static_cast<size_t>(kFrameWidth) * kFrameHeight * 4;
+
+// A frame of noise with partly transparent pixels, so premultiplication
+// cannot be skipped.
+std::vector<uint8_t> NoiseFrame(uint32_t seed) {
+  std::mt19937 random(seed);
+  std::vector<uint8_t> frame(kFrameBytes);
+  for (uint8_t& byte : frame) {
+    byte = static_cast<uint8_t>(random());
+  }
+  return frame;
+}
+
+void Convert(BenchmarkState& state,
+             void (*convert)(const uint8_t*, uint8_t*, size_t)) {
+  std::vector<uint8_t> source = NoiseFrame(1);
+  std::vector<uint8_t> destination(kFrameBytes);
+  state.SetBytesPerIteration(kFrameBytes);
+  while (state.KeepRunning()) {
+    convert(source.data(), destination.data(), kFrameBytes / 4);
+    DoNotOptimize(destination.data());
+  }
+}
+
+RUNNER_BENCHMARK(PixelConvert720p) {
+  Convert(state, ConvertBgraToRgbaPremultiplied);
+}
+
+RUNNER_BENCHMARK(PixelConvert720pScalar) {
+  Convert(state, ConvertBgraToRgbaPremultipliedScalar);
+}
+
+// Feeds the pipeline frames that alternate between two versions differing
+// in a band covering |percent| of the rows, like a page where only a
+// caret, a spinner or a scrolling list changes. Throughput is in frame
+// bytes, so it shows how much cheaper than a full conversion each frame is.
+void DirtyFrames(BenchmarkState& state, int32_t percent, bool detect_changes) {
+  std::vector<uint8_t> first = NoiseFrame(1);
+  std::vector<uint8_t> second = first;
+  int32_t band = kFrameHeight * percent / 100;
+  int32_t band_top = (kFrameHeight - band) / 2;
+  for (size_t i = static_cast<size_t>(band_top) * kFrameWidth * 4;
+       i < static_cast<size_t>(band_top + band) * kFrameWidth * 4; ++i) {
+    second[i] ^= 0x5A;
+  }
+  IntRect band_rect{0, band_top, kFrameWidth, band_top + band};
+
+  FramePipelineOptions options;
+  options.detect_changes = detect_changes;
+  FramePipeline pipeline(options);
+  PixelFrame frame{first.data(), kFrameWidth * 4u, kFrameWidth, kFrameHeight};
+  pipeline.Process(frame);
+  uint64_t frames = 0;
+  state.SetBytesPerIteration(kFrameBytes);
+  while (state.KeepRunning()) {
+    frame.pixels = (frames++ % 2 == 0 ? second : first).data();
+    if (!detect_changes) {
+      pipeline.Invalidate(band_rect);
+    }
+    DoNotOptimize(pipeline.Process(frame).size());
+  }
+  const FramePipelineStats& stats = pipeline.stats();
+  state.SetCounter("converted_tiles_ratio",
+                   static_cast<double>(stats.tiles_converted) /
+                       static_cast<double>(stats.tiles_converted +
+                                           stats.tiles_skipped));
+}
+
+RUNNER_BENCHMARK(FramePipelineDetect0Percent) {
+  DirtyFrames(state, 0, true);
+}
+
+RUNNER_BENCHMARK(FramePipelineDetect5Percent) {
+  DirtyFrames(state, 5, true);
+}
+
+RUNNER_BENCHMARK(FramePipelineDetect25Percent) {
+  DirtyFrames(state, 25, true);
+}
+
+RUNNER_BENCHMARK(FramePipelineDetect100Percent) {
+  DirtyFrames(state, 100, true);
+}
+
+RUNNER_BENCHMARK(FramePipelineInvalidate5Percent) {
+  DirtyFrames(state, 5, false);
+}
+
+}  // namespace
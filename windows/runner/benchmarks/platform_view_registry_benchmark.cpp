@@ -0,0 +1,58 @@
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "platform_view_registry.h"
+
+namespace {
+
+constexpr size_t kLiveViews = 4096;
+
+struct FakeView {
+  uint64_t data[4] = {};
+};
+
+// Keys shaped like HWNDs: small, aligned, mostly increasing.
+PlatformViewKey KeyFor(uint64_t serial) {
+  return static_cast<PlatformViewKey>(0x10000 + serial * 8);
+}
+
+// Create, look up by key and by handle, and destroy, over thousands of
+// live views.
+RUNNER_BENCHMARK(PlatformViewRegistryChurn) {
+  PlatformViewRegistry<FakeView> registry;
+  std::vector<PlatformViewKey> keys;
+  std::vector<SlotHandle> handles;
+  uint64_t serial = 0;
+  for (; serial < kLiveViews; ++serial) {
+    keys.push_back(KeyFor(serial));
+    handles.push_back(registry.Add(keys.back(), FakeView()));
+  }
+  std::mt19937 random(1);
+  state.SetItemsPerIteration(6);
+  while (state.KeepRunning()) {
+    size_t victim = random() % kLiveViews;
+    registry.Remove(handles[victim]);
+    keys[victim] = KeyFor(serial++);
+    handles[victim] = registry.Add(keys[victim], FakeView());
+    for (int i = 0; i < 2; ++i) {
+      DoNotOptimize(registry.Find(keys[random() % kLiveViews]));
+      DoNotOptimize(registry.Get(handles[random() % kLiveViews]));
+    }
+  }
+}
+
+RUNNER_BENCHMARK(PlatformViewRegistryFind) {
+  PlatformViewRegistry<FakeView> registry;
+  for (uint64_t serial = 0; serial < kLiveViews; ++serial) {
+    registry.Add(KeyFor(serial), FakeView());
+  }
+  uint64_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    DoNotOptimize(registry.Find(KeyFor(next)));
+    next = (next + 7) % kLiveViews;
+  }
+}
+
+}  // namespace
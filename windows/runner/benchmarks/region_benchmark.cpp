@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "occlusion_tracker.h"
+#include "region.h"
+
+namespace {
+
+constexpr int32_t kWindowWidth = 1920;
+constexpr int32_t kWindowHeight = 1080;
+
+// |count| overlapping overlays of up to 200x120 pixels scattered over the
+// window, like tooltips, menus, badges and scrims drawn over native views.
+std::vector<IntRect> Overlays(size_t count, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::vector<IntRect> rects;
+  rects.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    int32_t left = static_cast<int32_t>(random() % kWindowWidth);
+    int32_t top = static_cast<int32_t>(random() % kWindowHeight);
+    int32_t width = 8 + static_cast<int32_t>(random() % 192);
+    int32_t height = 8 + static_cast<int32_t>(random() % 112);
+    rects.push_back(IntRect{left, top, left + width, top + height});
+  }
+  return rects;
+}
+
+void FromRects(BenchmarkState& state, size_t count) {
+  std::vector<IntRect> overlays = Overlays(count, 1);
+  state.SetItemsPerIteration(count);
+  while (state.KeepRunning()) {
+    Region region = Region::FromRects(overlays);
+    DoNotOptimize(region.rect_count());
+  }
+  state.SetCounter("rects", static_cast<double>(
+                               Region::FromRects(overlays).rect_count()));
+}
+
+RUNNER_BENCHMARK(RegionFromRects100) {
+  FromRects(state, 100);
+}
+
+RUNNER_BENCHMARK(RegionFromRects500) {
+  FromRects(state, 500);
+}
+
+// The same union built one rectangle at a time, for comparison with the
+// single sweep.
+RUNNER_BENCHMARK(RegionUnionIncremental500) {
+  std::vector<IntRect> overlays = Overlays(500, 1);
+  state.SetItemsPerIteration(overlays.size());
+  while (state.KeepRunning()) {
+    Region region;
+    for (const IntRect& rect : overlays) {
+      region = Region::Union(region, Region(rect));
+    }
+    DoNotOptimize(region.rect_count());
+  }
+}
+
+RUNNER_BENCHMARK(RegionUnion2x250) {
+  Region a = Region::FromRects(Overlays(250, 1));
+  Region b = Region::FromRects(Overlays(250, 2));
+  while (state.KeepRunning()) {
+    Region region = Region::Union(a, b);
+    DoNotOptimize(region.rect_count());
+  }
+}
+
+RUNNER_BENCHMARK(RegionIntersect2x250) {
+  Region a = Region::FromRects(Overlays(250, 1));
+  Region b = Region::FromRects(Overlays(250, 2));
+  while (state.KeepRunning()) {
+    Region region = Region::Intersect(a, b);
+    DoNotOptimize(region.rect_count());
+  }
+}
+
+// A full-window view minus 500 overlays: the worst case of one view's
+// visible region.
+RUNNER_BENCHMARK(RegionSubtract500) {
+  Region view(IntRect{0, 0, kWindowWidth, kWindowHeight});
+  Region overlays = Region::FromRects(Overlays(500, 1));
+  while (state.KeepRunning()) {
+    Region visible = Region::Subtract(view, overlays);
+    DoNotOptimize(visible.rect_count());
+  }
+}
+
+// Twelve views in a 4x3 grid under 300 overlays, one of which moves every
+// frame, so every frame recomputes every view.
+void TrackerFrames(BenchmarkState& state, bool move_overlay) {
+  OcclusionTracker tracker;
+  for (OcclusionViewId view = 0; view < 12; ++view) {
+    int32_t left = static_cast<int32_t>(view % 4) * (kWindowWidth / 4);
+    int32_t top = static_cast<int32_t>(view / 4) * (kWindowHeight / 3);
+    tracker.SetViewBounds(view, IntRect{left, top, left + kWindowWidth / 4,
+                                        top + kWindowHeight / 3});
+  }
+  std::vector<IntRect> overlays = Overlays(300, 1);
+  tracker.SetOverlays(overlays);
+  tracker.Update();
+  uint64_t frame = 0;
+  while (state.KeepRunning()) {
+    if (move_overlay) {
+      int32_t dx = (++frame % 2 == 0) ? 1 : -1;
+      overlays[0].left += dx;
+      overlays[0].right += dx;
+    }
+    tracker.SetOverlays(overlays);
+    DoNotOptimize(tracker.Update().size());
+  }
+  const OcclusionTrackerStats& stats = tracker.stats();
+  state.SetCounter("regions_per_frame",
+                   static_cast<double>(stats.recomputed) /
+                       static_cast<double>(stats.overlay_updates));
+}
+
+RUNNER_BENCHMARK(OcclusionTrackerFrame300) {
+  TrackerFrames(state, true);
+}
+
+// The common case: the app reports the same overlays again.
+RUNNER_BENCHMARK(OcclusionTrackerUnchanged300) {
+  TrackerFrames(state, false);
+}
+
+}  // namespace
@@ -0,0 +1,94 @@
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark.h"
+#include "rpc_router.h"
+
+namespace {
+
+void RegisterMethods(RpcRouter* router, int extra_methods) {
+  router->Register("ping", [] { return "pong"; });
+  router->Register("echo", [](std::string_view message) { return message; });
+  router->Register("view.setBounds",
+                   [](int32_t view, double x, double y, double width,
+                      double height) { return x + y + width + height > view; });
+  // Names like a larger app's: namespaced, sharing long prefixes.
+  for (int i = 0; i < extra_methods; ++i) {
+    router->Register("app.module" + std::to_string(i % 16) + ".method" +
+                         std::to_string(i),
+                     [i] { return i; });
+  }
+}
+
+const char* const kRequests[] = {
+    "{\"id\":1,\"method\":\"ping\",\"params\":[]}",
+    "{\"id\":2,\"method\":\"echo\",\"params\":[\"hello from the page\"]}",
+    "{\"id\":3,\"method\":\"view.setBounds\",\"params\":[3,12.5,-3,1280,720]}",
+    "{\"id\":\"call-4\",\"method\":\"echo\","
+    "\"params\":[\"Gr\\u00fc\\u00dfe\"]}",
+};
+
+// Dispatch of a mix of typed calls, from parse to reply.
+void DispatchMix(BenchmarkState& state, int extra_methods) {
+  RpcRouter router;
+  RegisterMethods(&router, extra_methods);
+  std::string reply;
+  state.SetItemsPerIteration(std::size(kRequests));
+  while (state.KeepRunning()) {
+    for (const char* request : kRequests) {
+      DoNotOptimize(router.Dispatch(std::string_view(request), &reply));
+    }
+  }
+}
+
+RUNNER_BENCHMARK(RpcDispatch) {
+  DispatchMix(state, 0);
+}
+
+RUNNER_BENCHMARK(RpcDispatch1KMethods) {
+  DispatchMix(state, 1000);
+}
+
+// The path web messages take: UTF-16 JSON in, UTF-16 JSON out.
+RUNNER_BENCHMARK(RpcDispatchUtf16) {
+  RpcRouter router;
+  RegisterMethods(&router, 0);
+  std::vector<std::u16string> requests;
+  for (const char* request : kRequests) {
+    std::string_view ascii(request);
+    requests.emplace_back(ascii.begin(), ascii.end());
+  }
+  std::u16string reply;
+  state.SetItemsPerIteration(requests.size());
+  while (state.KeepRunning()) {
+    for (const std::u16string& request : requests) {
+      DoNotOptimize(router.Dispatch(std::u16string_view(request), &reply));
+    }
+  }
+}
+
+RUNNER_BENCHMARK(RpcMethodNotFound1KMethods) {
+  RpcRouter router;
+  RegisterMethods(&router, 1000);
+  std::string reply;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    DoNotOptimize(router.Dispatch(
+        std::string_view("{\"id\":9,\"method\":\"app.module3.method9999\"}"),
+        &reply));
+  }
+}
+
+// Registering 1000 methods and building the table for the first call.
+RUNNER_BENCHMARK_CAPPED(RpcRegister1KMethods, 1000) {
+  std::string reply;
+  while (state.KeepRunning()) {
+    RpcRouter router;
+    RegisterMethods(&router, 1000);
+    DoNotOptimize(router.Dispatch(std::string_view(kRequests[0]), &reply));
+  }
+}
+
+}  // namespace
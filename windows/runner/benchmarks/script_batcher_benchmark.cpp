@@ -0,0 +1,95 @@
+#include <deque>
+#include <string>
+#include <utility>
+
+#include "benchmark.h"
+#include "script_batcher.h"
+
+namespace {
+
+// Answers every script after |latency| calls to |AdvanceFrame|, with a
+// batch result that reports each call as returning 1. A latency of zero
+// answers synchronously.
+class FakeScriptEngine : public ScriptEngine {
+ public:
+  explicit FakeScriptEngine(uint64_t latency) : latency_(latency) {}
+
+  // ScriptEngine:
+  void Execute(std::u16string_view script, Callback callback) override {
+    // Each call of a batch is wrapped in its own try block.
+    size_t calls = 0;
+    for (size_t pos = script.find(u"try {"); pos != script.npos;
+         pos = script.find(u"try {", pos + 1)) {
+      ++calls;
+    }
+    std::u16string result = u"[";
+    for (size_t i = 0; i < calls; ++i) {
+      result.append(i == 0 ? u"[0,1]" : u",[0,1]");
+    }
+    result.push_back(u']');
+    if (latency_ == 0) {
+      callback(true, result);
+      return;
+    }
+    pending_.push_back(
+        Pending{frame_ + latency_, std::move(callback), std::move(result)});
+  }
+
+  // Advances one frame and answers the scripts that are due.
+  void AdvanceFrame() {
+    ++frame_;
+    while (!pending_.empty() && pending_.front().due <= frame_) {
+      Pending pending = std::move(pending_.front());
+      pending_.pop_front();
+      pending.callback(true, pending.result);
+    }
+  }
+
+ private:
+  struct Pending {
+    uint64_t due;
+    Callback callback;
+    std::u16string result;
+  };
+
+  uint64_t latency_;
+  uint64_t frame_ = 0;
+  std::deque<Pending> pending_;
+};
+
+// A frame's worth of property reads: queue |calls| expressions, flush them
+// as one script and deliver whatever results are due.
+void Frame(BenchmarkState& state, uint64_t latency, int calls) {
+  FakeScriptEngine engine(latency);
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  ScriptBatcher::Clock::time_point now;
+  uint64_t results = 0;
+  state.SetItemsPerIteration(calls);
+  while (state.KeepRunning()) {
+    for (int i = 0; i < calls; ++i) {
+      batcher.Execute(u"document.getElementById('item').scrollTop",
+                      [&results](ScriptStatus status,
+                                 std::u16string_view result_json) {
+                        results += result_json.size();
+                      });
+    }
+    now += std::chrono::milliseconds(16);
+    batcher.Flush(now);
+    engine.AdvanceFrame();
+  }
+  DoNotOptimize(results);
+}
+
+RUNNER_BENCHMARK(ScriptBatcherFrame16Sync) {
+  Frame(state, 0, 16);
+}
+
+RUNNER_BENCHMARK(ScriptBatcherFrame16Latency2) {
+  Frame(state, 2, 16);
+}
+
+RUNNER_BENCHMARK(ScriptBatcherSingleCall) {
+  Frame(state, 0, 1);
+}
+
+}  // namespace
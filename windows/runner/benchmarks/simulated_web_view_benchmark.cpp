@@ -0,0 +1,303 @@
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "benchmark.h"
+#include "controller_pool.h"
+#include "pixel_pipeline.h"
+#include "script_batcher.h"
+#include "simulated_web_view.h"
+#include "view_lifecycle.h"
+#include "web_message_channel.h"
+#include "web_view_backend.h"
+
+namespace {
+
+constexpr LifecycleViewId kViewCount = 8;
+constexpr int kFrames = 240;
+constexpr std::chrono::milliseconds kFrameTime(16);
+constexpr WebMessageChannelId kEchoChannel = 0;
+
+// A platform view as the runner keeps it, minus the native window.
+struct HostedView {
+  WebViewSurface surface;
+  std::unique_ptr<WebViewScriptEngine> engine;
+  std::unique_ptr<ScriptBatcher> scripts;
+  std::unique_ptr<WebViewMessageTransport> transport;
+  std::unique_ptr<WebMessageBatcher> messages;
+  WebMessageDispatcher dispatcher;
+  std::u16string restore_url;
+  ControllerPool<WebViewSurface>::ClaimId claim_id = 0;
+};
+
+// Drives views through the same components, in the same way, as
+// flutter_window.cpp does, against a simulated backend.
+class ScenarioHost : public ViewLifecycleDelegate {
+ public:
+  explicit ScenarioHost(SimulatedWebViewOptions options)
+      : backend_(&clock_, std::move(options)),
+        pool_(&backend_, PoolOptions()),
+        lifecycle_(this, LifecycleOptions()) {
+    pool_.Prewarm();
+  }
+
+  ~ScenarioHost() override {
+    for (auto& [id, view] : views_) {
+      Release(&view);
+    }
+    views_.clear();
+    pool_.Clear();
+  }
+
+  void AddView(LifecycleViewId id) {
+    views_.try_emplace(id);
+    lifecycle_.AddView(id, clock_.now());
+    Claim(id);
+  }
+
+  void RemoveView(LifecycleViewId id) {
+    auto it = views_.find(id);
+    Release(&it->second);
+    views_.erase(it);
+    lifecycle_.RemoveView(id);
+  }
+
+  void SetVisible(LifecycleViewId id, bool visible) {
+    lifecycle_.SetVisible(id, visible, clock_.now());
+  }
+
+  // Runs one frame: page traffic, flushes, and the simulated time until the
+  // next frame.
+  void Frame(int frame) {
+    for (auto& [id, view] : views_) {
+      if (!view.scripts) {
+        continue;
+      }
+      view.scripts->Execute(u"window.document.URL",
+                            [this](ScriptStatus status,
+                                   std::u16string_view result) {
+                              ++script_results_;
+                            });
+      if (frame % 4 == 0) {
+        view.messages->Send(kEchoChannel, u"ping");
+      }
+      view.scripts->Flush(clock_.now());
+      view.messages->Flush();
+      view.scripts->ExpireTimedOut(clock_.now());
+    }
+    lifecycle_.Update(clock_.now());
+    clock_.AdvanceBy(kFrameTime);
+  }
+
+  void Finish() { clock_.RunUntilIdle(); }
+
+  // ViewLifecycleDelegate:
+  void SuspendView(LifecycleViewId id) override {
+    HostedView& view = views_.at(id);
+    if (!view.surface) {
+      lifecycle_.OnSuspendFailed(id, clock_.now());
+      return;
+    }
+    view.surface->TrySuspend([this, id](bool suspended) {
+      if (!suspended && views_.count(id) != 0) {
+        lifecycle_.OnSuspendFailed(id, clock_.now());
+      }
+    });
+  }
+  void ResumeView(LifecycleViewId id) override {
+    HostedView& view = views_.at(id);
+    if (view.surface) {
+      view.surface->Resume();
+    }
+  }
+  void DiscardView(LifecycleViewId id) override {
+    HostedView& view = views_.at(id);
+    if (view.surface) {
+      view.restore_url = view.surface->Source();
+    }
+    Release(&view);
+  }
+  void RestoreView(LifecycleViewId id) override {
+    HostedView& view = views_.at(id);
+    if (!view.surface && view.claim_id == 0) {
+      Claim(id);
+    }
+  }
+
+  const SimulatedWebViewStats& backend_stats() const {
+    return backend_.stats();
+  }
+  uint64_t script_results() const { return script_results_; }
+  uint64_t echoes() const { return echoes_; }
+
+ private:
+  static ControllerPool<WebViewSurface>::Options PoolOptions() {
+    ControllerPool<WebViewSurface>::Options options;
+    options.idle_capacity = 4;
+    options.warm_count = 1;
+    options.max_idle_time = std::chrono::milliseconds(30000);
+    return options;
+  }
+
+  static ViewLifecycleOptions LifecycleOptions() {
+    ViewLifecycleOptions options;
+    options.max_live_views = 4;
+    options.hidden_suspend_delay = std::chrono::milliseconds(500);
+    options.suspend_retry_delay = std::chrono::milliseconds(1000);
+    return options;
+  }
+
+  void Claim(LifecycleViewId id) {
+    ControllerPool<WebViewSurface>::ClaimId claim_id =
+        pool_.Claim([this, id](WebViewSurface surface) {
+          Attach(id, std::move(surface));
+        });
+    auto it = views_.find(id);
+    if (it != views_.end() && !it->second.surface) {
+      it->second.claim_id = claim_id;
+    }
+  }
+
+  void Attach(LifecycleViewId id, WebViewSurface surface) {
+    auto it = views_.find(id);
+    if (it == views_.end()) {
+      if (surface) {
+        Recycle(std::move(surface));
+      }
+      return;
+    }
+    HostedView& view = it->second;
+    view.claim_id = 0;
+    if (!surface) {
+      return;
+    }
+    view.surface = std::move(surface);
+    WebViewController* webview = view.surface.get();
+    webview->Attach(static_cast<NativeWindow>(id), IntRect{0, 0, 640, 480});
+    webview->Navigate(view.restore_url.empty() ? u"https://example.com/"
+                                               : view.restore_url);
+    view.restore_url.clear();
+    view.engine = std::make_unique<WebViewScriptEngine>(webview);
+    view.scripts = std::make_unique<ScriptBatcher>(view.engine.get(),
+                                                   ScriptBatcher::Options());
+    view.transport = std::make_unique<WebViewMessageTransport>(webview);
+    view.messages = std::make_unique<WebMessageBatcher>(view.transport.get());
+    view.dispatcher.SetHandler(
+        kEchoChannel, [this](std::u16string_view payload) { ++echoes_; });
+
+    WebViewEvents events;
+    events.navigation_starting = [](std::u16string_view uri) {
+      return uri.substr(0, 8) == u"https://" || uri == u"about:blank";
+    };
+    events.web_message_received = [this, id](std::u16string_view message) {
+      auto it = views_.find(id);
+      if (it != views_.end() && IsWebMessageBatch(message)) {
+        it->second.dispatcher.Dispatch(message);
+      }
+    };
+    webview->SetEvents(std::move(events));
+  }
+
+  void Release(HostedView* view) {
+    view->scripts = nullptr;
+    view->engine = nullptr;
+    view->messages = nullptr;
+    view->transport = nullptr;
+    if (!view->surface) {
+      if (view->claim_id != 0) {
+        pool_.CancelClaim(view->claim_id);
+        view->claim_id = 0;
+      }
+      return;
+    }
+    view->surface->SetEvents(WebViewEvents());
+    Recycle(std::move(view->surface));
+    view->surface = WebViewSurface();
+  }
+
+  void Recycle(WebViewSurface surface) {
+    surface->Detach();
+    pool_.Return(std::move(surface));
+  }
+
+  VirtualClock clock_;
+  SimulatedWebViewBackend backend_;
+  ControllerPool<WebViewSurface> pool_;
+  ViewLifecycleManager lifecycle_;
+  std::map<LifecycleViewId, HostedView> views_;
+  uint64_t script_results_ = 0;
+  uint64_t echoes_ = 0;
+};
+
+// Four seconds of a feed of web views: views are created, scrolled out of
+// view and back, exchange scripts and messages with their pages every
+// frame, and are destroyed, against a backend that fails now and then.
+// One scenario per iteration, each with its own seed.
+RUNNER_BENCHMARK(SimulatedWebViewScenario) {
+  uint64_t seed = 1;
+  uint64_t callbacks = 0;
+  uint64_t failures = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    SimulatedWebViewOptions options;
+    options.controller_failure_rate = 0.02;
+    options.script_failure_rate = 0.05;
+    options.suspend_failure_rate = 0.1;
+    options.page_echoes_messages = true;
+    options.seed = seed++;
+    ScenarioHost host(std::move(options));
+    for (LifecycleViewId id = 1; id <= kViewCount; ++id) {
+      host.AddView(id);
+    }
+    for (int frame = 0; frame < kFrames; ++frame) {
+      LifecycleViewId id = 1 + frame % kViewCount;
+      host.SetVisible(id, frame / kViewCount % 3 != 0);
+      host.Frame(frame);
+    }
+    for (LifecycleViewId id = 1; id <= kViewCount; ++id) {
+      host.RemoveView(id);
+    }
+    host.Finish();
+    const SimulatedWebViewStats& stats = host.backend_stats();
+    callbacks += host.script_results() + host.echoes() + stats.navigations +
+                 stats.controllers_created;
+    failures += stats.script_failures + stats.suspend_failures +
+                stats.controller_failures;
+  }
+  state.SetCounter("callbacks_per_scenario",
+                   static_cast<double>(callbacks) /
+                       static_cast<double>(seed - 1));
+  state.SetCounter("failures_per_scenario",
+                   static_cast<double>(failures) /
+                       static_cast<double>(seed - 1));
+}
+
+// Captures a 720p simulated page into a frame pipeline every frame, as a
+// texture view does, with 5% of the rows changing between frames.
+RUNNER_BENCHMARK(SimulatedWebViewCaptureToTexture) {
+  VirtualClock clock;
+  SimulatedWebViewBackend backend(&clock, SimulatedWebViewOptions());
+  WebViewSurface surface;
+  backend.CreateController(
+      [&surface](WebViewSurface created) { surface = std::move(created); });
+  clock.RunUntilIdle();
+  surface->Attach(1, IntRect{0, 0, 1280, 720});
+  FramePipeline pipeline{FramePipelineOptions()};
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    surface->CaptureFrame([&pipeline](const PixelFrame* frame) {
+      DoNotOptimize(pipeline.Process(*frame).size());
+    });
+    clock.AdvanceBy(kFrameTime);
+  }
+  const FramePipelineStats& stats = pipeline.stats();
+  state.SetCounter("converted_tiles_ratio",
+                   static_cast<double>(stats.tiles_converted) /
+                       static_cast<double>(stats.tiles_converted +
+                                           stats.tiles_skipped));
+}
+
+}  // namespace
@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "standard_codec.h"
+#include "web_view_creation_params.h"
+
+namespace {
+
+// Creation params as the app sends them, with |script_count| scripts.
+std::vector<uint8_t> CreationParamsMessage(size_t script_count) {
+  std::vector<uint8_t> message;
+  StandardMessageWriter writer(&message);
+  writer.BeginMap(5);
+  writer.String("url");
+  writer.String("https://appassets.local/index.html");
+  writer.String("width");
+  writer.Int(1280);
+  writer.String("height");
+  writer.Int(720);
+  writer.String("settings");
+  writer.BeginMap(3);
+  writer.String("scriptDialogsEnabled");
+  writer.Bool(false);
+  writer.String("contextMenusEnabled");
+  writer.Bool(false);
+  writer.String("devToolsEnabled");
+  writer.Bool(true);
+  writer.String("scripts");
+  writer.BeginList(script_count);
+  for (size_t i = 0; i < script_count; ++i) {
+    writer.String("window.runnerConfig = window.runnerConfig || {};"
+                  "window.runnerConfig.feature" +
+                  std::to_string(i) + " = true;");
+  }
+  return message;
+}
+
+RUNNER_BENCHMARK(StandardDecodeCreationParams) {
+  std::vector<uint8_t> message = CreationParamsMessage(4);
+  WebViewCreationParams params;
+  std::string error;
+  state.SetBytesPerIteration(message.size());
+  while (state.KeepRunning()) {
+    StandardValue value;
+    DecodeStandardMessage(message.data(), message.size(), &value, &error);
+    ReadWebViewCreationParams(value, &params, &error);
+    DoNotOptimize(params.url.data());
+  }
+}
+
+RUNNER_BENCHMARK(StandardWriteCreationParams) {
+  size_t size = 0;
+  while (state.KeepRunning()) {
+    std::vector<uint8_t> message = CreationParamsMessage(4);
+    size = message.size();
+    DoNotOptimize(message.data());
+  }
+  state.SetBytesPerIteration(size);
+}
+
+// A large typed list is validated by its length alone and read in place.
+RUNNER_BENCHMARK(StandardDecodeFloat64List64K) {
+  std::vector<double> values(8 * 1024);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<double>(i) * 0.5;
+  }
+  std::vector<uint8_t> message;
+  StandardMessageWriter(&message).Float64List(values.data(), values.size());
+  state.SetBytesPerIteration(message.size());
+  while (state.KeepRunning()) {
+    StandardValue value;
+    DecodeStandardMessage(message.data(), message.size(), &value, nullptr);
+    double sum = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+      sum += value.Float64At(i);
+    }
+    DoNotOptimize(sum);
+  }
+}
+
+// Validation of many small values: a list of 1000 maps like a settings map.
+RUNNER_BENCHMARK(StandardDecodeNested1K) {
+  std::vector<uint8_t> message;
+  StandardMessageWriter writer(&message);
+  writer.BeginList(1000);
+  for (int i = 0; i < 1000; ++i) {
+    writer.BeginMap(3);
+    writer.String("id");
+    writer.Int(i);
+    writer.String("scale");
+    writer.Double(1.25);
+    writer.String("visible");
+    writer.Bool(i % 2 == 0);
+  }
+  state.SetBytesPerIteration(message.size());
+  while (state.KeepRunning()) {
+    StandardValue value;
+    DoNotOptimize(
+        DecodeStandardMessage(message.data(), message.size(), &value, nullptr));
+  }
+}
+
+}  // namespace
@@ -0,0 +1,72 @@
+#include <optional>
+#include <vector>
+
+#include "benchmark.h"
+#include "system_metrics.h"
+
+namespace {
+
+// Four monitors side by side at mixed DPIs, with a fixed theme and no
+// system functions.
+class FakeSystemMetricsProvider : public SystemMetricsProvider {
+ public:
+  // SystemMetricsProvider:
+  std::vector<MonitorInfo> EnumerateMonitors() override {
+    std::vector<MonitorInfo> monitors;
+    const uint32_t dpis[] = {96, 144, 120, 192};
+    for (int32_t i = 0; i < 4; ++i) {
+      MonitorInfo monitor;
+      monitor.id = static_cast<MonitorId>(i + 1);
+      monitor.bounds = IntRect{i * 1920, 0, (i + 1) * 1920, 1080};
+      monitor.dpi = dpis[i];
+      monitors.push_back(monitor);
+    }
+    return monitors;
+  }
+  std::optional<bool> ReadPrefersDarkMode() override { return true; }
+  void* LoadSystemFunction(const char* name) override { return nullptr; }
+};
+
+// DPI lookups as done when windows are created and moved.
+RUNNER_BENCHMARK(SystemMetricsDpiForPoint) {
+  FakeSystemMetricsProvider provider;
+  SystemMetricsCache cache(&provider);
+  int32_t x = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    x = (x + 997) % (4 * 1920 + 500);
+    DoNotOptimize(cache.DpiForPoint(x, 540));
+  }
+}
+
+// The same with the monitors re-enumerated every 64 lookups, as after a
+// burst of display changes.
+RUNNER_BENCHMARK(SystemMetricsDpiForPointInvalidated) {
+  FakeSystemMetricsProvider provider;
+  SystemMetricsCache cache(&provider);
+  int32_t x = 0;
+  uint32_t count = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    if (++count % 64 == 0) {
+      cache.InvalidateMonitors();
+    }
+    x = (x + 997) % (4 * 1920 + 500);
+    DoNotOptimize(cache.DpiForPoint(x, 540));
+  }
+}
+
+// Logical to physical and back, as done for every window size.
+RUNNER_BENCHMARK(SystemMetricsScaleRoundTrip) {
+  int32_t value = 0;
+  const uint32_t dpis[] = {96, 120, 144, 168, 192, 240};
+  size_t dpi = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    value = (value + 13) % 5000;
+    dpi = (dpi + 1) % 6;
+    DoNotOptimize(UnscaleForDpi(ScaleForDpi(value, dpis[dpi]), dpis[dpi]));
+  }
+}
+
+}  // namespace
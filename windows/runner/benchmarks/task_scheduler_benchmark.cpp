@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "portable_run_loop.h"
+#include "task_scheduler.h"
+
+namespace {
+
+// Posting and running a frame's worth of tasks on the loop's own thread.
+RUNNER_BENCHMARK(TaskSchedulerPostAndRun64) {
+  PortableRunLoop loop;
+  TaskScheduler& scheduler = loop.scheduler();
+  uint64_t ran = 0;
+  state.SetItemsPerIteration(64);
+  while (state.KeepRunning()) {
+    for (int i = 0; i < 64; ++i) {
+      scheduler.PostTask([&ran] { ++ran; },
+                         i % 4 == 0 ? TaskPriority::kHigh
+                                    : TaskPriority::kNormal);
+    }
+    loop.RunUntilIdle();
+  }
+  DoNotOptimize(ran);
+}
+
+// Delayed tasks that all come due before the loop runs them, ordered
+// through the delayed-task queue.
+RUNNER_BENCHMARK(TaskSchedulerDelayed64) {
+  PortableRunLoop loop;
+  TaskScheduler& scheduler = loop.scheduler();
+  uint64_t ran = 0;
+  state.SetItemsPerIteration(64);
+  while (state.KeepRunning()) {
+    TaskScheduler::Clock::time_point now = TaskScheduler::Clock::now();
+    for (int i = 0; i < 64; ++i) {
+      scheduler.PostTaskAt([&ran] { ++ran; },
+                           now - std::chrono::microseconds(64 - i));
+    }
+    loop.RunUntilIdle();
+  }
+  DoNotOptimize(ran);
+}
+
+// The time from posting a task on another thread to the sleeping loop
+// starting it, which is what a WebView2 completion posted to the UI thread
+// pays.
+RUNNER_BENCHMARK(TaskSchedulerCrossThreadWake) {
+  PortableRunLoop loop;
+  std::thread thread([&loop] { loop.Run(); });
+  std::vector<int64_t> latencies;
+  latencies.reserve(static_cast<size_t>(
+      std::min<uint64_t>(state.iterations(), 1 << 20)));
+  std::atomic<bool> done{false};
+  while (state.KeepRunning()) {
+    done.store(false, std::memory_order_relaxed);
+    TaskScheduler::Clock::time_point posted = TaskScheduler::Clock::now();
+    loop.scheduler().PostTask([&, posted] {
+      if (latencies.size() < latencies.capacity()) {
+        latencies.push_back((TaskScheduler::Clock::now() - posted).count());
+      }
+      done.store(true, std::memory_order_release);
+    });
+    while (!done.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  state.PauseTiming();
+  loop.Quit();
+  thread.join();
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    double to_ns = 1e9 * TaskScheduler::Clock::period::num /
+                   TaskScheduler::Clock::period::den;
+    state.SetCounter("p50_ns",
+                     latencies[latencies.size() / 2] * to_ns);
+    state.SetCounter("p99_ns",
+                     latencies[latencies.size() * 99 / 100] * to_ns);
+  }
+}
+
+}  // namespace
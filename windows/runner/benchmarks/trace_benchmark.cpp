@@ -0,0 +1,34 @@
+#include <thread>
+
+#include "benchmark.h"
+#include "trace.h"
+
+namespace {
+
+// A span while tracing is off: the common case in release runs.
+RUNNER_BENCHMARK(TraceScopeDisabled) {
+  StopTracing();
+  while (state.KeepRunning()) {
+    RUNNER_TRACE_SCOPE("Disabled");
+  }
+}
+
+// A span while tracing is on. Each run records on a new thread, whose
+// buffer starts empty, and stays within its capacity so that no event is
+// dropped; the dropped ratio confirms it.
+RUNNER_BENCHMARK_CAPPED(TraceScopeEnabled, 16 * 1024) {
+  uint64_t dropped = DroppedTraceEventCount();
+  StartTracing();
+  std::thread thread([&state] {
+    while (state.KeepRunning()) {
+      RUNNER_TRACE_SCOPE("Enabled");
+    }
+  });
+  thread.join();
+  StopTracing();
+  state.SetCounter("dropped_ratio",
+                   static_cast<double>(DroppedTraceEventCount() - dropped) /
+                       static_cast<double>(state.iterations()));
+}
+
+}  // namespace
@@ -0,0 +1,62 @@
+#include <string>
+
+#include "benchmark.h"
+#include "utf_transcoder.h"
+
+namespace {
+
+// Repeats |unit| until it is at least |length| code units long.
+std::u16string Repeat(std::u16string_view unit, size_t length) {
+  std::u16string text;
+  while (text.size() < length) {
+    text.append(unit);
+  }
+  return text;
+}
+
+void ConvertBuffered(BenchmarkState& state, const std::u16string& text) {
+  Utf8Buffer buffer;
+  state.SetBytesPerIteration(text.size() * sizeof(char16_t));
+  while (state.KeepRunning()) {
+    DoNotOptimize(buffer.Convert(text));
+  }
+}
+
+RUNNER_BENCHMARK(Utf16ToUtf8Ascii4K) {
+  ConvertBuffered(state, Repeat(u"https://example.com/path?query=value&", 4096));
+}
+
+RUNNER_BENCHMARK(Utf16ToUtf8Latin4K) {
+  ConvertBuffered(state, Repeat(u"Grüße aus Köln, àéîõü ", 4096));
+}
+
+RUNNER_BENCHMARK(Utf16ToUtf8Cjk4K) {
+  ConvertBuffered(state, Repeat(u"平台视图测试ウェブビュー한국어", 4096));
+}
+
+RUNNER_BENCHMARK(Utf16ToUtf8Emoji4K) {
+  ConvertBuffered(state, Repeat(u"ok \U0001F600\U0001F680 ", 4096));
+}
+
+// The shape of |Utf8FromUtf16|: one string into a new std::string.
+void ConvertToNewString(BenchmarkState& state, const std::u16string& text) {
+  state.SetBytesPerIteration(text.size() * sizeof(char16_t));
+  while (state.KeepRunning()) {
+    std::string utf8;
+    AppendUtf16AsUtf8(text, &utf8);
+    DoNotOptimize(utf8);
+  }
+}
+
+RUNNER_BENCHMARK(Utf16ToUtf8NewString64) {
+  ConvertToNewString(state, Repeat(u"--dart-entrypoint-args=", 64));
+}
+
+// Large enough that sizing the string for the worst case would cost a
+// zero-filled 12 KB allocation per call.
+RUNNER_BENCHMARK(Utf16ToUtf8NewString4K) {
+  ConvertToNewString(state,
+                     Repeat(u"https://example.com/path?query=value&", 4096));
+}
+
+}  // namespace
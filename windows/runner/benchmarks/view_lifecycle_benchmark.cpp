@@ -0,0 +1,90 @@
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "view_lifecycle.h"
+
+namespace {
+
+constexpr LifecycleViewId kViewCount = 32;
+constexpr size_t kTraceLength = 8192;
+
+// Counts the manager's decisions instead of acting on them.
+class CountingDelegate : public ViewLifecycleDelegate {
+ public:
+  // ViewLifecycleDelegate:
+  void SuspendView(LifecycleViewId view) override { ++calls; }
+  void ResumeView(LifecycleViewId view) override { ++calls; }
+  void DiscardView(LifecycleViewId view) override { ++calls; }
+  void RestoreView(LifecycleViewId view) override { ++calls; }
+
+  uint64_t calls = 0;
+};
+
+enum class EventType : uint8_t { kShow, kHide, kTouch, kUpdate };
+
+struct TraceEvent {
+  EventType type;
+  LifecycleViewId view;
+  // Time since the previous event.
+  std::chrono::milliseconds delay;
+};
+
+// A scrolling feed: views go off and on screen, the user now and then
+// focuses one, and the owner runs an update after most changes.
+std::vector<TraceEvent> VisibilityTrace() {
+  std::mt19937 random(3);
+  std::vector<TraceEvent> trace;
+  for (size_t i = 0; i < kTraceLength; ++i) {
+    LifecycleViewId view = 1 + random() % kViewCount;
+    EventType type = static_cast<EventType>(random() % 4);
+    trace.push_back(TraceEvent{
+        type, view, std::chrono::milliseconds(random() % 400)});
+  }
+  return trace;
+}
+
+// Replays a visibility trace, one event per iteration.
+RUNNER_BENCHMARK(ViewLifecycleTraceReplay) {
+  std::vector<TraceEvent> trace = VisibilityTrace();
+  CountingDelegate delegate;
+  ViewLifecycleOptions options;
+  options.max_live_views = 6;
+  options.memory_budget_bytes = 384 * 1024 * 1024;
+  ViewLifecycleManager manager(&delegate, options);
+  ViewLifecycleManager::Clock::time_point now;
+  for (LifecycleViewId view = 1; view <= kViewCount; ++view) {
+    manager.AddView(view, now);
+  }
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    const TraceEvent& event = trace[next];
+    next = (next + 1) % trace.size();
+    now += event.delay;
+    switch (event.type) {
+      case EventType::kShow:
+        manager.SetVisible(event.view, true, now);
+        break;
+      case EventType::kHide:
+        manager.SetVisible(event.view, false, now);
+        break;
+      case EventType::kTouch:
+        manager.Touch(event.view, now);
+        break;
+      case EventType::kUpdate:
+        manager.Update(now);
+        break;
+    }
+  }
+  const ViewLifecycleStats& stats = manager.stats();
+  double events = static_cast<double>(state.iterations());
+  state.SetCounter("suspended_per_event",
+                   static_cast<double>(stats.suspended) / events);
+  state.SetCounter("discarded_per_event",
+                   static_cast<double>(stats.discarded) / events);
+  DoNotOptimize(delegate.calls);
+}
+
+}  // namespace
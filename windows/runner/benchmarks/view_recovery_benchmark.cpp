@@ -0,0 +1,324 @@
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "controller_pool.h"
+#include "simulated_web_view.h"
+#include "view_recovery.h"
+#include "web_view_backend.h"
+
+namespace {
+
+constexpr RecoveryViewId kViewCount = 16;
+constexpr size_t kTraceLength = 8192;
+
+// Counts the manager's decisions instead of acting on them.
+class CountingDelegate : public ViewRecoveryDelegate {
+ public:
+  // ViewRecoveryDelegate:
+  void ReplaceController(RecoveryViewId view) override { ++calls; }
+  void RestartBrowser() override { ++calls; }
+  void AbandonView(RecoveryViewId view) override { ++calls; }
+  void ViewRecovered(RecoveryViewId view,
+                     std::chrono::nanoseconds recovery_time) override {
+    ++calls;
+  }
+
+  uint64_t calls = 0;
+};
+
+enum class EventType : uint8_t {
+  kRendererFailure,
+  kBrowserFailure,
+  kAttached,
+  kAttachFailed,
+  kNavigationCompleted,
+  kUpdate,
+};
+
+struct TraceEvent {
+  EventType type;
+  RecoveryViewId view;
+  // Time since the previous event.
+  std::chrono::milliseconds delay;
+};
+
+// Views crash now and then, mostly their renderers; replacements mostly
+// arrive and load, and the owner runs an update after most changes.
+std::vector<TraceEvent> FailureTrace() {
+  std::mt19937 random(5);
+  std::vector<TraceEvent> trace;
+  for (size_t i = 0; i < kTraceLength; ++i) {
+    RecoveryViewId view = 1 + random() % kViewCount;
+    uint32_t roll = random() % 100;
+    EventType type = roll < 10   ? EventType::kRendererFailure
+                     : roll < 11 ? EventType::kBrowserFailure
+                     : roll < 40 ? EventType::kAttached
+                     : roll < 45 ? EventType::kAttachFailed
+                     : roll < 75 ? EventType::kNavigationCompleted
+                                 : EventType::kUpdate;
+    trace.push_back(TraceEvent{
+        type, view, std::chrono::milliseconds(random() % 2000)});
+  }
+  return trace;
+}
+
+// Replays a failure trace, one event per iteration.
+RUNNER_BENCHMARK(ViewRecoveryTraceReplay) {
+  std::vector<TraceEvent> trace = FailureTrace();
+  CountingDelegate delegate;
+  ViewRecoveryManager manager(&delegate, ViewRecoveryOptions());
+  ViewRecoveryManager::Clock::time_point now;
+  for (RecoveryViewId view = 1; view <= kViewCount; ++view) {
+    manager.AddView(view);
+  }
+  size_t next = 0;
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    const TraceEvent& event = trace[next];
+    next = (next + 1) % trace.size();
+    now += event.delay;
+    switch (event.type) {
+      case EventType::kRendererFailure:
+        manager.OnProcessFailed(event.view,
+                                WebViewProcessFailure::kRendererExited, now);
+        break;
+      case EventType::kBrowserFailure:
+        manager.OnProcessFailed(event.view,
+                                WebViewProcessFailure::kBrowserExited, now);
+        break;
+      case EventType::kAttached:
+        manager.OnReplacementAttached(event.view, true, now);
+        break;
+      case EventType::kAttachFailed:
+        manager.OnReplacementAttached(event.view, false, now);
+        break;
+      case EventType::kNavigationCompleted:
+        manager.OnNavigationCompleted(event.view, now);
+        break;
+      case EventType::kUpdate:
+        manager.Update(now);
+        break;
+    }
+  }
+  const ViewRecoveryStats& stats = manager.stats();
+  double events = static_cast<double>(state.iterations());
+  state.SetCounter("replacements_per_event",
+                   static_cast<double>(stats.replacements) / events);
+  state.SetCounter("abandoned", static_cast<double>(stats.abandoned));
+  DoNotOptimize(delegate.calls);
+}
+
+// A platform view as the runner keeps it for recovery, minus the native
+// window and page traffic.
+struct HostedView {
+  WebViewSurface surface;
+  std::u16string committed_url;
+  std::u16string restore_url;
+  ControllerPool<WebViewSurface>::ClaimId claim_id = 0;
+};
+
+// Recovers views the way flutter_window.cpp does, against a simulated
+// backend.
+class RecoveryHost : public ViewRecoveryDelegate {
+ public:
+  explicit RecoveryHost(size_t warm_count)
+      : backend_(&clock_, SimulatedWebViewOptions()),
+        pool_(&backend_, PoolOptions(warm_count)),
+        recovery_(this, ViewRecoveryOptions()) {
+    pool_.Prewarm();
+  }
+
+  ~RecoveryHost() override {
+    for (auto& [id, view] : views_) {
+      view.surface = WebViewSurface();
+    }
+    views_.clear();
+    pool_.Clear();
+  }
+
+  void AddView(RecoveryViewId id) {
+    views_.try_emplace(id);
+    recovery_.AddView(id);
+    Claim(id);
+  }
+
+  // Lets views load and the pool warm up.
+  void Settle() { clock_.RunUntilIdle(); }
+
+  void CrashRenderer(RecoveryViewId id) {
+    static_cast<SimulatedWebViewController*>(views_.at(id).surface.get())
+        ->SimulateProcessFailure(WebViewProcessFailure::kRendererExited);
+  }
+
+  void CrashBrowser() { backend_.SimulateBrowserExit(); }
+
+  const ViewRecoveryStats& stats() const { return recovery_.stats(); }
+
+  // ViewRecoveryDelegate:
+  void ReplaceController(RecoveryViewId id) override {
+    HostedView& view = views_.at(id);
+    if (view.claim_id != 0) {
+      return;
+    }
+    if (view.surface) {
+      view.surface->SetEvents(WebViewEvents());
+      view.surface->Detach();
+      backend_.DestroyController(std::move(view.surface));
+      view.surface = WebViewSurface();
+    }
+    view.restore_url = view.committed_url;
+    Claim(id);
+  }
+  void RestartBrowser() override {
+    pool_.Clear();
+    backend_.RestartBrowser();
+    pool_.Prewarm();
+  }
+  void AbandonView(RecoveryViewId id) override {
+    HostedView& view = views_.at(id);
+    view.surface = WebViewSurface();
+  }
+  void ViewRecovered(RecoveryViewId id,
+                     std::chrono::nanoseconds recovery_time) override {}
+
+ private:
+  static ControllerPool<WebViewSurface>::Options PoolOptions(
+      size_t warm_count) {
+    ControllerPool<WebViewSurface>::Options options;
+    options.idle_capacity = 4;
+    options.warm_count = warm_count;
+    return options;
+  }
+
+  void Claim(RecoveryViewId id) {
+    auto answered = std::make_shared<bool>(false);
+    ControllerPool<WebViewSurface>::ClaimId claim_id =
+        pool_.Claim([this, id, answered](WebViewSurface surface) {
+          *answered = true;
+          Attach(id, std::move(surface));
+        });
+    if (!*answered) {
+      views_.at(id).claim_id = claim_id;
+    }
+  }
+
+  void Attach(RecoveryViewId id, WebViewSurface surface) {
+    HostedView& view = views_.at(id);
+    view.claim_id = 0;
+    recovery_.OnReplacementAttached(id, static_cast<bool>(surface),
+                                    clock_.now());
+    ScheduleUpdate();
+    if (!surface) {
+      return;
+    }
+    view.surface = std::move(surface);
+    WebViewController* webview = view.surface.get();
+    webview->Attach(static_cast<NativeWindow>(id), IntRect{0, 0, 640, 480});
+    webview->SetDocumentScripts({u"window.runnerReady = true;"});
+    webview->Navigate(view.restore_url.empty() ? u"https://example.com/"
+                                               : view.restore_url);
+    view.restore_url.clear();
+
+    WebViewEvents events;
+    events.navigation_completed = [this, id](bool succeeded) {
+      HostedView& view = views_.at(id);
+      if (succeeded) {
+        view.committed_url = view.surface->Source();
+      }
+      recovery_.OnNavigationCompleted(id, clock_.now());
+    };
+    events.process_failed = [this, id](WebViewProcessFailure failure) {
+      VirtualClock::Clock::time_point failed_at = clock_.now();
+      clock_.PostDelayed(VirtualClock::Clock::duration::zero(),
+                         [this, id, failure, failed_at] {
+                           recovery_.OnProcessFailed(id, failure, failed_at);
+                           ScheduleUpdate();
+                         });
+    };
+    webview->SetEvents(std::move(events));
+  }
+
+  void ScheduleUpdate() {
+    if (std::optional<ViewRecoveryManager::Clock::time_point> next =
+            recovery_.NextUpdateTime()) {
+      clock_.PostAt(*next, [this] {
+        recovery_.Update(clock_.now());
+        ScheduleUpdate();
+      });
+    }
+  }
+
+  VirtualClock clock_;
+  SimulatedWebViewBackend backend_;
+  ControllerPool<WebViewSurface> pool_;
+  ViewRecoveryManager recovery_;
+  std::map<RecoveryViewId, HostedView> views_;
+};
+
+// Crashes the renderer of each of four loaded views in turn and recovers
+// it, one scenario per iteration. Reports the simulated time from each
+// crash to the page having reloaded.
+void RendererRecovery(BenchmarkState& state, size_t warm_count) {
+  std::chrono::nanoseconds recovery_time{0};
+  uint64_t recovered = 0;
+  state.SetItemsPerIteration(4);
+  while (state.KeepRunning()) {
+    RecoveryHost host(warm_count);
+    for (RecoveryViewId id = 1; id <= 4; ++id) {
+      host.AddView(id);
+    }
+    host.Settle();
+    for (RecoveryViewId id = 1; id <= 4; ++id) {
+      host.CrashRenderer(id);
+      host.Settle();
+    }
+    recovery_time += host.stats().total_recovery_time;
+    recovered += host.stats().recovered;
+  }
+  state.SetCounter(
+      "recovery_ms",
+      std::chrono::duration<double, std::milli>(recovery_time).count() /
+          static_cast<double>(recovered));
+}
+
+// Replacements come from the pool's warm standby.
+RUNNER_BENCHMARK(ViewRecoveryRendererWarm) {
+  RendererRecovery(state, 1);
+}
+
+// Every replacement is created on demand.
+RUNNER_BENCHMARK(ViewRecoveryRendererCold) {
+  RendererRecovery(state, 0);
+}
+
+// Ends the browser under four loaded views, which all recover in a new one.
+RUNNER_BENCHMARK(ViewRecoveryBrowserExit) {
+  std::chrono::nanoseconds recovery_time{0};
+  uint64_t recovered = 0;
+  state.SetItemsPerIteration(4);
+  while (state.KeepRunning()) {
+    RecoveryHost host(1);
+    for (RecoveryViewId id = 1; id <= 4; ++id) {
+      host.AddView(id);
+    }
+    host.Settle();
+    host.CrashBrowser();
+    host.Settle();
+    recovery_time += host.stats().total_recovery_time;
+    recovered += host.stats().recovered;
+  }
+  state.SetCounter(
+      "recovery_ms",
+      std::chrono::duration<double, std::milli>(recovery_time).count() /
+          static_cast<double>(recovered));
+}
+
+}  // namespace
@@ -0,0 +1,50 @@
+#include <string>
+
+#include "benchmark.h"
+#include "web_message_channel.h"
+
+namespace {
+
+constexpr WebMessageChannelId kChannel = 3;
+
+// One frame's worth of messages through the loopback transport: encode,
+// post and dispatch.
+RUNNER_BENCHMARK(WebMessageLoopbackBatch64) {
+  WebMessageDispatcher dispatcher;
+  size_t received = 0;
+  dispatcher.SetHandler(kChannel, [&received](std::u16string_view payload) {
+    received += payload.size();
+  });
+  LoopbackWebMessageTransport transport(&dispatcher);
+  WebMessageBatcher batcher(&transport);
+  std::u16string payload(100, u'x');
+  state.SetItemsPerIteration(64);
+  state.SetBytesPerIteration(64 * payload.size() * sizeof(char16_t));
+  while (state.KeepRunning()) {
+    for (int i = 0; i < 64; ++i) {
+      batcher.Send(kChannel, payload);
+    }
+    batcher.Flush();
+  }
+  DoNotOptimize(received);
+}
+
+// A lone message, the latency-bound case.
+RUNNER_BENCHMARK(WebMessageLoopbackSingle) {
+  WebMessageDispatcher dispatcher;
+  size_t received = 0;
+  dispatcher.SetHandler(kChannel, [&received](std::u16string_view payload) {
+    received += payload.size();
+  });
+  LoopbackWebMessageTransport transport(&dispatcher);
+  WebMessageBatcher batcher(&transport);
+  std::u16string payload = u"{\"type\":\"scroll\",\"y\":1200}";
+  state.SetItemsPerIteration(1);
+  while (state.KeepRunning()) {
+    batcher.Send(kChannel, payload);
+    batcher.Flush();
+  }
+  DoNotOptimize(received);
+}
+
+}  // namespace
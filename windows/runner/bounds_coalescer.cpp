@@ -0,0 +1,57 @@
+#include "bounds_coalescer.h"
+
+BoundsCoalescer::BoundsCoalescer(Clock::duration min_apply_interval)
+    : min_apply_interval_(min_apply_interval) {}
+
+bool BoundsCoalescer::Submit(const IntRect& bounds) {
+  ++stats_.received;
+  if (pending_) {
+    if (*pending_ == bounds) {
+      ++stats_.unchanged;
+      return true;
+    }
+    ++stats_.merged;
+    if (applied_ && *applied_ == bounds) {
+      // The burst ended where it started; nothing needs to change.
+      pending_.reset();
+      return false;
+    }
+    pending_ = bounds;
+    return true;
+  }
+  if (applied_ && *applied_ == bounds) {
+    ++stats_.unchanged;
+    return false;
+  }
+  pending_ = bounds;
+  return true;
+}
+
+std::optional<IntRect> BoundsCoalescer::Flush(Clock::time_point now) {
+  if (!pending_) {
+    return std::nullopt;
+  }
+  if (applied_ && now - last_apply_ < min_apply_interval_) {
+    ++stats_.deferred;
+    return std::nullopt;
+  }
+  applied_ = pending_;
+  pending_.reset();
+  last_apply_ = now;
+  ++stats_.applied;
+  return applied_;
+}
+
+void BoundsCoalescer::MarkApplied(const IntRect& bounds,
+                                  Clock::time_point now) {
+  applied_ = bounds;
+  last_apply_ = now;
+  if (pending_ && *pending_ == bounds) {
+    pending_.reset();
+  }
+}
+
+void BoundsCoalescer::Reset() {
+  applied_.reset();
+  pending_.reset();
+}
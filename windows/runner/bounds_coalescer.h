@@ -0,0 +1,66 @@
+#ifndef RUNNER_BOUNDS_COALESCER_H_
+#define RUNNER_BOUNDS_COALESCER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "geometry.h"
+
+// Counters describing how many bounds updates a |BoundsCoalescer| absorbed.
+struct BoundsCoalescerStats {
+  // Every call to |Submit|.
+  uint64_t received = 0;
+  // Submissions identical to the bounds already pending or applied.
+  uint64_t unchanged = 0;
+  // Pending bounds overwritten by a newer submission before being applied.
+  uint64_t merged = 0;
+  // Flushes that held back pending bounds because of the rate limit.
+  uint64_t deferred = 0;
+  // Bounds actually handed to the controller.
+  uint64_t applied = 0;
+};
+
+// Collapses a stream of bounds changes for one view into at most one update
+// per flush.
+//
+// Window procedures |Submit| every size change as it arrives; the owner calls
+// |Flush| once per frame and applies whatever it returns. Submissions that
+// match what is already applied are dropped, bursts between flushes collapse
+// to the latest value, and consecutive applies are spaced at least
+// |min_apply_interval| apart.
+class BoundsCoalescer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit BoundsCoalescer(
+      Clock::duration min_apply_interval = Clock::duration::zero());
+
+  // Records |bounds| as the latest target. Returns true if an update is now
+  // pending and a flush should be scheduled.
+  bool Submit(const IntRect& bounds);
+
+  // Returns the bounds to apply at |now|, if any are pending and the rate
+  // limit allows it. Returned bounds are considered applied.
+  std::optional<IntRect> Flush(Clock::time_point now);
+
+  // Records |bounds| as applied outside of |Flush|, e.g. when a controller is
+  // first attached, and discards anything pending that matches it.
+  void MarkApplied(const IntRect& bounds, Clock::time_point now);
+
+  // Forgets the applied and pending bounds, so nothing submitted before is
+  // flushed and the next submission is always applied.
+  void Reset();
+
+  bool has_pending() const { return pending_.has_value(); }
+  const BoundsCoalescerStats& stats() const { return stats_; }
+
+ private:
+  Clock::duration min_apply_interval_;
+  std::optional<IntRect> applied_;
+  std::optional<IntRect> pending_;
+  Clock::time_point last_apply_;
+  BoundsCoalescerStats stats_;
+};
+
+#endif  // RUNNER_BOUNDS_COALESCER_H_
@@ -0,0 +1,62 @@
+#include "command_line.h"
+
+#include "utf_transcoder.h"
+
+namespace {
+
+constexpr std::u16string_view kTraceStartupFlag = u"--trace-startup";
+constexpr std::u16string_view kMetricsFlag = u"--metrics";
+constexpr std::u16string_view kTextureViewsFlag = u"--texture-views";
+
+// Handles |argument| if it is |flag|[=<file>], setting |file| to the file
+// or to |default_file|. Returns false if it is not.
+bool HandleFileFlag(std::u16string_view argument,
+                    std::u16string_view flag,
+                    const char16_t* default_file,
+                    std::optional<std::u16string>* file) {
+  if (argument.substr(0, flag.size()) != flag) {
+    return false;
+  }
+  std::u16string_view value = argument.substr(flag.size());
+  if (value.empty()) {
+    *file = default_file;
+  } else if (value.size() > 1 && value[0] == u'=') {
+    *file = std::u16string(value.substr(1));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Handles |argument| if it is a runner flag. Returns false if it should be
+// passed on to the engine.
+bool HandleRunnerFlag(std::u16string_view argument, RunnerFlags* flags) {
+  if (argument == kTextureViewsFlag) {
+    flags->texture_views = true;
+    return true;
+  }
+  return HandleFileFlag(argument, kTraceStartupFlag, kDefaultTraceFile,
+                        &flags->trace_file) ||
+         HandleFileFlag(argument, kMetricsFlag, kDefaultMetricsFile,
+                        &flags->metrics_file);
+}
+
+}  // namespace
+
+const char16_t kDefaultTraceFile[] = u"runner_trace.json";
+const char16_t kDefaultMetricsFile[] = u"runner_metrics.json";
+
+std::vector<std::string> ParseCommandLine(
+    const std::vector<std::u16string_view>& arguments,
+    RunnerFlags* flags) {
+  std::vector<std::string> engine_arguments;
+  engine_arguments.reserve(arguments.size());
+  for (std::u16string_view argument : arguments) {
+    if (HandleRunnerFlag(argument, flags)) {
+      continue;
+    }
+    std::string& utf8 = engine_arguments.emplace_back();
+    AppendUtf16AsUtf8(argument, &utf8);
+  }
+  return engine_arguments;
+}
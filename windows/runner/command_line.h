@@ -0,0 +1,33 @@
+#ifndef RUNNER_COMMAND_LINE_H_
+#define RUNNER_COMMAND_LINE_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Flags handled by the runner itself rather than passed on to the engine.
+struct RunnerFlags {
+  // --trace-startup[=<file>]: where to write the startup trace.
+  std::optional<std::u16string> trace_file;
+  // --metrics[=<file>]: where to write runtime metrics (see metrics.h).
+  std::optional<std::u16string> metrics_file;
+  // --texture-views: shows platform views as textures (see
+  // web_view_texture.h) instead of child windows.
+  bool texture_views = false;
+};
+
+// The trace file used by a bare --trace-startup.
+extern const char16_t kDefaultTraceFile[];
+
+// The metrics file used by a bare --metrics.
+extern const char16_t kDefaultMetricsFile[];
+
+// Removes runner flags from |arguments|, which exclude the executable name,
+// into |flags|, and returns the rest as UTF-8 for the engine. Arguments that
+// are not valid UTF-16 are passed on as empty strings.
+std::vector<std::string> ParseCommandLine(
+    const std::vector<std::u16string_view>& arguments,
+    RunnerFlags* flags);
+
+#endif  // RUNNER_COMMAND_LINE_H_
@@ -0,0 +1,288 @@
+#ifndef RUNNER_CONTROLLER_POOL_H_
+#define RUNNER_CONTROLLER_POOL_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Asynchronously produces and disposes of the controllers managed by a
+// |ControllerPool|.
+//
+// |Controller| is a movable handle type (for example a COM smart pointer)
+// that converts to false when empty.
+template <typename Controller>
+class ControllerSource {
+ public:
+  using CreateCallback = std::function<void(Controller controller)>;
+
+  virtual ~ControllerSource() = default;
+
+  // Starts creating a controller. |callback| must eventually be invoked
+  // exactly once, with an empty controller on failure. It may be invoked
+  // before this method returns.
+  virtual void CreateController(CreateCallback callback) = 0;
+
+  // Releases a controller the pool no longer needs.
+  virtual void DestroyController(Controller controller) = 0;
+};
+
+// Counters describing how well a |ControllerPool| is keeping up with demand.
+struct ControllerPoolStats {
+  // Claims satisfied immediately from an idle controller.
+  uint64_t hits = 0;
+  // Claims that had to wait for a controller to be created.
+  uint64_t misses = 0;
+  // Claims cancelled before they were satisfied.
+  uint64_t cancelled = 0;
+  // Controllers successfully created / failed to create by the source.
+  uint64_t created = 0;
+  uint64_t creation_failures = 0;
+  // Controllers handed back to the source for disposal, and how many of
+  // those were evicted for sitting idle too long.
+  uint64_t destroyed = 0;
+  uint64_t evicted = 0;
+  // Time from |Claim| to the claim callback, over all satisfied claims.
+  uint64_t claims_satisfied = 0;
+  std::chrono::nanoseconds total_claim_latency{0};
+  std::chrono::nanoseconds max_claim_latency{0};
+};
+
+// A bounded pool of pre-created controllers.
+//
+// Platform views claim a controller when they are created and return it when
+// they are destroyed. The pool keeps up to |idle_capacity| idle controllers
+// and proactively creates controllers so that |warm_count| are idle or in
+// flight, which keeps the expensive creation step off the path that shows a
+// new view. Idle controllers beyond |warm_count| are evicted once they have
+// been idle for |max_idle_time|. All methods must be called on the same
+// thread as the source's callbacks.
+template <typename Controller>
+class ControllerPool {
+ public:
+  using ClaimCallback = std::function<void(Controller controller)>;
+  using ClaimId = uint64_t;
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    // Maximum number of idle controllers retained.
+    size_t idle_capacity = 2;
+    // Number of controllers kept idle or in flight ahead of demand.
+    size_t warm_count = 1;
+    // How long a controller beyond |warm_count| may stay idle before
+    // |EvictIdle| disposes of it. Zero keeps idle controllers indefinitely.
+    std::chrono::milliseconds max_idle_time{0};
+  };
+
+  ControllerPool(ControllerSource<Controller>* source, Options options)
+      : source_(source), options_(options) {
+    if (options_.warm_count > options_.idle_capacity) {
+      options_.warm_count = options_.idle_capacity;
+    }
+  }
+
+  ~ControllerPool() { Clear(); }
+
+  ControllerPool(const ControllerPool&) = delete;
+  ControllerPool& operator=(const ControllerPool&) = delete;
+
+  // Starts creating controllers until |warm_count| are idle or pending.
+  void Prewarm() {
+    // Sources may complete synchronously, which re-enters through |Offer|;
+    // bounding the attempts also stops a failing source from spinning.
+    if (prewarming_) {
+      return;
+    }
+    prewarming_ = true;
+    for (size_t attempts = options_.warm_count;
+         attempts > 0 && idle_.size() + Surplus() < options_.warm_count;
+         --attempts) {
+      StartCreation();
+    }
+    prewarming_ = false;
+  }
+
+  // Requests a controller. |callback| runs synchronously when an idle
+  // controller is available and otherwise once one has been created; it
+  // receives an empty controller if creation fails. The returned id can be
+  // passed to |CancelClaim| while the claim is outstanding.
+  ClaimId Claim(ClaimCallback callback) {
+    ClaimId id = next_claim_id_++;
+    Clock::time_point start = Clock::now();
+    if (!idle_.empty()) {
+      ++stats_.hits;
+      // The most recently returned controller is the one most likely to
+      // still be warm; older ones are left to age out.
+      Controller controller = std::move(idle_.back().controller);
+      idle_.pop_back();
+      RecordLatency(start);
+      callback(std::move(controller));
+      Prewarm();
+      return id;
+    }
+    ++stats_.misses;
+    bool covered = Surplus() > 0;
+    waiters_.push_back(Waiter{id, start, std::move(callback)});
+    if (!covered) {
+      StartCreation();
+    }
+    return id;
+  }
+
+  // Abandons an outstanding claim. Returns false if it was already satisfied.
+  bool CancelClaim(ClaimId id) {
+    for (auto it = waiters_.begin(); it != waiters_.end(); ++it) {
+      if (it->id == id) {
+        waiters_.erase(it);
+        ++stats_.cancelled;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Hands |controller| back to the pool, which passes it to the oldest
+  // waiting claim, keeps it idle, or disposes of it when the pool is full.
+  // The caller must have detached it from its view first.
+  void Return(Controller controller) {
+    if (!controller) {
+      return;
+    }
+    Offer(std::move(controller));
+  }
+
+  // Disposes of idle controllers beyond |warm_count| that have been idle
+  // for at least |max_idle_time| as of |now|. Returns how many were evicted.
+  size_t EvictIdle(Clock::time_point now) {
+    if (options_.max_idle_time.count() == 0) {
+      return 0;
+    }
+    // |idle_| is ordered by return time, so the oldest are at the front.
+    size_t evicted = 0;
+    while (idle_.size() > options_.warm_count &&
+           now - idle_.front().since >= options_.max_idle_time) {
+      Controller controller = std::move(idle_.front().controller);
+      idle_.erase(idle_.begin());
+      ++stats_.destroyed;
+      ++stats_.evicted;
+      ++evicted;
+      source_->DestroyController(std::move(controller));
+    }
+    return evicted;
+  }
+
+  // Returns when |EvictIdle| next has something to do, or nullopt if no
+  // idle controller is eligible for eviction.
+  std::optional<Clock::time_point> NextEvictionTime() const {
+    if (options_.max_idle_time.count() == 0 ||
+        idle_.size() <= options_.warm_count) {
+      return std::nullopt;
+    }
+    return idle_.front().since + options_.max_idle_time;
+  }
+
+  // Disposes of every idle controller. Outstanding claims are kept.
+  void Clear() {
+    for (IdleController& idle : idle_) {
+      ++stats_.destroyed;
+      source_->DestroyController(std::move(idle.controller));
+    }
+    idle_.clear();
+  }
+
+  size_t idle_count() const { return idle_.size(); }
+  size_t pending_count() const { return pending_; }
+  size_t waiting_count() const { return waiters_.size(); }
+  const ControllerPoolStats& stats() const { return stats_; }
+
+ private:
+  struct Waiter {
+    ClaimId id;
+    Clock::time_point start;
+    ClaimCallback callback;
+  };
+
+  struct IdleController {
+    Controller controller;
+    // When the controller became idle.
+    Clock::time_point since;
+  };
+
+  // In-flight creations not already earmarked for a waiting claim.
+  size_t Surplus() const {
+    return pending_ > waiters_.size() ? pending_ - waiters_.size() : 0;
+  }
+
+  void StartCreation() {
+    ++pending_;
+    std::weak_ptr<bool> alive = alive_;
+    source_->CreateController([this, alive](Controller controller) {
+      if (alive.expired()) {
+        // The pool was destroyed while the creation was in flight; dropping
+        // the controller releases it.
+        return;
+      }
+      --pending_;
+      if (!controller) {
+        ++stats_.creation_failures;
+        FailOneWaiter();
+        return;
+      }
+      ++stats_.created;
+      Offer(std::move(controller));
+    });
+  }
+
+  void Offer(Controller controller) {
+    if (!waiters_.empty()) {
+      Waiter waiter = std::move(waiters_.front());
+      waiters_.pop_front();
+      RecordLatency(waiter.start);
+      waiter.callback(std::move(controller));
+    } else if (idle_.size() < options_.idle_capacity) {
+      idle_.push_back(IdleController{std::move(controller), Clock::now()});
+    } else {
+      ++stats_.destroyed;
+      source_->DestroyController(std::move(controller));
+    }
+    Prewarm();
+  }
+
+  // Fails the oldest waiter that is not covered by another in-flight
+  // creation, so a failed creation never strands a claim.
+  void FailOneWaiter() {
+    if (waiters_.size() <= pending_) {
+      return;
+    }
+    Waiter waiter = std::move(waiters_.front());
+    waiters_.pop_front();
+    waiter.callback(Controller());
+  }
+
+  void RecordLatency(Clock::time_point start) {
+    std::chrono::nanoseconds latency = Clock::now() - start;
+    ++stats_.claims_satisfied;
+    stats_.total_claim_latency += latency;
+    if (latency > stats_.max_claim_latency) {
+      stats_.max_claim_latency = latency;
+    }
+  }
+
+  ControllerSource<Controller>* source_;
+  Options options_;
+  std::vector<IdleController> idle_;
+  std::deque<Waiter> waiters_;
+  size_t pending_ = 0;
+  ClaimId next_claim_id_ = 1;
+  bool prewarming_ = false;
+  ControllerPoolStats stats_;
+  // Expires with the pool so late creation callbacks can detect it.
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+};
+
+#endif  // RUNNER_CONTROLLER_POOL_H_
@@ -0,0 +1,166 @@
+#include "coroutine.h"
+
+#include <algorithm>
+#include <new>
+
+namespace coroutine_internal {
+
+struct CancellationState {
+  bool cancelled = false;
+  uint64_t next_id = 1;
+  std::vector<std::pair<uint64_t, std::function<void()>>> callbacks;
+};
+
+namespace {
+
+// Blocks are pooled in size classes of this many bytes, up to
+// |kSizeClasses| of them; frames of the runner's tasks are a few hundred
+// bytes.
+constexpr size_t kSizeClassBytes = 64;
+constexpr size_t kSizeClasses = 16;
+
+// Free blocks kept per size class. Beyond this blocks go back to the heap,
+// bounding what a burst of tasks leaves behind.
+constexpr size_t kMaxFreeBlocks = 64;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+class FramePool {
+ public:
+  FramePool() = default;
+  ~FramePool() {
+    for (FreeBlock* block : free_lists_) {
+      while (block) {
+        FreeBlock* next = block->next;
+        ::operator delete(block);
+        block = next;
+      }
+    }
+  }
+
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  void* Allocate(size_t size) {
+    ++stats_.allocations;
+    size_t size_class = SizeClass(size);
+    if (size_class >= kSizeClasses) {
+      ++stats_.oversized;
+      return ::operator new(size);
+    }
+    if (FreeBlock* block = free_lists_[size_class]) {
+      free_lists_[size_class] = block->next;
+      --free_counts_[size_class];
+      ++stats_.reused;
+      return block;
+    }
+    return ::operator new((size_class + 1) * kSizeClassBytes);
+  }
+
+  void Free(void* frame, size_t size) {
+    size_t size_class = SizeClass(size);
+    if (size_class >= kSizeClasses ||
+        free_counts_[size_class] == kMaxFreeBlocks) {
+      ::operator delete(frame);
+      return;
+    }
+    FreeBlock* block = static_cast<FreeBlock*>(frame);
+    block->next = free_lists_[size_class];
+    free_lists_[size_class] = block;
+    ++free_counts_[size_class];
+  }
+
+  const CoroutineFramePoolStats& stats() const { return stats_; }
+
+ private:
+  static size_t SizeClass(size_t size) {
+    return size == 0 ? 0 : (size - 1) / kSizeClassBytes;
+  }
+
+  FreeBlock* free_lists_[kSizeClasses] = {};
+  size_t free_counts_[kSizeClasses] = {};
+  CoroutineFramePoolStats stats_;
+};
+
+FramePool& ThreadPool() {
+  thread_local FramePool pool;
+  return pool;
+}
+
+}  // namespace
+
+void* AllocateFrame(size_t size) {
+  return ThreadPool().Allocate(size);
+}
+
+void FreeFrame(void* frame, size_t size) {
+  ThreadPool().Free(frame, size);
+}
+
+}  // namespace coroutine_internal
+
+CoroutineFramePoolStats GetCoroutineFramePoolStats() {
+  return coroutine_internal::ThreadPool().stats();
+}
+
+void CancellationRegistration::Reset() {
+  std::shared_ptr<coroutine_internal::CancellationState> state =
+      state_.lock();
+  state_.reset();
+  if (!state) {
+    return;
+  }
+  auto& callbacks = state->callbacks;
+  auto it = std::find_if(callbacks.begin(), callbacks.end(),
+                         [this](const auto& entry) {
+                           return entry.first == id_;
+                         });
+  if (it != callbacks.end()) {
+    callbacks.erase(it);
+  }
+}
+
+bool CancellationToken::cancelled() const {
+  return state_ && state_->cancelled;
+}
+
+CancellationRegistration CancellationToken::OnCancel(
+    std::function<void()> callback) const {
+  if (!state_) {
+    return CancellationRegistration();
+  }
+  if (state_->cancelled) {
+    callback();
+    return CancellationRegistration();
+  }
+  uint64_t id = state_->next_id++;
+  state_->callbacks.emplace_back(id, std::move(callback));
+  return CancellationRegistration(state_, id);
+}
+
+CancellationSource::CancellationSource()
+    : state_(std::make_shared<coroutine_internal::CancellationState>()) {}
+
+void CancellationSource::Cancel() {
+  if (state_->cancelled) {
+    return;
+  }
+  state_->cancelled = true;
+  // Held in case a resumed task destroys this source. Callbacks are taken
+  // one at a time, since one may unregister those after it: resuming a
+  // task can complete another's operation. Callbacks registered from now
+  // on run immediately.
+  std::shared_ptr<coroutine_internal::CancellationState> state = state_;
+  auto& callbacks = state->callbacks;
+  while (!callbacks.empty()) {
+    std::function<void()> callback = std::move(callbacks.front().second);
+    callbacks.erase(callbacks.begin());
+    callback();
+  }
+}
+
+bool CancellationSource::cancelled() const {
+  return state_->cancelled;
+}
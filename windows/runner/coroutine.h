@@ -0,0 +1,483 @@
+#ifndef RUNNER_COROUTINE_H_
+#define RUNNER_COROUTINE_H_
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "task_scheduler.h"
+
+// C++20 coroutines for the runner's asynchronous work.
+//
+// Operations that complete through callbacks (creating a controller,
+// running a script, a timer) are wrapped with |Async| and awaited, so a
+// sequence of them reads top to bottom:
+//
+//   Task<> LoadPage(WebViewBackend* backend, WebViewSink* sink) {
+//     std::optional<WebViewSurface> surface =
+//         co_await CreateControllerAsync(backend);
+//     if (!surface || !*surface) {
+//       co_return;  // Cancelled, or creation failed.
+//     }
+//     (*surface)->Navigate(u"https://example.com/");
+//     co_await Delay(std::chrono::seconds(1));
+//     ...
+//   }
+//
+//   Spawn(LoadPage(backend, sink), {scheduler, cancellation.token()});
+//
+// A |Task| starts when it is awaited or spawned, and runs on the thread
+// that resumes it: the one completing the operation it awaits, or the
+// scheduler's for |Yield| and |Delay|. Each task carries a |TaskContext|,
+// which tasks it awaits inherit. Cancelling the context's token resumes
+// every operation the task tree is awaiting at once, with an empty result,
+// and makes later ones return empty without starting; the task decides
+// how to wind down. Everything related to one task tree must happen on one
+// thread.
+//
+// Frames and operation state come from a per-thread pool of recycled
+// blocks, so a steady stream of tasks stops allocating once the pool is
+// warm. Exceptions are not supported: one escaping a coroutine terminates.
+
+// Counters of the calling thread's frame pool.
+struct CoroutineFramePoolStats {
+  // Blocks handed out, pooled or not.
+  uint64_t allocations = 0;
+  // Allocations served from a free list.
+  uint64_t reused = 0;
+  // Allocations too large to pool, served by the heap.
+  uint64_t oversized = 0;
+};
+
+CoroutineFramePoolStats GetCoroutineFramePoolStats();
+
+namespace coroutine_internal {
+
+// Returns a block of at least |size| bytes from the calling thread's pool.
+void* AllocateFrame(size_t size);
+
+// Returns |frame|, allocated with |size|, to the calling thread's pool.
+void FreeFrame(void* frame, size_t size);
+
+// Shared by a |CancellationSource| and its tokens.
+struct CancellationState;
+
+}  // namespace coroutine_internal
+
+// Unregisters a cancellation callback when destroyed.
+class CancellationRegistration {
+ public:
+  CancellationRegistration() = default;
+  ~CancellationRegistration() { Reset(); }
+
+  CancellationRegistration(CancellationRegistration&& other) noexcept
+      : state_(std::move(other.state_)), id_(other.id_) {}
+  CancellationRegistration& operator=(
+      CancellationRegistration&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      state_ = std::move(other.state_);
+      id_ = other.id_;
+    }
+    return *this;
+  }
+
+  // Unregisters the callback, unless it already ran.
+  void Reset();
+
+ private:
+  friend class CancellationToken;
+
+  CancellationRegistration(
+      std::weak_ptr<coroutine_internal::CancellationState> state,
+      uint64_t id)
+      : state_(std::move(state)), id_(id) {}
+
+  std::weak_ptr<coroutine_internal::CancellationState> state_;
+  uint64_t id_ = 0;
+};
+
+// Observes a |CancellationSource|. A default-constructed token is never
+// cancelled.
+class CancellationToken {
+ public:
+  CancellationToken() = default;
+
+  bool cancelled() const;
+
+  // Runs |callback| when the source is cancelled, or now if it already
+  // was, until the returned registration is destroyed.
+  [[nodiscard]] CancellationRegistration OnCancel(
+      std::function<void()> callback) const;
+
+ private:
+  friend class CancellationSource;
+
+  explicit CancellationToken(
+      std::shared_ptr<coroutine_internal::CancellationState> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<coroutine_internal::CancellationState> state_;
+};
+
+// Cancels the tasks holding its tokens.
+class CancellationSource {
+ public:
+  CancellationSource();
+
+  CancellationSource(const CancellationSource&) = delete;
+  CancellationSource& operator=(const CancellationSource&) = delete;
+
+  CancellationToken token() const { return CancellationToken(state_); }
+
+  // Runs the registered callbacks, in the order they were registered.
+  // Later calls do nothing.
+  void Cancel();
+
+  bool cancelled() const;
+
+ private:
+  std::shared_ptr<coroutine_internal::CancellationState> state_;
+};
+
+// Where a task runs: the scheduler |Yield| and |Delay| post to, and the
+// token that cancels it.
+struct TaskContext {
+  TaskScheduler* scheduler = nullptr;
+  CancellationToken token;
+};
+
+template <typename T = void>
+class Task;
+
+namespace coroutine_internal {
+
+class PromiseBase {
+ public:
+  static void* operator new(size_t size) { return AllocateFrame(size); }
+  static void operator delete(void* frame, size_t size) {
+    FreeFrame(frame, size);
+  }
+
+  // Resumes whoever awaited the task, or destroys a detached task's frame.
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      PromiseBase& promise = handle.promise();
+      std::coroutine_handle<> continuation = promise.continuation_;
+      if (promise.detached_) {
+        handle.destroy();
+      }
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() noexcept { std::terminate(); }
+
+  const TaskContext& context() const { return context_; }
+
+  // Runs the task with |context|, resuming |continuation| when it finishes.
+  void Bind(std::coroutine_handle<> continuation,
+            const TaskContext& context) {
+    continuation_ = continuation;
+    context_ = context;
+  }
+
+  // Runs the task with |context|, freeing its frame when it finishes.
+  void Detach(TaskContext context) {
+    context_ = std::move(context);
+    detached_ = true;
+  }
+
+ private:
+  std::coroutine_handle<> continuation_;
+  TaskContext context_;
+  bool detached_ = false;
+};
+
+template <typename T>
+class Promise : public PromiseBase {
+ public:
+  Task<T> get_return_object();
+
+  template <typename U>
+  void return_value(U&& value) {
+    value_.emplace(std::forward<U>(value));
+  }
+
+  T TakeValue() { return std::move(*value_); }
+
+ private:
+  std::optional<T> value_;
+};
+
+template <>
+class Promise<void> : public PromiseBase {
+ public:
+  Task<void> get_return_object();
+  void return_void() {}
+  void TakeValue() {}
+};
+
+}  // namespace coroutine_internal
+
+// A coroutine producing a |T|. It starts when awaited, with the awaiting
+// task's context, or when passed to |Spawn|. A task must not be destroyed
+// while it is suspended, only before it starts or after it finishes.
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = coroutine_internal::Promise<T>;
+
+  Task() = default;
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  template <typename CallerPromise>
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<CallerPromise> caller) noexcept {
+    handle_.promise().Bind(caller, caller.promise().context());
+    return handle_;
+  }
+
+  T await_resume() { return handle_.promise().TakeValue(); }
+
+ private:
+  friend void Spawn(Task<void> task, TaskContext context);
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+Task<T> coroutine_internal::Promise<T>::get_return_object() {
+  return Task<T>(
+      std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> coroutine_internal::Promise<void>::get_return_object() {
+  return Task<void>(
+      std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// Runs |task| with |context| on the calling thread until it first
+// suspends. From then on the task owns itself and frees its frame when it
+// finishes.
+inline void Spawn(Task<void> task, TaskContext context) {
+  std::coroutine_handle<Task<void>::promise_type> handle =
+      std::exchange(task.handle_, {});
+  handle.promise().Detach(std::move(context));
+  handle.resume();
+}
+
+template <typename T>
+class Resolver;
+
+namespace coroutine_internal {
+
+// The state of one awaited |Async| operation, shared by the awaiter and
+// the operation's resolvers.
+template <typename T>
+struct AsyncSlot {
+  static void* operator new(size_t size) { return AllocateFrame(size); }
+  static void operator delete(void* slot, size_t size) {
+    FreeFrame(slot, size);
+  }
+
+  // Stores |result| and resumes the awaiting coroutine if it is suspended,
+  // unless the operation already completed.
+  void Complete(std::optional<T> result) {
+    if (done) {
+      return;
+    }
+    done = true;
+    value = std::move(result);
+    cancellation.Reset();
+    if (suspended) {
+      // May free this slot.
+      waiter.resume();
+    }
+  }
+
+  // Frees the slot once neither the awaiter nor any resolver refers to it.
+  void MaybeDelete() {
+    if (resolvers == 0 && !awaited) {
+      delete this;
+    }
+  }
+
+  uint32_t resolvers = 0;
+  bool awaited = true;
+  bool done = false;
+  // Whether the awaiter suspended; an operation completing while it
+  // starts does not resume it.
+  bool suspended = false;
+  std::coroutine_handle<> waiter;
+  std::optional<T> value;
+  CancellationRegistration cancellation;
+};
+
+}  // namespace coroutine_internal
+
+// Completes an |Async| operation. Copies share the operation; the first
+// call completes it and later ones are ignored, as are calls after the
+// awaiting task was cancelled. If every copy is destroyed without being
+// called, the operation completes empty, so callbacks that are dropped
+// rather than invoked do not strand the task.
+template <typename T>
+class Resolver {
+ public:
+  explicit Resolver(coroutine_internal::AsyncSlot<T>* slot) : slot_(slot) {
+    ++slot_->resolvers;
+  }
+  ~Resolver() { Release(); }
+
+  Resolver(const Resolver& other) : slot_(other.slot_) {
+    if (slot_) {
+      ++slot_->resolvers;
+    }
+  }
+  Resolver(Resolver&& other) noexcept
+      : slot_(std::exchange(other.slot_, nullptr)) {}
+  Resolver& operator=(Resolver other) noexcept {
+    std::swap(slot_, other.slot_);
+    return *this;
+  }
+
+  void operator()(T value) const { slot_->Complete(std::move(value)); }
+
+ private:
+  void Release() {
+    if (!slot_) {
+      return;
+    }
+    // Completing first keeps the count up while the awaiter resumes, so
+    // the slot is not freed under it.
+    if (slot_->resolvers == 1) {
+      slot_->Complete(std::nullopt);
+    }
+    --slot_->resolvers;
+    slot_->MaybeDelete();
+    slot_ = nullptr;
+  }
+
+  coroutine_internal::AsyncSlot<T>* slot_ = nullptr;
+};
+
+// Awaits the operation started by |start|; see |Async|.
+template <typename T, typename Start>
+class AsyncAwaiter {
+ public:
+  explicit AsyncAwaiter(Start start) : start_(std::move(start)) {}
+  ~AsyncAwaiter() {
+    if (slot_) {
+      slot_->awaited = false;
+      slot_->MaybeDelete();
+    }
+  }
+
+  AsyncAwaiter(const AsyncAwaiter&) = delete;
+  AsyncAwaiter& operator=(const AsyncAwaiter&) = delete;
+
+  bool await_ready() const noexcept { return false; }
+
+  template <typename Promise>
+  bool await_suspend(std::coroutine_handle<Promise> handle) {
+    const TaskContext& context = handle.promise().context();
+    slot_ = new coroutine_internal::AsyncSlot<T>();
+    if (context.token.cancelled()) {
+      slot_->done = true;
+      return false;
+    }
+    slot_->waiter = handle;
+    slot_->cancellation = context.token.OnCancel(
+        [slot = slot_] { slot->Complete(std::nullopt); });
+    if constexpr (std::is_invocable_v<Start&, Resolver<T>,
+                                      const TaskContext&>) {
+      start_(Resolver<T>(slot_), context);
+    } else {
+      start_(Resolver<T>(slot_));
+    }
+    if (slot_->done) {
+      return false;
+    }
+    slot_->suspended = true;
+    return true;
+  }
+
+  std::optional<T> await_resume() { return std::move(slot_->value); }
+
+ private:
+  Start start_;
+  coroutine_internal::AsyncSlot<T>* slot_ = nullptr;
+};
+
+// Returns an awaitable that calls |start(Resolver<T>)|, or
+// |start(Resolver<T>, const TaskContext&)|, to start an operation, and
+// evaluates to the |T| it is resolved with. It evaluates to an empty
+// optional, without suspending if need be, when the task is cancelled
+// first or every resolver is dropped. |start| runs when the task awaits,
+// and not at all if it is already cancelled; it may resolve before
+// returning.
+//
+//   std::optional<bool> suspended = co_await Async<bool>(
+//       [controller](Resolver<bool> resolve) {
+//         controller->TrySuspend(resolve);
+//       });
+template <typename T, typename Start>
+AsyncAwaiter<T, Start> Async(Start start) {
+  return AsyncAwaiter<T, Start>(std::move(start));
+}
+
+// Lets the scheduler run other work before the task continues, at
+// |priority|. Evaluates to true, or to nothing if the task was cancelled
+// meanwhile.
+inline auto Yield(TaskPriority priority = TaskPriority::kNormal) {
+  return Async<bool>(
+      [priority](Resolver<bool> resolve, const TaskContext& context) {
+        context.scheduler->PostTask([resolve] { resolve(true); }, priority);
+      });
+}
+
+// Continues the task after |delay|. Evaluates to true, or to nothing as
+// soon as the task is cancelled if that happens first.
+inline auto Delay(TaskScheduler::Clock::duration delay) {
+  return Async<bool>(
+      [delay](Resolver<bool> resolve, const TaskContext& context) {
+        context.scheduler->PostDelayedTask([resolve] { resolve(true); },
+                                           delay);
+      });
+}
+
+#endif  // RUNNER_COROUTINE_H_
@@ -1,263 +1,1652 @@
-#include "flutter_window.h"
-
-#include <iostream>
-#include <optional>
-
-#include "windows.h"
-#include "wrl.h"
-#include "wil/com.h"
-#include "WebView2.h"
-
-#include "flutter/generated_plugin_registrant.h"
-
-FlutterWindow::FlutterWindow(const flutter::DartProject& project)
-    : project_(project) {}
-
-FlutterWindow::~FlutterWindow() {}
-
-static wil::com_ptr<ICoreWebView2Controller> webviewController;
-static wil::com_ptr<ICoreWebView2> webview;
-static LRESULT CALLBACK WebViewWndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
-  switch (msg) {
-    case WM_CREATE: {
-      CREATESTRUCT* pars = (CREATESTRUCT*)lparam;
-      void* user_data = pars->lpCreateParams;
-      SetWindowLongPtr(hwnd, 0, (LONG_PTR)user_data);
-      return DefWindowProc(hwnd, msg, wparam, lparam);
-    }
-    case WM_SIZE:
-      if (webviewController != nullptr) {
-        RECT bounds;
-        GetClientRect(hwnd, &bounds);
-				std::cerr << "Bounds: (" << bounds.left << "," << bounds.top << ") to (" << bounds.right << "," << bounds.bottom << ")\n";
-        webviewController->put_Bounds(bounds);
-      }
-      break;
-    case WM_DESTROY:
-      webviewController = nullptr;
-      webview = nullptr;
-      break;
-    case WM_SETFOCUS: {
-      std::cerr << "Platform view window gained focus\n";
-      if (webviewController != nullptr) {
-        flutter::FlutterViewController* window = (flutter::FlutterViewController*)GetWindowLongPtr(hwnd, 0);
-        int reason = window->engine()->QueryFocusReason();
-        webviewController->MoveFocus(static_cast<COREWEBVIEW2_MOVE_FOCUS_REASON>(reason));
-      }
-      break;
-    }
-    case WM_KILLFOCUS: {
-      std::cerr << "Kill focus\n";
-      break;
-    }
-    default:
-      return DefWindowProc(hwnd, msg, wparam, lparam);
-  }
-  return 0;
-}
-
-bool FlutterWindow::OnCreate() {
-  if (!Win32Window::OnCreate()) {
-    return false;
-  }
-
-  RECT frame = GetClientArea();
-
-  // The size here must match the window dimensions to avoid unnecessary surface
-  // creation / destruction in the startup path.
-  flutter_controller_ = std::make_unique<flutter::FlutterViewController>(
-      frame.right - frame.left, frame.bottom - frame.top, project_);
-  // Ensure that basic setup of the controller was successful.
-  if (!flutter_controller_->engine() || !flutter_controller_->view()) {
-    return false;
-  }
-  RegisterPlugins(flutter_controller_->engine());
-  SetChildContent(flutter_controller_->view()->GetNativeWindow());
-
-  // Register webview class
-  WNDCLASSEX wnd;
-  wnd.cbSize = sizeof(wnd);
-  wnd.lpszClassName = L"Webview";
-  wnd.hIconSm = NULL;
-  wnd.cbClsExtra = 0;
-  wnd.cbWndExtra = sizeof(void*) * 1;
-  wnd.lpszMenuName = NULL;
-  wnd.hIcon = NULL;
-  wnd.hCursor = NULL;
-  wnd.hInstance = GetModuleHandle(nullptr);
-  wnd.style = CS_HREDRAW | CS_VREDRAW;
-  wnd.hbrBackground = (HBRUSH)(COLOR_HIGHLIGHT + 1);
-  wnd.lpfnWndProc = WebViewWndProc;
-
-  std::cerr << "Register window class returns " << RegisterClassEx(&wnd) << "\n";
-
-  flutter_controller_->engine()->RegisterPlatformViewType("test", [](const PlatformViewCreationParams* params) {
-    flutter::FlutterViewController* view_controller = (flutter::FlutterViewController*)params->user_data;
-    HWND hWnd = CreateWindow(L"Webview", L"testwebview", WS_VISIBLE | WS_CHILD, 0, 0, 800, 800, params->parent, NULL, NULL, (LPVOID)view_controller);
-    std::cerr << "Creating platform view #" << hWnd << " with parent " << params->parent << "\n";
-    RECT rect;
-    GetClientRect(params->parent, &rect);
-    std::cerr << "Parent is " << rect.right << " x " << rect.bottom << "\n";
-
-    if (webviewController == nullptr) {
-      std::cerr << "Creating webview controller\n";
-      CreateCoreWebView2EnvironmentWithOptions(nullptr, nullptr, nullptr,
-		    Microsoft::WRL::Callback<ICoreWebView2CreateCoreWebView2EnvironmentCompletedHandler>(
-			    [hWnd, view_controller](HRESULT result, ICoreWebView2Environment* env) -> HRESULT {
-
-            std::cerr << "Creation callback\n";
-				    // Create a CoreWebView2Controller and get the associated CoreWebView2 whose parent is the main window hWnd
-				    env->CreateCoreWebView2Controller(hWnd, Microsoft::WRL::Callback<ICoreWebView2CreateCoreWebView2ControllerCompletedHandler>(
-					    [hWnd, view_controller](HRESULT result, ICoreWebView2Controller* controller) -> HRESULT {
-                std::cerr << "Create core callback\n";
-						    if (controller != nullptr) {
-                  std::cerr << "Assigning controller\n";
-							    webviewController = controller;
-							    webviewController->get_CoreWebView2(&webview);
-						    }
-
-						    // Add a few settings for the webview
-						    // The demo step is redundant since the values are the default settings
-						    wil::com_ptr<ICoreWebView2Settings> settings;
-						    webview->get_Settings(&settings);
-						    settings->put_IsScriptEnabled(TRUE);
-						    settings->put_AreDefaultScriptDialogsEnabled(TRUE);
-						    settings->put_IsWebMessageEnabled(TRUE);
-
-						    // Resize WebView to fit the bounds of the parent window
-						    RECT bounds;
-						    GetClientRect(hWnd, &bounds);
-						    std::cerr << "Bounds: (" << bounds.left << "," << bounds.top << ") to (" << bounds.right << "," << bounds.bottom << ")\n";
-						    webviewController->put_Bounds(bounds);
-
-						    // Schedule an async task to navigate to Bing
-						    webview->Navigate(L"https://www.google.com/");
-
-						    // <NavigationEvents>
-						    // Step 4 - Navigation events
-						    // register an ICoreWebView2NavigationStartingEventHandler to cancel any non-https navigation
-						    EventRegistrationToken token;
-						    webview->add_NavigationStarting(Microsoft::WRL::Callback<ICoreWebView2NavigationStartingEventHandler>(
-							    [](ICoreWebView2* webview_, ICoreWebView2NavigationStartingEventArgs* args) -> HRESULT {
-                    std::cerr << "Navigation starting\n";
-								    wil::unique_cotaskmem_string uri;
-								    args->get_Uri(&uri);
-								    std::wstring source(uri.get());
-								    if (source.substr(0, 5) != L"https") {
-									    std::cerr << "Canceled\n";
-									    args->put_Cancel(true);
-								    } else std::cerr << "Not canceled\n";
-								    return S_OK;
-							    }).Get(), &token);
-						    // </NavigationEvents>
-
-						    // <Scripting>
-						    // Step 5 - Scripting
-						    // Schedule an async task to add initialization script that freezes the Object object
-						    // webview->AddScriptToExecuteOnDocumentCreated(L"Object.freeze(Object);", nullptr);
-						    // Schedule an async task to get the document URL
-						    webview->ExecuteScript(L"window.document.URL;", Microsoft::WRL::Callback<ICoreWebView2ExecuteScriptCompletedHandler>(
-							    [](HRESULT errorCode, LPCWSTR resultObjectAsJson) -> HRESULT {
-								    LPCWSTR URL = resultObjectAsJson;
-                    int len = WideCharToMultiByte(CP_UTF8, 0, URL, -1, NULL, 0, NULL, NULL);
-                    char *s = new char[len];
-                    WideCharToMultiByte(CP_UTF8, 0, URL, -1, s, len, NULL, NULL);
-                    std::cerr << "Got URL: " << std::string(s) << "\n";
-                    delete[] s;
-								    return S_OK;
-							    }).Get());
-						    // </Scripting>
-
-						    // <CommunicationHostWeb>
-						    // Step 6 - Communication between host and web content
-						    // Set an event handler for the host to return received message back to the web content
-						    webview->add_WebMessageReceived(Microsoft::WRL::Callback<ICoreWebView2WebMessageReceivedEventHandler>(
-							    [](ICoreWebView2* webview_, ICoreWebView2WebMessageReceivedEventArgs* args) -> HRESULT {
-								    std::cerr << "Web message received\n";
-								    wil::unique_cotaskmem_string message;
-								    args->TryGetWebMessageAsString(&message);
-								    // processMessage(&message);
-								    webview_->PostWebMessageAsString(message.get());
-								    return S_OK;
-							    }).Get(), &token);
-
-						    // Schedule an async task to add initialization script that
-						    // 1) Add an listener to print message from the host
-						    // 2) Post document URL to the host
-						    webview->AddScriptToExecuteOnDocumentCreated(
-							    L"window.chrome.webview.addEventListener(\'message\', event => alert(event.data));" \
-							    L"window.chrome.webview.postMessage(window.document.URL);",
-							    nullptr);
-						    // </CommunicationHostWeb>
-
-
-                webviewController->add_MoveFocusRequested(Microsoft::WRL::Callback<ICoreWebView2MoveFocusRequestedEventHandler>([hWnd, view_controller](ICoreWebView2Controller* sender, ICoreWebView2MoveFocusRequestedEventArgs* args){
-                  COREWEBVIEW2_MOVE_FOCUS_REASON reason;
-                  args->get_Reason(&reason);
-                  std::cerr << "Moving focus from webview with reason " << reason << "\n";
-                  view_controller->engine()->SendTabOut(hWnd, reason);
-                  return S_OK;
-                }).Get(), &token);
-
-                webviewController->add_GotFocus(Microsoft::WRL::Callback<ICoreWebView2FocusChangedEventHandler>([hWnd](ICoreWebView2Controller* sender, IUnknown* args){
-                  // This could probably be a method in FlutterViewController instead.
-                  ::SendMessage(GetParent(hWnd), WM_KILLFOCUS, (WPARAM)hWnd, NULL);
-                  return S_OK;
-                }).Get(), &token);
-
-						    return S_OK;
-					    }).Get());
-				    return S_OK;
-			    }).Get());
-    }
-
-    /*UpdateWindow(hWnd);
-    auto style = GetWindowLong(params->parent, GWL_STYLE);
-    style |= WS_CLIPCHILDREN | WS_TABSTOP;
-    SetWindowLong(params->parent, GWL_STYLE, style);
-    UpdateWindow(params->parent);*/
-    return hWnd;
-  }, (void*)flutter_controller_.get());
-
-  flutter_controller_->engine()->SetNextFrameCallback([&]() {
-    this->Show();
-  });
-
-  // Flutter can complete the first frame before the "show window" callback is
-  // registered. The following call ensures a frame is pending to ensure the
-  // window is shown. It is a no-op if the first frame hasn't completed yet.
-  flutter_controller_->ForceRedraw();
-
-  return true;
-}
-
-void FlutterWindow::OnDestroy() {
-  if (flutter_controller_) {
-    flutter_controller_ = nullptr;
-  }
-
-  Win32Window::OnDestroy();
-}
-
-LRESULT
-FlutterWindow::MessageHandler(HWND hwnd, UINT const message,
-                              WPARAM const wparam,
-                              LPARAM const lparam) noexcept {
-  // Give Flutter, including plugins, an opportunity to handle window messages.
-  if (flutter_controller_) {
-    std::optional<LRESULT> result =
-        flutter_controller_->HandleTopLevelWindowProc(hwnd, message, wparam,
-                                                      lparam);
-    if (result) {
-      return *result;
-    }
-  }
-
-  switch (message) {
-    case WM_FONTCHANGE:
-      flutter_controller_->engine()->ReloadSystemFonts();
-      break;
-  }
-
-  return Win32Window::MessageHandler(hwnd, message, wparam, lparam);
-}
+#include "flutter_window.h"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <flutter/binary_messenger.h>
+#include <flutter/encodable_value.h>
+#include <flutter/method_channel.h>
+#include <flutter/standard_method_codec.h>
+
+#include "windows.h"
+
+#include "asset_pack.h"
+#include "bounds_coalescer.h"
+#include "flutter/generated_plugin_registrant.h"
+#include "focus_graph.h"
+#include "geometry_transaction.h"
+#include "logging.h"
+#include "mapped_file.h"
+#include "metrics.h"
+#include "navigation_policy.h"
+#include "occlusion_tracker.h"
+#include "pixel_pipeline.h"
+#include "platform_view_registry.h"
+#include "region.h"
+#include "rpc_router.h"
+#include "script_batcher.h"
+#include "standard_codec.h"
+#include "trace.h"
+#include "utf_transcoder.h"
+#include "utils.h"
+#include "view_lifecycle.h"
+#include "view_recovery.h"
+#include "web_message_channel.h"
+#include "web_view_backend.h"
+#include "web_view_creation_params.h"
+#include "web_view_texture.h"
+#include "webview_environment.h"
+
+namespace {
+
+// Timer used to flush coalesced bounds changes, and how often it fires while
+// changes are pending. The interval approximates one display frame.
+constexpr UINT_PTR kBoundsFlushTimerId = 1;
+constexpr UINT kBoundsFlushIntervalMs = 16;
+
+// Timer used to post batched host-to-web messages, once per frame.
+constexpr UINT_PTR kMessageFlushTimerId = 2;
+constexpr UINT kMessageFlushIntervalMs = 16;
+
+// Timer used to send batched script calls, once per frame.
+constexpr UINT_PTR kScriptFlushTimerId = 3;
+constexpr UINT kScriptFlushIntervalMs = 16;
+
+// Timer used to capture a texture view's page, once per frame.
+constexpr UINT_PTR kCaptureTimerId = 4;
+constexpr UINT kCaptureIntervalMs = 16;
+
+// Batched message channel that echoes every payload back to the page.
+constexpr WebMessageChannelId kEchoChannel = 0;
+
+// The host end of a view's batched message channel.
+struct WebViewMessageChannel {
+  explicit WebViewMessageChannel(WebViewController* controller)
+      : transport(controller), batcher(&transport) {}
+
+  WebViewMessageTransport transport;
+  WebMessageBatcher batcher;
+  WebMessageDispatcher dispatcher;
+};
+
+// The host end of a view's batched script calls.
+struct WebViewScripts {
+  explicit WebViewScripts(WebViewController* controller)
+      : engine(controller), batcher(&engine, ScriptBatcher::Options()) {}
+
+  WebViewScriptEngine engine;
+  ScriptBatcher batcher;
+};
+
+// A "test" platform view: the child window handed to the engine and the
+// recycled web view surface attached to it once the pool provides one.
+struct WebViewPlatformView {
+  HWND hwnd = nullptr;
+  flutter::FlutterViewController* view_controller = nullptr;
+  WebViewSurface surface;
+
+  // Collapses WM_SIZE bursts into at most one put_Bounds per frame.
+  BoundsCoalescer bounds_coalescer;
+
+  // Batched messaging with the page, while a controller is attached.
+  std::unique_ptr<WebViewMessageChannel> messages;
+
+  // Batched script calls, while a controller is attached.
+  std::unique_ptr<WebViewScripts> scripts;
+
+  // Whether a task to time out overdue script calls is pending, and when it
+  // runs. At most one is kept per view; see |ScheduleScriptTimeout|.
+  bool script_timeout_pending = false;
+  ScriptBatcher::Clock::time_point script_timeout_at;
+
+  // The page to reload when a discarded view is restored.
+  std::u16string restore_url;
+
+  // The page the view last finished loading, which a replacement for a
+  // failed controller reloads.
+  std::u16string committed_url;
+
+  // The message the app sent the view's creation params in, and the params
+  // read from it, which point into it. Moving the message keeps its bytes
+  // where they are.
+  std::vector<uint8_t> creation_message;
+  WebViewCreationParams creation_params;
+
+  // The outstanding pool claim while waiting for a surface.
+  ControllerPool<WebViewSurface>::ClaimId claim_id = 0;
+
+  // The texture showing the page, with --texture-views, and whether a
+  // capture for it is in flight.
+  std::unique_ptr<WebViewTexture> texture;
+  bool capture_pending = false;
+};
+
+// Every live platform view, keyed by its child window.
+PlatformViewRegistry<WebViewPlatformView> g_platform_views;
+
+// Set by --texture-views: each platform view's page is captured every
+// frame into a Flutter texture, which the app draws in place of the view,
+// and the view's own window stays hidden. The registrar and the channel
+// announcing textures to the app live from |FlutterWindow::OnCreate| to
+// |FlutterWindow::OnDestroy|.
+bool g_texture_views = false;
+flutter::TextureRegistrar* g_texture_registrar = nullptr;
+std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>>
+    g_texture_channel;
+constexpr char kTextureChannelName[] = "runner/texture_views";
+
+// The engine passes a platform view factory nothing the app specified, so
+// the app sends each view's |WebViewCreationParams| on this channel just
+// before creating it, and the factory takes the oldest unclaimed ones.
+// Messages are validated on arrival and kept as they are, to be decoded in
+// place. The channel is handled from |FlutterWindow::OnCreate| to
+// |FlutterWindow::OnDestroy|.
+constexpr char kCreationParamsChannelName[] = "runner/platform_view_params";
+std::deque<std::vector<uint8_t>> g_pending_creation_params;
+
+// The process-wide WebView2 environment, and the surfaces pre-created from
+// it that new platform views claim and released views are recycled into.
+// Both live from |FlutterWindow::OnCreate| to |FlutterWindow::OnDestroy|.
+std::unique_ptr<WebViewEnvironment> g_webview_environment;
+std::unique_ptr<ControllerPool<WebViewSurface>> g_controller_pool;
+
+// Pages web views start on. With the asset pack from the data directory
+// they load from it, offline and without network latency; without it they
+// load from the web.
+constexpr wchar_t kAssetPackFile[] = L"assets.pack";
+constexpr char kAssetOrigin[] = "https://appassets.local";
+constexpr char16_t kAssetStartUrl[] = u"https://appassets.local/index.html";
+constexpr char16_t kWebStartUrl[] = u"https://www.google.com/";
+bool g_serving_assets = false;
+
+// Maps the asset pack and has the environment serve it on kAssetOrigin.
+void ServeAssetPack() {
+  RUNNER_TRACE_SCOPE("ServeAssetPack");
+  std::string error;
+  std::shared_ptr<const MappedFile> file =
+      MappedFile::Open(GetDataFilePath(kAssetPackFile), &error);
+  std::optional<AssetPack> pack;
+  if (file) {
+    pack = AssetPack::Open(file->bytes(), &error);
+  }
+  if (!pack) {
+    RUNNER_LOG_INFO("Not serving web assets: {}", error);
+    return;
+  }
+  RUNNER_LOG_INFO("Serving {} web assets on {}", pack->size(), kAssetOrigin);
+  g_webview_environment->ServeAssets(kAssetOrigin, std::move(file), *pack);
+  g_serving_assets = true;
+}
+
+// Maximum number of unattached surfaces kept alive, how many are created
+// ahead of demand, and how long the rest may sit idle before being closed.
+constexpr size_t kIdleControllerCapacity = 4;
+constexpr size_t kWarmControllerCount = 1;
+constexpr std::chrono::milliseconds kMaxIdleControllerTime(30000);
+
+// Whether a task to evict idle surfaces is pending.
+bool g_eviction_pending = false;
+
+// Suspends and discards hidden views to stay within these limits. Lives
+// alongside the pool.
+constexpr size_t kMaxLiveWebViews = 6;
+constexpr size_t kWebViewMemoryBudget = 384 * 1024 * 1024;
+std::unique_ptr<ViewLifecycleManager> g_view_lifecycle;
+
+// Whether a task to run the lifecycle manager's next update is pending.
+bool g_lifecycle_update_pending = false;
+
+// Replaces the controllers of views whose web view processes failed. Lives
+// alongside the pool.
+std::unique_ptr<ViewRecoveryManager> g_view_recovery;
+
+// Whether a task to run the recovery manager's next update is pending.
+bool g_recovery_update_pending = false;
+
+// Runs deferred work on the main loop. Outlives the window.
+TaskScheduler* g_task_scheduler = nullptr;
+
+// Posts |task| to run at |when|, unless |*pending| says it already is.
+void PostTaskOnce(bool* pending,
+                  std::chrono::steady_clock::time_point when,
+                  void (*task)(),
+                  TaskPriority priority = TaskPriority::kLow) {
+  if (*pending) {
+    return;
+  }
+  *pending = true;
+  g_task_scheduler->PostTaskAt(
+      [pending, task] {
+        *pending = false;
+        task();
+      },
+      when, priority);
+}
+
+// Runtime metrics (see metrics.h). With --metrics they are written to a
+// file every kMetricsWriteInterval and on exit, and the app can ask for a
+// JSON snapshot with "snapshot" on kMetricsChannelName. The channel lives
+// from |FlutterWindow::OnCreate| to |FlutterWindow::OnDestroy|.
+Counter* const g_navigations_started =
+    Metrics().GetCounter("navigation.started");
+Counter* const g_navigations_cancelled =
+    Metrics().GetCounter("navigation.cancelled");
+Counter* const g_web_messages_received =
+    Metrics().GetCounter("web_message.received");
+Counter* const g_view_resizes = Metrics().GetCounter("platform_view.wm_size");
+Gauge* const g_live_views = Metrics().GetGauge("platform_view.live");
+Histogram* const g_surface_claim_us =
+    Metrics().GetHistogram("platform_view.surface_claim_us");
+Counter* const g_process_failures =
+    Metrics().GetCounter("webview.process_failed");
+Histogram* const g_recovery_us = Metrics().GetHistogram("webview.recovery_us");
+std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>>
+    g_metrics_channel;
+constexpr char kMetricsChannelName[] = "runner/metrics";
+constexpr std::chrono::seconds kMetricsWriteInterval(10);
+
+// Whether a task to write the metrics file is pending.
+bool g_metrics_write_pending = false;
+
+void WriteMetricsPeriodically() {
+  WriteMetricsFile();
+  PostTaskOnce(&g_metrics_write_pending,
+               std::chrono::steady_clock::now() + kMetricsWriteInterval,
+               WriteMetricsPeriodically);
+}
+
+void HandleMetricsCall(
+    const flutter::MethodCall<flutter::EncodableValue>& call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  if (call.method_name() != "snapshot") {
+    result->NotImplemented();
+    return;
+  }
+  result->Success(flutter::EncodableValue(Metrics().ToJson()));
+}
+
+// Queues valid creation params for the next view, replying null, or
+// replies with why they are invalid.
+void HandleCreationParamsMessage(const uint8_t* message,
+                                 size_t message_size,
+                                 flutter::BinaryReply reply) {
+  StandardValue value;
+  WebViewCreationParams params;
+  std::string error;
+  if (DecodeStandardMessage(message, message_size, &value, &error) &&
+      ReadWebViewCreationParams(value, &params, &error)) {
+    g_pending_creation_params.emplace_back(message, message + message_size);
+    uint8_t null_reply = static_cast<uint8_t>(StandardType::kNull);
+    reply(&null_reply, 1);
+    return;
+  }
+  RUNNER_LOG_ERROR("Invalid platform view params: {}", error);
+  std::vector<uint8_t> error_reply;
+  StandardMessageWriter(&error_reply).String(error);
+  reply(error_reply.data(), error_reply.size());
+}
+
+// Hands the oldest pending creation params to |view|, if there are any.
+void TakeCreationParams(WebViewPlatformView* view) {
+  if (g_pending_creation_params.empty()) {
+    return;
+  }
+  view->creation_message = std::move(g_pending_creation_params.front());
+  g_pending_creation_params.pop_front();
+  // Validated on arrival, so reading cannot fail.
+  StandardValue value;
+  std::string error;
+  DecodeStandardMessage(view->creation_message.data(),
+                        view->creation_message.size(), &value, &error);
+  ReadWebViewCreationParams(value, &view->creation_params, &error);
+}
+
+// Methods pages call with runnerRpc.call() (see rpc_router.h). Replies are
+// posted to the page that called, synchronously.
+RpcRouter g_rpc_router;
+// Reused for every reply.
+std::u16string g_rpc_reply;
+
+void RegisterRpcMethods() {
+  g_rpc_router.Register("ping", [] { return "pong"; });
+  g_rpc_router.Register("echo",
+                        [](std::string_view message) { return message; });
+  g_rpc_router.Register("platformViews.live",
+                        [] { return g_live_views->Value(); });
+  g_rpc_router.RegisterRaw("metrics.snapshot", [](JsonValue params,
+                                                  RpcReply& reply) {
+    std::string json = Metrics().ToJson();
+    while (!json.empty() && json.back() == '\n') {
+      json.pop_back();
+    }
+    reply.Result().Raw(json);
+  });
+}
+
+void ScheduleIdleEviction();
+
+void EvictIdleSurfaces() {
+  if (g_controller_pool) {
+    size_t evicted = g_controller_pool->EvictIdle(
+        ControllerPool<WebViewSurface>::Clock::now());
+    RUNNER_LOG_DEBUG("Evicted {} idle webview surfaces", evicted);
+    ScheduleIdleEviction();
+  }
+}
+
+// Schedules eviction for the pool's next eviction, if there is one.
+void ScheduleIdleEviction() {
+  std::optional<ControllerPool<WebViewSurface>::Clock::time_point> next =
+      g_controller_pool->NextEvictionTime();
+  if (next) {
+    PostTaskOnce(&g_eviction_pending, *next, EvictIdleSurfaces);
+  }
+}
+
+void ScheduleLifecycleUpdate();
+
+void UpdateViewLifecycle() {
+  if (g_view_lifecycle) {
+    g_view_lifecycle->Update(ViewLifecycleManager::Clock::now());
+    ScheduleLifecycleUpdate();
+  }
+}
+
+// Schedules an update for the manager's next time-based decision.
+void ScheduleLifecycleUpdate() {
+  std::optional<ViewLifecycleManager::Clock::time_point> next =
+      g_view_lifecycle->NextUpdateTime();
+  if (next) {
+    PostTaskOnce(&g_lifecycle_update_pending, *next, UpdateViewLifecycle);
+  }
+}
+
+void ScheduleRecoveryUpdate();
+
+void UpdateViewRecovery() {
+  if (g_view_recovery) {
+    g_view_recovery->Update(ViewRecoveryManager::Clock::now());
+    ScheduleRecoveryUpdate();
+  }
+}
+
+// Schedules an update for the recovery manager's next retry.
+void ScheduleRecoveryUpdate() {
+  std::optional<ViewRecoveryManager::Clock::time_point> next =
+      g_view_recovery->NextUpdateTime();
+  if (next) {
+    PostTaskOnce(&g_recovery_update_pending, *next, UpdateViewRecovery);
+  }
+}
+
+// Hands |surface| back to the pool for another view to claim.
+void RecycleSurface(WebViewSurface surface) {
+  surface->Detach();
+  g_controller_pool->Return(std::move(surface));
+  ScheduleIdleEviction();
+}
+
+// Decides which navigations web views may start. Loaded in
+// |FlutterWindow::OnCreate| from kNavigationPolicyFile in the data directory,
+// falling back to kDefaultNavigationPolicy.
+constexpr wchar_t kNavigationPolicyFile[] = L"navigation_policy.txt";
+std::optional<NavigationPolicy> g_navigation_policy;
+
+// Compiles the configured navigation policy, or the built-in one if there is
+// no usable configuration.
+NavigationPolicy LoadNavigationPolicy() {
+  std::string config;
+  std::string error;
+  if (ReadDataFile(kNavigationPolicyFile, &config)) {
+    std::optional<NavigationPolicy> policy =
+        NavigationPolicy::Compile(config, &error);
+    if (policy) {
+      RUNNER_LOG_INFO("Loaded {} navigation rules", policy->rule_count());
+      return std::move(*policy);
+    }
+    RUNNER_LOG_ERROR("Ignoring navigation policy: {}", error);
+  }
+  return *NavigationPolicy::Compile(kDefaultNavigationPolicy, &error);
+}
+
+// Queues |payload| for the page on |channel|; the batch is posted by the
+// message flush timer.
+void SendWebMessage(WebViewPlatformView* view,
+                    WebMessageChannelId channel,
+                    std::u16string_view payload) {
+  if (view->messages && view->messages->batcher.Send(channel, payload)) {
+    SetTimer(view->hwnd, kMessageFlushTimerId, kMessageFlushIntervalMs,
+             nullptr);
+  }
+}
+
+// Queues |expression| for evaluation in |view|'s page; the batch is sent by
+// the script flush timer. |callback| is always invoked, with kCancelled if
+// the view has no web view or loses it first.
+void ExecuteScriptInView(WebViewPlatformView* view,
+                         std::u16string_view expression,
+                         ScriptBatcher::ResultCallback callback) {
+  if (!view->scripts) {
+    callback(ScriptStatus::kCancelled, std::u16string_view());
+    return;
+  }
+  bool start_batch = !view->scripts->batcher.has_queued();
+  view->scripts->batcher.Execute(expression, std::move(callback));
+  if (start_batch) {
+    SetTimer(view->hwnd, kScriptFlushTimerId, kScriptFlushIntervalMs, nullptr);
+  }
+}
+
+void ExpireScriptCalls(SlotHandle handle,
+                       ScriptBatcher::Clock::time_point scheduled_for);
+
+// Makes sure a task times out the script calls of |view|, referenced by
+// |handle|, when the earliest of them is due. A pending task that runs no
+// later than that is kept, so flushing every frame does not pile up tasks.
+void ScheduleScriptTimeout(SlotHandle handle, WebViewPlatformView* view) {
+  if (!view->scripts) {
+    return;
+  }
+  std::optional<ScriptBatcher::Clock::time_point> next =
+      view->scripts->batcher.NextTimeout();
+  if (!next ||
+      (view->script_timeout_pending && view->script_timeout_at <= *next)) {
+    return;
+  }
+  view->script_timeout_pending = true;
+  view->script_timeout_at = *next;
+  g_task_scheduler->PostTaskAt(
+      [handle, when = *next] { ExpireScriptCalls(handle, when); }, *next,
+      TaskPriority::kLow);
+}
+
+// Times out the overdue script calls of the view referenced by |handle|,
+// and schedules the next check. Does nothing if the task scheduled for
+// |scheduled_for| was superseded by an earlier one.
+void ExpireScriptCalls(SlotHandle handle,
+                       ScriptBatcher::Clock::time_point scheduled_for) {
+  WebViewPlatformView* view = g_platform_views.Get(handle);
+  if (view == nullptr || !view->script_timeout_pending ||
+      view->script_timeout_at != scheduled_for) {
+    return;
+  }
+  view->script_timeout_pending = false;
+  if (!view->scripts) {
+    return;
+  }
+  view->scripts->batcher.ExpireTimedOut(ScriptBatcher::Clock::now());
+  ScheduleScriptTimeout(handle, view);
+}
+
+// Sends the queued script calls of the view referenced by |handle| as one
+// batch.
+void FlushScripts(SlotHandle handle) {
+  WebViewPlatformView* view = g_platform_views.Get(handle);
+  if (view == nullptr || !view->scripts) {
+    return;
+  }
+  view->scripts->batcher.Flush(ScriptBatcher::Clock::now());
+  if (!view->scripts->batcher.has_queued()) {
+    KillTimer(view->hwnd, kScriptFlushTimerId);
+  }
+  ScheduleScriptTimeout(handle, view);
+}
+
+// Tells the app that |view|'s page is shown by |texture_id|, through
+// |method| "textureCreated" or "textureDestroyed".
+void NotifyTextureView(const char* method,
+                       PlatformViewKey view,
+                       int64_t texture_id) {
+  if (!g_texture_channel) {
+    return;
+  }
+  g_texture_channel->InvokeMethod(
+      method, std::make_unique<flutter::EncodableValue>(flutter::EncodableMap{
+                  {flutter::EncodableValue("view"),
+                   flutter::EncodableValue(static_cast<int64_t>(view))},
+                  {flutter::EncodableValue("texture"),
+                   flutter::EncodableValue(texture_id)},
+              }));
+}
+
+// Captures the page of the view referenced by |handle| into its texture.
+// A tick while the previous capture is still in flight is skipped.
+void CaptureViewTexture(SlotHandle handle) {
+  WebViewPlatformView* view = g_platform_views.Get(handle);
+  if (view == nullptr || !view->texture || !view->surface ||
+      view->capture_pending) {
+    return;
+  }
+  view->capture_pending = true;
+  view->surface->CaptureFrame([handle](const PixelFrame* frame) {
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr) {
+      return;
+    }
+    view->capture_pending = false;
+    if (frame != nullptr && view->texture) {
+      view->texture->Update(*frame);
+    }
+  });
+}
+
+// Detaches |view|'s surface, if any, and returns it to the pool.
+void ReleaseWebView(WebViewPlatformView* view) {
+  view->messages = nullptr;
+  view->scripts = nullptr;
+  // A capture still in flight may never complete once the surface moves on.
+  view->capture_pending = false;
+  if (!view->surface) {
+    if (view->claim_id != 0) {
+      // The cancelled claim is never answered, so nothing else clears its
+      // id, and a view with a claim outstanding is not claimed again.
+      g_controller_pool->CancelClaim(view->claim_id);
+      view->claim_id = 0;
+    }
+    return;
+  }
+  // The next view to claim the surface installs its own handlers.
+  view->surface->SetEvents(WebViewEvents());
+  RecycleSurface(std::move(view->surface));
+  view->surface = WebViewSurface();
+}
+
+// Detaches |view|'s failed surface and destroys it; unlike a working one,
+// it must not go back to the pool.
+void DestroyFailedWebView(WebViewPlatformView* view) {
+  view->messages = nullptr;
+  view->scripts = nullptr;
+  view->capture_pending = false;
+  if (!view->surface) {
+    return;
+  }
+  view->surface->SetEvents(WebViewEvents());
+  view->surface->Detach();
+  g_webview_environment->DestroyController(std::move(view->surface));
+  view->surface = WebViewSurface();
+}
+
+PlatformViewKey KeyFromWindow(HWND hwnd) {
+  return reinterpret_cast<PlatformViewKey>(hwnd);
+}
+
+IntRect IntRectFromRect(const RECT& rect) {
+  return IntRect{rect.left, rect.top, rect.right, rect.bottom};
+}
+
+// Focus order of the platform view windows by their position in the parent,
+// and which of them has focus. Lives alongside |g_task_scheduler|, through
+// which it reports focus changes.
+std::unique_ptr<FocusGraph> g_focus_graph;
+
+// Tells the Flutter view that one of its platform views took focus, so the
+// engine unfocuses its own widgets. Runs as a scheduler task, and posts
+// WM_KILLFOCUS rather than sending it: handling it from within the WebView2
+// focus event, or from a task run inside a message the engine is handling,
+// re-entered the engine while focus was still moving.
+void OnPlatformViewFocusChanged(FocusNodeId previous, FocusNodeId current) {
+  RUNNER_LOG_DEBUG("Platform view focus moved from {} to {}", previous,
+                   current);
+  WebViewPlatformView* view =
+      g_platform_views.Find(static_cast<PlatformViewKey>(current));
+  if (view == nullptr) {
+    return;
+  }
+  ::PostMessage(GetParent(view->hwnd), WM_KILLFOCUS,
+                reinterpret_cast<WPARAM>(view->hwnd), 0);
+}
+
+// The Flutter content drawn over platform views, as reported by the app
+// through kOverlayChannelName, and how much of each view window it leaves
+// visible. Windows are clipped to their visible region so the overlays show
+// through; with --texture-views the windows are hidden and nothing is
+// tracked. The channel lives from |FlutterWindow::OnCreate| to
+// |FlutterWindow::OnDestroy|.
+OcclusionTracker g_occlusion;
+std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>>
+    g_overlay_channel;
+constexpr char kOverlayChannelName[] = "runner/overlays";
+
+// Whether a task to re-clip the view windows is pending.
+bool g_clip_update_pending = false;
+
+// Returns a GDI region made of |region|'s rectangles, built in one call.
+HRGN CreateGdiRegion(const Region& region) {
+  std::vector<IntRect> rects = region.Rects();
+  std::vector<uint8_t> buffer(sizeof(RGNDATAHEADER) +
+                              rects.size() * sizeof(RECT));
+  RGNDATA* data = reinterpret_cast<RGNDATA*>(buffer.data());
+  IntRect bounds = region.bounds();
+  data->rdh.dwSize = sizeof(RGNDATAHEADER);
+  data->rdh.iType = RDH_RECTANGLES;
+  data->rdh.nCount = static_cast<DWORD>(rects.size());
+  data->rdh.nRgnSize = static_cast<DWORD>(rects.size() * sizeof(RECT));
+  data->rdh.rcBound = RECT{bounds.left, bounds.top, bounds.right, bounds.bottom};
+  RECT* out = reinterpret_cast<RECT*>(data->Buffer);
+  for (size_t i = 0; i < rects.size(); ++i) {
+    out[i] = RECT{rects[i].left, rects[i].top, rects[i].right, rects[i].bottom};
+  }
+  return ExtCreateRegion(nullptr, static_cast<DWORD>(buffer.size()), data);
+}
+
+// Clips every view window whose visible region changed. Windows that
+// nothing covers are unclipped rather than given a region of their own
+// bounds.
+void UpdateViewClipping() {
+  RUNNER_TRACE_SCOPE("UpdateViewClipping");
+  for (OcclusionViewId id : g_occlusion.Update()) {
+    WebViewPlatformView* view =
+        g_platform_views.Find(static_cast<PlatformViewKey>(id));
+    if (view == nullptr) {
+      continue;
+    }
+    // The window takes ownership of the region.
+    HRGN region = g_occlusion.IsUnoccluded(id)
+                      ? nullptr
+                      : CreateGdiRegion(*g_occlusion.VisibleRegion(id));
+    SetWindowRgn(view->hwnd, region, TRUE);
+  }
+}
+
+void ScheduleViewClipping() {
+  PostTaskOnce(&g_clip_update_pending, std::chrono::steady_clock::now(),
+               UpdateViewClipping, TaskPriority::kHigh);
+}
+
+// Handles "setOverlays" from the app, whose argument lists the overlays'
+// left, top, right and bottom edges in the Flutter view's physical pixels.
+void HandleOverlayCall(
+    const flutter::MethodCall<flutter::EncodableValue>& call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  if (call.method_name() != "setOverlays") {
+    result->NotImplemented();
+    return;
+  }
+  const auto* edges = std::get_if<std::vector<int32_t>>(call.arguments());
+  if (edges == nullptr || edges->size() % 4 != 0) {
+    result->Error("bad_arguments",
+                  "Expected an Int32List of left, top, right, bottom edges");
+    return;
+  }
+  std::vector<IntRect> overlays;
+  overlays.reserve(edges->size() / 4);
+  for (size_t i = 0; i < edges->size(); i += 4) {
+    overlays.push_back(IntRect{(*edges)[i], (*edges)[i + 1], (*edges)[i + 2],
+                               (*edges)[i + 3]});
+  }
+  if (g_occlusion.SetOverlays(overlays)) {
+    ScheduleViewClipping();
+  }
+  result->Success();
+}
+
+// Geometry the engine requested for platform view windows, held back until
+// the frame that laid them out is presented.
+GeometryTransaction g_geometry;
+
+// True while |g_geometry| is being applied, so that its own window changes
+// are let through.
+bool g_committing_geometry = false;
+
+// How long geometry may wait for a presented frame before it is applied
+// anyway, e.g. when the engine moves a view without producing a frame.
+constexpr std::chrono::milliseconds kGeometryCommitTimeout(50);
+
+// Whether a task to apply late geometry is pending.
+bool g_geometry_timeout_pending = false;
+
+// Returns true for the special |hWndInsertAfter| values of SetWindowPos.
+bool IsSpecialInsertAfter(HWND insert_after) {
+  return insert_after == HWND_TOP || insert_after == HWND_BOTTOM ||
+         insert_after == HWND_TOPMOST || insert_after == HWND_NOTOPMOST;
+}
+
+// Applies every pending geometry change. Views sharing a parent are
+// updated with a single DeferWindowPos batch, so they move together.
+void CommitGeometry(bool presented) {
+  std::vector<GeometryChange> changes =
+      g_geometry.Commit(GeometryTransaction::Clock::now(), presented);
+  if (changes.empty()) {
+    return;
+  }
+  RUNNER_TRACE_SCOPE("CommitGeometry");
+
+  struct WindowPos {
+    HWND hwnd;
+    HWND parent;
+    HWND insert_after;
+    IntRect bounds;
+    UINT flags;
+  };
+  std::vector<WindowPos> positions;
+  positions.reserve(changes.size());
+  for (const GeometryChange& change : changes) {
+    WebViewPlatformView* view = g_platform_views.Find(change.view);
+    if (view == nullptr) {
+      continue;
+    }
+    WindowPos pos{view->hwnd, GetParent(view->hwnd), nullptr, IntRect(),
+                  SWP_NOACTIVATE | SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER};
+    if (change.bounds) {
+      pos.bounds = *change.bounds;
+      pos.flags &= ~(SWP_NOMOVE | SWP_NOSIZE);
+    }
+    if (change.visible) {
+      pos.flags |= *change.visible ? SWP_SHOWWINDOW : SWP_HIDEWINDOW;
+    }
+    if (change.insert_after) {
+      HWND insert_after = reinterpret_cast<HWND>(
+          static_cast<uintptr_t>(*change.insert_after));
+      // The sibling may have been destroyed since, which would fail the
+      // whole batch.
+      if (IsSpecialInsertAfter(insert_after) || IsWindow(insert_after)) {
+        pos.insert_after = insert_after;
+        pos.flags &= ~SWP_NOZORDER;
+      }
+    }
+    positions.push_back(pos);
+  }
+
+  g_committing_geometry = true;
+  std::vector<bool> applied(positions.size(), false);
+  for (size_t first = 0; first < positions.size(); ++first) {
+    if (applied[first]) {
+      continue;
+    }
+    HWND parent = positions[first].parent;
+    HDWP batch = BeginDeferWindowPos(static_cast<int>(positions.size()));
+    for (size_t i = first; i < positions.size() && batch != nullptr; ++i) {
+      const WindowPos& pos = positions[i];
+      if (!applied[i] && pos.parent == parent) {
+        batch = DeferWindowPos(batch, pos.hwnd, pos.insert_after,
+                               pos.bounds.left, pos.bounds.top,
+                               pos.bounds.width(), pos.bounds.height(),
+                               pos.flags);
+      }
+    }
+    bool batched = batch != nullptr && EndDeferWindowPos(batch);
+    if (!batched) {
+      RUNNER_LOG_WARNING("DeferWindowPos failed ({}); applying views one by one",
+                         GetLastError());
+    }
+    for (size_t i = first; i < positions.size(); ++i) {
+      const WindowPos& pos = positions[i];
+      if (applied[i] || pos.parent != parent) {
+        continue;
+      }
+      if (!batched) {
+        SetWindowPos(pos.hwnd, pos.insert_after, pos.bounds.left,
+                     pos.bounds.top, pos.bounds.width(), pos.bounds.height(),
+                     pos.flags);
+      }
+      applied[i] = true;
+    }
+  }
+  g_committing_geometry = false;
+}
+
+// Applies pending geometry that no presented frame has picked up in time.
+void CommitLateGeometry() {
+  std::optional<GeometryTransaction::Clock::time_point> since =
+      g_geometry.pending_since();
+  if (!since) {
+    return;
+  }
+  if (GeometryTransaction::Clock::now() >= *since + kGeometryCommitTimeout) {
+    CommitGeometry(false);
+  } else {
+    PostTaskOnce(&g_geometry_timeout_pending, *since + kGeometryCommitTimeout,
+                 CommitLateGeometry, TaskPriority::kHigh);
+  }
+}
+
+// Moves the position, size, visibility and stacking changes in |pos| into
+// |g_geometry|, letting the rest of the change through.
+void DeferGeometry(HWND hwnd, WINDOWPOS* pos) {
+  GeometryViewId view = KeyFromWindow(hwnd);
+  GeometryTransaction::Clock::time_point now =
+      GeometryTransaction::Clock::now();
+  bool started = false;
+  if ((pos->flags & (SWP_NOMOVE | SWP_NOSIZE)) != (SWP_NOMOVE | SWP_NOSIZE)) {
+    RECT current;
+    GetWindowRect(hwnd, &current);
+    MapWindowPoints(nullptr, GetParent(hwnd),
+                    reinterpret_cast<POINT*>(&current), 2);
+    IntRect target = IntRectFromRect(current);
+    if (!(pos->flags & SWP_NOMOVE)) {
+      target.right += pos->x - target.left;
+      target.bottom += pos->y - target.top;
+      target.left = pos->x;
+      target.top = pos->y;
+    }
+    if (!(pos->flags & SWP_NOSIZE)) {
+      target.right = target.left + pos->cx;
+      target.bottom = target.top + pos->cy;
+    }
+    // A no-op request still has to replace a pending one.
+    if (target != IntRectFromRect(current) || g_geometry.has_pending(view)) {
+      started = g_geometry.SetBounds(view, target, now) || started;
+    }
+    pos->flags |= SWP_NOMOVE | SWP_NOSIZE;
+  }
+  if (pos->flags & SWP_SHOWWINDOW) {
+    started = g_geometry.SetVisible(view, true, now) || started;
+    pos->flags &= ~SWP_SHOWWINDOW;
+  }
+  if (pos->flags & SWP_HIDEWINDOW) {
+    started = g_geometry.SetVisible(view, false, now) || started;
+    pos->flags &= ~SWP_HIDEWINDOW;
+  }
+  if (!(pos->flags & SWP_NOZORDER)) {
+    started = g_geometry.SetInsertAfter(
+                  view, reinterpret_cast<uintptr_t>(pos->hwndInsertAfter),
+                  now) ||
+              started;
+    pos->flags |= SWP_NOZORDER;
+  }
+  if (started) {
+    PostTaskOnce(&g_geometry_timeout_pending, now + kGeometryCommitTimeout,
+                 CommitLateGeometry, TaskPriority::kHigh);
+  }
+}
+
+// Applies |view|'s coalesced bounds, if any are due, and stops the flush
+// timer once nothing is left pending.
+void FlushBounds(WebViewPlatformView* view) {
+  std::optional<IntRect> bounds =
+      view->bounds_coalescer.Flush(BoundsCoalescer::Clock::now());
+  if (bounds && view->surface) {
+    view->surface->SetBounds(*bounds);
+  }
+  if (!view->bounds_coalescer.has_pending()) {
+    KillTimer(view->hwnd, kBoundsFlushTimerId);
+  }
+}
+
+LRESULT CALLBACK WebViewWndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+  switch (msg) {
+    case WM_CREATE: {
+      CREATESTRUCT* pars = (CREATESTRUCT*)lparam;
+      void* user_data = pars->lpCreateParams;
+      SetWindowLongPtr(hwnd, 0, (LONG_PTR)user_data);
+      return DefWindowProc(hwnd, msg, wparam, lparam);
+    }
+    case WM_WINDOWPOSCHANGING: {
+      // Hold the engine's layout of the view back until its frame is
+      // presented.
+      if (!g_committing_geometry &&
+          g_platform_views.Find(KeyFromWindow(hwnd)) != nullptr) {
+        DeferGeometry(hwnd, reinterpret_cast<WINDOWPOS*>(lparam));
+      }
+      return DefWindowProc(hwnd, msg, wparam, lparam);
+    }
+    case WM_WINDOWPOSCHANGED: {
+      // Track whether the view is shown and at least partly inside its
+      // parent, so views that are hidden or scrolled away can be suspended.
+      // A texture view's window is always hidden, so only the layout the
+      // engine gave it counts. DefWindowProc still turns this into WM_SIZE.
+      RECT window_rect;
+      RECT parent_rect;
+      RECT visible_rect;
+      HWND parent = GetParent(hwnd);
+      GetWindowRect(hwnd, &window_rect);
+      GetClientRect(parent, &parent_rect);
+      MapWindowPoints(parent, nullptr, reinterpret_cast<POINT*>(&parent_rect), 2);
+      bool shown = g_texture_views || IsWindowVisible(hwnd);
+      bool visible =
+          shown && IntersectRect(&visible_rect, &window_rect, &parent_rect);
+      if (g_view_lifecycle) {
+        g_view_lifecycle->SetVisible(KeyFromWindow(hwnd), visible,
+                                     ViewLifecycleManager::Clock::now());
+        ScheduleLifecycleUpdate();
+      }
+      OffsetRect(&window_rect, -parent_rect.left, -parent_rect.top);
+      if (g_focus_graph) {
+        g_focus_graph->MoveNode(KeyFromWindow(hwnd),
+                                IntRectFromRect(window_rect));
+      }
+      if (!g_texture_views &&
+          g_platform_views.Find(KeyFromWindow(hwnd)) != nullptr) {
+        g_occlusion.SetViewBounds(KeyFromWindow(hwnd),
+                                  IntRectFromRect(window_rect));
+        ScheduleViewClipping();
+      }
+      return DefWindowProc(hwnd, msg, wparam, lparam);
+    }
+    case WM_SIZE: {
+      g_view_resizes->Increment();
+      WebViewPlatformView* view = g_platform_views.Find(KeyFromWindow(hwnd));
+      if (view != nullptr && view->surface) {
+        RECT bounds;
+        GetClientRect(hwnd, &bounds);
+        if (view->bounds_coalescer.Submit(IntRectFromRect(bounds))) {
+          // Resize the web view in the same pass as a committed frame's
+          // geometry; anything else waits for the flush timer.
+          if (g_committing_geometry) {
+            FlushBounds(view);
+          } else {
+            SetTimer(hwnd, kBoundsFlushTimerId, kBoundsFlushIntervalMs,
+                     nullptr);
+          }
+        }
+      }
+      break;
+    }
+    case WM_TIMER: {
+      WebViewPlatformView* view = g_platform_views.Find(KeyFromWindow(hwnd));
+      if (wparam == kBoundsFlushTimerId && view != nullptr) {
+        FlushBounds(view);
+      } else if (wparam == kMessageFlushTimerId && view != nullptr) {
+        if (view->messages) {
+          view->messages->batcher.Flush();
+        }
+        KillTimer(hwnd, kMessageFlushTimerId);
+      } else if (wparam == kScriptFlushTimerId && view != nullptr) {
+        FlushScripts(g_platform_views.FindHandle(KeyFromWindow(hwnd)));
+      } else if (wparam == kCaptureTimerId && view != nullptr) {
+        CaptureViewTexture(g_platform_views.FindHandle(KeyFromWindow(hwnd)));
+      } else if (wparam == kBoundsFlushTimerId || wparam == kMessageFlushTimerId ||
+                 wparam == kScriptFlushTimerId || wparam == kCaptureTimerId) {
+        KillTimer(hwnd, wparam);
+      } else {
+        return DefWindowProc(hwnd, msg, wparam, lparam);
+      }
+      break;
+    }
+    case WM_DESTROY: {
+      WebViewPlatformView* view = g_platform_views.Find(KeyFromWindow(hwnd));
+      if (view != nullptr) {
+        const BoundsCoalescerStats& stats = view->bounds_coalescer.stats();
+        RUNNER_LOG_DEBUG("Bounds updates: {} received, {} applied",
+                         stats.received, stats.applied);
+        KillTimer(hwnd, kBoundsFlushTimerId);
+        KillTimer(hwnd, kMessageFlushTimerId);
+        KillTimer(hwnd, kScriptFlushTimerId);
+        KillTimer(hwnd, kCaptureTimerId);
+        if (view->texture) {
+          NotifyTextureView("textureDestroyed", KeyFromWindow(hwnd),
+                            view->texture->id());
+        }
+        ReleaseWebView(view);
+        g_geometry.RemoveView(KeyFromWindow(hwnd));
+        g_occlusion.RemoveView(KeyFromWindow(hwnd));
+        g_platform_views.Remove(KeyFromWindow(hwnd));
+        g_live_views->Add(-1);
+        if (g_view_lifecycle) {
+          g_view_lifecycle->RemoveView(KeyFromWindow(hwnd));
+        }
+        if (g_view_recovery) {
+          g_view_recovery->RemoveView(KeyFromWindow(hwnd));
+        }
+        if (g_focus_graph) {
+          g_focus_graph->RemoveNode(KeyFromWindow(hwnd));
+        }
+      }
+      break;
+    }
+    case WM_SETFOCUS: {
+      RUNNER_LOG_DEBUG("Platform view window gained focus");
+      if (g_view_lifecycle) {
+        // Resumes or restores the view if it was put to sleep.
+        g_view_lifecycle->Touch(KeyFromWindow(hwnd),
+                                ViewLifecycleManager::Clock::now());
+      }
+      WebViewPlatformView* view = g_platform_views.Find(KeyFromWindow(hwnd));
+      if (view != nullptr && view->surface) {
+        int reason = view->view_controller->engine()->QueryFocusReason();
+        view->surface->MoveFocus(static_cast<WebViewFocusReason>(reason));
+      }
+      break;
+    }
+    case WM_KILLFOCUS: {
+      RUNNER_LOG_DEBUG("Kill focus");
+      break;
+    }
+    default:
+      return DefWindowProc(hwnd, msg, wparam, lparam);
+  }
+  return 0;
+}
+
+// Finishes setting up the platform view referenced by |handle| once the pool
+// has provided a surface. |handle| is generation-checked, so a view
+// destroyed while the claim was in flight is detected here and the surface
+// goes straight back to the pool.
+void AttachWebView(SlotHandle handle, WebViewSurface surface) {
+  WebViewPlatformView* view = g_platform_views.Get(handle);
+  if (view == nullptr) {
+    if (surface) {
+      RecycleSurface(std::move(surface));
+    }
+    return;
+  }
+  view->claim_id = 0;
+  if (g_view_recovery) {
+    // Completes the view's recovery if it was waiting for this surface.
+    g_view_recovery->OnReplacementAttached(KeyFromWindow(view->hwnd),
+                                           static_cast<bool>(surface),
+                                           ViewRecoveryManager::Clock::now());
+    ScheduleRecoveryUpdate();
+  }
+  if (!surface) {
+    RUNNER_LOG_ERROR("Failed to create webview controller");
+    return;
+  }
+
+  RUNNER_LOG_INFO("Assigning controller");
+  view->surface = std::move(surface);
+  WebViewController* webview = view->surface.get();
+
+  // Move the WebView into the platform view and fit it to its bounds
+  RECT bounds;
+  GetClientRect(view->hwnd, &bounds);
+  webview->Attach(reinterpret_cast<NativeWindow>(view->hwnd),
+                  IntRectFromRect(bounds));
+  view->bounds_coalescer.MarkApplied(IntRectFromRect(bounds),
+                                     BoundsCoalescer::Clock::now());
+
+  // Apply the view's own settings and scripts, replacing those of the view
+  // that last used the surface, before anything loads.
+  const WebViewCreationParams& params = view->creation_params;
+  webview->ApplySettings(params.settings);
+  std::vector<std::u16string> scripts(params.scripts.size());
+  for (size_t i = 0; i < params.scripts.size(); ++i) {
+    AppendUtf8AsUtf16(params.scripts[i], &scripts[i]);
+  }
+  webview->SetDocumentScripts(std::move(scripts));
+
+  // Schedule an async task to navigate to the start page, or back to where
+  // a discarded view was
+  RUNNER_TRACE_INSTANT("Navigate");
+  if (view->restore_url.empty() && !params.url.empty()) {
+    std::u16string url;
+    AppendUtf8AsUtf16(params.url, &url);
+    webview->Navigate(url);
+  } else if (view->restore_url.empty()) {
+    webview->Navigate(g_serving_assets ? kAssetStartUrl : kWebStartUrl);
+  } else {
+    webview->Navigate(view->restore_url);
+    view->restore_url.clear();
+  }
+
+  WebViewEvents events;
+
+  // <NavigationEvents>
+  // Step 4 - Navigation events
+  // cancel any navigation the navigation policy denies
+  events.navigation_starting = [](std::u16string_view uri) {
+    RUNNER_LOG_DEBUG("Navigation starting");
+    RUNNER_TRACE_INSTANT("NavigationStarting");
+    g_navigations_started->Increment();
+    NavigationDecision decision = g_navigation_policy->Check(uri);
+    if (decision.action == NavigationAction::kDeny) {
+      RUNNER_LOG_DEBUG("Canceled by rule {}", decision.rule);
+      g_navigations_cancelled->Increment();
+      return false;
+    }
+    RUNNER_LOG_DEBUG("Not canceled");
+    return true;
+  };
+  events.navigation_completed = [handle](bool succeeded) {
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr || !view->surface) {
+      return;
+    }
+    if (succeeded) {
+      view->committed_url = view->surface->Source();
+    }
+    if (g_view_recovery) {
+      g_view_recovery->OnNavigationCompleted(
+          KeyFromWindow(view->hwnd), ViewRecoveryManager::Clock::now());
+    }
+  };
+  // </NavigationEvents>
+
+  // Replacing the controller destroys it, which must not happen inside
+  // its own event, so recovery runs as a task.
+  events.process_failed = [handle](WebViewProcessFailure failure) {
+    RUNNER_LOG_ERROR("Webview process failed ({})",
+                     static_cast<int>(failure));
+    g_process_failures->Increment();
+    auto now = ViewRecoveryManager::Clock::now();
+    g_task_scheduler->PostTask([handle, failure, now] {
+      WebViewPlatformView* view = g_platform_views.Get(handle);
+      if (view == nullptr || !g_view_recovery) {
+        return;
+      }
+      PlatformViewKey id = KeyFromWindow(view->hwnd);
+      g_view_recovery->OnProcessFailed(id, failure, now);
+      view = g_platform_views.Get(handle);
+      if (view != nullptr && g_view_recovery->StateOf(id) ==
+                                 ViewRecoveryState::kBackingOff) {
+        // Nothing needs the failed controller while the view waits, and it
+        // must not be recycled if the view is discarded meanwhile.
+        DestroyFailedWebView(view);
+      }
+      ScheduleRecoveryUpdate();
+    });
+  };
+
+  // <Scripting>
+  // Step 5 - Scripting
+  // Schedule an async task to add initialization script that freezes the Object object
+  // webview->AddScriptToExecuteOnDocumentCreated(L"Object.freeze(Object);", nullptr);
+  // Queue a batched script call to get the document URL
+  view->scripts = std::make_unique<WebViewScripts>(webview);
+  ExecuteScriptInView(view, u"window.document.URL",
+    [](ScriptStatus status, std::u16string_view result_json) {
+      if (status != ScriptStatus::kSucceeded) {
+        RUNNER_LOG_DEBUG("URL probe did not complete ({})", status);
+        return;
+      }
+      // Script results can be large; reuse one buffer for all of them.
+      static Utf8Buffer result_buffer;
+      std::string_view URL =
+          result_buffer.Convert(result_json, InvalidUtf16Policy::kReplace);
+      RUNNER_LOG_DEBUG("Got URL: {}", URL);
+    });
+  // </Scripting>
+
+  // <CommunicationHostWeb>
+  // Step 6 - Communication between host and web content
+  // Set an event handler for the host to return received message back to the web content.
+  // Batches from the page's runnerChannel are split and routed by channel id
+  // without copying; anything else is echoed back directly.
+  view->messages = std::make_unique<WebViewMessageChannel>(webview);
+  view->messages->dispatcher.SetHandler(kEchoChannel, [handle](std::u16string_view payload) {
+    if (WebViewPlatformView* echo_view = g_platform_views.Get(handle)) {
+      SendWebMessage(echo_view, kEchoChannel, payload);
+    }
+  });
+  events.web_message_received = [handle](std::u16string_view message) {
+    g_web_messages_received->Increment();
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr || !view->surface) {
+      return;
+    }
+    if (view->messages && IsWebMessageBatch(message)) {
+      view->messages->dispatcher.Dispatch(message);
+      return;
+    }
+    RUNNER_LOG_DEBUG("Web message received");
+    // processMessage(&message);
+    view->surface->PostWebMessage(message);
+  };
+  events.web_message_json_received = [handle](std::u16string_view json) {
+    g_web_messages_received->Increment();
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr || !view->surface) {
+      return;
+    }
+    if (g_rpc_router.Dispatch(json, &g_rpc_reply)) {
+      view->surface->PostWebMessageAsJson(g_rpc_reply);
+    }
+  };
+  // </CommunicationHostWeb>
+
+  events.move_focus_requested = [handle](WebViewFocusReason reason) {
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr) {
+      return;
+    }
+    RUNNER_LOG_DEBUG("Moving focus from webview with reason {}",
+                     static_cast<int>(reason));
+    view->view_controller->engine()->SendTabOut(view->hwnd,
+                                                static_cast<int>(reason));
+  };
+
+  events.got_focus = [handle] {
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr) {
+      return;
+    }
+    // The Flutter view is told once this event has returned; see
+    // |OnPlatformViewFocusChanged|.
+    if (g_focus_graph) {
+      g_focus_graph->SetFocus(KeyFromWindow(view->hwnd));
+    }
+  };
+
+  events.lost_focus = [handle] {
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr || !g_focus_graph) {
+      return;
+    }
+    // Focus may already have moved to another view.
+    if (g_focus_graph->focused() == KeyFromWindow(view->hwnd)) {
+      g_focus_graph->SetFocus(kNoFocusNode);
+    }
+  };
+
+  webview->SetEvents(std::move(events));
+}
+
+// Claims a recycled or pre-created surface for the view referenced by
+// |handle|. The callback runs immediately on a pool hit and once a new
+// surface is ready on a miss.
+void ClaimSurface(SlotHandle handle) {
+  RUNNER_LOG_DEBUG("Claiming webview surface");
+  auto start = std::chrono::steady_clock::now();
+  // A claim answered before |Claim| returns, as a failed environment
+  // answers it, is not outstanding; recording it would keep recovery from
+  // ever claiming the view another surface.
+  auto answered = std::make_shared<bool>(false);
+  ControllerPool<WebViewSurface>::ClaimId claim_id = g_controller_pool->Claim(
+      [handle, start, answered](WebViewSurface surface) {
+        *answered = true;
+        g_surface_claim_us->Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count()));
+        AttachWebView(handle, std::move(surface));
+      });
+  if (WebViewPlatformView* pending = g_platform_views.Get(handle)) {
+    if (!*answered) {
+      pending->claim_id = claim_id;
+    }
+  }
+}
+
+// Carries out |g_view_lifecycle|'s decisions on platform views.
+class WebViewLifecycleDelegate : public ViewLifecycleDelegate {
+ public:
+  // ViewLifecycleDelegate:
+  void SuspendView(LifecycleViewId id) override {
+    WebViewPlatformView* view = g_platform_views.Find(id);
+    if (view == nullptr || !view->surface) {
+      g_view_lifecycle->OnSuspendFailed(id, ViewLifecycleManager::Clock::now());
+      return;
+    }
+    view->surface->TrySuspend([id](bool suspended) {
+      if (!suspended && g_view_lifecycle) {
+        RUNNER_LOG_DEBUG("Could not suspend platform view {}", id);
+        g_view_lifecycle->OnSuspendFailed(id, ViewLifecycleManager::Clock::now());
+      }
+    });
+  }
+
+  void ResumeView(LifecycleViewId id) override {
+    WebViewPlatformView* view = g_platform_views.Find(id);
+    if (view == nullptr || !view->surface) {
+      return;
+    }
+    view->surface->Resume();
+  }
+
+  void DiscardView(LifecycleViewId id) override {
+    WebViewPlatformView* view = g_platform_views.Find(id);
+    if (view == nullptr) {
+      return;
+    }
+    if (view->surface) {
+      view->restore_url = view->surface->Source();
+    }
+    RUNNER_LOG_DEBUG("Discarding platform view {}", id);
+    ReleaseWebView(view);
+  }
+
+  void RestoreView(LifecycleViewId id) override {
+    std::optional<ViewRecoveryState> recovery =
+        g_view_recovery ? g_view_recovery->StateOf(id) : std::nullopt;
+    if (recovery == ViewRecoveryState::kBackingOff ||
+        recovery == ViewRecoveryState::kAbandoned) {
+      // Recovery decides when, and whether, the view gets a surface.
+      return;
+    }
+    SlotHandle handle = g_platform_views.FindHandle(id);
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view != nullptr && !view->surface && view->claim_id == 0) {
+      RUNNER_LOG_DEBUG("Restoring platform view {}", id);
+      ClaimSurface(handle);
+    }
+  }
+};
+
+WebViewLifecycleDelegate g_lifecycle_delegate;
+
+// Carries out |g_view_recovery|'s decisions on platform views.
+class WebViewRecoveryDelegate : public ViewRecoveryDelegate {
+ public:
+  // ViewRecoveryDelegate:
+  void ReplaceController(RecoveryViewId id) override {
+    SlotHandle handle = g_platform_views.FindHandle(id);
+    WebViewPlatformView* view = g_platform_views.Get(handle);
+    if (view == nullptr || view->claim_id != 0) {
+      // Gone, or a surface is on its way already.
+      return;
+    }
+    RUNNER_LOG_INFO("Replacing the controller of platform view {}", id);
+    DestroyFailedWebView(view);
+    // Reloads the page in place of the view's start page; its scripts
+    // come from its creation params.
+    view->restore_url = view->committed_url;
+    ClaimSurface(handle);
+  }
+
+  void RestartBrowser() override {
+    RUNNER_LOG_ERROR("Webview browser process exited; restarting it");
+    // The standby controllers went down with the browser.
+    g_controller_pool->Clear();
+    g_webview_environment->RestartBrowser();
+    g_controller_pool->Prewarm();
+  }
+
+  void AbandonView(RecoveryViewId id) override {
+    RUNNER_LOG_ERROR("Platform view {} keeps failing; giving up on it", id);
+    if (WebViewPlatformView* view = g_platform_views.Find(id)) {
+      DestroyFailedWebView(view);
+    }
+  }
+
+  void ViewRecovered(RecoveryViewId id,
+                     std::chrono::nanoseconds recovery_time) override {
+    uint64_t recovery_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(recovery_time)
+            .count());
+    RUNNER_LOG_INFO("Platform view {} recovered in {}us", id, recovery_us);
+    g_recovery_us->Record(recovery_us);
+  }
+};
+
+WebViewRecoveryDelegate g_recovery_delegate;
+
+}  // namespace
+
+FlutterWindow::FlutterWindow(const flutter::DartProject& project,
+                             TaskScheduler* scheduler)
+    : project_(project), scheduler_(scheduler) {}
+
+FlutterWindow::~FlutterWindow() {}
+
+bool FlutterWindow::OnCreate() {
+  RUNNER_TRACE_SCOPE("FlutterWindow::OnCreate");
+  if (!Win32Window::OnCreate()) {
+    return false;
+  }
+
+  RECT frame = GetClientArea();
+
+  // The size here must match the window dimensions to avoid unnecessary surface
+  // creation / destruction in the startup path.
+  {
+    RUNNER_TRACE_SCOPE("FlutterViewController");
+    flutter_controller_ = std::make_unique<flutter::FlutterViewController>(
+        frame.right - frame.left, frame.bottom - frame.top, project_);
+  }
+  // Ensure that basic setup of the controller was successful.
+  if (!flutter_controller_->engine() || !flutter_controller_->view()) {
+    return false;
+  }
+  RegisterPlugins(flutter_controller_->engine());
+  SetChildContent(flutter_controller_->view()->GetNativeWindow());
+
+  g_texture_views = UseTextureViews();
+  if (g_texture_views) {
+    RUNNER_LOG_INFO("Showing platform views as textures");
+    g_texture_registrar = flutter_controller_->engine()->texture_registrar();
+    g_texture_channel =
+        std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
+            flutter_controller_->engine()->messenger(), kTextureChannelName,
+            &flutter::StandardMethodCodec::GetInstance());
+  }
+
+  g_overlay_channel =
+      std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
+          flutter_controller_->engine()->messenger(), kOverlayChannelName,
+          &flutter::StandardMethodCodec::GetInstance());
+  g_overlay_channel->SetMethodCallHandler(HandleOverlayCall);
+
+  g_metrics_channel =
+      std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
+          flutter_controller_->engine()->messenger(), kMetricsChannelName,
+          &flutter::StandardMethodCodec::GetInstance());
+  g_metrics_channel->SetMethodCallHandler(HandleMetricsCall);
+
+  flutter_controller_->engine()->messenger()->SetMessageHandler(
+      kCreationParamsChannelName, HandleCreationParamsMessage);
+
+  RegisterRpcMethods();
+
+  // Register webview class
+  WNDCLASSEX wnd;
+  wnd.cbSize = sizeof(wnd);
+  wnd.lpszClassName = L"Webview";
+  wnd.hIconSm = NULL;
+  wnd.cbClsExtra = 0;
+  wnd.cbWndExtra = sizeof(void*) * 1;
+  wnd.lpszMenuName = NULL;
+  wnd.hIcon = NULL;
+  wnd.hCursor = NULL;
+  wnd.hInstance = GetModuleHandle(nullptr);
+  wnd.style = CS_HREDRAW | CS_VREDRAW;
+  wnd.hbrBackground = (HBRUSH)(COLOR_HIGHLIGHT + 1);
+  wnd.lpfnWndProc = WebViewWndProc;
+
+  ATOM webview_class;
+  {
+    RUNNER_TRACE_SCOPE("RegisterClassEx");
+    webview_class = RegisterClassEx(&wnd);
+  }
+  RUNNER_LOG_INFO("Register window class returns {}", webview_class);
+
+  g_task_scheduler = scheduler_;
+  if (MetricsFileRequested()) {
+    PostTaskOnce(&g_metrics_write_pending,
+                 std::chrono::steady_clock::now() + kMetricsWriteInterval,
+                 WriteMetricsPeriodically);
+  }
+  g_focus_graph = std::make_unique<FocusGraph>(g_task_scheduler,
+                                               OnPlatformViewFocusChanged);
+  g_navigation_policy = LoadNavigationPolicy();
+
+  // Start the browser environment now so the first platform view does not
+  // have to wait for it.
+  g_webview_environment = std::make_unique<WebViewEnvironment>(scheduler_);
+  ServeAssetPack();
+  g_controller_pool = std::make_unique<ControllerPool<WebViewSurface>>(
+      g_webview_environment.get(),
+      ControllerPool<WebViewSurface>::Options{
+          kIdleControllerCapacity, kWarmControllerCount,
+          kMaxIdleControllerTime});
+  g_controller_pool->Prewarm();
+
+  ViewLifecycleOptions lifecycle_options;
+  lifecycle_options.max_live_views = kMaxLiveWebViews;
+  lifecycle_options.memory_budget_bytes = kWebViewMemoryBudget;
+  g_view_lifecycle = std::make_unique<ViewLifecycleManager>(
+      &g_lifecycle_delegate, lifecycle_options);
+  g_view_recovery = std::make_unique<ViewRecoveryManager>(
+      &g_recovery_delegate, ViewRecoveryOptions());
+
+  flutter_controller_->engine()->RegisterPlatformViewType("test", [](const PlatformViewCreationParams* params) {
+    RUNNER_TRACE_SCOPE("CreatePlatformView");
+    flutter::FlutterViewController* view_controller = (flutter::FlutterViewController*)params->user_data;
+    WebViewPlatformView view;
+    TakeCreationParams(&view);
+    // Start out at the requested size, or covering the parent; the engine
+    // moves and sizes the view before it is composited, which a recycled
+    // surface follows via WM_SIZE.
+    RECT rect;
+    GetClientRect(params->parent, &rect);
+    RUNNER_LOG_DEBUG("Parent is {} x {}", rect.right, rect.bottom);
+    if (view.creation_params.width > 0) {
+      rect.right = view.creation_params.width;
+    }
+    if (view.creation_params.height > 0) {
+      rect.bottom = view.creation_params.height;
+    }
+    // Texture views keep their window hidden; it still gives the web view
+    // its size and a home in the window tree.
+    DWORD style = g_texture_views ? WS_CHILD : WS_VISIBLE | WS_CHILD;
+    HWND hWnd = CreateWindow(L"Webview", L"testwebview", style, 0, 0, rect.right, rect.bottom, params->parent, NULL, NULL, (LPVOID)view_controller);
+    RUNNER_LOG_INFO("Creating platform view #{} with parent {}", hWnd, params->parent);
+    if (hWnd == nullptr) {
+      return hWnd;
+    }
+
+    view.hwnd = hWnd;
+    view.view_controller = view_controller;
+    if (g_texture_views) {
+      view.texture = std::make_unique<WebViewTexture>(g_texture_registrar);
+      NotifyTextureView("textureCreated", KeyFromWindow(hWnd),
+                        view.texture->id());
+      SetTimer(hWnd, kCaptureTimerId, kCaptureIntervalMs, nullptr);
+    }
+    SlotHandle handle = g_platform_views.Add(KeyFromWindow(hWnd), std::move(view));
+    g_live_views->Add(1);
+    g_view_lifecycle->AddView(KeyFromWindow(hWnd),
+                              ViewLifecycleManager::Clock::now());
+    g_view_recovery->AddView(KeyFromWindow(hWnd));
+    g_focus_graph->AddNode(KeyFromWindow(hWnd), IntRectFromRect(rect));
+    if (!g_texture_views) {
+      g_occlusion.SetViewBounds(KeyFromWindow(hWnd), IntRectFromRect(rect));
+      ScheduleViewClipping();
+    }
+    ClaimSurface(handle);
+
+    /*UpdateWindow(hWnd);
+    auto style = GetWindowLong(params->parent, GWL_STYLE);
+    style |= WS_CLIPCHILDREN | WS_TABSTOP;
+    SetWindowLong(params->parent, GWL_STYLE, style);
+    UpdateWindow(params->parent);*/
+    return hWnd;
+  }, (void*)flutter_controller_.get());
+
+  TraceAsyncBegin("FirstFrame", 0);
+  flutter_controller_->engine()->SetNextFrameCallback([&]() {
+    TraceAsyncEnd("FirstFrame", 0);
+    OnFramePresented();
+    RUNNER_TRACE_SCOPE("Show");
+    this->Show();
+  });
+
+  // Flutter can complete the first frame before the "show window" callback is
+  // registered. The following call ensures a frame is pending to ensure the
+  // window is shown. It is a no-op if the first frame hasn't completed yet.
+  flutter_controller_->ForceRedraw();
+
+  return true;
+}
+
+void FlutterWindow::OnFramePresented() {
+  g_geometry.OnFramePresented();
+  CommitGeometry(true);
+  // Frame callbacks are one-shot; stay subscribed to every frame so the
+  // lag of each geometry change can be measured in frames.
+  if (flutter_controller_) {
+    flutter_controller_->engine()->SetNextFrameCallback(
+        [this]() { OnFramePresented(); });
+  }
+}
+
+void FlutterWindow::OnDestroy() {
+  // Textures have to be unregistered while the engine is still running.
+  g_platform_views.ForEach([](PlatformViewKey, WebViewPlatformView& view) {
+    view.texture = nullptr;
+  });
+  g_texture_channel = nullptr;
+  g_texture_registrar = nullptr;
+  g_overlay_channel = nullptr;
+  g_metrics_channel = nullptr;
+  if (flutter_controller_) {
+    flutter_controller_->engine()->messenger()->SetMessageHandler(
+        kCreationParamsChannelName, nullptr);
+  }
+  g_pending_creation_params.clear();
+
+  if (flutter_controller_) {
+    flutter_controller_ = nullptr;
+  }
+
+  const GeometryTransactionStats& geometry = g_geometry.stats();
+  RUNNER_LOG_INFO("Geometry: {} commits, {} unpresented, frame lag 0/1/2/3+: {}/{}/{}/{}, max delay {}us",
+                  geometry.commits, geometry.unpresented_commits,
+                  geometry.frame_lag[0], geometry.frame_lag[1],
+                  geometry.frame_lag[2], geometry.frame_lag[3],
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      geometry.max_commit_delay)
+                      .count());
+
+  const RpcRouterStats& rpc = g_rpc_router.stats();
+  RUNNER_LOG_INFO("RPC: {} requests, {} notifications, {} invalid, {} unknown methods, {} errors",
+                  rpc.requests, rpc.notifications, rpc.invalid,
+                  rpc.unknown_methods, rpc.errors);
+
+  const OcclusionTrackerStats& occlusion = g_occlusion.stats();
+  RUNNER_LOG_INFO("Occlusion: {} overlay updates, {} unchanged, {} regions computed, {} applied",
+                  occlusion.overlay_updates, occlusion.unchanged_overlays,
+                  occlusion.recomputed, occlusion.changed);
+
+  if (g_view_lifecycle) {
+    const ViewLifecycleStats& stats = g_view_lifecycle->stats();
+    RUNNER_LOG_INFO("View lifecycle: {} suspended, {} discarded, {} restored",
+                    stats.suspended, stats.discarded, stats.restored);
+    g_view_lifecycle = nullptr;
+  }
+  if (g_view_recovery) {
+    const ViewRecoveryStats& stats = g_view_recovery->stats();
+    RUNNER_LOG_INFO("View recovery: {} renderer and {} browser failures, {} recovered, {} abandoned, max recovery {}us",
+                    stats.renderer_failures, stats.browser_failures,
+                    stats.recovered, stats.abandoned,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        stats.max_recovery_time)
+                        .count());
+    g_view_recovery = nullptr;
+  }
+  if (g_controller_pool) {
+    const ControllerPoolStats& stats = g_controller_pool->stats();
+    RUNNER_LOG_INFO("Controller pool: {} hits, {} misses, {} evicted, max claim latency {}us",
+                    stats.hits, stats.misses, stats.evicted,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        stats.max_claim_latency)
+                        .count());
+    g_controller_pool = nullptr;
+  }
+  g_webview_environment = nullptr;
+  g_focus_graph = nullptr;
+
+  if (g_navigation_policy) {
+    for (size_t rule = 0; rule < g_navigation_policy->rule_count(); ++rule) {
+      if (g_navigation_policy->hits(rule) > 0) {
+        RUNNER_LOG_INFO("Navigation rule '{}': {} hits",
+                        g_navigation_policy->rule_text(rule),
+                        g_navigation_policy->hits(rule));
+      }
+    }
+    RUNNER_LOG_INFO("Navigation default: {} hits",
+                    g_navigation_policy->hits(NavigationPolicy::kDefaultRule));
+    g_navigation_policy.reset();
+  }
+
+  Win32Window::OnDestroy();
+}
+
+LRESULT
+FlutterWindow::MessageHandler(HWND hwnd, UINT const message,
+                              WPARAM const wparam,
+                              LPARAM const lparam) noexcept {
+  // Give Flutter, including plugins, an opportunity to handle window messages.
+  if (flutter_controller_) {
+    std::optional<LRESULT> result =
+        flutter_controller_->HandleTopLevelWindowProc(hwnd, message, wparam,
+                                                      lparam);
+    if (result) {
+      return *result;
+    }
+  }
+
+  switch (message) {
+    case WM_FONTCHANGE:
+      flutter_controller_->engine()->ReloadSystemFonts();
+      break;
+  }
+
+  return Win32Window::MessageHandler(hwnd, message, wparam, lparam);
+}
@@ -6,13 +6,15 @@
 
 #include <memory>
 
+#include "task_scheduler.h"
 #include "win32_window.h"
 
 // A window that does nothing but host a Flutter view.
 class FlutterWindow : public Win32Window {
  public:
   // Creates a new FlutterWindow hosting a Flutter view running |project|.
-  explicit FlutterWindow(const flutter::DartProject& project);
+  // Deferred work is posted to |scheduler|, which must outlive the window.
+  FlutterWindow(const flutter::DartProject& project, TaskScheduler* scheduler);
   virtual ~FlutterWindow();
 
  protected:
@@ -23,9 +25,16 @@ class FlutterWindow : public Win32Window {
                          LPARAM const lparam) noexcept override;
 
  private:
+  // Applies the platform view geometry laid out for the frame the engine
+  // just presented, and waits for the next frame.
+  void OnFramePresented();
+
   // The project to run.
   flutter::DartProject project_;
 
+  // The main loop's scheduler.
+  TaskScheduler* scheduler_;
+
   // The Flutter instance hosted by this window.
   std::unique_ptr<flutter::FlutterViewController> flutter_controller_;
 };
@@ -0,0 +1,118 @@
+#include "focus_graph.h"
+
+#include <iterator>
+#include <tuple>
+#include <utility>
+
+bool FocusGraph::OrderKey::operator<(const OrderKey& other) const {
+  return std::tie(group, top, left, node) <
+         std::tie(other.group, other.top, other.left, other.node);
+}
+
+FocusGraph::FocusGraph(TaskScheduler* scheduler,
+                       FocusChangeCallback on_change)
+    : scheduler_(scheduler),
+      on_change_(std::move(on_change)),
+      self_(std::make_shared<FocusGraph*>(this)) {}
+
+bool FocusGraph::AddNode(FocusNodeId node,
+                         const IntRect& bounds,
+                         int32_t group) {
+  if (node == kNoFocusNode || nodes_.count(node) != 0) {
+    return false;
+  }
+  OrderKey key{group, bounds.top, bounds.left, node};
+  order_.insert(key);
+  nodes_.emplace(node, key);
+  return true;
+}
+
+bool FocusGraph::MoveNode(FocusNodeId node, const IntRect& bounds) {
+  auto it = nodes_.find(node);
+  if (it == nodes_.end()) {
+    return false;
+  }
+  OrderKey& key = it->second;
+  if (key.top == bounds.top && key.left == bounds.left) {
+    return true;
+  }
+  order_.erase(key);
+  key.top = bounds.top;
+  key.left = bounds.left;
+  order_.insert(key);
+  return true;
+}
+
+bool FocusGraph::RemoveNode(FocusNodeId node) {
+  auto it = nodes_.find(node);
+  if (it == nodes_.end()) {
+    return false;
+  }
+  order_.erase(it->second);
+  nodes_.erase(it);
+  if (focused_ == node) {
+    SetFocus(kNoFocusNode);
+  }
+  return true;
+}
+
+FocusNodeId FocusGraph::Next(FocusNodeId node, bool wrap) const {
+  if (order_.empty()) {
+    return kNoFocusNode;
+  }
+  auto current = nodes_.find(node);
+  if (current == nodes_.end()) {
+    return order_.begin()->node;
+  }
+  auto next = order_.upper_bound(current->second);
+  if (next == order_.end()) {
+    return wrap && order_.size() > 1 ? order_.begin()->node : kNoFocusNode;
+  }
+  return next->node;
+}
+
+FocusNodeId FocusGraph::Previous(FocusNodeId node, bool wrap) const {
+  if (order_.empty()) {
+    return kNoFocusNode;
+  }
+  auto current = nodes_.find(node);
+  if (current == nodes_.end()) {
+    return order_.rbegin()->node;
+  }
+  auto it = order_.find(current->second);
+  if (it == order_.begin()) {
+    return wrap && order_.size() > 1 ? order_.rbegin()->node : kNoFocusNode;
+  }
+  return std::prev(it)->node;
+}
+
+void FocusGraph::SetFocus(FocusNodeId node) {
+  if (node != kNoFocusNode && nodes_.count(node) == 0) {
+    return;
+  }
+  focused_ = node;
+  if (report_pending_ || focused_ == reported_) {
+    return;
+  }
+  report_pending_ = true;
+  std::weak_ptr<FocusGraph*> self = self_;
+  scheduler_->PostTask(
+      [self] {
+        if (std::shared_ptr<FocusGraph*> graph = self.lock()) {
+          (*graph)->DeliverFocusChange();
+        }
+      },
+      TaskPriority::kHigh);
+}
+
+void FocusGraph::DeliverFocusChange() {
+  report_pending_ = false;
+  if (focused_ == reported_) {
+    return;
+  }
+  FocusNodeId previous = reported_;
+  reported_ = focused_;
+  if (on_change_) {
+    on_change_(previous, reported_);
+  }
+}
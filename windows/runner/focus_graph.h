@@ -0,0 +1,95 @@
+#ifndef RUNNER_FOCUS_GRAPH_H_
+#define RUNNER_FOCUS_GRAPH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+
+#include "geometry.h"
+#include "task_scheduler.h"
+
+// Keyboard focus order and focus state for native views.
+//
+// Nodes are kept sorted in reading order, by group, then top edge, then
+// left edge, and are re-sorted individually as they are added, moved and
+// removed, so the next and previous node are found in O(log n) without
+// rediscovering the order.
+//
+// Focus changes are not reported from inside |SetFocus|, which is often
+// called from window procedures and COM callbacks. Instead a task is posted
+// that reports the latest focus to the listener once the current work is
+// done; several changes before it runs are reported as one.
+
+using FocusNodeId = uint64_t;
+
+// Identifies no node: focus is elsewhere, or there is no neighbour.
+constexpr FocusNodeId kNoFocusNode = 0;
+
+class FocusGraph {
+ public:
+  // Receives the node that had focus when the listener was last called and
+  // the node that has it now, either of which may be kNoFocusNode.
+  using FocusChangeCallback =
+      std::function<void(FocusNodeId previous, FocusNodeId current)>;
+
+  // Reports focus changes to |on_change| through tasks on |scheduler|, which
+  // must outlive the graph.
+  FocusGraph(TaskScheduler* scheduler, FocusChangeCallback on_change);
+
+  FocusGraph(const FocusGraph&) = delete;
+  FocusGraph& operator=(const FocusGraph&) = delete;
+
+  // Adds |node| at |bounds|. Nodes in a lower |group| come first. Returns
+  // false if |node| is kNoFocusNode or already present.
+  bool AddNode(FocusNodeId node, const IntRect& bounds, int32_t group = 0);
+
+  // Moves |node| to |bounds|. Returns false if it is not present.
+  bool MoveNode(FocusNodeId node, const IntRect& bounds);
+
+  // Removes |node|, clearing focus if it had it. Returns false if it was
+  // not present.
+  bool RemoveNode(FocusNodeId node);
+
+  // Return the node after or before |node| in focus order, wrapping around
+  // at the ends if |wrap|, or kNoFocusNode if there is none. Passing
+  // kNoFocusNode returns the first or last node.
+  FocusNodeId Next(FocusNodeId node, bool wrap = true) const;
+  FocusNodeId Previous(FocusNodeId node, bool wrap = true) const;
+
+  // Records that |node| has focus, or that no node does.
+  void SetFocus(FocusNodeId node);
+
+  FocusNodeId focused() const { return focused_; }
+  bool Contains(FocusNodeId node) const { return nodes_.count(node) != 0; }
+  size_t size() const { return nodes_.size(); }
+
+ private:
+  struct OrderKey {
+    int32_t group;
+    int32_t top;
+    int32_t left;
+    FocusNodeId node;
+
+    bool operator<(const OrderKey& other) const;
+  };
+
+  // Reports focus to the listener if it changed since the last report.
+  void DeliverFocusChange();
+
+  TaskScheduler* scheduler_;
+  FocusChangeCallback on_change_;
+  std::set<OrderKey> order_;
+  // Each node's current key in |order_|.
+  std::unordered_map<FocusNodeId, OrderKey> nodes_;
+  FocusNodeId focused_ = kNoFocusNode;
+  // The focus last reported to the listener.
+  FocusNodeId reported_ = kNoFocusNode;
+  bool report_pending_ = false;
+  // Lets posted reports detect that the graph has been destroyed.
+  std::shared_ptr<FocusGraph*> self_;
+};
+
+#endif  // RUNNER_FOCUS_GRAPH_H_
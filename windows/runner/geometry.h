@@ -0,0 +1,25 @@
+#ifndef RUNNER_GEOMETRY_H_
+#define RUNNER_GEOMETRY_H_
+
+#include <cstdint>
+
+// A rectangle in physical pixels with exclusive right and bottom edges,
+// laid out like a Win32 RECT but usable from platform-neutral code.
+struct IntRect {
+  int32_t left = 0;
+  int32_t top = 0;
+  int32_t right = 0;
+  int32_t bottom = 0;
+
+  int32_t width() const { return right - left; }
+  int32_t height() const { return bottom - top; }
+  bool IsEmpty() const { return right <= left || bottom <= top; }
+
+  bool operator==(const IntRect& other) const {
+    return left == other.left && top == other.top && right == other.right &&
+           bottom == other.bottom;
+  }
+  bool operator!=(const IntRect& other) const { return !(*this == other); }
+};
+
+#endif  // RUNNER_GEOMETRY_H_
@@ -0,0 +1,118 @@
+#include "geometry_transaction.h"
+
+#include <algorithm>
+#include <utility>
+
+bool GeometryTransaction::SetBounds(GeometryViewId view,
+                                    const IntRect& bounds,
+                                    Clock::time_point now) {
+  bool was_empty = pending_.empty();
+  Pending* entry = Entry(view, now);
+  if (entry->change.bounds) {
+    ++stats_.merged;
+  }
+  entry->change.bounds = bounds;
+  return was_empty;
+}
+
+bool GeometryTransaction::SetVisible(GeometryViewId view,
+                                     bool visible,
+                                     Clock::time_point now) {
+  bool was_empty = pending_.empty();
+  Pending* entry = Entry(view, now);
+  if (entry->change.visible) {
+    ++stats_.merged;
+  }
+  entry->change.visible = visible;
+  return was_empty;
+}
+
+bool GeometryTransaction::SetInsertAfter(GeometryViewId view,
+                                         uint64_t insert_after,
+                                         Clock::time_point now) {
+  bool was_empty = pending_.empty();
+  Pending* entry = Entry(view, now);
+  if (entry->change.insert_after) {
+    ++stats_.merged;
+  }
+  entry->change.insert_after = insert_after;
+  return was_empty;
+}
+
+void GeometryTransaction::RemoveView(GeometryViewId view) {
+  pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+                                [view](const Pending& pending) {
+                                  return pending.change.view == view;
+                                }),
+                 pending_.end());
+}
+
+std::vector<GeometryChange> GeometryTransaction::Commit(Clock::time_point now,
+                                                        bool presented) {
+  std::vector<GeometryChange> changes;
+  if (pending_.empty()) {
+    return changes;
+  }
+  ++stats_.commits;
+  if (!presented) {
+    ++stats_.unpresented_commits;
+  }
+  stats_.views_committed += pending_.size();
+  changes.reserve(pending_.size());
+
+  // Hidden first, shown last; otherwise in the order first changed.
+  auto group = [](const Pending& pending) {
+    if (!pending.change.visible) {
+      return 1;
+    }
+    return *pending.change.visible ? 2 : 0;
+  };
+  for (int current = 0; current <= 2; ++current) {
+    for (Pending& pending : pending_) {
+      if (group(pending) != current) {
+        continue;
+      }
+      uint64_t lag = frame_ - pending.first_frame;
+      ++stats_.frame_lag[std::min<uint64_t>(lag, 3)];
+      if (now - pending.first_change > stats_.max_commit_delay) {
+        stats_.max_commit_delay = now - pending.first_change;
+      }
+      changes.push_back(std::move(pending.change));
+    }
+  }
+  pending_.clear();
+  return changes;
+}
+
+bool GeometryTransaction::has_pending(GeometryViewId view) const {
+  for (const Pending& pending : pending_) {
+    if (pending.change.view == view) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::optional<GeometryTransaction::Clock::time_point>
+GeometryTransaction::pending_since() const {
+  if (pending_.empty()) {
+    return std::nullopt;
+  }
+  return pending_.front().first_change;
+}
+
+GeometryTransaction::Pending* GeometryTransaction::Entry(GeometryViewId view,
+                                                         Clock::time_point now) {
+  ++stats_.changes;
+  for (Pending& pending : pending_) {
+    if (pending.change.view == view) {
+      return &pending;
+    }
+  }
+  Pending pending;
+  pending.change.view = view;
+  pending.first_frame = frame_;
+  pending.first_change = now;
+  pending_.push_back(pending);
+  return &pending_.back();
+}
@@ -0,0 +1,109 @@
+#ifndef RUNNER_GEOMETRY_TRANSACTION_H_
+#define RUNNER_GEOMETRY_TRANSACTION_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "geometry.h"
+
+// Collects native geometry changes for all platform views into one
+// transaction per presented frame.
+//
+// The engine moves, shows, hides and restacks platform view windows while it
+// lays out a frame, but the frame itself reaches the screen later. Applying
+// the changes immediately lets the native views run ahead of the Flutter
+// content around them. Instead, the changes are recorded here as they are
+// requested and committed together when the engine reports that the frame
+// was presented.
+//
+// The transaction keeps the latest value of each property per view, and
+// |Commit| returns the views in an order that never exposes stale content:
+// views being hidden first, then views that only move, resize or restack,
+// then views being shown, each group in the order the views were first
+// changed.
+
+using GeometryViewId = uint64_t;
+
+// The pending changes for one view. Unset properties keep their value.
+struct GeometryChange {
+  GeometryViewId view = 0;
+  std::optional<IntRect> bounds;
+  std::optional<bool> visible;
+  // Platform handle of the sibling to place the view after, as passed to
+  // SetWindowPos.
+  std::optional<uint64_t> insert_after;
+};
+
+struct GeometryTransactionStats {
+  // Every |Set*| call, and those that overwrote a pending value.
+  uint64_t changes = 0;
+  uint64_t merged = 0;
+  // Non-empty commits, how many of those were not triggered by a presented
+  // frame, and the views they applied.
+  uint64_t commits = 0;
+  uint64_t unpresented_commits = 0;
+  uint64_t views_committed = 0;
+  // Presented frames between a view's first change and its commit: 0, 1, 2
+  // and 3 or more. One is the expected lag when the engine lays out and
+  // presents in the same frame.
+  uint64_t frame_lag[4] = {};
+  // Longest time from a view's first change to its commit.
+  std::chrono::nanoseconds max_commit_delay{0};
+};
+
+class GeometryTransaction {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Record a change to |view| requested at |now|. Return true if the
+  // transaction was empty before, so a commit needs to be scheduled.
+  bool SetBounds(GeometryViewId view,
+                 const IntRect& bounds,
+                 Clock::time_point now);
+  bool SetVisible(GeometryViewId view, bool visible, Clock::time_point now);
+  bool SetInsertAfter(GeometryViewId view,
+                      uint64_t insert_after,
+                      Clock::time_point now);
+
+  // Drops any pending changes for |view|, e.g. when it is destroyed.
+  void RemoveView(GeometryViewId view);
+
+  // Records that the engine presented a frame.
+  void OnFramePresented() { ++frame_; }
+
+  // Returns the pending changes in commit order and starts a new
+  // transaction. |presented| is false when committing without a presented
+  // frame, such as after a timeout.
+  std::vector<GeometryChange> Commit(Clock::time_point now, bool presented);
+
+  bool has_pending() const { return !pending_.empty(); }
+  bool has_pending(GeometryViewId view) const;
+
+  // When the oldest pending change was recorded.
+  std::optional<Clock::time_point> pending_since() const;
+
+  uint64_t frame() const { return frame_; }
+  const GeometryTransactionStats& stats() const { return stats_; }
+
+ private:
+  struct Pending {
+    GeometryChange change;
+    // Frame counter and time at the view's first change.
+    uint64_t first_frame;
+    Clock::time_point first_change;
+  };
+
+  // Returns |view|'s pending entry, adding one if needed.
+  Pending* Entry(GeometryViewId view, Clock::time_point now);
+
+  // Pending views in the order of their first change. A frame touches a
+  // handful of views, so lookups scan linearly.
+  std::vector<Pending> pending_;
+  uint64_t frame_ = 0;
+  GeometryTransactionStats stats_;
+};
+
+#endif  // RUNNER_GEOMETRY_TRANSACTION_H_
@@ -0,0 +1,758 @@
+#include "json.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RUNNER_JSON_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RUNNER_JSON_NEON 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Returns the index of the lowest set bit of |mask|, which is non-zero.
+int LowestBit(uint64_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+bool IsStringSpecial(unsigned char c) {
+  return c == '"' || c == '\\' || c < 0x20;
+}
+
+// Returns the offset of the first quote, backslash or control character in
+// [p, end), or end - p if there is none. Strings in web messages are mostly
+// long runs of ordinary text, so they are scanned in whole SIMD blocks.
+size_t ScanString(const char* p, const char* end) {
+  size_t length = static_cast<size_t>(end - p);
+  size_t i = 0;
+#if defined(RUNNER_JSON_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    // Bytes up to 0x1F are the ones |max| leaves at 0x1F.
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                     _mm_cmpeq_epi8(block, backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+    int mask = _mm_movemask_epi8(special);
+    if (mask != 0) {
+      return i + LowestBit(static_cast<uint64_t>(mask));
+    }
+  }
+#elif defined(RUNNER_JSON_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t control = vdupq_n_u8(0x1F);
+  for (; i + 16 <= length; i += 16) {
+    uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p + i));
+    uint8x16_t special =
+        vorrq_u8(vorrq_u8(vceqq_u8(block, quote), vceqq_u8(block, backslash)),
+                 vcleq_u8(block, control));
+    // Narrow each byte of the comparison to four bits of a 64-bit mask.
+    uint64_t mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(special), 4)),
+        0);
+    if (mask != 0) {
+      return i + LowestBit(mask) / 4;
+    }
+  }
+#endif
+  for (; i < length; ++i) {
+    if (IsStringSpecial(static_cast<unsigned char>(p[i]))) {
+      return i;
+    }
+  }
+  return length;
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Decodes the four hex digits at |p|.
+bool DecodeHex4(const char* p, uint32_t* unit) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    int digit = HexValue(p[i]);
+    if (digit < 0) {
+      return false;
+    }
+    value = value * 16 + static_cast<uint32_t>(digit);
+  }
+  *unit = value;
+  return true;
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+void AppendUtf8(uint32_t code_point, std::string* output) {
+  if (code_point < 0x80) {
+    output->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    output->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    output->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    output->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+// Decodes the UTF-8 sequence at the start of |input|, storing its length in
+// |length|. Invalid sequences decode to U+FFFD with a length of one.
+uint32_t DecodeUtf8(std::string_view input, size_t* length) {
+  constexpr uint32_t kReplacement = 0xFFFD;
+  unsigned char lead = static_cast<unsigned char>(input[0]);
+  *length = 1;
+  size_t size;
+  uint32_t code_point;
+  uint32_t min;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    size = 2;
+    code_point = lead & 0x1F;
+    min = 0x80;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    size = 3;
+    code_point = lead & 0x0F;
+    min = 0x800;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    size = 4;
+    code_point = lead & 0x07;
+    min = 0x10000;
+  } else {
+    return kReplacement;
+  }
+  if (input.size() < size) {
+    return kReplacement;
+  }
+  for (size_t i = 1; i < size; ++i) {
+    unsigned char c = static_cast<unsigned char>(input[i]);
+    if ((c & 0xC0) != 0x80) {
+      return kReplacement;
+    }
+    code_point = (code_point << 6) | (c & 0x3F);
+  }
+  if (code_point < min || code_point > 0x10FFFF ||
+      (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+    return kReplacement;
+  }
+  *length = size;
+  return code_point;
+}
+
+void AppendUnicodeEscape(uint32_t unit, std::string* output) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  char escape[6] = {'\\',
+                    'u',
+                    kHex[(unit >> 12) & 0xF],
+                    kHex[(unit >> 8) & 0xF],
+                    kHex[(unit >> 4) & 0xF],
+                    kHex[unit & 0xF]};
+  output->append(escape, sizeof(escape));
+}
+
+}  // namespace
+
+// Recursive descent over the input, appending nodes in document order.
+class JsonDocument::Parser {
+ public:
+  Parser(JsonDocument* document, std::string_view json)
+      : document_(document),
+        begin_(json.data()),
+        p_(json.data()),
+        end_(json.data() + json.size()) {}
+
+  bool Run(std::string* error) {
+    bool ok = ParseValue(0);
+    if (ok) {
+      SkipWhitespace();
+      if (p_ != end_) {
+        ok = Fail("unexpected characters after the value");
+      }
+    }
+    if (!ok && error != nullptr) {
+      *error = std::string(error_) + " at offset " +
+               std::to_string(p_ - begin_);
+    }
+    return ok;
+  }
+
+ private:
+  bool Fail(const char* message) {
+    error_ = message;
+    return false;
+  }
+
+  void SkipWhitespace() {
+    while (p_ != end_ &&
+           (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) {
+      ++p_;
+    }
+  }
+
+  // Appends a zeroed node of |type| with no children.
+  uint32_t AddNode(JsonType type) {
+    Node& node = document_->nodes_.emplace_back();
+    node.type = type;
+    uint32_t index = static_cast<uint32_t>(document_->nodes_.size() - 1);
+    node.end = index + 1;
+    return index;
+  }
+
+  bool ParseValue(size_t depth) {
+    SkipWhitespace();
+    if (p_ == end_) {
+      return Fail("unexpected end of input");
+    }
+    switch (*p_) {
+      case '{':
+      case '[':
+        if (depth == kMaxDepth) {
+          return Fail("nesting is too deep");
+        }
+        return *p_ == '{' ? ParseObject(depth) : ParseArray(depth);
+      case '"': {
+        uint32_t node = AddNode(JsonType::kString);
+        std::string_view value;
+        if (!ParseString(&value)) {
+          return false;
+        }
+        document_->nodes_[node].text = value;
+        return true;
+      }
+      case 't':
+        return ParseLiteral("true", JsonType::kBool, true);
+      case 'f':
+        return ParseLiteral("false", JsonType::kBool, false);
+      case 'n':
+        return ParseLiteral("null", JsonType::kNull, false);
+      default:
+        if (*p_ == '-' || IsDigit(*p_)) {
+          return ParseNumber();
+        }
+        return Fail("unexpected character");
+    }
+  }
+
+  bool ParseObject(size_t depth) {
+    uint32_t node = AddNode(JsonType::kObject);
+    ++p_;
+    uint32_t count = 0;
+    SkipWhitespace();
+    if (p_ != end_ && *p_ == '}') {
+      ++p_;
+    } else {
+      while (true) {
+        SkipWhitespace();
+        if (p_ == end_ || *p_ != '"') {
+          return Fail("expected a member name");
+        }
+        uint32_t key = AddNode(JsonType::kString);
+        std::string_view name;
+        if (!ParseString(&name)) {
+          return false;
+        }
+        document_->nodes_[key].text = name;
+        SkipWhitespace();
+        if (p_ == end_ || *p_ != ':') {
+          return Fail("expected ':'");
+        }
+        ++p_;
+        if (!ParseValue(depth + 1)) {
+          return false;
+        }
+        ++count;
+        SkipWhitespace();
+        if (p_ != end_ && *p_ == ',') {
+          ++p_;
+        } else if (p_ != end_ && *p_ == '}') {
+          ++p_;
+          break;
+        } else {
+          return Fail("expected ',' or '}'");
+        }
+      }
+    }
+    Node& object = document_->nodes_[node];
+    object.count = count;
+    object.end = static_cast<uint32_t>(document_->nodes_.size());
+    return true;
+  }
+
+  bool ParseArray(size_t depth) {
+    uint32_t node = AddNode(JsonType::kArray);
+    ++p_;
+    uint32_t count = 0;
+    SkipWhitespace();
+    if (p_ != end_ && *p_ == ']') {
+      ++p_;
+    } else {
+      while (true) {
+        if (!ParseValue(depth + 1)) {
+          return false;
+        }
+        ++count;
+        SkipWhitespace();
+        if (p_ != end_ && *p_ == ',') {
+          ++p_;
+        } else if (p_ != end_ && *p_ == ']') {
+          ++p_;
+          break;
+        } else {
+          return Fail("expected ',' or ']'");
+        }
+      }
+    }
+    Node& array = document_->nodes_[node];
+    array.count = count;
+    array.end = static_cast<uint32_t>(document_->nodes_.size());
+    return true;
+  }
+
+  // Parses the string starting at the quote at |p_|.
+  bool ParseString(std::string_view* value) {
+    const char* start = ++p_;
+    p_ += ScanString(p_, end_);
+    if (p_ == end_) {
+      return Fail("unterminated string");
+    }
+    if (*p_ == '"') {
+      *value = std::string_view(start, static_cast<size_t>(p_ - start));
+      ++p_;
+      return true;
+    }
+    // Unescape from the first escape on, into the document's storage.
+    std::string& strings = document_->strings_;
+    size_t offset = strings.size();
+    strings.append(start, p_);
+    while (true) {
+      if (p_ == end_) {
+        return Fail("unterminated string");
+      }
+      char c = *p_;
+      if (c == '"') {
+        ++p_;
+        break;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+        return Fail("control character in string");
+      }
+      if (c != '\\') {
+        size_t run = ScanString(p_, end_);
+        strings.append(p_, run);
+        p_ += run;
+        continue;
+      }
+      if (++p_ == end_) {
+        return Fail("unterminated string");
+      }
+      switch (*p_++) {
+        case '"':
+          strings.push_back('"');
+          break;
+        case '\\':
+          strings.push_back('\\');
+          break;
+        case '/':
+          strings.push_back('/');
+          break;
+        case 'b':
+          strings.push_back('\b');
+          break;
+        case 'f':
+          strings.push_back('\f');
+          break;
+        case 'n':
+          strings.push_back('\n');
+          break;
+        case 'r':
+          strings.push_back('\r');
+          break;
+        case 't':
+          strings.push_back('\t');
+          break;
+        case 'u': {
+          uint32_t unit;
+          if (!ParseHex4(&unit)) {
+            return false;
+          }
+          // A high surrogate combines with an escaped low one after it;
+          // unpaired surrogates become U+FFFD.
+          uint32_t code_point = unit;
+          uint32_t low;
+          if (unit >= 0xD800 && unit <= 0xDBFF && end_ - p_ >= 6 &&
+              p_[0] == '\\' && p_[1] == 'u' && DecodeHex4(p_ + 2, &low) &&
+              low >= 0xDC00 && low <= 0xDFFF) {
+            code_point = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+            p_ += 6;
+          } else if (unit >= 0xD800 && unit <= 0xDFFF) {
+            code_point = 0xFFFD;
+          }
+          AppendUtf8(code_point, &strings);
+          break;
+        }
+        default:
+          --p_;
+          return Fail("invalid escape");
+      }
+    }
+    *value = std::string_view(strings.data() + offset, strings.size() - offset);
+    return true;
+  }
+
+  bool ParseHex4(uint32_t* unit) {
+    if (end_ - p_ < 4 || !DecodeHex4(p_, unit)) {
+      return Fail("invalid \\u escape");
+    }
+    p_ += 4;
+    return true;
+  }
+
+  bool ParseLiteral(std::string_view literal, JsonType type, bool value) {
+    if (static_cast<size_t>(end_ - p_) < literal.size() ||
+        std::memcmp(p_, literal.data(), literal.size()) != 0) {
+      return Fail("unexpected character");
+    }
+    p_ += literal.size();
+    uint32_t node = AddNode(type);
+    document_->nodes_[node].boolean = value;
+    return true;
+  }
+
+  // Checks the number's syntax, which std::from_chars is laxer about, then
+  // converts it: integers exactly when they fit in int64_t.
+  bool ParseNumber() {
+    const char* start = p_;
+    if (*p_ == '-') {
+      ++p_;
+    }
+    if (p_ == end_ || !IsDigit(*p_)) {
+      return Fail("invalid number");
+    }
+    if (*p_ == '0') {
+      ++p_;
+    } else {
+      while (p_ != end_ && IsDigit(*p_)) {
+        ++p_;
+      }
+    }
+    bool integral = true;
+    if (p_ != end_ && *p_ == '.') {
+      integral = false;
+      ++p_;
+      if (p_ == end_ || !IsDigit(*p_)) {
+        return Fail("invalid number");
+      }
+      while (p_ != end_ && IsDigit(*p_)) {
+        ++p_;
+      }
+    }
+    if (p_ != end_ && (*p_ == 'e' || *p_ == 'E')) {
+      integral = false;
+      ++p_;
+      if (p_ != end_ && (*p_ == '+' || *p_ == '-')) {
+        ++p_;
+      }
+      if (p_ == end_ || !IsDigit(*p_)) {
+        return Fail("invalid number");
+      }
+      while (p_ != end_ && IsDigit(*p_)) {
+        ++p_;
+      }
+    }
+
+    uint32_t index = AddNode(JsonType::kNumber);
+    Node& node = document_->nodes_[index];
+    node.text = std::string_view(start, static_cast<size_t>(p_ - start));
+    if (integral) {
+      auto result = std::from_chars(start, p_, node.integer);
+      if (result.ec == std::errc()) {
+        node.is_integer = true;
+        node.number = static_cast<double>(node.integer);
+        return true;
+      }
+    }
+    auto result = std::from_chars(start, p_, node.number);
+    if (result.ec == std::errc::result_out_of_range) {
+      // As in JavaScript, numbers too large for a double are infinite and
+      // ones too small are zero.
+      std::string_view text = node.text;
+      size_t exponent = text.find_first_of("eE");
+      bool large = exponent == std::string_view::npos
+                       ? text[text[0] == '-' ? 1 : 0] != '0'
+                       : text[exponent + 1] != '-';
+      double magnitude = large ? std::numeric_limits<double>::infinity() : 0;
+      node.number = text[0] == '-' ? -magnitude : magnitude;
+    }
+    return true;
+  }
+
+  JsonDocument* document_;
+  const char* begin_;
+  const char* p_;
+  const char* end_;
+  const char* error_ = "";
+};
+
+bool JsonDocument::Parse(std::string_view json, std::string* error) {
+  nodes_.clear();
+  strings_.clear();
+  if (json.size() >= std::numeric_limits<uint32_t>::max()) {
+    if (error != nullptr) {
+      *error = "input is too large";
+    }
+    return false;
+  }
+  strings_.reserve(json.size());
+  if (!Parser(this, json).Run(error)) {
+    nodes_.clear();
+    return false;
+  }
+  return true;
+}
+
+JsonValue JsonDocument::root() const {
+  return nodes_.empty() ? JsonValue() : JsonValue(this, 0);
+}
+
+JsonType JsonValue::type() const {
+  return document_ ? document_->nodes_[index_].type : JsonType::kNone;
+}
+
+bool JsonValue::GetBool() const {
+  return type() == JsonType::kBool && document_->nodes_[index_].boolean;
+}
+
+double JsonValue::GetNumber() const {
+  return type() == JsonType::kNumber ? document_->nodes_[index_].number : 0;
+}
+
+bool JsonValue::GetInt64(int64_t* value) const {
+  if (type() != JsonType::kNumber) {
+    return false;
+  }
+  const JsonDocument::Node& node = document_->nodes_[index_];
+  if (node.is_integer) {
+    *value = node.integer;
+    return true;
+  }
+  // Integral values written with a fraction or exponent, like 1e3.
+  double number = node.number;
+  if (std::trunc(number) != number || number < -9223372036854775808.0 ||
+      number >= 9223372036854775808.0) {
+    return false;
+  }
+  *value = static_cast<int64_t>(number);
+  return true;
+}
+
+std::string_view JsonValue::GetString() const {
+  return type() == JsonType::kString ? document_->nodes_[index_].text
+                                     : std::string_view();
+}
+
+std::string_view JsonValue::GetNumberText() const {
+  return type() == JsonType::kNumber ? document_->nodes_[index_].text
+                                     : std::string_view();
+}
+
+size_t JsonValue::size() const {
+  JsonType value_type = type();
+  return value_type == JsonType::kArray || value_type == JsonType::kObject
+             ? document_->nodes_[index_].count
+             : 0;
+}
+
+JsonValue JsonValue::At(size_t index) const {
+  if (type() != JsonType::kArray || index >= size()) {
+    return JsonValue();
+  }
+  uint32_t child = index_ + 1;
+  for (size_t i = 0; i < index; ++i) {
+    child = document_->nodes_[child].end;
+  }
+  return JsonValue(document_, child);
+}
+
+JsonValue JsonValue::Find(std::string_view key) const {
+  JsonValue found;
+  ForEachMember([&](std::string_view name, JsonValue value) {
+    if (name == key) {
+      found = value;
+    }
+  });
+  return found;
+}
+
+uint32_t JsonValue::end() const {
+  return document_->nodes_[index_].end;
+}
+
+void JsonWriter::BeforeValue() {
+  if (need_comma_) {
+    output_->push_back(',');
+  }
+  need_comma_ = true;
+}
+
+void JsonWriter::Null() {
+  BeforeValue();
+  output_->append("null");
+}
+
+void JsonWriter::Bool(bool value) {
+  BeforeValue();
+  output_->append(value ? "true" : "false");
+}
+
+void JsonWriter::Int(int64_t value) {
+  BeforeValue();
+  char buffer[24];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  output_->append(buffer, result.ptr);
+}
+
+void JsonWriter::Double(double value) {
+  if (!std::isfinite(value)) {
+    Null();
+    return;
+  }
+  BeforeValue();
+  // The shortest text that reads back as the same double.
+  char buffer[32];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  output_->append(buffer, result.ptr);
+}
+
+void JsonWriter::String(std::string_view value) {
+  BeforeValue();
+  output_->push_back('"');
+  size_t i = 0;
+  while (i < value.size()) {
+    // Copy runs that need no escaping at once.
+    size_t run = i;
+    while (run < value.size()) {
+      unsigned char c = static_cast<unsigned char>(value[run]);
+      if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\') {
+        break;
+      }
+      ++run;
+    }
+    output_->append(value.data() + i, run - i);
+    i = run;
+    if (i == value.size()) {
+      break;
+    }
+    unsigned char c = static_cast<unsigned char>(value[i]);
+    if (c < 0x80) {
+      ++i;
+      switch (c) {
+        case '"':
+          output_->append("\\\"");
+          break;
+        case '\\':
+          output_->append("\\\\");
+          break;
+        case '\n':
+          output_->append("\\n");
+          break;
+        case '\r':
+          output_->append("\\r");
+          break;
+        case '\t':
+          output_->append("\\t");
+          break;
+        default:
+          AppendUnicodeEscape(c, output_);
+          break;
+      }
+      continue;
+    }
+    size_t length;
+    uint32_t code_point = DecodeUtf8(value.substr(i), &length);
+    i += length;
+    if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      AppendUnicodeEscape(0xD800 + (code_point >> 10), output_);
+      AppendUnicodeEscape(0xDC00 + (code_point & 0x3FF), output_);
+    } else {
+      AppendUnicodeEscape(code_point, output_);
+    }
+  }
+  output_->push_back('"');
+}
+
+void JsonWriter::Raw(std::string_view json) {
+  BeforeValue();
+  output_->append(json);
+}
+
+void JsonWriter::BeginArray() {
+  BeforeValue();
+  output_->push_back('[');
+  need_comma_ = false;
+}
+
+void JsonWriter::EndArray() {
+  output_->push_back(']');
+  need_comma_ = true;
+}
+
+void JsonWriter::BeginObject() {
+  BeforeValue();
+  output_->push_back('{');
+  need_comma_ = false;
+}
+
+void JsonWriter::EndObject() {
+  output_->push_back('}');
+  need_comma_ = true;
+}
+
+void JsonWriter::Key(std::string_view key) {
+  String(key);
+  output_->push_back(':');
+  need_comma_ = false;
+}
+
+void AppendAsciiAsUtf16(std::string_view ascii, std::u16string* output) {
+  size_t offset = output->size();
+  output->resize(offset + ascii.size());
+  for (size_t i = 0; i < ascii.size(); ++i) {
+    (*output)[offset + i] = static_cast<char16_t>(ascii[i]);
+  }
+}
@@ -0,0 +1,200 @@
+#ifndef RUNNER_JSON_H_
+#define RUNNER_JSON_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A fast JSON parser and writer for web messages.
+//
+// |JsonDocument| parses UTF-8 JSON into a flat array of nodes in document
+// order, where each container records where its subtree ends, so values
+// are walked without pointers and skipped in constant time. Strings are
+// scanned for their closing quote 16 bytes at a time with SSE2 or NEON
+// when the build targets them. Strings without escapes are views into the
+// input; the rest are unescaped into storage owned by the document. Both
+// the node array and that storage keep their capacity between parses, so
+// parsing messages of a steady size does not allocate.
+//
+// The input is expected to be valid UTF-8, as produced by
+// |ConvertUtf16ToUtf8|; it is not validated.
+
+enum class JsonType : uint8_t {
+  // Not a value: what looking up a missing member or element returns.
+  kNone,
+  kNull,
+  kBool,
+  kNumber,
+  kString,
+  kArray,
+  kObject,
+};
+
+class JsonDocument;
+
+// A value in a |JsonDocument|, valid until the document is parsed again or
+// destroyed. Accessors for the wrong type return empty values.
+class JsonValue {
+ public:
+  JsonValue() = default;
+
+  JsonType type() const;
+  bool exists() const { return type() != JsonType::kNone; }
+  bool IsNull() const { return type() == JsonType::kNull; }
+
+  bool GetBool() const;
+  double GetNumber() const;
+  // Returns whether this is a number with an integral value that fits in
+  // int64_t, and if so stores it in |value|.
+  bool GetInt64(int64_t* value) const;
+  std::string_view GetString() const;
+  // Returns a number's text as it appeared in the input.
+  std::string_view GetNumberText() const;
+
+  // The number of elements of an array or members of an object.
+  size_t size() const;
+
+  // Returns the array element at |index|. Elements are found by skipping
+  // their predecessors, in constant time each.
+  JsonValue At(size_t index) const;
+
+  // Returns the value of the object member named |key|; the last one if
+  // the key repeats.
+  JsonValue Find(std::string_view key) const;
+
+  // Invokes |callback(JsonValue)| on each array element in order.
+  template <typename Callback>
+  void ForEachElement(Callback&& callback) const;
+
+  // Invokes |callback(std::string_view key, JsonValue value)| on each
+  // object member in order.
+  template <typename Callback>
+  void ForEachMember(Callback&& callback) const;
+
+ private:
+  friend class JsonDocument;
+
+  JsonValue(const JsonDocument* document, uint32_t index)
+      : document_(document), index_(index) {}
+
+  // Returns the index of the first node after this value's subtree.
+  uint32_t end() const;
+
+  const JsonDocument* document_ = nullptr;
+  uint32_t index_ = 0;
+};
+
+class JsonDocument {
+ public:
+  // Containers nested deeper than this are rejected, bounding the parser's
+  // recursion.
+  static constexpr size_t kMaxDepth = 128;
+
+  JsonDocument() = default;
+
+  JsonDocument(const JsonDocument&) = delete;
+  JsonDocument& operator=(const JsonDocument&) = delete;
+
+  // Parses |json|, replacing the previous document. |json| must outlive
+  // the values read from the document. On failure returns false and, if
+  // |error| is non-null, sets it to a description including the offset.
+  bool Parse(std::string_view json, std::string* error);
+
+  // The top-level value; a value of type kNone if parsing failed.
+  JsonValue root() const;
+
+ private:
+  friend class JsonValue;
+  class Parser;
+
+  struct Node {
+    JsonType type;
+    bool boolean;
+    // Whether |integer| holds the number exactly.
+    bool is_integer;
+    // Elements or members of a container.
+    uint32_t count;
+    // Index of the first node after this one's subtree.
+    uint32_t end;
+    // A string's value, or a number's text.
+    std::string_view text;
+    double number;
+    int64_t integer;
+  };
+
+  std::vector<Node> nodes_;
+  // Unescaped strings. Reserved to the input's size before parsing, which
+  // bounds their total length, so views into it stay valid.
+  std::string strings_;
+};
+
+// Writes JSON into a string.
+//
+// Everything beyond ASCII is written as \u escapes, so the output is pure
+// ASCII and widening it to UTF-16 for WebView2 is a plain copy. Commas and
+// colons are inserted automatically; the caller is responsible for
+// balancing containers and writing a key before each member value.
+class JsonWriter {
+ public:
+  // Appends to |output|, which must outlive the writer.
+  explicit JsonWriter(std::string* output) : output_(output) {}
+
+  JsonWriter(const JsonWriter&) = delete;
+  JsonWriter& operator=(const JsonWriter&) = delete;
+
+  void Null();
+  void Bool(bool value);
+  void Int(int64_t value);
+  // Non-finite values are written as null, as JSON.stringify does.
+  void Double(double value);
+  // |value| is UTF-8; invalid sequences are written as U+FFFD.
+  void String(std::string_view value);
+  // Writes |json|, which must be a complete JSON value, as it is.
+  void Raw(std::string_view json);
+
+  void BeginArray();
+  void EndArray();
+  void BeginObject();
+  void EndObject();
+  void Key(std::string_view key);
+
+ private:
+  // Separates a value from the one before it.
+  void BeforeValue();
+
+  std::string* output_;
+  bool need_comma_ = false;
+};
+
+// Appends |ascii|, e.g. the output of |JsonWriter|, to |output| as UTF-16.
+void AppendAsciiAsUtf16(std::string_view ascii, std::u16string* output);
+
+template <typename Callback>
+void JsonValue::ForEachElement(Callback&& callback) const {
+  if (type() != JsonType::kArray) {
+    return;
+  }
+  uint32_t end_index = end();
+  for (uint32_t child = index_ + 1; child < end_index;) {
+    JsonValue element(document_, child);
+    callback(element);
+    child = element.end();
+  }
+}
+
+template <typename Callback>
+void JsonValue::ForEachMember(Callback&& callback) const {
+  if (type() != JsonType::kObject) {
+    return;
+  }
+  uint32_t end_index = end();
+  for (uint32_t key = index_ + 1; key < end_index;) {
+    JsonValue value(document_, key + 1);
+    callback(JsonValue(document_, key).GetString(), value);
+    key = value.end();
+  }
+}
+
+#endif  // RUNNER_JSON_H_
@@ -0,0 +1,299 @@
+#include "logging.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using logging_internal::ArgType;
+using logging_internal::Record;
+
+// Records per thread. A power of two so indices can be masked.
+constexpr size_t kRingCapacity = 512;
+
+// How often the flusher drains the rings when nothing asks it to.
+constexpr std::chrono::milliseconds kFlushInterval(20);
+
+// A single-producer, single-consumer ring of records. The owning thread
+// writes at |head_|; the flusher reads at |tail_|. Each index lives on its
+// own cache line so the two sides do not contend.
+class RecordRing {
+ public:
+  Record* Begin() {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kRingCapacity) {
+      return nullptr;
+    }
+    return &records_[head & (kRingCapacity - 1)];
+  }
+
+  void Commit() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // Invokes |callback| on every published record, oldest first.
+  template <typename Callback>
+  void Drain(Callback&& callback) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      callback(records_[tail & (kRingCapacity - 1)]);
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+ private:
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  alignas(64) Record records_[kRingCapacity];
+};
+
+// Owns every thread's ring and the flusher thread.
+class LogState {
+ public:
+  static LogState& Get() {
+    // Intentionally leaked: threads may log during static destruction.
+    static LogState* state = new LogState();
+    return *state;
+  }
+
+  RecordRing* RegisterThread() {
+    auto ring = std::make_unique<RecordRing>();
+    RecordRing* result = ring.get();
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.push_back(std::move(ring));
+    return result;
+  }
+
+  void Start() {
+    std::lock_guard<std::mutex> lock(thread_mutex_);
+    if (flusher_.joinable()) {
+      return;
+    }
+    stop_ = false;
+    flusher_ = std::thread([this] { Run(); });
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex_);
+      if (!flusher_.joinable()) {
+        return;
+      }
+      stop_ = true;
+    }
+    wake_.notify_one();
+    flusher_.join();
+    Flush();
+  }
+
+  // Drains every ring and writes the result with a single stdio call.
+  void Flush() {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    output_.clear();
+    {
+      std::lock_guard<std::mutex> rings_lock(rings_mutex_);
+      for (const std::unique_ptr<RecordRing>& ring : rings_) {
+        ring->Drain([this](const Record& record) { Format(record); });
+      }
+    }
+    if (!output_.empty()) {
+      FILE* stream = stream_ != nullptr ? stream_ : stderr;
+      fwrite(output_.data(), 1, output_.size(), stream);
+      fflush(stream);
+    }
+  }
+
+  void SetStream(FILE* stream) {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    stream_ = stream;
+  }
+
+  std::atomic<uint64_t> dropped{0};
+
+ private:
+  LogState() : start_(std::chrono::steady_clock::now()) {}
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(thread_mutex_);
+    while (!stop_) {
+      wake_.wait_for(lock, kFlushInterval);
+      lock.unlock();
+      Flush();
+      lock.lock();
+    }
+  }
+
+  void Format(const Record& record) {
+    static const char kLevelNames[] = {'T', 'D', 'I', 'W', 'E'};
+    char prefix[48];
+    int64_t elapsed_us =
+        (record.timestamp_ns -
+         std::chrono::duration_cast<std::chrono::nanoseconds>(
+             start_.time_since_epoch())
+             .count()) /
+        1000;
+    int prefix_size = snprintf(
+        prefix, sizeof(prefix), "[%c %lld.%06lld] ",
+        kLevelNames[static_cast<int>(record.level)],
+        static_cast<long long>(elapsed_us / 1000000),
+        static_cast<long long>(elapsed_us % 1000000));
+    output_.append(prefix, prefix_size > 0 ? prefix_size : 0);
+
+    size_t arg = 0;
+    for (const char* p = record.format; *p != '\0'; ++p) {
+      if (p[0] == '{' && p[1] == '}' && arg < record.arg_count) {
+        FormatArg(record, arg++);
+        ++p;
+      } else {
+        output_.push_back(*p);
+      }
+    }
+    output_.push_back('\n');
+  }
+
+  void FormatArg(const Record& record, size_t index) {
+    const Record::Value& value = record.values[index];
+    char buffer[32];
+    int size = 0;
+    switch (record.types[index]) {
+      case ArgType::kInt:
+        size = snprintf(buffer, sizeof(buffer), "%lld",
+                        static_cast<long long>(value.i));
+        break;
+      case ArgType::kUint:
+        size = snprintf(buffer, sizeof(buffer), "%llu",
+                        static_cast<unsigned long long>(value.u));
+        break;
+      case ArgType::kDouble:
+        size = snprintf(buffer, sizeof(buffer), "%g", value.d);
+        break;
+      case ArgType::kBool:
+        output_.append(value.u ? "true" : "false");
+        return;
+      case ArgType::kPointer:
+        size = snprintf(buffer, sizeof(buffer), "%p", value.p);
+        break;
+      case ArgType::kString:
+        output_.append(record.text + value.text.offset, value.text.size);
+        return;
+      case ArgType::kWideString:
+        AppendWide(record.text + value.text.offset, value.text.size);
+        return;
+    }
+    output_.append(buffer, size > 0 ? size : 0);
+  }
+
+  // Appends |bytes| of wchar_t code units as UTF-8. Invalid surrogates are
+  // replaced with U+FFFD.
+  void AppendWide(const char* data, size_t bytes) {
+    size_t count = bytes / sizeof(wchar_t);
+    // The text buffer is only byte-aligned, so units are copied out.
+    auto unit_at = [data](size_t index) {
+      wchar_t unit;
+      memcpy(&unit, data + index * sizeof(wchar_t), sizeof(wchar_t));
+      return static_cast<uint32_t>(unit);
+    };
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t c = unit_at(i);
+      if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDFFF) {
+        uint32_t next = i + 1 < count ? unit_at(i + 1) : 0;
+        if (c <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF) {
+          c = 0x10000 + ((c - 0xD800) << 10) + (next - 0xDC00);
+          ++i;
+        } else {
+          c = 0xFFFD;
+        }
+      }
+      if (c < 0x80) {
+        output_.push_back(static_cast<char>(c));
+      } else if (c < 0x800) {
+        output_.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        output_.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      } else if (c < 0x10000) {
+        output_.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        output_.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        output_.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      } else {
+        output_.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        output_.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        output_.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        output_.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      }
+    }
+  }
+
+  const std::chrono::steady_clock::time_point start_;
+
+  std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<RecordRing>> rings_;
+
+  std::mutex thread_mutex_;
+  std::condition_variable wake_;
+  std::thread flusher_;
+  bool stop_ = false;
+
+  // Serializes flushes and guards |output_|.
+  std::mutex flush_mutex_;
+  std::string output_;
+  // Where formatted records go; stderr if null.
+  FILE* stream_ = nullptr;
+};
+
+RecordRing* CurrentThreadRing() {
+  thread_local RecordRing* ring = LogState::Get().RegisterThread();
+  return ring;
+}
+
+}  // namespace
+
+void StartLogging() {
+  LogState::Get().Start();
+}
+
+void StopLogging() {
+  LogState::Get().Stop();
+}
+
+void FlushLogs() {
+  LogState::Get().Flush();
+}
+
+void SetLogStream(FILE* stream) {
+  LogState::Get().SetStream(stream);
+}
+
+uint64_t DroppedLogRecordCount() {
+  return LogState::Get().dropped.load(std::memory_order_relaxed);
+}
+
+namespace logging_internal {
+
+Record* BeginRecord() {
+  Record* record = CurrentThreadRing()->Begin();
+  if (record == nullptr) {
+    LogState::Get().dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  return record;
+}
+
+void CommitRecord() {
+  CurrentThreadRing()->Commit();
+}
+
+int64_t NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace logging_internal
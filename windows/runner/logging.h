@@ -0,0 +1,217 @@
+#ifndef RUNNER_LOGGING_H_
+#define RUNNER_LOGGING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logging for the runner.
+//
+// A log call on any thread copies its format string pointer and arguments in
+// binary form into a fixed-size record in that thread's lock-free ring
+// buffer; no allocation, formatting or I/O happens on the calling thread. A
+// background thread drains every ring, formats the records and writes them
+// to stderr. Messages use "{}" placeholders:
+//
+//   RUNNER_LOG_DEBUG("Bounds: {}x{}", width, height);
+//
+// The format string must be a string literal (or otherwise outlive the
+// flusher). Call sites below RUNNER_MIN_LOG_LEVEL compile to nothing and do
+// not evaluate their arguments. When a ring is full, new records are dropped
+// and counted rather than blocking the caller.
+
+enum class LogLevel : uint8_t {
+  kTrace = 0,
+  kDebug = 1,
+  kInfo = 2,
+  kWarning = 3,
+  kError = 4,
+};
+
+// The lowest level that is compiled in. Defaults to kDebug in debug builds
+// and kInfo otherwise; define it on the command line to override.
+#ifndef RUNNER_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define RUNNER_MIN_LOG_LEVEL 2
+#else
+#define RUNNER_MIN_LOG_LEVEL 1
+#endif
+#endif
+
+#define RUNNER_LOG(level, ...)                                      \
+  do {                                                              \
+    if constexpr (static_cast<int>(level) >= RUNNER_MIN_LOG_LEVEL) { \
+      ::logging_internal::Write(level, __VA_ARGS__);                \
+    }                                                               \
+  } while (0)
+
+#define RUNNER_LOG_TRACE(...) RUNNER_LOG(LogLevel::kTrace, __VA_ARGS__)
+#define RUNNER_LOG_DEBUG(...) RUNNER_LOG(LogLevel::kDebug, __VA_ARGS__)
+#define RUNNER_LOG_INFO(...) RUNNER_LOG(LogLevel::kInfo, __VA_ARGS__)
+#define RUNNER_LOG_WARNING(...) RUNNER_LOG(LogLevel::kWarning, __VA_ARGS__)
+#define RUNNER_LOG_ERROR(...) RUNNER_LOG(LogLevel::kError, __VA_ARGS__)
+
+// Starts the background flusher. Records logged before this call are kept
+// and written once it runs.
+void StartLogging();
+
+// Writes every pending record and stops the background flusher.
+void StopLogging();
+
+// Synchronously writes every record logged so far, on the calling thread.
+void FlushLogs();
+
+// Writes formatted records to |stream| instead of stderr, e.g. to discard
+// them while benchmarking. Pass nullptr to restore stderr.
+void SetLogStream(FILE* stream);
+
+// Returns the number of records dropped because a ring was full.
+uint64_t DroppedLogRecordCount();
+
+namespace logging_internal {
+
+constexpr size_t kMaxArgs = 8;
+constexpr size_t kTextCapacity = 160;
+
+enum class ArgType : uint8_t {
+  kInt,
+  kUint,
+  kDouble,
+  kBool,
+  kPointer,
+  kString,
+  kWideString,
+};
+
+// A log call in binary form. Text arguments are copied (and truncated if
+// necessary) into |text|; wide text is stored as raw UTF-16 code units and
+// transcoded by the flusher.
+struct Record {
+  int64_t timestamp_ns;
+  const char* format;
+  LogLevel level;
+  uint8_t arg_count;
+  uint16_t text_size;
+  ArgType types[kMaxArgs];
+  union Value {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const void* p;
+    struct {
+      uint16_t offset;
+      uint16_t size;
+    } text;
+  } values[kMaxArgs];
+  char text[kTextCapacity];
+};
+
+// Returns a record in the calling thread's ring to fill in, or nullptr if
+// the ring is full.
+Record* BeginRecord();
+
+// Publishes the record returned by the last |BeginRecord| on this thread.
+void CommitRecord();
+
+int64_t NowNanoseconds();
+
+inline void AppendText(Record* record,
+                       ArgType type,
+                       const void* data,
+                       size_t bytes,
+                       size_t unit) {
+  size_t room = kTextCapacity - record->text_size;
+  size_t copied = (bytes < room ? bytes : room) / unit * unit;
+  std::memcpy(record->text + record->text_size, data, copied);
+  Record::Value& value = record->values[record->arg_count];
+  value.text.offset = record->text_size;
+  value.text.size = static_cast<uint16_t>(copied);
+  record->types[record->arg_count] = type;
+  record->text_size = static_cast<uint16_t>(record->text_size + copied);
+}
+
+inline void EncodeArg(Record* record, std::string_view value) {
+  AppendText(record, ArgType::kString, value.data(), value.size(), 1);
+}
+
+inline void EncodeArg(Record* record, const std::string& value) {
+  EncodeArg(record, std::string_view(value));
+}
+
+inline void EncodeArg(Record* record, const char* value) {
+  EncodeArg(record, std::string_view(value ? value : "(null)"));
+}
+
+inline void EncodeArg(Record* record, char* value) {
+  EncodeArg(record, static_cast<const char*>(value));
+}
+
+inline void EncodeArg(Record* record, std::wstring_view value) {
+  static_assert(sizeof(wchar_t) == 2 || sizeof(wchar_t) == 4,
+                "unexpected wchar_t size");
+  AppendText(record, ArgType::kWideString, value.data(),
+             value.size() * sizeof(wchar_t), sizeof(wchar_t));
+}
+
+inline void EncodeArg(Record* record, const std::wstring& value) {
+  EncodeArg(record, std::wstring_view(value));
+}
+
+inline void EncodeArg(Record* record, const wchar_t* value) {
+  EncodeArg(record, std::wstring_view(value ? value : L"(null)"));
+}
+
+inline void EncodeArg(Record* record, wchar_t* value) {
+  EncodeArg(record, static_cast<const wchar_t*>(value));
+}
+
+template <typename T>
+void EncodeArg(Record* record, const T& value) {
+  Record::Value& slot = record->values[record->arg_count];
+  ArgType& type = record->types[record->arg_count];
+  if constexpr (std::is_same_v<T, bool>) {
+    slot.u = value ? 1 : 0;
+    type = ArgType::kBool;
+  } else if constexpr (std::is_enum_v<T>) {
+    slot.i = static_cast<int64_t>(value);
+    type = ArgType::kInt;
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    slot.i = static_cast<int64_t>(value);
+    type = ArgType::kInt;
+  } else if constexpr (std::is_integral_v<T>) {
+    slot.u = static_cast<uint64_t>(value);
+    type = ArgType::kUint;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    slot.d = static_cast<double>(value);
+    type = ArgType::kDouble;
+  } else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) {
+    slot.p = static_cast<const void*>(value);
+    type = ArgType::kPointer;
+  } else {
+    static_assert(std::is_pointer_v<T>, "unsupported log argument type");
+  }
+}
+
+template <typename... Args>
+void Write(LogLevel level, const char* format, const Args&... args) {
+  static_assert(sizeof...(Args) <= kMaxArgs, "too many log arguments");
+  Record* record = BeginRecord();
+  if (record == nullptr) {
+    return;
+  }
+  record->timestamp_ns = NowNanoseconds();
+  record->format = format;
+  record->level = level;
+  record->arg_count = 0;
+  record->text_size = 0;
+  ((EncodeArg(record, args), ++record->arg_count), ...);
+  CommitRecord();
+}
+
+}  // namespace logging_internal
+
+#endif  // RUNNER_LOGGING_H_
@@ -3,7 +3,10 @@
 #include <windows.h>
 
 #include "flutter_window.h"
+#include "logging.h"
+#include "trace.h"
 #include "utils.h"
+#include "win32_run_loop.h"
 
 int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
                       _In_ wchar_t *command_line, _In_ int show_command) {
@@ -13,31 +16,51 @@ int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
     CreateAndAttachConsole();
   }
 
-  // Initialize COM, so that it is available for use in the library and/or
-  // plugins.
-  ::CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
-
-  flutter::DartProject project(L"data");
+  // Runner log records are formatted and written off the UI thread.
+  StartLogging();
 
+  // Parsed first so --trace-startup covers everything that follows.
   std::vector<std::string> command_line_arguments =
       GetCommandLineArguments();
 
-  project.set_dart_entrypoint_arguments(std::move(command_line_arguments));
+  // Initialize COM, so that it is available for use in the library and/or
+  // plugins.
+  {
+    RUNNER_TRACE_SCOPE("CoInitializeEx");
+    ::CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+  }
+
+  flutter::DartProject project = [&command_line_arguments] {
+    RUNNER_TRACE_SCOPE("DartProject");
+    flutter::DartProject dart_project(L"data");
+    dart_project.set_dart_entrypoint_arguments(
+        std::move(command_line_arguments));
+    return dart_project;
+  }();
 
-  FlutterWindow window(project);
+  Win32RunLoop run_loop;
+  FlutterWindow window(project, &run_loop.scheduler());
   Win32Window::Point origin(10, 10);
   Win32Window::Size size(1280, 720);
   if (!window.Create(L"platform_view_test", origin, size)) {
+    WriteStartupTrace();
+    StopLogging();
     return EXIT_FAILURE;
   }
   window.SetQuitOnClose(true);
 
-  ::MSG msg;
-  while (::GetMessage(&msg, nullptr, 0, 0)) {
-    ::TranslateMessage(&msg);
-    ::DispatchMessage(&msg);
-  }
+  run_loop.Run();
+
+  TaskSchedulerStats stats = run_loop.scheduler().stats();
+  RUNNER_LOG_INFO("Run loop: {} tasks, {} idle tasks, {} over budget, max delay {}us",
+                  stats.tasks_run, stats.idle_tasks_run, stats.budget_exhausted,
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      stats.max_task_delay)
+                      .count());
 
   ::CoUninitialize();
+  WriteStartupTrace();
+  WriteMetricsFile();
+  StopLogging();
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,99 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::unique_ptr<MappedFile> Fail(std::string* error, const char* message) {
+  if (error != nullptr) {
+    *error = message;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+#if defined(_WIN32)
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::filesystem::path& path,
+                                             std::string* error) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return Fail(error, "cannot open file");
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    return Fail(error, "cannot get file size");
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0));
+  }
+  // The view keeps the file mapped after both handles are closed.
+  HANDLE mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) {
+    return Fail(error, "cannot create file mapping");
+  }
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (view == nullptr) {
+    return Fail(error, "cannot map file");
+  }
+  return std::unique_ptr<MappedFile>(new MappedFile(
+      static_cast<const char*>(view), static_cast<size_t>(size.QuadPart)));
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+}
+
+#else
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::filesystem::path& path,
+                                             std::string* error) {
+  int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file < 0) {
+    return Fail(error, "cannot open file");
+  }
+  struct stat status;
+  if (fstat(file, &status) != 0) {
+    close(file);
+    return Fail(error, "cannot get file size");
+  }
+  size_t size = static_cast<size_t>(status.st_size);
+  if (size == 0) {
+    close(file);
+    return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0));
+  }
+  // The mapping outlives the descriptor.
+  void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (view == MAP_FAILED) {
+    return Fail(error, "cannot map file");
+  }
+  return std::unique_ptr<MappedFile>(
+      new MappedFile(static_cast<const char*>(view), size));
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+#endif
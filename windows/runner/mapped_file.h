@@ -0,0 +1,35 @@
+#ifndef RUNNER_MAPPED_FILE_H_
+#define RUNNER_MAPPED_FILE_H_
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// A file mapped read-only into memory for as long as the object lives.
+//
+// Pages are loaded by the OS on first touch and shared with every other
+// mapping of the file, so opening even a large file is cheap and its bytes
+// can be handed out as views without copying.
+class MappedFile {
+ public:
+  // Maps the file at |path|. On failure returns null and, if |error| is
+  // non-null, sets it to a description.
+  static std::unique_ptr<MappedFile> Open(const std::filesystem::path& path,
+                                          std::string* error);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view bytes() const { return std::string_view(data_, size_); }
+
+ private:
+  MappedFile(const char* data, size_t size) : data_(data), size_(size) {}
+
+  const char* data_;
+  size_t size_;
+};
+
+#endif  // RUNNER_MAPPED_FILE_H_
@@ -0,0 +1,254 @@
+#include "metrics.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace metrics_internal {
+
+size_t NextShard() {
+  static std::atomic<size_t> next{0};
+  return next.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+}
+
+}  // namespace metrics_internal
+
+namespace {
+
+using metrics_internal::kShardCount;
+
+// Returns the index of the highest set bit of |value|, which is non-zero.
+int HighestBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<int>(index);
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+void AppendName(std::string* output, std::string_view name) {
+  output->push_back('"');
+  for (char c : name) {
+    if (c == '"' || c == '\\') {
+      output->push_back('\\');
+    }
+    output->push_back(c);
+  }
+  output->append("\":");
+}
+
+void AppendNumber(std::string* output, uint64_t value) {
+  char buffer[24];
+  int size = snprintf(buffer, sizeof(buffer), "%llu",
+                      static_cast<unsigned long long>(value));
+  output->append(buffer, size > 0 ? size : 0);
+}
+
+void AppendSignedNumber(std::string* output, int64_t value) {
+  char buffer[24];
+  int size =
+      snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+  output->append(buffer, size > 0 ? size : 0);
+}
+
+void AppendHistogram(std::string* output, const HistogramSnapshot& snapshot) {
+  output->append("{\"count\":");
+  AppendNumber(output, snapshot.count);
+  output->append(",\"sum\":");
+  AppendNumber(output, snapshot.sum);
+  output->append(",\"p50\":");
+  AppendNumber(output, snapshot.Percentile(50));
+  output->append(",\"p90\":");
+  AppendNumber(output, snapshot.Percentile(90));
+  output->append(",\"p99\":");
+  AppendNumber(output, snapshot.Percentile(99));
+  output->append(",\"max\":");
+  AppendNumber(output, snapshot.Percentile(100));
+  output->append(",\"buckets\":[");
+  bool first = true;
+  for (size_t i = 0; i < snapshot.buckets.size(); ++i) {
+    if (snapshot.buckets[i] == 0) {
+      continue;
+    }
+    if (!first) {
+      output->push_back(',');
+    }
+    first = false;
+    output->push_back('[');
+    AppendNumber(output, Histogram::BucketLowerBound(i));
+    output->push_back(',');
+    AppendNumber(output, snapshot.buckets[i]);
+    output->push_back(']');
+  }
+  output->append("]}");
+}
+
+// Returns the metric called |name| in |metrics|, adding it if needed.
+template <typename Metric>
+Metric* GetOrAdd(
+    std::map<std::string, std::unique_ptr<Metric>, std::less<>>* metrics,
+    std::string_view name) {
+  auto it = metrics->find(name);
+  if (it == metrics->end()) {
+    it = metrics->emplace(std::string(name), std::make_unique<Metric>()).first;
+  }
+  return it->second.get();
+}
+
+}  // namespace
+
+uint64_t Counter::Value() const {
+  uint64_t value = 0;
+  for (const Cell& cell : cells_) {
+    value += cell.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+uint64_t HistogramSnapshot::Percentile(double percentile) const {
+  if (count == 0) {
+    return 0;
+  }
+  // The rank of the sample, counting from 1.
+  double fraction = std::clamp(percentile, 0.0, 100.0) / 100.0;
+  uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.5));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return Histogram::BucketUpperBound(i);
+    }
+  }
+  // Buckets read while samples were being recorded can trail |count|.
+  for (size_t i = buckets.size(); i > 0; --i) {
+    if (buckets[i - 1] != 0) {
+      return Histogram::BucketUpperBound(i - 1);
+    }
+  }
+  return 0;
+}
+
+Histogram::Histogram() : shards_(new Shard[kShardCount]) {
+  for (size_t shard = 0; shard < kShardCount; ++shard) {
+    for (std::atomic<uint64_t>& bucket : shards_[shard].buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Histogram::Record(uint64_t value) {
+  Shard& shard = shards_[metrics_internal::CurrentShard()];
+  shard.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::Snapshot() const {
+  HistogramSnapshot snapshot;
+  snapshot.buckets.resize(kBucketCount);
+  for (size_t shard = 0; shard < kShardCount; ++shard) {
+    const Shard& source = shards_[shard];
+    snapshot.count += source.count.load(std::memory_order_relaxed);
+    snapshot.sum += source.sum.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      snapshot.buckets[i] += source.buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+size_t Histogram::BucketIndex(uint64_t value) {
+  if (value < kSubBucketCount) {
+    return static_cast<size_t>(value);
+  }
+  // The power of two selects a group of sub-buckets and the next
+  // |kSubBucketBits| bits below the highest select one within it.
+  int exponent = HighestBit(value);
+  size_t group = static_cast<size_t>(exponent) - kSubBucketBits + 1;
+  size_t sub_bucket = static_cast<size_t>(
+      (value >> (exponent - static_cast<int>(kSubBucketBits))) &
+      (kSubBucketCount - 1));
+  return group * kSubBucketCount + sub_bucket;
+}
+
+uint64_t Histogram::BucketLowerBound(size_t bucket) {
+  if (bucket < kSubBucketCount) {
+    return bucket;
+  }
+  size_t group = bucket / kSubBucketCount;
+  uint64_t sub_bucket = bucket % kSubBucketCount;
+  return (kSubBucketCount + sub_bucket) << (group - 1);
+}
+
+uint64_t Histogram::BucketUpperBound(size_t bucket) {
+  if (bucket + 1 >= kBucketCount) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return BucketLowerBound(bucket + 1) - 1;
+}
+
+Counter* MetricsRegistry::GetCounter(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetOrAdd(&counters_, name);
+}
+
+Gauge* MetricsRegistry::GetGauge(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetOrAdd(&gauges_, name);
+}
+
+Histogram* MetricsRegistry::GetHistogram(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetOrAdd(&histograms_, name);
+}
+
+std::string MetricsRegistry::ToJson() const {
+  std::string output = "{\"counters\":{";
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool first = true;
+  for (const auto& [name, counter] : counters_) {
+    if (!first) {
+      output.push_back(',');
+    }
+    first = false;
+    AppendName(&output, name);
+    AppendNumber(&output, counter->Value());
+  }
+  output.append("},\"gauges\":{");
+  first = true;
+  for (const auto& [name, gauge] : gauges_) {
+    if (!first) {
+      output.push_back(',');
+    }
+    first = false;
+    AppendName(&output, name);
+    AppendSignedNumber(&output, gauge->Value());
+  }
+  output.append("},\"histograms\":{");
+  first = true;
+  for (const auto& [name, histogram] : histograms_) {
+    if (!first) {
+      output.push_back(',');
+    }
+    first = false;
+    AppendName(&output, name);
+    AppendHistogram(&output, histogram->Snapshot());
+  }
+  output.append("}}\n");
+  return output;
+}
+
+MetricsRegistry& Metrics() {
+  // Intentionally leaked: threads may update metrics during static
+  // destruction.
+  static MetricsRegistry* registry = new MetricsRegistry();
+  return *registry;
+}
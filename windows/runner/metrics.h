@@ -0,0 +1,181 @@
+#ifndef RUNNER_METRICS_H_
+#define RUNNER_METRICS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runtime metrics for the runner: counters, gauges and latency histograms,
+// exported as JSON.
+//
+// Metrics are registered by name once, typically at startup, and the
+// returned pointers are kept for the life of the process. Updates take no
+// locks and do not allocate: counters and histograms are split into shards,
+// and each thread updates its own shard with relaxed atomics, so threads
+// incrementing the same metric do not contend for a cache line. Reading a
+// metric sums its shards, so a snapshot taken while other threads update
+// it may be slightly out of date, but never torn.
+//
+//   Counter* const g_navigations = Metrics().GetCounter("navigation.started");
+//   ...
+//   g_navigations->Increment();
+
+namespace metrics_internal {
+
+// Shards per metric. A power of two; threads are assigned shards round
+// robin, so up to this many threads update a metric without sharing.
+constexpr size_t kShardCount = 8;
+constexpr size_t kCacheLineSize = 64;
+
+size_t NextShard();
+
+// Returns the calling thread's shard.
+inline size_t CurrentShard() {
+  thread_local const size_t shard = NextShard();
+  return shard;
+}
+
+}  // namespace metrics_internal
+
+// A monotonically increasing count of events.
+class Counter {
+ public:
+  Counter() = default;
+
+  Counter(const Counter&) = delete;
+  Counter& operator=(const Counter&) = delete;
+
+  void Increment(uint64_t count = 1) {
+    cells_[metrics_internal::CurrentShard()].value.fetch_add(
+        count, std::memory_order_relaxed);
+  }
+
+  uint64_t Value() const;
+
+ private:
+  // One cell per cache line.
+  struct Cell {
+    std::atomic<uint64_t> value{0};
+    char padding[metrics_internal::kCacheLineSize - sizeof(uint64_t)];
+  };
+
+  Cell cells_[metrics_internal::kShardCount];
+};
+
+// A value that goes up and down, such as the number of live views. Gauges
+// are set rather than accumulated, so they are not sharded.
+class Gauge {
+ public:
+  Gauge() = default;
+
+  Gauge(const Gauge&) = delete;
+  Gauge& operator=(const Gauge&) = delete;
+
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  void Add(int64_t delta) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+struct HistogramSnapshot {
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  // Samples per bucket; see |Histogram::BucketIndex|.
+  std::vector<uint64_t> buckets;
+
+  // Returns an upper bound of the |percentile|th sample (0 to 100), exact
+  // to within a bucket, or 0 if there are no samples.
+  uint64_t Percentile(double percentile) const;
+};
+
+// A distribution of non-negative values, typically latencies in
+// microseconds, in log-linear buckets: values below 8 have a bucket each,
+// and every power of two above is split into 8 equal buckets. Any value
+// is thus recorded to within 12.5%, in 496 buckets covering all of
+// uint64_t, without configuring a range.
+class Histogram {
+ public:
+  static constexpr size_t kSubBucketBits = 3;
+  static constexpr size_t kSubBucketCount = size_t{1} << kSubBucketBits;
+  static constexpr size_t kBucketCount =
+      (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+  Histogram();
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void Record(uint64_t value);
+
+  HistogramSnapshot Snapshot() const;
+
+  // Returns the bucket |value| is counted in.
+  static size_t BucketIndex(uint64_t value);
+
+  // Returns the smallest value counted in |bucket|.
+  static uint64_t BucketLowerBound(size_t bucket);
+
+  // Returns the largest value counted in |bucket|.
+  static uint64_t BucketUpperBound(size_t bucket);
+
+ private:
+  struct Shard {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> buckets[kBucketCount];
+    // Keeps the next shard's counts off this shard's last cache line.
+    char padding[metrics_internal::kCacheLineSize];
+  };
+
+  std::unique_ptr<Shard[]> shards_;
+};
+
+// The set of named metrics. Registration locks; updating a registered
+// metric does not.
+class MetricsRegistry {
+ public:
+  MetricsRegistry() = default;
+
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  // Return the metric called |name|, registering it on first use. The
+  // pointers stay valid for the registry's lifetime. Names of different
+  // kinds of metric are separate.
+  Counter* GetCounter(std::string_view name);
+  Gauge* GetGauge(std::string_view name);
+  Histogram* GetHistogram(std::string_view name);
+
+  // Returns every metric as a JSON object:
+  //
+  //   {"counters":{"navigation.started":12},
+  //    "gauges":{"webview.live":2},
+  //    "histograms":{"webview.controller_create_us":{"count":3,"sum":...,
+  //        "p50":...,"p90":...,"p99":...,"max":...,
+  //        "buckets":[[<lower bound>,<count>],...]}}}
+  //
+  // Only non-empty buckets are listed.
+  std::string ToJson() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Counter>, std::less<>> counters_;
+  std::map<std::string, std::unique_ptr<Gauge>, std::less<>> gauges_;
+  std::map<std::string, std::unique_ptr<Histogram>, std::less<>> histograms_;
+};
+
+// Returns the process-wide registry.
+MetricsRegistry& Metrics();
+
+#endif  // RUNNER_METRICS_H_
@@ -0,0 +1,500 @@
+#include "navigation_policy.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+const char kDefaultNavigationPolicy[] =
+    "allow https://*\n"
+    "default deny\n";
+
+namespace {
+
+// Linear search beats binary search for the few children most nodes have.
+constexpr uint32_t kLinearSearchEdges = 8;
+
+// The port a URI without one is treated as having, when its scheme has no
+// default port.
+constexpr uint32_t kNoPort = 0;
+
+char16_t ToLowerAscii(char16_t c) {
+  return (c >= u'A' && c <= u'Z') ? static_cast<char16_t>(c + (u'a' - u'A'))
+                                  : c;
+}
+
+bool IsSchemeChar(char16_t c, bool first) {
+  c = ToLowerAscii(c);
+  if (c >= u'a' && c <= u'z') {
+    return true;
+  }
+  return !first && ((c >= u'0' && c <= u'9') || c == u'+' || c == u'-' ||
+                    c == u'.');
+}
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Returns the position of the first of |delimiters| in |text| at or after
+// |start|, or |text.size()|.
+size_t FindFirstOf(std::u16string_view text,
+                   std::u16string_view delimiters,
+                   size_t start) {
+  for (size_t i = start; i < text.size(); ++i) {
+    for (char16_t delimiter : delimiters) {
+      if (text[i] == delimiter) {
+        return i;
+      }
+    }
+  }
+  return text.size();
+}
+
+// Parses |text| as a decimal port. Returns false if it is not one.
+bool ParsePort(std::u16string_view text, uint32_t* port) {
+  if (text.empty() || text.size() > 5) {
+    return false;
+  }
+  uint32_t value = 0;
+  for (char16_t c : text) {
+    if (c < u'0' || c > u'9') {
+      return false;
+    }
+    value = value * 10 + (c - u'0');
+  }
+  if (value > 65535) {
+    return false;
+  }
+  *port = value;
+  return true;
+}
+
+uint32_t DefaultPort(std::u16string_view scheme) {
+  auto equals = [scheme](std::u16string_view name) {
+    if (scheme.size() != name.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+      if (ToLowerAscii(scheme[i]) != name[i]) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (equals(u"https") || equals(u"wss")) {
+    return 443;
+  }
+  if (equals(u"http") || equals(u"ws")) {
+    return 80;
+  }
+  return kNoPort;
+}
+
+// A trie node under construction.
+struct BuildNode {
+  std::map<char16_t, uint32_t> children;
+  std::vector<uint32_t> exact;
+  std::vector<uint32_t> suffix;
+};
+
+// A parsed rule pattern, before its host is added to the trie.
+struct Pattern {
+  std::u16string scheme;
+  // Empty for any host.
+  std::u16string host;
+  bool include_subdomains = false;
+  uint32_t port = 0;
+  bool any_port = true;
+  std::u16string path_prefix;
+};
+
+// Widens |text|, which must be printable ASCII.
+bool WidenAscii(std::string_view text, std::u16string* result) {
+  result->clear();
+  for (char c : text) {
+    if (c <= ' ' || c > '~') {
+      return false;
+    }
+    result->push_back(static_cast<char16_t>(c));
+  }
+  return true;
+}
+
+bool ParsePattern(std::string_view text, Pattern* pattern, std::string* error) {
+  std::u16string wide;
+  if (!WidenAscii(text, &wide)) {
+    *error = "patterns must be printable ASCII";
+    return false;
+  }
+  std::u16string_view rest(wide);
+  std::u16string_view scheme;
+  std::u16string_view authority;
+  size_t separator = rest.find(u"://");
+  if (separator != std::u16string_view::npos) {
+    scheme = rest.substr(0, separator);
+    rest.remove_prefix(separator + 3);
+    size_t path_start = FindFirstOf(rest, u"/", 0);
+    authority = rest.substr(0, path_start);
+    rest.remove_prefix(path_start);
+    if (authority.empty()) {
+      *error = "missing host";
+      return false;
+    }
+  } else if ((separator = rest.find(u':')) != std::u16string_view::npos) {
+    scheme = rest.substr(0, separator);
+    rest.remove_prefix(separator + 1);
+    authority = u"*";
+  } else {
+    scheme = u"*";
+    authority = rest;
+    rest = std::u16string_view();
+  }
+
+  if (scheme != u"*") {
+    if (scheme.empty()) {
+      *error = "missing scheme";
+      return false;
+    }
+    for (size_t i = 0; i < scheme.size(); ++i) {
+      if (!IsSchemeChar(scheme[i], i == 0)) {
+        *error = "invalid scheme";
+        return false;
+      }
+      pattern->scheme.push_back(ToLowerAscii(scheme[i]));
+    }
+  }
+
+  // Split off the port, leaving bracketed IPv6 literals intact.
+  size_t bracket = authority.rfind(u']');
+  size_t colon = authority.rfind(u':');
+  if (colon != std::u16string_view::npos &&
+      (bracket == std::u16string_view::npos || colon > bracket)) {
+    std::u16string_view port = authority.substr(colon + 1);
+    authority = authority.substr(0, colon);
+    if (port != u"*") {
+      if (!ParsePort(port, &pattern->port)) {
+        *error = "invalid port";
+        return false;
+      }
+      pattern->any_port = false;
+    }
+  }
+
+  if (authority != u"*") {
+    if (authority.size() > 2 && authority[0] == u'*' && authority[1] == u'.') {
+      pattern->include_subdomains = true;
+      authority.remove_prefix(2);
+    }
+    if (!authority.empty() && authority.back() == u'.') {
+      authority.remove_suffix(1);
+    }
+    if (authority.empty() || authority.find(u'*') != std::u16string_view::npos) {
+      *error = "invalid host";
+      return false;
+    }
+    for (char16_t c : authority) {
+      pattern->host.push_back(ToLowerAscii(c));
+    }
+  }
+
+  if (!rest.empty() && rest.back() == u'*') {
+    rest.remove_suffix(1);
+  }
+  if (rest.find(u'*') != std::u16string_view::npos) {
+    *error = "'*' is only allowed at the end of a path";
+    return false;
+  }
+  pattern->path_prefix.assign(rest);
+  return true;
+}
+
+// Splits |line| into whitespace-separated words, dropping a trailing
+// comment. Returns false if there are more than |max_words|.
+bool SplitWords(std::string_view line,
+                std::string_view* words,
+                size_t max_words,
+                size_t* count) {
+  *count = 0;
+  size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && IsSpace(line[i])) {
+      ++i;
+    }
+    if (i == line.size() || line[i] == '#') {
+      break;
+    }
+    size_t start = i;
+    while (i < line.size() && !IsSpace(line[i])) {
+      ++i;
+    }
+    if (*count == max_words) {
+      return false;
+    }
+    words[(*count)++] = line.substr(start, i - start);
+  }
+  return true;
+}
+
+bool ParseAction(std::string_view word, NavigationAction* action) {
+  if (word == "allow") {
+    *action = NavigationAction::kAllow;
+    return true;
+  }
+  if (word == "deny") {
+    *action = NavigationAction::kDeny;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+// The components of a URI, as views into it.
+struct NavigationPolicy::UriParts {
+  std::u16string_view scheme;
+  std::u16string_view host;
+  std::u16string_view path;
+  uint32_t port = kNoPort;
+};
+
+bool NavigationPolicy::ParseUri(std::u16string_view uri, UriParts* parts) {
+  const char16_t* data = uri.data();
+  const size_t size = uri.size();
+  size_t i = 0;
+  while (i < size && IsSchemeChar(data[i], i == 0)) {
+    ++i;
+  }
+  if (i == 0 || i == size || data[i] != u':') {
+    return false;
+  }
+  parts->scheme = std::u16string_view(data, i);
+  ++i;
+
+  if (i + 1 < size && data[i] == u'/' && data[i + 1] == u'/') {
+    // One pass over the authority, remembering where the host starts (after
+    // any user info) and where its port separator is.
+    i += 2;
+    size_t host_start = i;
+    size_t colon = 0;
+    for (; i < size; ++i) {
+      char16_t c = data[i];
+      if (c == u'/' || c == u'?' || c == u'#') {
+        break;
+      }
+      if (c == u'@') {
+        host_start = i + 1;
+        colon = 0;
+      } else if (c == u':') {
+        colon = i;
+      } else if (c == u']') {
+        // A colon inside an IPv6 literal is not a port separator.
+        colon = 0;
+      }
+    }
+    size_t host_end = colon != 0 ? colon : i;
+    parts->port = DefaultPort(parts->scheme);
+    if (colon != 0 && colon + 1 < i &&
+        !ParsePort(std::u16string_view(data + colon + 1, i - colon - 1),
+                   &parts->port)) {
+      return false;
+    }
+    if (host_end > host_start && data[host_end - 1] == u'.') {
+      --host_end;
+    }
+    parts->host = std::u16string_view(data + host_start, host_end - host_start);
+  }
+
+  size_t path_start = i;
+  while (i < size && data[i] != u'?' && data[i] != u'#') {
+    ++i;
+  }
+  parts->path = std::u16string_view(data + path_start, i - path_start);
+  return true;
+}
+
+std::optional<NavigationPolicy> NavigationPolicy::Compile(
+    std::string_view config,
+    std::string* error) {
+  NavigationPolicy policy;
+  std::vector<BuildNode> build_nodes(1);
+
+  size_t line_number = 0;
+  while (!config.empty()) {
+    ++line_number;
+    size_t line_end = config.find('\n');
+    std::string_view line = config.substr(0, line_end);
+    config.remove_prefix(line_end == std::string_view::npos ? config.size()
+                                                             : line_end + 1);
+
+    std::string_view words[2];
+    size_t word_count;
+    std::string message;
+    NavigationAction action;
+    Pattern pattern;
+    if (!SplitWords(line, words, 2, &word_count)) {
+      message = "too many words";
+    } else if (word_count == 0) {
+      continue;
+    } else if (word_count == 1) {
+      message = "expected an action and a pattern";
+    } else if (words[0] == "default") {
+      if (ParseAction(words[1], &policy.default_action_)) {
+        continue;
+      }
+      message = "default must be 'allow' or 'deny'";
+    } else if (!ParseAction(words[0], &action)) {
+      message = "unknown action '" + std::string(words[0]) + "'";
+    } else if (ParsePattern(words[1], &pattern, &message)) {
+      uint32_t index = static_cast<uint32_t>(policy.rules_.size());
+      policy.rules_.push_back(Rule{action, std::move(pattern.scheme),
+                                   pattern.any_port ? kAnyPort : pattern.port,
+                                   std::move(pattern.path_prefix),
+                                   std::string(line)});
+
+      uint32_t node = 0;
+      for (auto it = pattern.host.rbegin(); it != pattern.host.rend(); ++it) {
+        auto [child, inserted] = build_nodes[node].children.emplace(
+            *it, static_cast<uint32_t>(build_nodes.size()));
+        node = child->second;
+        if (inserted) {
+          build_nodes.emplace_back();
+        }
+      }
+      // "*" is stored as a suffix of the root, which every host has.
+      bool suffix = pattern.include_subdomains || pattern.host.empty();
+      (suffix ? build_nodes[node].suffix : build_nodes[node].exact)
+          .push_back(index);
+      continue;
+    }
+    if (error != nullptr) {
+      *error = "line " + std::to_string(line_number) + ": " + message;
+    }
+    return std::nullopt;
+  }
+
+  // Flatten the trie breadth-first so each node's edges are contiguous.
+  std::vector<uint32_t> order(1, 0);
+  std::vector<uint32_t> flat_index(build_nodes.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    flat_index[order[i]] = static_cast<uint32_t>(i);
+    for (const auto& [unit, child] : build_nodes[order[i]].children) {
+      order.push_back(child);
+    }
+  }
+  policy.nodes_.resize(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    const BuildNode& source = build_nodes[order[i]];
+    Node& node = policy.nodes_[i];
+    node.first_edge = static_cast<uint32_t>(policy.edges_.size());
+    node.edge_count = static_cast<uint32_t>(source.children.size());
+    for (const auto& [unit, child] : source.children) {
+      policy.edges_.push_back(Edge{unit, flat_index[child]});
+    }
+    node.exact_begin = static_cast<uint32_t>(policy.rule_refs_.size());
+    policy.rule_refs_.insert(policy.rule_refs_.end(), source.exact.begin(),
+                             source.exact.end());
+    node.suffix_begin = static_cast<uint32_t>(policy.rule_refs_.size());
+    policy.rule_refs_.insert(policy.rule_refs_.end(), source.suffix.begin(),
+                             source.suffix.end());
+    node.suffix_end = static_cast<uint32_t>(policy.rule_refs_.size());
+  }
+  policy.hits_.assign(policy.rules_.size(), 0);
+  return policy;
+}
+
+NavigationDecision NavigationPolicy::Evaluate(std::u16string_view uri) const {
+  UriParts parts;
+  if (!ParseUri(uri, &parts)) {
+    return NavigationDecision{default_action_, kDefaultRule};
+  }
+
+  size_t best = kDefaultRule;
+  ConsiderRules(nodes_[0].suffix_begin, nodes_[0].suffix_end, parts, &best);
+
+  // Walk the host from its last character, checking exact rules at the end
+  // of the host and subdomain rules at each label boundary.
+  std::u16string_view host = parts.host;
+  uint32_t node = 0;
+  for (size_t consumed = 1; consumed <= host.size(); ++consumed) {
+    char16_t unit = ToLowerAscii(host[host.size() - consumed]);
+    const Edge* first = edges_.data() + nodes_[node].first_edge;
+    const Edge* last = first + nodes_[node].edge_count;
+    const Edge* edge;
+    if (nodes_[node].edge_count <= kLinearSearchEdges) {
+      edge = first;
+      while (edge != last && edge->unit != unit) {
+        ++edge;
+      }
+    } else {
+      edge = std::lower_bound(
+          first, last, unit,
+          [](const Edge& e, char16_t value) { return e.unit < value; });
+    }
+    if (edge == last || edge->unit != unit) {
+      break;
+    }
+    node = edge->child;
+
+    const Node& current = nodes_[node];
+    if (consumed == host.size()) {
+      ConsiderRules(current.exact_begin, current.suffix_begin, parts, &best);
+      ConsiderRules(current.suffix_begin, current.suffix_end, parts, &best);
+    } else if (host[host.size() - consumed - 1] == u'.') {
+      ConsiderRules(current.suffix_begin, current.suffix_end, parts, &best);
+    }
+  }
+
+  if (best == kDefaultRule) {
+    return NavigationDecision{default_action_, kDefaultRule};
+  }
+  return NavigationDecision{rules_[best].action, best};
+}
+
+NavigationDecision NavigationPolicy::Check(std::u16string_view uri) {
+  NavigationDecision decision = Evaluate(uri);
+  if (decision.rule == kDefaultRule) {
+    ++default_hits_;
+  } else {
+    ++hits_[decision.rule];
+  }
+  return decision;
+}
+
+void NavigationPolicy::ResetHits() {
+  std::fill(hits_.begin(), hits_.end(), 0);
+  default_hits_ = 0;
+}
+
+void NavigationPolicy::ConsiderRules(uint32_t begin,
+                                     uint32_t end,
+                                     const UriParts& uri,
+                                     size_t* best) const {
+  for (uint32_t i = begin; i < end; ++i) {
+    uint32_t rule = rule_refs_[i];
+    if (rule >= *best) {
+      return;
+    }
+    if (RuleMatches(rules_[rule], uri)) {
+      *best = rule;
+      return;
+    }
+  }
+}
+
+bool NavigationPolicy::RuleMatches(const Rule& rule,
+                                   const UriParts& uri) const {
+  if (rule.port != kAnyPort && rule.port != uri.port) {
+    return false;
+  }
+  if (!rule.scheme.empty()) {
+    if (rule.scheme.size() != uri.scheme.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < rule.scheme.size(); ++i) {
+      if (rule.scheme[i] != ToLowerAscii(uri.scheme[i])) {
+        return false;
+      }
+    }
+  }
+  return uri.path.substr(0, rule.path_prefix.size()) == rule.path_prefix;
+}
@@ -0,0 +1,140 @@
+#ifndef RUNNER_NAVIGATION_POLICY_H_
+#define RUNNER_NAVIGATION_POLICY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Allow/deny rules for top-level navigations.
+//
+// A policy is compiled from text with one rule per line:
+//
+//   # Comments run to the end of the line.
+//   allow https://*.example.com
+//   deny  *://ads.example.com/banner/
+//   allow http://localhost:8080/
+//   allow about:blank
+//   default deny
+//
+// A hierarchical pattern is <scheme>://<host>[:<port>][<path prefix>], where
+// the scheme and port may be "*" for any, and the host is "*" for any host,
+// "*.<domain>" for a domain and all of its subdomains, or an exact host name.
+// A pattern without "://" but with a ':' is <scheme>:<prefix>, matching the
+// remainder of URIs such as about:blank or data:. A bare host matches it on
+// any scheme. Schemes and hosts are matched case-insensitively, paths
+// case-sensitively.
+//
+// The first rule in file order that matches decides; if none does, the
+// default action applies (deny unless set with "default").
+
+enum class NavigationAction : uint8_t {
+  kAllow,
+  kDeny,
+};
+
+struct NavigationDecision {
+  NavigationAction action = NavigationAction::kDeny;
+  // The index of the deciding rule, or |NavigationPolicy::kDefaultRule|.
+  size_t rule = 0;
+};
+
+// The policy used when no configuration is provided: allow https only, as
+// the runner always has.
+extern const char kDefaultNavigationPolicy[];
+
+// A compiled policy.
+//
+// Host patterns are stored in a trie keyed on the reversed host name, so a
+// lookup walks the URI's host once, from the top-level domain down, and only
+// checks the scheme, port and path of rules whose host matched. Matching
+// reads the URI in place and never allocates.
+class NavigationPolicy {
+ public:
+  static constexpr size_t kDefaultRule = static_cast<size_t>(-1);
+
+  // Compiles |config|. On failure returns nullopt and, if |error| is
+  // non-null, sets it to a description that includes the line number.
+  static std::optional<NavigationPolicy> Compile(std::string_view config,
+                                                 std::string* error);
+
+  // Returns the decision for |uri| without recording it.
+  NavigationDecision Evaluate(std::u16string_view uri) const;
+
+  // Returns the decision for |uri| and counts a hit on the deciding rule.
+  NavigationDecision Check(std::u16string_view uri);
+
+  size_t rule_count() const { return rules_.size(); }
+
+  // The source text of |rule|, for diagnostics.
+  std::string_view rule_text(size_t rule) const { return rules_[rule].text; }
+
+  // The number of |Check| calls decided by |rule|, or by the default action
+  // for |kDefaultRule|.
+  uint64_t hits(size_t rule) const {
+    return rule == kDefaultRule ? default_hits_ : hits_[rule];
+  }
+
+  void ResetHits();
+
+ private:
+  // Port value meaning any port.
+  static constexpr uint32_t kAnyPort = static_cast<uint32_t>(-1);
+
+  struct Rule {
+    NavigationAction action;
+    // Lower-case scheme, or empty for any.
+    std::u16string scheme;
+    uint32_t port;
+    std::u16string path_prefix;
+    std::string text;
+  };
+
+  // A trie node. Its children are |edges_[first_edge, first_edge +
+  // edge_count)|, sorted by code unit. Rules whose host ends exactly here
+  // are |rule_refs_[exact_begin, suffix_begin)|, and rules that also match
+  // subdomains are |rule_refs_[suffix_begin, suffix_end)|, each in
+  // ascending order. Rules whose host is "*" are the root's suffix rules.
+  struct Node {
+    uint32_t first_edge = 0;
+    uint32_t edge_count = 0;
+    uint32_t exact_begin = 0;
+    uint32_t suffix_begin = 0;
+    uint32_t suffix_end = 0;
+  };
+
+  struct Edge {
+    char16_t unit;
+    uint32_t child;
+  };
+
+  struct UriParts;
+
+  NavigationPolicy() = default;
+
+  // Lowers |best| to the first rule in |rule_refs_[begin, end)| that
+  // matches |uri|, if it is earlier.
+  void ConsiderRules(uint32_t begin,
+                     uint32_t end,
+                     const UriParts& uri,
+                     size_t* best) const;
+
+  bool RuleMatches(const Rule& rule, const UriParts& uri) const;
+
+  // Splits |uri| into the parts rules match against. Returns false if it
+  // does not start with a scheme.
+  static bool ParseUri(std::u16string_view uri, UriParts* parts);
+
+  std::vector<Rule> rules_;
+  std::vector<Node> nodes_;
+  std::vector<Edge> edges_;
+  std::vector<uint32_t> rule_refs_;
+  NavigationAction default_action_ = NavigationAction::kDeny;
+
+  std::vector<uint64_t> hits_;
+  uint64_t default_hits_ = 0;
+};
+
+#endif  // RUNNER_NAVIGATION_POLICY_H_
@@ -0,0 +1,70 @@
+#include "occlusion_tracker.h"
+
+#include <utility>
+
+void OcclusionTracker::SetViewBounds(OcclusionViewId view,
+                                     const IntRect& bounds) {
+  auto [it, added] = views_.try_emplace(view);
+  if (added || it->second.bounds != bounds) {
+    it->second.bounds = bounds;
+    it->second.dirty = true;
+  }
+}
+
+void OcclusionTracker::RemoveView(OcclusionViewId view) {
+  views_.erase(view);
+}
+
+bool OcclusionTracker::SetOverlays(const std::vector<IntRect>& overlays) {
+  ++stats_.overlay_updates;
+  if (overlays == overlay_rects_) {
+    ++stats_.unchanged_overlays;
+    return false;
+  }
+  overlay_rects_ = overlays;
+  Region region = Region::FromRects(overlays);
+  if (region == overlays_) {
+    ++stats_.unchanged_overlays;
+    return false;
+  }
+  overlays_ = std::move(region);
+  for (auto& entry : views_) {
+    entry.second.dirty = true;
+  }
+  return true;
+}
+
+std::vector<OcclusionViewId> OcclusionTracker::Update() {
+  std::vector<OcclusionViewId> changed;
+  for (auto& [id, view] : views_) {
+    if (!view.dirty) {
+      continue;
+    }
+    view.dirty = false;
+    ++stats_.recomputed;
+    Region visible = Region::Subtract(Region(view.bounds), overlays_)
+                         .Translated(-view.bounds.left, -view.bounds.top);
+    if (!view.reported || visible != view.visible) {
+      view.visible = std::move(visible);
+      view.reported = true;
+      changed.push_back(id);
+      ++stats_.changed;
+    }
+  }
+  return changed;
+}
+
+const Region* OcclusionTracker::VisibleRegion(OcclusionViewId view) const {
+  auto it = views_.find(view);
+  return it == views_.end() ? nullptr : &it->second.visible;
+}
+
+bool OcclusionTracker::IsUnoccluded(OcclusionViewId view) const {
+  auto it = views_.find(view);
+  if (it == views_.end()) {
+    return true;
+  }
+  const IntRect& bounds = it->second.bounds;
+  return it->second.visible.IsRect(
+      IntRect{0, 0, bounds.width(), bounds.height()});
+}
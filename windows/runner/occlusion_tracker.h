@@ -0,0 +1,85 @@
+#ifndef RUNNER_OCCLUSION_TRACKER_H_
+#define RUNNER_OCCLUSION_TRACKER_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry.h"
+#include "region.h"
+
+// Which parts of native views are not covered by Flutter content drawn
+// over them.
+//
+// A native child window is always drawn above the Flutter view, so
+// widgets stacked on top of a platform view only show if the window is
+// clipped to the parts of it they leave uncovered. The framework reports
+// the rectangles of those overlays; the tracker subtracts their union from
+// each view's bounds. Views are only recomputed when their bounds or the
+// overlays changed, and only views whose visible region actually changed
+// are reported, so the windows are not re-clipped every frame.
+
+using OcclusionViewId = uint64_t;
+
+struct OcclusionTrackerStats {
+  // Overlay lists received, and those identical to the current one.
+  uint64_t overlay_updates = 0;
+  uint64_t unchanged_overlays = 0;
+  // Visible regions computed, and those that differed from the last one.
+  uint64_t recomputed = 0;
+  uint64_t changed = 0;
+};
+
+class OcclusionTracker {
+ public:
+  OcclusionTracker() = default;
+
+  OcclusionTracker(const OcclusionTracker&) = delete;
+  OcclusionTracker& operator=(const OcclusionTracker&) = delete;
+
+  // Adds |view| at |bounds|, or moves it there. Bounds and overlays share
+  // one coordinate space, e.g. the parent window's client area.
+  void SetViewBounds(OcclusionViewId view, const IntRect& bounds);
+
+  // Stops tracking |view|.
+  void RemoveView(OcclusionViewId view);
+
+  // Replaces the overlay rectangles, which may overlap. Returns false if
+  // they cover the same area as before, in which case nothing is
+  // recomputed.
+  bool SetOverlays(const std::vector<IntRect>& overlays);
+
+  // Recomputes the visible region of every view whose bounds or overlays
+  // changed since the last call, and returns the views whose region
+  // differs from the one last returned.
+  std::vector<OcclusionViewId> Update();
+
+  // Returns |view|'s visible region as of the last |Update|, relative to
+  // its top-left corner, or null if it is not tracked.
+  const Region* VisibleRegion(OcclusionViewId view) const;
+
+  // Returns whether no overlay covers any part of |view|, so it needs no
+  // clipping.
+  bool IsUnoccluded(OcclusionViewId view) const;
+
+  const Region& overlays() const { return overlays_; }
+  const OcclusionTrackerStats& stats() const { return stats_; }
+
+ private:
+  struct View {
+    IntRect bounds;
+    Region visible;
+    bool dirty = true;
+    // Whether |visible| has been returned from |Update| yet.
+    bool reported = false;
+  };
+
+  std::unordered_map<OcclusionViewId, View> views_;
+  // The overlays as last reported, to skip building their union when the
+  // same list is reported again.
+  std::vector<IntRect> overlay_rects_;
+  Region overlays_;
+  OcclusionTrackerStats stats_;
+};
+
+#endif  // RUNNER_OCCLUSION_TRACKER_H_
@@ -0,0 +1,266 @@
+#include "pixel_pipeline.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RUNNER_PIXEL_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RUNNER_PIXEL_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RUNNER_PIXEL_NEON 1
+#endif
+
+namespace {
+
+constexpr size_t kBytesPerPixel = 4;
+
+// Returns |color| * |alpha| / 255, rounded to nearest. Exact for all 8-bit
+// inputs, and cheap to do in 16-bit SIMD lanes since no intermediate value
+// exceeds 0xFFFF.
+inline uint8_t Premultiply(uint32_t color, uint32_t alpha) {
+  uint32_t t = color * alpha + 128;
+  return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+}
+
+#if defined(RUNNER_PIXEL_AVX2)
+// Premultiplies and swizzles two pixels per 128-bit lane, widened to 16
+// bits per channel.
+inline __m256i PremultiplyWide(__m256i pixels) {
+  // Each pixel's alpha in its color lanes and 255 in its alpha lane, which
+  // leaves alpha unchanged.
+  const __m256i color_lanes =
+      _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1,
+                       -1, -1);
+  const __m256i alpha_lanes = _mm256_set_epi16(
+      255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+  __m256i alpha = _mm256_shufflehi_epi16(
+      _mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm256_or_si256(_mm256_and_si256(alpha, color_lanes), alpha_lanes);
+  __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(pixels, alpha),
+                               _mm256_set1_epi16(128));
+  t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+  // BGRA to RGBA.
+  return _mm256_shufflehi_epi16(
+      _mm256_shufflelo_epi16(t, _MM_SHUFFLE(3, 0, 1, 2)),
+      _MM_SHUFFLE(3, 0, 1, 2));
+}
+#endif
+
+#if defined(RUNNER_PIXEL_SSE2)
+// Premultiplies and swizzles two pixels widened to 16 bits per channel.
+inline __m128i PremultiplyWide(__m128i pixels) {
+  const __m128i color_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+  const __m128i alpha_lanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+  __m128i alpha = _mm_shufflehi_epi16(
+      _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_or_si128(_mm_and_si128(alpha, color_lanes), alpha_lanes);
+  __m128i t =
+      _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_set1_epi16(128));
+  t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(t, _MM_SHUFFLE(3, 0, 1, 2)),
+                             _MM_SHUFFLE(3, 0, 1, 2));
+}
+#endif
+
+#if defined(RUNNER_PIXEL_NEON)
+inline uint8x8_t PremultiplyNarrow(uint8x8_t color, uint8x8_t alpha) {
+  uint16x8_t t = vaddq_u16(vmull_u8(color, alpha), vdupq_n_u16(128));
+  return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+inline uint8x16_t PremultiplyNarrow(uint8x16_t color, uint8x16_t alpha) {
+  return vcombine_u8(
+      PremultiplyNarrow(vget_low_u8(color), vget_low_u8(alpha)),
+      PremultiplyNarrow(vget_high_u8(color), vget_high_u8(alpha)));
+}
+#endif
+
+}  // namespace
+
+void ConvertBgraToRgbaPremultiplied(const uint8_t* source,
+                                    uint8_t* destination,
+                                    size_t pixels) {
+  size_t i = 0;
+#if defined(RUNNER_PIXEL_AVX2)
+  const __m256i zero256 = _mm256_setzero_si256();
+  for (; i + 8 <= pixels; i += 8) {
+    __m256i bgra = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(source + i * kBytesPerPixel));
+    // Unpacking and packing both work within 128-bit lanes, so the pixel
+    // order comes out as it went in.
+    __m256i low = PremultiplyWide(_mm256_unpacklo_epi8(bgra, zero256));
+    __m256i high = PremultiplyWide(_mm256_unpackhi_epi8(bgra, zero256));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(destination + i * kBytesPerPixel),
+        _mm256_packus_epi16(low, high));
+  }
+#endif
+#if defined(RUNNER_PIXEL_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= pixels; i += 4) {
+    __m128i bgra = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(source + i * kBytesPerPixel));
+    __m128i low = PremultiplyWide(_mm_unpacklo_epi8(bgra, zero));
+    __m128i high = PremultiplyWide(_mm_unpackhi_epi8(bgra, zero));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(destination + i * kBytesPerPixel),
+        _mm_packus_epi16(low, high));
+  }
+#elif defined(RUNNER_PIXEL_NEON)
+  for (; i + 16 <= pixels; i += 16) {
+    uint8x16x4_t bgra = vld4q_u8(source + i * kBytesPerPixel);
+    uint8x16x4_t rgba;
+    rgba.val[0] = PremultiplyNarrow(bgra.val[2], bgra.val[3]);
+    rgba.val[1] = PremultiplyNarrow(bgra.val[1], bgra.val[3]);
+    rgba.val[2] = PremultiplyNarrow(bgra.val[0], bgra.val[3]);
+    rgba.val[3] = bgra.val[3];
+    vst4q_u8(destination + i * kBytesPerPixel, rgba);
+  }
+#endif
+  ConvertBgraToRgbaPremultipliedScalar(source + i * kBytesPerPixel,
+                                       destination + i * kBytesPerPixel,
+                                       pixels - i);
+}
+
+void ConvertBgraToRgbaPremultipliedScalar(const uint8_t* source,
+                                          uint8_t* destination,
+                                          size_t pixels) {
+  for (size_t i = 0; i < pixels; ++i) {
+    const uint8_t* bgra = source + i * kBytesPerPixel;
+    uint8_t* rgba = destination + i * kBytesPerPixel;
+    uint32_t alpha = bgra[3];
+    rgba[0] = Premultiply(bgra[2], alpha);
+    rgba[1] = Premultiply(bgra[1], alpha);
+    rgba[2] = Premultiply(bgra[0], alpha);
+    rgba[3] = static_cast<uint8_t>(alpha);
+  }
+}
+
+FramePipeline::FramePipeline(FramePipelineOptions options)
+    : options_(options) {
+  if (options_.tile_size < 1) {
+    options_.tile_size = 1;
+  }
+}
+
+void FramePipeline::Invalidate(const IntRect& rect) {
+  MarkTiles(rect);
+}
+
+const std::vector<IntRect>& FramePipeline::Process(const PixelFrame& frame) {
+  changed_.clear();
+  if (frame.pixels == nullptr || frame.width <= 0 || frame.height <= 0) {
+    return changed_;
+  }
+  ++stats_.frames;
+  if (frame.width != width_ || frame.height != height_) {
+    Resize(frame.width, frame.height);
+  }
+
+  for (int32_t row = 0; row < rows_; ++row) {
+    for (int32_t column = 0; column < columns_; ++column) {
+      uint8_t& dirty = dirty_[static_cast<size_t>(row) * columns_ + column];
+      IntRect rect = TileRect(column, row);
+      // The comparison also refreshes the previous frame, so it runs even
+      // for tiles already known to be dirty.
+      if (options_.detect_changes && TileChanged(frame, rect)) {
+        dirty = 1;
+      }
+      if (!dirty) {
+        ++stats_.tiles_skipped;
+        continue;
+      }
+      dirty = 0;
+      ConvertTile(frame, rect);
+      if (!changed_.empty() && changed_.back().top == rect.top &&
+          changed_.back().right == rect.left) {
+        changed_.back().right = rect.right;
+      } else {
+        changed_.push_back(rect);
+      }
+    }
+  }
+  if (changed_.empty()) {
+    ++stats_.unchanged_frames;
+  }
+  return changed_;
+}
+
+void FramePipeline::Resize(int32_t width, int32_t height) {
+  width_ = width;
+  height_ = height;
+  columns_ = (width + options_.tile_size - 1) / options_.tile_size;
+  rows_ = (height + options_.tile_size - 1) / options_.tile_size;
+  size_t bytes = static_cast<size_t>(width) * height * kBytesPerPixel;
+  output_.assign(bytes, 0);
+  if (options_.detect_changes) {
+    previous_.assign(bytes, 0);
+  }
+  dirty_.assign(static_cast<size_t>(columns_) * rows_, 1);
+}
+
+void FramePipeline::MarkTiles(const IntRect& rect) {
+  int32_t left = std::max(rect.left, 0);
+  int32_t top = std::max(rect.top, 0);
+  int32_t right = std::min(rect.right, width_);
+  int32_t bottom = std::min(rect.bottom, height_);
+  if (right <= left || bottom <= top) {
+    return;
+  }
+  int32_t tile = options_.tile_size;
+  for (int32_t row = top / tile; row <= (bottom - 1) / tile; ++row) {
+    for (int32_t column = left / tile; column <= (right - 1) / tile;
+         ++column) {
+      dirty_[static_cast<size_t>(row) * columns_ + column] = 1;
+    }
+  }
+}
+
+IntRect FramePipeline::TileRect(int32_t column, int32_t row) const {
+  int32_t tile = options_.tile_size;
+  return IntRect{column * tile, row * tile,
+                 std::min((column + 1) * tile, width_),
+                 std::min((row + 1) * tile, height_)};
+}
+
+bool FramePipeline::TileChanged(const PixelFrame& frame, const IntRect& rect) {
+  size_t row_bytes = static_cast<size_t>(rect.width()) * kBytesPerPixel;
+  size_t previous_stride = static_cast<size_t>(width_) * kBytesPerPixel;
+  size_t offset = static_cast<size_t>(rect.left) * kBytesPerPixel;
+  for (int32_t y = rect.top; y < rect.bottom; ++y) {
+    const uint8_t* current = frame.pixels + y * frame.stride + offset;
+    uint8_t* previous = previous_.data() + y * previous_stride + offset;
+    if (std::memcmp(current, previous, row_bytes) == 0) {
+      continue;
+    }
+    // The rows above matched, so only the rest needs copying.
+    for (; y < rect.bottom; ++y) {
+      std::memcpy(previous_.data() + y * previous_stride + offset,
+                  frame.pixels + y * frame.stride + offset, row_bytes);
+    }
+    return true;
+  }
+  return false;
+}
+
+void FramePipeline::ConvertTile(const PixelFrame& frame, const IntRect& rect) {
+  size_t output_stride = static_cast<size_t>(width_) * kBytesPerPixel;
+  size_t offset = static_cast<size_t>(rect.left) * kBytesPerPixel;
+  for (int32_t y = rect.top; y < rect.bottom; ++y) {
+    ConvertBgraToRgbaPremultiplied(frame.pixels + y * frame.stride + offset,
+                                   output_.data() + y * output_stride + offset,
+                                   rect.width());
+  }
+  ++stats_.tiles_converted;
+  stats_.bytes_converted +=
+      static_cast<uint64_t>(rect.width()) * rect.height() * kBytesPerPixel;
+}
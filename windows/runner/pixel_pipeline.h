@@ -0,0 +1,110 @@
+#ifndef RUNNER_PIXEL_PIPELINE_H_
+#define RUNNER_PIXEL_PIPELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometry.h"
+
+// Turns captured web view frames into texture pixels, touching only what
+// changed.
+//
+// Captures arrive as 32-bit BGRA with straight alpha, the layout of Windows
+// bitmaps; Flutter's pixel buffer textures take RGBA with premultiplied
+// alpha. The frame is divided into square tiles, and a tile is converted
+// only if it was invalidated or, with change detection, if its pixels
+// differ from the previous frame. Frames in which nothing changed are
+// reported as such, so the texture is not marked dirty at all.
+
+// Converts |pixels| BGRA pixels at |source| to RGBA at |destination|,
+// premultiplying the color channels by alpha with exact rounding. The
+// buffers may not overlap. Uses SIMD where available.
+void ConvertBgraToRgbaPremultiplied(const uint8_t* source,
+                                    uint8_t* destination,
+                                    size_t pixels);
+
+// The same conversion one pixel at a time, as a reference.
+void ConvertBgraToRgbaPremultipliedScalar(const uint8_t* source,
+                                          uint8_t* destination,
+                                          size_t pixels);
+
+// A captured frame: |height| rows of |width| BGRA pixels, |stride| bytes
+// apart.
+struct PixelFrame {
+  const uint8_t* pixels = nullptr;
+  size_t stride = 0;
+  int32_t width = 0;
+  int32_t height = 0;
+};
+
+struct FramePipelineOptions {
+  // Edge length of a tile, in pixels.
+  int32_t tile_size = 64;
+  // Whether to compare every frame against the previous one to find the
+  // changed tiles. Without it, only invalidated areas are converted.
+  bool detect_changes = true;
+};
+
+struct FramePipelineStats {
+  uint64_t frames = 0;
+  // Frames in which no tile changed.
+  uint64_t unchanged_frames = 0;
+  uint64_t tiles_converted = 0;
+  uint64_t tiles_skipped = 0;
+  uint64_t bytes_converted = 0;
+};
+
+class FramePipeline {
+ public:
+  explicit FramePipeline(FramePipelineOptions options);
+
+  FramePipeline(const FramePipeline&) = delete;
+  FramePipeline& operator=(const FramePipeline&) = delete;
+
+  // Marks |rect| as changed in the next frame, e.g. from the engine's own
+  // damage reports.
+  void Invalidate(const IntRect& rect);
+
+  // Brings the output up to date with |frame|. A frame of a different size
+  // replaces the output entirely. Returns the changed areas of the output,
+  // tile-aligned, with adjacent tiles of a row merged; empty if nothing
+  // changed. The result is valid until the next call.
+  const std::vector<IntRect>& Process(const PixelFrame& frame);
+
+  // The converted RGBA frame, |width() * 4| bytes per row.
+  const uint8_t* pixels() const { return output_.data(); }
+  int32_t width() const { return width_; }
+  int32_t height() const { return height_; }
+  const FramePipelineStats& stats() const { return stats_; }
+
+ private:
+  // Resizes the buffers for a |width| x |height| frame and invalidates it.
+  void Resize(int32_t width, int32_t height);
+
+  // Marks the tiles overlapping |rect| dirty.
+  void MarkTiles(const IntRect& rect);
+
+  IntRect TileRect(int32_t column, int32_t row) const;
+
+  // Returns true if the tile at |rect| differs from the previous frame, and
+  // updates the copy of the previous frame if so.
+  bool TileChanged(const PixelFrame& frame, const IntRect& rect);
+
+  void ConvertTile(const PixelFrame& frame, const IntRect& rect);
+
+  FramePipelineOptions options_;
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+  int32_t columns_ = 0;
+  int32_t rows_ = 0;
+  // One flag per tile, row by row.
+  std::vector<uint8_t> dirty_;
+  // The previous frame in its source layout, packed, for change detection.
+  std::vector<uint8_t> previous_;
+  std::vector<uint8_t> output_;
+  std::vector<IntRect> changed_;
+  FramePipelineStats stats_;
+};
+
+#endif  // RUNNER_PIXEL_PIPELINE_H_
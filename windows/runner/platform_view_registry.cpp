@@ -0,0 +1,113 @@
+#include "platform_view_registry.h"
+
+namespace {
+
+// The smallest table allocated once the first key is inserted.
+constexpr size_t kMinBucketCount = 16;
+
+// Finalizer from SplitMix64. Native handles are small, aligned integers, so
+// they need a full avalanche before masking.
+uint64_t MixKey(uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xBF58476D1CE4E5B9ull;
+  key ^= key >> 27;
+  key *= 0x94D049BB133111EBull;
+  key ^= key >> 31;
+  return key;
+}
+
+}  // namespace
+
+PlatformViewKeyIndex::PlatformViewKeyIndex() = default;
+
+size_t PlatformViewKeyIndex::BucketFor(PlatformViewKey key) const {
+  return static_cast<size_t>(MixKey(static_cast<uint64_t>(key))) & mask_;
+}
+
+bool PlatformViewKeyIndex::Insert(PlatformViewKey key, SlotHandle handle) {
+  if (key == 0) {
+    return false;
+  }
+  // Keep the load factor at or below one half.
+  if ((size_ + 1) * 2 > buckets_.size()) {
+    Rehash(buckets_.empty() ? kMinBucketCount : buckets_.size() * 2);
+  }
+  for (size_t i = BucketFor(key);; i = (i + 1) & mask_) {
+    Bucket& bucket = buckets_[i];
+    if (bucket.key == key) {
+      return false;
+    }
+    if (bucket.key == 0) {
+      bucket.key = key;
+      bucket.handle = handle;
+      ++size_;
+      return true;
+    }
+  }
+}
+
+SlotHandle PlatformViewKeyIndex::Find(PlatformViewKey key) const {
+  if (size_ == 0 || key == 0) {
+    return SlotHandle{};
+  }
+  for (size_t i = BucketFor(key);; i = (i + 1) & mask_) {
+    const Bucket& bucket = buckets_[i];
+    if (bucket.key == key) {
+      return bucket.handle;
+    }
+    if (bucket.key == 0) {
+      return SlotHandle{};
+    }
+  }
+}
+
+bool PlatformViewKeyIndex::Erase(PlatformViewKey key) {
+  if (size_ == 0 || key == 0) {
+    return false;
+  }
+  size_t hole = BucketFor(key);
+  while (buckets_[hole].key != key) {
+    if (buckets_[hole].key == 0) {
+      return false;
+    }
+    hole = (hole + 1) & mask_;
+  }
+
+  // Shift later members of the probe run back into the hole so that every
+  // remaining key stays reachable from its home bucket.
+  for (size_t next = (hole + 1) & mask_; buckets_[next].key != 0;
+       next = (next + 1) & mask_) {
+    size_t home = BucketFor(buckets_[next].key);
+    bool home_in_gap = hole <= next ? (home > hole && home <= next)
+                                    : (home > hole || home <= next);
+    if (!home_in_gap) {
+      buckets_[hole] = buckets_[next];
+      hole = next;
+    }
+  }
+  buckets_[hole] = Bucket{};
+  --size_;
+  return true;
+}
+
+void PlatformViewKeyIndex::Reserve(size_t count) {
+  size_t bucket_count = kMinBucketCount;
+  while (bucket_count < count * 2) {
+    bucket_count *= 2;
+  }
+  if (bucket_count > buckets_.size()) {
+    Rehash(bucket_count);
+  }
+}
+
+void PlatformViewKeyIndex::Rehash(size_t bucket_count) {
+  std::vector<Bucket> old_buckets(bucket_count);
+  old_buckets.swap(buckets_);
+  mask_ = bucket_count - 1;
+  size_ = 0;
+  for (const Bucket& bucket : old_buckets) {
+    if (bucket.key != 0) {
+      Insert(bucket.key, bucket.handle);
+    }
+  }
+}
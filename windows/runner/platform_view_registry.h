@@ -0,0 +1,135 @@
+#ifndef RUNNER_PLATFORM_VIEW_REGISTRY_H_
+#define RUNNER_PLATFORM_VIEW_REGISTRY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "slot_map.h"
+
+// Identifies a platform view by its native handle (an HWND on Windows).
+// Zero is reserved and never a valid key.
+using PlatformViewKey = std::uintptr_t;
+
+// An open-addressed hash index from |PlatformViewKey| to |SlotHandle|.
+//
+// Buckets are stored inline in a single array and probed linearly; removal
+// uses backward-shift deletion so lookups never have to skip tombstones.
+class PlatformViewKeyIndex {
+ public:
+  PlatformViewKeyIndex();
+
+  // Associates |key| with |handle|. Returns false if |key| is already present.
+  bool Insert(PlatformViewKey key, SlotHandle handle);
+
+  // Returns the handle for |key|, or a null handle if it is not present.
+  SlotHandle Find(PlatformViewKey key) const;
+
+  // Removes |key|. Returns false if it was not present.
+  bool Erase(PlatformViewKey key);
+
+  // Ensures |count| keys can be inserted without rehashing.
+  void Reserve(size_t count);
+
+  size_t size() const { return size_; }
+
+ private:
+  struct Bucket {
+    PlatformViewKey key = 0;
+    SlotHandle handle;
+  };
+
+  size_t BucketFor(PlatformViewKey key) const;
+  void Rehash(size_t bucket_count);
+
+  std::vector<Bucket> buckets_;
+  size_t mask_ = 0;
+  size_t size_ = 0;
+};
+
+// Tracks the live platform views of a process.
+//
+// Each view is stored once in a |SlotMap| and is reachable either through the
+// generation-checked |SlotHandle| returned by |Add| (safe to capture in
+// asynchronous callbacks that may outlive the view) or through its native
+// key (what a window procedure receives). Both lookups are O(1).
+template <typename View>
+class PlatformViewRegistry {
+ public:
+  using Handle = SlotHandle;
+
+  PlatformViewRegistry() = default;
+
+  PlatformViewRegistry(const PlatformViewRegistry&) = delete;
+  PlatformViewRegistry& operator=(const PlatformViewRegistry&) = delete;
+
+  // Registers |view| under |key|. Returns a null handle if |key| is zero or
+  // already registered.
+  Handle Add(PlatformViewKey key, View view) {
+    if (key == 0 || !index_.Find(key).IsNull()) {
+      return Handle{};
+    }
+    Handle handle = views_.Emplace(Entry{key, std::move(view)});
+    index_.Insert(key, handle);
+    return handle;
+  }
+
+  // Returns the view referenced by |handle|, or nullptr if it was removed.
+  View* Get(Handle handle) {
+    Entry* entry = views_.Get(handle);
+    return entry ? &entry->view : nullptr;
+  }
+
+  // Returns the view registered under |key|, or nullptr.
+  View* Find(PlatformViewKey key) { return Get(index_.Find(key)); }
+
+  // Returns the handle of the view registered under |key|, or a null handle.
+  Handle FindHandle(PlatformViewKey key) const { return index_.Find(key); }
+
+  // Returns the key |handle| was registered under, or zero if it is stale.
+  PlatformViewKey KeyOf(Handle handle) const {
+    const Entry* entry = views_.Get(handle);
+    return entry ? entry->key : 0;
+  }
+
+  // Unregisters the view referenced by |handle|. Returns false if stale.
+  bool Remove(Handle handle) {
+    const Entry* entry = views_.Get(handle);
+    if (entry == nullptr) {
+      return false;
+    }
+    index_.Erase(entry->key);
+    return views_.Erase(handle);
+  }
+
+  // Unregisters the view registered under |key|. Returns false if absent.
+  bool Remove(PlatformViewKey key) { return Remove(index_.Find(key)); }
+
+  // Invokes |callback(key, view)| for every live view in storage order.
+  template <typename Callback>
+  void ForEach(Callback&& callback) {
+    for (Entry& entry : views_) {
+      callback(entry.key, entry.view);
+    }
+  }
+
+  void Reserve(size_t count) {
+    views_.Reserve(count);
+    index_.Reserve(count);
+  }
+
+  size_t size() const { return views_.size(); }
+  bool empty() const { return views_.empty(); }
+
+ private:
+  struct Entry {
+    PlatformViewKey key;
+    View view;
+  };
+
+  SlotMap<Entry> views_;
+  PlatformViewKeyIndex index_;
+};
+
+#endif  // RUNNER_PLATFORM_VIEW_REGISTRY_H_
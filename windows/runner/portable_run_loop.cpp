@@ -0,0 +1,65 @@
+#include "portable_run_loop.h"
+
+#include <optional>
+
+PortableRunLoop::PortableRunLoop(RunLoopBudget budget)
+    : budget_(budget), scheduler_([this] { Wake(); }) {}
+
+void PortableRunLoop::Run() {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (quit_) {
+        quit_ = false;
+        return;
+      }
+    }
+    TaskScheduler::Clock::time_point now = TaskScheduler::Clock::now();
+    if (scheduler_.RunUntil(now + budget_.tasks)) {
+      continue;
+    }
+    std::optional<TaskScheduler::Clock::time_point> wake_time =
+        scheduler_.NextWakeTime();
+    if (scheduler_.HasIdleTasks() &&
+        (!wake_time || *wake_time > TaskScheduler::Clock::now())) {
+      scheduler_.RunIdleTasks(TaskScheduler::Clock::now() + budget_.idle);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto woken = [this] { return woken_ || quit_; };
+    if (!wake_time) {
+      condition_.wait(lock, woken);
+    } else {
+      condition_.wait_until(lock, *wake_time, woken);
+    }
+    woken_ = false;
+  }
+}
+
+void PortableRunLoop::RunUntilIdle() {
+  while (true) {
+    TaskScheduler::Clock::time_point now = TaskScheduler::Clock::now();
+    if (scheduler_.RunUntil(now + budget_.tasks) ||
+        scheduler_.RunIdleTasks(TaskScheduler::Clock::now() + budget_.idle)) {
+      continue;
+    }
+    std::optional<TaskScheduler::Clock::time_point> wake_time =
+        scheduler_.NextWakeTime();
+    if (!wake_time || *wake_time > TaskScheduler::Clock::now()) {
+      return;
+    }
+  }
+}
+
+void PortableRunLoop::Quit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  quit_ = true;
+  condition_.notify_one();
+}
+
+void PortableRunLoop::Wake() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  woken_ = true;
+  condition_.notify_one();
+}
@@ -0,0 +1,43 @@
+#ifndef RUNNER_PORTABLE_RUN_LOOP_H_
+#define RUNNER_PORTABLE_RUN_LOOP_H_
+
+#include <condition_variable>
+#include <mutex>
+
+#include "task_scheduler.h"
+
+// Runs a |TaskScheduler| on the calling thread, sleeping on a condition
+// variable between tasks. It has no window messages to interleave, so it
+// drives the same scheduling policy as |Win32RunLoop| on any platform, for
+// tests and latency benchmarks.
+class PortableRunLoop {
+ public:
+  explicit PortableRunLoop(RunLoopBudget budget = RunLoopBudget());
+
+  PortableRunLoop(const PortableRunLoop&) = delete;
+  PortableRunLoop& operator=(const PortableRunLoop&) = delete;
+
+  TaskScheduler& scheduler() { return scheduler_; }
+
+  // Runs tasks until |Quit| is called.
+  void Run();
+
+  // Runs tasks until no due or idle task is left, without waiting for
+  // delayed tasks.
+  void RunUntilIdle();
+
+  // Makes |Run| return once the current task finishes. Thread-safe.
+  void Quit();
+
+ private:
+  void Wake();
+
+  RunLoopBudget budget_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool woken_ = false;
+  bool quit_ = false;
+  TaskScheduler scheduler_;
+};
+
+#endif  // RUNNER_PORTABLE_RUN_LOOP_H_
@@ -0,0 +1,344 @@
+#include "region.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr int32_t kMaxCoordinate = std::numeric_limits<int32_t>::max();
+
+bool Overlaps(const IntRect& a, const IntRect& b) {
+  return a.left < b.right && b.left < a.right && a.top < b.bottom &&
+         b.top < a.bottom;
+}
+
+// The span merges below append the result of combining one band's spans
+// from each operand to |out|. The inputs are sorted, disjoint and
+// non-touching, and so are the outputs.
+
+template <typename Span>
+void UnionSpans(const Span* a,
+                size_t a_count,
+                const Span* b,
+                size_t b_count,
+                size_t first,
+                std::vector<Span>* out) {
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a_count || j < b_count) {
+    const Span& next = (j == b_count || (i < a_count && a[i].left <= b[j].left))
+                           ? a[i++]
+                           : b[j++];
+    if (out->size() > first && out->back().right >= next.left) {
+      out->back().right = std::max(out->back().right, next.right);
+    } else {
+      out->push_back(next);
+    }
+  }
+}
+
+template <typename Span>
+void IntersectSpans(const Span* a,
+                    size_t a_count,
+                    const Span* b,
+                    size_t b_count,
+                    std::vector<Span>* out) {
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a_count && j < b_count) {
+    int32_t left = std::max(a[i].left, b[j].left);
+    int32_t right = std::min(a[i].right, b[j].right);
+    if (left < right) {
+      out->push_back(Span{left, right});
+    }
+    if (a[i].right < b[j].right) {
+      ++i;
+    } else {
+      ++j;
+    }
+  }
+}
+
+template <typename Span>
+void SubtractSpans(const Span* a,
+                   size_t a_count,
+                   const Span* b,
+                   size_t b_count,
+                   std::vector<Span>* out) {
+  size_t j = 0;
+  for (size_t i = 0; i < a_count; ++i) {
+    int32_t left = a[i].left;
+    int32_t right = a[i].right;
+    // Spans of |b| entirely left of this one are left of every later one.
+    while (j < b_count && b[j].right <= left) {
+      ++j;
+    }
+    for (size_t k = j; k < b_count && b[k].left < right && left < right;
+         ++k) {
+      if (b[k].left > left) {
+        out->push_back(Span{left, b[k].left});
+      }
+      left = std::max(left, b[k].right);
+    }
+    if (left < right) {
+      out->push_back(Span{left, right});
+    }
+  }
+}
+
+}  // namespace
+
+Region::Region(const IntRect& rect) {
+  if (rect.IsEmpty()) {
+    return;
+  }
+  spans_.push_back(Span{rect.left, rect.right});
+  bands_.push_back(Band{rect.top, rect.bottom, 0, 1});
+}
+
+Region Region::FromRects(const std::vector<IntRect>& rects) {
+  std::vector<IntRect> sorted;
+  sorted.reserve(rects.size());
+  std::vector<int32_t> edges;
+  edges.reserve(rects.size() * 2);
+  for (const IntRect& rect : rects) {
+    if (rect.IsEmpty()) {
+      continue;
+    }
+    sorted.push_back(rect);
+    edges.push_back(rect.top);
+    edges.push_back(rect.bottom);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const IntRect& a, const IntRect& b) { return a.top < b.top; });
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  Region result;
+  // The rectangles covering the current band, sorted by left edge, so each
+  // band's spans come out in order without sorting.
+  std::vector<IntRect> active;
+  size_t next = 0;
+  for (size_t e = 0; e + 1 < edges.size(); ++e) {
+    int32_t top = edges[e];
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [top](const IntRect& rect) {
+                                  return rect.bottom <= top;
+                                }),
+                 active.end());
+    for (; next < sorted.size() && sorted[next].top <= top; ++next) {
+      active.insert(std::upper_bound(active.begin(), active.end(),
+                                     sorted[next],
+                                     [](const IntRect& a, const IntRect& b) {
+                                       return a.left < b.left;
+                                     }),
+                    sorted[next]);
+    }
+    uint32_t first = static_cast<uint32_t>(result.spans_.size());
+    for (const IntRect& rect : active) {
+      if (result.spans_.size() > first &&
+          result.spans_.back().right >= rect.left) {
+        result.spans_.back().right =
+            std::max(result.spans_.back().right, rect.right);
+      } else {
+        result.spans_.push_back(Span{rect.left, rect.right});
+      }
+    }
+    result.AppendBand(top, edges[e + 1], first);
+  }
+  return result;
+}
+
+Region Region::Union(const Region& a, const Region& b) {
+  if (a.IsEmpty()) {
+    return b;
+  }
+  if (b.IsEmpty()) {
+    return a;
+  }
+  return Combine(a, b, Op::kUnion);
+}
+
+Region Region::Intersect(const Region& a, const Region& b) {
+  if (a.IsEmpty() || b.IsEmpty() || !Overlaps(a.bounds(), b.bounds())) {
+    return Region();
+  }
+  return Combine(a, b, Op::kIntersect);
+}
+
+Region Region::Subtract(const Region& a, const Region& b) {
+  if (a.IsEmpty() || b.IsEmpty() || !Overlaps(a.bounds(), b.bounds())) {
+    return a;
+  }
+  return Combine(a, b, Op::kSubtract);
+}
+
+Region Region::Combine(const Region& a, const Region& b, Op op) {
+  Region result;
+  result.bands_.reserve(a.bands_.size() + b.bands_.size());
+  result.spans_.reserve(a.spans_.size() + b.spans_.size());
+  size_t ia = 0;
+  size_t ib = 0;
+  const size_t a_count = a.bands_.size();
+  const size_t b_count = b.bands_.size();
+  // Rows above |y| are done; the current bands may have started above it.
+  int32_t y = std::numeric_limits<int32_t>::min();
+  while (ia < a_count || ib < b_count) {
+    // Past the end of |a| only a union has anything left to add.
+    if (ia == a_count && op != Op::kUnion) {
+      break;
+    }
+    if (ib == b_count && op == Op::kIntersect) {
+      break;
+    }
+    const Band* band_a = ia < a_count ? &a.bands_[ia] : nullptr;
+    const Band* band_b = ib < b_count ? &b.bands_[ib] : nullptr;
+    int32_t top = std::max(y, std::min(band_a ? band_a->top : kMaxCoordinate,
+                                       band_b ? band_b->top : kMaxCoordinate));
+    bool in_a = band_a && band_a->top <= top;
+    bool in_b = band_b && band_b->top <= top;
+    // The rows up to the next edge of either operand.
+    int32_t bottom = kMaxCoordinate;
+    if (band_a) {
+      bottom = std::min(bottom, in_a ? band_a->bottom : band_a->top);
+    }
+    if (band_b) {
+      bottom = std::min(bottom, in_b ? band_b->bottom : band_b->top);
+    }
+
+    const Span* spans_a = in_a ? &a.spans_[band_a->first] : nullptr;
+    size_t count_a = in_a ? band_a->count : 0;
+    const Span* spans_b = in_b ? &b.spans_[band_b->first] : nullptr;
+    size_t count_b = in_b ? band_b->count : 0;
+    uint32_t first = static_cast<uint32_t>(result.spans_.size());
+    switch (op) {
+      case Op::kUnion:
+        UnionSpans(spans_a, count_a, spans_b, count_b, first, &result.spans_);
+        break;
+      case Op::kIntersect:
+        IntersectSpans(spans_a, count_a, spans_b, count_b, &result.spans_);
+        break;
+      case Op::kSubtract:
+        SubtractSpans(spans_a, count_a, spans_b, count_b, &result.spans_);
+        break;
+    }
+    result.AppendBand(top, bottom, first);
+
+    if (in_a && band_a->bottom == bottom) {
+      ++ia;
+    }
+    if (in_b && band_b->bottom == bottom) {
+      ++ib;
+    }
+    y = bottom;
+  }
+  return result;
+}
+
+void Region::AppendBand(int32_t top, int32_t bottom, uint32_t first) {
+  uint32_t count = static_cast<uint32_t>(spans_.size()) - first;
+  if (count == 0) {
+    return;
+  }
+  if (!bands_.empty()) {
+    Band& last = bands_.back();
+    if (last.bottom == top && last.count == count &&
+        std::equal(spans_.begin() + last.first,
+                   spans_.begin() + last.first + count,
+                   spans_.begin() + first)) {
+      last.bottom = bottom;
+      spans_.resize(first);
+      return;
+    }
+  }
+  bands_.push_back(Band{top, bottom, first, count});
+}
+
+Region Region::Translated(int32_t dx, int32_t dy) const {
+  Region result = *this;
+  for (Band& band : result.bands_) {
+    band.top += dy;
+    band.bottom += dy;
+  }
+  for (Span& span : result.spans_) {
+    span.left += dx;
+    span.right += dx;
+  }
+  return result;
+}
+
+bool Region::Contains(int32_t x, int32_t y) const {
+  auto band = std::upper_bound(
+      bands_.begin(), bands_.end(), y,
+      [](int32_t value, const Band& band) { return value < band.bottom; });
+  if (band == bands_.end() || band->top > y) {
+    return false;
+  }
+  auto begin = spans_.begin() + band->first;
+  auto end = begin + band->count;
+  auto span = std::upper_bound(
+      begin, end, x,
+      [](int32_t value, const Span& span) { return value < span.right; });
+  return span != end && span->left <= x;
+}
+
+IntRect Region::bounds() const {
+  if (bands_.empty()) {
+    return IntRect();
+  }
+  IntRect bounds{kMaxCoordinate, bands_.front().top,
+                 std::numeric_limits<int32_t>::min(), bands_.back().bottom};
+  for (const Band& band : bands_) {
+    bounds.left = std::min(bounds.left, spans_[band.first].left);
+    bounds.right =
+        std::max(bounds.right, spans_[band.first + band.count - 1].right);
+  }
+  return bounds;
+}
+
+bool Region::IsRect(const IntRect& rect) const {
+  if (rect.IsEmpty()) {
+    return IsEmpty();
+  }
+  return bands_.size() == 1 && bands_[0].top == rect.top &&
+         bands_[0].bottom == rect.bottom && spans_.size() == 1 &&
+         spans_[0].left == rect.left && spans_[0].right == rect.right;
+}
+
+int64_t Region::Area() const {
+  int64_t area = 0;
+  for (const Band& band : bands_) {
+    int64_t width = 0;
+    for (uint32_t i = band.first; i < band.first + band.count; ++i) {
+      width += spans_[i].right - spans_[i].left;
+    }
+    area += width * (band.bottom - band.top);
+  }
+  return area;
+}
+
+std::vector<IntRect> Region::Rects() const {
+  std::vector<IntRect> rects;
+  rects.reserve(spans_.size());
+  for (const Band& band : bands_) {
+    for (uint32_t i = band.first; i < band.first + band.count; ++i) {
+      rects.push_back(
+          IntRect{spans_[i].left, band.top, spans_[i].right, band.bottom});
+    }
+  }
+  return rects;
+}
+
+bool Region::operator==(const Region& other) const {
+  if (bands_.size() != other.bands_.size() || spans_ != other.spans_) {
+    return false;
+  }
+  for (size_t i = 0; i < bands_.size(); ++i) {
+    const Band& a = bands_[i];
+    const Band& b = other.bands_[i];
+    if (a.top != b.top || a.bottom != b.bottom || a.count != b.count) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,87 @@
+#ifndef RUNNER_REGION_H_
+#define RUNNER_REGION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometry.h"
+
+// A set of pixels, stored as y-banded rectangles like X11 and pixman
+// regions.
+//
+// The region is a list of bands sorted top to bottom; each band covers the
+// rows [top, bottom) and holds disjoint, non-touching spans sorted left to
+// right. Vertically adjacent bands always differ, since identical ones are
+// merged, so every set of pixels has exactly one representation and two
+// regions are equal exactly when their bands are.
+//
+// Union, intersection and subtraction walk both operands' bands in one
+// pass, in time linear in their size, and rebuild the result band by band.
+// That keeps recomputing a region from scratch every frame cheap.
+class Region {
+ public:
+  Region() = default;
+  explicit Region(const IntRect& rect);
+
+  // Returns the union of |rects|, which may overlap, in a single sweep.
+  static Region FromRects(const std::vector<IntRect>& rects);
+
+  static Region Union(const Region& a, const Region& b);
+  static Region Intersect(const Region& a, const Region& b);
+  static Region Subtract(const Region& a, const Region& b);
+
+  // Returns the region moved by |dx|, |dy|.
+  Region Translated(int32_t dx, int32_t dy) const;
+
+  bool IsEmpty() const { return bands_.empty(); }
+  bool Contains(int32_t x, int32_t y) const;
+
+  // Returns the smallest rectangle containing the region.
+  IntRect bounds() const;
+
+  // Returns whether the region is exactly |rect|.
+  bool IsRect(const IntRect& rect) const;
+
+  // Returns the number of pixels in the region.
+  int64_t Area() const;
+
+  // Returns the region as disjoint rectangles, one per span, in band order.
+  std::vector<IntRect> Rects() const;
+  size_t rect_count() const { return spans_.size(); }
+
+  bool operator==(const Region& other) const;
+  bool operator!=(const Region& other) const { return !(*this == other); }
+
+ private:
+  struct Span {
+    int32_t left;
+    int32_t right;
+
+    bool operator==(const Span& other) const {
+      return left == other.left && right == other.right;
+    }
+  };
+
+  struct Band {
+    int32_t top;
+    int32_t bottom;
+    // The band's spans are spans_[first, first + count).
+    uint32_t first;
+    uint32_t count;
+  };
+
+  enum class Op { kUnion, kIntersect, kSubtract };
+
+  static Region Combine(const Region& a, const Region& b, Op op);
+
+  // Appends the rows [top, bottom) with the spans last added to |spans_|
+  // from index |first| on, merging with the previous band when it is
+  // adjacent and identical. Drops the band if it has no spans.
+  void AppendBand(int32_t top, int32_t bottom, uint32_t first);
+
+  std::vector<Band> bands_;
+  std::vector<Span> spans_;
+};
+
+#endif  // RUNNER_REGION_H_
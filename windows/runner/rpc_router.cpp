@@ -0,0 +1,329 @@
+#include "rpc_router.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Displacements tried per bucket before the table is enlarged.
+constexpr uint32_t kMaxDisplacement = 1 << 12;
+
+// Table sizes tried, as doublings of the smallest, before the name hash is
+// reseeded.
+constexpr int kTableDoublings = 3;
+
+// FNV-1a over |name|.
+uint64_t HashMethod(std::string_view name, uint64_t seed) {
+  uint64_t hash = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+  for (char c : name) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+size_t BucketOf(uint64_t hash, size_t bucket_count) {
+  return static_cast<size_t>(hash >> 32) & (bucket_count - 1);
+}
+
+// The slot |hash| lands in under |displacement|. The splitmix64 finalizer
+// makes each displacement an independent-looking placement.
+size_t SlotOf(uint64_t hash, uint32_t displacement, size_t slot_count) {
+  uint64_t x = hash + displacement * 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return static_cast<size_t>(x) & (slot_count - 1);
+}
+
+size_t NextPowerOfTwo(size_t value) {
+  size_t power = 1;
+  while (power < value) {
+    power *= 2;
+  }
+  return power;
+}
+
+void WriteId(JsonWriter& writer, JsonValue id) {
+  switch (id.type()) {
+    case JsonType::kNumber:
+      writer.Raw(id.GetNumberText());
+      break;
+    case JsonType::kString:
+      writer.String(id.GetString());
+      break;
+    default:
+      writer.Null();
+      break;
+  }
+}
+
+}  // namespace
+
+namespace rpc_internal {
+
+bool FromJson(JsonValue value, bool* out) {
+  if (value.type() != JsonType::kBool) {
+    return false;
+  }
+  *out = value.GetBool();
+  return true;
+}
+
+bool FromJson(JsonValue value, int32_t* out) {
+  int64_t integer;
+  if (!value.GetInt64(&integer) ||
+      integer < std::numeric_limits<int32_t>::min() ||
+      integer > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  *out = static_cast<int32_t>(integer);
+  return true;
+}
+
+bool FromJson(JsonValue value, int64_t* out) {
+  return value.GetInt64(out);
+}
+
+bool FromJson(JsonValue value, uint32_t* out) {
+  int64_t integer;
+  if (!value.GetInt64(&integer) || integer < 0 ||
+      integer > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  *out = static_cast<uint32_t>(integer);
+  return true;
+}
+
+bool FromJson(JsonValue value, double* out) {
+  if (value.type() != JsonType::kNumber) {
+    return false;
+  }
+  *out = value.GetNumber();
+  return true;
+}
+
+bool FromJson(JsonValue value, std::string_view* out) {
+  if (value.type() != JsonType::kString) {
+    return false;
+  }
+  *out = value.GetString();
+  return true;
+}
+
+bool FromJson(JsonValue value, std::string* out) {
+  if (value.type() != JsonType::kString) {
+    return false;
+  }
+  out->assign(value.GetString());
+  return true;
+}
+
+bool FromJson(JsonValue value, JsonValue* out) {
+  *out = value;
+  return value.exists();
+}
+
+}  // namespace rpc_internal
+
+JsonWriter& RpcReply::Result() {
+  if (!started_) {
+    started_ = true;
+    output_->append("\"result\":");
+  }
+  return writer_;
+}
+
+void RpcReply::Error(int code, std::string_view message) {
+  output_->resize(start_);
+  started_ = true;
+  has_error_ = true;
+  output_->append("\"error\":");
+  JsonWriter writer(output_);
+  writer.BeginObject();
+  writer.Key("code");
+  writer.Int(code);
+  writer.Key("message");
+  writer.String(message);
+  writer.EndObject();
+}
+
+RpcRouter::RpcRouter() = default;
+
+void RpcRouter::RegisterRaw(std::string_view method, Handler handler) {
+  // Registration is rare and the table may be stale, so search linearly.
+  for (Method& existing : methods_) {
+    if (existing.name == method) {
+      existing.handler = std::move(handler);
+      return;
+    }
+  }
+  methods_.push_back(Method{std::string(method), std::move(handler)});
+  table_stale_ = true;
+}
+
+void RpcRouter::BuildTable() {
+  // Twice as many slots as methods and two methods per bucket keep the
+  // search for displacements short.
+  size_t slot_count = NextPowerOfTwo(methods_.size() * 2);
+  for (;; ++seed_) {
+    for (int doubling = 0; doubling < kTableDoublings; ++doubling) {
+      if (TryBuildTable(slot_count << doubling)) {
+        return;
+      }
+    }
+  }
+}
+
+bool RpcRouter::TryBuildTable(size_t slot_count) {
+  size_t bucket_count = NextPowerOfTwo((methods_.size() + 1) / 2);
+  std::vector<std::vector<uint32_t>> buckets(bucket_count);
+  std::vector<uint64_t> hashes(methods_.size());
+  for (size_t i = 0; i < methods_.size(); ++i) {
+    hashes[i] = HashMethod(methods_[i].name, seed_);
+    buckets[BucketOf(hashes[i], bucket_count)].push_back(
+        static_cast<uint32_t>(i));
+  }
+  // The largest buckets are the hardest to place, so place them while the
+  // table is emptiest.
+  std::vector<size_t> order(bucket_count);
+  for (size_t i = 0; i < bucket_count; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  std::vector<uint32_t> table(slot_count, 0);
+  std::vector<uint32_t> displacements(bucket_count, 0);
+  for (size_t bucket : order) {
+    const std::vector<uint32_t>& members = buckets[bucket];
+    if (members.empty()) {
+      break;
+    }
+    bool placed = false;
+    for (uint32_t displacement = 0;
+         !placed && displacement < kMaxDisplacement; ++displacement) {
+      size_t claimed = 0;
+      for (; claimed < members.size(); ++claimed) {
+        uint32_t& slot = table[SlotOf(hashes[members[claimed]], displacement,
+                                      slot_count)];
+        if (slot != 0) {
+          break;
+        }
+        slot = members[claimed] + 1;
+      }
+      placed = claimed == members.size();
+      if (placed) {
+        displacements[bucket] = displacement;
+      } else {
+        // Release the slots this attempt claimed.
+        for (size_t i = 0; i < claimed; ++i) {
+          table[SlotOf(hashes[members[i]], displacement, slot_count)] = 0;
+        }
+      }
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+  table_ = std::move(table);
+  displacements_ = std::move(displacements);
+  return true;
+}
+
+RpcRouter::Method* RpcRouter::Lookup(std::string_view name) {
+  if (table_stale_) {
+    BuildTable();
+    table_stale_ = false;
+  }
+  if (table_.empty()) {
+    return nullptr;
+  }
+  uint64_t hash = HashMethod(name, seed_);
+  uint32_t displacement =
+      displacements_[BucketOf(hash, displacements_.size())];
+  uint32_t slot = table_[SlotOf(hash, displacement, table_.size())];
+  if (slot == 0 || methods_[slot - 1].name != name) {
+    return nullptr;
+  }
+  return &methods_[slot - 1];
+}
+
+void RpcRouter::WriteError(JsonValue id,
+                           int code,
+                           std::string_view message,
+                           std::string* reply) {
+  ++stats_.errors;
+  reply->append("{\"id\":");
+  JsonWriter writer(reply);
+  WriteId(writer, id);
+  reply->push_back(',');
+  RpcReply(reply, reply->size()).Error(code, message);
+  reply->push_back('}');
+}
+
+bool RpcRouter::Dispatch(std::string_view request, std::string* reply) {
+  reply->clear();
+  if (!document_.Parse(request, nullptr)) {
+    ++stats_.invalid;
+    WriteError(JsonValue(), kRpcParseError, "Parse error", reply);
+    return true;
+  }
+  // Other JSON messages may share the channel; only objects with a method
+  // are requests.
+  JsonValue root = document_.root();
+  JsonValue method_name = root.Find("method");
+  if (method_name.type() != JsonType::kString) {
+    ++stats_.invalid;
+    return false;
+  }
+  JsonValue id = root.Find("id");
+  bool notification = !id.exists();
+  if (!notification && id.type() != JsonType::kNumber &&
+      id.type() != JsonType::kString) {
+    ++stats_.invalid;
+    WriteError(JsonValue(), kRpcInvalidRequest, "Invalid request", reply);
+    return true;
+  }
+  ++(notification ? stats_.notifications : stats_.requests);
+
+  Method* method = Lookup(method_name.GetString());
+  if (method == nullptr) {
+    ++stats_.unknown_methods;
+    if (notification) {
+      return false;
+    }
+    WriteError(id, kRpcMethodNotFound, "Method not found", reply);
+    return true;
+  }
+
+  reply->append("{\"id\":");
+  JsonWriter writer(reply);
+  WriteId(writer, id);
+  reply->push_back(',');
+  RpcReply result(reply, reply->size());
+  method->handler(root.Find("params"), result);
+  if (!result.started_) {
+    result.Result().Null();
+  }
+  reply->push_back('}');
+  if (result.has_error()) {
+    ++stats_.errors;
+  }
+  if (notification) {
+    reply->clear();
+    return false;
+  }
+  return true;
+}
+
+bool RpcRouter::Dispatch(std::u16string_view request, std::u16string* reply) {
+  std::string_view utf8 = utf8_.Convert(request, InvalidUtf16Policy::kReplace);
+  if (!Dispatch(utf8, &reply_)) {
+    return false;
+  }
+  reply->clear();
+  AppendAsciiAsUtf16(reply_, reply);
+  return true;
+}
@@ -0,0 +1,261 @@
+#ifndef RUNNER_RPC_ROUTER_H_
+#define RUNNER_RPC_ROUTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "json.h"
+#include "utf_transcoder.h"
+
+// Routes calls from web pages to native methods.
+//
+// A page calls a method by posting a JSON object (not a string) with
+// window.chrome.webview.postMessage:
+//
+//   {"id": 7, "method": "echo", "params": ["hello"]}
+//
+// and receives the reply, posted back as JSON, with the same id:
+//
+//   {"id": 7, "result": "hello"}
+//   {"id": 7, "error": {"code": -32601, "message": "Method not found"}}
+//
+// The shape and error codes follow JSON-RPC 2.0. Requests without an id
+// are notifications and get no reply. The page side is runnerRpc.call()
+// (see webview_environment.cpp), which returns a promise per call.
+//
+// Method names are looked up in a perfect hash table, rebuilt on the first
+// dispatch after methods are registered, so dispatch costs one hash of the
+// name and one string comparison. The table is built by hash and displace:
+// names are grouped into buckets by their hash, and each bucket gets a
+// displacement that moves all of its names to free slots. Parsing reuses
+// the router's document and conversion buffers, so steady-state dispatch
+// allocates only what handlers do.
+
+// JSON-RPC error codes.
+constexpr int kRpcParseError = -32700;
+constexpr int kRpcInvalidRequest = -32600;
+constexpr int kRpcMethodNotFound = -32601;
+constexpr int kRpcInvalidParams = -32602;
+// Errors reported by handlers; see |RpcReply::Error|.
+constexpr int kRpcHandlerError = -32000;
+
+struct RpcRouterStats {
+  uint64_t requests = 0;
+  uint64_t notifications = 0;
+  // Messages that failed to parse or were not requests.
+  uint64_t invalid = 0;
+  uint64_t unknown_methods = 0;
+  // Replies carrying an error, including unknown methods and bad params.
+  uint64_t errors = 0;
+};
+
+// Where a handler writes its reply.
+class RpcReply {
+ public:
+  // Returns a writer for the result, which must be written as exactly one
+  // JSON value. Without a result or error the reply's result is null.
+  JsonWriter& Result();
+
+  // Replies with an error instead, discarding any result written so far.
+  // Nothing may be written to the result afterwards.
+  void Error(int code, std::string_view message);
+
+  bool has_error() const { return has_error_; }
+
+ private:
+  friend class RpcRouter;
+
+  RpcReply(std::string* output, size_t start)
+      : output_(output), start_(start), writer_(output) {}
+
+  std::string* output_;
+  // Where the result or error starts in |output_|.
+  size_t start_;
+  JsonWriter writer_;
+  bool started_ = false;
+  bool has_error_ = false;
+};
+
+namespace rpc_internal {
+
+template <typename T>
+struct FunctionTraits : FunctionTraits<decltype(&T::operator())> {};
+
+template <typename Class, typename Result, typename... Args>
+struct FunctionTraits<Result (Class::*)(Args...) const> {
+  using ResultType = Result;
+  using ArgumentTypes = std::tuple<std::decay_t<Args>...>;
+};
+
+template <typename Class, typename Result, typename... Args>
+struct FunctionTraits<Result (Class::*)(Args...)>
+    : FunctionTraits<Result (Class::*)(Args...) const> {};
+
+template <typename Result, typename... Args>
+struct FunctionTraits<Result (*)(Args...)> {
+  using ResultType = Result;
+  using ArgumentTypes = std::tuple<std::decay_t<Args>...>;
+};
+
+// Convert parameters to handler arguments. Return false on a type
+// mismatch. String views point into the request and are valid for the
+// duration of the call.
+bool FromJson(JsonValue value, bool* out);
+bool FromJson(JsonValue value, int32_t* out);
+bool FromJson(JsonValue value, int64_t* out);
+bool FromJson(JsonValue value, uint32_t* out);
+bool FromJson(JsonValue value, double* out);
+bool FromJson(JsonValue value, std::string_view* out);
+bool FromJson(JsonValue value, std::string* out);
+bool FromJson(JsonValue value, JsonValue* out);
+
+// Write handler results.
+inline void ToJson(JsonWriter& writer, bool value) {
+  writer.Bool(value);
+}
+inline void ToJson(JsonWriter& writer, int32_t value) {
+  writer.Int(value);
+}
+inline void ToJson(JsonWriter& writer, int64_t value) {
+  writer.Int(value);
+}
+inline void ToJson(JsonWriter& writer, uint32_t value) {
+  writer.Int(value);
+}
+inline void ToJson(JsonWriter& writer, double value) {
+  writer.Double(value);
+}
+inline void ToJson(JsonWriter& writer, std::string_view value) {
+  writer.String(value);
+}
+inline void ToJson(JsonWriter& writer, const std::string& value) {
+  writer.String(value);
+}
+inline void ToJson(JsonWriter& writer, const char* value) {
+  writer.String(value);
+}
+
+template <typename Tuple, size_t... Indices>
+bool ArgumentsFromJson([[maybe_unused]] JsonValue params,
+                       [[maybe_unused]] Tuple* arguments,
+                       std::index_sequence<Indices...>) {
+  // The fold stops at the first failure, and is true when there are no
+  // parameters.
+  return (FromJson(params.At(Indices), &std::get<Indices>(*arguments)) &&
+          ...);
+}
+
+// Converts |params|, a positional array, to |Function|'s arguments, calls
+// it and writes its result to |reply|.
+template <typename Function>
+void InvokeTyped(Function& function, JsonValue params, RpcReply& reply) {
+  using Traits = FunctionTraits<Function>;
+  using Arguments = typename Traits::ArgumentTypes;
+  constexpr size_t kArity = std::tuple_size_v<Arguments>;
+  Arguments arguments;
+  bool valid = params.exists()
+                   ? params.type() == JsonType::kArray &&
+                         params.size() == kArity &&
+                         ArgumentsFromJson(params, &arguments,
+                                           std::make_index_sequence<kArity>())
+                   : kArity == 0;
+  if (!valid) {
+    reply.Error(kRpcInvalidParams, "Invalid params");
+    return;
+  }
+  if constexpr (std::is_void_v<typename Traits::ResultType>) {
+    std::apply(function, std::move(arguments));
+  } else {
+    ToJson(reply.Result(), std::apply(function, std::move(arguments)));
+  }
+}
+
+}  // namespace rpc_internal
+
+class RpcRouter {
+ public:
+  // Receives the request's params, or a value of type kNone if it had
+  // none, and writes the reply.
+  using Handler = std::function<void(JsonValue params, RpcReply& reply)>;
+
+  RpcRouter();
+
+  RpcRouter(const RpcRouter&) = delete;
+  RpcRouter& operator=(const RpcRouter&) = delete;
+
+  // Routes |method| to |handler|, replacing any previous handler.
+  void RegisterRaw(std::string_view method, Handler handler);
+
+  // Routes |method| to |function|, whose parameters are converted from the
+  // request's positional params and whose return value becomes the result.
+  // Supported parameter types are bool, int32_t, int64_t, uint32_t, double,
+  // std::string_view, std::string and JsonValue; results may also be void
+  // or const char*. Calls with the wrong number or types of params get an
+  // kRpcInvalidParams error.
+  //
+  //   router.Register("add", [](double a, double b) { return a + b; });
+  template <typename Function>
+  void Register(std::string_view method, Function function) {
+    RegisterRaw(method, [function = std::move(function)](
+                            JsonValue params, RpcReply& reply) mutable {
+      rpc_internal::InvokeTyped(function, params, reply);
+    });
+  }
+
+  // Handles |request|, UTF-8 JSON. Returns true if a reply is due, with
+  // the reply, pure ASCII JSON, in |reply|.
+  bool Dispatch(std::string_view request, std::string* reply);
+
+  // Handles |request| as delivered by WebView2's WebMessageAsJson, and
+  // returns the reply as UTF-16 for PostWebMessageAsJson.
+  bool Dispatch(std::u16string_view request, std::u16string* reply);
+
+  size_t method_count() const { return methods_.size(); }
+  const RpcRouterStats& stats() const { return stats_; }
+
+ private:
+  struct Method {
+    std::string name;
+    Handler handler;
+  };
+
+  // Finds displacements under which every method has its own slot.
+  void BuildTable();
+
+  // Tries to build the table with |slot_count| slots. Returns false if
+  // some bucket could not be placed.
+  bool TryBuildTable(size_t slot_count);
+
+  // Returns the method called |name|, or null.
+  Method* Lookup(std::string_view name);
+
+  // Writes an error reply for |id|.
+  void WriteError(JsonValue id,
+                  int code,
+                  std::string_view message,
+                  std::string* reply);
+
+  std::vector<Method> methods_;
+  // Index into |methods_| plus one per slot, or 0 for an empty slot.
+  std::vector<uint32_t> table_;
+  // Per bucket, the displacement applied to its names' hashes.
+  std::vector<uint32_t> displacements_;
+  // Seeds the name hash; changed only if two names' hashes collide.
+  uint64_t seed_ = 0;
+  // Whether methods were registered since the table was built.
+  bool table_stale_ = false;
+
+  JsonDocument document_;
+  Utf8Buffer utf8_;
+  std::string reply_;
+  RpcRouterStats stats_;
+};
+
+#endif  // RUNNER_RPC_ROUTER_H_
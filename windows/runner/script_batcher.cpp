@@ -0,0 +1,367 @@
+#include "script_batcher.h"
+
+#include <utility>
+
+namespace {
+
+// A call's outcome within a batch result.
+struct CallResult {
+  bool threw;
+  std::u16string_view value;
+};
+
+bool IsJsonSpace(char16_t c) {
+  return c == u' ' || c == u'\t' || c == u'\n' || c == u'\r';
+}
+
+void SkipSpace(std::u16string_view json, size_t* pos) {
+  while (*pos < json.size() && IsJsonSpace(json[*pos])) {
+    ++*pos;
+  }
+}
+
+// Consumes |c| at |*pos|, after any whitespace.
+bool Expect(std::u16string_view json, size_t* pos, char16_t c) {
+  SkipSpace(json, pos);
+  if (*pos >= json.size() || json[*pos] != c) {
+    return false;
+  }
+  ++*pos;
+  return true;
+}
+
+// Advances |*pos| past the string starting at it.
+bool SkipString(std::u16string_view json, size_t* pos) {
+  ++*pos;
+  while (*pos < json.size()) {
+    char16_t c = json[(*pos)++];
+    if (c == u'\\') {
+      ++*pos;
+    } else if (c == u'"') {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Advances |*pos| past the JSON value starting at it. Only structure is
+// checked; the engine produced the JSON, so scalars are taken as they are.
+bool SkipValue(std::u16string_view json, size_t* pos) {
+  if (*pos >= json.size()) {
+    return false;
+  }
+  char16_t first = json[*pos];
+  if (first == u'"') {
+    return SkipString(json, pos);
+  }
+  if (first == u'[' || first == u'{') {
+    size_t depth = 0;
+    while (*pos < json.size()) {
+      char16_t c = json[*pos];
+      if (c == u'"') {
+        if (!SkipString(json, pos)) {
+          return false;
+        }
+        continue;
+      }
+      ++*pos;
+      if (c == u'[' || c == u'{') {
+        ++depth;
+      } else if ((c == u']' || c == u'}') && --depth == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+  size_t start = *pos;
+  while (*pos < json.size()) {
+    char16_t c = json[*pos];
+    if (c == u',' || c == u']' || c == u'}' || IsJsonSpace(c)) {
+      break;
+    }
+    ++*pos;
+  }
+  return *pos > start;
+}
+
+// Splits a batch result, an array of [status, value] pairs, into up to
+// |count| results that point into |json|. Stops at the first pair that
+// cannot be read, so |results| is short if the result is malformed.
+void SplitBatchResult(std::u16string_view json,
+                      size_t count,
+                      std::vector<CallResult>* results) {
+  size_t pos = 0;
+  if (!Expect(json, &pos, u'[')) {
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if ((i > 0 && !Expect(json, &pos, u',')) || !Expect(json, &pos, u'[')) {
+      return;
+    }
+    SkipSpace(json, &pos);
+    if (pos >= json.size() || (json[pos] != u'0' && json[pos] != u'1')) {
+      return;
+    }
+    bool threw = json[pos++] == u'1';
+    if (!Expect(json, &pos, u',')) {
+      return;
+    }
+    SkipSpace(json, &pos);
+    size_t start = pos;
+    if (!SkipValue(json, &pos)) {
+      return;
+    }
+    std::u16string_view value = json.substr(start, pos - start);
+    if (!Expect(json, &pos, u']')) {
+      return;
+    }
+    results->push_back(CallResult{threw, value});
+  }
+}
+
+// Drops trailing whitespace and semicolons, which are harmless in a
+// statement but not inside the parentheses the call is wrapped in.
+std::u16string_view TrimExpression(std::u16string_view expression) {
+  while (!expression.empty() && (expression.back() == u';' ||
+                                 IsJsonSpace(expression.back()))) {
+    expression.remove_suffix(1);
+  }
+  return expression;
+}
+
+}  // namespace
+
+ScriptBatcher::ScriptBatcher(ScriptEngine* engine, Options options)
+    : engine_(engine),
+      options_(options),
+      self_(std::make_shared<ScriptBatcher*>(this)) {}
+
+ScriptBatcher::~ScriptBatcher() {
+  // Results arriving from now on are dropped.
+  self_.reset();
+  std::vector<ResultCallback> callbacks;
+  for (Call& call : queued_) {
+    callbacks.push_back(std::move(call.callback));
+  }
+  for (Batch& batch : in_flight_) {
+    for (Call& call : batch.calls) {
+      if (call.callback) {
+        callbacks.push_back(std::move(call.callback));
+      }
+    }
+  }
+  queued_.clear();
+  in_flight_.clear();
+  for (ResultCallback& callback : callbacks) {
+    Complete(std::move(callback), ScriptStatus::kCancelled, {});
+  }
+}
+
+ScriptBatcher::CallId ScriptBatcher::Execute(std::u16string_view expression,
+                                             ResultCallback callback) {
+  ++stats_.calls;
+  CallId id = next_call_id_++;
+  queued_.push_back(Call{id, std::u16string(TrimExpression(expression)),
+                         std::move(callback), Clock::time_point()});
+  return id;
+}
+
+bool ScriptBatcher::Cancel(CallId id) {
+  for (auto it = queued_.begin(); it != queued_.end(); ++it) {
+    if (it->id == id) {
+      ResultCallback callback = std::move(it->callback);
+      queued_.erase(it);
+      Complete(std::move(callback), ScriptStatus::kCancelled, {});
+      return true;
+    }
+  }
+  for (Batch& batch : in_flight_) {
+    for (Call& call : batch.calls) {
+      if (call.id == id && call.callback) {
+        ResultCallback callback = std::move(call.callback);
+        call.callback = nullptr;
+        Complete(std::move(callback), ScriptStatus::kCancelled, {});
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+size_t ScriptBatcher::Flush(Clock::time_point now) {
+  if (queued_.empty()) {
+    return 0;
+  }
+  size_t count = queued_.size();
+  if (options_.max_batch_calls != 0 && count > options_.max_batch_calls) {
+    count = options_.max_batch_calls;
+  }
+  std::vector<Call> calls;
+  calls.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    calls.push_back(std::move(queued_.front()));
+    queued_.pop_front();
+    calls.back().deadline = now + options_.timeout;
+  }
+  Send(std::move(calls));
+  return count;
+}
+
+void ScriptBatcher::ExpireTimedOut(Clock::time_point now) {
+  if (options_.timeout.count() == 0) {
+    return;
+  }
+  std::vector<ResultCallback> expired;
+  for (Batch& batch : in_flight_) {
+    for (Call& call : batch.calls) {
+      if (call.callback && now >= call.deadline) {
+        expired.push_back(std::move(call.callback));
+        call.callback = nullptr;
+      }
+    }
+  }
+  for (ResultCallback& callback : expired) {
+    Complete(std::move(callback), ScriptStatus::kTimedOut, {});
+  }
+}
+
+std::optional<ScriptBatcher::Clock::time_point> ScriptBatcher::NextTimeout()
+    const {
+  if (options_.timeout.count() == 0) {
+    return std::nullopt;
+  }
+  std::optional<Clock::time_point> next;
+  for (const Batch& batch : in_flight_) {
+    for (const Call& call : batch.calls) {
+      if (call.callback && (!next || call.deadline < *next)) {
+        next = call.deadline;
+      }
+    }
+  }
+  return next;
+}
+
+size_t ScriptBatcher::in_flight_calls() const {
+  size_t count = 0;
+  for (const Batch& batch : in_flight_) {
+    for (const Call& call : batch.calls) {
+      if (call.callback) {
+        ++count;
+      }
+    }
+  }
+  return count;
+}
+
+void ScriptBatcher::Send(std::vector<Call> calls) {
+  ++stats_.batches;
+  if (calls.size() > stats_.max_batch_calls) {
+    stats_.max_batch_calls = calls.size();
+  }
+
+  // Built in a local so a retry sent from a synchronous callback cannot
+  // overwrite it mid-call.
+  std::u16string script = std::move(script_);
+  script.assign(u"(() => { const r = [];");
+  for (const Call& call : calls) {
+    // The line breaks keep a trailing // comment from swallowing the rest.
+    script.append(u"\ntry { r.push([0, (\n");
+    script.append(call.expression);
+    script.append(u"\n)]); } catch (e) { r.push([1, String(e)]); }");
+  }
+  script.append(u"\nreturn r; })();");
+
+  uint64_t batch_id = next_batch_id_++;
+  in_flight_.push_back(Batch{batch_id, std::move(calls)});
+  std::weak_ptr<ScriptBatcher*> self = self_;
+  engine_->Execute(script, [self, batch_id](bool succeeded,
+                                            std::u16string_view result_json) {
+    if (std::shared_ptr<ScriptBatcher*> batcher = self.lock()) {
+      (*batcher)->OnBatchComplete(batch_id, succeeded, result_json);
+    }
+  });
+  script_ = std::move(script);
+}
+
+void ScriptBatcher::OnBatchComplete(uint64_t batch_id,
+                                    bool succeeded,
+                                    std::u16string_view result_json) {
+  Batch batch;
+  bool found = false;
+  for (auto it = in_flight_.begin(); it != in_flight_.end(); ++it) {
+    if (it->id == batch_id) {
+      batch = std::move(*it);
+      in_flight_.erase(it);
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    return;
+  }
+
+  if (succeeded) {
+    // The calls ran, so running them again would repeat their side effects.
+    // Those whose results cannot be read fail.
+    std::vector<CallResult> results;
+    results.reserve(batch.calls.size());
+    SplitBatchResult(result_json, batch.calls.size(), &results);
+    for (size_t i = 0; i < batch.calls.size(); ++i) {
+      if (!batch.calls[i].callback) {
+        continue;
+      }
+      if (i >= results.size()) {
+        Complete(std::move(batch.calls[i].callback), ScriptStatus::kFailed,
+                 {});
+      } else {
+        Complete(std::move(batch.calls[i].callback),
+                 results[i].threw ? ScriptStatus::kThrew
+                                  : ScriptStatus::kSucceeded,
+                 results[i].value);
+      }
+    }
+    return;
+  }
+
+  if (batch.calls.size() > 1) {
+    ++stats_.retried_batches;
+    for (Call& call : batch.calls) {
+      if (call.callback) {
+        std::vector<Call> single;
+        single.push_back(std::move(call));
+        Send(std::move(single));
+      }
+    }
+    return;
+  }
+  for (Call& call : batch.calls) {
+    if (call.callback) {
+      Complete(std::move(call.callback), ScriptStatus::kFailed, {});
+    }
+  }
+}
+
+void ScriptBatcher::Complete(ResultCallback callback,
+                             ScriptStatus status,
+                             std::u16string_view result_json) {
+  switch (status) {
+    case ScriptStatus::kSucceeded:
+      ++stats_.succeeded;
+      break;
+    case ScriptStatus::kThrew:
+      ++stats_.threw;
+      break;
+    case ScriptStatus::kFailed:
+      ++stats_.failed;
+      break;
+    case ScriptStatus::kCancelled:
+      ++stats_.cancelled;
+      break;
+    case ScriptStatus::kTimedOut:
+      ++stats_.timed_out;
+      break;
+  }
+  if (callback) {
+    callback(status, result_json);
+  }
+}
@@ -0,0 +1,172 @@
+#ifndef RUNNER_SCRIPT_BATCHER_H_
+#define RUNNER_SCRIPT_BATCHER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs many host-to-page script calls through few script invocations.
+//
+// Calls queued between two |Flush|es, typically one frame, are packed into a
+// single script that evaluates each call in its own try/catch and returns an
+// array of [status, value] pairs:
+//
+//   (() => { const r = [];
+//     try { r.push([0, (<call 1>)]); } catch (e) { r.push([1, String(e)]); }
+//     ...
+//     return r; })()
+//
+// The engine returns the array as JSON, which is split back into one result
+// per call without copying. A call therefore has to be a JavaScript
+// expression, not a statement list. If the combined script fails as a whole,
+// e.g. because one call does not parse, each call of that batch is retried
+// on its own so that only the broken call fails. A batch that ran but whose
+// result cannot be read is not retried, since its calls already had their
+// side effects: calls whose results cannot be read fail instead. This is the
+// case when a call returns a value the engine cannot encode as JSON, such as
+// a cyclic object, which ExecuteScript turns the whole result into null for.
+
+// Evaluates scripts, e.g. through ICoreWebView2::ExecuteScript.
+class ScriptEngine {
+ public:
+  // Receives whether the script ran and its result as JSON. |result_json|
+  // is only valid for the duration of the call.
+  using Callback =
+      std::function<void(bool succeeded, std::u16string_view result_json)>;
+
+  virtual ~ScriptEngine() = default;
+
+  // Starts evaluating |script|, which is always followed by a null
+  // terminator and only valid for the duration of the call. |callback| must
+  // be invoked exactly once, possibly before this method returns.
+  virtual void Execute(std::u16string_view script, Callback callback) = 0;
+};
+
+enum class ScriptStatus : uint8_t {
+  // The expression evaluated; the result is its value as JSON.
+  kSucceeded,
+  // The expression threw; the result is the exception as a JSON string.
+  kThrew,
+  // The script could not be run or its result could not be read.
+  kFailed,
+  // Cancelled with |ScriptBatcher::Cancel| or by destroying the batcher.
+  kCancelled,
+  // No result arrived within |ScriptBatcher::Options::timeout|.
+  kTimedOut,
+};
+
+struct ScriptBatcherStats {
+  // Calls queued, and batches handed to the engine for them.
+  uint64_t calls = 0;
+  uint64_t batches = 0;
+  // Batches that failed as a whole and were retried call by call.
+  uint64_t retried_batches = 0;
+  uint64_t succeeded = 0;
+  uint64_t threw = 0;
+  uint64_t failed = 0;
+  uint64_t cancelled = 0;
+  uint64_t timed_out = 0;
+  // Largest number of calls in one batch.
+  size_t max_batch_calls = 0;
+};
+
+class ScriptBatcher {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using CallId = uint64_t;
+  // Receives the outcome of a call. |result_json| is only valid for the
+  // duration of the call, and empty unless the status is kSucceeded or
+  // kThrew.
+  using ResultCallback =
+      std::function<void(ScriptStatus status, std::u16string_view result_json)>;
+
+  struct Options {
+    // How long a call may wait for its result after being flushed. Zero
+    // waits indefinitely.
+    std::chrono::milliseconds timeout{5000};
+    // Maximum number of calls packed into one script; the rest stay queued
+    // for the next flush.
+    size_t max_batch_calls = 256;
+  };
+
+  ScriptBatcher(ScriptEngine* engine, Options options);
+
+  // Completes every outstanding call with kCancelled.
+  ~ScriptBatcher();
+
+  ScriptBatcher(const ScriptBatcher&) = delete;
+  ScriptBatcher& operator=(const ScriptBatcher&) = delete;
+
+  // Queues |expression| until the next |Flush|. |callback| is invoked
+  // exactly once.
+  CallId Execute(std::u16string_view expression, ResultCallback callback);
+
+  // Completes call |id| with kCancelled, unless it already completed. A
+  // flushed call still runs, but its result is dropped. Returns true if the
+  // call was cancelled.
+  bool Cancel(CallId id);
+
+  // Sends up to |max_batch_calls| queued calls as one script. Returns the
+  // number of calls sent.
+  size_t Flush(Clock::time_point now);
+
+  // Completes flushed calls whose timeout passed by |now| with kTimedOut.
+  void ExpireTimedOut(Clock::time_point now);
+
+  // Returns when the earliest flushed call times out, if any can.
+  std::optional<Clock::time_point> NextTimeout() const;
+
+  bool has_queued() const { return !queued_.empty(); }
+  size_t in_flight_calls() const;
+  const ScriptBatcherStats& stats() const { return stats_; }
+
+ private:
+  struct Call {
+    CallId id;
+    std::u16string expression;
+    ResultCallback callback;
+    // Set once flushed.
+    Clock::time_point deadline;
+  };
+
+  struct Batch {
+    uint64_t id;
+    std::vector<Call> calls;
+  };
+
+  // Sends |calls| as one script and tracks them until it completes.
+  void Send(std::vector<Call> calls);
+
+  // Handles the engine's answer for batch |batch_id|.
+  void OnBatchComplete(uint64_t batch_id,
+                       bool succeeded,
+                       std::u16string_view result_json);
+
+  // Invokes |callback| with |status| and counts it.
+  void Complete(ResultCallback callback,
+                ScriptStatus status,
+                std::u16string_view result_json);
+
+  ScriptEngine* engine_;
+  Options options_;
+  std::deque<Call> queued_;
+  // Batches awaiting their result. Calls that were cancelled or timed out
+  // stay with an empty callback until the result arrives.
+  std::vector<Batch> in_flight_;
+  CallId next_call_id_ = 1;
+  uint64_t next_batch_id_ = 1;
+  // The script being built; keeps its capacity between batches.
+  std::u16string script_;
+  // Lets engine callbacks detect that the batcher has been destroyed.
+  std::shared_ptr<ScriptBatcher*> self_;
+  ScriptBatcherStats stats_;
+};
+
+#endif  // RUNNER_SCRIPT_BATCHER_H_
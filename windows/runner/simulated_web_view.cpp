@@ -0,0 +1,455 @@
+#include "simulated_web_view.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// The statement |ScriptBatcher| emits for each call of a batch.
+constexpr std::u16string_view kBatchCallMarker = u"r.push([0, (";
+
+// Advances |*state| and returns the next value of a SplitMix64 sequence,
+// which is the same on every platform, unlike the standard distributions.
+uint64_t NextRandom(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+}  // namespace
+
+void VirtualClock::PostAt(Clock::time_point when, Task task) {
+  tasks_.emplace(std::make_pair(when, next_sequence_++), std::move(task));
+}
+
+void VirtualClock::PostDelayed(Clock::duration delay, Task task) {
+  PostAt(now_ + delay, std::move(task));
+}
+
+size_t VirtualClock::RunUntil(Clock::time_point until) {
+  size_t count = 0;
+  while (!tasks_.empty() && tasks_.begin()->first.first <= until) {
+    RunNext();
+    ++count;
+  }
+  if (until > now_) {
+    now_ = until;
+  }
+  return count;
+}
+
+size_t VirtualClock::AdvanceBy(Clock::duration delta) {
+  return RunUntil(now_ + delta);
+}
+
+size_t VirtualClock::RunUntilIdle() {
+  size_t count = 0;
+  while (!tasks_.empty()) {
+    RunNext();
+    ++count;
+  }
+  return count;
+}
+
+void VirtualClock::RunNext() {
+  auto it = tasks_.begin();
+  if (it->first.first > now_) {
+    now_ = it->first.first;
+  }
+  Task task = std::move(it->second);
+  tasks_.erase(it);
+  task();
+}
+
+SimulatedWebViewController::SimulatedWebViewController(
+    SimulatedWebViewBackend* backend)
+    : backend_(backend),
+      self_(std::make_shared<SimulatedWebViewController*>(this)) {
+  backend_->controllers_.push_back(this);
+}
+
+SimulatedWebViewController::~SimulatedWebViewController() {
+  std::vector<SimulatedWebViewController*>& controllers =
+      backend_->controllers_;
+  controllers.erase(std::find(controllers.begin(), controllers.end(), this));
+  ++backend_->stats_.controllers_destroyed;
+}
+
+void SimulatedWebViewController::SetEvents(WebViewEvents events) {
+  events_ = std::move(events);
+}
+
+void SimulatedWebViewController::Attach(NativeWindow parent,
+                                        const IntRect& bounds) {
+  parent_ = parent;
+  bounds_ = bounds;
+  visible_ = true;
+}
+
+void SimulatedWebViewController::SetBounds(const IntRect& bounds) {
+  bounds_ = bounds;
+}
+
+void SimulatedWebViewController::Detach() {
+  visible_ = false;
+  focused_ = false;
+  parent_ = 0;
+  Navigate(u"about:blank");
+}
+
+void SimulatedWebViewController::SetVisible(bool visible) {
+  visible_ = visible;
+}
+
+void SimulatedWebViewController::Navigate(std::u16string_view uri) {
+  // Like WebView2, navigating wakes a suspended page and replaces any
+  // navigation still in progress.
+  suspended_ = false;
+  uint64_t id = ++navigation_id_;
+  ++backend_->stats_.navigations;
+  PostDelayed(backend_->options_.navigation_latency,
+              [id, uri = std::u16string(uri)](
+                  SimulatedWebViewController* controller) {
+                controller->FinishNavigation(id, uri);
+              });
+}
+
+void SimulatedWebViewController::ExecuteScript(std::u16string_view script,
+                                               ScriptCallback callback) {
+  ++backend_->stats_.scripts;
+  suspended_ = false;
+  if (failed_ || backend_->Fails(backend_->options_.script_failure_rate)) {
+    ++backend_->stats_.script_failures;
+    PostDelayed(backend_->options_.script_latency,
+                [callback](SimulatedWebViewController* controller) {
+                  callback(false, std::u16string_view());
+                });
+    return;
+  }
+  PostDelayed(backend_->options_.script_latency,
+              [callback, result = backend_->EvaluateScript(script)](
+                  SimulatedWebViewController* controller) {
+                callback(true, result);
+              });
+}
+
+void SimulatedWebViewController::PostWebMessage(std::u16string_view message) {
+  ++backend_->stats_.messages_posted;
+  if (backend_->options_.page_echoes_messages) {
+    PostDelayed(backend_->options_.script_latency,
+                [message = std::u16string(message)](
+                    SimulatedWebViewController* controller) {
+                  controller->SimulatePageMessage(message);
+                });
+  }
+}
+
+void SimulatedWebViewController::PostWebMessageAsJson(
+    std::u16string_view json) {
+  ++backend_->stats_.messages_posted;
+  if (backend_->options_.page_echoes_messages) {
+    PostDelayed(backend_->options_.script_latency,
+                [json = std::u16string(json)](
+                    SimulatedWebViewController* controller) {
+                  controller->SimulatePageJsonMessage(json);
+                });
+  }
+}
+
+void SimulatedWebViewController::MoveFocus(WebViewFocusReason reason) {
+  if (focused_) {
+    return;
+  }
+  focused_ = true;
+  PostDelayed(std::chrono::microseconds(0),
+              [](SimulatedWebViewController* controller) {
+                if (auto handler = controller->events_.got_focus) {
+                  handler();
+                }
+              });
+}
+
+void SimulatedWebViewController::TrySuspend(SuspendCallback callback) {
+  visible_ = false;
+  bool fails = backend_->Fails(backend_->options_.suspend_failure_rate);
+  PostDelayed(backend_->options_.suspend_latency,
+              [callback, fails](SimulatedWebViewController* controller) {
+                // Showing the page again in the meantime also fails it.
+                if (fails || controller->visible_) {
+                  ++controller->backend_->stats_.suspend_failures;
+                  callback(false);
+                  return;
+                }
+                ++controller->backend_->stats_.suspended;
+                controller->suspended_ = true;
+                callback(true);
+              });
+}
+
+void SimulatedWebViewController::Resume() {
+  suspended_ = false;
+  visible_ = true;
+}
+
+void SimulatedWebViewController::CaptureFrame(FrameCallback callback) {
+  PostDelayed(backend_->options_.capture_latency,
+              [callback](SimulatedWebViewController* controller) {
+                if (controller->bounds_.IsEmpty()) {
+                  callback(nullptr);
+                  return;
+                }
+                controller->RenderFrame();
+                ++controller->backend_->stats_.frames_captured;
+                PixelFrame frame{
+                    controller->frame_.data(),
+                    static_cast<size_t>(controller->frame_width_) * 4,
+                    controller->frame_width_, controller->frame_height_};
+                callback(&frame);
+              });
+}
+
+void SimulatedWebViewController::SimulateFocusLost() {
+  if (!focused_) {
+    return;
+  }
+  focused_ = false;
+  if (auto handler = events_.lost_focus) {
+    handler();
+  }
+}
+
+void SimulatedWebViewController::SimulateTabOut(WebViewFocusReason reason) {
+  if (auto handler = events_.move_focus_requested) {
+    handler(reason);
+  }
+  SimulateFocusLost();
+}
+
+void SimulatedWebViewController::SimulatePageMessage(
+    std::u16string_view message) {
+  ++backend_->stats_.messages_received;
+  if (auto handler = events_.web_message_received) {
+    handler(message);
+  }
+}
+
+void SimulatedWebViewController::SimulatePageJsonMessage(
+    std::u16string_view json) {
+  ++backend_->stats_.messages_received;
+  if (auto handler = events_.web_message_json_received) {
+    handler(json);
+  }
+}
+
+void SimulatedWebViewController::SimulateProcessFailure(
+    WebViewProcessFailure failure) {
+  ++backend_->stats_.process_failures;
+  if (failure == WebViewProcessFailure::kBrowserExited ||
+      failure == WebViewProcessFailure::kRendererExited ||
+      failure == WebViewProcessFailure::kRendererUnresponsive) {
+    failed_ = true;
+  }
+  if (auto handler = events_.process_failed) {
+    handler(failure);
+  }
+}
+
+void SimulatedWebViewController::PostDelayed(
+    std::chrono::microseconds delay,
+    std::function<void(SimulatedWebViewController*)> task) {
+  std::weak_ptr<SimulatedWebViewController*> self = self_;
+  backend_->clock_->PostDelayed(delay, [self, task = std::move(task)] {
+    if (std::shared_ptr<SimulatedWebViewController*> controller =
+            self.lock()) {
+      task(*controller);
+    }
+  });
+}
+
+void SimulatedWebViewController::FinishNavigation(uint64_t id,
+                                                  const std::u16string& uri) {
+  if (id != navigation_id_ || failed_) {
+    return;
+  }
+  if (auto handler = events_.navigation_starting) {
+    if (!handler(uri)) {
+      ++backend_->stats_.cancelled_navigations;
+      if (auto completed = events_.navigation_completed) {
+        completed(false);
+      }
+      return;
+    }
+  }
+  source_ = uri;
+  backend_->stats_.document_scripts_run += document_scripts_.size();
+  // The page's initialization script posts the document URL to the host.
+  SimulatePageMessage(source_);
+  // The handler may have replaced the events.
+  if (auto completed = events_.navigation_completed) {
+    completed(true);
+  }
+}
+
+void SimulatedWebViewController::RenderFrame() {
+  size_t row_bytes = static_cast<size_t>(bounds_.width()) * 4;
+  if (bounds_.width() != frame_width_ || bounds_.height() != frame_height_) {
+    frame_width_ = bounds_.width();
+    frame_height_ = bounds_.height();
+    // An opaque white page.
+    frame_.assign(row_bytes * frame_height_, 0xFF);
+  }
+  int32_t band = std::max(
+      1, static_cast<int32_t>(frame_height_ *
+                              backend_->options_.frame_change_ratio));
+  int32_t top = static_cast<int32_t>(frame_count_ * band % frame_height_);
+  int32_t bottom = std::min(top + band, frame_height_);
+  uint8_t shade = static_cast<uint8_t>(frame_count_++);
+  for (int32_t y = top; y < bottom; ++y) {
+    uint8_t* row = frame_.data() + row_bytes * y;
+    std::memset(row, shade, row_bytes);
+    for (size_t x = 3; x < row_bytes; x += 4) {
+      row[x] = 0xFF;
+    }
+  }
+}
+
+SimulatedWebViewBackend::SimulatedWebViewBackend(
+    VirtualClock* clock,
+    SimulatedWebViewOptions options)
+    : clock_(clock),
+      options_(std::move(options)),
+      random_state_(options_.seed),
+      self_(std::make_shared<SimulatedWebViewBackend*>(this)) {}
+
+SimulatedWebViewBackend::~SimulatedWebViewBackend() {
+  self_.reset();
+  std::vector<CreateCallback> requests = std::move(queued_requests_);
+  for (CreateCallback& callback : requests) {
+    callback(WebViewSurface());
+  }
+}
+
+void SimulatedWebViewBackend::CreateController(CreateCallback callback) {
+  switch (environment_) {
+    case EnvironmentState::kReady:
+      CreateControllerFromEnvironment(std::move(callback));
+      return;
+    case EnvironmentState::kFailed:
+      ++stats_.controller_failures;
+      callback(WebViewSurface());
+      return;
+    case EnvironmentState::kCreating:
+      queued_requests_.push_back(std::move(callback));
+      return;
+    case EnvironmentState::kNone:
+      break;
+  }
+  queued_requests_.push_back(std::move(callback));
+  environment_ = EnvironmentState::kCreating;
+  std::weak_ptr<SimulatedWebViewBackend*> self = self_;
+  clock_->PostDelayed(options_.environment_latency, [self] {
+    if (std::shared_ptr<SimulatedWebViewBackend*> backend = self.lock()) {
+      (*backend)->OnEnvironmentCreated();
+    }
+  });
+}
+
+void SimulatedWebViewBackend::DestroyController(WebViewSurface surface) {
+  surface.reset();
+}
+
+void SimulatedWebViewBackend::SimulateBrowserExit() {
+  ++browser_generation_;
+  if (environment_ == EnvironmentState::kReady) {
+    environment_ = EnvironmentState::kNone;
+  }
+  // Handlers may destroy controllers, so each is looked up again.
+  std::vector<std::weak_ptr<SimulatedWebViewController*>> controllers;
+  for (SimulatedWebViewController* controller : controllers_) {
+    controllers.push_back(controller->self_);
+  }
+  for (const auto& weak_controller : controllers) {
+    if (std::shared_ptr<SimulatedWebViewController*> controller =
+            weak_controller.lock()) {
+      (*controller)->SimulateProcessFailure(
+          WebViewProcessFailure::kBrowserExited);
+    }
+  }
+}
+
+void SimulatedWebViewBackend::RestartBrowser() {
+  if (environment_ != EnvironmentState::kCreating) {
+    environment_ = EnvironmentState::kNone;
+  }
+}
+
+void SimulatedWebViewBackend::OnEnvironmentCreated() {
+  bool fails = options_.fail_environment || environment_failures_ > 0;
+  if (fails) {
+    if (environment_failures_ > 0) {
+      --environment_failures_;
+    }
+    ++stats_.environment_failures;
+  }
+  environment_ = fails ? EnvironmentState::kFailed : EnvironmentState::kReady;
+  std::vector<CreateCallback> requests = std::move(queued_requests_);
+  queued_requests_.clear();
+  for (CreateCallback& callback : requests) {
+    CreateController(std::move(callback));
+  }
+}
+
+void SimulatedWebViewBackend::CreateControllerFromEnvironment(
+    CreateCallback callback) {
+  bool fails = Fails(options_.controller_failure_rate);
+  uint64_t generation = browser_generation_;
+  std::weak_ptr<SimulatedWebViewBackend*> self = self_;
+  clock_->PostDelayed(options_.controller_latency, [self, callback, fails,
+                                                    generation] {
+    std::shared_ptr<SimulatedWebViewBackend*> backend = self.lock();
+    if (!backend || fails ||
+        generation != (*backend)->browser_generation_) {
+      if (backend) {
+        ++(*backend)->stats_.controller_failures;
+      }
+      callback(WebViewSurface());
+      return;
+    }
+    ++(*backend)->stats_.controllers_created;
+    callback(std::make_unique<SimulatedWebViewController>(*backend));
+  });
+}
+
+bool SimulatedWebViewBackend::Fails(double rate) {
+  if (rate <= 0) {
+    return false;
+  }
+  // The top 53 bits, as a fraction in [0, 1).
+  double roll = static_cast<double>(NextRandom(&random_state_) >> 11) *
+                (1.0 / 9007199254740992.0);
+  return roll < rate;
+}
+
+std::u16string SimulatedWebViewBackend::EvaluateScript(
+    std::u16string_view script) const {
+  if (options_.evaluate_script) {
+    return options_.evaluate_script(script);
+  }
+  size_t calls = 0;
+  for (size_t pos = script.find(kBatchCallMarker);
+       pos != std::u16string_view::npos;
+       pos = script.find(kBatchCallMarker, pos + kBatchCallMarker.size())) {
+    ++calls;
+  }
+  if (calls == 0) {
+    return u"null";
+  }
+  std::u16string result = u"[";
+  for (size_t i = 0; i < calls; ++i) {
+    result.append(i == 0 ? u"[0,null]" : u",[0,null]");
+  }
+  result.push_back(u']');
+  return result;
+}
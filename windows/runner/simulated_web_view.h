@@ -0,0 +1,289 @@
+#ifndef RUNNER_SIMULATED_WEB_VIEW_H_
+#define RUNNER_SIMULATED_WEB_VIEW_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "geometry.h"
+#include "web_view_backend.h"
+
+// An in-process stand-in for WebView2, for exercising the runner's web view
+// logic deterministically on any platform.
+//
+// Every callback WebView2 delivers asynchronously (environment and
+// controller creation, navigation, script results, suspension, page
+// messages) is instead posted to a |VirtualClock| after a configurable
+// latency, and can be made to fail at a configurable rate. Time only moves
+// when the clock is advanced, so a scenario that spans minutes of simulated
+// time runs in microseconds and always produces the same callbacks in the
+// same order for the same seed.
+
+// A manually advanced clock and the tasks scheduled on it.
+//
+// Its time points are steady_clock time points, so they can be passed to
+// components that take |Clock::time_point|s, such as |ControllerPool| and
+// |ViewLifecycleManager|.
+class VirtualClock {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Task = std::function<void()>;
+
+  VirtualClock() = default;
+
+  VirtualClock(const VirtualClock&) = delete;
+  VirtualClock& operator=(const VirtualClock&) = delete;
+
+  Clock::time_point now() const { return now_; }
+
+  // Runs |task| once the clock reaches |when|, or at the next advance if
+  // |when| has passed. Tasks due at the same time run in posting order.
+  void PostAt(Clock::time_point when, Task task);
+  void PostDelayed(Clock::duration delay, Task task);
+
+  // Runs every task due by |until|, including tasks they post, moving the
+  // clock to each task's time before running it, and then to |until|.
+  // Returns the number of tasks run.
+  size_t RunUntil(Clock::time_point until);
+  size_t AdvanceBy(Clock::duration delta);
+
+  // Runs tasks, advancing the clock as far as needed, until none remain.
+  size_t RunUntilIdle();
+
+  bool has_pending() const { return !tasks_.empty(); }
+
+ private:
+  // Runs the earliest task.
+  void RunNext();
+
+  Clock::time_point now_;
+  uint64_t next_sequence_ = 0;
+  // Ordered by due time, then posting order.
+  std::map<std::pair<Clock::time_point, uint64_t>, Task> tasks_;
+};
+
+struct SimulatedWebViewOptions {
+  // How long each asynchronous operation takes to call back.
+  std::chrono::microseconds environment_latency{200000};
+  std::chrono::microseconds controller_latency{80000};
+  std::chrono::microseconds navigation_latency{30000};
+  std::chrono::microseconds script_latency{2000};
+  std::chrono::microseconds suspend_latency{10000};
+  std::chrono::microseconds capture_latency{8000};
+
+  // Whether creating the environment fails, which fails every controller.
+  bool fail_environment = false;
+  // Probability, from 0 to 1, that an individual operation fails.
+  double controller_failure_rate = 0;
+  double script_failure_rate = 0;
+  double suspend_failure_rate = 0;
+  // Seeds the failure rolls.
+  uint64_t seed = 1;
+
+  // Produces the JSON result of a script. By default a |ScriptBatcher|
+  // batch returns null for each of its calls, and any other script null.
+  std::function<std::u16string(std::u16string_view script)> evaluate_script;
+
+  // Whether the page posts every message it receives straight back, like
+  // the echo channel does.
+  bool page_echoes_messages = false;
+
+  // Fraction of the page's rows that change between two captured frames.
+  double frame_change_ratio = 0.05;
+};
+
+struct SimulatedWebViewStats {
+  uint64_t controllers_created = 0;
+  uint64_t controller_failures = 0;
+  uint64_t controllers_destroyed = 0;
+  uint64_t navigations = 0;
+  uint64_t cancelled_navigations = 0;
+  uint64_t scripts = 0;
+  uint64_t script_failures = 0;
+  uint64_t messages_posted = 0;
+  uint64_t messages_received = 0;
+  // Scripts run by documents loading, as |SetDocumentScripts| requested.
+  uint64_t document_scripts_run = 0;
+  uint64_t suspended = 0;
+  uint64_t suspend_failures = 0;
+  uint64_t frames_captured = 0;
+  uint64_t process_failures = 0;
+  uint64_t environment_failures = 0;
+};
+
+class SimulatedWebViewBackend;
+
+// A simulated web view. Owned through a |WebViewSurface|; must not outlive
+// the backend that created it.
+class SimulatedWebViewController : public WebViewController {
+ public:
+  explicit SimulatedWebViewController(SimulatedWebViewBackend* backend);
+  ~SimulatedWebViewController() override;
+
+  SimulatedWebViewController(const SimulatedWebViewController&) = delete;
+  SimulatedWebViewController& operator=(const SimulatedWebViewController&) =
+      delete;
+
+  // WebViewController:
+  void SetEvents(WebViewEvents events) override;
+  void Attach(NativeWindow parent, const IntRect& bounds) override;
+  void SetBounds(const IntRect& bounds) override;
+  void Detach() override;
+  void SetVisible(bool visible) override;
+  void Navigate(std::u16string_view uri) override;
+  void ApplySettings(const WebViewSettings& settings) override {
+    settings_ = settings;
+  }
+  void SetDocumentScripts(std::vector<std::u16string> scripts) override {
+    document_scripts_ = std::move(scripts);
+  }
+  std::u16string Source() override { return source_; }
+  void ExecuteScript(std::u16string_view script,
+                     ScriptCallback callback) override;
+  void PostWebMessage(std::u16string_view message) override;
+  void PostWebMessageAsJson(std::u16string_view json) override;
+  void MoveFocus(WebViewFocusReason reason) override;
+  void TrySuspend(SuspendCallback callback) override;
+  void Resume() override;
+  void CaptureFrame(FrameCallback callback) override;
+
+  // Act as the user would: click outside the page, or tab out of it.
+  void SimulateFocusLost();
+  void SimulateTabOut(WebViewFocusReason reason);
+
+  // Posts |message| from the page to the host.
+  void SimulatePageMessage(std::u16string_view message);
+
+  // Posts the value encoded by |json| from the page to the host.
+  void SimulatePageJsonMessage(std::u16string_view json);
+
+  // Raises |failure| as WebView2's ProcessFailed would. Unless it is a
+  // failure WebView2 recovers from by itself, the controller stops working:
+  // navigations never complete and scripts fail.
+  void SimulateProcessFailure(WebViewProcessFailure failure);
+
+  NativeWindow parent() const { return parent_; }
+  const IntRect& bounds() const { return bounds_; }
+  bool visible() const { return visible_; }
+  bool suspended() const { return suspended_; }
+  bool focused() const { return focused_; }
+  bool failed() const { return failed_; }
+  const WebViewSettings& settings() const { return settings_; }
+  const std::vector<std::u16string>& document_scripts() const {
+    return document_scripts_;
+  }
+
+ private:
+  friend class SimulatedWebViewBackend;
+
+  // Runs |task| on the backend's clock after |delay|, unless this
+  // controller has been destroyed by then.
+  void PostDelayed(std::chrono::microseconds delay,
+                   std::function<void(SimulatedWebViewController*)> task);
+
+  // Completes navigation |id| to |uri|, unless a newer one replaced it.
+  void FinishNavigation(uint64_t id, const std::u16string& uri);
+
+  // Draws the next frame of the page into |frame_|: a band of rows moving
+  // down the page changes each time.
+  void RenderFrame();
+
+  SimulatedWebViewBackend* backend_;
+  WebViewEvents events_;
+  NativeWindow parent_ = 0;
+  IntRect bounds_;
+  bool visible_ = false;
+  bool suspended_ = false;
+  bool focused_ = false;
+  bool failed_ = false;
+  std::u16string source_;
+  WebViewSettings settings_;
+  std::vector<std::u16string> document_scripts_;
+  // Identifies the latest navigation, so that earlier ones are abandoned.
+  uint64_t navigation_id_ = 0;
+  // The page's pixels as BGRA, sized to |bounds_|.
+  std::vector<uint8_t> frame_;
+  int32_t frame_width_ = 0;
+  int32_t frame_height_ = 0;
+  uint64_t frame_count_ = 0;
+  // Lets posted tasks detect that the controller has been destroyed.
+  std::shared_ptr<SimulatedWebViewController*> self_;
+};
+
+// Creates |SimulatedWebViewController|s on |clock|, which must outlive the
+// backend.
+class SimulatedWebViewBackend : public WebViewBackend {
+ public:
+  SimulatedWebViewBackend(VirtualClock* clock, SimulatedWebViewOptions options);
+
+  // Fails requests that are still waiting for the environment.
+  ~SimulatedWebViewBackend() override;
+
+  SimulatedWebViewBackend(const SimulatedWebViewBackend&) = delete;
+  SimulatedWebViewBackend& operator=(const SimulatedWebViewBackend&) = delete;
+
+  // ControllerSource:
+  void CreateController(CreateCallback callback) override;
+  void DestroyController(WebViewSurface surface) override;
+
+  VirtualClock* clock() const { return clock_; }
+  const SimulatedWebViewOptions& options() const { return options_; }
+  const SimulatedWebViewStats& stats() const { return stats_; }
+  size_t live_controllers() const { return controllers_.size(); }
+
+  // Ends the browser process: every live controller reports
+  // kBrowserExited and stops working, controllers still being created fail,
+  // and the next request starts a new environment.
+  void SimulateBrowserExit();
+
+  // Like |WebViewEnvironment::RestartBrowser|: has the next request start a
+  // new environment, also after creating one failed, unless one is being
+  // created already.
+  void RestartBrowser();
+
+  // Fails the next |count| environment creations, as |fail_environment|
+  // would.
+  void SimulateEnvironmentFailures(uint32_t count) {
+    environment_failures_ = count;
+  }
+
+ private:
+  friend class SimulatedWebViewController;
+
+  enum class EnvironmentState { kNone, kCreating, kReady, kFailed };
+
+  void OnEnvironmentCreated();
+  void CreateControllerFromEnvironment(CreateCallback callback);
+
+  // Returns true with probability |rate|.
+  bool Fails(double rate);
+
+  // Returns the result of |script| as JSON.
+  std::u16string EvaluateScript(std::u16string_view script) const;
+
+  VirtualClock* clock_;
+  SimulatedWebViewOptions options_;
+  EnvironmentState environment_ = EnvironmentState::kNone;
+  // Counts browser exits, so creations started before one fail.
+  uint64_t browser_generation_ = 0;
+  // Environment creations still to fail; see
+  // |SimulateEnvironmentFailures|.
+  uint32_t environment_failures_ = 0;
+  // Controller requests received while the environment was being created.
+  std::vector<CreateCallback> queued_requests_;
+  uint64_t random_state_;
+  // Every live controller, in creation order.
+  std::vector<SimulatedWebViewController*> controllers_;
+  SimulatedWebViewStats stats_;
+  // Lets posted tasks detect that the backend has been destroyed.
+  std::shared_ptr<SimulatedWebViewBackend*> self_;
+};
+
+#endif  // RUNNER_SIMULATED_WEB_VIEW_H_
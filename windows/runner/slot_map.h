@@ -0,0 +1,151 @@
+#ifndef RUNNER_SLOT_MAP_H_
+#define RUNNER_SLOT_MAP_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A stable, generation-checked reference to a value stored in a |SlotMap|.
+//
+// Handles stay valid until the value they refer to is erased. Once erased,
+// the slot's generation advances so stale handles (for example, ones captured
+// by an asynchronous callback) resolve to nullptr rather than to whatever
+// value later reuses the slot. A default-constructed handle is null.
+struct SlotHandle {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+
+  bool IsNull() const { return generation == 0; }
+
+  bool operator==(const SlotHandle& other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+// A densely packed container with O(1) insertion, lookup and removal through
+// |SlotHandle|s.
+//
+// Values live contiguously in insertion order (modulo swap-removal), so
+// iterating every live value touches a single array. A sparse slot array maps
+// handles to dense positions; freed slots are chained into a free list and
+// reused. A slot's generation is odd while occupied and even while free.
+template <typename T>
+class SlotMap {
+ public:
+  SlotMap() = default;
+
+  SlotMap(const SlotMap&) = delete;
+  SlotMap& operator=(const SlotMap&) = delete;
+
+  // Constructs a new value in place and returns its handle.
+  template <typename... Args>
+  SlotHandle Emplace(Args&&... args) {
+    uint32_t slot_index;
+    if (free_head_ != kNoSlot) {
+      slot_index = free_head_;
+      free_head_ = slots_[slot_index].target;
+    } else {
+      slot_index = static_cast<uint32_t>(slots_.size());
+      slots_.push_back(Slot{});
+    }
+    Slot& slot = slots_[slot_index];
+    slot.target = static_cast<uint32_t>(values_.size());
+    ++slot.generation;
+    values_.emplace_back(std::forward<Args>(args)...);
+    dense_to_slot_.push_back(slot_index);
+    return SlotHandle{slot_index, slot.generation};
+  }
+
+  // Returns the value referenced by |handle|, or nullptr if it has been
+  // erased or never existed.
+  T* Get(SlotHandle handle) {
+    return const_cast<T*>(static_cast<const SlotMap*>(this)->Get(handle));
+  }
+  const T* Get(SlotHandle handle) const {
+    if (handle.index >= slots_.size()) {
+      return nullptr;
+    }
+    const Slot& slot = slots_[handle.index];
+    if (slot.generation != handle.generation || !IsLive(slot)) {
+      return nullptr;
+    }
+    return &values_[slot.target];
+  }
+
+  // Erases the value referenced by |handle|. Returns false if the handle was
+  // already stale.
+  bool Erase(SlotHandle handle) {
+    if (Get(handle) == nullptr) {
+      return false;
+    }
+    Slot& slot = slots_[handle.index];
+    uint32_t dense_index = slot.target;
+    uint32_t last_index = static_cast<uint32_t>(values_.size() - 1);
+    if (dense_index != last_index) {
+      values_[dense_index] = std::move(values_[last_index]);
+      dense_to_slot_[dense_index] = dense_to_slot_[last_index];
+      slots_[dense_to_slot_[dense_index]].target = dense_index;
+    }
+    values_.pop_back();
+    dense_to_slot_.pop_back();
+
+    ++slot.generation;
+    slot.target = free_head_;
+    free_head_ = handle.index;
+    return true;
+  }
+
+  // Returns the handle of the value stored at |dense_index| in iteration
+  // order.
+  SlotHandle HandleAt(size_t dense_index) const {
+    assert(dense_index < dense_to_slot_.size());
+    uint32_t slot_index = dense_to_slot_[dense_index];
+    return SlotHandle{slot_index, slots_[slot_index].generation};
+  }
+
+  // Reserves room for |count| live values.
+  void Reserve(size_t count) {
+    slots_.reserve(count);
+    values_.reserve(count);
+    dense_to_slot_.reserve(count);
+  }
+
+  void Clear() {
+    for (size_t i = values_.size(); i > 0; --i) {
+      Erase(HandleAt(i - 1));
+    }
+  }
+
+  size_t size() const { return values_.size(); }
+  bool empty() const { return values_.empty(); }
+
+  // Iteration over live values in dense order. Erasing during iteration
+  // invalidates iterators.
+  typename std::vector<T>::iterator begin() { return values_.begin(); }
+  typename std::vector<T>::iterator end() { return values_.end(); }
+  typename std::vector<T>::const_iterator begin() const {
+    return values_.begin();
+  }
+  typename std::vector<T>::const_iterator end() const { return values_.end(); }
+
+ private:
+  static constexpr uint32_t kNoSlot = 0xFFFFFFFFu;
+
+  struct Slot {
+    // The dense index while occupied, or the next free slot while free.
+    uint32_t target = kNoSlot;
+    uint32_t generation = 0;
+  };
+
+  static bool IsLive(const Slot& slot) { return (slot.generation & 1u) != 0; }
+
+  std::vector<Slot> slots_;
+  std::vector<T> values_;
+  std::vector<uint32_t> dense_to_slot_;
+  uint32_t free_head_ = kNoSlot;
+};
+
+#endif  // RUNNER_SLOT_MAP_H_
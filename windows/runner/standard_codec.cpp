@@ -0,0 +1,406 @@
+#include "standard_codec.h"
+
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Size prefixes: a byte below 254 is the size itself; 254 and 255 are
+// followed by a uint16_t or uint32_t holding it.
+constexpr uint8_t kSize16 = 254;
+constexpr uint8_t kSize32 = 255;
+
+template <typename T>
+T Load(const uint8_t* bytes) {
+  T value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+// Bytes per element of a typed list, or 0 if |type| is not one.
+size_t ElementSize(StandardType type) {
+  switch (type) {
+    case StandardType::kUint8List:
+      return 1;
+    case StandardType::kInt32List:
+    case StandardType::kFloat32List:
+      return 4;
+    case StandardType::kInt64List:
+    case StandardType::kFloat64List:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// Bytes of a scalar's payload, or 0 if |type| has none or is not a scalar.
+size_t ScalarSize(StandardType type) {
+  switch (type) {
+    case StandardType::kInt32:
+      return 4;
+    case StandardType::kInt64:
+    case StandardType::kFloat64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// The alignment of a value's payload relative to the message start.
+size_t PayloadAlignment(StandardType type) {
+  return type == StandardType::kFloat64 ? 8 : ElementSize(type);
+}
+
+bool HasSizePrefix(StandardType type) {
+  return type == StandardType::kString || type == StandardType::kList ||
+         type == StandardType::kMap || ElementSize(type) != 0;
+}
+
+size_t AlignOffset(size_t offset, size_t alignment) {
+  return alignment > 1 ? (offset + alignment - 1) / alignment * alignment
+                       : offset;
+}
+
+// Validates a message with the same walk |StandardValue| does unchecked.
+class Validator {
+ public:
+  Validator(const uint8_t* message, size_t size)
+      : message_(message), position_(0), size_(size) {}
+
+  bool Run(std::string* error) {
+    bool ok = ValidateValue(0);
+    if (ok && position_ != size_) {
+      ok = Fail("unexpected bytes after the value");
+    }
+    if (!ok && error != nullptr) {
+      *error = std::string(error_) + " at offset " + std::to_string(position_);
+    }
+    return ok;
+  }
+
+ private:
+  bool Fail(const char* message) {
+    error_ = message;
+    return false;
+  }
+
+  // Consumes |count| bytes.
+  bool Take(size_t count) {
+    if (count > size_ - position_) {
+      return Fail("unexpected end of message");
+    }
+    position_ += count;
+    return true;
+  }
+
+  bool ReadSize(size_t* size) {
+    if (!Take(1)) {
+      return false;
+    }
+    uint8_t prefix = message_[position_ - 1];
+    if (prefix < kSize16) {
+      *size = prefix;
+    } else if (prefix == kSize16) {
+      if (!Take(2)) {
+        return false;
+      }
+      *size = Load<uint16_t>(message_ + position_ - 2);
+    } else {
+      if (!Take(4)) {
+        return false;
+      }
+      *size = Load<uint32_t>(message_ + position_ - 4);
+    }
+    return true;
+  }
+
+  bool ValidateValue(size_t depth) {
+    if (!Take(1)) {
+      return false;
+    }
+    uint8_t type_byte = message_[position_ - 1];
+    if (type_byte > static_cast<uint8_t>(StandardType::kFloat32List) ||
+        type_byte == static_cast<uint8_t>(StandardType::kLargeInt)) {
+      --position_;
+      return Fail("unsupported type");
+    }
+    StandardType type = static_cast<StandardType>(type_byte);
+    size_t count = 0;
+    if (HasSizePrefix(type) && !ReadSize(&count)) {
+      return false;
+    }
+    size_t aligned = AlignOffset(position_, PayloadAlignment(type));
+    if (aligned > size_) {
+      return Fail("unexpected end of message");
+    }
+    position_ = aligned;
+
+    if (type == StandardType::kList || type == StandardType::kMap) {
+      if (depth + 1 > kMaxStandardMessageDepth) {
+        return Fail("nesting is too deep");
+      }
+      size_t children = type == StandardType::kMap ? 2 : 1;
+      for (size_t i = 0; i < count; ++i) {
+        for (size_t child = 0; child < children; ++child) {
+          if (!ValidateValue(depth + 1)) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+    if (type == StandardType::kString) {
+      return Take(count);
+    }
+    if (size_t element_size = ElementSize(type)) {
+      if (count > (size_ - position_) / element_size) {
+        return Fail("unexpected end of message");
+      }
+      return Take(count * element_size);
+    }
+    return Take(ScalarSize(type));
+  }
+
+  const uint8_t* message_;
+  size_t position_;
+  size_t size_;
+  const char* error_ = "";
+};
+
+}  // namespace
+
+int64_t StandardValue::GetInt() const {
+  switch (type_) {
+    case StandardType::kInt32:
+      return Load<int32_t>(payload_);
+    case StandardType::kInt64:
+      return Load<int64_t>(payload_);
+    default:
+      return 0;
+  }
+}
+
+double StandardValue::GetDouble() const {
+  return type_ == StandardType::kFloat64 ? Load<double>(payload_) : 0;
+}
+
+std::string_view StandardValue::GetString() const {
+  if (type_ != StandardType::kString) {
+    return std::string_view();
+  }
+  return std::string_view(reinterpret_cast<const char*>(payload_), count_);
+}
+
+uint8_t StandardValue::Uint8At(size_t index) const {
+  return payload_[index];
+}
+
+int32_t StandardValue::Int32At(size_t index) const {
+  return Load<int32_t>(payload_ + index * sizeof(int32_t));
+}
+
+int64_t StandardValue::Int64At(size_t index) const {
+  return Load<int64_t>(payload_ + index * sizeof(int64_t));
+}
+
+float StandardValue::Float32At(size_t index) const {
+  return Load<float>(payload_ + index * sizeof(float));
+}
+
+double StandardValue::Float64At(size_t index) const {
+  return Load<double>(payload_ + index * sizeof(double));
+}
+
+StandardValue StandardValue::At(size_t index) const {
+  if (type_ != StandardType::kList || index >= count_) {
+    return StandardValue();
+  }
+  StandardValue element;
+  const uint8_t* position = payload_;
+  for (size_t i = 0;; ++i) {
+    ReadHeader(message_, position, &element);
+    if (i == index) {
+      return element;
+    }
+    position = element.End();
+  }
+}
+
+StandardValue StandardValue::Find(std::string_view key) const {
+  StandardValue found;
+  if (type_ != StandardType::kMap) {
+    return found;
+  }
+  const uint8_t* position = payload_;
+  for (size_t i = 0; i < count_; ++i) {
+    StandardValue entry_key;
+    StandardValue value;
+    ReadHeader(message_, position, &entry_key);
+    ReadHeader(message_, entry_key.End(), &value);
+    if (entry_key.type_ == StandardType::kString &&
+        entry_key.GetString() == key) {
+      return value;
+    }
+    position = value.End();
+  }
+  return found;
+}
+
+const uint8_t* StandardValue::ReadHeader(const uint8_t* message,
+                                         const uint8_t* position,
+                                         StandardValue* value) {
+  value->message_ = message;
+  value->type_ = static_cast<StandardType>(*position++);
+  value->count_ = 0;
+  if (HasSizePrefix(value->type_)) {
+    uint8_t prefix = *position++;
+    if (prefix < kSize16) {
+      value->count_ = prefix;
+    } else if (prefix == kSize16) {
+      value->count_ = Load<uint16_t>(position);
+      position += 2;
+    } else {
+      value->count_ = Load<uint32_t>(position);
+      position += 4;
+    }
+  }
+  position = message + AlignOffset(static_cast<size_t>(position - message),
+                                   PayloadAlignment(value->type_));
+  value->payload_ = position;
+  return position;
+}
+
+const uint8_t* StandardValue::End() const {
+  switch (type_) {
+    case StandardType::kString:
+      return payload_ + count_;
+    case StandardType::kList:
+    case StandardType::kMap: {
+      size_t children = type_ == StandardType::kMap ? count_ * 2 : count_;
+      const uint8_t* position = payload_;
+      for (size_t i = 0; i < children; ++i) {
+        StandardValue child;
+        ReadHeader(message_, position, &child);
+        position = child.End();
+      }
+      return position;
+    }
+    default:
+      return payload_ + count_ * ElementSize(type_) + ScalarSize(type_);
+  }
+}
+
+bool DecodeStandardMessage(const uint8_t* message,
+                           size_t size,
+                           StandardValue* value,
+                           std::string* error) {
+  if (!Validator(message, size).Run(error)) {
+    *value = StandardValue();
+    return false;
+  }
+  StandardValue::ReadHeader(message, message, value);
+  return true;
+}
+
+void StandardMessageWriter::Null() {
+  WriteType(StandardType::kNull);
+}
+
+void StandardMessageWriter::Bool(bool value) {
+  WriteType(value ? StandardType::kTrue : StandardType::kFalse);
+}
+
+void StandardMessageWriter::Int(int64_t value) {
+  if (value >= std::numeric_limits<int32_t>::min() &&
+      value <= std::numeric_limits<int32_t>::max()) {
+    int32_t narrow = static_cast<int32_t>(value);
+    WriteType(StandardType::kInt32);
+    WriteBytes(&narrow, sizeof(narrow));
+  } else {
+    WriteType(StandardType::kInt64);
+    WriteBytes(&value, sizeof(value));
+  }
+}
+
+void StandardMessageWriter::Double(double value) {
+  WriteType(StandardType::kFloat64);
+  Align(sizeof(value));
+  WriteBytes(&value, sizeof(value));
+}
+
+void StandardMessageWriter::String(std::string_view value) {
+  WriteType(StandardType::kString);
+  WriteSize(value.size());
+  WriteBytes(value.data(), value.size());
+}
+
+void StandardMessageWriter::Uint8List(const uint8_t* values, size_t count) {
+  WriteType(StandardType::kUint8List);
+  WriteSize(count);
+  WriteBytes(values, count);
+}
+
+void StandardMessageWriter::Int32List(const int32_t* values, size_t count) {
+  WriteType(StandardType::kInt32List);
+  WriteSize(count);
+  Align(sizeof(*values));
+  WriteBytes(values, count * sizeof(*values));
+}
+
+void StandardMessageWriter::Int64List(const int64_t* values, size_t count) {
+  WriteType(StandardType::kInt64List);
+  WriteSize(count);
+  Align(sizeof(*values));
+  WriteBytes(values, count * sizeof(*values));
+}
+
+void StandardMessageWriter::Float32List(const float* values, size_t count) {
+  WriteType(StandardType::kFloat32List);
+  WriteSize(count);
+  Align(sizeof(*values));
+  WriteBytes(values, count * sizeof(*values));
+}
+
+void StandardMessageWriter::Float64List(const double* values, size_t count) {
+  WriteType(StandardType::kFloat64List);
+  WriteSize(count);
+  Align(sizeof(*values));
+  WriteBytes(values, count * sizeof(*values));
+}
+
+void StandardMessageWriter::BeginList(size_t count) {
+  WriteType(StandardType::kList);
+  WriteSize(count);
+}
+
+void StandardMessageWriter::BeginMap(size_t count) {
+  WriteType(StandardType::kMap);
+  WriteSize(count);
+}
+
+void StandardMessageWriter::WriteType(StandardType type) {
+  output_->push_back(static_cast<uint8_t>(type));
+}
+
+void StandardMessageWriter::WriteSize(size_t size) {
+  if (size < kSize16) {
+    output_->push_back(static_cast<uint8_t>(size));
+  } else if (size <= std::numeric_limits<uint16_t>::max()) {
+    output_->push_back(kSize16);
+    uint16_t value = static_cast<uint16_t>(size);
+    WriteBytes(&value, sizeof(value));
+  } else {
+    output_->push_back(kSize32);
+    uint32_t value = static_cast<uint32_t>(size);
+    WriteBytes(&value, sizeof(value));
+  }
+}
+
+void StandardMessageWriter::Align(size_t alignment) {
+  output_->resize(AlignOffset(output_->size(), alignment), 0);
+}
+
+void StandardMessageWriter::WriteBytes(const void* bytes, size_t count) {
+  const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+  output_->insert(output_->end(), begin, begin + count);
+}
@@ -0,0 +1,207 @@
+#ifndef RUNNER_STANDARD_CODEC_H_
+#define RUNNER_STANDARD_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A zero-copy reader and a writer for Flutter's standard message codec, the
+// binary format of StandardMessageCodec in Dart.
+//
+// |DecodeStandardMessage| validates a whole message in one pass and
+// returns its top-level value as a |StandardValue|, a view into the
+// message: strings and typed lists are read in place, and containers are
+// walked by skipping over their children, so decoding allocates nothing.
+// Validation bounds every later read, so accessors do no checking beyond
+// the value's type.
+//
+// Multi-byte values are in host byte order, as Dart writes them; every
+// platform the runner targets is little-endian. Typed list data is aligned
+// relative to the start of the message, so it is aligned in memory when
+// the message is, which |data()| callers relying on it must ensure.
+
+// Type bytes of the format.
+enum class StandardType : uint8_t {
+  kNull = 0,
+  kTrue = 1,
+  kFalse = 2,
+  kInt32 = 3,
+  kInt64 = 4,
+  // Integers too large for int64_t, as hex strings. Dart no longer writes
+  // them, and they are rejected.
+  kLargeInt = 5,
+  kFloat64 = 6,
+  kString = 7,
+  kUint8List = 8,
+  kInt32List = 9,
+  kInt64List = 10,
+  kFloat64List = 11,
+  kList = 12,
+  kMap = 13,
+  kFloat32List = 14,
+};
+
+// A value in a validated message, valid as long as the message's bytes
+// are. Accessors for the wrong type return empty values.
+class StandardValue {
+ public:
+  // A null value, not part of any message.
+  StandardValue() = default;
+
+  StandardType type() const { return type_; }
+  bool IsNull() const { return type_ == StandardType::kNull; }
+  bool IsBool() const {
+    return type_ == StandardType::kTrue || type_ == StandardType::kFalse;
+  }
+  // Whether this is an int32 or int64.
+  bool IsInt() const {
+    return type_ == StandardType::kInt32 || type_ == StandardType::kInt64;
+  }
+
+  bool GetBool() const { return type_ == StandardType::kTrue; }
+  // Returns an int32 or int64.
+  int64_t GetInt() const;
+  double GetDouble() const;
+  // Returns a string's UTF-8 bytes, pointing into the message.
+  std::string_view GetString() const;
+
+  // The number of bytes of a string, elements of a list or typed list, or
+  // entries of a map.
+  size_t size() const { return count_; }
+
+  // A typed list's first element, pointing into the message.
+  const uint8_t* data() const { return payload_; }
+
+  // Typed list elements. |index| must be below |size()|.
+  uint8_t Uint8At(size_t index) const;
+  int32_t Int32At(size_t index) const;
+  int64_t Int64At(size_t index) const;
+  float Float32At(size_t index) const;
+  double Float64At(size_t index) const;
+
+  // Returns the list element at |index|, or null if there is none.
+  // Elements are found by skipping their predecessors.
+  StandardValue At(size_t index) const;
+
+  // Returns the value of the map entry whose key is the string |key|, or
+  // null if there is none.
+  StandardValue Find(std::string_view key) const;
+
+  // Invokes |callback(StandardValue)| on each list element in order.
+  template <typename Callback>
+  void ForEachElement(Callback&& callback) const;
+
+  // Invokes |callback(StandardValue key, StandardValue value)| on each map
+  // entry in order.
+  template <typename Callback>
+  void ForEachEntry(Callback&& callback) const;
+
+ private:
+  friend bool DecodeStandardMessage(const uint8_t* message,
+                                    size_t size,
+                                    StandardValue* value,
+                                    std::string* error);
+
+  // Reads the value starting at |position| in |message|, which has been
+  // validated, into |value|, and returns where its payload ends; for
+  // containers that is where their first child starts.
+  static const uint8_t* ReadHeader(const uint8_t* message,
+                                   const uint8_t* position,
+                                   StandardValue* value);
+
+  // Returns where this value, including any children, ends.
+  const uint8_t* End() const;
+
+  // Where the message starts, which alignment is relative to.
+  const uint8_t* message_ = nullptr;
+  // Where the value's payload starts: a scalar's bytes, a string's or
+  // typed list's data, or a container's first child.
+  const uint8_t* payload_ = nullptr;
+  size_t count_ = 0;
+  StandardType type_ = StandardType::kNull;
+};
+
+// Containers nested deeper than this are rejected, bounding the recursion
+// of validation and of skipping over values.
+constexpr size_t kMaxStandardMessageDepth = 64;
+
+// Validates the |size| bytes at |message| as exactly one value and stores
+// it in |value|. On failure returns false and, if |error| is non-null,
+// sets it to a description including the offset.
+bool DecodeStandardMessage(const uint8_t* message,
+                           size_t size,
+                           StandardValue* value,
+                           std::string* error);
+
+// Writes a message into a byte vector.
+//
+// The message starts at the beginning of the vector, which alignment is
+// relative to. The caller is responsible for writing as many elements or
+// entries (key, then value) as each container announces.
+class StandardMessageWriter {
+ public:
+  // Appends to |output|, which must be empty and outlive the writer.
+  explicit StandardMessageWriter(std::vector<uint8_t>* output)
+      : output_(output) {}
+
+  StandardMessageWriter(const StandardMessageWriter&) = delete;
+  StandardMessageWriter& operator=(const StandardMessageWriter&) = delete;
+
+  void Null();
+  void Bool(bool value);
+  // Writes an int32 when |value| fits, like Dart does, and an int64
+  // otherwise.
+  void Int(int64_t value);
+  void Double(double value);
+  void String(std::string_view value);
+  void Uint8List(const uint8_t* values, size_t count);
+  void Int32List(const int32_t* values, size_t count);
+  void Int64List(const int64_t* values, size_t count);
+  void Float32List(const float* values, size_t count);
+  void Float64List(const double* values, size_t count);
+  void BeginList(size_t count);
+  void BeginMap(size_t count);
+
+ private:
+  void WriteType(StandardType type);
+  void WriteSize(size_t size);
+  // Pads the message to a multiple of |alignment| bytes.
+  void Align(size_t alignment);
+  void WriteBytes(const void* bytes, size_t count);
+
+  std::vector<uint8_t>* output_;
+};
+
+template <typename Callback>
+void StandardValue::ForEachElement(Callback&& callback) const {
+  if (type_ != StandardType::kList) {
+    return;
+  }
+  const uint8_t* position = payload_;
+  for (size_t i = 0; i < count_; ++i) {
+    StandardValue element;
+    ReadHeader(message_, position, &element);
+    callback(element);
+    position = element.End();
+  }
+}
+
+template <typename Callback>
+void StandardValue::ForEachEntry(Callback&& callback) const {
+  if (type_ != StandardType::kMap) {
+    return;
+  }
+  const uint8_t* position = payload_;
+  for (size_t i = 0; i < count_; ++i) {
+    StandardValue key;
+    StandardValue value;
+    ReadHeader(message_, position, &key);
+    ReadHeader(message_, key.End(), &value);
+    callback(key, value);
+    position = value.End();
+  }
+}
+
+#endif  // RUNNER_STANDARD_CODEC_H_
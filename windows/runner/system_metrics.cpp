@@ -0,0 +1,81 @@
+#include "system_metrics.h"
+
+namespace {
+
+// Returns the squared distance from the point to |rect|, zero inside it.
+int64_t DistanceSquared(const IntRect& rect, int32_t x, int32_t y) {
+  int64_t dx = 0;
+  if (x < rect.left) {
+    dx = static_cast<int64_t>(rect.left) - x;
+  } else if (x >= rect.right) {
+    dx = static_cast<int64_t>(x) - rect.right + 1;
+  }
+  int64_t dy = 0;
+  if (y < rect.top) {
+    dy = static_cast<int64_t>(rect.top) - y;
+  } else if (y >= rect.bottom) {
+    dy = static_cast<int64_t>(y) - rect.bottom + 1;
+  }
+  return dx * dx + dy * dy;
+}
+
+}  // namespace
+
+SystemMetricsCache::SystemMetricsCache(SystemMetricsProvider* provider)
+    : provider_(provider) {}
+
+const MonitorInfo* SystemMetricsCache::MonitorFromPoint(int32_t x, int32_t y) {
+  ++stats_.lookups;
+  if (!monitors_) {
+    ++stats_.monitor_refreshes;
+    monitors_ = provider_->EnumerateMonitors();
+  }
+  const MonitorInfo* nearest = nullptr;
+  int64_t nearest_distance = 0;
+  for (const MonitorInfo& monitor : *monitors_) {
+    int64_t distance = DistanceSquared(monitor.bounds, x, y);
+    if (nearest == nullptr || distance < nearest_distance) {
+      nearest = &monitor;
+      nearest_distance = distance;
+      if (distance == 0) {
+        break;
+      }
+    }
+  }
+  return nearest;
+}
+
+uint32_t SystemMetricsCache::DpiForPoint(int32_t x, int32_t y) {
+  const MonitorInfo* monitor = MonitorFromPoint(x, y);
+  return monitor != nullptr && monitor->dpi != 0 ? monitor->dpi : kDefaultDpi;
+}
+
+std::optional<bool> SystemMetricsCache::PrefersDarkMode() {
+  ++stats_.lookups;
+  if (!prefers_dark_mode_) {
+    ++stats_.theme_refreshes;
+    prefers_dark_mode_ = provider_->ReadPrefersDarkMode();
+  }
+  return *prefers_dark_mode_;
+}
+
+void* SystemMetricsCache::SystemFunction(const char* name) {
+  ++stats_.lookups;
+  for (const auto& [function_name, function] : functions_) {
+    if (function_name == name) {
+      return function;
+    }
+  }
+  ++stats_.function_loads;
+  void* function = provider_->LoadSystemFunction(name);
+  functions_.emplace_back(name, function);
+  return function;
+}
+
+void SystemMetricsCache::InvalidateMonitors() {
+  monitors_.reset();
+}
+
+void SystemMetricsCache::InvalidateTheme() {
+  prefers_dark_mode_.reset();
+}
@@ -0,0 +1,117 @@
+#ifndef RUNNER_SYSTEM_METRICS_H_
+#define RUNNER_SYSTEM_METRICS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "geometry.h"
+
+// The DPI at which one logical pixel is one physical pixel.
+constexpr uint32_t kDefaultDpi = 96;
+
+// Converts |logical| pixels to physical pixels at |dpi|, rounding to the
+// nearest pixel with halves away from zero. Computed in integers, so the
+// result is exact where scaling by a floating-point factor and truncating
+// can lose a pixel.
+constexpr int32_t ScaleForDpi(int32_t logical, uint32_t dpi) {
+  int64_t scaled = static_cast<int64_t>(logical) * dpi;
+  int64_t half = kDefaultDpi / 2;
+  return static_cast<int32_t>(scaled >= 0 ? (scaled + half) / kDefaultDpi
+                                          : -((-scaled + half) / kDefaultDpi));
+}
+
+// Converts |physical| pixels at |dpi| back to logical pixels, rounding the
+// same way as |ScaleForDpi|.
+constexpr int32_t UnscaleForDpi(int32_t physical, uint32_t dpi) {
+  if (dpi == 0) {
+    return physical;
+  }
+  int64_t scaled = static_cast<int64_t>(physical) * kDefaultDpi;
+  int64_t half = dpi / 2;
+  return static_cast<int32_t>(scaled >= 0 ? (scaled + half) / dpi
+                                          : -((-scaled + half) / dpi));
+}
+
+using MonitorId = uint64_t;
+
+struct MonitorInfo {
+  MonitorId id = 0;
+  // Monitor rectangle in virtual screen coordinates.
+  IntRect bounds;
+  uint32_t dpi = kDefaultDpi;
+};
+
+// The operating system queries behind a |SystemMetricsCache|.
+class SystemMetricsProvider {
+ public:
+  virtual ~SystemMetricsProvider() = default;
+
+  // Returns every attached monitor.
+  virtual std::vector<MonitorInfo> EnumerateMonitors() = 0;
+
+  // Returns whether apps should use dark mode, or nothing if the preference
+  // cannot be read.
+  virtual std::optional<bool> ReadPrefersDarkMode() = 0;
+
+  // Returns the system function |name|, or null if this version of the OS
+  // does not have it.
+  virtual void* LoadSystemFunction(const char* name) = 0;
+};
+
+struct SystemMetricsStats {
+  // Lookups served, and how many of them had to query the provider.
+  uint64_t lookups = 0;
+  uint64_t monitor_refreshes = 0;
+  uint64_t theme_refreshes = 0;
+  uint64_t function_loads = 0;
+};
+
+// Serves monitor, DPI, theme and system function lookups from memory.
+//
+// Each kind of data is fetched from the provider on first use and kept
+// until the matching |Invalidate*| call, which the window procedure makes
+// when the system reports a change. Not thread-safe; use it from the UI
+// thread.
+class SystemMetricsCache {
+ public:
+  explicit SystemMetricsCache(SystemMetricsProvider* provider);
+
+  SystemMetricsCache(const SystemMetricsCache&) = delete;
+  SystemMetricsCache& operator=(const SystemMetricsCache&) = delete;
+
+  // Returns the monitor containing the point, or the nearest one if no
+  // monitor does. Returns null if there are no monitors. The pointer is
+  // valid until the monitors are invalidated.
+  const MonitorInfo* MonitorFromPoint(int32_t x, int32_t y);
+
+  // Returns the DPI of the monitor |MonitorFromPoint| picks, or
+  // kDefaultDpi.
+  uint32_t DpiForPoint(int32_t x, int32_t y);
+
+  // Returns whether apps should use dark mode, or nothing if unknown.
+  std::optional<bool> PrefersDarkMode();
+
+  // Returns the system function |name|, or null if unavailable. Functions
+  // stay valid for the life of the process, so they are never invalidated.
+  void* SystemFunction(const char* name);
+
+  // Call when monitors are added, removed, moved or change DPI.
+  void InvalidateMonitors();
+
+  // Call when the user's theme preference may have changed.
+  void InvalidateTheme();
+
+  const SystemMetricsStats& stats() const { return stats_; }
+
+ private:
+  SystemMetricsProvider* provider_;
+  std::optional<std::vector<MonitorInfo>> monitors_;
+  std::optional<std::optional<bool>> prefers_dark_mode_;
+  std::vector<std::pair<std::string, void*>> functions_;
+  SystemMetricsStats stats_;
+};
+
+#endif  // RUNNER_SYSTEM_METRICS_H_
@@ -0,0 +1,158 @@
+#include "task_scheduler.h"
+
+#include <utility>
+
+TaskScheduler::TaskScheduler(WakeCallback wake) : wake_(std::move(wake)) {}
+
+void TaskScheduler::PostTask(Task task, TaskPriority priority) {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_[static_cast<size_t>(priority)].push_back(
+        ReadyTask{Clock::now(), std::move(task)});
+    wake = !wake_pending_;
+    wake_pending_ = true;
+  }
+  Wake(wake);
+}
+
+void TaskScheduler::PostTaskAt(Task task,
+                               Clock::time_point run_at,
+                               TaskPriority priority) {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Only a new earliest task changes how long the loop may sleep.
+    bool earliest = delayed_.empty() || run_at < delayed_.top().run_at;
+    delayed_.push(
+        DelayedTask{run_at, next_sequence_++, priority, std::move(task)});
+    wake = earliest && !wake_pending_;
+    wake_pending_ = wake_pending_ || earliest;
+  }
+  Wake(wake);
+}
+
+void TaskScheduler::PostDelayedTask(Task task,
+                                    Clock::duration delay,
+                                    TaskPriority priority) {
+  PostTaskAt(std::move(task), Clock::now() + delay, priority);
+}
+
+void TaskScheduler::PostIdleTask(IdleTask task) {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(std::move(task));
+    wake = !wake_pending_;
+    wake_pending_ = true;
+  }
+  Wake(wake);
+}
+
+bool TaskScheduler::RunUntil(Clock::time_point deadline) {
+  bool ran_task = false;
+  while (true) {
+    ReadyTask next;
+    Clock::time_point now = Clock::now();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      PromoteDueTasks(now);
+      std::deque<ReadyTask>* queue = nullptr;
+      for (std::deque<ReadyTask>& ready : ready_) {
+        if (!ready.empty()) {
+          queue = &ready;
+          break;
+        }
+      }
+      if (queue == nullptr) {
+        return false;
+      }
+      // Guarantee progress even if the deadline had already passed.
+      if (ran_task && now >= deadline) {
+        ++stats_.budget_exhausted;
+        return true;
+      }
+      next = std::move(queue->front());
+      queue->pop_front();
+      ++stats_.tasks_run;
+      if (now - next.due > stats_.max_task_delay) {
+        stats_.max_task_delay = now - next.due;
+      }
+    }
+    next.task();
+    ran_task = true;
+  }
+}
+
+bool TaskScheduler::RunIdleTasks(Clock::time_point deadline) {
+  while (true) {
+    IdleTask next;
+    Clock::time_point task_deadline = deadline;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (idle_.empty()) {
+        return false;
+      }
+      if (Clock::now() >= deadline) {
+        return true;
+      }
+      if (!delayed_.empty() && delayed_.top().run_at < task_deadline) {
+        task_deadline = delayed_.top().run_at;
+      }
+      next = std::move(idle_.front());
+      idle_.pop_front();
+      ++stats_.idle_tasks_run;
+    }
+    next(task_deadline);
+  }
+}
+
+std::optional<TaskScheduler::Clock::time_point> TaskScheduler::NextWakeTime() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The loop is about to consult the queues; posts from here on must wake it
+  // again.
+  wake_pending_ = false;
+  if (HasReadyTask()) {
+    return Clock::time_point::min();
+  }
+  if (!delayed_.empty()) {
+    return delayed_.top().run_at;
+  }
+  return std::nullopt;
+}
+
+bool TaskScheduler::HasIdleTasks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !idle_.empty();
+}
+
+TaskSchedulerStats TaskScheduler::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void TaskScheduler::PromoteDueTasks(Clock::time_point now) {
+  while (!delayed_.empty() && delayed_.top().run_at <= now) {
+    // The heap only exposes a const top; the task is moved out just before
+    // the element is popped.
+    DelayedTask& top = const_cast<DelayedTask&>(delayed_.top());
+    ready_[static_cast<size_t>(top.priority)].push_back(
+        ReadyTask{top.run_at, std::move(top.task)});
+    delayed_.pop();
+  }
+}
+
+bool TaskScheduler::HasReadyTask() const {
+  for (const std::deque<ReadyTask>& ready : ready_) {
+    if (!ready.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskScheduler::Wake(bool needed) {
+  if (needed && wake_) {
+    wake_();
+  }
+}
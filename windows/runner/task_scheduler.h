@@ -0,0 +1,147 @@
+#ifndef RUNNER_TASK_SCHEDULER_H_
+#define RUNNER_TASK_SCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <vector>
+
+// Deferred work for the runner's main loop.
+//
+// Tasks may be posted from any thread. The loop that owns the scheduler runs
+// them between window messages: due tasks first, highest priority first and
+// in posting order within a priority, then idle tasks when nothing else is
+// pending. Each call runs work only until a caller-supplied deadline, so a
+// long queue cannot starve input and painting.
+//
+// The scheduler does not block. Posting a task invokes the wake callback,
+// which the owning loop uses to interrupt its wait; |NextWakeTime| tells it
+// how long it may sleep otherwise. See |Win32RunLoop| and |PortableRunLoop|.
+
+enum class TaskPriority : uint8_t {
+  // Work the user is waiting on, such as input-driven updates.
+  kHigh,
+  kNormal,
+  // Housekeeping that may be delayed by anything else.
+  kLow,
+};
+
+struct TaskSchedulerStats {
+  uint64_t tasks_run = 0;
+  uint64_t idle_tasks_run = 0;
+  // Calls to |RunUntil| that stopped at the deadline with due work left.
+  uint64_t budget_exhausted = 0;
+  // Time from when a task became due to when it started running.
+  std::chrono::nanoseconds max_task_delay{0};
+};
+
+// How long a loop driving a |TaskScheduler| spends on tasks before it goes
+// back to its other events.
+struct RunLoopBudget {
+  // Due tasks per iteration; half a frame at 60Hz.
+  std::chrono::milliseconds tasks{8};
+  // Idle tasks per iteration, when there is nothing else to do.
+  std::chrono::milliseconds idle{50};
+};
+
+class TaskScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Task = std::function<void()>;
+  // Receives the time by which the idle task should return.
+  using IdleTask = std::function<void(Clock::time_point deadline)>;
+  using WakeCallback = std::function<void()>;
+
+  // |wake| is invoked, possibly from another thread, when a posted task may
+  // require the loop to run sooner than it planned to. Consecutive posts
+  // wake the loop once until it next calls |NextWakeTime|.
+  explicit TaskScheduler(WakeCallback wake);
+
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+  // Posts |task| to run as soon as possible. Thread-safe.
+  void PostTask(Task task, TaskPriority priority = TaskPriority::kNormal);
+
+  // Posts |task| to run once |run_at| has passed. Thread-safe.
+  void PostTaskAt(Task task,
+                  Clock::time_point run_at,
+                  TaskPriority priority = TaskPriority::kNormal);
+
+  // Posts |task| to run after |delay|. Thread-safe.
+  void PostDelayedTask(Task task,
+                       Clock::duration delay,
+                       TaskPriority priority = TaskPriority::kNormal);
+
+  // Posts |task| to run when the loop is otherwise idle. Thread-safe.
+  void PostIdleTask(IdleTask task);
+
+  // Runs due tasks until none are left or |deadline| has passed. At least
+  // one due task is run. Returns true if due tasks remain.
+  bool RunUntil(Clock::time_point deadline);
+
+  // Runs idle tasks until none are left or |deadline| has passed, passing
+  // each the earlier of |deadline| and the next delayed task. Returns true
+  // if idle tasks remain.
+  bool RunIdleTasks(Clock::time_point deadline);
+
+  // Returns when due work is next expected: now or earlier if a task is
+  // already due, the earliest delayed task otherwise, or nothing if there is
+  // no pending work other than idle tasks.
+  std::optional<Clock::time_point> NextWakeTime();
+
+  bool HasIdleTasks();
+
+  TaskSchedulerStats stats();
+
+ private:
+  struct DelayedTask {
+    Clock::time_point run_at;
+    // Keeps tasks due at the same time in posting order.
+    uint64_t sequence;
+    TaskPriority priority;
+    Task task;
+  };
+
+  struct LaterFirst {
+    bool operator()(const DelayedTask& a, const DelayedTask& b) const {
+      return a.run_at != b.run_at ? a.run_at > b.run_at
+                                  : a.sequence > b.sequence;
+    }
+  };
+
+  struct ReadyTask {
+    Clock::time_point due;
+    Task task;
+  };
+
+  static constexpr size_t kPriorityCount = 3;
+
+  // Moves delayed tasks due at |now| to the ready queues. Requires |mutex_|.
+  void PromoteDueTasks(Clock::time_point now);
+
+  // Returns true if a ready task exists. Requires |mutex_|.
+  bool HasReadyTask() const;
+
+  // Invokes the wake callback if |needed|. Must be called without |mutex_|
+  // held, since the callback may post tasks of its own.
+  void Wake(bool needed);
+
+  WakeCallback wake_;
+
+  std::mutex mutex_;
+  std::deque<ReadyTask> ready_[kPriorityCount];
+  std::priority_queue<DelayedTask, std::vector<DelayedTask>, LaterFirst>
+      delayed_;
+  std::deque<IdleTask> idle_;
+  uint64_t next_sequence_ = 0;
+  // Set once the loop has been woken, cleared by |NextWakeTime|.
+  bool wake_pending_ = false;
+  TaskSchedulerStats stats_;
+};
+
+#endif  // RUNNER_TASK_SCHEDULER_H_
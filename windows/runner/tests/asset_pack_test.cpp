@@ -0,0 +1,294 @@
+#include "asset_pack.h"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "test.h"
+
+namespace {
+
+// Offsets within the archive, as documented in asset_pack.h.
+constexpr size_t kCountOffset = 8;
+constexpr size_t kHashesOffset = 16;
+constexpr size_t kEntrySize = 32;
+
+size_t EntryOffset(size_t count, size_t index) {
+  return kHashesOffset + count * 8 + index * kEntrySize;
+}
+
+void Store32(std::string* bytes, size_t offset, uint32_t value) {
+  std::memcpy(bytes->data() + offset, &value, sizeof(value));
+}
+
+void Store64(std::string* bytes, size_t offset, uint64_t value) {
+  std::memcpy(bytes->data() + offset, &value, sizeof(value));
+}
+
+// Assets of varied sizes, types and contents, including an empty one and
+// binary data with embedded nulls.
+std::map<std::string, std::string> SampleAssets() {
+  std::map<std::string, std::string> assets;
+  assets["index.html"] = "<!doctype html><script src=main.js></script>";
+  assets["main.js"] = "console.log('hi');";
+  assets["css/app.css"] = "body { margin: 0 }";
+  assets["empty.txt"] = "";
+  std::string binary;
+  for (int i = 0; i < 1000; ++i) {
+    binary.push_back(static_cast<char>(i * 7));
+  }
+  assets["img/logo.png"] = binary;
+  assets["fonts/x.woff2"] = std::string(3, '\0');
+  assets["caf\xC3\xA9/menu.json"] = "{}";
+  return assets;
+}
+
+std::string BuildPack(const std::map<std::string, std::string>& assets) {
+  AssetPackBuilder builder;
+  for (const auto& [path, data] : assets) {
+    builder.Add(path, MimeTypeForPath(path), data);
+  }
+  return builder.Build();
+}
+
+// Returns whether |view| lies within |bytes|.
+bool Within(std::string_view view, std::string_view bytes) {
+  return view.data() >= bytes.data() &&
+         view.data() + view.size() <= bytes.data() + bytes.size();
+}
+
+RUNNER_TEST(AssetPack, RoundTrip) {
+  std::map<std::string, std::string> assets = SampleAssets();
+  std::string bytes = BuildPack(assets);
+  std::string error;
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, &error);
+  ASSERT_TRUE(pack.has_value());
+  EXPECT_EQ(error, "");
+  EXPECT_EQ(pack->size(), assets.size());
+  for (const auto& [path, data] : assets) {
+    std::optional<Asset> asset = pack->Find(path);
+    ASSERT_TRUE(asset.has_value());
+    EXPECT_EQ(asset->data, data);
+    EXPECT_EQ(asset->mime_type, MimeTypeForPath(path));
+    // Served in place, aligned to 16 bytes.
+    EXPECT_TRUE(Within(asset->data, bytes));
+    EXPECT_EQ((asset->data.data() - bytes.data()) % 16, 0);
+  }
+}
+
+RUNNER_TEST(AssetPack, FindMisses) {
+  std::string bytes = BuildPack(SampleAssets());
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, nullptr);
+  ASSERT_TRUE(pack.has_value());
+  EXPECT_FALSE(pack->Find("").has_value());
+  EXPECT_FALSE(pack->Find("missing.js").has_value());
+  EXPECT_FALSE(pack->Find("Main.js").has_value());
+  EXPECT_FALSE(pack->Find("/main.js").has_value());
+  EXPECT_FALSE(pack->Find(std::string_view("main.js\0", 8)).has_value());
+}
+
+RUNNER_TEST(AssetPack, EmptyPack) {
+  AssetPackBuilder builder;
+  std::string bytes = builder.Build();
+  EXPECT_EQ(bytes.size(), 16u);
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, nullptr);
+  ASSERT_TRUE(pack.has_value());
+  EXPECT_EQ(pack->size(), 0u);
+  EXPECT_FALSE(pack->Find("index.html").has_value());
+}
+
+RUNNER_TEST(AssetPack, BuilderRejectsEmptyAndDuplicatePaths) {
+  AssetPackBuilder builder;
+  EXPECT_FALSE(builder.Add("", "text/plain", "x"));
+  EXPECT_TRUE(builder.Add("a.txt", "text/plain", "1"));
+  EXPECT_FALSE(builder.Add("a.txt", "text/html", "2"));
+  EXPECT_EQ(builder.size(), 1u);
+  std::string bytes = builder.Build();
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, nullptr);
+  ASSERT_TRUE(pack.has_value());
+  EXPECT_EQ(pack->Find("a.txt")->data, "1");
+}
+
+RUNNER_TEST(AssetPack, ManyAssetsRoundTrip) {
+  std::mt19937 random(31);
+  std::map<std::string, std::string> assets;
+  for (int i = 0; i < 2000; ++i) {
+    std::string path("dir");
+    path.append(std::to_string(i % 17)).append("/file");
+    path.append(std::to_string(i)).append(i % 2 ? ".js" : ".css");
+    assets[path] = std::string(random() % 100, static_cast<char>(i));
+  }
+  std::string bytes = BuildPack(assets);
+  std::optional<AssetPack> pack = AssetPack::Open(bytes, nullptr);
+  ASSERT_TRUE(pack.has_value());
+  for (const auto& [path, data] : assets) {
+    std::optional<Asset> asset = pack->Find(path);
+    ASSERT_TRUE(asset.has_value());
+    EXPECT_EQ(asset->data, data);
+  }
+}
+
+RUNNER_TEST(AssetPack, RejectsBadHeaders) {
+  std::string bytes = BuildPack(SampleAssets());
+  std::string error;
+  std::string bad = bytes;
+  bad[0] = 'X';
+  EXPECT_FALSE(AssetPack::Open(bad, &error).has_value());
+  EXPECT_EQ(error, "not an asset pack");
+
+  bad = bytes;
+  Store32(&bad, 4, 2);
+  EXPECT_FALSE(AssetPack::Open(bad, &error).has_value());
+  EXPECT_EQ(error, "unsupported asset pack version");
+
+  bad = bytes;
+  Store32(&bad, kCountOffset, 0xFFFFFFFFu);
+  EXPECT_FALSE(AssetPack::Open(bad, &error).has_value());
+  EXPECT_EQ(error, "asset index is truncated");
+
+  EXPECT_FALSE(AssetPack::Open(std::string_view(), &error).has_value());
+  EXPECT_FALSE(AssetPack::Open("RAPK", &error).has_value());
+  EXPECT_EQ(error, "not an asset pack");
+}
+
+RUNNER_TEST(AssetPack, RejectsEveryTruncation) {
+  std::string bytes = BuildPack(SampleAssets());
+  for (size_t size = 0; size < bytes.size(); ++size) {
+    std::string truncated = bytes.substr(0, size);
+    if (AssetPack::Open(truncated, nullptr).has_value()) {
+      std::string message("Opened a pack truncated to ");
+      message.append(std::to_string(size)).append(" bytes");
+      ReportTestFailure(__FILE__, __LINE__, message);
+      return;
+    }
+  }
+}
+
+RUNNER_TEST(AssetPack, RejectsEntriesOutsideThePack) {
+  std::map<std::string, std::string> assets = SampleAssets();
+  std::string bytes = BuildPack(assets);
+  size_t count = assets.size();
+  std::string error;
+  // Data offset past the end, a size that wraps, and path and MIME type
+  // offsets past the end.
+  const size_t fields[] = {0, 8, 16, 24};
+  for (size_t field : fields) {
+    std::string bad = bytes;
+    if (field < 16) {
+      Store64(&bad, EntryOffset(count, 3) + field,
+              field == 0 ? bytes.size() + 1 : ~uint64_t{0});
+    } else {
+      Store32(&bad, EntryOffset(count, 3) + field,
+              static_cast<uint32_t>(bytes.size()));
+    }
+    EXPECT_FALSE(AssetPack::Open(bad, &error).has_value());
+    EXPECT_EQ(error, "asset entry points outside the pack");
+  }
+}
+
+RUNNER_TEST(AssetPack, RejectsInconsistentIndex) {
+  std::map<std::string, std::string> assets = SampleAssets();
+  std::string bytes = BuildPack(assets);
+  size_t count = assets.size();
+  std::string error;
+
+  // A hash that does not match its path.
+  std::string bad = bytes;
+  bad[kHashesOffset + 8 * 2] ^= 1;
+  EXPECT_FALSE(AssetPack::Open(bad, &error).has_value());
+  EXPECT_TRUE(error == "asset path does not match its hash" ||
+              error == "asset index is not sorted");
+
+  // The first two assets swapped, hashes and entries alike, so each entry
+  // is consistent but the index is out of order.
+  bad = bytes;
+  for (size_t i = 0; i < 8; ++i) {
+    std::swap(bad[kHashesOffset + i], bad[kHashesOffset + 8 + i]);
+  }
+  for (size_t i = 0; i < kEntrySize; ++i) {
+    std::swap(bad[EntryOffset(count, 0) + i], bad[EntryOffset(count, 1) + i]);
+  }
+  EXPECT_FALSE(AssetPack::Open(bad, &error).has_value());
+  EXPECT_EQ(error, "asset index is not sorted");
+}
+
+// Flips random bytes: the pack either fails to open or only ever returns
+// views within its bytes.
+RUNNER_TEST(AssetPack, CorruptPacksStayInBounds) {
+  std::map<std::string, std::string> assets = SampleAssets();
+  std::string bytes = BuildPack(assets);
+  std::mt19937 random(37);
+  size_t opened = 0;
+  for (int i = 0; i < 2000 && !CurrentTestFailed(); ++i) {
+    std::string bad = bytes;
+    int flips = 1 + static_cast<int>(random() % 4);
+    for (int flip = 0; flip < flips; ++flip) {
+      bad[random() % bad.size()] ^= static_cast<char>(1 + random() % 255);
+    }
+    std::optional<AssetPack> pack = AssetPack::Open(bad, nullptr);
+    if (!pack) {
+      continue;
+    }
+    ++opened;
+    for (const auto& [path, data] : assets) {
+      if (std::optional<Asset> asset = pack->Find(path)) {
+        EXPECT_TRUE(Within(asset->data, bad));
+        EXPECT_TRUE(Within(asset->mime_type, bad));
+      }
+    }
+  }
+  // Flips in the asset data leave the pack valid.
+  EXPECT_GT(opened, 0u);
+}
+
+RUNNER_TEST(AssetPack, MimeTypeForPath) {
+  EXPECT_EQ(MimeTypeForPath("index.html"), "text/html");
+  EXPECT_EQ(MimeTypeForPath("a/b/main.JS"), "text/javascript");
+  EXPECT_EQ(MimeTypeForPath("font.woff2"), "font/woff2");
+  EXPECT_EQ(MimeTypeForPath("README"), "application/octet-stream");
+  EXPECT_EQ(MimeTypeForPath("dir.css/file"), "application/octet-stream");
+  EXPECT_EQ(MimeTypeForPath("trailing."), "application/octet-stream");
+}
+
+RUNNER_TEST(AssetPack, AssetPathFromUrl) {
+  constexpr char kOrigin[] = "https://appassets.local";
+  std::string path;
+  EXPECT_TRUE(AssetPathFromUrl(u"https://appassets.local/a/b.js?v=1#x",
+                               kOrigin, &path));
+  EXPECT_EQ(path, "a/b.js");
+  EXPECT_TRUE(AssetPathFromUrl(u"HTTPS://AppAssets.Local/A.js", kOrigin,
+                               &path));
+  EXPECT_EQ(path, "A.js");
+  EXPECT_TRUE(AssetPathFromUrl(u"https://appassets.local", kOrigin, &path));
+  EXPECT_EQ(path, "index.html");
+  EXPECT_TRUE(AssetPathFromUrl(u"https://appassets.local/docs/?q", kOrigin,
+                               &path));
+  EXPECT_EQ(path, "docs/index.html");
+  EXPECT_TRUE(AssetPathFromUrl(u"https://appassets.local/a%20b%2Fc.txt",
+                               kOrigin, &path));
+  EXPECT_EQ(path, "a b/c.txt");
+  EXPECT_TRUE(AssetPathFromUrl(u"https://appassets.local/caf\u00E9/x",
+                               kOrigin, &path));
+  EXPECT_EQ(path, "caf\xC3\xA9/x");
+
+  EXPECT_FALSE(AssetPathFromUrl(u"https://appassets.localhost/a", kOrigin,
+                                &path));
+  EXPECT_FALSE(AssetPathFromUrl(u"https://appassets.local:8080/a", kOrigin,
+                                &path));
+  EXPECT_FALSE(AssetPathFromUrl(u"https://other.local/a", kOrigin, &path));
+  EXPECT_FALSE(AssetPathFromUrl(u"https://app", kOrigin, &path));
+  EXPECT_FALSE(AssetPathFromUrl(u"https://appassets.local/%2", kOrigin,
+                                &path));
+  EXPECT_FALSE(AssetPathFromUrl(u"https://appassets.local/%zz", kOrigin,
+                                &path));
+  // A lone surrogate cannot be converted.
+  EXPECT_FALSE(AssetPathFromUrl(u"https://appassets.local/\xD800", kOrigin,
+                                &path));
+}
+
+}  // namespace
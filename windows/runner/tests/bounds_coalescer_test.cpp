@@ -0,0 +1,117 @@
+#include "bounds_coalescer.h"
+
+#include <chrono>
+#include <optional>
+
+#include "test.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr IntRect kSmall{0, 0, 400, 300};
+constexpr IntRect kLarge{0, 0, 800, 600};
+constexpr IntRect kHuge{0, 0, 1600, 1200};
+
+RUNNER_TEST(BoundsCoalescer, FirstSubmissionIsApplied) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  EXPECT_FALSE(coalescer.Flush(now).has_value());
+  EXPECT_TRUE(coalescer.Submit(kSmall));
+  std::optional<IntRect> applied = coalescer.Flush(now);
+  ASSERT_TRUE(applied.has_value());
+  EXPECT_TRUE(*applied == kSmall);
+  EXPECT_FALSE(coalescer.has_pending());
+  EXPECT_EQ(coalescer.stats().applied, 1u);
+}
+
+RUNNER_TEST(BoundsCoalescer, DropsUnchangedBounds) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  coalescer.Submit(kSmall);
+  coalescer.Flush(now);
+  EXPECT_FALSE(coalescer.Submit(kSmall));
+  EXPECT_FALSE(coalescer.Flush(now).has_value());
+  EXPECT_EQ(coalescer.stats().unchanged, 1u);
+  EXPECT_EQ(coalescer.stats().applied, 1u);
+}
+
+RUNNER_TEST(BoundsCoalescer, BurstCollapsesToLatest) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  coalescer.Submit(kSmall);
+  coalescer.Submit(kLarge);
+  coalescer.Submit(kHuge);
+  std::optional<IntRect> applied = coalescer.Flush(now);
+  ASSERT_TRUE(applied.has_value());
+  EXPECT_TRUE(*applied == kHuge);
+  EXPECT_FALSE(coalescer.Flush(now).has_value());
+  const BoundsCoalescerStats& stats = coalescer.stats();
+  EXPECT_EQ(stats.received, 3u);
+  EXPECT_EQ(stats.merged, 2u);
+  EXPECT_EQ(stats.applied, 1u);
+}
+
+RUNNER_TEST(BoundsCoalescer, BurstEndingWhereItStartedAppliesNothing) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  coalescer.Submit(kSmall);
+  coalescer.Flush(now);
+  EXPECT_TRUE(coalescer.Submit(kLarge));
+  EXPECT_FALSE(coalescer.Submit(kSmall));
+  EXPECT_FALSE(coalescer.has_pending());
+  EXPECT_FALSE(coalescer.Flush(now).has_value());
+}
+
+RUNNER_TEST(BoundsCoalescer, RateLimitDefersApply) {
+  BoundsCoalescer coalescer(milliseconds(50));
+  BoundsCoalescer::Clock::time_point start;
+  coalescer.Submit(kSmall);
+  ASSERT_TRUE(coalescer.Flush(start).has_value());
+  coalescer.Submit(kLarge);
+  EXPECT_FALSE(coalescer.Flush(start + milliseconds(16)).has_value());
+  EXPECT_TRUE(coalescer.has_pending());
+  EXPECT_EQ(coalescer.stats().deferred, 1u);
+  std::optional<IntRect> applied = coalescer.Flush(start + milliseconds(50));
+  ASSERT_TRUE(applied.has_value());
+  EXPECT_TRUE(*applied == kLarge);
+}
+
+RUNNER_TEST(BoundsCoalescer, MarkAppliedDiscardsMatchingPending) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  coalescer.Submit(kLarge);
+  coalescer.MarkApplied(kLarge, now);
+  EXPECT_FALSE(coalescer.has_pending());
+  EXPECT_FALSE(coalescer.Submit(kLarge));
+
+  coalescer.Submit(kHuge);
+  coalescer.MarkApplied(kSmall, now);
+  // Different bounds stay pending.
+  std::optional<IntRect> applied = coalescer.Flush(now);
+  ASSERT_TRUE(applied.has_value());
+  EXPECT_TRUE(*applied == kHuge);
+}
+
+RUNNER_TEST(BoundsCoalescer, ResetForgetsAppliedBounds) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  coalescer.Submit(kSmall);
+  coalescer.Flush(now);
+  coalescer.Reset();
+  EXPECT_TRUE(coalescer.Submit(kSmall));
+  EXPECT_TRUE(coalescer.Flush(now).has_value());
+}
+
+RUNNER_TEST(BoundsCoalescer, ResetDropsPendingBounds) {
+  BoundsCoalescer coalescer;
+  BoundsCoalescer::Clock::time_point now;
+  coalescer.Submit(kSmall);
+  coalescer.Flush(now);
+  coalescer.Submit(kLarge);
+  coalescer.Reset();
+  EXPECT_FALSE(coalescer.has_pending());
+  EXPECT_FALSE(coalescer.Flush(now).has_value());
+}
+
+}  // namespace
@@ -0,0 +1,424 @@
+#include "controller_pool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+// A controller handle that is empty when zero.
+struct FakeController {
+  uint64_t id = 0;
+
+  explicit operator bool() const { return id != 0; }
+};
+
+// Creates controllers |latency| calls to |Pump| after they are requested,
+// standing in for the asynchronous WebView2 environment. A latency of zero
+// completes synchronously. Creations can be made to fail.
+class FakeControllerSource : public ControllerSource<FakeController> {
+ public:
+  explicit FakeControllerSource(uint64_t latency = 1) : latency_(latency) {}
+
+  // ControllerSource:
+  void CreateController(CreateCallback callback) override {
+    ++requested;
+    if (latency_ == 0) {
+      Finish(std::move(callback));
+      return;
+    }
+    pending_.push_back(Pending{tick_ + latency_, std::move(callback)});
+  }
+  void DestroyController(FakeController controller) override {
+    destroyed.push_back(controller.id);
+  }
+
+  // Advances time by one step and completes the creations that are due.
+  void Pump() {
+    ++tick_;
+    while (!pending_.empty() && pending_.front().ready_at <= tick_) {
+      CreateCallback callback = std::move(pending_.front().callback);
+      pending_.pop_front();
+      Finish(std::move(callback));
+    }
+  }
+
+  // Pumps until no creation is pending.
+  void Drain() {
+    while (!pending_.empty()) {
+      Pump();
+    }
+  }
+
+  size_t pending() const { return pending_.size(); }
+
+  // Creations that fail from now on, before any succeeds.
+  int failures = 0;
+  int requested = 0;
+  std::vector<uint64_t> destroyed;
+
+ private:
+  struct Pending {
+    uint64_t ready_at;
+    CreateCallback callback;
+  };
+
+  void Finish(CreateCallback callback) {
+    if (failures > 0) {
+      --failures;
+      callback(FakeController());
+      return;
+    }
+    callback(FakeController{next_id_++});
+  }
+
+  uint64_t latency_;
+  uint64_t tick_ = 0;
+  uint64_t next_id_ = 1;
+  std::deque<Pending> pending_;
+};
+
+using Pool = ControllerPool<FakeController>;
+
+Pool::Options Options(size_t idle_capacity, size_t warm_count) {
+  Pool::Options options;
+  options.idle_capacity = idle_capacity;
+  options.warm_count = warm_count;
+  return options;
+}
+
+// Claims from |pool|, storing the controller each claim receives in
+// |*received|, an empty one included.
+Pool::ClaimId ClaimInto(Pool* pool, std::vector<FakeController>* received) {
+  return pool->Claim([received](FakeController controller) {
+    received->push_back(controller);
+  });
+}
+
+RUNNER_TEST(ControllerPool, PrewarmFillsUpToWarmCount) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(4, 2));
+  pool.Prewarm();
+  EXPECT_EQ(source.requested, 2);
+  EXPECT_EQ(pool.pending_count(), 2u);
+  // Creations in flight count towards the warm count.
+  pool.Prewarm();
+  EXPECT_EQ(source.requested, 2);
+  source.Drain();
+  EXPECT_EQ(pool.idle_count(), 2u);
+  EXPECT_EQ(pool.pending_count(), 0u);
+  pool.Prewarm();
+  EXPECT_EQ(source.requested, 2);
+  EXPECT_EQ(pool.stats().created, 2u);
+}
+
+RUNNER_TEST(ControllerPool, WarmCountIsBoundedByIdleCapacity) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(1, 3));
+  pool.Prewarm();
+  EXPECT_EQ(source.requested, 1);
+}
+
+RUNNER_TEST(ControllerPool, CountsHitsAndMisses) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(2, 1));
+  pool.Prewarm();
+  source.Drain();
+  std::vector<FakeController> received;
+
+  // The warm controller is handed out at once, and another is started.
+  ClaimInto(&pool, &received);
+  ASSERT_EQ(received.size(), 1u);
+  EXPECT_EQ(received[0].id, 1u);
+  EXPECT_EQ(pool.stats().hits, 1u);
+  EXPECT_EQ(source.requested, 2);
+
+  // The replacement is still in flight, so this claim waits for it.
+  ClaimInto(&pool, &received);
+  EXPECT_EQ(received.size(), 1u);
+  EXPECT_EQ(pool.stats().misses, 1u);
+  EXPECT_EQ(pool.waiting_count(), 1u);
+  EXPECT_EQ(source.requested, 2);
+  source.Pump();
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[1].id, 2u);
+  EXPECT_EQ(pool.stats().claims_satisfied, 2u);
+
+  // A second waiting claim needs a creation of its own.
+  ClaimInto(&pool, &received);
+  ClaimInto(&pool, &received);
+  EXPECT_EQ(pool.stats().misses, 3u);
+  source.Drain();
+  EXPECT_EQ(received.size(), 4u);
+  EXPECT_EQ(pool.waiting_count(), 0u);
+}
+
+RUNNER_TEST(ControllerPool, CancelledClaimIsNotCalled) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(2, 0));
+  std::vector<FakeController> first;
+  std::vector<FakeController> second;
+  Pool::ClaimId cancelled = ClaimInto(&pool, &first);
+  ClaimInto(&pool, &second);
+  EXPECT_TRUE(pool.CancelClaim(cancelled));
+  EXPECT_FALSE(pool.CancelClaim(cancelled));
+  EXPECT_EQ(pool.stats().cancelled, 1u);
+  source.Drain();
+  EXPECT_TRUE(first.empty());
+  ASSERT_EQ(second.size(), 1u);
+  // The controller created for the cancelled claim is kept idle.
+  EXPECT_EQ(pool.idle_count(), 1u);
+  EXPECT_FALSE(pool.CancelClaim(12345));
+}
+
+RUNNER_TEST(ControllerPool, ReturnHandsOffToTheOldestWaiter) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(2, 0));
+  std::vector<FakeController> first;
+  std::vector<FakeController> second;
+  std::vector<FakeController> third;
+  ClaimInto(&pool, &first);
+  ClaimInto(&pool, &second);
+  ClaimInto(&pool, &third);
+  pool.Return(FakeController{100});
+  ASSERT_EQ(first.size(), 1u);
+  EXPECT_EQ(first[0].id, 100u);
+  EXPECT_TRUE(second.empty());
+  pool.Return(FakeController{101});
+  ASSERT_EQ(second.size(), 1u);
+  EXPECT_EQ(second[0].id, 101u);
+  EXPECT_TRUE(third.empty());
+  // The creations started for the first claims go to the remaining
+  // waiter, then to the idle list.
+  source.Drain();
+  ASSERT_EQ(third.size(), 1u);
+  EXPECT_EQ(third[0].id, 1u);
+  EXPECT_EQ(pool.idle_count(), 2u);
+  // Empty controllers are not taken back.
+  pool.Return(FakeController());
+  EXPECT_EQ(pool.idle_count(), 2u);
+}
+
+RUNNER_TEST(ControllerPool, FailedCreationFailsOneWaiter) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(2, 0));
+  std::vector<FakeController> received;
+  ClaimInto(&pool, &received);
+  ClaimInto(&pool, &received);
+  ASSERT_EQ(source.pending(), 2u);
+  source.failures = 1;
+  source.Pump();
+  ASSERT_EQ(received.size(), 2u);
+  // The first creation failed the oldest waiter; the second succeeded.
+  EXPECT_FALSE(received[0]);
+  EXPECT_TRUE(received[1]);
+  EXPECT_EQ(pool.stats().creation_failures, 1u);
+  EXPECT_EQ(pool.stats().created, 1u);
+  EXPECT_EQ(pool.waiting_count(), 0u);
+}
+
+RUNNER_TEST(ControllerPool, FailedCreationSparesCoveredWaiters) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(2, 1));
+  pool.Prewarm();
+  std::vector<FakeController> received;
+  // Both claims wait: one on the warm creation, one on its own.
+  ClaimInto(&pool, &received);
+  ClaimInto(&pool, &received);
+  EXPECT_EQ(source.requested, 2);
+  source.failures = 1;
+  source.Pump();
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_FALSE(received[0]);
+  EXPECT_TRUE(received[1]);
+}
+
+RUNNER_TEST(ControllerPool, SynchronousFailureDoesNotSpin) {
+  FakeControllerSource source(0);
+  source.failures = 1000;
+  Pool pool(&source, Options(4, 3));
+  pool.Prewarm();
+  EXPECT_EQ(source.requested, 3);
+  std::vector<FakeController> received;
+  ClaimInto(&pool, &received);
+  ASSERT_EQ(received.size(), 1u);
+  EXPECT_FALSE(received[0]);
+}
+
+RUNNER_TEST(ControllerPool, ReturnsBeyondCapacityAreDisposedOf) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(2, 0));
+  pool.Return(FakeController{10});
+  pool.Return(FakeController{11});
+  EXPECT_TRUE(source.destroyed.empty());
+  pool.Return(FakeController{12});
+  EXPECT_EQ(pool.idle_count(), 2u);
+  EXPECT_TRUE(source.destroyed == std::vector<uint64_t>{12});
+  EXPECT_EQ(pool.stats().destroyed, 1u);
+
+  // The most recently returned controller is handed out first.
+  std::vector<FakeController> received;
+  ClaimInto(&pool, &received);
+  ASSERT_EQ(received.size(), 1u);
+  EXPECT_EQ(received[0].id, 11u);
+
+  pool.Clear();
+  EXPECT_EQ(pool.idle_count(), 0u);
+  EXPECT_TRUE(source.destroyed == (std::vector<uint64_t>{12, 10}));
+}
+
+Pool::Options EvictingOptions() {
+  Pool::Options options = Options(4, 1);
+  options.max_idle_time = milliseconds(1000);
+  return options;
+}
+
+// Returns |id| to |pool| and the times just before and after, between
+// which the pool stamps it idle. Sleeps first, so that controllers
+// returned one after the other have distinct times.
+std::pair<Pool::Clock::time_point, Pool::Clock::time_point> TimedReturn(
+    Pool* pool,
+    uint64_t id) {
+  std::this_thread::sleep_for(milliseconds(2));
+  Pool::Clock::time_point before = Pool::Clock::now();
+  pool->Return(FakeController{id});
+  return {before, Pool::Clock::now()};
+}
+
+// Checks that |pool| next evicts the controller returned during |window|.
+void ExpectNextEviction(
+    const Pool& pool,
+    std::pair<Pool::Clock::time_point, Pool::Clock::time_point> window) {
+  std::optional<Pool::Clock::time_point> next = pool.NextEvictionTime();
+  ASSERT_TRUE(next.has_value());
+  EXPECT_TRUE(*next >= window.first + milliseconds(1000));
+  EXPECT_TRUE(*next <= window.second + milliseconds(1000));
+}
+
+RUNNER_TEST(ControllerPool, EvictsControllersIdleTooLong) {
+  FakeControllerSource source;
+  Pool pool(&source, EvictingOptions());
+  TimedReturn(&pool, 10);
+  TimedReturn(&pool, 11);
+  auto last = TimedReturn(&pool, 12);
+  // Not idle long enough yet.
+  EXPECT_EQ(pool.EvictIdle(last.second), 0u);
+  EXPECT_TRUE(source.destroyed.empty());
+  // The oldest go first, and |warm_count| stay however long they idle.
+  EXPECT_EQ(pool.EvictIdle(last.second + milliseconds(1000)), 2u);
+  EXPECT_TRUE(source.destroyed == (std::vector<uint64_t>{10, 11}));
+  EXPECT_EQ(pool.idle_count(), 1u);
+  EXPECT_EQ(pool.stats().evicted, 2u);
+  EXPECT_EQ(pool.stats().destroyed, 2u);
+  EXPECT_FALSE(pool.NextEvictionTime().has_value());
+  EXPECT_EQ(pool.EvictIdle(last.second + milliseconds(60000)), 0u);
+  EXPECT_EQ(pool.idle_count(), 1u);
+}
+
+RUNNER_TEST(ControllerPool, EvictsOnlyThoseDue) {
+  FakeControllerSource source;
+  Pool pool(&source, EvictingOptions());
+  auto first = TimedReturn(&pool, 10);
+  std::this_thread::sleep_for(milliseconds(20));
+  TimedReturn(&pool, 11);
+  TimedReturn(&pool, 12);
+  // Only the first has been idle for the whole timeout by then.
+  EXPECT_EQ(pool.EvictIdle(first.second + milliseconds(1000)), 1u);
+  EXPECT_TRUE(source.destroyed == std::vector<uint64_t>{10});
+}
+
+RUNNER_TEST(ControllerPool, ZeroIdleTimeKeepsControllers) {
+  FakeControllerSource source;
+  Pool pool(&source, Options(4, 1));
+  for (uint64_t id = 10; id < 14; ++id) {
+    pool.Return(FakeController{id});
+  }
+  EXPECT_FALSE(pool.NextEvictionTime().has_value());
+  EXPECT_EQ(pool.EvictIdle(Pool::Clock::now() + std::chrono::hours(24)), 0u);
+  EXPECT_EQ(pool.idle_count(), 4u);
+}
+
+RUNNER_TEST(ControllerPool, NextEvictionTimeFollowsReturnsAndClaims) {
+  FakeControllerSource source;
+  Pool pool(&source, EvictingOptions());
+  std::vector<FakeController> received;
+  // Within |warm_count| nothing is eligible.
+  auto first = TimedReturn(&pool, 10);
+  EXPECT_FALSE(pool.NextEvictionTime().has_value());
+  TimedReturn(&pool, 11);
+  ExpectNextEviction(pool, first);
+  auto third = TimedReturn(&pool, 12);
+  ExpectNextEviction(pool, first);
+
+  // Claims take the newest, so the oldest stays next.
+  ClaimInto(&pool, &received);
+  ExpectNextEviction(pool, first);
+  ClaimInto(&pool, &received);
+  EXPECT_FALSE(pool.NextEvictionTime().has_value());
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[0].id, 12u);
+  EXPECT_EQ(received[1].id, 11u);
+
+  TimedReturn(&pool, 12);
+  ExpectNextEviction(pool, first);
+  pool.EvictIdle(third.second + milliseconds(1000));
+  EXPECT_TRUE(source.destroyed == std::vector<uint64_t>{10});
+  EXPECT_FALSE(pool.NextEvictionTime().has_value());
+}
+
+RUNNER_TEST(ControllerPool, EvictionLeavesPendingClaimsAlone) {
+  FakeControllerSource source;
+  Pool pool(&source, EvictingOptions());
+  std::vector<FakeController> received;
+  ClaimInto(&pool, &received);
+  ClaimInto(&pool, &received);
+  EXPECT_EQ(pool.waiting_count(), 2u);
+  EXPECT_EQ(pool.EvictIdle(Pool::Clock::now() + std::chrono::hours(1)), 0u);
+  EXPECT_EQ(pool.waiting_count(), 2u);
+  EXPECT_TRUE(source.destroyed.empty());
+  source.Drain();
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_TRUE(received[0]);
+  EXPECT_TRUE(received[1]);
+  // Serving the claims started a warm replacement, which went idle first.
+  EXPECT_EQ(source.requested, 3);
+  EXPECT_EQ(pool.idle_count(), 1u);
+
+  // The warm replacement and the first controller returned are evicted,
+  // and the most recently returned one is kept for the next claim.
+  TimedReturn(&pool, received[0].id);
+  TimedReturn(&pool, received[1].id);
+  EXPECT_EQ(pool.EvictIdle(Pool::Clock::now() + milliseconds(1000)), 2u);
+  EXPECT_EQ(pool.idle_count(), 1u);
+  ASSERT_EQ(source.destroyed.size(), 2u);
+  EXPECT_NE(source.destroyed[0], received[0].id);
+  EXPECT_NE(source.destroyed[0], received[1].id);
+  EXPECT_EQ(source.destroyed[1], received[0].id);
+  size_t hits = pool.stats().hits;
+  ClaimInto(&pool, &received);
+  EXPECT_EQ(pool.stats().hits, hits + 1);
+  ASSERT_EQ(received.size(), 3u);
+  EXPECT_EQ(received[2].id, received[1].id);
+}
+
+RUNNER_TEST(ControllerPool, LateCreationsAfterDestructionAreDropped) {
+  FakeControllerSource source;
+  std::vector<FakeController> received;
+  {
+    Pool pool(&source, Options(2, 1));
+    pool.Prewarm();
+    ClaimInto(&pool, &received);
+  }
+  source.Drain();
+  EXPECT_TRUE(received.empty());
+}
+
+}  // namespace
@@ -0,0 +1,402 @@
+#include "coroutine.h"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "portable_run_loop.h"
+#include "test.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+// A fake asynchronous operation whose completions the test delivers, in
+// any order, the way WebView2 completions arrive from the run loop.
+class FakeAsyncSource {
+ public:
+  using Callback = std::function<void(int result)>;
+
+  // Queues an operation on |input|.
+  void Start(int input, Callback callback) {
+    ++started;
+    pending_.push_back(Operation{input, std::move(callback)});
+  }
+
+  // Completes the |index|th pending operation with its input plus one.
+  void Complete(size_t index = 0) {
+    Operation operation = std::move(pending_[index]);
+    pending_.erase(pending_.begin() + static_cast<ptrdiff_t>(index));
+    operation.callback(operation.input + 1);
+  }
+
+  // Drops every pending operation without completing it.
+  void Drop() { pending_.clear(); }
+
+  size_t pending() const { return pending_.size(); }
+
+  int started = 0;
+
+ private:
+  struct Operation {
+    int input;
+    Callback callback;
+  };
+
+  std::deque<Operation> pending_;
+};
+
+// Awaits one operation of |source| on |input|.
+auto Operate(FakeAsyncSource* source, int input) {
+  return Async<int>([source, input](Resolver<int> resolve) {
+    source->Start(input, [resolve](int value) { resolve(value); });
+  });
+}
+
+// Counts its destruction, to see when a frame's locals go away.
+struct Guard {
+  explicit Guard(int* destroyed) : destroyed(destroyed) {}
+  ~Guard() { ++*destroyed; }
+  int* destroyed;
+};
+
+Task<> Record(FakeAsyncSource* source,
+              int input,
+              std::string name,
+              std::vector<std::string>* log) {
+  log->push_back(name + " start");
+  std::optional<int> result = co_await Operate(source, input);
+  std::string entry = name;
+  entry.append(" got ").append(result ? std::to_string(*result) : "none");
+  log->push_back(entry);
+}
+
+RUNNER_TEST(Coroutine, SpawnRunsUntilTheFirstSuspension) {
+  FakeAsyncSource source;
+  std::vector<std::string> log;
+  Spawn(Record(&source, 1, "a", &log), TaskContext());
+  ASSERT_EQ(log.size(), 1u);
+  EXPECT_EQ(log[0], "a start");
+  EXPECT_EQ(source.pending(), 1u);
+  source.Complete();
+  ASSERT_EQ(log.size(), 2u);
+  EXPECT_EQ(log[1], "a got 2");
+}
+
+RUNNER_TEST(Coroutine, TasksResumeInCompletionOrder) {
+  FakeAsyncSource source;
+  std::vector<std::string> log;
+  Spawn(Record(&source, 10, "a", &log), TaskContext());
+  Spawn(Record(&source, 20, "b", &log), TaskContext());
+  Spawn(Record(&source, 30, "c", &log), TaskContext());
+  source.Complete(1);
+  source.Complete(1);
+  source.Complete(0);
+  const std::vector<std::string> expected = {
+      "a start", "b start", "c start", "b got 21", "c got 31", "a got 11"};
+  EXPECT_TRUE(log == expected);
+}
+
+Task<int> Step(FakeAsyncSource* source, int input, int* resumed) {
+  std::optional<int> result = co_await Operate(source, input);
+  ++*resumed;
+  co_return result.value_or(-1);
+}
+
+Task<> Sequence(FakeAsyncSource* source, int* resumed, int* out) {
+  int first = co_await Step(source, 0, resumed);
+  int second = co_await Step(source, first, resumed);
+  int third = co_await Step(source, second, resumed);
+  *out = first * 100 + second * 10 + third;
+}
+
+RUNNER_TEST(Coroutine, AwaitedTasksPassResultsBack) {
+  FakeAsyncSource source;
+  int resumed = 0;
+  int out = 0;
+  Spawn(Sequence(&source, &resumed, &out), TaskContext());
+  for (int step = 0; step < 3; ++step) {
+    // Each step starts only once the previous one finished.
+    EXPECT_EQ(source.pending(), 1u);
+    EXPECT_EQ(resumed, step);
+    source.Complete();
+  }
+  EXPECT_EQ(source.pending(), 0u);
+  EXPECT_EQ(out, 123);
+}
+
+Task<> ResolveImmediately(int* out) {
+  std::optional<int> result =
+      co_await Async<int>([](Resolver<int> resolve) { resolve(7); });
+  *out = result.value_or(-1);
+}
+
+RUNNER_TEST(Coroutine, ResolvingWhileStartingDoesNotSuspend) {
+  int out = 0;
+  Spawn(ResolveImmediately(&out), TaskContext());
+  EXPECT_EQ(out, 7);
+}
+
+RUNNER_TEST(Coroutine, OnlyTheFirstResolutionCounts) {
+  std::vector<Resolver<int>> resolvers;
+  std::optional<int> out;
+  bool finished = false;
+  auto task = [](std::vector<Resolver<int>>* resolvers,
+                 std::optional<int>* out, bool* finished) -> Task<> {
+    *out = co_await Async<int>([resolvers](Resolver<int> resolve) {
+      resolvers->push_back(resolve);
+      resolvers->push_back(resolve);
+    });
+    *finished = true;
+  };
+  Spawn(task(&resolvers, &out, &finished), TaskContext());
+  ASSERT_EQ(resolvers.size(), 2u);
+  resolvers[1](5);
+  EXPECT_TRUE(finished);
+  EXPECT_TRUE(out == std::optional<int>(5));
+  // The task is gone; later calls and the copies' release are ignored.
+  resolvers[0](6);
+  resolvers.clear();
+  EXPECT_TRUE(out == std::optional<int>(5));
+}
+
+Task<> AwaitWithGuard(FakeAsyncSource* source,
+                      int* destroyed,
+                      std::optional<int>* out) {
+  Guard guard(destroyed);
+  *out = co_await Operate(source, 1);
+}
+
+RUNNER_TEST(Coroutine, DroppedOperationsResumeEmptyAndFreeTheFrame) {
+  FakeAsyncSource source;
+  int destroyed = 0;
+  std::optional<int> out = 42;
+  Spawn(AwaitWithGuard(&source, &destroyed, &out), TaskContext());
+  EXPECT_EQ(destroyed, 0);
+  // Destroying the callback, and with it the last resolver, stands for a
+  // completion that never comes.
+  source.Drop();
+  EXPECT_FALSE(out.has_value());
+  EXPECT_EQ(destroyed, 1);
+}
+
+RUNNER_TEST(Coroutine, UnstartedTaskIsDestroyedWithoutRunning) {
+  FakeAsyncSource source;
+  int destroyed = 0;
+  std::optional<int> out;
+  {
+    Task<> task = AwaitWithGuard(&source, &destroyed, &out);
+    Task<> moved = std::move(task);
+  }
+  // The body never ran, so the guard was never constructed.
+  EXPECT_EQ(destroyed, 0);
+  EXPECT_EQ(source.started, 0);
+}
+
+RUNNER_TEST(Coroutine, CancellingResumesAwaitingTasksInOrder) {
+  FakeAsyncSource source;
+  CancellationSource cancellation;
+  TaskContext context{nullptr, cancellation.token()};
+  std::vector<std::string> log;
+  Spawn(Record(&source, 1, "a", &log), context);
+  Spawn(Record(&source, 2, "b", &log), context);
+  Spawn(Record(&source, 3, "c", &log), context);
+  source.Complete(1);
+  cancellation.Cancel();
+  const std::vector<std::string> expected = {
+      "a start", "b start", "c start", "b got 3", "a got none", "c got none"};
+  EXPECT_TRUE(log == expected);
+  // Completions arriving afterwards are ignored.
+  source.Complete();
+  source.Complete();
+  EXPECT_EQ(log.size(), expected.size());
+}
+
+Task<> AwaitTwice(FakeAsyncSource* source, std::vector<std::string>* log) {
+  std::optional<int> first = co_await Operate(source, 1);
+  log->push_back(first ? "first" : "first cancelled");
+  std::optional<int> second = co_await Operate(source, 2);
+  log->push_back(second ? "second" : "second cancelled");
+}
+
+RUNNER_TEST(Coroutine, CancelledTasksDoNotStartOperations) {
+  FakeAsyncSource source;
+  CancellationSource cancellation;
+  std::vector<std::string> log;
+  Spawn(AwaitTwice(&source, &log), TaskContext{nullptr, cancellation.token()});
+  cancellation.Cancel();
+  EXPECT_EQ(source.started, 1);
+  const std::vector<std::string> expected = {"first cancelled",
+                                             "second cancelled"};
+  EXPECT_TRUE(log == expected);
+
+  // A task spawned already cancelled starts nothing at all.
+  log.clear();
+  Spawn(AwaitTwice(&source, &log), TaskContext{nullptr, cancellation.token()});
+  EXPECT_EQ(source.started, 1);
+  EXPECT_TRUE(log == expected);
+}
+
+RUNNER_TEST(Coroutine, AwaitedTasksInheritTheToken) {
+  FakeAsyncSource source;
+  CancellationSource cancellation;
+  int resumed = 0;
+  int out = 0;
+  Spawn(Sequence(&source, &resumed, &out),
+        TaskContext{nullptr, cancellation.token()});
+  source.Complete();
+  // The second step, inside a nested task, is cancelled, and the third
+  // does not start.
+  cancellation.Cancel();
+  EXPECT_EQ(resumed, 3);
+  EXPECT_EQ(source.started, 2);
+  EXPECT_EQ(out, 100 - 10 - 1);
+}
+
+RUNNER_TEST(Coroutine, CancellationTokenCallbacks) {
+  CancellationSource source;
+  CancellationToken token = source.token();
+  std::string order;
+  CancellationRegistration first = token.OnCancel([&order] { order += "1"; });
+  CancellationRegistration second =
+      token.OnCancel([&order] { order += "2"; });
+  CancellationRegistration third = token.OnCancel([&order] { order += "3"; });
+  second.Reset();
+  EXPECT_FALSE(token.cancelled());
+  source.Cancel();
+  EXPECT_TRUE(token.cancelled());
+  EXPECT_TRUE(source.cancelled());
+  EXPECT_EQ(order, "13");
+  source.Cancel();
+  EXPECT_EQ(order, "13");
+  // Registering after cancellation runs the callback at once.
+  CancellationRegistration late = token.OnCancel([&order] { order += "4"; });
+  EXPECT_EQ(order, "134");
+  // A default token is never cancelled and never calls back.
+  CancellationToken never;
+  CancellationRegistration ignored = never.OnCancel([&order] { order += "5"; });
+  EXPECT_FALSE(never.cancelled());
+  EXPECT_EQ(order, "134");
+}
+
+RUNNER_TEST(Coroutine, CallbackMayUnregisterLaterOnes) {
+  CancellationSource source;
+  CancellationToken token = source.token();
+  std::string order;
+  CancellationRegistration second;
+  CancellationRegistration first = token.OnCancel([&] {
+    order += "1";
+    second.Reset();
+  });
+  second = token.OnCancel([&order] { order += "2"; });
+  CancellationRegistration third = token.OnCancel([&order] { order += "3"; });
+  source.Cancel();
+  EXPECT_EQ(order, "13");
+}
+
+RUNNER_TEST(Coroutine, RegistrationOutlivingTheSourceIsHarmless) {
+  CancellationRegistration registration;
+  {
+    CancellationSource source;
+    registration = source.token().OnCancel([] {});
+  }
+  registration.Reset();
+  registration.Reset();
+}
+
+Task<> YieldAndLog(const char* name, int count, std::string* log) {
+  for (int i = 0; i < count; ++i) {
+    std::optional<bool> yielded = co_await Yield();
+    if (!yielded) {
+      log->append(name).append("x ");
+      co_return;
+    }
+    log->append(name).append(std::to_string(i)).append(" ");
+  }
+}
+
+RUNNER_TEST(Coroutine, YieldInterleavesWithTheRunLoop) {
+  PortableRunLoop loop;
+  TaskContext context{&loop.scheduler(), CancellationToken()};
+  std::string log;
+  Spawn(YieldAndLog("a", 3, &log), context);
+  Spawn(YieldAndLog("b", 2, &log), context);
+  loop.scheduler().PostTask([&log] { log += "task "; });
+  EXPECT_EQ(log, "");
+  loop.RunUntilIdle();
+  EXPECT_EQ(log, "a0 b0 task a1 b1 a2 ");
+}
+
+RUNNER_TEST(Coroutine, CancellingAYieldingTask) {
+  PortableRunLoop loop;
+  CancellationSource cancellation;
+  TaskContext context{&loop.scheduler(), cancellation.token()};
+  std::string log;
+  Spawn(YieldAndLog("a", 3, &log), context);
+  loop.scheduler().PostTask([&cancellation] { cancellation.Cancel(); });
+  loop.RunUntilIdle();
+  EXPECT_EQ(log, "a0 ax ");
+}
+
+Task<> DelayThenQuit(PortableRunLoop* loop,
+                     TaskScheduler::Clock::duration delay,
+                     std::optional<bool>* out,
+                     TaskScheduler::Clock::time_point* resumed_at) {
+  *out = co_await Delay(delay);
+  *resumed_at = TaskScheduler::Clock::now();
+  loop->Quit();
+}
+
+RUNNER_TEST(Coroutine, DelayResumesAfterTheDelay) {
+  PortableRunLoop loop;
+  TaskContext context{&loop.scheduler(), CancellationToken()};
+  std::optional<bool> out;
+  TaskScheduler::Clock::time_point resumed_at;
+  TaskScheduler::Clock::time_point start = TaskScheduler::Clock::now();
+  Spawn(DelayThenQuit(&loop, milliseconds(20), &out, &resumed_at), context);
+  loop.Run();
+  EXPECT_TRUE(out == std::optional<bool>(true));
+  EXPECT_GE(resumed_at - start, milliseconds(20));
+}
+
+RUNNER_TEST(Coroutine, CancellingADelayResumesAtOnce) {
+  PortableRunLoop loop;
+  CancellationSource cancellation;
+  TaskContext context{&loop.scheduler(), cancellation.token()};
+  std::optional<bool> out = false;
+  TaskScheduler::Clock::time_point resumed_at;
+  TaskScheduler::Clock::time_point start = TaskScheduler::Clock::now();
+  Spawn(DelayThenQuit(&loop, std::chrono::hours(1), &out, &resumed_at),
+        context);
+  loop.scheduler().PostTask([&cancellation] { cancellation.Cancel(); });
+  loop.Run();
+  EXPECT_FALSE(out.has_value());
+  EXPECT_LT(resumed_at - start, std::chrono::minutes(1));
+}
+
+RUNNER_TEST(Coroutine, FramesAreRecycled) {
+  FakeAsyncSource source;
+  std::vector<std::string> log;
+  // Warm the pool up.
+  for (int i = 0; i < 4; ++i) {
+    Spawn(Record(&source, i, "warm", &log), TaskContext());
+    source.Complete();
+  }
+  CoroutineFramePoolStats before = GetCoroutineFramePoolStats();
+  for (int i = 0; i < 100; ++i) {
+    Spawn(Record(&source, i, "task", &log), TaskContext());
+    source.Complete();
+  }
+  CoroutineFramePoolStats after = GetCoroutineFramePoolStats();
+  uint64_t allocations = after.allocations - before.allocations;
+  // One frame and one operation slot per task, all from the free lists.
+  EXPECT_EQ(allocations, 200u);
+  EXPECT_EQ(after.reused - before.reused, allocations);
+  EXPECT_EQ(after.oversized, before.oversized);
+}
+
+}  // namespace
@@ -0,0 +1,331 @@
+#include "focus_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "task_scheduler.h"
+#include "test.h"
+
+namespace {
+
+// A far-off deadline, for runs that should not be cut short.
+TaskScheduler::Clock::time_point Later() {
+  return TaskScheduler::Clock::now() + std::chrono::hours(1);
+}
+
+IntRect At(int32_t left, int32_t top) {
+  return IntRect{left, top, left + 100, top + 30};
+}
+
+// Walks the whole order forwards from the first node, without wrapping.
+std::vector<FocusNodeId> Forward(const FocusGraph& graph) {
+  std::vector<FocusNodeId> order;
+  for (FocusNodeId node = graph.Next(kNoFocusNode, false);
+       node != kNoFocusNode && order.size() <= graph.size();
+       node = graph.Next(node, false)) {
+    order.push_back(node);
+  }
+  return order;
+}
+
+// The same backwards from the last node, returned in forward order.
+std::vector<FocusNodeId> Backward(const FocusGraph& graph) {
+  std::vector<FocusNodeId> order;
+  for (FocusNodeId node = graph.Previous(kNoFocusNode, false);
+       node != kNoFocusNode && order.size() <= graph.size();
+       node = graph.Previous(node, false)) {
+    order.push_back(node);
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+bool Equal(const std::vector<FocusNodeId>& a,
+           const std::vector<FocusNodeId>& b) {
+  return a == b;
+}
+
+RUNNER_TEST(FocusGraph, EmptyGraphHasNoNodes) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  EXPECT_EQ(graph.Next(kNoFocusNode), kNoFocusNode);
+  EXPECT_EQ(graph.Previous(kNoFocusNode), kNoFocusNode);
+  EXPECT_EQ(graph.Next(5), kNoFocusNode);
+  EXPECT_EQ(graph.size(), 0u);
+}
+
+RUNNER_TEST(FocusGraph, OrdersByReadingOrder) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  // Added out of order: two rows of two.
+  EXPECT_TRUE(graph.AddNode(4, At(200, 100)));
+  EXPECT_TRUE(graph.AddNode(1, At(0, 0)));
+  EXPECT_TRUE(graph.AddNode(3, At(0, 100)));
+  EXPECT_TRUE(graph.AddNode(2, At(200, 0)));
+  EXPECT_TRUE(Equal(Forward(graph), {1, 2, 3, 4}));
+  EXPECT_TRUE(Equal(Backward(graph), {1, 2, 3, 4}));
+}
+
+RUNNER_TEST(FocusGraph, LowerGroupsComeFirst) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  graph.AddNode(1, At(0, 0), 1);
+  graph.AddNode(2, At(0, 500), 0);
+  graph.AddNode(3, At(500, 0), 1);
+  graph.AddNode(4, At(0, 0), -1);
+  EXPECT_TRUE(Equal(Forward(graph), {4, 2, 1, 3}));
+}
+
+RUNNER_TEST(FocusGraph, TiesAreBrokenById) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  graph.AddNode(9, At(0, 0));
+  graph.AddNode(3, At(0, 0));
+  graph.AddNode(6, At(0, 0));
+  EXPECT_TRUE(Equal(Forward(graph), {3, 6, 9}));
+  EXPECT_EQ(graph.Next(3), 6u);
+  EXPECT_EQ(graph.Previous(9), 6u);
+}
+
+RUNNER_TEST(FocusGraph, WrapsAtTheEndsOnlyWhenAsked) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  graph.AddNode(1, At(0, 0));
+  graph.AddNode(2, At(0, 100));
+  graph.AddNode(3, At(0, 200));
+  EXPECT_EQ(graph.Next(3), 1u);
+  EXPECT_EQ(graph.Next(3, false), kNoFocusNode);
+  EXPECT_EQ(graph.Previous(1), 3u);
+  EXPECT_EQ(graph.Previous(1, false), kNoFocusNode);
+  EXPECT_EQ(graph.Next(1, false), 2u);
+  EXPECT_EQ(graph.Previous(3, false), 2u);
+}
+
+RUNNER_TEST(FocusGraph, SingleNodeDoesNotWrapToItself) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  graph.AddNode(1, At(0, 0));
+  EXPECT_EQ(graph.Next(kNoFocusNode), 1u);
+  EXPECT_EQ(graph.Previous(kNoFocusNode), 1u);
+  EXPECT_EQ(graph.Next(1), kNoFocusNode);
+  EXPECT_EQ(graph.Previous(1), kNoFocusNode);
+}
+
+RUNNER_TEST(FocusGraph, UnknownNodeStartsAtTheEnds) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  graph.AddNode(1, At(0, 0));
+  graph.AddNode(2, At(0, 100));
+  EXPECT_EQ(graph.Next(42), 1u);
+  EXPECT_EQ(graph.Previous(42), 2u);
+}
+
+RUNNER_TEST(FocusGraph, RejectsInvalidAndDuplicateNodes) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  EXPECT_FALSE(graph.AddNode(kNoFocusNode, At(0, 0)));
+  EXPECT_TRUE(graph.AddNode(1, At(0, 0)));
+  EXPECT_FALSE(graph.AddNode(1, At(0, 100)));
+  EXPECT_EQ(graph.size(), 1u);
+  EXPECT_FALSE(graph.MoveNode(2, At(0, 0)));
+  EXPECT_FALSE(graph.RemoveNode(2));
+  EXPECT_TRUE(graph.RemoveNode(1));
+  EXPECT_FALSE(graph.RemoveNode(1));
+  EXPECT_FALSE(graph.Contains(1));
+}
+
+RUNNER_TEST(FocusGraph, MoveNodeReordersAndKeepsItsGroup) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  graph.AddNode(1, At(0, 0));
+  graph.AddNode(2, At(0, 100));
+  graph.AddNode(3, At(0, 200));
+  graph.AddNode(4, At(0, 0), 1);
+  EXPECT_TRUE(graph.MoveNode(1, At(0, 150)));
+  EXPECT_TRUE(Equal(Forward(graph), {2, 1, 3, 4}));
+  // Moving within the same top edge reorders by left edge.
+  EXPECT_TRUE(graph.MoveNode(3, At(-10, 100)));
+  EXPECT_TRUE(Equal(Forward(graph), {3, 2, 1, 4}));
+  // Moving above everything in group 0 leaves node 4 after them.
+  EXPECT_TRUE(graph.MoveNode(4, At(0, -1000)));
+  EXPECT_TRUE(Equal(Forward(graph), {3, 2, 1, 4}));
+  // A size change alone keeps the order.
+  EXPECT_TRUE(graph.MoveNode(2, IntRect{0, 100, 5, 105}));
+  EXPECT_TRUE(Equal(Forward(graph), {3, 2, 1, 4}));
+}
+
+RUNNER_TEST(FocusGraph, RemovedNodeIsSkipped) {
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  graph.AddNode(1, At(0, 0));
+  graph.AddNode(2, At(0, 100));
+  graph.AddNode(3, At(0, 200));
+  graph.RemoveNode(2);
+  EXPECT_EQ(graph.Next(1), 3u);
+  EXPECT_EQ(graph.Previous(3), 1u);
+  EXPECT_TRUE(Equal(Forward(graph), {1, 3}));
+}
+
+// Checks traversal against a sorted copy of the nodes after random adds,
+// moves and removals.
+RUNNER_TEST(FocusGraph, MatchesSortedModel) {
+  struct ModelNode {
+    int32_t group;
+    int32_t top;
+    int32_t left;
+    FocusNodeId id;
+
+    bool operator<(const ModelNode& other) const {
+      return std::tie(group, top, left, id) <
+             std::tie(other.group, other.top, other.left, other.id);
+    }
+  };
+  TaskScheduler scheduler(nullptr);
+  FocusGraph graph(&scheduler, nullptr);
+  std::vector<ModelNode> model;
+  std::mt19937 random(11);
+  for (int step = 0; step < 2000 && !CurrentTestFailed(); ++step) {
+    FocusNodeId id = 1 + random() % 40;
+    auto it = std::find_if(model.begin(), model.end(),
+                           [id](const ModelNode& n) { return n.id == id; });
+    // Coarse coordinates so that ties are common.
+    int32_t top = static_cast<int32_t>(random() % 5) * 50;
+    int32_t left = static_cast<int32_t>(random() % 5) * 50;
+    switch (random() % 3) {
+      case 0: {
+        int32_t group = static_cast<int32_t>(random() % 3);
+        bool added = graph.AddNode(id, At(left, top), group);
+        EXPECT_EQ(added, it == model.end());
+        if (added) {
+          model.push_back(ModelNode{group, top, left, id});
+        }
+        break;
+      }
+      case 1:
+        EXPECT_EQ(graph.MoveNode(id, At(left, top)), it != model.end());
+        if (it != model.end()) {
+          it->top = top;
+          it->left = left;
+        }
+        break;
+      case 2:
+        EXPECT_EQ(graph.RemoveNode(id), it != model.end());
+        if (it != model.end()) {
+          model.erase(it);
+        }
+        break;
+    }
+    std::vector<ModelNode> sorted = model;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<FocusNodeId> expected;
+    for (const ModelNode& node : sorted) {
+      expected.push_back(node.id);
+    }
+    EXPECT_EQ(graph.size(), expected.size());
+    EXPECT_TRUE(Equal(Forward(graph), expected));
+    EXPECT_TRUE(Equal(Backward(graph), expected));
+    if (expected.size() > 1) {
+      EXPECT_EQ(graph.Next(expected.back()), expected.front());
+      EXPECT_EQ(graph.Previous(expected.front()), expected.back());
+    }
+  }
+}
+
+RUNNER_TEST(FocusGraph, FocusChangesAreReportedFromATask) {
+  TaskScheduler scheduler(nullptr);
+  std::vector<std::pair<FocusNodeId, FocusNodeId>> changes;
+  FocusGraph graph(&scheduler,
+                   [&changes](FocusNodeId previous, FocusNodeId current) {
+                     changes.emplace_back(previous, current);
+                   });
+  graph.AddNode(1, At(0, 0));
+  graph.AddNode(2, At(0, 100));
+  graph.SetFocus(1);
+  EXPECT_EQ(graph.focused(), 1u);
+  EXPECT_EQ(changes.size(), 0u);
+  scheduler.RunUntil(Later());
+  ASSERT_EQ(changes.size(), 1u);
+  EXPECT_EQ(changes[0].first, kNoFocusNode);
+  EXPECT_EQ(changes[0].second, 1u);
+}
+
+RUNNER_TEST(FocusGraph, ChangesBeforeTheReportAreCoalesced) {
+  TaskScheduler scheduler(nullptr);
+  std::vector<std::pair<FocusNodeId, FocusNodeId>> changes;
+  FocusGraph graph(&scheduler,
+                   [&changes](FocusNodeId previous, FocusNodeId current) {
+                     changes.emplace_back(previous, current);
+                   });
+  graph.AddNode(1, At(0, 0));
+  graph.AddNode(2, At(0, 100));
+  graph.AddNode(3, At(0, 200));
+  graph.SetFocus(1);
+  scheduler.RunUntil(Later());
+  graph.SetFocus(2);
+  graph.SetFocus(3);
+  scheduler.RunUntil(Later());
+  ASSERT_EQ(changes.size(), 2u);
+  EXPECT_EQ(changes[1].first, 1u);
+  EXPECT_EQ(changes[1].second, 3u);
+
+  // Moving away and back before the report is no change at all.
+  graph.SetFocus(1);
+  graph.SetFocus(3);
+  scheduler.RunUntil(Later());
+  EXPECT_EQ(changes.size(), 2u);
+  EXPECT_EQ(scheduler.stats().tasks_run, 3u);
+}
+
+RUNNER_TEST(FocusGraph, UnknownNodeCannotTakeFocus) {
+  TaskScheduler scheduler(nullptr);
+  int reports = 0;
+  FocusGraph graph(&scheduler,
+                   [&reports](FocusNodeId, FocusNodeId) { ++reports; });
+  graph.AddNode(1, At(0, 0));
+  graph.SetFocus(1);
+  graph.SetFocus(7);
+  EXPECT_EQ(graph.focused(), 1u);
+  scheduler.RunUntil(Later());
+  EXPECT_EQ(reports, 1);
+}
+
+RUNNER_TEST(FocusGraph, RemovingTheFocusedNodeClearsFocus) {
+  TaskScheduler scheduler(nullptr);
+  std::vector<std::pair<FocusNodeId, FocusNodeId>> changes;
+  FocusGraph graph(&scheduler,
+                   [&changes](FocusNodeId previous, FocusNodeId current) {
+                     changes.emplace_back(previous, current);
+                   });
+  graph.AddNode(1, At(0, 0));
+  graph.AddNode(2, At(0, 100));
+  graph.SetFocus(2);
+  scheduler.RunUntil(Later());
+  graph.RemoveNode(1);
+  EXPECT_EQ(graph.focused(), 2u);
+  graph.RemoveNode(2);
+  EXPECT_EQ(graph.focused(), kNoFocusNode);
+  scheduler.RunUntil(Later());
+  ASSERT_EQ(changes.size(), 2u);
+  EXPECT_EQ(changes[1].first, 2u);
+  EXPECT_EQ(changes[1].second, kNoFocusNode);
+}
+
+RUNNER_TEST(FocusGraph, DestroyedGraphDropsItsReport) {
+  TaskScheduler scheduler(nullptr);
+  int reports = 0;
+  {
+    FocusGraph graph(&scheduler,
+                     [&reports](FocusNodeId, FocusNodeId) { ++reports; });
+    graph.AddNode(1, At(0, 0));
+    graph.SetFocus(1);
+  }
+  scheduler.RunUntil(Later());
+  EXPECT_EQ(reports, 0);
+}
+
+}  // namespace
@@ -0,0 +1,195 @@
+#include "geometry_transaction.h"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+using TimePoint = GeometryTransaction::Clock::time_point;
+
+std::vector<GeometryViewId> ViewsOf(
+    const std::vector<GeometryChange>& changes) {
+  std::vector<GeometryViewId> views;
+  for (const GeometryChange& change : changes) {
+    views.push_back(change.view);
+  }
+  return views;
+}
+
+RUNNER_TEST(GeometryTransaction, ReportsWhenACommitIsNeeded) {
+  GeometryTransaction transaction;
+  TimePoint now;
+  EXPECT_FALSE(transaction.has_pending());
+  EXPECT_FALSE(transaction.pending_since().has_value());
+  EXPECT_TRUE(transaction.SetBounds(1, IntRect{0, 0, 10, 10}, now));
+  EXPECT_FALSE(transaction.SetVisible(2, true, now + milliseconds(1)));
+  EXPECT_FALSE(transaction.SetInsertAfter(1, 7, now + milliseconds(2)));
+  EXPECT_TRUE(transaction.has_pending(1));
+  EXPECT_TRUE(transaction.has_pending(2));
+  EXPECT_FALSE(transaction.has_pending(3));
+  EXPECT_TRUE(transaction.pending_since() == now);
+
+  EXPECT_EQ(transaction.Commit(now, true).size(), 2u);
+  EXPECT_FALSE(transaction.has_pending());
+  // The next change starts a new transaction.
+  EXPECT_TRUE(transaction.SetVisible(1, false, now));
+  // Committing nothing is not counted.
+  transaction.Commit(now, true);
+  EXPECT_TRUE(transaction.Commit(now, true).empty());
+  EXPECT_EQ(transaction.stats().commits, 2u);
+}
+
+RUNNER_TEST(GeometryTransaction, RepeatedChangesMergeIntoTheLastValue) {
+  GeometryTransaction transaction;
+  TimePoint now;
+  transaction.SetBounds(1, IntRect{0, 0, 10, 10}, now);
+  transaction.SetBounds(1, IntRect{5, 5, 20, 20}, now);
+  transaction.SetBounds(1, IntRect{8, 8, 30, 40}, now);
+  transaction.SetVisible(1, false, now);
+  transaction.SetVisible(1, true, now);
+  transaction.SetInsertAfter(1, 3, now);
+  transaction.SetInsertAfter(1, 4, now);
+  transaction.SetBounds(2, IntRect{1, 1, 2, 2}, now);
+
+  std::vector<GeometryChange> changes = transaction.Commit(now, true);
+  ASSERT_EQ(changes.size(), 2u);
+  // View 2 only moved, so it goes before view 1, which is being shown.
+  EXPECT_EQ(changes[0].view, 2u);
+  EXPECT_FALSE(changes[0].visible.has_value());
+  EXPECT_FALSE(changes[0].insert_after.has_value());
+  const GeometryChange& change = changes[1];
+  EXPECT_EQ(change.view, 1u);
+  ASSERT_TRUE(change.bounds.has_value());
+  EXPECT_TRUE(*change.bounds == (IntRect{8, 8, 30, 40}));
+  EXPECT_TRUE(change.visible == std::optional<bool>(true));
+  EXPECT_TRUE(change.insert_after == std::optional<uint64_t>(4));
+
+  const GeometryTransactionStats& stats = transaction.stats();
+  EXPECT_EQ(stats.changes, 8u);
+  EXPECT_EQ(stats.merged, 4u);
+  EXPECT_EQ(stats.views_committed, 2u);
+}
+
+RUNNER_TEST(GeometryTransaction, HidesBeforeMovesBeforeShows) {
+  GeometryTransaction transaction;
+  TimePoint now;
+  // First changed in the order 1 to 6.
+  transaction.SetVisible(1, true, now);
+  transaction.SetBounds(2, IntRect{0, 0, 1, 1}, now);
+  transaction.SetVisible(3, false, now);
+  transaction.SetInsertAfter(4, 9, now);
+  transaction.SetVisible(5, true, now);
+  transaction.SetBounds(6, IntRect{0, 0, 1, 1}, now);
+  transaction.SetVisible(6, false, now);
+  // A later change to view 1 does not move it within its group.
+  transaction.SetBounds(1, IntRect{0, 0, 2, 2}, now);
+
+  std::vector<GeometryChange> changes = transaction.Commit(now, true);
+  EXPECT_TRUE(ViewsOf(changes) ==
+              (std::vector<GeometryViewId>{3, 6, 2, 4, 1, 5}));
+}
+
+RUNNER_TEST(GeometryTransaction, KeepsZOrder) {
+  GeometryTransaction transaction;
+  TimePoint now;
+  // Restacking alone, and combined with a move, is passed through.
+  transaction.SetInsertAfter(1, 0, now);
+  transaction.SetInsertAfter(2, 0x1001, now);
+  transaction.SetBounds(2, IntRect{0, 0, 5, 5}, now);
+  std::vector<GeometryChange> changes = transaction.Commit(now, true);
+  ASSERT_EQ(changes.size(), 2u);
+  EXPECT_TRUE(changes[0].insert_after == std::optional<uint64_t>(0));
+  EXPECT_FALSE(changes[0].bounds.has_value());
+  EXPECT_TRUE(changes[1].insert_after == std::optional<uint64_t>(0x1001));
+  EXPECT_TRUE(changes[1].bounds.has_value());
+
+  // A commit without restacking leaves it unset.
+  transaction.SetBounds(1, IntRect{0, 0, 5, 5}, now);
+  changes = transaction.Commit(now, true);
+  ASSERT_EQ(changes.size(), 1u);
+  EXPECT_FALSE(changes[0].insert_after.has_value());
+}
+
+RUNNER_TEST(GeometryTransaction, RemoveViewDropsItsChanges) {
+  GeometryTransaction transaction;
+  TimePoint now;
+  transaction.SetBounds(1, IntRect{0, 0, 1, 1}, now);
+  transaction.SetVisible(2, false, now + milliseconds(5));
+  transaction.SetBounds(3, IntRect{0, 0, 1, 1}, now + milliseconds(9));
+  transaction.RemoveView(1);
+  transaction.RemoveView(4);
+  EXPECT_FALSE(transaction.has_pending(1));
+  EXPECT_TRUE(transaction.pending_since() == now + milliseconds(5));
+  std::vector<GeometryChange> changes = transaction.Commit(now, true);
+  EXPECT_TRUE(ViewsOf(changes) == (std::vector<GeometryViewId>{2, 3}));
+
+  // Removing the only pending view empties the transaction, so the next
+  // change asks for a commit again.
+  transaction.SetVisible(1, true, now);
+  transaction.RemoveView(1);
+  EXPECT_FALSE(transaction.has_pending());
+  EXPECT_TRUE(transaction.Commit(now, true).empty());
+  EXPECT_TRUE(transaction.SetVisible(1, true, now));
+  changes = transaction.Commit(now, true);
+  ASSERT_EQ(changes.size(), 1u);
+  // A re-added view starts from scratch.
+  EXPECT_FALSE(changes[0].bounds.has_value());
+}
+
+RUNNER_TEST(GeometryTransaction, CountsFrameLag) {
+  GeometryTransaction transaction;
+  TimePoint now;
+  // Laid out and presented in the same frame: a lag of one.
+  transaction.SetBounds(1, IntRect{0, 0, 1, 1}, now);
+  transaction.OnFramePresented();
+  transaction.Commit(now, true);
+  // Committed before any frame was presented.
+  transaction.SetBounds(1, IntRect{0, 0, 1, 1}, now);
+  transaction.SetBounds(2, IntRect{0, 0, 1, 1}, now);
+  transaction.Commit(now, false);
+  // Two, and five, frames late; a change in between does not reset it.
+  transaction.SetBounds(1, IntRect{0, 0, 1, 1}, now);
+  transaction.OnFramePresented();
+  transaction.SetBounds(2, IntRect{0, 0, 1, 1}, now);
+  transaction.SetBounds(1, IntRect{0, 0, 2, 2}, now);
+  transaction.OnFramePresented();
+  transaction.Commit(now, true);
+  transaction.SetBounds(3, IntRect{0, 0, 1, 1}, now);
+  for (int i = 0; i < 5; ++i) {
+    transaction.OnFramePresented();
+  }
+  transaction.Commit(now, true);
+
+  const GeometryTransactionStats& stats = transaction.stats();
+  EXPECT_EQ(transaction.frame(), 8u);
+  EXPECT_EQ(stats.frame_lag[0], 2u);
+  EXPECT_EQ(stats.frame_lag[1], 2u);
+  EXPECT_EQ(stats.frame_lag[2], 1u);
+  EXPECT_EQ(stats.frame_lag[3], 1u);
+  EXPECT_EQ(stats.commits, 4u);
+  EXPECT_EQ(stats.unpresented_commits, 1u);
+  EXPECT_EQ(stats.views_committed, 6u);
+}
+
+RUNNER_TEST(GeometryTransaction, TracksTheLongestCommitDelay) {
+  GeometryTransaction transaction;
+  TimePoint now;
+  transaction.SetBounds(1, IntRect{0, 0, 1, 1}, now);
+  transaction.SetBounds(2, IntRect{0, 0, 1, 1}, now + milliseconds(10));
+  // Only the first change of a view counts.
+  transaction.SetBounds(1, IntRect{0, 0, 2, 2}, now + milliseconds(30));
+  // A late commit, as after the presentation timeout.
+  transaction.Commit(now + milliseconds(50), false);
+  EXPECT_TRUE(transaction.stats().max_commit_delay == milliseconds(50));
+  transaction.SetBounds(1, IntRect{0, 0, 1, 1}, now + milliseconds(100));
+  transaction.Commit(now + milliseconds(120), true);
+  EXPECT_TRUE(transaction.stats().max_commit_delay == milliseconds(50));
+  EXPECT_EQ(transaction.stats().unpresented_commits, 1u);
+}
+
+}  // namespace
@@ -0,0 +1,269 @@
+#include "json.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "test.h"
+
+namespace {
+
+// Parses |json|, which must be a single string value, and returns it.
+std::string ParseString(JsonDocument* document, std::string_view json) {
+  std::string error;
+  if (!document->Parse(json, &error)) {
+    ReportTestFailure(__FILE__, __LINE__, error.c_str());
+    return std::string();
+  }
+  if (document->root().type() != JsonType::kString) {
+    ReportTestFailure(__FILE__, __LINE__, "Not a string");
+  }
+  return std::string(document->root().GetString());
+}
+
+// Returns the error message for |json|, or an empty string if it parses.
+std::string ParseError(std::string_view json) {
+  JsonDocument document;
+  std::string error;
+  if (document.Parse(json, &error)) {
+    return std::string();
+  }
+  EXPECT_FALSE(document.root().exists());
+  return error;
+}
+
+std::string Nested(size_t depth) {
+  return std::string(depth, '[') + std::string(depth, ']');
+}
+
+RUNNER_TEST(Json, ParsesValues) {
+  JsonDocument document;
+  ASSERT_TRUE(document.Parse(
+      " {\"a\": [1, -2.5, true, false, null], \"b\": {}, \"c\": \"x\"} ",
+      nullptr));
+  JsonValue root = document.root();
+  EXPECT_TRUE(root.type() == JsonType::kObject);
+  EXPECT_EQ(root.size(), 3u);
+  JsonValue a = root.Find("a");
+  ASSERT_EQ(a.size(), 5u);
+  int64_t integer = 0;
+  EXPECT_TRUE(a.At(0).GetInt64(&integer));
+  EXPECT_EQ(integer, 1);
+  EXPECT_EQ(a.At(1).GetNumber(), -2.5);
+  EXPECT_FALSE(a.At(1).GetInt64(&integer));
+  EXPECT_EQ(a.At(1).GetNumberText(), "-2.5");
+  EXPECT_TRUE(a.At(2).GetBool());
+  EXPECT_TRUE(a.At(3).type() == JsonType::kBool);
+  EXPECT_FALSE(a.At(3).GetBool());
+  EXPECT_TRUE(a.At(4).IsNull());
+  EXPECT_FALSE(a.At(5).exists());
+  // Skipping a container skips its whole subtree.
+  EXPECT_TRUE(root.Find("b").type() == JsonType::kObject);
+  EXPECT_EQ(root.Find("c").GetString(), "x");
+  EXPECT_FALSE(root.Find("d").exists());
+  // Accessors for the wrong type return empty values.
+  EXPECT_EQ(root.Find("c").GetNumber(), 0.0);
+  EXPECT_EQ(a.GetString(), "");
+}
+
+RUNNER_TEST(Json, LastRepeatedKeyWins) {
+  JsonDocument document;
+  ASSERT_TRUE(document.Parse("{\"k\": 1, \"k\": 2}", nullptr));
+  EXPECT_EQ(document.root().Find("k").GetNumber(), 2.0);
+}
+
+RUNNER_TEST(Json, Escapes) {
+  JsonDocument document;
+  EXPECT_EQ(ParseString(&document, R"("a\"b\\c\/d\b\f\n\r\t")"),
+            "a\"b\\c/d\b\f\n\r\t");
+  EXPECT_EQ(ParseString(&document, R"("\u0041\u00e9\u20AC")"),
+            "A\xC3\xA9\xE2\x82\xAC");
+  // A surrogate pair is one code point.
+  EXPECT_EQ(ParseString(&document, R"("\ud83d\ude00")"), "\xF0\x9F\x98\x80");
+  // Lone surrogates, and a high one followed by something else, become
+  // U+FFFD.
+  EXPECT_EQ(ParseString(&document, R"("\ud83d")"), "\xEF\xBF\xBD");
+  EXPECT_EQ(ParseString(&document, R"("\ude00x")"), "\xEF\xBF\xBDx");
+  EXPECT_EQ(ParseString(&document, R"("\ud83d\u0041")"), "\xEF\xBF\xBD" "A");
+  EXPECT_EQ(ParseString(&document, R"("\ud83d\ud83d\ude00")"),
+            "\xEF\xBF\xBD\xF0\x9F\x98\x80");
+
+  EXPECT_NE(ParseError(R"("\x")").find("invalid escape"), std::string::npos);
+  EXPECT_NE(ParseError(R"("\u12G4")").find("invalid \\u escape"),
+            std::string::npos);
+  EXPECT_NE(ParseError(R"("\u12")").find("invalid \\u escape"),
+            std::string::npos);
+  EXPECT_NE(ParseError("\"a\nb\"").find("control character"),
+            std::string::npos);
+}
+
+RUNNER_TEST(Json, UnescapedStringsPointIntoTheInput) {
+  JsonDocument document;
+  std::string json = "[\"plain\", \"esc\\naped\"]";
+  ASSERT_TRUE(document.Parse(json, nullptr));
+  std::string_view plain = document.root().At(0).GetString();
+  EXPECT_TRUE(plain.data() == json.data() + 2);
+  std::string_view escaped = document.root().At(1).GetString();
+  EXPECT_EQ(escaped, "esc\naped");
+  EXPECT_TRUE(escaped.data() < json.data() ||
+              escaped.data() >= json.data() + json.size());
+}
+
+RUNNER_TEST(Json, Numbers) {
+  JsonDocument document;
+  int64_t integer = 0;
+  ASSERT_TRUE(document.Parse("[0, -0, 1e3, 2.5E-1, 9223372036854775807, "
+                             "9223372036854775808, 1e400, -1e400, 1e-400]",
+                             nullptr));
+  JsonValue root = document.root();
+  EXPECT_TRUE(root.At(0).GetInt64(&integer));
+  EXPECT_EQ(integer, 0);
+  // Integral values written with an exponent still convert.
+  EXPECT_TRUE(root.At(2).GetInt64(&integer));
+  EXPECT_EQ(integer, 1000);
+  EXPECT_EQ(root.At(3).GetNumber(), 0.25);
+  EXPECT_TRUE(root.At(4).GetInt64(&integer));
+  EXPECT_EQ(integer, INT64_MAX);
+  EXPECT_FALSE(root.At(5).GetInt64(&integer));
+  EXPECT_EQ(root.At(5).GetNumber(), 9223372036854775808.0);
+  EXPECT_TRUE(std::isinf(root.At(6).GetNumber()));
+  EXPECT_TRUE(root.At(7).GetNumber() < 0);
+  EXPECT_EQ(root.At(8).GetNumber(), 0.0);
+
+  for (std::string_view invalid :
+       {"01", "-01", "00", "1.", "1.e5", ".5", "-", "-a", "1e", "1e+",
+        "1E-", "+1", "1ex"}) {
+    std::string error = ParseError(invalid);
+    if (error.empty()) {
+      ReportTestFailure(__FILE__, __LINE__, std::string(invalid).c_str());
+    }
+  }
+}
+
+RUNNER_TEST(Json, DepthLimit) {
+  JsonDocument document;
+  EXPECT_TRUE(document.Parse(Nested(JsonDocument::kMaxDepth), nullptr));
+  std::string error = ParseError(Nested(JsonDocument::kMaxDepth + 1));
+  EXPECT_EQ(error, "nesting is too deep at offset 128");
+  // Objects count towards the same limit.
+  std::string objects;
+  for (size_t i = 0; i <= JsonDocument::kMaxDepth; ++i) {
+    objects.append("{\"a\":");
+  }
+  EXPECT_NE(ParseError(objects).find("too deep"), std::string::npos);
+}
+
+RUNNER_TEST(Json, ErrorsReportTheirOffset) {
+  EXPECT_EQ(ParseError(""), "unexpected end of input at offset 0");
+  EXPECT_EQ(ParseError("[1] x"),
+            "unexpected characters after the value at offset 4");
+  EXPECT_EQ(ParseError("{} {}"),
+            "unexpected characters after the value at offset 3");
+  EXPECT_EQ(ParseError("[1,]"), "unexpected character at offset 3");
+  EXPECT_EQ(ParseError("[1 2]"), "expected ',' or ']' at offset 3");
+  EXPECT_EQ(ParseError("{\"a\" 1}"), "expected ':' at offset 5");
+  EXPECT_EQ(ParseError("{1:2}"), "expected a member name at offset 1");
+  EXPECT_EQ(ParseError("{\"a\":1 \"b\":2}"),
+            "expected ',' or '}' at offset 7");
+  EXPECT_EQ(ParseError("[\"abc"), "unterminated string at offset 5");
+  EXPECT_EQ(ParseError("tru"), "unexpected character at offset 0");
+  EXPECT_EQ(ParseError("[1, nul]"), "unexpected character at offset 4");
+
+  // A failed parse leaves no root behind, and the next one succeeds.
+  JsonDocument document;
+  ASSERT_TRUE(document.Parse("[1]", nullptr));
+  EXPECT_FALSE(document.Parse("[1", nullptr));
+  EXPECT_FALSE(document.root().exists());
+  EXPECT_TRUE(document.Parse("2", nullptr));
+  EXPECT_EQ(document.root().GetNumber(), 2.0);
+}
+
+// Puts a quote, backslash or control character at every offset around the
+// 16-byte blocks the string scanner reads.
+RUNNER_TEST(Json, LongStringsAcrossBlockBoundaries) {
+  JsonDocument document;
+  for (size_t offset = 0; offset < 50; ++offset) {
+    std::string prefix(offset, 'a');
+    std::string suffix(37, 'b');
+
+    std::string plain = prefix + suffix;
+    std::string json = "\"";
+    json.append(plain).append("\"");
+    EXPECT_EQ(ParseString(&document, json), plain);
+
+    json = "\"";
+    json.append(prefix).append("\\\"").append(suffix).append("\"");
+    std::string expected = prefix;
+    expected.append("\"").append(suffix);
+    EXPECT_EQ(ParseString(&document, json), expected);
+
+    json = "\"";
+    json.append(prefix).append("\\\\").append(suffix).append("\\n\"");
+    expected = prefix;
+    expected.append("\\").append(suffix).append("\n");
+    EXPECT_EQ(ParseString(&document, json), expected);
+
+    // The string ends before the rest of the input.
+    json = "[\"";
+    json.append(prefix).append("\",\"").append(suffix).append("\"]");
+    ASSERT_TRUE(document.Parse(json, nullptr));
+    EXPECT_EQ(document.root().At(0).GetString(), prefix);
+    EXPECT_EQ(document.root().At(1).GetString(), suffix);
+
+    json = "\"";
+    json.append(prefix).append("\x01").append(suffix).append("\"");
+    std::string error = ParseError(json);
+    std::string expected_error = "control character in string at offset ";
+    expected_error.append(std::to_string(offset + 1));
+    EXPECT_EQ(error, expected_error);
+
+    json = "\"";
+    json.append(prefix).append(suffix);
+    EXPECT_NE(ParseError(json).find("unterminated"), std::string::npos);
+  }
+}
+
+RUNNER_TEST(Json, ReusesTheDocument) {
+  JsonDocument document;
+  ASSERT_TRUE(document.Parse("{\"a\": \"x\\ty\"}", nullptr));
+  EXPECT_EQ(document.root().Find("a").GetString(), "x\ty");
+  ASSERT_TRUE(document.Parse("[\"p\\tq\", 3]", nullptr));
+  EXPECT_EQ(document.root().At(0).GetString(), "p\tq");
+  EXPECT_FALSE(document.root().Find("a").exists());
+}
+
+RUNNER_TEST(Json, WriterEscapesToAscii) {
+  std::string output;
+  JsonWriter writer(&output);
+  writer.BeginObject();
+  writer.Key("s");
+  writer.String("q\"b\\n\n\x01\xC3\xA9\xF0\x9F\x98\x80");
+  writer.Key("bad");
+  writer.String("\xFF");
+  writer.Key("list");
+  writer.BeginArray();
+  writer.Int(-3);
+  writer.Double(0.5);
+  writer.Double(std::nan(""));
+  writer.Bool(true);
+  writer.Null();
+  writer.Raw("{\"r\":1}");
+  writer.EndArray();
+  writer.EndObject();
+  EXPECT_EQ(output,
+            "{\"s\":\"q\\\"b\\\\n\\n\\u0001\\u00e9\\ud83d\\ude00\","
+            "\"bad\":\"\\ufffd\","
+            "\"list\":[-3,0.5,null,true,null,{\"r\":1}]}");
+
+  // What the writer produces reads back as what it was given.
+  JsonDocument document;
+  ASSERT_TRUE(document.Parse(output, nullptr));
+  EXPECT_EQ(document.root().Find("s").GetString(),
+            "q\"b\\n\n\x01\xC3\xA9\xF0\x9F\x98\x80");
+
+  std::u16string wide = u"x";
+  AppendAsciiAsUtf16("{\"a\":1}", &wide);
+  EXPECT_TRUE(wide == u"x{\"a\":1}");
+}
+
+}  // namespace
@@ -0,0 +1,208 @@
+#include "logging.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+// Routes the log to a temporary file for the life of the object and reads
+// back what the flusher wrote.
+class CapturedLog {
+ public:
+  CapturedLog() : file_(std::tmpfile()) {
+    // Drop anything an earlier test left in this thread's ring.
+    FlushLogs();
+    SetLogStream(file_);
+  }
+
+  ~CapturedLog() {
+    SetLogStream(nullptr);
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  bool ok() const { return file_ != nullptr; }
+
+  // Flushes, then returns each line written since construction with its
+  // "[L seconds] " prefix removed.
+  std::vector<std::string> Messages() { return Read(true); }
+
+  // Flushes, then returns each line written since construction.
+  std::vector<std::string> Lines() { return Read(false); }
+
+ private:
+  std::vector<std::string> Read(bool strip_prefix) {
+    FlushLogs();
+    std::vector<std::string> lines;
+    std::fseek(file_, 0, SEEK_SET);
+    std::string line;
+    for (int c = std::fgetc(file_); c != EOF; c = std::fgetc(file_)) {
+      if (c != '\n') {
+        line.push_back(static_cast<char>(c));
+        continue;
+      }
+      size_t end = line.find("] ");
+      if (strip_prefix && end != std::string::npos) {
+        line.erase(0, end + 2);
+      }
+      lines.push_back(line);
+      line.clear();
+    }
+    return lines;
+  }
+
+  FILE* file_;
+};
+
+RUNNER_TEST(Logging, FormatsArguments) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  int negative = -42;
+  unsigned long long big = 18446744073709551615ull;
+  std::string text = "view";
+  const char* null_text = nullptr;
+  RUNNER_LOG_INFO("{} {} {} {} {}", negative, big, 1.5, true, false);
+  RUNNER_LOG_INFO("{}:{}:{}", text, "literal", null_text);
+  RUNNER_LOG_INFO("no arguments");
+  std::vector<std::string> messages = log.Messages();
+  ASSERT_EQ(messages.size(), 3u);
+  EXPECT_EQ(messages[0], "-42 18446744073709551615 1.5 true false");
+  EXPECT_EQ(messages[1], "view:literal:(null)");
+  EXPECT_EQ(messages[2], "no arguments");
+}
+
+RUNNER_TEST(Logging, UnmatchedPlaceholdersAreKept) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  RUNNER_LOG_INFO("{} of {}", 1);
+  RUNNER_LOG_INFO("{x} {", 2);
+  std::vector<std::string> messages = log.Messages();
+  ASSERT_EQ(messages.size(), 2u);
+  EXPECT_EQ(messages[0], "1 of {}");
+  EXPECT_EQ(messages[1], "{x} {");
+}
+
+RUNNER_TEST(Logging, PrefixesLevel) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  RUNNER_LOG_INFO("info");
+  RUNNER_LOG_WARNING("warning");
+  RUNNER_LOG_ERROR("error");
+  std::vector<std::string> lines = log.Lines();
+  ASSERT_EQ(lines.size(), 3u);
+  EXPECT_EQ(lines[0].substr(0, 3), "[I ");
+  EXPECT_EQ(lines[1].substr(0, 3), "[W ");
+  EXPECT_EQ(lines[2].substr(0, 3), "[E ");
+  EXPECT_EQ(lines[2].substr(lines[2].size() - 7), "] error");
+}
+
+RUNNER_TEST(Logging, LevelsBelowMinimumAreCompiledOut) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  int evaluated = 0;
+  RUNNER_LOG_TRACE("trace {}", ++evaluated);
+  RUNNER_LOG_DEBUG("debug {}", ++evaluated);
+  RUNNER_LOG_INFO("info {}", ++evaluated);
+  std::vector<std::string> messages = log.Messages();
+  int expected = 1 + (RUNNER_MIN_LOG_LEVEL <= 1) + (RUNNER_MIN_LOG_LEVEL <= 0);
+  EXPECT_EQ(evaluated, expected);
+  EXPECT_EQ(messages.size(), static_cast<size_t>(expected));
+  ASSERT_TRUE(!messages.empty());
+  EXPECT_EQ(messages.back(), "info " + std::to_string(expected));
+}
+
+RUNNER_TEST(Logging, TranscodesWideStrings) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  std::wstring wide = L"caf\u00E9 \u4E2D \U0001F600";
+  const wchar_t* null_wide = nullptr;
+  RUNNER_LOG_INFO("[{}] [{}]", wide, null_wide);
+  std::vector<std::string> messages = log.Messages();
+  ASSERT_EQ(messages.size(), 1u);
+  EXPECT_EQ(messages[0],
+            "[caf\xC3\xA9 \xE4\xB8\xAD \xF0\x9F\x98\x80] [(null)]");
+}
+
+RUNNER_TEST(Logging, TruncatesTextAtCapacity) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  std::string first(logging_internal::kTextCapacity - 10, 'a');
+  std::string second(20, 'b');
+  RUNNER_LOG_INFO("{}|{}|{}|{}", first, second, "c", 7);
+  std::vector<std::string> messages = log.Messages();
+  ASSERT_EQ(messages.size(), 1u);
+  // The second string gets what room is left; later text gets none, but
+  // numbers are stored outside the text buffer.
+  EXPECT_EQ(messages[0], first + "|" + std::string(10, 'b') + "||7");
+}
+
+RUNNER_TEST(Logging, TruncatesWideTextOnCodeUnits) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  size_t capacity_units = logging_internal::kTextCapacity / sizeof(wchar_t);
+  std::string narrow(logging_internal::kTextCapacity - 3, 'a');
+  std::wstring wide(capacity_units, L'w');
+  RUNNER_LOG_INFO("{}{}", narrow, wide);
+  std::vector<std::string> messages = log.Messages();
+  ASSERT_EQ(messages.size(), 1u);
+  // Three bytes remain, which is less than one unit when wchar_t is four
+  // bytes and one unit when it is two.
+  EXPECT_EQ(messages[0], narrow + std::string(3 / sizeof(wchar_t), 'w'));
+}
+
+RUNNER_TEST(Logging, KeepsOrderWithinAThread) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  for (int i = 0; i < 300; ++i) {
+    RUNNER_LOG_INFO("{}", i);
+  }
+  std::vector<std::string> messages = log.Messages();
+  ASSERT_EQ(messages.size(), 300u);
+  for (int i = 0; i < 300; ++i) {
+    EXPECT_EQ(messages[i], std::to_string(i));
+  }
+}
+
+RUNNER_TEST(Logging, CollectsRecordsFromOtherThreads) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  std::thread worker([] {
+    for (int i = 0; i < 10; ++i) {
+      RUNNER_LOG_INFO("worker {}", i);
+    }
+  });
+  worker.join();
+  std::vector<std::string> messages = log.Messages();
+  ASSERT_EQ(messages.size(), 10u);
+  EXPECT_EQ(messages.front(), "worker 0");
+  EXPECT_EQ(messages.back(), "worker 9");
+}
+
+RUNNER_TEST(Logging, DropsAndCountsRecordsWhenRingIsFull) {
+  CapturedLog log;
+  ASSERT_TRUE(log.ok());
+  uint64_t dropped = DroppedLogRecordCount();
+  // More than a ring holds, with no flush in between.
+  for (int i = 0; i < 600; ++i) {
+    RUNNER_LOG_INFO("{}", i);
+  }
+  uint64_t newly_dropped = DroppedLogRecordCount() - dropped;
+  std::vector<std::string> messages = log.Messages();
+  EXPECT_GT(newly_dropped, 0u);
+  EXPECT_EQ(messages.size() + newly_dropped, 600u);
+  // The oldest records are the ones kept.
+  ASSERT_TRUE(!messages.empty());
+  EXPECT_EQ(messages.front(), "0");
+  EXPECT_EQ(messages.back(), std::to_string(messages.size() - 1));
+
+  // Once drained, the ring takes records again.
+  RUNNER_LOG_INFO("after");
+  EXPECT_EQ(DroppedLogRecordCount() - dropped, newly_dropped);
+}
+
+}  // namespace
@@ -0,0 +1,354 @@
+#include "navigation_policy.h"
+
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+std::u16string Widen(std::string_view text) {
+  return std::u16string(text.begin(), text.end());
+}
+
+NavigationPolicy CompileOrDie(std::string_view config) {
+  std::string error;
+  std::optional<NavigationPolicy> policy =
+      NavigationPolicy::Compile(config, &error);
+  if (!policy) {
+    ReportTestFailure(__FILE__, __LINE__, "Compile failed: " + error);
+    return *NavigationPolicy::Compile("", nullptr);
+  }
+  return std::move(*policy);
+}
+
+bool Allows(const NavigationPolicy& policy, std::string_view uri) {
+  return policy.Evaluate(Widen(uri)).action == NavigationAction::kAllow;
+}
+
+// The index of the rule that decides |uri|.
+size_t DecidingRule(const NavigationPolicy& policy, std::string_view uri) {
+  return policy.Evaluate(Widen(uri)).rule;
+}
+
+// Returns the error for |config|, or an empty string if it compiled.
+std::string CompileError(std::string_view config) {
+  std::string error;
+  if (NavigationPolicy::Compile(config, &error)) {
+    return std::string();
+  }
+  return error;
+}
+
+RUNNER_TEST(NavigationPolicy, DefaultPolicyAllowsOnlyHttps) {
+  NavigationPolicy policy = CompileOrDie(kDefaultNavigationPolicy);
+  EXPECT_TRUE(Allows(policy, "https://example.com/"));
+  EXPECT_TRUE(Allows(policy, "HTTPS://EXAMPLE.COM"));
+  EXPECT_FALSE(Allows(policy, "http://example.com/"));
+  EXPECT_FALSE(Allows(policy, "httpsx://example.com/"));
+  EXPECT_FALSE(Allows(policy, "file:///C:/Windows"));
+  EXPECT_FALSE(Allows(policy, "about:blank"));
+  EXPECT_FALSE(Allows(policy, "not a uri"));
+  EXPECT_FALSE(Allows(policy, ""));
+}
+
+RUNNER_TEST(NavigationPolicy, FirstMatchingRuleDecides) {
+  NavigationPolicy policy = CompileOrDie(
+      "deny https://ads.example.com\n"
+      "allow https://*.example.com\n"
+      "deny https://*.example.com/private/\n"
+      "default allow\n");
+  EXPECT_EQ(DecidingRule(policy, "https://ads.example.com/"), 0u);
+  EXPECT_EQ(DecidingRule(policy, "https://www.example.com/"), 1u);
+  // A later, more specific rule does not override an earlier match.
+  EXPECT_EQ(DecidingRule(policy, "https://www.example.com/private/x"), 1u);
+  EXPECT_EQ(DecidingRule(policy, "https://other.com/"),
+            NavigationPolicy::kDefaultRule);
+  EXPECT_TRUE(Allows(policy, "https://other.com/"));
+  EXPECT_FALSE(Allows(policy, "https://ads.example.com/"));
+}
+
+RUNNER_TEST(NavigationPolicy, MatchesHosts) {
+  NavigationPolicy policy = CompileOrDie(
+      "allow https://*.example.com\n"
+      "allow https://exact.org\n");
+  EXPECT_TRUE(Allows(policy, "https://example.com/"));
+  EXPECT_TRUE(Allows(policy, "https://a.b.example.com/"));
+  EXPECT_TRUE(Allows(policy, "https://A.Example.COM/"));
+  EXPECT_TRUE(Allows(policy, "https://example.com./"));
+  EXPECT_FALSE(Allows(policy, "https://badexample.com/"));
+  EXPECT_FALSE(Allows(policy, "https://example.com.evil.net/"));
+  EXPECT_TRUE(Allows(policy, "https://exact.org"));
+  EXPECT_FALSE(Allows(policy, "https://www.exact.org/"));
+  EXPECT_FALSE(Allows(policy, "https://xexact.org/"));
+  EXPECT_FALSE(Allows(policy, "https://org/"));
+}
+
+RUNNER_TEST(NavigationPolicy, HostComesAfterUserInfo) {
+  NavigationPolicy policy = CompileOrDie("allow https://good.com\n");
+  EXPECT_TRUE(Allows(policy, "https://evil.com@good.com/"));
+  EXPECT_FALSE(Allows(policy, "https://good.com@evil.com/"));
+  EXPECT_FALSE(Allows(policy, "https://good.com:pw@evil.com/"));
+}
+
+RUNNER_TEST(NavigationPolicy, MatchesPorts) {
+  NavigationPolicy policy = CompileOrDie(
+      "allow http://localhost:8080\n"
+      "allow https://secure.com:443\n"
+      "allow http://plain.com:80\n"
+      "allow ws://any.com:*\n"
+      "allow http://[::1]:9000\n");
+  EXPECT_TRUE(Allows(policy, "http://localhost:8080/"));
+  EXPECT_FALSE(Allows(policy, "http://localhost/"));
+  EXPECT_FALSE(Allows(policy, "http://localhost:8081/"));
+  // Default ports count as the URI's port.
+  EXPECT_TRUE(Allows(policy, "https://secure.com/"));
+  EXPECT_TRUE(Allows(policy, "http://plain.com/"));
+  EXPECT_FALSE(Allows(policy, "https://plain.com/"));
+  EXPECT_TRUE(Allows(policy, "ws://any.com:1234/"));
+  EXPECT_TRUE(Allows(policy, "http://[::1]:9000/"));
+  EXPECT_FALSE(Allows(policy, "http://[::1]/"));
+  // An unparseable port makes the URI unparseable.
+  EXPECT_FALSE(Allows(policy, "http://localhost:99999/"));
+  EXPECT_FALSE(Allows(policy, "http://localhost:80a/"));
+}
+
+RUNNER_TEST(NavigationPolicy, MatchesPathPrefixes) {
+  NavigationPolicy policy = CompileOrDie(
+      "allow https://site.com/app/\n"
+      "allow https://wild.com/docs*\n");
+  EXPECT_TRUE(Allows(policy, "https://site.com/app/"));
+  EXPECT_TRUE(Allows(policy, "https://site.com/app/main.js?v=1"));
+  EXPECT_FALSE(Allows(policy, "https://site.com/app"));
+  EXPECT_FALSE(Allows(policy, "https://site.com/APP/"));
+  EXPECT_FALSE(Allows(policy, "https://site.com/?/app/"));
+  EXPECT_FALSE(Allows(policy, "https://site.com/#/app/"));
+  EXPECT_TRUE(Allows(policy, "https://wild.com/docs"));
+  EXPECT_TRUE(Allows(policy, "https://wild.com/docs/intro"));
+  EXPECT_TRUE(Allows(policy, "https://wild.com/docsets"));
+}
+
+RUNNER_TEST(NavigationPolicy, MatchesSchemes) {
+  NavigationPolicy policy = CompileOrDie(
+      "allow about:blank\n"
+      "allow data:\n"
+      "allow *://any-scheme.com\n"
+      "allow bare.com\n");
+  EXPECT_TRUE(Allows(policy, "about:blank"));
+  EXPECT_TRUE(Allows(policy, "ABOUT:blank"));
+  EXPECT_FALSE(Allows(policy, "about:srcdoc"));
+  EXPECT_TRUE(Allows(policy, "data:text/html,hello"));
+  EXPECT_TRUE(Allows(policy, "http://any-scheme.com/"));
+  EXPECT_TRUE(Allows(policy, "custom+app://any-scheme.com/"));
+  EXPECT_TRUE(Allows(policy, "ftp://bare.com/file"));
+  EXPECT_FALSE(Allows(policy, "ftp://www.bare.com/file"));
+}
+
+RUNNER_TEST(NavigationPolicy, CountsHits) {
+  NavigationPolicy policy = CompileOrDie(
+      "allow https://a.com\n"
+      "deny https://b.com\n");
+  policy.Check(u"https://a.com/");
+  policy.Check(u"https://a.com/x");
+  policy.Check(u"https://b.com/");
+  policy.Check(u"https://c.com/");
+  policy.Check(u"garbage");
+  // Evaluating does not count.
+  policy.Evaluate(u"https://a.com/");
+  EXPECT_EQ(policy.hits(0), 2u);
+  EXPECT_EQ(policy.hits(1), 1u);
+  EXPECT_EQ(policy.hits(NavigationPolicy::kDefaultRule), 2u);
+  policy.ResetHits();
+  EXPECT_EQ(policy.hits(0), 0u);
+  EXPECT_EQ(policy.hits(1), 0u);
+  EXPECT_EQ(policy.hits(NavigationPolicy::kDefaultRule), 0u);
+}
+
+RUNNER_TEST(NavigationPolicy, KeepsRuleText) {
+  NavigationPolicy policy = CompileOrDie(
+      "# Header comment\n"
+      "\n"
+      "  allow   https://a.com   # trailing comment\r\n"
+      "deny *://b.com\n");
+  ASSERT_EQ(policy.rule_count(), 2u);
+  EXPECT_EQ(policy.rule_text(0),
+            "  allow   https://a.com   # trailing comment\r");
+  EXPECT_EQ(policy.rule_text(1), "deny *://b.com");
+}
+
+RUNNER_TEST(NavigationPolicy, ReportsErrorsWithLineNumbers) {
+  EXPECT_EQ(CompileError("allow https://a.com\nallow\n"),
+            "line 2: expected an action and a pattern");
+  EXPECT_EQ(CompileError("permit https://a.com\n"),
+            "line 1: unknown action 'permit'");
+  EXPECT_EQ(CompileError("allow a.com b.com\n"), "line 1: too many words");
+  EXPECT_EQ(CompileError("default maybe\n"),
+            "line 1: default must be 'allow' or 'deny'");
+  EXPECT_EQ(CompileError("\n\nallow https://a.com:99999\n"),
+            "line 3: invalid port");
+  EXPECT_EQ(CompileError("allow https://\n"), "line 1: missing host");
+  EXPECT_EQ(CompileError("allow ://a.com\n"), "line 1: missing scheme");
+  EXPECT_EQ(CompileError("allow 1http://a.com\n"), "line 1: invalid scheme");
+  EXPECT_EQ(CompileError("allow https://a.*.com\n"), "line 1: invalid host");
+  EXPECT_EQ(CompileError("allow https://a.com/*/x\n"),
+            "line 1: '*' is only allowed at the end of a path");
+  EXPECT_EQ(CompileError("allow https://caf\xC3\xA9.com\n"),
+            "line 1: patterns must be printable ASCII");
+  EXPECT_EQ(CompileError(""), "");
+  EXPECT_FALSE(NavigationPolicy::Compile("allow", nullptr).has_value());
+}
+
+// A rule in structured form, matched by brute force to check the trie.
+struct ModelRule {
+  NavigationAction action;
+  // Empty for any.
+  std::string scheme;
+  std::string host;
+  bool subdomains = false;
+  // Negative for any.
+  int port = -1;
+  std::string path;
+
+  std::string Text() const {
+    std::string text =
+        action == NavigationAction::kAllow ? "allow " : "deny ";
+    text += scheme.empty() ? "*" : scheme;
+    text += "://";
+    if (host.empty()) {
+      text += "*";
+    } else {
+      text += subdomains ? "*." : "";
+      text += host;
+    }
+    if (port >= 0) {
+      text += ":";
+      text += std::to_string(port);
+    }
+    text += path;
+    return text;
+  }
+};
+
+struct ModelUri {
+  std::string scheme;
+  std::string host;
+  int port;
+  std::string path;
+};
+
+char LowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+std::string Lower(std::string text) {
+  for (char& c : text) {
+    c = LowerAscii(c);
+  }
+  return text;
+}
+
+bool ModelMatches(const ModelRule& rule, const ModelUri& uri) {
+  std::string host = Lower(uri.host);
+  if (!rule.scheme.empty() && rule.scheme != Lower(uri.scheme)) {
+    return false;
+  }
+  if (!rule.host.empty() && host != rule.host) {
+    // A subdomain rule also matches hosts ending in "." followed by it.
+    size_t dot = host.size() - rule.host.size() - 1;
+    if (!rule.subdomains || host.size() <= rule.host.size() ||
+        host[dot] != '.' || host.compare(dot + 1, std::string::npos,
+                                         rule.host) != 0) {
+      return false;
+    }
+  }
+  if (rule.port >= 0 && rule.port != uri.port) {
+    return false;
+  }
+  return uri.path.compare(0, rule.path.size(), rule.path) == 0;
+}
+
+RUNNER_TEST(NavigationPolicy, RandomRulesMatchBruteForce) {
+  // Enough hosts ending in different characters that the trie's root uses
+  // its binary search, and nested domains so suffixes overlap.
+  const std::vector<std::string> kDomains = {
+      "a.com", "b.a.com", "c.b.a.com", "ba.com", "x.org",  "y.x.org",
+      "z.net", "q.io",    "w.dev",     "e.app",  "r.info", "localhost",
+      "t.uk",  "co.uk",   "s.co.uk"};
+  const std::vector<std::string> kSchemes = {"https", "http", "ws", "app"};
+  const std::vector<int> kPorts = {80, 443, 8080};
+  const std::vector<std::string> kPaths = {"", "/", "/a", "/a/", "/a/b",
+                                           "/b"};
+  std::mt19937 random(7);
+  auto pick = [&random](const auto& values) {
+    return values[random() % values.size()];
+  };
+
+  for (int round = 0; round < 50; ++round) {
+    std::vector<ModelRule> rules;
+    std::string config = round % 2 ? "default allow\n" : "";
+    size_t rule_count = 1 + random() % 40;
+    for (size_t i = 0; i < rule_count; ++i) {
+      ModelRule rule;
+      rule.action =
+          random() % 2 ? NavigationAction::kAllow : NavigationAction::kDeny;
+      rule.scheme = random() % 3 ? pick(kSchemes) : "";
+      rule.host = random() % 8 ? pick(kDomains) : "";
+      rule.subdomains = !rule.host.empty() && random() % 2;
+      rule.port = random() % 3 ? -1 : pick(kPorts);
+      rule.path = pick(kPaths);
+      config += rule.Text() + "\n";
+      rules.push_back(rule);
+    }
+    NavigationPolicy policy = CompileOrDie(config);
+    ASSERT_EQ(policy.rule_count(), rules.size());
+
+    for (int check = 0; check < 200; ++check) {
+      ModelUri uri;
+      uri.scheme = pick(kSchemes);
+      // Sometimes a lookalike that only shares a suffix with a domain.
+      uri.host = random() % 4 ? "" : "v";
+      uri.host += pick(kDomains);
+      uri.port = uri.scheme == "https"                      ? 443
+                 : uri.scheme == "http" || uri.scheme == "ws" ? 80
+                                                              : 0;
+      if (random() % 4 == 0) {
+        uri.scheme[0] = static_cast<char>(uri.scheme[0] - ('a' - 'A'));
+        uri.host[0] = static_cast<char>(uri.host[0] - ('a' - 'A'));
+      }
+      bool explicit_port = random() % 2;
+      if (explicit_port) {
+        uri.port = pick(kPorts);
+      }
+      uri.path = pick(kPaths);
+      std::string text = uri.scheme;
+      text += "://";
+      text += uri.host;
+      if (explicit_port) {
+        text += ":";
+        text += std::to_string(uri.port);
+      }
+      text += uri.path;
+      if (random() % 4 == 0) {
+        text += "?q=/a/b";
+      }
+
+      size_t expected = NavigationPolicy::kDefaultRule;
+      for (size_t i = 0; i < rules.size(); ++i) {
+        if (ModelMatches(rules[i], uri)) {
+          expected = i;
+          break;
+        }
+      }
+      NavigationDecision decision = policy.Evaluate(Widen(text));
+      EXPECT_EQ(decision.rule, expected);
+      if (decision.rule != expected) {
+        ReportTestFailure(__FILE__, __LINE__, "URI: " + text);
+        return;
+      }
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,240 @@
+#include "platform_view_registry.h"
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+SlotHandle HandleFor(uint32_t value) {
+  return SlotHandle{value, 1};
+}
+
+RUNNER_TEST(PlatformViewKeyIndex, InsertFindErase) {
+  PlatformViewKeyIndex index;
+  EXPECT_TRUE(index.Find(0x1000).IsNull());
+  EXPECT_TRUE(index.Insert(0x1000, HandleFor(1)));
+  EXPECT_FALSE(index.Insert(0x1000, HandleFor(2)));
+  EXPECT_EQ(index.Find(0x1000), HandleFor(1));
+  EXPECT_EQ(index.size(), 1u);
+  EXPECT_TRUE(index.Erase(0x1000));
+  EXPECT_FALSE(index.Erase(0x1000));
+  EXPECT_TRUE(index.Find(0x1000).IsNull());
+  EXPECT_EQ(index.size(), 0u);
+}
+
+RUNNER_TEST(PlatformViewKeyIndex, RejectsZeroKey) {
+  PlatformViewKeyIndex index;
+  EXPECT_FALSE(index.Insert(0, HandleFor(1)));
+  EXPECT_TRUE(index.Find(0).IsNull());
+  EXPECT_FALSE(index.Erase(0));
+}
+
+RUNNER_TEST(PlatformViewKeyIndex, GrowsPastInitialTable) {
+  PlatformViewKeyIndex index;
+  for (uint32_t i = 1; i <= 1000; ++i) {
+    ASSERT_TRUE(index.Insert(i * 16, HandleFor(i)));
+  }
+  for (uint32_t i = 1; i <= 1000; ++i) {
+    EXPECT_EQ(index.Find(i * 16), HandleFor(i));
+  }
+}
+
+// Fills a minimum-size table to its load limit and erases the keys in
+// every rotation of the insertion order. Each erase must shift the rest of
+// its probe run back, including across the end of the table, or a later
+// key becomes unreachable.
+RUNNER_TEST(PlatformViewKeyIndex, BackwardShiftKeepsProbeRunsReachable) {
+  constexpr uint32_t kKeys = 8;
+  for (uint32_t rotation = 0; rotation < kKeys; ++rotation) {
+    PlatformViewKeyIndex index;
+    for (uint32_t i = 1; i <= kKeys; ++i) {
+      ASSERT_TRUE(index.Insert(i * 8, HandleFor(i)));
+    }
+    for (uint32_t n = 0; n < kKeys; ++n) {
+      uint32_t erased = 1 + (rotation + n) % kKeys;
+      ASSERT_TRUE(index.Erase(erased * 8));
+      for (uint32_t m = n + 1; m < kKeys; ++m) {
+        uint32_t remaining = 1 + (rotation + m) % kKeys;
+        EXPECT_EQ(index.Find(remaining * 8), HandleFor(remaining));
+      }
+      EXPECT_TRUE(index.Find(erased * 8).IsNull());
+    }
+    EXPECT_EQ(index.size(), 0u);
+  }
+}
+
+// Random inserts and erases over a small key range, so probe runs form,
+// merge and wrap, checked against std::map after every operation.
+RUNNER_TEST(PlatformViewKeyIndex, ChurnMatchesModel) {
+  PlatformViewKeyIndex index;
+  std::map<PlatformViewKey, SlotHandle> model;
+  std::mt19937 random(7);
+  for (uint32_t step = 0; step < 20000; ++step) {
+    PlatformViewKey key = 1 + random() % 64;
+    if (random() % 2 == 0) {
+      bool inserted = index.Insert(key, HandleFor(step));
+      EXPECT_EQ(inserted, model.count(key) == 0);
+      model.emplace(key, HandleFor(step));
+    } else {
+      EXPECT_EQ(index.Erase(key), model.erase(key) == 1);
+    }
+    ASSERT_EQ(index.size(), model.size());
+    for (PlatformViewKey probe = 1; probe <= 64; ++probe) {
+      auto it = model.find(probe);
+      SlotHandle expected = it == model.end() ? SlotHandle{} : it->second;
+      ASSERT_EQ(index.Find(probe), expected);
+    }
+  }
+}
+
+struct TestView {
+  std::string name;
+};
+
+RUNNER_TEST(PlatformViewRegistry, AddFindRemove) {
+  PlatformViewRegistry<TestView> registry;
+  SlotHandle a = registry.Add(0x10, TestView{"a"});
+  SlotHandle b = registry.Add(0x20, TestView{"b"});
+  ASSERT_FALSE(a.IsNull());
+  ASSERT_FALSE(b.IsNull());
+  EXPECT_EQ(registry.Find(0x10)->name, "a");
+  EXPECT_EQ(registry.Get(b)->name, "b");
+  EXPECT_EQ(registry.FindHandle(0x20), b);
+  EXPECT_EQ(registry.KeyOf(a), 0x10u);
+  EXPECT_TRUE(registry.Remove(PlatformViewKey{0x10}));
+  EXPECT_EQ(registry.Find(0x10), nullptr);
+  EXPECT_EQ(registry.Get(a), nullptr);
+  EXPECT_EQ(registry.KeyOf(a), 0u);
+  EXPECT_EQ(registry.Get(b)->name, "b");
+  EXPECT_EQ(registry.size(), 1u);
+}
+
+RUNNER_TEST(PlatformViewRegistry, RejectsZeroAndDuplicateKeys) {
+  PlatformViewRegistry<TestView> registry;
+  EXPECT_TRUE(registry.Add(0, TestView{"zero"}).IsNull());
+  ASSERT_FALSE(registry.Add(0x10, TestView{"first"}).IsNull());
+  EXPECT_TRUE(registry.Add(0x10, TestView{"second"}).IsNull());
+  EXPECT_EQ(registry.Find(0x10)->name, "first");
+  EXPECT_EQ(registry.size(), 1u);
+}
+
+// A callback holding the handle of a view that was destroyed, and whose
+// window handle was then reused by a new view, must not reach the new one.
+RUNNER_TEST(PlatformViewRegistry, StaleHandleAfterKeyReuse) {
+  PlatformViewRegistry<TestView> registry;
+  SlotHandle old_handle = registry.Add(0x10, TestView{"old"});
+  ASSERT_TRUE(registry.Remove(old_handle));
+  SlotHandle new_handle = registry.Add(0x10, TestView{"new"});
+  ASSERT_FALSE(new_handle.IsNull());
+  EXPECT_EQ(registry.Get(old_handle), nullptr);
+  EXPECT_FALSE(registry.Remove(old_handle));
+  EXPECT_EQ(registry.Find(0x10)->name, "new");
+}
+
+RUNNER_TEST(PlatformViewRegistry, RemoveKeepsOtherViewsReachable) {
+  PlatformViewRegistry<TestView> registry;
+  std::vector<SlotHandle> handles;
+  for (PlatformViewKey key = 1; key <= 32; ++key) {
+    handles.push_back(registry.Add(key * 0x100, TestView{std::to_string(key)}));
+  }
+  for (PlatformViewKey key = 1; key <= 32; key += 2) {
+    ASSERT_TRUE(registry.Remove(handles[key - 1]));
+  }
+  for (PlatformViewKey key = 2; key <= 32; key += 2) {
+    TestView* view = registry.Find(key * 0x100);
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(view->name, std::to_string(key));
+    EXPECT_EQ(registry.Get(handles[key - 1]), view);
+  }
+  size_t visited = 0;
+  registry.ForEach([&visited](PlatformViewKey key, TestView& view) {
+    EXPECT_EQ(view.name, std::to_string(key / 0x100));
+    ++visited;
+  });
+  EXPECT_EQ(visited, 16u);
+}
+
+// Creates and destroys views the way window handles come and go, reusing
+// keys, and checks every lookup against a model, including ones through
+// handles of views that were removed.
+RUNNER_TEST(PlatformViewRegistry, ChurnMatchesModel) {
+  struct Live {
+    SlotHandle handle;
+    std::string name;
+  };
+  PlatformViewRegistry<TestView> registry;
+  std::map<PlatformViewKey, Live> model;
+  std::vector<SlotHandle> removed;
+  std::mt19937 random(11);
+  for (uint32_t step = 0; step < 20000; ++step) {
+    PlatformViewKey key = (1 + random() % 96) * 0x10;
+    auto it = model.find(key);
+    switch (random() % 4) {
+      case 0:
+      case 1: {
+        std::string name = std::to_string(step);
+        SlotHandle handle = registry.Add(key, TestView{name});
+        ASSERT_EQ(handle.IsNull(), it != model.end());
+        if (it == model.end()) {
+          model.emplace(key, Live{handle, name});
+        }
+        break;
+      }
+      case 2:
+        // By key, as a window procedure does.
+        EXPECT_EQ(registry.Remove(key), it != model.end());
+        if (it != model.end()) {
+          removed.push_back(it->second.handle);
+          model.erase(it);
+        }
+        break;
+      default:
+        // By handle, as a callback does, sometimes with a stale one.
+        if (!removed.empty() && random() % 2 == 0) {
+          EXPECT_FALSE(registry.Remove(removed[random() % removed.size()]));
+        } else if (it != model.end()) {
+          EXPECT_TRUE(registry.Remove(it->second.handle));
+          removed.push_back(it->second.handle);
+          model.erase(it);
+        }
+        break;
+    }
+    ASSERT_EQ(registry.size(), model.size());
+    if (step % 64 != 0) {
+      continue;
+    }
+    for (PlatformViewKey probe = 0x10; probe <= 96 * 0x10; probe += 0x10) {
+      auto found = model.find(probe);
+      TestView* view = registry.Find(probe);
+      if (found == model.end()) {
+        ASSERT_EQ(view, nullptr);
+        ASSERT_TRUE(registry.FindHandle(probe).IsNull());
+        continue;
+      }
+      ASSERT_NE(view, nullptr);
+      ASSERT_EQ(view->name, found->second.name);
+      ASSERT_EQ(registry.FindHandle(probe), found->second.handle);
+      ASSERT_EQ(registry.Get(found->second.handle), view);
+      ASSERT_EQ(registry.KeyOf(found->second.handle), probe);
+    }
+    for (SlotHandle handle : removed) {
+      ASSERT_EQ(registry.Get(handle), nullptr);
+      ASSERT_EQ(registry.KeyOf(handle), 0u);
+    }
+  }
+  std::map<PlatformViewKey, std::string> visited;
+  registry.ForEach([&visited](PlatformViewKey key, TestView& view) {
+    EXPECT_TRUE(visited.emplace(key, view.name).second);
+  });
+  ASSERT_EQ(visited.size(), model.size());
+  for (const auto& [key, live] : model) {
+    EXPECT_EQ(visited[key], live.name);
+  }
+}
+
+}  // namespace
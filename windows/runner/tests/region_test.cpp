@@ -0,0 +1,324 @@
+#include "region.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+// Random rectangles fall in [kMin, kMax) on both axes, and the bitmap
+// model covers that square.
+constexpr int32_t kMin = -8;
+constexpr int32_t kMax = 40;
+constexpr int32_t kSize = kMax - kMin;
+
+// The reference model: one bool per pixel.
+class Bitmap {
+ public:
+  Bitmap() : pixels_(kSize * kSize, false) {}
+
+  void Fill(const IntRect& rect) {
+    for (int32_t y = rect.top; y < rect.bottom; ++y) {
+      for (int32_t x = rect.left; x < rect.right; ++x) {
+        Set(x, y, true);
+      }
+    }
+  }
+
+  bool Get(int32_t x, int32_t y) const {
+    return pixels_[(y - kMin) * kSize + (x - kMin)];
+  }
+  void Set(int32_t x, int32_t y, bool value) {
+    pixels_[(y - kMin) * kSize + (x - kMin)] = value;
+  }
+
+  int64_t Count() const {
+    int64_t count = 0;
+    for (bool pixel : pixels_) {
+      count += pixel ? 1 : 0;
+    }
+    return count;
+  }
+
+  // Combines with |other| pixel by pixel.
+  template <typename Op>
+  Bitmap Combined(const Bitmap& other, Op op) const {
+    Bitmap result;
+    for (size_t i = 0; i < pixels_.size(); ++i) {
+      result.pixels_[i] = op(pixels_[i], other.pixels_[i]);
+    }
+    return result;
+  }
+
+ private:
+  std::vector<bool> pixels_;
+};
+
+// A rectangle in the model's square, empty now and then.
+IntRect RandomRect(std::mt19937& random) {
+  auto coordinate = [&random] {
+    return kMin + static_cast<int32_t>(random() % kSize);
+  };
+  int32_t left = coordinate();
+  int32_t top = coordinate();
+  int32_t right = left + static_cast<int32_t>(random() % 20);
+  int32_t bottom = top + static_cast<int32_t>(random() % 20);
+  return IntRect{left, top, std::min(right, kMax), std::min(bottom, kMax)};
+}
+
+std::vector<IntRect> RandomRects(std::mt19937& random, size_t max_count) {
+  std::vector<IntRect> rects(random() % (max_count + 1));
+  for (IntRect& rect : rects) {
+    rect = RandomRect(random);
+  }
+  return rects;
+}
+
+Bitmap ToBitmap(const std::vector<IntRect>& rects) {
+  Bitmap bitmap;
+  for (const IntRect& rect : rects) {
+    bitmap.Fill(rect);
+  }
+  return bitmap;
+}
+
+std::string Describe(const Region& region) {
+  std::string text;
+  for (const IntRect& rect : region.Rects()) {
+    text.append("[");
+    text.append(std::to_string(rect.left)).append(",");
+    text.append(std::to_string(rect.top)).append(",");
+    text.append(std::to_string(rect.right)).append(",");
+    text.append(std::to_string(rect.bottom)).append("] ");
+  }
+  return text;
+}
+
+// Reports a failure unless |region| holds exactly the pixels of |expected|.
+void ExpectMatches(const Region& region,
+                   const Bitmap& expected,
+                   const char* what) {
+  Bitmap actual = ToBitmap(region.Rects());
+  for (int32_t y = kMin; y < kMax; ++y) {
+    for (int32_t x = kMin; x < kMax; ++x) {
+      if (actual.Get(x, y) != expected.Get(x, y) ||
+          region.Contains(x, y) != expected.Get(x, y)) {
+        std::string message(what);
+        message.append(" differs from the model at ");
+        message.append(std::to_string(x)).append(",");
+        message.append(std::to_string(y)).append(": ");
+        message.append(Describe(region));
+        ReportTestFailure(__FILE__, __LINE__, message);
+        return;
+      }
+    }
+  }
+  EXPECT_EQ(region.Area(), expected.Count());
+}
+
+// Reports that |region| is not in canonical form because of |problem|.
+void ReportBadForm(int line, const char* problem, const Region& region) {
+  std::string message(problem);
+  message.append(" in ").append(Describe(region));
+  ReportTestFailure(__FILE__, line, message);
+}
+
+// Reports a failure unless |region| is in the canonical band form: bands
+// sorted top to bottom without overlap, each holding sorted, disjoint and
+// non-touching spans, and no two vertically adjacent bands alike.
+void ExpectCanonical(const Region& region) {
+  struct Band {
+    int32_t top;
+    int32_t bottom;
+    std::vector<std::pair<int32_t, int32_t>> spans;
+  };
+  std::vector<Band> bands;
+  for (const IntRect& rect : region.Rects()) {
+    if (rect.IsEmpty()) {
+      ReportBadForm(__LINE__, "Empty span", region);
+      return;
+    }
+    if (bands.empty() || bands.back().top != rect.top) {
+      bands.push_back(Band{rect.top, rect.bottom, {}});
+    } else if (bands.back().bottom != rect.bottom) {
+      ReportBadForm(__LINE__, "Ragged band", region);
+      return;
+    }
+    bands.back().spans.emplace_back(rect.left, rect.right);
+  }
+  for (size_t i = 0; i < bands.size(); ++i) {
+    const Band& band = bands[i];
+    for (size_t j = 1; j < band.spans.size(); ++j) {
+      // Touching spans should have been merged into one.
+      if (band.spans[j].first <= band.spans[j - 1].second) {
+        ReportBadForm(__LINE__, "Unsorted or touching spans", region);
+        return;
+      }
+    }
+    if (i == 0) {
+      continue;
+    }
+    const Band& above = bands[i - 1];
+    if (band.top < above.bottom) {
+      ReportBadForm(__LINE__, "Overlapping bands", region);
+      return;
+    }
+    if (band.top == above.bottom && band.spans == above.spans) {
+      ReportBadForm(__LINE__, "Unmerged bands", region);
+      return;
+    }
+  }
+  if (!region.IsEmpty()) {
+    IntRect bounds = region.bounds();
+    EXPECT_EQ(bounds.top, bands.front().top);
+    EXPECT_EQ(bounds.bottom, bands.back().bottom);
+  } else {
+    EXPECT_EQ(region.rect_count(), 0u);
+  }
+}
+
+RUNNER_TEST(Region, EmptyRegion) {
+  Region region;
+  EXPECT_TRUE(region.IsEmpty());
+  EXPECT_EQ(region.Area(), 0);
+  EXPECT_EQ(region.rect_count(), 0u);
+  EXPECT_FALSE(region.Contains(0, 0));
+  EXPECT_TRUE(region.IsRect(IntRect()));
+  EXPECT_TRUE(Region(IntRect{5, 5, 5, 10}).IsEmpty());
+  EXPECT_TRUE(Region(IntRect{5, 5, 4, 10}).IsEmpty());
+  EXPECT_TRUE(region == Region::FromRects({IntRect{1, 1, 1, 1}}));
+}
+
+RUNNER_TEST(Region, SingleRect) {
+  IntRect rect{2, 3, 10, 7};
+  Region region(rect);
+  EXPECT_TRUE(region.IsRect(rect));
+  EXPECT_FALSE(region.IsRect(IntRect{2, 3, 10, 8}));
+  EXPECT_TRUE(region.bounds() == rect);
+  EXPECT_EQ(region.Area(), 32);
+  EXPECT_TRUE(region.Contains(2, 3));
+  EXPECT_TRUE(region.Contains(9, 6));
+  // Right and bottom edges are exclusive.
+  EXPECT_FALSE(region.Contains(10, 3));
+  EXPECT_FALSE(region.Contains(2, 7));
+  EXPECT_FALSE(region.Contains(1, 3));
+}
+
+RUNNER_TEST(Region, TouchingRectsMergeIntoOne) {
+  // Side by side, then stacked.
+  Region row = Region::FromRects({IntRect{0, 0, 5, 5}, IntRect{5, 0, 9, 5}});
+  EXPECT_TRUE(row.IsRect(IntRect{0, 0, 9, 5}));
+  Region column = Region::Union(Region(IntRect{0, 0, 5, 5}),
+                                Region(IntRect{0, 5, 5, 9}));
+  EXPECT_TRUE(column.IsRect(IntRect{0, 0, 5, 9}));
+  // Subtracting the middle and adding it back restores one rectangle.
+  Region whole(IntRect{0, 0, 10, 10});
+  Region hole = Region::Subtract(whole, Region(IntRect{3, 3, 6, 6}));
+  EXPECT_EQ(hole.rect_count(), 4u);
+  EXPECT_TRUE(Region::Union(hole, Region(IntRect{3, 3, 6, 6})) == whole);
+}
+
+RUNNER_TEST(Region, DisjointOperandsShortCut) {
+  Region a(IntRect{0, 0, 10, 10});
+  Region b(IntRect{20, 0, 30, 10});
+  EXPECT_TRUE(Region::Intersect(a, b).IsEmpty());
+  EXPECT_TRUE(Region::Subtract(a, b) == a);
+  EXPECT_TRUE(Region::Subtract(a, Region()) == a);
+  EXPECT_TRUE(Region::Union(a, Region()) == a);
+  EXPECT_TRUE(Region::Union(Region(), b) == b);
+  EXPECT_EQ(Region::Union(a, b).rect_count(), 2u);
+}
+
+RUNNER_TEST(Region, Translated) {
+  Region region = Region::FromRects(
+      {IntRect{0, 0, 4, 4}, IntRect{2, 2, 8, 6}, IntRect{10, 0, 12, 2}});
+  Region moved = region.Translated(-3, 5);
+  EXPECT_EQ(moved.Area(), region.Area());
+  for (int32_t y = -2; y < 10; ++y) {
+    for (int32_t x = -2; x < 14; ++x) {
+      EXPECT_EQ(moved.Contains(x - 3, y + 5), region.Contains(x, y));
+    }
+  }
+  EXPECT_TRUE(moved.Translated(3, -5) == region);
+}
+
+RUNNER_TEST(Region, FromRectsMatchesModel) {
+  std::mt19937 random(19);
+  for (int i = 0; i < 500 && !CurrentTestFailed(); ++i) {
+    std::vector<IntRect> rects = RandomRects(random, 12);
+    Region region = Region::FromRects(rects);
+    ExpectMatches(region, ToBitmap(rects), "FromRects");
+    ExpectCanonical(region);
+  }
+}
+
+RUNNER_TEST(Region, OperationsMatchModel) {
+  std::mt19937 random(23);
+  for (int i = 0; i < 1000 && !CurrentTestFailed(); ++i) {
+    std::vector<IntRect> rects_a = RandomRects(random, 6);
+    std::vector<IntRect> rects_b = RandomRects(random, 6);
+    Region a = Region::FromRects(rects_a);
+    Region b = Region::FromRects(rects_b);
+    Bitmap bitmap_a = ToBitmap(rects_a);
+    Bitmap bitmap_b = ToBitmap(rects_b);
+
+    Region united = Region::Union(a, b);
+    ExpectMatches(united,
+                  bitmap_a.Combined(bitmap_b,
+                                    [](bool x, bool y) { return x || y; }),
+                  "Union");
+    ExpectCanonical(united);
+
+    Region intersected = Region::Intersect(a, b);
+    ExpectMatches(intersected,
+                  bitmap_a.Combined(bitmap_b,
+                                    [](bool x, bool y) { return x && y; }),
+                  "Intersect");
+    ExpectCanonical(intersected);
+
+    Region subtracted = Region::Subtract(a, b);
+    ExpectMatches(subtracted,
+                  bitmap_a.Combined(bitmap_b,
+                                    [](bool x, bool y) { return x && !y; }),
+                  "Subtract");
+    ExpectCanonical(subtracted);
+  }
+}
+
+// Every set of pixels has one representation, however it was built.
+RUNNER_TEST(Region, EqualPixelsGiveEqualRegions) {
+  std::mt19937 random(29);
+  for (int i = 0; i < 500 && !CurrentTestFailed(); ++i) {
+    std::vector<IntRect> rects = RandomRects(random, 8);
+    Region swept = Region::FromRects(rects);
+    // One rectangle at a time, in reverse order.
+    Region folded;
+    for (auto it = rects.rbegin(); it != rects.rend(); ++it) {
+      folded = Region::Union(folded, Region(*it));
+    }
+    EXPECT_TRUE(swept == folded);
+    // Rebuilt from its own rectangles.
+    EXPECT_TRUE(Region::FromRects(swept.Rects()) == swept);
+
+    Region other = Region::FromRects(RandomRects(random, 8));
+    // (a - b) + (a & b) == a, and a - (a - b) == a & b.
+    Region rejoined = Region::Union(Region::Subtract(swept, other),
+                                    Region::Intersect(swept, other));
+    EXPECT_TRUE(rejoined == swept);
+    EXPECT_TRUE(Region::Subtract(swept, Region::Subtract(swept, other)) ==
+                Region::Intersect(swept, other));
+    // Union and intersection commute.
+    EXPECT_TRUE(Region::Union(swept, other) == Region::Union(other, swept));
+    EXPECT_TRUE(Region::Intersect(swept, other) ==
+                Region::Intersect(other, swept));
+    EXPECT_EQ(swept == other, Region::Subtract(swept, other).IsEmpty() &&
+                                  Region::Subtract(other, swept).IsEmpty());
+  }
+}
+
+}  // namespace
@@ -0,0 +1,252 @@
+#include "rpc_router.h"
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+
+#include "test.h"
+
+namespace {
+
+constexpr std::string_view kMethodNotFound =
+    "\"error\":{\"code\":-32601,\"message\":\"Method not found\"}}";
+constexpr std::string_view kInvalidParams =
+    "\"error\":{\"code\":-32602,\"message\":\"Invalid params\"}}";
+
+void RegisterMethods(RpcRouter* router) {
+  router->Register("ping", [] { return "pong"; });
+  router->Register("echo", [](std::string_view message) { return message; });
+  router->Register("add", [](double a, double b) { return a + b; });
+  router->Register("view.setBounds",
+                   [](int32_t id, uint32_t width, bool animate) {
+                     return id + static_cast<int64_t>(width) + animate;
+                   });
+}
+
+// Dispatches |request| and returns the reply, or "none" if there is none.
+std::string Call(RpcRouter* router, std::string_view request) {
+  std::string reply;
+  if (!router->Dispatch(request, &reply)) {
+    EXPECT_TRUE(reply.empty());
+    return "none";
+  }
+  return reply;
+}
+
+std::string ErrorReply(std::string_view id, std::string_view error) {
+  std::string reply = "{\"id\":";
+  reply.append(id).append(",").append(error);
+  return reply;
+}
+
+RUNNER_TEST(RpcRouter, DispatchesToTypedHandlers) {
+  RpcRouter router;
+  RegisterMethods(&router);
+  EXPECT_EQ(router.method_count(), 4u);
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"ping"})"),
+            R"({"id":1,"result":"pong"})");
+  EXPECT_EQ(Call(&router, R"({"method":"ping","params":[],"id":"a"})"),
+            R"({"id":"a","result":"pong"})");
+  EXPECT_EQ(Call(&router, R"({"id":2,"method":"echo","params":["h\"i"]})"),
+            R"({"id":2,"result":"h\"i"})");
+  EXPECT_EQ(Call(&router, R"({"id":3,"method":"add","params":[1.5,2]})"),
+            R"({"id":3,"result":3.5})");
+  EXPECT_EQ(Call(&router,
+                 R"({"id":4,"method":"view.setBounds","params":[-1,10,true]})"),
+            R"({"id":4,"result":10})");
+  // The id is echoed as it was written.
+  EXPECT_EQ(Call(&router, R"({"id":1.50,"method":"ping"})"),
+            R"({"id":1.50,"result":"pong"})");
+  EXPECT_EQ(router.stats().requests, 6u);
+  EXPECT_EQ(router.stats().errors, 0u);
+}
+
+RUNNER_TEST(RpcRouter, RawHandlersAndErrors) {
+  RpcRouter router;
+  router.RegisterRaw("list", [](JsonValue params, RpcReply& reply) {
+    JsonWriter& writer = reply.Result();
+    writer.BeginArray();
+    writer.Int(static_cast<int64_t>(params.size()));
+    writer.Bool(params.exists());
+    writer.EndArray();
+  });
+  router.RegisterRaw("fail", [](JsonValue params, RpcReply& reply) {
+    reply.Result().String("discarded");
+    reply.Error(kRpcHandlerError, "No \"view\"");
+  });
+  router.Register("nothing", [] {});
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"list","params":[1,2]})"),
+            R"({"id":1,"result":[2,true]})");
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"list"})"),
+            R"({"id":1,"result":[0,false]})");
+  EXPECT_EQ(Call(&router, R"({"id":2,"method":"fail"})"),
+            R"({"id":2,"error":{"code":-32000,"message":"No \"view\""}})");
+  // A handler writing nothing, or returning void, replies null.
+  EXPECT_EQ(Call(&router, R"({"id":3,"method":"nothing"})"),
+            R"({"id":3,"result":null})");
+  EXPECT_EQ(router.stats().errors, 1u);
+}
+
+RUNNER_TEST(RpcRouter, UnknownMethodsAreNotFound) {
+  RpcRouter router;
+  RegisterMethods(&router);
+  // With four methods in eight slots, about half of these names land in a
+  // slot taken by a registered method and are only told apart by the name
+  // comparison.
+  std::string request;
+  for (int i = 0; i < 2000; ++i) {
+    request = "{\"id\":7,\"method\":\"m";
+    request.append(std::to_string(i)).append("\"}");
+    std::string reply = Call(&router, request);
+    if (reply != ErrorReply("7", kMethodNotFound)) {
+      ReportTestFailure(__FILE__, __LINE__, request.c_str());
+      break;
+    }
+  }
+  for (std::string_view name :
+       {"", "pin", "pingg", "Ping", "ping ", "view.setBound", "eChO"}) {
+    request = "{\"id\":7,\"method\":\"";
+    request.append(name).append("\"}");
+    EXPECT_EQ(Call(&router, request), ErrorReply("7", kMethodNotFound));
+  }
+  EXPECT_EQ(router.stats().unknown_methods, 2007u);
+  EXPECT_EQ(router.stats().errors, 2007u);
+  // The registered names still resolve.
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"ping"})"),
+            R"({"id":1,"result":"pong"})");
+
+  RpcRouter empty;
+  EXPECT_EQ(Call(&empty, R"({"id":1,"method":"ping"})"),
+            ErrorReply("1", kMethodNotFound));
+}
+
+RUNNER_TEST(RpcRouter, RegisteringAfterDispatchRebuildsTheTable) {
+  RpcRouter router;
+  RegisterMethods(&router);
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"late"})"),
+            ErrorReply("1", kMethodNotFound));
+  router.Register("late", [] { return 1; });
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"late"})"),
+            R"({"id":1,"result":1})");
+  // Replacing a handler takes effect without a new name.
+  router.Register("ping", [] { return "PONG"; });
+  EXPECT_EQ(router.method_count(), 5u);
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"ping"})"),
+            R"({"id":1,"result":"PONG"})");
+
+  // Enough methods that the table grows several times.
+  std::string request;
+  for (int i = 0; i < 300; ++i) {
+    std::string name = "method.";
+    name.append(std::to_string(i));
+    router.Register(name, [i] { return i; });
+    for (int j = i; j >= 0; j -= 37) {
+      request = "{\"id\":1,\"method\":\"method.";
+      request.append(std::to_string(j)).append("\"}");
+      std::string expected = "{\"id\":1,\"result\":";
+      expected.append(std::to_string(j)).append("}");
+      if (Call(&router, request) != expected) {
+        ReportTestFailure(__FILE__, __LINE__, request.c_str());
+        return;
+      }
+    }
+  }
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":"echo","params":["x"]})"),
+            R"({"id":1,"result":"x"})");
+}
+
+RUNNER_TEST(RpcRouter, NotificationsGetNoReply) {
+  RpcRouter router;
+  int calls = 0;
+  router.Register("count", [&calls] { return ++calls; });
+  router.RegisterRaw("fail", [](JsonValue params, RpcReply& reply) {
+    reply.Error(kRpcHandlerError, "failed");
+  });
+  EXPECT_EQ(Call(&router, R"({"method":"count"})"), "none");
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(Call(&router, R"({"method":"count","params":[1]})"), "none");
+  EXPECT_EQ(Call(&router, R"({"method":"missing"})"), "none");
+  EXPECT_EQ(Call(&router, R"({"method":"fail"})"), "none");
+  EXPECT_EQ(router.stats().notifications, 4u);
+  EXPECT_EQ(router.stats().requests, 0u);
+  EXPECT_EQ(router.stats().unknown_methods, 1u);
+}
+
+RUNNER_TEST(RpcRouter, InvalidParams) {
+  RpcRouter router;
+  RegisterMethods(&router);
+  const std::string_view kInvalid[] = {
+      // Wrong arity.
+      R"({"id":1,"method":"add","params":[1]})",
+      R"({"id":1,"method":"add","params":[1,2,3]})",
+      R"({"id":1,"method":"add"})",
+      R"({"id":1,"method":"ping","params":[1]})",
+      // Not positional.
+      R"({"id":1,"method":"add","params":{"a":1,"b":2}})",
+      R"({"id":1,"method":"echo","params":"x"})",
+      // Wrong types.
+      R"({"id":1,"method":"add","params":["1",2]})",
+      R"({"id":1,"method":"add","params":[1,null]})",
+      R"({"id":1,"method":"echo","params":[1]})",
+      R"({"id":1,"method":"view.setBounds","params":[1.5,1,true]})",
+      R"({"id":1,"method":"view.setBounds","params":[2147483648,1,true]})",
+      R"({"id":1,"method":"view.setBounds","params":[1,-1,true]})",
+      R"({"id":1,"method":"view.setBounds","params":[1,4294967296,true]})",
+      R"({"id":1,"method":"view.setBounds","params":[1,1,1]})",
+  };
+  for (std::string_view request : kInvalid) {
+    if (Call(&router, request) != ErrorReply("1", kInvalidParams)) {
+      ReportTestFailure(__FILE__, __LINE__, std::string(request).c_str());
+    }
+  }
+  EXPECT_EQ(router.stats().errors, std::size(kInvalid));
+  // Integral values in any notation fit integer parameters.
+  EXPECT_EQ(
+      Call(&router,
+           R"({"id":1,"method":"view.setBounds","params":[-2e0,4.0e1,false]})"),
+      R"({"id":1,"result":38})");
+}
+
+RUNNER_TEST(RpcRouter, MalformedRequests) {
+  RpcRouter router;
+  RegisterMethods(&router);
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":)"),
+            R"({"id":null,"error":{"code":-32700,"message":"Parse error"}})");
+  // Other messages on the channel are not requests and are left alone.
+  EXPECT_EQ(Call(&router, R"({"id":1,"type":"resize"})"), "none");
+  EXPECT_EQ(Call(&router, R"({"id":1,"method":3})"), "none");
+  EXPECT_EQ(Call(&router, R"(["ping"])"), "none");
+  EXPECT_EQ(Call(&router, R"({"id":{},"method":"ping"})"),
+            R"({"id":null,"error":{"code":-32600,)"
+            R"("message":"Invalid request"}})");
+  EXPECT_EQ(Call(&router, R"({"id":null,"method":"ping"})"),
+            R"({"id":null,"error":{"code":-32600,)"
+            R"("message":"Invalid request"}})");
+  EXPECT_EQ(router.stats().invalid, 6u);
+  EXPECT_EQ(router.stats().requests, 0u);
+}
+
+RUNNER_TEST(RpcRouter, DispatchesUtf16) {
+  RpcRouter router;
+  RegisterMethods(&router);
+  std::u16string reply = u"stale";
+  ASSERT_TRUE(router.Dispatch(
+      u"{\"id\":1,\"method\":\"echo\",\"params\":[\"h\u00e9 \U0001F600\"]}",
+      &reply));
+  EXPECT_TRUE(reply == u"{\"id\":1,\"result\":\"h\\u00e9 \\ud83d\\ude00\"}");
+  // Unpaired surrogates are replaced rather than failing the request.
+  std::u16string request = u"{\"id\":2,\"method\":\"echo\",\"params\":[\"";
+  request.push_back(u'\xD800');
+  request.append(u"\"]}");
+  ASSERT_TRUE(router.Dispatch(request, &reply));
+  EXPECT_TRUE(reply == u"{\"id\":2,\"result\":\"\\ufffd\"}");
+  // Without a reply the output is left alone.
+  EXPECT_FALSE(router.Dispatch(u"{\"method\":\"ping\"}", &reply));
+  EXPECT_TRUE(reply == u"{\"id\":2,\"result\":\"\\ufffd\"}");
+  ASSERT_TRUE(router.Dispatch(u"{", &reply));
+  EXPECT_TRUE(reply ==
+              u"{\"id\":null,\"error\":{\"code\":-32700,"
+              u"\"message\":\"Parse error\"}}");
+}
+
+}  // namespace
@@ -0,0 +1,430 @@
+#include "script_batcher.h"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+// Keeps every script until the test answers it.
+class FakeScriptEngine : public ScriptEngine {
+ public:
+  struct Pending {
+    std::u16string script;
+    Callback callback;
+  };
+
+  // ScriptEngine:
+  void Execute(std::u16string_view script, Callback callback) override {
+    scripts.push_back(Pending{std::u16string(script), std::move(callback)});
+  }
+
+  // Answers the oldest unanswered script.
+  void Answer(bool succeeded, std::u16string_view result_json) {
+    if (unanswered() == 0) {
+      ReportTestFailure(__FILE__, __LINE__, "No script to answer");
+      return;
+    }
+    Pending pending = std::move(scripts[answered++]);
+    pending.callback(succeeded, result_json);
+  }
+
+  size_t unanswered() const { return scripts.size() - answered; }
+
+  std::vector<Pending> scripts;
+  size_t answered = 0;
+};
+
+// Records the outcomes of calls.
+struct Outcome {
+  ScriptStatus status;
+  std::u16string result;
+};
+
+struct Recorder {
+  ScriptBatcher::ResultCallback Callback() {
+    return [this](ScriptStatus status, std::u16string_view result_json) {
+      outcomes.push_back(Outcome{status, std::u16string(result_json)});
+    };
+  }
+
+  std::vector<Outcome> outcomes;
+};
+
+// Returns how many calls |script| packs.
+size_t CountCalls(std::u16string_view script) {
+  size_t calls = 0;
+  for (size_t pos = script.find(u"try {"); pos != script.npos;
+       pos = script.find(u"try {", pos + 1)) {
+    ++calls;
+  }
+  return calls;
+}
+
+ScriptBatcher::Options Options(milliseconds timeout,
+                               size_t max_batch_calls = 256) {
+  ScriptBatcher::Options options;
+  options.timeout = timeout;
+  options.max_batch_calls = max_batch_calls;
+  return options;
+}
+
+RUNNER_TEST(ScriptBatcher, CallsWaitForFlush) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"1", recorder.Callback());
+  EXPECT_TRUE(batcher.has_queued());
+  EXPECT_EQ(engine.scripts.size(), 0u);
+  EXPECT_EQ(batcher.Flush(ScriptBatcher::Clock::time_point()), 1u);
+  EXPECT_FALSE(batcher.has_queued());
+  EXPECT_EQ(engine.scripts.size(), 1u);
+  EXPECT_EQ(batcher.Flush(ScriptBatcher::Clock::time_point()), 0u);
+  EXPECT_EQ(engine.scripts.size(), 1u);
+}
+
+RUNNER_TEST(ScriptBatcher, FlushPacksCallsIntoOneScript) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"document.title", recorder.Callback());
+  batcher.Execute(u"window.scrollY;  \n", recorder.Callback());
+  batcher.Execute(u"x.y // trailing comment", recorder.Callback());
+  EXPECT_EQ(batcher.Flush(ScriptBatcher::Clock::time_point()), 3u);
+  ASSERT_EQ(engine.scripts.size(), 1u);
+  const std::u16string& script = engine.scripts[0].script;
+  EXPECT_EQ(CountCalls(script), 3u);
+  EXPECT_NE(script.find(u"document.title"), script.npos);
+  // The trailing semicolon and space are trimmed off.
+  EXPECT_NE(script.find(u"(\nwindow.scrollY\n)"), script.npos);
+  // The comment ends at the line break after it.
+  EXPECT_NE(script.find(u"comment\n)]);"), script.npos);
+  EXPECT_EQ(batcher.in_flight_calls(), 3u);
+
+  engine.Answer(true, u"[[0,\"T\"], [0, 12] ,[0,{\"a\":[1,\"]\"]}]]");
+  ASSERT_EQ(recorder.outcomes.size(), 3u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kSucceeded);
+  EXPECT_EQ(recorder.outcomes[0].result, u"\"T\"");
+  EXPECT_EQ(recorder.outcomes[1].result, u"12");
+  EXPECT_EQ(recorder.outcomes[2].result, u"{\"a\":[1,\"]\"]}");
+  EXPECT_EQ(batcher.in_flight_calls(), 0u);
+  EXPECT_EQ(batcher.stats().batches, 1u);
+  EXPECT_EQ(batcher.stats().succeeded, 3u);
+  EXPECT_EQ(batcher.stats().max_batch_calls, 3u);
+}
+
+RUNNER_TEST(ScriptBatcher, FlushHonorsMaxBatchCalls) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, Options(milliseconds(0), 2));
+  for (int i = 0; i < 5; ++i) {
+    batcher.Execute(u"1", recorder.Callback());
+  }
+  ScriptBatcher::Clock::time_point now;
+  EXPECT_EQ(batcher.Flush(now), 2u);
+  EXPECT_EQ(batcher.Flush(now), 2u);
+  EXPECT_EQ(batcher.Flush(now), 1u);
+  ASSERT_EQ(engine.scripts.size(), 3u);
+  EXPECT_EQ(CountCalls(engine.scripts[0].script), 2u);
+  EXPECT_EQ(CountCalls(engine.scripts[2].script), 1u);
+  EXPECT_EQ(batcher.stats().max_batch_calls, 2u);
+}
+
+RUNNER_TEST(ScriptBatcher, ThrowingCallDoesNotAffectOthers) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"1", recorder.Callback());
+  batcher.Execute(u"missing.property", recorder.Callback());
+  batcher.Execute(u"3", recorder.Callback());
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  engine.Answer(true, u"[[0,1],[1,\"TypeError: missing\"],[0,3]]");
+  ASSERT_EQ(recorder.outcomes.size(), 3u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kSucceeded);
+  EXPECT_TRUE(recorder.outcomes[1].status == ScriptStatus::kThrew);
+  EXPECT_EQ(recorder.outcomes[1].result, u"\"TypeError: missing\"");
+  EXPECT_TRUE(recorder.outcomes[2].status == ScriptStatus::kSucceeded);
+  EXPECT_EQ(recorder.outcomes[2].result, u"3");
+  EXPECT_EQ(batcher.stats().threw, 1u);
+  EXPECT_EQ(batcher.stats().retried_batches, 0u);
+}
+
+RUNNER_TEST(ScriptBatcher, FailedBatchIsRetriedCallByCall) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"1", recorder.Callback());
+  batcher.Execute(u"syntax error(", recorder.Callback());
+  batcher.Execute(u"3", recorder.Callback());
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  // The combined script does not parse.
+  engine.Answer(false, u"");
+  EXPECT_EQ(recorder.outcomes.size(), 0u);
+  ASSERT_EQ(engine.unanswered(), 3u);
+  for (size_t i = 1; i < 4; ++i) {
+    EXPECT_EQ(CountCalls(engine.scripts[i].script), 1u);
+  }
+  EXPECT_NE(engine.scripts[2].script.find(u"syntax error("),
+            std::u16string::npos);
+  engine.Answer(true, u"[[0,1]]");
+  engine.Answer(false, u"");
+  engine.Answer(true, u"[[0,3]]");
+  ASSERT_EQ(recorder.outcomes.size(), 3u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kSucceeded);
+  EXPECT_TRUE(recorder.outcomes[1].status == ScriptStatus::kFailed);
+  EXPECT_EQ(recorder.outcomes[1].result, u"");
+  EXPECT_TRUE(recorder.outcomes[2].status == ScriptStatus::kSucceeded);
+  EXPECT_EQ(recorder.outcomes[2].result, u"3");
+  EXPECT_EQ(batcher.stats().retried_batches, 1u);
+  EXPECT_EQ(batcher.stats().batches, 4u);
+  EXPECT_EQ(batcher.stats().failed, 1u);
+}
+
+RUNNER_TEST(ScriptBatcher, MalformedResultFailsUnreadCalls) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"1", recorder.Callback());
+  batcher.Execute(u"2", recorder.Callback());
+  batcher.Execute(u"3", recorder.Callback());
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  // The batch ran, so nothing is retried; the calls after the last
+  // readable result fail.
+  engine.Answer(true, u"[[0,1],[1,\"E\"],[0,\"unterminated]]");
+  EXPECT_EQ(engine.unanswered(), 0u);
+  ASSERT_EQ(recorder.outcomes.size(), 3u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kSucceeded);
+  EXPECT_TRUE(recorder.outcomes[1].status == ScriptStatus::kThrew);
+  EXPECT_EQ(recorder.outcomes[1].result, u"\"E\"");
+  EXPECT_TRUE(recorder.outcomes[2].status == ScriptStatus::kFailed);
+
+  // One result short.
+  batcher.Execute(u"4", recorder.Callback());
+  batcher.Execute(u"5", recorder.Callback());
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  engine.Answer(true, u"[[0,4]]");
+  ASSERT_EQ(recorder.outcomes.size(), 5u);
+  EXPECT_EQ(recorder.outcomes[3].result, u"4");
+  EXPECT_TRUE(recorder.outcomes[4].status == ScriptStatus::kFailed);
+  EXPECT_EQ(batcher.stats().retried_batches, 0u);
+  EXPECT_EQ(batcher.stats().batches, 2u);
+  EXPECT_EQ(batcher.stats().failed, 2u);
+}
+
+RUNNER_TEST(ScriptBatcher, UnserializableResultDoesNotRerunCalls) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"counter++", recorder.Callback());
+  batcher.Execute(u"(() => { const o = {}; o.o = o; return o; })()",
+                  recorder.Callback());
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  // ExecuteScript reports a result it cannot encode as JSON as null, so
+  // the whole batch result is lost. Rerunning the calls would increment
+  // the counter twice.
+  engine.Answer(true, u"null");
+  EXPECT_EQ(engine.scripts.size(), 1u);
+  ASSERT_EQ(recorder.outcomes.size(), 2u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kFailed);
+  EXPECT_TRUE(recorder.outcomes[1].status == ScriptStatus::kFailed);
+  EXPECT_EQ(batcher.stats().retried_batches, 0u);
+}
+
+RUNNER_TEST(ScriptBatcher, SynchronousEngineCompletesDuringFlush) {
+  // Answers batches as failed and single calls as succeeded, before
+  // returning, so the retries are sent from inside the callback.
+  class SynchronousEngine : public ScriptEngine {
+   public:
+    void Execute(std::u16string_view script, Callback callback) override {
+      if (CountCalls(script) > 1) {
+        callback(false, u"");
+      } else {
+        callback(true, u"[[0,7]]");
+      }
+    }
+  };
+  SynchronousEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  for (int i = 0; i < 3; ++i) {
+    batcher.Execute(u"7", recorder.Callback());
+  }
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  ASSERT_EQ(recorder.outcomes.size(), 3u);
+  for (const Outcome& outcome : recorder.outcomes) {
+    EXPECT_TRUE(outcome.status == ScriptStatus::kSucceeded);
+    EXPECT_EQ(outcome.result, u"7");
+  }
+  EXPECT_EQ(batcher.in_flight_calls(), 0u);
+}
+
+RUNNER_TEST(ScriptBatcher, CancelQueuedCall) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"1", recorder.Callback());
+  ScriptBatcher::CallId id = batcher.Execute(u"2", recorder.Callback());
+  EXPECT_TRUE(batcher.Cancel(id));
+  ASSERT_EQ(recorder.outcomes.size(), 1u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kCancelled);
+  EXPECT_FALSE(batcher.Cancel(id));
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  ASSERT_EQ(engine.scripts.size(), 1u);
+  EXPECT_EQ(CountCalls(engine.scripts[0].script), 1u);
+}
+
+RUNNER_TEST(ScriptBatcher, CancelFlushedCallDropsItsResult) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  batcher.Execute(u"1", recorder.Callback());
+  ScriptBatcher::CallId id = batcher.Execute(u"2", recorder.Callback());
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  EXPECT_TRUE(batcher.Cancel(id));
+  EXPECT_EQ(batcher.in_flight_calls(), 1u);
+  engine.Answer(true, u"[[0,1],[0,2]]");
+  ASSERT_EQ(recorder.outcomes.size(), 2u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kCancelled);
+  EXPECT_TRUE(recorder.outcomes[1].status == ScriptStatus::kSucceeded);
+  EXPECT_EQ(recorder.outcomes[1].result, u"1");
+  EXPECT_FALSE(batcher.Cancel(id));
+}
+
+RUNNER_TEST(ScriptBatcher, CancelledCallIsNotRetried) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+  ScriptBatcher::CallId id = batcher.Execute(u"1", recorder.Callback());
+  batcher.Execute(u"2", recorder.Callback());
+  batcher.Flush(ScriptBatcher::Clock::time_point());
+  batcher.Cancel(id);
+  engine.Answer(false, u"");
+  EXPECT_EQ(engine.unanswered(), 1u);
+}
+
+RUNNER_TEST(ScriptBatcher, DestroyingCancelsOutstandingCalls) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  {
+    ScriptBatcher batcher(&engine, ScriptBatcher::Options());
+    batcher.Execute(u"1", recorder.Callback());
+    batcher.Flush(ScriptBatcher::Clock::time_point());
+    batcher.Execute(u"2", recorder.Callback());
+  }
+  ASSERT_EQ(recorder.outcomes.size(), 2u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kCancelled);
+  EXPECT_TRUE(recorder.outcomes[1].status == ScriptStatus::kCancelled);
+  // A result arriving afterwards is dropped.
+  engine.Answer(true, u"[[0,1]]");
+  EXPECT_EQ(recorder.outcomes.size(), 2u);
+}
+
+RUNNER_TEST(ScriptBatcher, CallsTimeOutAfterFlush) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, Options(milliseconds(100)));
+  ScriptBatcher::Clock::time_point start;
+  batcher.Execute(u"1", recorder.Callback());
+  // Time spent queued does not count.
+  EXPECT_FALSE(batcher.NextTimeout().has_value());
+  batcher.Flush(start + milliseconds(50));
+  batcher.Execute(u"2", recorder.Callback());
+  batcher.Flush(start + milliseconds(80));
+  std::optional<ScriptBatcher::Clock::time_point> next = batcher.NextTimeout();
+  ASSERT_TRUE(next.has_value());
+  EXPECT_TRUE(*next == start + milliseconds(150));
+
+  batcher.ExpireTimedOut(start + milliseconds(149));
+  EXPECT_EQ(recorder.outcomes.size(), 0u);
+  batcher.ExpireTimedOut(start + milliseconds(150));
+  ASSERT_EQ(recorder.outcomes.size(), 1u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kTimedOut);
+  // The next deadline is the second call's.
+  next = batcher.NextTimeout();
+  ASSERT_TRUE(next.has_value());
+  EXPECT_TRUE(*next == start + milliseconds(180));
+
+  // The late result only completes the call still waiting.
+  engine.Answer(true, u"[[0,1]]");
+  engine.Answer(true, u"[[0,2]]");
+  ASSERT_EQ(recorder.outcomes.size(), 2u);
+  EXPECT_TRUE(recorder.outcomes[1].status == ScriptStatus::kSucceeded);
+  EXPECT_FALSE(batcher.NextTimeout().has_value());
+  EXPECT_EQ(batcher.stats().timed_out, 1u);
+}
+
+RUNNER_TEST(ScriptBatcher, CancelledCallsHaveNoTimeout) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, Options(milliseconds(100)));
+  ScriptBatcher::Clock::time_point start;
+  ScriptBatcher::CallId id = batcher.Execute(u"1", recorder.Callback());
+  batcher.Flush(start);
+  batcher.Cancel(id);
+  EXPECT_FALSE(batcher.NextTimeout().has_value());
+  batcher.ExpireTimedOut(start + milliseconds(500));
+  ASSERT_EQ(recorder.outcomes.size(), 1u);
+  EXPECT_TRUE(recorder.outcomes[0].status == ScriptStatus::kCancelled);
+}
+
+RUNNER_TEST(ScriptBatcher, ZeroTimeoutWaitsIndefinitely) {
+  FakeScriptEngine engine;
+  Recorder recorder;
+  ScriptBatcher batcher(&engine, Options(milliseconds(0)));
+  ScriptBatcher::Clock::time_point start;
+  batcher.Execute(u"1", recorder.Callback());
+  batcher.Flush(start);
+  EXPECT_FALSE(batcher.NextTimeout().has_value());
+  batcher.ExpireTimedOut(start + std::chrono::hours(24));
+  EXPECT_EQ(recorder.outcomes.size(), 0u);
+  engine.Answer(true, u"[[0,1]]");
+  EXPECT_EQ(recorder.outcomes.size(), 1u);
+}
+
+RUNNER_TEST(ScriptBatcher, EveryCallCompletesExactlyOnce) {
+  FakeScriptEngine engine;
+  ScriptBatcher batcher(&engine, Options(milliseconds(100), 4));
+  std::vector<int> completions(40, 0);
+  std::vector<ScriptBatcher::CallId> ids;
+  ScriptBatcher::Clock::time_point now;
+  for (int i = 0; i < 40; ++i) {
+    ids.push_back(batcher.Execute(
+        u"1", [&completions, i](ScriptStatus, std::u16string_view) {
+          ++completions[i];
+        }));
+    if (i % 3 == 0) {
+      now += milliseconds(30);
+      batcher.Flush(now);
+    }
+    if (i % 7 == 0) {
+      batcher.Cancel(ids[i / 2]);
+    }
+    if (i % 5 == 0) {
+      batcher.ExpireTimedOut(now);
+    }
+    if (i % 4 == 0 && engine.unanswered() > 0) {
+      engine.Answer(i % 8 == 0, u"[[0,1],[0,1],[0,1],[0,1]]");
+    }
+  }
+  while (batcher.has_queued()) {
+    batcher.Flush(now);
+  }
+  while (engine.unanswered() > 0) {
+    engine.Answer(false, u"");
+  }
+  for (int i = 0; i < 40; ++i) {
+    EXPECT_EQ(completions[i], 1);
+  }
+  const ScriptBatcherStats& stats = batcher.stats();
+  EXPECT_EQ(stats.succeeded + stats.threw + stats.failed + stats.cancelled +
+                stats.timed_out,
+            40u);
+}
+
+}  // namespace
@@ -0,0 +1,152 @@
+#include "slot_map.h"
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+RUNNER_TEST(SlotMap, DefaultHandleIsNull) {
+  SlotMap<int> map;
+  SlotHandle handle;
+  EXPECT_TRUE(handle.IsNull());
+  EXPECT_EQ(map.Get(handle), nullptr);
+  EXPECT_FALSE(map.Erase(handle));
+}
+
+RUNNER_TEST(SlotMap, EmplaceAndGet) {
+  SlotMap<std::string> map;
+  SlotHandle a = map.Emplace("a");
+  SlotHandle b = map.Emplace(3, 'b');
+  EXPECT_FALSE(a.IsNull());
+  EXPECT_NE(a, b);
+  ASSERT_NE(map.Get(a), nullptr);
+  ASSERT_NE(map.Get(b), nullptr);
+  EXPECT_EQ(*map.Get(a), "a");
+  EXPECT_EQ(*map.Get(b), "bbb");
+  EXPECT_EQ(map.size(), 2u);
+}
+
+RUNNER_TEST(SlotMap, EraseInvalidatesHandle) {
+  SlotMap<int> map;
+  SlotHandle handle = map.Emplace(1);
+  EXPECT_TRUE(map.Erase(handle));
+  EXPECT_EQ(map.Get(handle), nullptr);
+  EXPECT_FALSE(map.Erase(handle));
+  EXPECT_TRUE(map.empty());
+}
+
+RUNNER_TEST(SlotMap, StaleHandleDoesNotResolveToReusedSlot) {
+  SlotMap<int> map;
+  SlotHandle stale = map.Emplace(1);
+  ASSERT_TRUE(map.Erase(stale));
+  SlotHandle reused = map.Emplace(2);
+  // The slot is reused under a new generation.
+  EXPECT_EQ(reused.index, stale.index);
+  EXPECT_NE(reused.generation, stale.generation);
+  EXPECT_EQ(map.Get(stale), nullptr);
+  EXPECT_FALSE(map.Erase(stale));
+  ASSERT_NE(map.Get(reused), nullptr);
+  EXPECT_EQ(*map.Get(reused), 2);
+}
+
+RUNNER_TEST(SlotMap, HandleFromOutOfRangeIndexIsRejected) {
+  SlotMap<int> map;
+  map.Emplace(1);
+  EXPECT_EQ(map.Get(SlotHandle{7, 1}), nullptr);
+  EXPECT_FALSE(map.Erase(SlotHandle{7, 1}));
+}
+
+RUNNER_TEST(SlotMap, EraseSwapsLastValueIntoHole) {
+  SlotMap<int> map;
+  SlotHandle a = map.Emplace(10);
+  SlotHandle b = map.Emplace(20);
+  SlotHandle c = map.Emplace(30);
+  ASSERT_TRUE(map.Erase(a));
+  // The last value moved into the erased position, and its handle still
+  // resolves to it.
+  std::vector<int> values(map.begin(), map.end());
+  EXPECT_EQ(values.size(), 2u);
+  EXPECT_EQ(values[0], 30);
+  EXPECT_EQ(values[1], 20);
+  EXPECT_EQ(*map.Get(c), 30);
+  EXPECT_EQ(*map.Get(b), 20);
+  EXPECT_EQ(map.HandleAt(0), c);
+  EXPECT_EQ(map.HandleAt(1), b);
+}
+
+RUNNER_TEST(SlotMap, EraseLastValueMovesNothing) {
+  SlotMap<int> map;
+  SlotHandle a = map.Emplace(10);
+  SlotHandle b = map.Emplace(20);
+  ASSERT_TRUE(map.Erase(b));
+  EXPECT_EQ(map.size(), 1u);
+  EXPECT_EQ(*map.Get(a), 10);
+  EXPECT_EQ(map.HandleAt(0), a);
+}
+
+RUNNER_TEST(SlotMap, HoldsMoveOnlyValues) {
+  SlotMap<std::unique_ptr<int>> map;
+  SlotHandle a = map.Emplace(std::make_unique<int>(1));
+  SlotHandle b = map.Emplace(std::make_unique<int>(2));
+  ASSERT_TRUE(map.Erase(a));
+  EXPECT_EQ(**map.Get(b), 2);
+}
+
+RUNNER_TEST(SlotMap, ClearInvalidatesEveryHandle) {
+  SlotMap<int> map;
+  std::vector<SlotHandle> handles;
+  for (int i = 0; i < 8; ++i) {
+    handles.push_back(map.Emplace(i));
+  }
+  map.Clear();
+  EXPECT_TRUE(map.empty());
+  for (SlotHandle handle : handles) {
+    EXPECT_EQ(map.Get(handle), nullptr);
+  }
+}
+
+// Random emplaces and erases, checked against a plain list of the live
+// handles and their values.
+RUNNER_TEST(SlotMap, ChurnMatchesModel) {
+  SlotMap<uint32_t> map;
+  std::vector<std::pair<SlotHandle, uint32_t>> live;
+  std::vector<SlotHandle> erased;
+  std::mt19937 random(1);
+  for (uint32_t step = 0; step < 20000; ++step) {
+    if (live.empty() || random() % 3 != 0) {
+      live.emplace_back(map.Emplace(step), step);
+    } else {
+      size_t victim = random() % live.size();
+      ASSERT_TRUE(map.Erase(live[victim].first));
+      erased.push_back(live[victim].first);
+      live[victim] = live.back();
+      live.pop_back();
+    }
+  }
+  ASSERT_EQ(map.size(), live.size());
+  for (const auto& [handle, value] : live) {
+    const uint32_t* found = map.Get(handle);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, value);
+  }
+  for (SlotHandle handle : erased) {
+    EXPECT_EQ(map.Get(handle), nullptr);
+  }
+  // Dense iteration visits every live value once.
+  uint64_t sum = 0;
+  for (uint32_t value : map) {
+    sum += value;
+  }
+  uint64_t expected = 0;
+  for (const auto& entry : live) {
+    expected += entry.second;
+  }
+  EXPECT_EQ(sum, expected);
+}
+
+}  // namespace
@@ -0,0 +1,498 @@
+#include "standard_codec.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+// Decodes |message|, reporting a failure if it does not decode.
+StandardValue Decode(const std::vector<uint8_t>& message) {
+  StandardValue value;
+  std::string error;
+  if (!DecodeStandardMessage(message.data(), message.size(), &value,
+                             &error)) {
+    std::string text("Decoding failed: ");
+    text.append(error);
+    ReportTestFailure(__FILE__, __LINE__, text);
+  }
+  return value;
+}
+
+// Returns the error decoding |message| fails with, or "" if it decodes.
+std::string DecodeError(const std::vector<uint8_t>& message) {
+  StandardValue value;
+  std::string error;
+  if (DecodeStandardMessage(message.data(), message.size(), &value,
+                            &error)) {
+    return "";
+  }
+  return error;
+}
+
+bool StartsWith(const std::string& text, const char* prefix) {
+  return text.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+// Describes |value| and everything in it, for comparing a decoded value
+// with what was written.
+void Describe(const StandardValue& value, std::string* out) {
+  switch (value.type()) {
+    case StandardType::kNull:
+      out->append("null");
+      break;
+    case StandardType::kTrue:
+    case StandardType::kFalse:
+      out->append(value.GetBool() ? "true" : "false");
+      break;
+    case StandardType::kInt32:
+    case StandardType::kInt64:
+      out->append(std::to_string(value.GetInt()));
+      break;
+    case StandardType::kFloat64:
+      out->append(std::to_string(value.GetDouble()));
+      break;
+    case StandardType::kString:
+      out->append("'").append(value.GetString()).append("'");
+      break;
+    case StandardType::kUint8List:
+      out->append("u8[");
+      for (size_t i = 0; i < value.size(); ++i) {
+        out->append(std::to_string(value.Uint8At(i))).append(",");
+      }
+      out->append("]");
+      break;
+    case StandardType::kInt32List:
+      out->append("i32[");
+      for (size_t i = 0; i < value.size(); ++i) {
+        out->append(std::to_string(value.Int32At(i))).append(",");
+      }
+      out->append("]");
+      break;
+    case StandardType::kInt64List:
+      out->append("i64[");
+      for (size_t i = 0; i < value.size(); ++i) {
+        out->append(std::to_string(value.Int64At(i))).append(",");
+      }
+      out->append("]");
+      break;
+    case StandardType::kFloat32List:
+      out->append("f32[");
+      for (size_t i = 0; i < value.size(); ++i) {
+        out->append(std::to_string(value.Float32At(i))).append(",");
+      }
+      out->append("]");
+      break;
+    case StandardType::kFloat64List:
+      out->append("f64[");
+      for (size_t i = 0; i < value.size(); ++i) {
+        out->append(std::to_string(value.Float64At(i))).append(",");
+      }
+      out->append("]");
+      break;
+    case StandardType::kList:
+      out->append("[");
+      value.ForEachElement([out](StandardValue element) {
+        Describe(element, out);
+        out->append(",");
+      });
+      out->append("]");
+      break;
+    case StandardType::kMap:
+      out->append("{");
+      value.ForEachEntry([out](StandardValue key, StandardValue entry) {
+        Describe(key, out);
+        out->append(":");
+        Describe(entry, out);
+        out->append(",");
+      });
+      out->append("}");
+      break;
+    case StandardType::kLargeInt:
+      out->append("large");
+      break;
+  }
+}
+
+// Writes a random value to |writer|, and its description to |out|.
+void WriteRandom(std::mt19937& random,
+                 size_t depth,
+                 StandardMessageWriter* writer,
+                 std::string* out) {
+  uint32_t kind = random() % (depth < 4 ? 12 : 10);
+  size_t count = random() % 6;
+  switch (kind) {
+    case 0:
+      writer->Null();
+      out->append("null");
+      break;
+    case 1: {
+      bool value = random() % 2 == 0;
+      writer->Bool(value);
+      out->append(value ? "true" : "false");
+      break;
+    }
+    case 2: {
+      int64_t value = static_cast<int64_t>(random()) - (1u << 31);
+      if (random() % 2) {
+        value *= 1000003;
+      }
+      writer->Int(value);
+      out->append(std::to_string(value));
+      break;
+    }
+    case 3: {
+      double value = static_cast<double>(random()) / 7;
+      writer->Double(value);
+      out->append(std::to_string(value));
+      break;
+    }
+    case 4: {
+      std::string value(random() % 300, 'a' + random() % 26);
+      writer->String(value);
+      out->append("'").append(value).append("'");
+      break;
+    }
+    case 5: {
+      std::vector<uint8_t> values(count);
+      out->append("u8[");
+      for (uint8_t& value : values) {
+        value = static_cast<uint8_t>(random());
+        out->append(std::to_string(value)).append(",");
+      }
+      out->append("]");
+      writer->Uint8List(values.data(), values.size());
+      break;
+    }
+    case 6: {
+      std::vector<int32_t> values(count);
+      out->append("i32[");
+      for (int32_t& value : values) {
+        value = static_cast<int32_t>(random());
+        out->append(std::to_string(value)).append(",");
+      }
+      out->append("]");
+      writer->Int32List(values.data(), values.size());
+      break;
+    }
+    case 7: {
+      std::vector<int64_t> values(count);
+      out->append("i64[");
+      for (int64_t& value : values) {
+        value = static_cast<int64_t>(random()) << 20;
+        out->append(std::to_string(value)).append(",");
+      }
+      out->append("]");
+      writer->Int64List(values.data(), values.size());
+      break;
+    }
+    case 8: {
+      std::vector<float> values(count);
+      out->append("f32[");
+      for (float& value : values) {
+        value = static_cast<float>(random() % 1000) / 8;
+        out->append(std::to_string(value)).append(",");
+      }
+      out->append("]");
+      writer->Float32List(values.data(), values.size());
+      break;
+    }
+    case 9: {
+      std::vector<double> values(count);
+      out->append("f64[");
+      for (double& value : values) {
+        value = static_cast<double>(random()) / 3;
+        out->append(std::to_string(value)).append(",");
+      }
+      out->append("]");
+      writer->Float64List(values.data(), values.size());
+      break;
+    }
+    case 10:
+      writer->BeginList(count);
+      out->append("[");
+      for (size_t i = 0; i < count; ++i) {
+        WriteRandom(random, depth + 1, writer, out);
+        out->append(",");
+      }
+      out->append("]");
+      break;
+    case 11:
+      writer->BeginMap(count);
+      out->append("{");
+      for (size_t i = 0; i < count; ++i) {
+        WriteRandom(random, depth + 1, writer, out);
+        out->append(":");
+        WriteRandom(random, depth + 1, writer, out);
+        out->append(",");
+      }
+      out->append("}");
+      break;
+  }
+}
+
+// A list of mixed values, including ones whose payloads are aligned.
+std::vector<uint8_t> MixedMessage() {
+  std::vector<uint8_t> message;
+  StandardMessageWriter writer(&message);
+  const int32_t ints[] = {1, -2, 3};
+  const double doubles[] = {0.5, -1.25};
+  writer.BeginList(6);
+  writer.String("name");
+  writer.Double(2.5);
+  writer.Int32List(ints, 3);
+  writer.BeginMap(2);
+  writer.String("id");
+  writer.Int(int64_t{1} << 40);
+  writer.String("ok");
+  writer.Bool(true);
+  writer.Float64List(doubles, 2);
+  writer.Null();
+  return message;
+}
+
+RUNNER_TEST(StandardCodec, ScalarsMatchDartEncoding) {
+  std::vector<uint8_t> message;
+  StandardMessageWriter(&message).Null();
+  EXPECT_TRUE(message == std::vector<uint8_t>({0}));
+  message.clear();
+  StandardMessageWriter(&message).Bool(false);
+  EXPECT_TRUE(message == std::vector<uint8_t>({2}));
+  message.clear();
+  StandardMessageWriter(&message).Int(-2);
+  EXPECT_TRUE(message == std::vector<uint8_t>({3, 0xFE, 0xFF, 0xFF, 0xFF}));
+  message.clear();
+  StandardMessageWriter(&message).String("hi");
+  EXPECT_TRUE(message == std::vector<uint8_t>({7, 2, 'h', 'i'}));
+  message.clear();
+  // A double is aligned to 8 bytes from the start of the message.
+  StandardMessageWriter(&message).Double(1.0);
+  EXPECT_TRUE(message == std::vector<uint8_t>({6, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                               0, 0, 0, 0, 0xF0, 0x3F}));
+}
+
+RUNNER_TEST(StandardCodec, IntsUseTheNarrowestType) {
+  const int64_t values[] = {0,
+                            std::numeric_limits<int32_t>::min(),
+                            std::numeric_limits<int32_t>::max(),
+                            int64_t{std::numeric_limits<int32_t>::max()} + 1,
+                            int64_t{std::numeric_limits<int32_t>::min()} - 1,
+                            std::numeric_limits<int64_t>::min(),
+                            std::numeric_limits<int64_t>::max()};
+  for (int64_t value : values) {
+    std::vector<uint8_t> message;
+    StandardMessageWriter(&message).Int(value);
+    bool narrow = value >= std::numeric_limits<int32_t>::min() &&
+                  value <= std::numeric_limits<int32_t>::max();
+    EXPECT_EQ(message.size(), narrow ? 5u : 9u);
+    StandardValue decoded = Decode(message);
+    EXPECT_TRUE(decoded.IsInt());
+    EXPECT_TRUE(decoded.type() ==
+                (narrow ? StandardType::kInt32 : StandardType::kInt64));
+    EXPECT_EQ(decoded.GetInt(), value);
+  }
+}
+
+RUNNER_TEST(StandardCodec, DoublesRoundTripBitForBit) {
+  const double values[] = {0.0,
+                           -0.0,
+                           1e-310,
+                           std::numeric_limits<double>::infinity(),
+                           -std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::quiet_NaN()};
+  for (double value : values) {
+    std::vector<uint8_t> message;
+    StandardMessageWriter(&message).Double(value);
+    double decoded = Decode(message).GetDouble();
+    EXPECT_EQ(std::memcmp(&decoded, &value, sizeof(value)), 0);
+  }
+}
+
+RUNNER_TEST(StandardCodec, StringSizePrefixes) {
+  // One byte up to 253, then 0xFE and a uint16, then 0xFF and a uint32.
+  const size_t sizes[] = {0, 1, 253, 254, 65535, 65536, 100000};
+  for (size_t size : sizes) {
+    std::string text(size, 'x');
+    if (size > 0) {
+      text.back() = 'y';
+    }
+    std::vector<uint8_t> message;
+    StandardMessageWriter(&message).String(text);
+    size_t prefix = size < 254 ? 1 : size <= 65535 ? 3 : 5;
+    EXPECT_EQ(message.size(), 1 + prefix + size);
+    StandardValue decoded = Decode(message);
+    EXPECT_EQ(decoded.size(), size);
+    EXPECT_TRUE(decoded.GetString() == text);
+  }
+}
+
+RUNNER_TEST(StandardCodec, StringsAreReadInPlace) {
+  std::vector<uint8_t> message;
+  StandardMessageWriter(&message).String("caf\xC3\xA9");
+  StandardValue decoded = Decode(message);
+  EXPECT_EQ(decoded.GetString(), "caf\xC3\xA9");
+  EXPECT_EQ(reinterpret_cast<const uint8_t*>(decoded.GetString().data()),
+            message.data() + 2);
+}
+
+RUNNER_TEST(StandardCodec, TypedListsRoundTripAligned) {
+  std::vector<uint8_t> message = MixedMessage();
+  StandardValue list = Decode(message);
+  ASSERT_EQ(list.size(), 6u);
+  StandardValue ints = list.At(2);
+  ASSERT_TRUE(ints.type() == StandardType::kInt32List);
+  ASSERT_EQ(ints.size(), 3u);
+  EXPECT_EQ(ints.Int32At(1), -2);
+  EXPECT_EQ((ints.data() - message.data()) % 4, 0);
+  StandardValue doubles = list.At(4);
+  ASSERT_TRUE(doubles.type() == StandardType::kFloat64List);
+  EXPECT_EQ(doubles.Float64At(1), -1.25);
+  EXPECT_EQ((doubles.data() - message.data()) % 8, 0);
+  EXPECT_EQ(list.At(1).GetDouble(), 2.5);
+}
+
+RUNNER_TEST(StandardCodec, ContainerAccess) {
+  std::vector<uint8_t> message = MixedMessage();
+  StandardValue list = Decode(message);
+  EXPECT_EQ(list.At(0).GetString(), "name");
+  EXPECT_TRUE(list.At(5).IsNull());
+  EXPECT_TRUE(list.At(6).IsNull());
+  StandardValue map = list.At(3);
+  ASSERT_TRUE(map.type() == StandardType::kMap);
+  EXPECT_EQ(map.size(), 2u);
+  EXPECT_EQ(map.Find("id").GetInt(), int64_t{1} << 40);
+  EXPECT_TRUE(map.Find("ok").GetBool());
+  EXPECT_TRUE(map.Find("missing").IsNull());
+  EXPECT_TRUE(list.Find("id").IsNull());
+
+  std::string description;
+  Describe(list, &description);
+  EXPECT_EQ(description,
+            "['name',2.500000,i32[1,-2,3,],{'id':1099511627776,'ok':true,},"
+            "f64[0.500000,-1.250000,],null,]");
+}
+
+RUNNER_TEST(StandardCodec, WrongTypeAccessorsReturnEmpty) {
+  std::vector<uint8_t> message;
+  StandardMessageWriter(&message).String("text");
+  StandardValue value = Decode(message);
+  EXPECT_FALSE(value.IsInt());
+  EXPECT_FALSE(value.IsBool());
+  EXPECT_EQ(value.GetInt(), 0);
+  EXPECT_EQ(value.GetDouble(), 0.0);
+  EXPECT_FALSE(value.GetBool());
+  EXPECT_TRUE(value.At(0).IsNull());
+  EXPECT_TRUE(value.Find("text").IsNull());
+  int visits = 0;
+  value.ForEachElement([&visits](StandardValue) { ++visits; });
+  value.ForEachEntry([&visits](StandardValue, StandardValue) { ++visits; });
+  EXPECT_EQ(visits, 0);
+  EXPECT_TRUE(StandardValue().IsNull());
+  EXPECT_EQ(StandardValue().GetString(), "");
+}
+
+RUNNER_TEST(StandardCodec, RandomMessagesRoundTrip) {
+  std::mt19937 random(41);
+  for (int i = 0; i < 500 && !CurrentTestFailed(); ++i) {
+    std::vector<uint8_t> message;
+    StandardMessageWriter writer(&message);
+    std::string written;
+    WriteRandom(random, 0, &writer, &written);
+    std::string decoded;
+    Describe(Decode(message), &decoded);
+    EXPECT_EQ(decoded, written);
+  }
+}
+
+RUNNER_TEST(StandardCodec, RejectsEveryTruncation) {
+  std::vector<uint8_t> message = MixedMessage();
+  EXPECT_EQ(DecodeError(message), "");
+  for (size_t size = 0; size < message.size(); ++size) {
+    std::vector<uint8_t> truncated(message.begin(), message.begin() + size);
+    std::string error = DecodeError(truncated);
+    if (!StartsWith(error, "unexpected end of message at offset")) {
+      std::string text("Truncated to ");
+      text.append(std::to_string(size)).append(" bytes: ").append(error);
+      ReportTestFailure(__FILE__, __LINE__, text);
+      return;
+    }
+  }
+}
+
+RUNNER_TEST(StandardCodec, RejectsMalformedMessages) {
+  EXPECT_EQ(DecodeError({15}), "unsupported type at offset 0");
+  EXPECT_EQ(DecodeError({12, 1, 0xFF}), "unsupported type at offset 2");
+  // Dart no longer writes large integers.
+  EXPECT_EQ(DecodeError({5, 1, '1'}), "unsupported type at offset 0");
+  EXPECT_EQ(DecodeError({0, 0}),
+            "unexpected bytes after the value at offset 1");
+  EXPECT_EQ(DecodeError({7, 3, 'a'}),
+            "unexpected end of message at offset 2");
+  // A 16-bit size prefix cut short.
+  EXPECT_EQ(DecodeError({7, 0xFE, 1}),
+            "unexpected end of message at offset 2");
+  // Sizes far beyond the message, which must not overflow.
+  EXPECT_TRUE(StartsWith(
+      DecodeError({10, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0}),
+      "unexpected end of message"));
+  EXPECT_TRUE(StartsWith(DecodeError({12, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}),
+                         "unexpected end of message"));
+  EXPECT_TRUE(StartsWith(DecodeError({}), "unexpected end of message"));
+  // A map with a key but no value.
+  EXPECT_TRUE(StartsWith(DecodeError({13, 1, 0}), "unexpected end"));
+}
+
+RUNNER_TEST(StandardCodec, LimitsNestingDepth) {
+  const size_t depths[] = {kMaxStandardMessageDepth,
+                           kMaxStandardMessageDepth + 1};
+  for (size_t depth : depths) {
+    std::vector<uint8_t> message;
+    StandardMessageWriter writer(&message);
+    for (size_t i = 0; i < depth; ++i) {
+      writer.BeginList(1);
+    }
+    writer.Null();
+    std::string error = DecodeError(message);
+    if (depth <= kMaxStandardMessageDepth) {
+      EXPECT_EQ(error, "");
+    } else {
+      EXPECT_TRUE(StartsWith(error, "nesting is too deep"));
+    }
+  }
+}
+
+// Flips random bytes: the message either fails to decode or decodes to
+// values that only point into it.
+RUNNER_TEST(StandardCodec, CorruptMessagesStayInBounds) {
+  std::mt19937 random(43);
+  size_t decoded = 0;
+  for (int i = 0; i < 2000 && !CurrentTestFailed(); ++i) {
+    std::vector<uint8_t> message;
+    StandardMessageWriter writer(&message);
+    std::string written;
+    WriteRandom(random, 0, &writer, &written);
+    message[random() % message.size()] ^=
+        static_cast<uint8_t>(1 + random() % 255);
+    StandardValue value;
+    if (!DecodeStandardMessage(message.data(), message.size(), &value,
+                               nullptr)) {
+      continue;
+    }
+    ++decoded;
+    // Walking the whole value reads every byte it refers to.
+    std::string description;
+    Describe(value, &description);
+    if (value.type() == StandardType::kString ||
+        value.type() == StandardType::kUint8List) {
+      EXPECT_LE(value.data() + value.size(), message.data() + message.size());
+    }
+  }
+  EXPECT_GT(decoded, 0u);
+}
+
+}  // namespace
@@ -0,0 +1,241 @@
+#include "system_metrics.h"
+
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+// Serves whatever the test sets and counts the queries that reach it.
+class FakeSystemMetricsProvider : public SystemMetricsProvider {
+ public:
+  // SystemMetricsProvider:
+  std::vector<MonitorInfo> EnumerateMonitors() override {
+    ++monitor_queries;
+    return monitors;
+  }
+  std::optional<bool> ReadPrefersDarkMode() override {
+    ++theme_queries;
+    return prefers_dark_mode;
+  }
+  void* LoadSystemFunction(const char* name) override {
+    loaded.push_back(name);
+    return std::strcmp(name, "Missing") == 0 ? nullptr : &function;
+  }
+
+  std::vector<MonitorInfo> monitors;
+  std::optional<bool> prefers_dark_mode;
+  int monitor_queries = 0;
+  int theme_queries = 0;
+  std::vector<std::string> loaded;
+  int function = 0;
+};
+
+MonitorInfo Monitor(MonitorId id, IntRect bounds, uint32_t dpi) {
+  MonitorInfo monitor;
+  monitor.id = id;
+  monitor.bounds = bounds;
+  monitor.dpi = dpi;
+  return monitor;
+}
+
+// Two monitors side by side, the second at 150%.
+void AddTwoMonitors(FakeSystemMetricsProvider* provider) {
+  provider->monitors = {Monitor(1, IntRect{0, 0, 1920, 1080}, 96),
+                        Monitor(2, IntRect{1920, 0, 3840, 1080}, 144)};
+}
+
+RUNNER_TEST(SystemMetrics, MonitorsAreEnumeratedOnce) {
+  FakeSystemMetricsProvider provider;
+  AddTwoMonitors(&provider);
+  SystemMetricsCache cache(&provider);
+  EXPECT_EQ(provider.monitor_queries, 0);
+  for (int32_t x = 0; x < 3840; x += 100) {
+    cache.DpiForPoint(x, 500);
+  }
+  EXPECT_EQ(provider.monitor_queries, 1);
+  EXPECT_EQ(cache.stats().monitor_refreshes, 1u);
+  EXPECT_EQ(cache.stats().lookups, 39u);
+}
+
+RUNNER_TEST(SystemMetrics, PicksTheMonitorContainingThePoint) {
+  FakeSystemMetricsProvider provider;
+  AddTwoMonitors(&provider);
+  SystemMetricsCache cache(&provider);
+  const MonitorInfo* monitor = cache.MonitorFromPoint(1919, 1079);
+  ASSERT_NE(monitor, nullptr);
+  EXPECT_EQ(monitor->id, 1u);
+  monitor = cache.MonitorFromPoint(1920, 0);
+  ASSERT_NE(monitor, nullptr);
+  EXPECT_EQ(monitor->id, 2u);
+  EXPECT_EQ(cache.DpiForPoint(100, 100), 96u);
+  EXPECT_EQ(cache.DpiForPoint(2000, 100), 144u);
+}
+
+RUNNER_TEST(SystemMetrics, PicksTheNearestMonitorOutsideAll) {
+  FakeSystemMetricsProvider provider;
+  AddTwoMonitors(&provider);
+  SystemMetricsCache cache(&provider);
+  const MonitorInfo* monitor = cache.MonitorFromPoint(-50, 500);
+  ASSERT_NE(monitor, nullptr);
+  EXPECT_EQ(monitor->id, 1u);
+  monitor = cache.MonitorFromPoint(4000, -10);
+  ASSERT_NE(monitor, nullptr);
+  EXPECT_EQ(monitor->id, 2u);
+  // Below the shared edge, nearer the second monitor.
+  monitor = cache.MonitorFromPoint(1925, 1200);
+  ASSERT_NE(monitor, nullptr);
+  EXPECT_EQ(monitor->id, 2u);
+}
+
+RUNNER_TEST(SystemMetrics, NoMonitorsGivesDefaultDpi) {
+  FakeSystemMetricsProvider provider;
+  SystemMetricsCache cache(&provider);
+  EXPECT_EQ(cache.MonitorFromPoint(0, 0), nullptr);
+  EXPECT_EQ(cache.DpiForPoint(0, 0), kDefaultDpi);
+  // An empty list is still cached.
+  EXPECT_EQ(provider.monitor_queries, 1);
+}
+
+RUNNER_TEST(SystemMetrics, ZeroDpiGivesDefaultDpi) {
+  FakeSystemMetricsProvider provider;
+  provider.monitors = {Monitor(1, IntRect{0, 0, 100, 100}, 0)};
+  SystemMetricsCache cache(&provider);
+  EXPECT_EQ(cache.DpiForPoint(10, 10), kDefaultDpi);
+}
+
+RUNNER_TEST(SystemMetrics, InvalidateMonitorsRefetches) {
+  FakeSystemMetricsProvider provider;
+  AddTwoMonitors(&provider);
+  SystemMetricsCache cache(&provider);
+  EXPECT_EQ(cache.DpiForPoint(2000, 100), 144u);
+  provider.monitors[1].dpi = 192;
+  // Still cached until told otherwise.
+  EXPECT_EQ(cache.DpiForPoint(2000, 100), 144u);
+  cache.InvalidateMonitors();
+  EXPECT_EQ(provider.monitor_queries, 1);
+  EXPECT_EQ(cache.DpiForPoint(2000, 100), 192u);
+  EXPECT_EQ(provider.monitor_queries, 2);
+  // Invalidating monitors leaves the theme alone.
+  cache.PrefersDarkMode();
+  cache.InvalidateMonitors();
+  cache.PrefersDarkMode();
+  EXPECT_EQ(provider.theme_queries, 1);
+}
+
+RUNNER_TEST(SystemMetrics, ThemeIsCachedIncludingUnknown) {
+  FakeSystemMetricsProvider provider;
+  SystemMetricsCache cache(&provider);
+  EXPECT_FALSE(cache.PrefersDarkMode().has_value());
+  EXPECT_FALSE(cache.PrefersDarkMode().has_value());
+  EXPECT_EQ(provider.theme_queries, 1);
+  provider.prefers_dark_mode = true;
+  EXPECT_FALSE(cache.PrefersDarkMode().has_value());
+  cache.InvalidateTheme();
+  EXPECT_TRUE(cache.PrefersDarkMode() == std::optional<bool>(true));
+  EXPECT_EQ(provider.theme_queries, 2);
+  EXPECT_EQ(cache.stats().theme_refreshes, 2u);
+  // Invalidating the theme leaves the monitors alone.
+  cache.DpiForPoint(0, 0);
+  cache.InvalidateTheme();
+  cache.DpiForPoint(0, 0);
+  EXPECT_EQ(provider.monitor_queries, 1);
+}
+
+RUNNER_TEST(SystemMetrics, FunctionsAreLoadedOnceIncludingMissing) {
+  FakeSystemMetricsProvider provider;
+  SystemMetricsCache cache(&provider);
+  EXPECT_EQ(cache.SystemFunction("GetDpiForWindow"), &provider.function);
+  EXPECT_EQ(cache.SystemFunction("Missing"), nullptr);
+  EXPECT_EQ(cache.SystemFunction("GetDpiForWindow"), &provider.function);
+  EXPECT_EQ(cache.SystemFunction("Missing"), nullptr);
+  EXPECT_EQ(provider.loaded.size(), 2u);
+  EXPECT_EQ(cache.stats().function_loads, 2u);
+  // Functions survive both invalidations.
+  cache.InvalidateMonitors();
+  cache.InvalidateTheme();
+  cache.SystemFunction("GetDpiForWindow");
+  EXPECT_EQ(provider.loaded.size(), 2u);
+}
+
+RUNNER_TEST(SystemMetrics, FunctionNamesAreComparedByValue) {
+  FakeSystemMetricsProvider provider;
+  SystemMetricsCache cache(&provider);
+  std::string name = "GetDpiForWindow";
+  cache.SystemFunction(name.c_str());
+  std::string copy = name;
+  cache.SystemFunction(copy.c_str());
+  EXPECT_EQ(provider.loaded.size(), 1u);
+}
+
+RUNNER_TEST(SystemMetrics, ScaleForDpiCommonFactors) {
+  EXPECT_EQ(ScaleForDpi(100, 96), 100);
+  EXPECT_EQ(ScaleForDpi(100, 120), 125);
+  EXPECT_EQ(ScaleForDpi(100, 144), 150);
+  EXPECT_EQ(ScaleForDpi(100, 192), 200);
+  EXPECT_EQ(ScaleForDpi(0, 144), 0);
+  EXPECT_EQ(UnscaleForDpi(150, 144), 100);
+  EXPECT_EQ(UnscaleForDpi(250, 240), 100);
+}
+
+RUNNER_TEST(SystemMetrics, ScaleForDpiRoundsHalvesAwayFromZero) {
+  // 1 * 144 / 96 = 1.5, 3 * 120 / 96 = 3.75, 1 * 120 / 96 = 1.25.
+  EXPECT_EQ(ScaleForDpi(1, 144), 2);
+  EXPECT_EQ(ScaleForDpi(-1, 144), -2);
+  EXPECT_EQ(ScaleForDpi(3, 120), 4);
+  EXPECT_EQ(ScaleForDpi(-3, 120), -4);
+  EXPECT_EQ(ScaleForDpi(1, 120), 1);
+  EXPECT_EQ(ScaleForDpi(-1, 120), -1);
+  // 3 * 96 / 192 = 1.5.
+  EXPECT_EQ(UnscaleForDpi(3, 192), 2);
+  EXPECT_EQ(UnscaleForDpi(-3, 192), -2);
+}
+
+RUNNER_TEST(SystemMetrics, ScaleForDpiMatchesExactRounding) {
+  const uint32_t dpis[] = {72, 96, 108, 120, 144, 168, 192, 240, 288};
+  for (uint32_t dpi : dpis) {
+    for (int32_t logical = -3000; logical <= 3000; ++logical) {
+      double exact = static_cast<double>(logical) * dpi / kDefaultDpi;
+      int32_t expected = static_cast<int32_t>(std::round(exact));
+      if (ScaleForDpi(logical, dpi) != expected) {
+        EXPECT_EQ(ScaleForDpi(logical, dpi), expected);
+        return;
+      }
+      exact = static_cast<double>(logical) * kDefaultDpi / dpi;
+      expected = static_cast<int32_t>(std::round(exact));
+      if (UnscaleForDpi(logical, dpi) != expected) {
+        EXPECT_EQ(UnscaleForDpi(logical, dpi), expected);
+        return;
+      }
+    }
+  }
+}
+
+RUNNER_TEST(SystemMetrics, ScaleRoundTripsAtOrAbove100Percent) {
+  const uint32_t dpis[] = {96, 120, 144, 168, 192, 240};
+  for (uint32_t dpi : dpis) {
+    for (int32_t logical = -5000; logical <= 5000; ++logical) {
+      if (UnscaleForDpi(ScaleForDpi(logical, dpi), dpi) != logical) {
+        EXPECT_EQ(UnscaleForDpi(ScaleForDpi(logical, dpi), dpi), logical);
+        return;
+      }
+    }
+  }
+}
+
+RUNNER_TEST(SystemMetrics, ScaleForDpiDoesNotOverflow) {
+  // The product is taken in 64 bits.
+  EXPECT_EQ(ScaleForDpi(20000000, 192), 40000000);
+  EXPECT_EQ(ScaleForDpi(-20000000, 192), -40000000);
+  EXPECT_EQ(UnscaleForDpi(2000000000, 192), 1000000000);
+  EXPECT_EQ(UnscaleForDpi(123, 0), 123);
+}
+
+static_assert(ScaleForDpi(100, 144) == 150);
+static_assert(UnscaleForDpi(150, 144) == 100);
+
+}  // namespace
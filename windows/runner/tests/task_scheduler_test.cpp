@@ -0,0 +1,254 @@
+#include "task_scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "portable_run_loop.h"
+#include "test.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+using Clock = TaskScheduler::Clock;
+
+// A far-off deadline, for runs that should not be cut short.
+Clock::time_point Later() {
+  return Clock::now() + std::chrono::hours(1);
+}
+
+RUNNER_TEST(TaskScheduler, RunsByPriorityThenPostingOrder) {
+  TaskScheduler scheduler(nullptr);
+  std::string order;
+  scheduler.PostTask([&order] { order += "n1 "; });
+  scheduler.PostTask([&order] { order += "l1 "; }, TaskPriority::kLow);
+  scheduler.PostTask([&order] { order += "h1 "; }, TaskPriority::kHigh);
+  scheduler.PostTask([&order] { order += "n2 "; });
+  scheduler.PostTask([&order] { order += "h2 "; }, TaskPriority::kHigh);
+  EXPECT_FALSE(scheduler.RunUntil(Later()));
+  EXPECT_EQ(order, "h1 h2 n1 n2 l1 ");
+  EXPECT_EQ(scheduler.stats().tasks_run, 5u);
+}
+
+RUNNER_TEST(TaskScheduler, TasksPostedWhileRunningRunInTheSamePass) {
+  TaskScheduler scheduler(nullptr);
+  std::string order;
+  scheduler.PostTask([&] {
+    order += "a ";
+    scheduler.PostTask([&order] { order += "c "; });
+    scheduler.PostTask([&order] { order += "high "; }, TaskPriority::kHigh);
+  });
+  scheduler.PostTask([&order] { order += "b "; });
+  EXPECT_FALSE(scheduler.RunUntil(Later()));
+  EXPECT_EQ(order, "a high b c ");
+}
+
+RUNNER_TEST(TaskScheduler, DelayedTasksRunInDueOrder) {
+  TaskScheduler scheduler(nullptr);
+  std::string order;
+  Clock::time_point now = Clock::now();
+  scheduler.PostTaskAt([&order] { order += "3 "; }, now - milliseconds(1));
+  scheduler.PostTaskAt([&order] { order += "1 "; }, now - milliseconds(3));
+  scheduler.PostTaskAt([&order] { order += "2a "; }, now - milliseconds(2));
+  scheduler.PostTaskAt([&order] { order += "2b "; }, now - milliseconds(2));
+  scheduler.PostTaskAt([&order] { order += "future "; },
+                       now + std::chrono::hours(1));
+  EXPECT_FALSE(scheduler.RunUntil(Later()));
+  EXPECT_EQ(order, "1 2a 2b 3 ");
+  std::optional<Clock::time_point> wake = scheduler.NextWakeTime();
+  ASSERT_TRUE(wake.has_value());
+  EXPECT_TRUE(*wake == now + std::chrono::hours(1));
+}
+
+RUNNER_TEST(TaskScheduler, DueDelayedTasksKeepTheirPriority) {
+  TaskScheduler scheduler(nullptr);
+  std::string order;
+  scheduler.PostTask([&order] { order += "normal "; });
+  scheduler.PostTaskAt([&order] { order += "high "; },
+                       Clock::now() - milliseconds(1), TaskPriority::kHigh);
+  scheduler.PostDelayedTask([&order] { order += "low "; },
+                            Clock::duration::zero(), TaskPriority::kLow);
+  EXPECT_FALSE(scheduler.RunUntil(Later()));
+  EXPECT_EQ(order, "high normal low ");
+}
+
+RUNNER_TEST(TaskScheduler, NextWakeTime) {
+  TaskScheduler scheduler(nullptr);
+  EXPECT_FALSE(scheduler.NextWakeTime().has_value());
+  scheduler.PostIdleTask([](Clock::time_point) {});
+  // Idle work alone is no reason to wake.
+  EXPECT_FALSE(scheduler.NextWakeTime().has_value());
+  EXPECT_TRUE(scheduler.HasIdleTasks());
+  Clock::time_point later = Clock::now() + std::chrono::hours(1);
+  scheduler.PostTaskAt([] {}, later + milliseconds(1));
+  scheduler.PostTaskAt([] {}, later);
+  EXPECT_TRUE(*scheduler.NextWakeTime() == later);
+  scheduler.PostTask([] {});
+  EXPECT_TRUE(*scheduler.NextWakeTime() == Clock::time_point::min());
+}
+
+RUNNER_TEST(TaskScheduler, CoalescesWakes) {
+  int wakes = 0;
+  TaskScheduler scheduler([&wakes] { ++wakes; });
+  scheduler.PostTask([] {});
+  scheduler.PostTask([] {});
+  scheduler.PostIdleTask([](Clock::time_point) {});
+  EXPECT_EQ(wakes, 1);
+  // The loop consulted the queues, so the next post wakes it again.
+  scheduler.NextWakeTime();
+  Clock::time_point later = Clock::now() + std::chrono::hours(1);
+  scheduler.PostTaskAt([] {}, later);
+  EXPECT_EQ(wakes, 2);
+  scheduler.NextWakeTime();
+  // A delayed task after the earliest one does not change the wake time.
+  scheduler.PostTaskAt([] {}, later + milliseconds(1));
+  EXPECT_EQ(wakes, 2);
+  scheduler.PostTaskAt([] {}, later - milliseconds(1));
+  EXPECT_EQ(wakes, 3);
+}
+
+RUNNER_TEST(TaskScheduler, StopsAtTheDeadlineAfterOneTask) {
+  TaskScheduler scheduler(nullptr);
+  int ran = 0;
+  for (int i = 0; i < 3; ++i) {
+    scheduler.PostTask([&ran] { ++ran; });
+  }
+  // A deadline that has passed still lets one task run.
+  EXPECT_TRUE(scheduler.RunUntil(Clock::now() - milliseconds(1)));
+  EXPECT_EQ(ran, 1);
+  EXPECT_EQ(scheduler.stats().budget_exhausted, 1u);
+  EXPECT_FALSE(scheduler.RunUntil(Later()));
+  EXPECT_EQ(ran, 3);
+  EXPECT_FALSE(scheduler.RunUntil(Clock::now() - milliseconds(1)));
+}
+
+RUNNER_TEST(TaskScheduler, RecordsTaskDelay) {
+  TaskScheduler scheduler(nullptr);
+  scheduler.PostTaskAt([] {}, Clock::now() - milliseconds(50));
+  scheduler.RunUntil(Later());
+  EXPECT_GE(scheduler.stats().max_task_delay, milliseconds(50));
+}
+
+RUNNER_TEST(TaskScheduler, IdleTasksGetTheEarlierDeadline) {
+  TaskScheduler scheduler(nullptr);
+  Clock::time_point deadline = Clock::now() + std::chrono::hours(1);
+  Clock::time_point delayed = deadline - milliseconds(1);
+  std::vector<Clock::time_point> deadlines;
+  auto record = [&deadlines](Clock::time_point d) { deadlines.push_back(d); };
+  scheduler.PostIdleTask(record);
+  EXPECT_FALSE(scheduler.RunIdleTasks(deadline));
+  scheduler.PostTaskAt([] {}, delayed);
+  scheduler.PostIdleTask(record);
+  EXPECT_FALSE(scheduler.RunIdleTasks(deadline));
+  ASSERT_EQ(deadlines.size(), 2u);
+  EXPECT_TRUE(deadlines[0] == deadline);
+  EXPECT_TRUE(deadlines[1] == delayed);
+  EXPECT_EQ(scheduler.stats().idle_tasks_run, 2u);
+  // Idle tasks do not run from |RunUntil|, nor past their deadline.
+  scheduler.PostIdleTask(record);
+  scheduler.RunUntil(Later());
+  EXPECT_TRUE(scheduler.RunIdleTasks(Clock::now() - milliseconds(1)));
+  EXPECT_EQ(deadlines.size(), 2u);
+}
+
+RUNNER_TEST(PortableRunLoop, RunUntilIdleSkipsFutureTasks) {
+  PortableRunLoop loop;
+  std::string order;
+  loop.scheduler().PostIdleTask(
+      [&order](Clock::time_point) { order += "idle "; });
+  loop.scheduler().PostDelayedTask([&order] { order += "later "; },
+                                   std::chrono::hours(1));
+  loop.scheduler().PostTask([&order] { order += "task "; });
+  loop.RunUntilIdle();
+  EXPECT_EQ(order, "task idle ");
+}
+
+RUNNER_TEST(PortableRunLoop, QuitFromATask) {
+  PortableRunLoop loop;
+  int ran = 0;
+  loop.scheduler().PostTask([&] {
+    ++ran;
+    loop.Quit();
+  });
+  loop.Run();
+  EXPECT_EQ(ran, 1);
+  // The loop can run again after quitting.
+  loop.scheduler().PostTask([&] {
+    ++ran;
+    loop.Quit();
+  });
+  loop.Run();
+  EXPECT_EQ(ran, 2);
+}
+
+RUNNER_TEST(PortableRunLoop, SleepsUntilDelayedTasks) {
+  PortableRunLoop loop;
+  std::vector<int> order;
+  Clock::time_point start = Clock::now();
+  Clock::time_point first_ran;
+  loop.scheduler().PostDelayedTask(
+      [&] {
+        order.push_back(2);
+        loop.Quit();
+      },
+      milliseconds(30));
+  loop.scheduler().PostDelayedTask(
+      [&] {
+        order.push_back(1);
+        first_ran = Clock::now();
+      },
+      milliseconds(15));
+  loop.Run();
+  EXPECT_GE(Clock::now() - start, milliseconds(30));
+  EXPECT_GE(first_ran - start, milliseconds(15));
+  EXPECT_EQ(order.size(), 2u);
+  EXPECT_TRUE(order == std::vector<int>({1, 2}));
+}
+
+RUNNER_TEST(PortableRunLoop, RunsIdleTasksWhileWaitingForTimers) {
+  PortableRunLoop loop;
+  Clock::time_point timer_at = Clock::now() + milliseconds(20);
+  std::optional<Clock::time_point> idle_deadline;
+  bool idle_before_timer = false;
+  loop.scheduler().PostTaskAt([&loop] { loop.Quit(); }, timer_at);
+  loop.scheduler().PostIdleTask([&](Clock::time_point deadline) {
+    idle_deadline = deadline;
+    idle_before_timer = Clock::now() < timer_at;
+  });
+  loop.Run();
+  ASSERT_TRUE(idle_deadline.has_value());
+  EXPECT_TRUE(idle_before_timer);
+  EXPECT_TRUE(*idle_deadline <= timer_at);
+}
+
+RUNNER_TEST(PortableRunLoop, PostsFromOtherThreadsWakeTheLoop) {
+  PortableRunLoop loop;
+  std::atomic<int> ran{0};
+  std::thread poster([&loop, &ran] {
+    for (int i = 0; i < 100; ++i) {
+      loop.scheduler().PostTask([&ran] { ++ran; });
+      std::this_thread::yield();
+    }
+    loop.scheduler().PostTask([&loop] { loop.Quit(); });
+  });
+  // Without a wake the loop would sleep forever: nothing is delayed.
+  loop.Run();
+  poster.join();
+  EXPECT_EQ(ran.load(), 100);
+}
+
+RUNNER_TEST(PortableRunLoop, QuitFromAnotherThread) {
+  PortableRunLoop loop;
+  std::thread quitter([&loop] {
+    std::this_thread::sleep_for(milliseconds(10));
+    loop.Quit();
+  });
+  loop.Run();
+  quitter.join();
+  EXPECT_EQ(loop.scheduler().stats().tasks_run, 0u);
+}
+
+}  // namespace
@@ -0,0 +1,107 @@
+#include "test.h"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs the registered tests.
+//
+//   runner_tests [--filter=<text>] [--list]
+//
+// --filter runs only tests whose Suite.Name contains <text>. The exit code
+// is 1 if any test failed, and also if the filter matched no test, so a
+// misspelled ctest registration does not pass silently.
+
+namespace {
+
+struct Test {
+  std::string name;
+  TestFunction function;
+};
+
+// Function-local so registration from other translation units' static
+// initializers does not depend on initialization order.
+std::vector<Test>& Registry() {
+  static std::vector<Test> tests;
+  return tests;
+}
+
+// Failures reported by the running test.
+int g_failures = 0;
+
+bool ParseFlag(std::string_view argument,
+               std::string_view flag,
+               std::string_view* value) {
+  if (argument.substr(0, flag.size()) != flag ||
+      argument.size() <= flag.size() || argument[flag.size()] != '=') {
+    return false;
+  }
+  *value = argument.substr(flag.size() + 1);
+  return true;
+}
+
+}  // namespace
+
+bool RegisterTest(const char* suite, const char* name, TestFunction function) {
+  Registry().push_back(
+      Test{std::string(suite) + "." + std::string(name), function});
+  return true;
+}
+
+void ReportTestFailure(const char* file, int line,
+                       const std::string& message) {
+  ++g_failures;
+  std::printf("%s:%d: Failure\n  %s\n", file, line, message.c_str());
+}
+
+bool CurrentTestFailed() {
+  return g_failures != 0;
+}
+
+int main(int argc, char** argv) {
+  std::string filter;
+  bool list = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view argument = argv[i];
+    std::string_view value;
+    if (argument == "--list") {
+      list = true;
+    } else if (ParseFlag(argument, "--filter", &value)) {
+      filter = std::string(value);
+    } else {
+      std::fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  int run = 0;
+  std::vector<std::string> failed;
+  for (const Test& test : Registry()) {
+    if (test.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    if (list) {
+      std::printf("%s\n", test.name.c_str());
+      continue;
+    }
+    ++run;
+    std::printf("[ RUN      ] %s\n", test.name.c_str());
+    g_failures = 0;
+    test.function();
+    std::printf("%s %s\n", g_failures == 0 ? "[       OK ]" : "[  FAILED  ]",
+                test.name.c_str());
+    if (g_failures != 0) {
+      failed.push_back(test.name);
+    }
+  }
+  if (list) {
+    return 0;
+  }
+
+  std::printf("%d tests run, %zu failed\n", run, failed.size());
+  for (const std::string& name : failed) {
+    std::printf("  FAILED: %s\n", name.c_str());
+  }
+  return run == 0 || !failed.empty() ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#ifndef RUNNER_TESTS_TEST_H_
+#define RUNNER_TESTS_TEST_H_
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// A minimal unit test harness for the runner's platform-neutral components.
+//
+// A test is a function that checks its expectations with the EXPECT_ and
+// ASSERT_ macros:
+//
+//   RUNNER_TEST(SlotMap, EraseInvalidatesHandle) {
+//     SlotMap<int> map;
+//     SlotHandle handle = map.Emplace(1);
+//     ASSERT_TRUE(map.Erase(handle));
+//     EXPECT_EQ(map.Get(handle), nullptr);
+//   }
+//
+// A failed EXPECT_ marks the test failed and carries on; a failed ASSERT_
+// also returns from the test function. Tests are named Suite.Name and run
+// in registration order.
+
+using TestFunction = void (*)();
+
+// Adds |function| to the tests run by the harness's main. Returns true so
+// it can initialize a static.
+bool RegisterTest(const char* suite, const char* name, TestFunction function);
+
+// Marks the running test failed, reporting |message| at |file|:|line|.
+void ReportTestFailure(const char* file, int line, const std::string& message);
+
+// Returns whether the running test has failed so far, e.g. to stop a long
+// randomized loop at the first bad step.
+bool CurrentTestFailed();
+
+namespace test_internal {
+
+template <typename T, typename = void>
+struct IsPrintable : std::false_type {};
+
+template <typename T>
+struct IsPrintable<T, std::void_t<decltype(std::declval<std::ostream&>()
+                                           << std::declval<const T&>())>>
+    : std::true_type {};
+
+// Formats |value| for a failure message.
+template <typename T>
+std::string Describe(const T& value) {
+  if constexpr (std::is_enum_v<T>) {
+    return std::to_string(static_cast<long long>(value));
+  } else if constexpr (std::is_same_v<T, std::u16string> ||
+                       std::is_same_v<T, std::u16string_view>) {
+    // Code units outside ASCII are escaped.
+    std::string text = "u\"";
+    for (char16_t unit : value) {
+      if (unit >= 0x20 && unit < 0x7F) {
+        text.push_back(static_cast<char>(unit));
+      } else {
+        static constexpr char kHex[] = "0123456789ABCDEF";
+        text += "\\u";
+        for (int shift = 12; shift >= 0; shift -= 4) {
+          text.push_back(kHex[(unit >> shift) & 0xF]);
+        }
+      }
+    }
+    return text + "\"";
+  } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+    return "nullptr";
+  } else if constexpr (IsPrintable<T>::value) {
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+  } else {
+    return "(unprintable)";
+  }
+}
+
+// Reports a failure unless |compare(actual, expected)| holds. Returns
+// whether it held.
+template <typename A, typename B, typename Compare>
+bool CheckOp(const A& a,
+             const B& b,
+             Compare compare,
+             const char* expression,
+             const char* file,
+             int line) {
+  if (compare(a, b)) {
+    return true;
+  }
+  ReportTestFailure(file, line,
+                    std::string("Expected: ") + expression + "\n  Actual: " +
+                        Describe(a) + " vs " + Describe(b));
+  return false;
+}
+
+}  // namespace test_internal
+
+// Defines and registers a test. Use it at namespace scope, normally inside
+// an anonymous namespace.
+#define RUNNER_TEST(suite, name)                                        \
+  void RunnerTest_##suite##_##name();                                   \
+  [[maybe_unused]] const bool runner_test_##suite##_##name =            \
+      RegisterTest(#suite, #name, RunnerTest_##suite##_##name);         \
+  void RunnerTest_##suite##_##name()
+
+#define RUNNER_TEST_CHECK(condition, on_failure)                        \
+  do {                                                                  \
+    if (!(condition)) {                                                 \
+      ReportTestFailure(__FILE__, __LINE__, "Expected: " #condition);   \
+      on_failure;                                                       \
+    }                                                                   \
+  } while (0)
+
+#define RUNNER_TEST_CHECK_OP(a, op, b, on_failure)                      \
+  do {                                                                  \
+    if (!test_internal::CheckOp(                                        \
+            (a), (b),                                                   \
+            [](const auto& x, const auto& y) { return x op y; },        \
+            #a " " #op " " #b, __FILE__, __LINE__)) {                   \
+      on_failure;                                                       \
+    }                                                                   \
+  } while (0)
+
+#define EXPECT_TRUE(condition) RUNNER_TEST_CHECK(condition, (void)0)
+#define EXPECT_FALSE(condition) RUNNER_TEST_CHECK(!(condition), (void)0)
+#define EXPECT_EQ(a, b) RUNNER_TEST_CHECK_OP(a, ==, b, (void)0)
+#define EXPECT_NE(a, b) RUNNER_TEST_CHECK_OP(a, !=, b, (void)0)
+#define EXPECT_LT(a, b) RUNNER_TEST_CHECK_OP(a, <, b, (void)0)
+#define EXPECT_LE(a, b) RUNNER_TEST_CHECK_OP(a, <=, b, (void)0)
+#define EXPECT_GT(a, b) RUNNER_TEST_CHECK_OP(a, >, b, (void)0)
+#define EXPECT_GE(a, b) RUNNER_TEST_CHECK_OP(a, >=, b, (void)0)
+
+#define ASSERT_TRUE(condition) RUNNER_TEST_CHECK(condition, return)
+#define ASSERT_FALSE(condition) RUNNER_TEST_CHECK(!(condition), return)
+#define ASSERT_EQ(a, b) RUNNER_TEST_CHECK_OP(a, ==, b, return)
+#define ASSERT_NE(a, b) RUNNER_TEST_CHECK_OP(a, !=, b, return)
+
+#endif  // RUNNER_TESTS_TEST_H_
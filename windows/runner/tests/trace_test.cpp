@@ -0,0 +1,170 @@
+#include "trace.h"
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "test.h"
+
+namespace {
+
+// An exported event, as read back from the JSON.
+struct ExportedEvent {
+  std::string phase;
+  int64_t tid = 0;
+  double ts = 0;
+  double dur = -1;
+  std::string id;
+  std::string scope;
+};
+
+// Exports the trace, checks that it parses, and returns the events named
+// |name|. Tracing state is process-wide, so each test records under names
+// of its own.
+std::vector<ExportedEvent> ExportedEvents(std::string_view name) {
+  std::string json = ExportChromeTrace();
+  JsonDocument document;
+  std::string error;
+  std::vector<ExportedEvent> events;
+  if (!document.Parse(json, &error)) {
+    ReportTestFailure(__FILE__, __LINE__, "Export is not JSON: " + error);
+    return events;
+  }
+  EXPECT_EQ(document.root().Find("displayTimeUnit").GetString(), "ms");
+  JsonValue trace_events = document.root().Find("traceEvents");
+  EXPECT_EQ(trace_events.type(), JsonType::kArray);
+  trace_events.ForEachElement([&](JsonValue value) {
+    EXPECT_EQ(value.Find("cat").GetString(), "runner");
+    EXPECT_EQ(value.Find("pid").GetNumber(), 1.0);
+    if (value.Find("name").GetString() != name) {
+      return;
+    }
+    ExportedEvent event;
+    event.phase = std::string(value.Find("ph").GetString());
+    value.Find("tid").GetInt64(&event.tid);
+    event.ts = value.Find("ts").GetNumber();
+    if (value.Find("dur").exists()) {
+      event.dur = value.Find("dur").GetNumber();
+    }
+    event.id = std::string(value.Find("id").GetString());
+    event.scope = std::string(value.Find("s").GetString());
+    events.push_back(event);
+  });
+  return events;
+}
+
+RUNNER_TEST(Trace, RecordsNothingWhileStopped) {
+  StopTracing();
+  EXPECT_FALSE(IsTracingEnabled());
+  {
+    RUNNER_TRACE_SCOPE("Trace.Stopped");
+    RUNNER_TRACE_INSTANT("Trace.Stopped");
+    TraceAsyncBegin("Trace.Stopped", 1);
+    TraceAsyncEnd("Trace.Stopped", 1);
+  }
+  EXPECT_EQ(ExportedEvents("Trace.Stopped").size(), 0u);
+}
+
+RUNNER_TEST(Trace, RecordsSpans) {
+  StartTracing();
+  EXPECT_TRUE(IsTracingEnabled());
+  {
+    RUNNER_TRACE_SCOPE("Trace.Outer");
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    {
+      RUNNER_TRACE_SCOPE("Trace.Inner");
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  StopTracing();
+  std::vector<ExportedEvent> outer = ExportedEvents("Trace.Outer");
+  std::vector<ExportedEvent> inner = ExportedEvents("Trace.Inner");
+  ASSERT_EQ(outer.size(), 1u);
+  ASSERT_EQ(inner.size(), 1u);
+  EXPECT_EQ(outer[0].phase, "X");
+  EXPECT_EQ(inner[0].phase, "X");
+  EXPECT_EQ(outer[0].tid, inner[0].tid);
+  // Microseconds since |StartTracing|.
+  EXPECT_GE(outer[0].ts, 0.0);
+  EXPECT_GE(outer[0].dur, 3000.0);
+  EXPECT_GE(inner[0].dur, 1000.0);
+  // The inner span lies within the outer one.
+  EXPECT_GE(inner[0].ts, outer[0].ts + 2000.0);
+  EXPECT_LE(inner[0].ts + inner[0].dur, outer[0].ts + outer[0].dur);
+}
+
+RUNNER_TEST(Trace, RecordsInstants) {
+  StartTracing();
+  RUNNER_TRACE_INSTANT("Trace.Instant");
+  RUNNER_TRACE_INSTANT("Trace.Instant");
+  StopTracing();
+  std::vector<ExportedEvent> events = ExportedEvents("Trace.Instant");
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[0].phase, "i");
+  EXPECT_EQ(events[0].scope, "t");
+  EXPECT_EQ(events[0].dur, -1.0);
+  EXPECT_LE(events[0].ts, events[1].ts);
+}
+
+RUNNER_TEST(Trace, RecordsAsyncSpansAcrossThreads) {
+  StartTracing();
+  TraceAsyncBegin("Trace.Async", 0xABCDEF);
+  std::thread thread([] { TraceAsyncEnd("Trace.Async", 0xABCDEF); });
+  thread.join();
+  StopTracing();
+  std::vector<ExportedEvent> events = ExportedEvents("Trace.Async");
+  ASSERT_EQ(events.size(), 2u);
+  // Events are exported a thread at a time, the main thread's first.
+  EXPECT_EQ(events[0].phase, "b");
+  EXPECT_EQ(events[1].phase, "e");
+  EXPECT_EQ(events[0].id, "0xabcdef");
+  EXPECT_EQ(events[1].id, "0xabcdef");
+  EXPECT_NE(events[0].tid, events[1].tid);
+  EXPECT_LE(events[0].ts, events[1].ts);
+}
+
+RUNNER_TEST(Trace, EscapesNames) {
+  StartTracing();
+  RUNNER_TRACE_INSTANT("Trace.\"Quoted\\Name\"");
+  StopTracing();
+  EXPECT_EQ(ExportedEvents("Trace.\"Quoted\\Name\"").size(), 1u);
+}
+
+RUNNER_TEST(Trace, KeepsEventsAcrossRestarts) {
+  StartTracing();
+  RUNNER_TRACE_INSTANT("Trace.BeforeRestart");
+  StopTracing();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  StartTracing();
+  RUNNER_TRACE_INSTANT("Trace.AfterRestart");
+  StopTracing();
+  // Timestamps are relative to the latest start, so earlier events are
+  // negative, and must still be valid numbers.
+  std::vector<ExportedEvent> before = ExportedEvents("Trace.BeforeRestart");
+  std::vector<ExportedEvent> after = ExportedEvents("Trace.AfterRestart");
+  ASSERT_EQ(before.size(), 1u);
+  ASSERT_EQ(after.size(), 1u);
+  EXPECT_LE(before[0].ts, -1000.0);
+  EXPECT_GE(after[0].ts, 0.0);
+}
+
+RUNNER_TEST(Trace, DropsEventsWhenAThreadsBufferIsFull) {
+  // A new thread starts with an empty buffer, which holds 32768 events.
+  constexpr uint64_t kRecorded = 32768 + 100;
+  uint64_t dropped = DroppedTraceEventCount();
+  StartTracing();
+  std::thread thread([] {
+    for (uint64_t i = 0; i < kRecorded; ++i) {
+      RUNNER_TRACE_INSTANT("Trace.Flood");
+    }
+  });
+  thread.join();
+  StopTracing();
+  EXPECT_EQ(DroppedTraceEventCount() - dropped, 100u);
+  EXPECT_EQ(ExportedEvents("Trace.Flood").size(), 32768u);
+}
+
+}  // namespace
@@ -0,0 +1,258 @@
+#include "utf_transcoder.h"
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "test.h"
+
+namespace {
+
+constexpr std::string_view kReplacement = "\xEF\xBF\xBD";
+
+// A straightforward one-unit-at-a-time encoder to check the block converters
+// against. Returns nullopt where |policy| is kFail and the input has an
+// unpaired surrogate.
+std::optional<std::string> ReferenceUtf8(std::u16string_view input,
+                                         InvalidUtf16Policy policy) {
+  std::string output;
+  for (size_t i = 0; i < input.size(); ++i) {
+    uint32_t c = input[i];
+    if (c >= 0xD800 && c <= 0xDFFF) {
+      uint32_t next = i + 1 < input.size() ? input[i + 1] : 0;
+      if (c <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF) {
+        c = 0x10000 + ((c - 0xD800) << 10) + (next - 0xDC00);
+        ++i;
+      } else if (policy == InvalidUtf16Policy::kFail) {
+        return std::nullopt;
+      } else {
+        c = 0xFFFD;
+      }
+    }
+    if (c < 0x80) {
+      output.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+      output.push_back(static_cast<char>(0xC0 | (c >> 6)));
+      output.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+      output.push_back(static_cast<char>(0xE0 | (c >> 12)));
+      output.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      output.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+      output.push_back(static_cast<char>(0xF0 | (c >> 18)));
+      output.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+      output.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+      output.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+  }
+  return output;
+}
+
+// Converts |input| with |ConvertUtf16ToUtf8|, or returns nullopt if it
+// failed.
+std::optional<std::string> Convert(std::u16string_view input,
+                                   InvalidUtf16Policy policy) {
+  std::string output(MaxUtf8Length(input.size()), '\0');
+  size_t written =
+      ConvertUtf16ToUtf8(input.data(), input.size(), output.data(), policy);
+  if (written == kUtf8ConversionFailed) {
+    return std::nullopt;
+  }
+  output.resize(written);
+  return output;
+}
+
+// Checks every entry point against the reference for both policies.
+void ExpectMatchesReference(std::u16string_view input) {
+  for (InvalidUtf16Policy policy :
+       {InvalidUtf16Policy::kFail, InvalidUtf16Policy::kReplace}) {
+    std::optional<std::string> expected = ReferenceUtf8(input, policy);
+    std::optional<std::string> actual = Convert(input, policy);
+    EXPECT_EQ(actual.has_value(), expected.has_value());
+    if (actual && expected) {
+      EXPECT_EQ(*actual, *expected);
+    }
+
+    std::string appended = "prefix";
+    bool appended_ok = AppendUtf16AsUtf8(input, &appended, policy);
+    EXPECT_EQ(appended_ok, expected.has_value());
+    EXPECT_EQ(appended, expected ? "prefix" + *expected : "prefix");
+
+    Utf8Buffer buffer;
+    std::string_view buffered = buffer.Convert(input, policy);
+    EXPECT_EQ(buffered, expected ? std::string_view(*expected) : "");
+  }
+}
+
+RUNNER_TEST(UtfTranscoder, ConvertsEachEncodedLength) {
+  std::string utf8;
+  ASSERT_TRUE(AppendUtf16AsUtf8(u"a\u00E9\u4E2D\U0001F600", &utf8));
+  EXPECT_EQ(utf8, "a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80");
+  // The edges of each encoded length.
+  utf8.clear();
+  ASSERT_TRUE(AppendUtf16AsUtf8(
+      u"\u007F\u0080\u07FF\u0800\uFFFF\U00010000\U0010FFFF", &utf8));
+  EXPECT_EQ(utf8,
+            "\x7F\xC2\x80\xDF\xBF\xE0\xA0\x80\xEF\xBF\xBF\xF0\x90\x80\x80"
+            "\xF4\x8F\xBF\xBF");
+}
+
+RUNNER_TEST(UtfTranscoder, EmptyInput) {
+  std::string utf8 = "kept";
+  EXPECT_TRUE(AppendUtf16AsUtf8(u"", &utf8));
+  EXPECT_EQ(utf8, "kept");
+  Utf8Buffer buffer;
+  EXPECT_TRUE(buffer.Convert(u"").empty());
+  EXPECT_EQ(ConvertUtf16ToUtf8(nullptr, 0, nullptr), 0u);
+}
+
+RUNNER_TEST(UtfTranscoder, LoneHighSurrogateAtEnd) {
+  std::u16string input = u"abc";
+  input.push_back(0xD83D);
+  std::string utf8 = "kept";
+  EXPECT_FALSE(AppendUtf16AsUtf8(input, &utf8, InvalidUtf16Policy::kFail));
+  EXPECT_EQ(utf8, "kept");
+  EXPECT_TRUE(AppendUtf16AsUtf8(input, &utf8, InvalidUtf16Policy::kReplace));
+  EXPECT_EQ(utf8, "keptabc" + std::string(kReplacement));
+}
+
+RUNNER_TEST(UtfTranscoder, LoneLowSurrogateAtStart) {
+  std::u16string input;
+  input.push_back(0xDE00);
+  input += u"abc";
+  EXPECT_FALSE(Convert(input, InvalidUtf16Policy::kFail).has_value());
+  EXPECT_EQ(Convert(input, InvalidUtf16Policy::kReplace).value_or(""),
+            std::string(kReplacement) + "abc");
+}
+
+RUNNER_TEST(UtfTranscoder, ReplacesEachUnpairedUnit) {
+  // High-high-low: the first high is unpaired, the rest form a pair. Then a
+  // high followed by ASCII, and a low after a complete pair.
+  std::u16string input = {0xD83D, 0xD83D, 0xDE00, 0xD83D, u'x',
+                          0xD83D, 0xDE00, 0xDE00};
+  std::string expected = std::string(kReplacement) + "\xF0\x9F\x98\x80" +
+                         std::string(kReplacement) + "x" +
+                         "\xF0\x9F\x98\x80" + std::string(kReplacement);
+  EXPECT_EQ(Convert(input, InvalidUtf16Policy::kReplace).value_or(""),
+            expected);
+  EXPECT_FALSE(Convert(input, InvalidUtf16Policy::kFail).has_value());
+}
+
+RUNNER_TEST(UtfTranscoder, SurrogatePairsAcrossBlockBoundaries) {
+  // The block converters take 8, 16 and 32 units at a time. Put a pair, and
+  // each half alone, at every offset around those boundaries, inside ASCII
+  // runs long enough to be handed to them.
+  const std::u16string pair = u"\U0001F600";
+  for (size_t offset = 0; offset <= 72; ++offset) {
+    for (size_t tail : {0u, 1u, 7u, 8u, 40u}) {
+      std::u16string ascii_before(offset, u'a');
+      std::u16string ascii_after(tail, u'b');
+      ExpectMatchesReference(ascii_before + pair + ascii_after);
+      ExpectMatchesReference(ascii_before + pair[0] + ascii_after);
+      ExpectMatchesReference(ascii_before + pair[1] + ascii_after);
+      ExpectMatchesReference(ascii_before + u'\u00E9' + ascii_after);
+    }
+  }
+}
+
+RUNNER_TEST(UtfTranscoder, RandomInputMatchesReference) {
+  std::mt19937 random(16);
+  for (int round = 0; round < 2000; ++round) {
+    std::u16string input;
+    size_t length = random() % 200;
+    while (input.size() < length) {
+      uint32_t roll = random() % 100;
+      if (roll < 60) {
+        // ASCII runs of mixed length, so blocks start at varied offsets.
+        input.append(random() % 40,
+                     static_cast<char16_t>(0x20 + random() % 0x5F));
+      } else if (roll < 75) {
+        input.push_back(static_cast<char16_t>(0x80 + random() % 0x780));
+      } else if (roll < 90) {
+        input.push_back(static_cast<char16_t>(0x800 + random() % 0xD000));
+      } else if (roll < 98) {
+        input.push_back(static_cast<char16_t>(0xD800 + random() % 0x400));
+        input.push_back(static_cast<char16_t>(0xDC00 + random() % 0x400));
+      } else {
+        input.push_back(static_cast<char16_t>(0xD800 + random() % 0x800));
+      }
+    }
+    ExpectMatchesReference(input);
+  }
+}
+
+RUNNER_TEST(UtfTranscoder, LongInputs) {
+  // Longer than any chunking a caller might do, with a pair at the end.
+  std::u16string input(100000, u'z');
+  input += u"\U0001F600";
+  ExpectMatchesReference(input);
+  input.back() = u'z';
+  ExpectMatchesReference(input);
+}
+
+RUNNER_TEST(UtfTranscoder, BufferKeepsStorage) {
+  Utf8Buffer buffer;
+  std::u16string input(100, u'a');
+  EXPECT_EQ(buffer.Convert(input).size(), 100u);
+  size_t capacity = buffer.capacity();
+  EXPECT_GE(capacity, MaxUtf8Length(100));
+  EXPECT_EQ(buffer.Convert(u"short"), "short");
+  EXPECT_EQ(buffer.capacity(), capacity);
+  // Growing by a little at a time still grows geometrically.
+  buffer.Convert(std::u16string(101, u'a'));
+  EXPECT_GE(buffer.capacity(), 2 * capacity);
+}
+
+RUNNER_TEST(UtfTranscoder, Utf8ToUtf16) {
+  std::u16string utf16;
+  AppendUtf8AsUtf16("a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80", &utf16);
+  EXPECT_EQ(utf16, std::u16string(u"a\u00E9\u4E2D\U0001F600"));
+}
+
+RUNNER_TEST(UtfTranscoder, Utf8ToUtf16ReplacesInvalidBytes) {
+  auto convert = [](std::string_view input) {
+    std::u16string utf16;
+    AppendUtf8AsUtf16(input, &utf16);
+    return utf16;
+  };
+  // An overlong '/', one replacement per byte.
+  EXPECT_EQ(convert("\xC0\xAF"), std::u16string(u"\uFFFD\uFFFD"));
+  // A truncated sequence at the end.
+  EXPECT_EQ(convert("a\xE4\xB8"), std::u16string(u"a\uFFFD\uFFFD"));
+  // An encoded surrogate.
+  EXPECT_EQ(convert("\xED\xA0\x80"), std::u16string(u"\uFFFD\uFFFD\uFFFD"));
+  // Above U+10FFFF.
+  EXPECT_EQ(convert("\xF4\x90\x80\x80"),
+            std::u16string(u"\uFFFD\uFFFD\uFFFD\uFFFD"));
+  // A stray continuation byte between valid characters.
+  EXPECT_EQ(convert("a\x80" "b"), std::u16string(u"a\uFFFDb"));
+}
+
+RUNNER_TEST(UtfTranscoder, RoundTripsValidText) {
+  std::mt19937 random(17);
+  for (int round = 0; round < 500; ++round) {
+    std::u16string input;
+    size_t length = random() % 100;
+    while (input.size() < length) {
+      uint32_t code_point = random() % 0x110000;
+      if (code_point >= 0xD800 && code_point <= 0xDFFF) {
+        continue;
+      }
+      if (code_point >= 0x10000) {
+        code_point -= 0x10000;
+        input.push_back(static_cast<char16_t>(0xD800 + (code_point >> 10)));
+        input.push_back(static_cast<char16_t>(0xDC00 + (code_point & 0x3FF)));
+      } else {
+        input.push_back(static_cast<char16_t>(code_point));
+      }
+    }
+    std::string utf8;
+    ASSERT_TRUE(AppendUtf16AsUtf8(input, &utf8));
+    std::u16string back;
+    AppendUtf8AsUtf16(utf8, &back);
+    EXPECT_EQ(back, input);
+  }
+}
+
+}  // namespace
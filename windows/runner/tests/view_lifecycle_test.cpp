@@ -0,0 +1,558 @@
+#include "view_lifecycle.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "controller_pool.h"
+#include "test.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+using TimePoint = ViewLifecycleManager::Clock::time_point;
+
+constexpr size_t kMiB = 1024 * 1024;
+
+// Records the manager's decisions, and tracks each view's state the way a
+// real delegate would see it, failing on transitions that make no sense.
+class RecordingDelegate : public ViewLifecycleDelegate {
+ public:
+  // ViewLifecycleDelegate:
+  void SuspendView(LifecycleViewId view) override {
+    Transition(view, "suspend", ViewLifecycleState::kActive,
+               ViewLifecycleState::kSuspended);
+  }
+  void ResumeView(LifecycleViewId view) override {
+    Transition(view, "resume", ViewLifecycleState::kSuspended,
+               ViewLifecycleState::kActive);
+  }
+  void DiscardView(LifecycleViewId view) override {
+    ViewLifecycleState from = states[view];
+    EXPECT_NE(from, ViewLifecycleState::kDiscarded);
+    Transition(view, "discard", from, ViewLifecycleState::kDiscarded);
+  }
+  void RestoreView(LifecycleViewId view) override {
+    Transition(view, "restore", ViewLifecycleState::kDiscarded,
+               ViewLifecycleState::kActive);
+  }
+
+  // Takes the recorded calls, leaving none.
+  std::vector<std::string> TakeCalls() { return std::move(calls); }
+
+  // Views are active until the manager says otherwise.
+  std::map<LifecycleViewId, ViewLifecycleState> states;
+  std::vector<std::string> calls;
+
+ private:
+  void Transition(LifecycleViewId view,
+                  const char* name,
+                  ViewLifecycleState from,
+                  ViewLifecycleState to) {
+    auto it = states.try_emplace(view, ViewLifecycleState::kActive).first;
+    EXPECT_EQ(it->second, from);
+    it->second = to;
+    calls.push_back(std::string(name) + " " + std::to_string(view));
+  }
+};
+
+using Calls = std::vector<std::string>;
+
+ViewLifecycleOptions Options() {
+  ViewLifecycleOptions options;
+  options.active_view_bytes = 64 * kMiB;
+  options.suspended_view_bytes = 16 * kMiB;
+  options.hidden_suspend_delay = milliseconds(5000);
+  options.suspend_retry_delay = milliseconds(10000);
+  return options;
+}
+
+RUNNER_TEST(ViewLifecycle, SuspendsHiddenViewAfterDelay) {
+  RecordingDelegate delegate;
+  ViewLifecycleManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1, now);
+  EXPECT_FALSE(manager.NextUpdateTime().has_value());
+  manager.SetVisible(1, false, now);
+  ASSERT_TRUE(manager.NextUpdateTime().has_value());
+  EXPECT_TRUE(*manager.NextUpdateTime() == now + milliseconds(5000));
+
+  manager.Update(now + milliseconds(4999));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kActive);
+  manager.Update(now + milliseconds(5000));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kSuspended);
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 1"}));
+  EXPECT_FALSE(manager.NextUpdateTime().has_value());
+  EXPECT_EQ(manager.EstimatedMemory(), 16 * kMiB);
+}
+
+RUNNER_TEST(ViewLifecycle, ShowingResumesSuspendedView) {
+  RecordingDelegate delegate;
+  ViewLifecycleManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1, now);
+  manager.SetVisible(1, false, now);
+  manager.Update(now += milliseconds(6000));
+  manager.SetVisible(1, true, now += milliseconds(1));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kActive);
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 1", "resume 1"}));
+  // Showing a visible view again does nothing.
+  manager.SetVisible(1, true, now);
+  EXPECT_TRUE(delegate.calls.empty());
+  EXPECT_EQ(manager.stats().suspended, 1u);
+  EXPECT_EQ(manager.stats().resumed, 1u);
+}
+
+RUNNER_TEST(ViewLifecycle, FocusResumesAndRestartsIdlePeriod) {
+  RecordingDelegate delegate;
+  ViewLifecycleManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1, now);
+  manager.SetVisible(1, false, now);
+  manager.Update(now += milliseconds(5000));
+  // Focus through WM_SETFOCUS brings a hidden view back.
+  manager.Touch(1, now += milliseconds(100));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kActive);
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 1", "resume 1"}));
+  // It stays hidden, so it is suspended again a full delay later.
+  EXPECT_TRUE(*manager.NextUpdateTime() == now + milliseconds(5000));
+  manager.Update(now + milliseconds(4999));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kActive);
+  manager.Update(now + milliseconds(5000));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kSuspended);
+}
+
+RUNNER_TEST(ViewLifecycle, ViewBudgetDiscardsLeastRecentlyUsed) {
+  RecordingDelegate delegate;
+  ViewLifecycleOptions options = Options();
+  options.max_live_views = 2;
+  ViewLifecycleManager manager(&delegate, options);
+  TimePoint now;
+  for (LifecycleViewId view = 1; view <= 3; ++view) {
+    manager.AddView(view, now);
+  }
+  // All visible: over budget, but nothing can be demoted.
+  EXPECT_TRUE(delegate.calls.empty());
+
+  manager.Touch(2, now += milliseconds(1));
+  manager.Touch(1, now += milliseconds(1));
+  manager.Touch(3, now += milliseconds(1));
+  manager.SetVisible(1, false, now += milliseconds(1));
+  // The only hidden view goes, straight to discarded: suspending would not
+  // reduce the number of live views.
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"discard 1"}));
+
+  manager.SetVisible(1, true, now += milliseconds(1));
+  manager.SetVisible(2, false, now += milliseconds(1));
+  manager.SetVisible(3, false, now += milliseconds(1));
+  // Showing 1 restores it and makes three live views; 2 is then the least
+  // recently used hidden view once it is hidden.
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"restore 1", "discard 2"}));
+  EXPECT_EQ(manager.StateOf(3), ViewLifecycleState::kActive);
+  EXPECT_EQ(manager.stats().discarded, 2u);
+  EXPECT_EQ(manager.stats().restored, 1u);
+}
+
+RUNNER_TEST(ViewLifecycle, DemotesByLastUseNotByHiddenOrder) {
+  RecordingDelegate delegate;
+  ViewLifecycleOptions options = Options();
+  options.max_live_views = 3;
+  ViewLifecycleManager manager(&delegate, options);
+  TimePoint now;
+  for (LifecycleViewId view = 1; view <= 3; ++view) {
+    manager.AddView(view, now);
+  }
+  manager.SetVisible(1, false, now += milliseconds(1));
+  manager.SetVisible(2, false, now += milliseconds(1));
+  // 1 was hidden first but used more recently.
+  manager.Touch(1, now += milliseconds(1));
+  manager.AddView(4, now += milliseconds(1));
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"discard 2"}));
+  manager.AddView(5, now += milliseconds(1));
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"discard 1"}));
+}
+
+RUNNER_TEST(ViewLifecycle, MemoryBudgetSuspendsBeforeDiscarding) {
+  RecordingDelegate delegate;
+  ViewLifecycleOptions options = Options();
+  options.memory_budget_bytes = 150 * kMiB;
+  ViewLifecycleManager manager(&delegate, options);
+  TimePoint now;
+  for (LifecycleViewId view = 1; view <= 3; ++view) {
+    manager.AddView(view, now);
+  }
+  EXPECT_EQ(manager.EstimatedMemory(), 192 * kMiB);
+  manager.SetVisible(1, false, now += milliseconds(1));
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 1"}));
+  EXPECT_EQ(manager.EstimatedMemory(), 144 * kMiB);
+  manager.SetVisible(2, false, now += milliseconds(1));
+  EXPECT_TRUE(delegate.calls.empty());
+}
+
+RUNNER_TEST(ViewLifecycle, MemoryBudgetDiscardsWhenSuspendingIsNotEnough) {
+  RecordingDelegate delegate;
+  ViewLifecycleOptions options = Options();
+  options.memory_budget_bytes = 100 * kMiB;
+  ViewLifecycleManager manager(&delegate, options);
+  TimePoint now;
+  for (LifecycleViewId view = 1; view <= 3; ++view) {
+    manager.AddView(view, now);
+  }
+  manager.SetVisible(1, false, now += milliseconds(1));
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 1", "discard 1"}));
+  manager.SetVisible(2, false, now += milliseconds(1));
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 2"}));
+  EXPECT_EQ(manager.EstimatedMemory(), 80 * kMiB);
+}
+
+RUNNER_TEST(ViewLifecycle, RetriesFailedSuspension) {
+  RecordingDelegate delegate;
+  ViewLifecycleManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1, now);
+  manager.SetVisible(1, false, now);
+  manager.Update(now += milliseconds(5000));
+  manager.OnSuspendFailed(1, now);
+  delegate.states[1] = ViewLifecycleState::kActive;
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kActive);
+  EXPECT_EQ(manager.stats().suspend_failures, 1u);
+  // A failure report for a view that is not suspending is ignored.
+  manager.OnSuspendFailed(1, now);
+  EXPECT_EQ(manager.stats().suspend_failures, 1u);
+
+  EXPECT_TRUE(*manager.NextUpdateTime() == now + milliseconds(10000));
+  manager.Update(now + milliseconds(9999));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kActive);
+  manager.Update(now + milliseconds(10000));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kSuspended);
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 1", "suspend 1"}));
+}
+
+RUNNER_TEST(ViewLifecycle, FailedSuspensionFallsBackToDiscardOverBudget) {
+  RecordingDelegate delegate;
+  ViewLifecycleOptions options = Options();
+  options.memory_budget_bytes = 150 * kMiB;
+  ViewLifecycleManager manager(&delegate, options);
+  TimePoint now;
+  for (LifecycleViewId view = 1; view <= 3; ++view) {
+    manager.AddView(view, now);
+  }
+  manager.SetVisible(1, false, now += milliseconds(1));
+  manager.OnSuspendFailed(1, now);
+  delegate.states[1] = ViewLifecycleState::kActive;
+  // Over budget again and 1 may not be suspended yet, so it is discarded.
+  manager.Update(now += milliseconds(1));
+  EXPECT_EQ(delegate.TakeCalls(), Calls({"suspend 1", "discard 1"}));
+}
+
+RUNNER_TEST(ViewLifecycle, AddAndRemoveViews) {
+  RecordingDelegate delegate;
+  ViewLifecycleManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1, now);
+  manager.AddView(1, now);
+  manager.AddView(2, now);
+  EXPECT_EQ(manager.view_count(), 2u);
+  manager.SetVisible(2, false, now);
+  manager.RemoveView(2);
+  manager.RemoveView(99);
+  EXPECT_EQ(manager.view_count(), 1u);
+  EXPECT_FALSE(manager.StateOf(2).has_value());
+  EXPECT_FALSE(manager.NextUpdateTime().has_value());
+  // Calls for unknown views are ignored.
+  manager.SetVisible(2, true, now);
+  manager.Touch(2, now);
+  manager.OnSuspendFailed(2, now);
+  EXPECT_TRUE(delegate.calls.empty());
+}
+
+enum class EventType : uint8_t { kShow, kHide, kTouch, kUpdate, kFail };
+
+struct TraceEvent {
+  EventType type;
+  LifecycleViewId view;
+  milliseconds delay;
+};
+
+// A scrolling feed like the benchmark's, with the odd failed suspension.
+std::vector<TraceEvent> VisibilityTrace(uint32_t seed,
+                                        LifecycleViewId view_count,
+                                        size_t length) {
+  std::mt19937 random(seed);
+  std::vector<TraceEvent> trace;
+  for (size_t i = 0; i < length; ++i) {
+    LifecycleViewId view = 1 + random() % view_count;
+    uint32_t roll = random() % 100;
+    EventType type = roll < 30   ? EventType::kShow
+                     : roll < 60 ? EventType::kHide
+                     : roll < 75 ? EventType::kTouch
+                     : roll < 97 ? EventType::kUpdate
+                                 : EventType::kFail;
+    trace.push_back(TraceEvent{type, view, milliseconds(random() % 2000)});
+  }
+  return trace;
+}
+
+// What the test knows about a view from the events it sent.
+struct ViewModel {
+  bool visible = true;
+  TimePoint hidden_since;
+  TimePoint retry_after;
+};
+
+// Replays |trace| and checks the policy's guarantees after every event.
+// Returns the delegate's calls.
+Calls ReplayAndCheck(const std::vector<TraceEvent>& trace,
+                     LifecycleViewId view_count,
+                     const ViewLifecycleOptions& options) {
+  RecordingDelegate delegate;
+  ViewLifecycleManager manager(&delegate, options);
+  std::map<LifecycleViewId, ViewModel> model;
+  TimePoint now;
+  for (LifecycleViewId view = 1; view <= view_count; ++view) {
+    manager.AddView(view, now);
+    model[view];
+  }
+
+  for (size_t step = 0; step < trace.size(); ++step) {
+    const TraceEvent& event = trace[step];
+    now += event.delay;
+    // The runner's timer fires whenever the manager asks for an update.
+    std::optional<TimePoint> due;
+    while ((due = manager.NextUpdateTime()) && *due <= now) {
+      manager.Update(*due);
+      // An update at the requested time deals with what was due by then.
+      std::optional<TimePoint> next = manager.NextUpdateTime();
+      if (next && *next <= *due) {
+        ReportTestFailure(__FILE__, __LINE__, "NextUpdateTime did not advance");
+        return delegate.calls;
+      }
+    }
+    ViewModel& view = model[event.view];
+    switch (event.type) {
+      case EventType::kShow:
+        if (!view.visible) {
+          view.visible = true;
+        }
+        manager.SetVisible(event.view, true, now);
+        break;
+      case EventType::kHide:
+        if (view.visible) {
+          view.visible = false;
+          view.hidden_since = now;
+        }
+        manager.SetVisible(event.view, false, now);
+        break;
+      case EventType::kTouch:
+        view.hidden_since = now;
+        manager.Touch(event.view, now);
+        break;
+      case EventType::kUpdate:
+        manager.Update(now);
+        break;
+      case EventType::kFail:
+        if (manager.StateOf(event.view) == ViewLifecycleState::kSuspended) {
+          view.retry_after = now + options.suspend_retry_delay;
+          delegate.states[event.view] = ViewLifecycleState::kActive;
+        }
+        manager.OnSuspendFailed(event.view, now);
+        // Failures are reported asynchronously; the next update applies
+        // the budget again.
+        manager.Update(now);
+        break;
+    }
+
+    size_t live = 0;
+    size_t hidden_live = 0;
+    for (const auto& [id, expected] : model) {
+      ViewLifecycleState state = *manager.StateOf(id);
+      // The delegate has been told about every change.
+      auto known = delegate.states.find(id);
+      EXPECT_EQ(known == delegate.states.end() ? ViewLifecycleState::kActive
+                                               : known->second,
+                state);
+      if (expected.visible) {
+        EXPECT_EQ(state, ViewLifecycleState::kActive);
+      }
+      if (state != ViewLifecycleState::kDiscarded) {
+        ++live;
+        hidden_live += expected.visible ? 0 : 1;
+      }
+      // Views hidden for long enough have been suspended, unless a failed
+      // suspension is still waiting to be retried.
+      if (!expected.visible &&
+          now - expected.hidden_since >= options.hidden_suspend_delay &&
+          now >= expected.retry_after) {
+        EXPECT_NE(state, ViewLifecycleState::kActive);
+      }
+    }
+    // Being over budget is only allowed once every hidden view is gone.
+    if (live > options.max_live_views ||
+        manager.EstimatedMemory() > options.memory_budget_bytes) {
+      EXPECT_EQ(hidden_live, 0u);
+    }
+    if (CurrentTestFailed()) {
+      ReportTestFailure(__FILE__, __LINE__,
+                        "at trace step " + std::to_string(step));
+      break;
+    }
+  }
+  return delegate.calls;
+}
+
+RUNNER_TEST(ViewLifecycle, VisibilityTraceKeepsPolicyInvariants) {
+  ViewLifecycleOptions options = Options();
+  options.max_live_views = 6;
+  options.memory_budget_bytes = 256 * kMiB;
+  for (uint32_t seed = 1; seed <= 20; ++seed) {
+    Calls calls = ReplayAndCheck(VisibilityTrace(seed, 16, 2000), 16, options);
+    EXPECT_FALSE(calls.empty());
+    if (CurrentTestFailed()) {
+      ReportTestFailure(__FILE__, __LINE__, "seed " + std::to_string(seed));
+      return;
+    }
+  }
+}
+
+RUNNER_TEST(ViewLifecycle, VisibilityTraceIsDeterministic) {
+  ViewLifecycleOptions options = Options();
+  options.max_live_views = 4;
+  options.memory_budget_bytes = 160 * kMiB;
+  std::vector<TraceEvent> trace = VisibilityTrace(42, 10, 3000);
+  Calls first = ReplayAndCheck(trace, 10, options);
+  Calls second = ReplayAndCheck(trace, 10, options);
+  EXPECT_EQ(first.size(), second.size());
+  EXPECT_TRUE(first == second);
+}
+
+// A surface handle that is empty when zero.
+struct FakeSurface {
+  uint64_t id = 0;
+
+  explicit operator bool() const { return id != 0; }
+};
+
+// Creates surfaces when |Finish| is called, like an environment still
+// starting up.
+class DeferredSurfaceSource : public ControllerSource<FakeSurface> {
+ public:
+  // ControllerSource:
+  void CreateController(CreateCallback callback) override {
+    pending_.push_back(std::move(callback));
+  }
+  void DestroyController(FakeSurface surface) override {}
+
+  // Completes every pending creation.
+  void Finish() {
+    std::vector<CreateCallback> pending = std::move(pending_);
+    pending_.clear();
+    for (CreateCallback& callback : pending) {
+      callback(FakeSurface{next_id_++});
+    }
+  }
+
+ private:
+  std::vector<CreateCallback> pending_;
+  uint64_t next_id_ = 1;
+};
+
+// Claims, releases and reclaims views' surfaces the way flutter_window.cpp
+// does for the lifecycle manager.
+class SurfaceHost : public ViewLifecycleDelegate {
+ public:
+  SurfaceHost() : pool_(&source_, PoolOptions()) {}
+
+  struct View {
+    FakeSurface surface;
+    ControllerPool<FakeSurface>::ClaimId claim_id = 0;
+  };
+
+  void AddView(LifecycleViewId id) {
+    views_.try_emplace(id);
+    Claim(id);
+  }
+
+  const View& view(LifecycleViewId id) const { return views_.at(id); }
+  DeferredSurfaceSource& source() { return source_; }
+
+  // ViewLifecycleDelegate:
+  void SuspendView(LifecycleViewId id) override {}
+  void ResumeView(LifecycleViewId id) override {}
+  void DiscardView(LifecycleViewId id) override {
+    View& view = views_.at(id);
+    if (!view.surface) {
+      if (view.claim_id != 0) {
+        pool_.CancelClaim(view.claim_id);
+        view.claim_id = 0;
+      }
+      return;
+    }
+    pool_.Return(std::exchange(view.surface, FakeSurface()));
+  }
+  void RestoreView(LifecycleViewId id) override {
+    View& view = views_.at(id);
+    if (!view.surface && view.claim_id == 0) {
+      Claim(id);
+    }
+  }
+
+ private:
+  static ControllerPool<FakeSurface>::Options PoolOptions() {
+    ControllerPool<FakeSurface>::Options options;
+    options.idle_capacity = 2;
+    options.warm_count = 0;
+    return options;
+  }
+
+  void Claim(LifecycleViewId id) {
+    auto answered = std::make_shared<bool>(false);
+    ControllerPool<FakeSurface>::ClaimId claim_id =
+        pool_.Claim([this, id, answered](FakeSurface surface) {
+          *answered = true;
+          View& view = views_.at(id);
+          view.claim_id = 0;
+          view.surface = surface;
+        });
+    if (!*answered) {
+      views_.at(id).claim_id = claim_id;
+    }
+  }
+
+  DeferredSurfaceSource source_;
+  ControllerPool<FakeSurface> pool_;
+  std::map<LifecycleViewId, View> views_;
+};
+
+RUNNER_TEST(ViewLifecycle, ViewDiscardedWhileClaimingIsRestored) {
+  SurfaceHost host;
+  ViewLifecycleOptions options = Options();
+  options.max_live_views = 1;
+  ViewLifecycleManager manager(&host, options);
+  TimePoint now;
+  host.AddView(1);
+  host.AddView(2);
+  manager.AddView(1, now);
+  manager.AddView(2, now);
+
+  // Hidden before its surface arrives: the claim is cancelled.
+  manager.SetVisible(1, false, now += milliseconds(1));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kDiscarded);
+  EXPECT_EQ(host.view(1).claim_id, 0u);
+  host.source().Finish();
+  EXPECT_FALSE(host.view(1).surface);
+  EXPECT_TRUE(host.view(2).surface);
+
+  // Shown again, it claims a surface anew.
+  manager.SetVisible(2, false, now += milliseconds(1));
+  manager.SetVisible(1, true, now += milliseconds(1));
+  EXPECT_EQ(manager.StateOf(1), ViewLifecycleState::kActive);
+  EXPECT_TRUE(host.view(1).surface);
+  EXPECT_FALSE(host.view(2).surface);
+}
+
+}  // namespace
@@ -0,0 +1,581 @@
+#include "view_recovery.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "controller_pool.h"
+#include "simulated_web_view.h"
+#include "test.h"
+#include "web_view_backend.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+using TimePoint = ViewRecoveryManager::Clock::time_point;
+using Calls = std::vector<std::string>;
+
+// Records the manager's decisions.
+class RecordingDelegate : public ViewRecoveryDelegate {
+ public:
+  // ViewRecoveryDelegate:
+  void ReplaceController(RecoveryViewId view) override {
+    Record("replace", view);
+  }
+  void RestartBrowser() override { calls.push_back("restart"); }
+  void AbandonView(RecoveryViewId view) override { Record("abandon", view); }
+  void ViewRecovered(RecoveryViewId view,
+                     std::chrono::nanoseconds recovery_time) override {
+    Record("recovered", view);
+    recovery_times.push_back(recovery_time);
+  }
+
+  // Takes the recorded calls, leaving none.
+  Calls TakeCalls() { return std::move(calls); }
+
+  Calls calls;
+  std::vector<std::chrono::nanoseconds> recovery_times;
+
+ private:
+  void Record(const char* name, RecoveryViewId view) {
+    std::string call = name;
+    call.append(" ").append(std::to_string(view));
+    calls.push_back(std::move(call));
+  }
+};
+
+ViewRecoveryOptions Options() {
+  ViewRecoveryOptions options;
+  options.retry_delay = milliseconds(500);
+  options.max_retry_delay = milliseconds(2000);
+  options.failure_window = milliseconds(60000);
+  options.max_failures = 10;
+  return options;
+}
+
+// Reports a renderer failure of |view| at |now| and has its replacement
+// attach and load at once.
+void FailAndRecover(ViewRecoveryManager* manager,
+                    RecoveryViewId view,
+                    TimePoint now) {
+  manager->OnProcessFailed(view, WebViewProcessFailure::kRendererExited, now);
+  manager->OnReplacementAttached(view, true, now);
+  manager->OnNavigationCompleted(view, now);
+}
+
+RUNNER_TEST(ViewRecovery, RendererFailureIsReplacedAtOnce) {
+  RecordingDelegate delegate;
+  ViewRecoveryManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1);
+  manager.AddView(2);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kRendererExited, now);
+  EXPECT_TRUE(delegate.TakeCalls() == Calls{"replace 1"});
+  EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kReplacing);
+  EXPECT_TRUE(manager.StateOf(2) == ViewRecoveryState::kHealthy);
+
+  manager.OnReplacementAttached(1, true, now + milliseconds(80));
+  EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kRestoring);
+  manager.OnNavigationCompleted(1, now + milliseconds(300));
+  EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kHealthy);
+  EXPECT_TRUE(delegate.TakeCalls() == Calls{"recovered 1"});
+  ASSERT_EQ(delegate.recovery_times.size(), 1u);
+  EXPECT_TRUE(delegate.recovery_times[0] == milliseconds(300));
+
+  const ViewRecoveryStats& stats = manager.stats();
+  EXPECT_EQ(stats.renderer_failures, 1u);
+  EXPECT_EQ(stats.replacements, 1u);
+  EXPECT_EQ(stats.recovered, 1u);
+  EXPECT_TRUE(stats.total_recovery_time == milliseconds(300));
+  EXPECT_TRUE(stats.max_recovery_time == milliseconds(300));
+}
+
+RUNNER_TEST(ViewRecovery, IgnoresFailuresThatNeedNoRecovery) {
+  RecordingDelegate delegate;
+  ViewRecoveryOptions options = Options();
+  options.recover_unresponsive = false;
+  ViewRecoveryManager manager(&delegate, options);
+  TimePoint now;
+  manager.AddView(1);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kFrameRendererExited,
+                          now);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kOther, now);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kRendererUnresponsive,
+                          now);
+  // Unknown views, and views already being replaced.
+  manager.OnProcessFailed(9, WebViewProcessFailure::kRendererExited, now);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kRendererExited, now);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kRendererExited, now);
+  EXPECT_TRUE(delegate.TakeCalls() == Calls{"replace 1"});
+  EXPECT_EQ(manager.stats().ignored_failures, 4u);
+  // Reports out of turn change nothing.
+  manager.OnNavigationCompleted(1, now);
+  EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kReplacing);
+  EXPECT_TRUE(delegate.TakeCalls().empty());
+}
+
+RUNNER_TEST(ViewRecovery, RepeatedFailuresBackOffExponentially) {
+  RecordingDelegate delegate;
+  ViewRecoveryManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1);
+  FailAndRecover(&manager, 1, now);
+  delegate.TakeCalls();
+  const milliseconds expected_delays[] = {
+      milliseconds(500), milliseconds(1000), milliseconds(2000),
+      milliseconds(2000)};
+  for (milliseconds delay : expected_delays) {
+    now += milliseconds(1000);
+    manager.OnProcessFailed(1, WebViewProcessFailure::kRendererExited, now);
+    EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kBackingOff);
+    ASSERT_TRUE(manager.NextUpdateTime().has_value());
+    EXPECT_TRUE(*manager.NextUpdateTime() == now + delay);
+    manager.Update(now + delay - milliseconds(1));
+    EXPECT_TRUE(delegate.TakeCalls().empty());
+    now += delay;
+    manager.Update(now);
+    EXPECT_TRUE(delegate.TakeCalls() == Calls{"replace 1"});
+    EXPECT_FALSE(manager.NextUpdateTime().has_value());
+    manager.OnReplacementAttached(1, true, now);
+    manager.OnNavigationCompleted(1, now);
+    delegate.TakeCalls();
+  }
+}
+
+RUNNER_TEST(ViewRecovery, FailuresOutsideTheWindowAreForgotten) {
+  RecordingDelegate delegate;
+  ViewRecoveryOptions options = Options();
+  options.max_failures = 2;
+  ViewRecoveryManager manager(&delegate, options);
+  TimePoint now;
+  manager.AddView(1);
+  for (int i = 0; i < 5; ++i) {
+    FailAndRecover(&manager, 1, now);
+    now += options.failure_window;
+  }
+  EXPECT_EQ(manager.stats().replacements, 5u);
+  EXPECT_EQ(manager.stats().abandoned, 0u);
+  EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kHealthy);
+}
+
+RUNNER_TEST(ViewRecovery, AbandonsViewsThatKeepFailing) {
+  RecordingDelegate delegate;
+  ViewRecoveryOptions options = Options();
+  options.max_failures = 3;
+  ViewRecoveryManager manager(&delegate, options);
+  TimePoint now;
+  manager.AddView(1);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kRendererExited, now);
+  // Missing replacements count as failures.
+  manager.OnReplacementAttached(1, false, now);
+  EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kBackingOff);
+  now += milliseconds(500);
+  manager.Update(now);
+  manager.OnReplacementAttached(1, false, now);
+  EXPECT_TRUE(manager.StateOf(1) == ViewRecoveryState::kAbandoned);
+  EXPECT_TRUE(delegate.TakeCalls() ==
+              (Calls{"replace 1", "replace 1", "abandon 1"}));
+  EXPECT_EQ(manager.stats().replacement_failures, 2u);
+  EXPECT_EQ(manager.stats().abandoned, 1u);
+  EXPECT_FALSE(manager.NextUpdateTime().has_value());
+  manager.OnProcessFailed(1, WebViewProcessFailure::kRendererExited, now);
+  manager.Update(now + milliseconds(60000));
+  EXPECT_TRUE(delegate.TakeCalls().empty());
+}
+
+RUNNER_TEST(ViewRecovery, RestartsEachFailedBrowserOnce) {
+  RecordingDelegate delegate;
+  ViewRecoveryManager manager(&delegate, Options());
+  TimePoint now;
+  for (RecoveryViewId view = 1; view <= 3; ++view) {
+    manager.AddView(view);
+  }
+  for (RecoveryViewId view = 1; view <= 3; ++view) {
+    manager.OnProcessFailed(view, WebViewProcessFailure::kBrowserExited, now);
+  }
+  EXPECT_TRUE(delegate.TakeCalls() ==
+              (Calls{"restart", "replace 1", "replace 2", "replace 3"}));
+
+  // Views on the new browser report its failure; the first restarts it.
+  for (RecoveryViewId view = 1; view <= 3; ++view) {
+    manager.OnReplacementAttached(view, true, now);
+    manager.OnNavigationCompleted(view, now);
+  }
+  delegate.TakeCalls();
+  now += milliseconds(120000);
+  manager.OnProcessFailed(2, WebViewProcessFailure::kBrowserExited, now);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kBrowserExited, now);
+  EXPECT_TRUE(delegate.TakeCalls() ==
+              (Calls{"restart", "replace 2", "replace 1"}));
+  EXPECT_EQ(manager.stats().browser_failures, 5u);
+  EXPECT_EQ(manager.stats().browser_restarts, 2u);
+}
+
+RUNNER_TEST(ViewRecovery, RemovedViewsAreForgotten) {
+  RecordingDelegate delegate;
+  ViewRecoveryManager manager(&delegate, Options());
+  TimePoint now;
+  manager.AddView(1);
+  FailAndRecover(&manager, 1, now);
+  manager.OnProcessFailed(1, WebViewProcessFailure::kRendererExited, now);
+  manager.RemoveView(1);
+  EXPECT_EQ(manager.view_count(), 0u);
+  EXPECT_FALSE(manager.StateOf(1).has_value());
+  EXPECT_FALSE(manager.NextUpdateTime().has_value());
+  delegate.TakeCalls();
+  manager.Update(now + milliseconds(60000));
+  EXPECT_TRUE(delegate.TakeCalls().empty());
+}
+
+// Requests a controller from |backend| and stores what it gets in
+// |*surface|, leaving it empty on failure.
+void Request(SimulatedWebViewBackend* backend,
+             WebViewSurface* surface,
+             bool* answered) {
+  backend->CreateController([surface, answered](WebViewSurface created) {
+    *surface = std::move(created);
+    *answered = true;
+  });
+}
+
+RUNNER_TEST(BrowserRestart, FailedEnvironmentIsRetriedAfterRestart) {
+  VirtualClock clock;
+  SimulatedWebViewBackend backend(&clock, SimulatedWebViewOptions());
+  backend.SimulateEnvironmentFailures(1);
+  WebViewSurface surface;
+  bool answered = false;
+  Request(&backend, &surface, &answered);
+  clock.RunUntilIdle();
+  EXPECT_TRUE(answered);
+  EXPECT_FALSE(surface);
+  EXPECT_EQ(backend.stats().environment_failures, 1u);
+
+  // Until the browser restarts, requests fail at once.
+  answered = false;
+  Request(&backend, &surface, &answered);
+  EXPECT_TRUE(answered);
+  EXPECT_FALSE(surface);
+
+  backend.RestartBrowser();
+  answered = false;
+  Request(&backend, &surface, &answered);
+  EXPECT_FALSE(answered);
+  clock.RunUntilIdle();
+  EXPECT_TRUE(answered);
+  EXPECT_TRUE(surface);
+  EXPECT_EQ(backend.stats().environment_failures, 1u);
+  surface = WebViewSurface();
+}
+
+RUNNER_TEST(BrowserRestart, RestartWhileCreatingKeepsTheCreation) {
+  VirtualClock clock;
+  SimulatedWebViewOptions options;
+  SimulatedWebViewBackend backend(&clock, options);
+  WebViewSurface first;
+  WebViewSurface second;
+  bool first_answered = false;
+  bool second_answered = false;
+  Request(&backend, &first, &first_answered);
+  backend.RestartBrowser();
+  Request(&backend, &second, &second_answered);
+  // One environment, then one controller each.
+  EXPECT_EQ(clock.RunUntilIdle(), 3u);
+  EXPECT_TRUE(first);
+  EXPECT_TRUE(second);
+  EXPECT_TRUE(clock.now() - VirtualClock::Clock::time_point() ==
+              options.environment_latency + options.controller_latency);
+  first = WebViewSurface();
+  second = WebViewSurface();
+}
+
+RUNNER_TEST(BrowserRestart, RestartStartsANewEnvironment) {
+  VirtualClock clock;
+  SimulatedWebViewOptions options;
+  SimulatedWebViewBackend backend(&clock, options);
+  WebViewSurface surface;
+  bool answered = false;
+  Request(&backend, &surface, &answered);
+  clock.RunUntilIdle();
+  ASSERT_TRUE(surface);
+  surface = WebViewSurface();
+
+  VirtualClock::Clock::time_point restarted = clock.now();
+  backend.RestartBrowser();
+  Request(&backend, &surface, &answered);
+  clock.RunUntilIdle();
+  EXPECT_TRUE(surface);
+  EXPECT_TRUE(clock.now() - restarted ==
+              options.environment_latency + options.controller_latency);
+  surface = WebViewSurface();
+}
+
+// A platform view as the runner keeps it for recovery, minus the native
+// window and page traffic.
+struct HostedView {
+  WebViewSurface surface;
+  std::u16string committed_url;
+  std::u16string restore_url;
+  ControllerPool<WebViewSurface>::ClaimId claim_id = 0;
+};
+
+// Recovers views the way flutter_window.cpp does, against a simulated
+// backend whose failures the test injects.
+class RecoveryHost : public ViewRecoveryDelegate {
+ public:
+  explicit RecoveryHost(
+      ViewRecoveryOptions recovery_options = ViewRecoveryOptions(),
+      SimulatedWebViewOptions backend_options = SimulatedWebViewOptions())
+      : backend_(&clock_, std::move(backend_options)),
+        pool_(&backend_, PoolOptions()),
+        recovery_(this, recovery_options) {
+    pool_.Prewarm();
+  }
+
+  ~RecoveryHost() override {
+    for (auto& [id, view] : views_) {
+      view.surface = WebViewSurface();
+    }
+    views_.clear();
+    pool_.Clear();
+  }
+
+  void AddView(RecoveryViewId id) {
+    views_.try_emplace(id);
+    recovery_.AddView(id);
+    Claim(id);
+  }
+
+  // Lets views load and the pool warm up.
+  void Settle() { clock_.RunUntilIdle(); }
+
+  void CrashRenderer(RecoveryViewId id) {
+    static_cast<SimulatedWebViewController*>(views_.at(id).surface.get())
+        ->SimulateProcessFailure(WebViewProcessFailure::kRendererExited);
+  }
+
+  void CrashBrowser() { backend_.SimulateBrowserExit(); }
+
+  bool HasSurface(RecoveryViewId id) const {
+    return static_cast<bool>(views_.at(id).surface);
+  }
+  ViewRecoveryState StateOf(RecoveryViewId id) const {
+    return *recovery_.StateOf(id);
+  }
+  VirtualClock& clock() { return clock_; }
+  SimulatedWebViewBackend& backend() { return backend_; }
+  const ViewRecoveryStats& stats() const { return recovery_.stats(); }
+
+  // ViewRecoveryDelegate:
+  void ReplaceController(RecoveryViewId id) override {
+    HostedView& view = views_.at(id);
+    if (view.claim_id != 0) {
+      return;
+    }
+    if (view.surface) {
+      view.surface->SetEvents(WebViewEvents());
+      view.surface->Detach();
+      backend_.DestroyController(std::move(view.surface));
+      view.surface = WebViewSurface();
+    }
+    view.restore_url = view.committed_url;
+    Claim(id);
+  }
+  void RestartBrowser() override {
+    pool_.Clear();
+    backend_.RestartBrowser();
+    pool_.Prewarm();
+  }
+  void AbandonView(RecoveryViewId id) override {
+    views_.at(id).surface = WebViewSurface();
+  }
+  void ViewRecovered(RecoveryViewId id,
+                     std::chrono::nanoseconds recovery_time) override {}
+
+ private:
+  static ControllerPool<WebViewSurface>::Options PoolOptions() {
+    ControllerPool<WebViewSurface>::Options options;
+    options.idle_capacity = 4;
+    options.warm_count = 1;
+    return options;
+  }
+
+  void Claim(RecoveryViewId id) {
+    auto answered = std::make_shared<bool>(false);
+    ControllerPool<WebViewSurface>::ClaimId claim_id =
+        pool_.Claim([this, id, answered](WebViewSurface surface) {
+          *answered = true;
+          Attach(id, std::move(surface));
+        });
+    if (!*answered) {
+      views_.at(id).claim_id = claim_id;
+    }
+  }
+
+  void Attach(RecoveryViewId id, WebViewSurface surface) {
+    HostedView& view = views_.at(id);
+    view.claim_id = 0;
+    recovery_.OnReplacementAttached(id, static_cast<bool>(surface),
+                                    clock_.now());
+    ScheduleUpdate();
+    if (!surface) {
+      return;
+    }
+    view.surface = std::move(surface);
+    WebViewController* webview = view.surface.get();
+    webview->Attach(static_cast<NativeWindow>(id), IntRect{0, 0, 640, 480});
+    webview->Navigate(view.restore_url.empty() ? u"https://example.com/"
+                                               : view.restore_url);
+    view.restore_url.clear();
+
+    WebViewEvents events;
+    events.navigation_completed = [this, id](bool succeeded) {
+      HostedView& view = views_.at(id);
+      if (succeeded) {
+        view.committed_url = view.surface->Source();
+      }
+      recovery_.OnNavigationCompleted(id, clock_.now());
+    };
+    events.process_failed = [this, id](WebViewProcessFailure failure) {
+      VirtualClock::Clock::time_point failed_at = clock_.now();
+      clock_.PostDelayed(VirtualClock::Clock::duration::zero(),
+                         [this, id, failure, failed_at] {
+                           recovery_.OnProcessFailed(id, failure, failed_at);
+                           ScheduleUpdate();
+                         });
+    };
+    webview->SetEvents(std::move(events));
+  }
+
+  void ScheduleUpdate() {
+    if (std::optional<ViewRecoveryManager::Clock::time_point> next =
+            recovery_.NextUpdateTime()) {
+      clock_.PostAt(*next, [this] {
+        recovery_.Update(clock_.now());
+        ScheduleUpdate();
+      });
+    }
+  }
+
+  VirtualClock clock_;
+  SimulatedWebViewBackend backend_;
+  ControllerPool<WebViewSurface> pool_;
+  ViewRecoveryManager recovery_;
+  std::map<RecoveryViewId, HostedView> views_;
+};
+
+RUNNER_TEST(BrowserRestart, ViewsRecoverFromRendererAndBrowserFailures) {
+  RecoveryHost host;
+  for (RecoveryViewId id = 1; id <= 4; ++id) {
+    host.AddView(id);
+  }
+  host.Settle();
+  host.CrashRenderer(2);
+  host.Settle();
+  EXPECT_EQ(host.stats().recovered, 1u);
+
+  host.CrashBrowser();
+  host.Settle();
+  EXPECT_EQ(host.stats().browser_restarts, 1u);
+  EXPECT_EQ(host.stats().recovered, 5u);
+  EXPECT_EQ(host.stats().replacement_failures, 0u);
+  for (RecoveryViewId id = 1; id <= 4; ++id) {
+    EXPECT_TRUE(host.StateOf(id) == ViewRecoveryState::kHealthy);
+    EXPECT_TRUE(host.HasSurface(id));
+  }
+}
+
+RUNNER_TEST(BrowserRestart, FailedRestartIsRetriedOnTheNextRestart) {
+  ViewRecoveryOptions options;
+  options.max_failures = 100;
+  RecoveryHost host(options);
+  for (RecoveryViewId id = 1; id <= 2; ++id) {
+    host.AddView(id);
+  }
+  host.Settle();
+  // The restarted browser's environment cannot be created, so the views'
+  // replacements fail and they back off.
+  host.backend().SimulateEnvironmentFailures(1);
+  host.CrashBrowser();
+  host.clock().AdvanceBy(std::chrono::seconds(5));
+  EXPECT_EQ(host.backend().stats().environment_failures, 1u);
+  EXPECT_GT(host.stats().replacement_failures, 2u);
+  for (RecoveryViewId id = 1; id <= 2; ++id) {
+    EXPECT_TRUE(host.StateOf(id) == ViewRecoveryState::kBackingOff);
+    EXPECT_FALSE(host.HasSurface(id));
+  }
+
+  // Restarting again, as the next browser failure report would, creates a
+  // new environment and the views' next retries succeed. Without it they
+  // would keep retrying, so the clock is only run for a while.
+  host.RestartBrowser();
+  host.clock().AdvanceBy(std::chrono::seconds(30));
+  for (RecoveryViewId id = 1; id <= 2; ++id) {
+    EXPECT_TRUE(host.StateOf(id) == ViewRecoveryState::kHealthy);
+    EXPECT_TRUE(host.HasSurface(id));
+  }
+  EXPECT_EQ(host.stats().recovered, 2u);
+  EXPECT_EQ(host.backend().stats().environment_failures, 1u);
+}
+
+RUNNER_TEST(BrowserRestart, ViewsAreAbandonedWhileTheBrowserStaysDown) {
+  ViewRecoveryOptions options;
+  options.max_failures = 4;
+  RecoveryHost host(options);
+  for (RecoveryViewId id = 1; id <= 2; ++id) {
+    host.AddView(id);
+  }
+  host.Settle();
+  host.backend().SimulateEnvironmentFailures(1);
+  host.CrashBrowser();
+  host.Settle();
+  EXPECT_EQ(host.stats().abandoned, 2u);
+  for (RecoveryViewId id = 1; id <= 2; ++id) {
+    EXPECT_TRUE(host.StateOf(id) == ViewRecoveryState::kAbandoned);
+    EXPECT_FALSE(host.HasSurface(id));
+  }
+}
+
+RUNNER_TEST(BrowserRestart, RecoveryIsDeterministic) {
+  auto run = [] {
+    SimulatedWebViewOptions backend_options;
+    backend_options.controller_failure_rate = 0.3;
+    backend_options.seed = 11;
+    RecoveryHost host(ViewRecoveryOptions(), backend_options);
+    for (RecoveryViewId id = 1; id <= 4; ++id) {
+      host.AddView(id);
+    }
+    host.Settle();
+    for (RecoveryViewId id = 1; id <= 4; ++id) {
+      if (host.HasSurface(id)) {
+        host.CrashRenderer(id);
+      }
+      host.Settle();
+    }
+    host.backend().SimulateEnvironmentFailures(1);
+    host.CrashBrowser();
+    host.clock().AdvanceBy(std::chrono::seconds(2));
+    host.RestartBrowser();
+    host.Settle();
+    const ViewRecoveryStats& stats = host.stats();
+    std::vector<uint64_t> outcome = {
+        stats.renderer_failures,    stats.browser_failures,
+        stats.replacements,         stats.replacement_failures,
+        stats.recovered,            stats.abandoned,
+        host.backend().stats().controller_failures,
+        static_cast<uint64_t>(stats.total_recovery_time.count()),
+        static_cast<uint64_t>(
+            host.clock().now().time_since_epoch().count())};
+    return outcome;
+  };
+  std::vector<uint64_t> first = run();
+  EXPECT_TRUE(first == run());
+  // Both the injected failures and the random ones happened.
+  EXPECT_GT(first[3], 0u);
+  EXPECT_GT(first[6], 0u);
+}
+
+}  // namespace
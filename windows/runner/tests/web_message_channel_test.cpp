@@ -0,0 +1,248 @@
+#include "web_message_channel.h"
+
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "test.h"
+
+namespace {
+
+// Keeps a copy of every batch posted to it.
+class RecordingTransport : public WebMessageTransport {
+ public:
+  // WebMessageTransport:
+  void Post(std::u16string_view batch) override {
+    batches.emplace_back(batch);
+  }
+
+  std::vector<std::u16string> batches;
+};
+
+struct Received {
+  WebMessageChannelId channel;
+  std::u16string payload;
+};
+
+// Records every message delivered on |channels| into |received|.
+void RecordChannels(WebMessageDispatcher* dispatcher,
+                    std::vector<WebMessageChannelId> channels,
+                    std::vector<Received>* received) {
+  for (WebMessageChannelId channel : channels) {
+    dispatcher->SetHandler(channel,
+                           [received, channel](std::u16string_view payload) {
+                             received->push_back(
+                                 Received{channel, std::u16string(payload)});
+                           });
+  }
+}
+
+std::u16string Batch(std::u16string_view frames) {
+  return kWebMessageBatchMarker + std::u16string(frames);
+}
+
+RUNNER_TEST(WebMessageChannel, EncodesFrames) {
+  RecordingTransport transport;
+  WebMessageBatcher batcher(&transport);
+  EXPECT_TRUE(batcher.Send(3, u"hi"));
+  EXPECT_FALSE(batcher.Send(12, u""));
+  EXPECT_FALSE(batcher.Send(65535, u"a:1:b"));
+  EXPECT_TRUE(batcher.has_pending());
+  EXPECT_TRUE(transport.batches.empty());
+  EXPECT_EQ(batcher.Flush(), 3u);
+  EXPECT_FALSE(batcher.has_pending());
+  ASSERT_EQ(transport.batches.size(), 1u);
+  EXPECT_EQ(transport.batches[0], Batch(u"3:2:hi12:0:65535:5:a:1:b"));
+  EXPECT_TRUE(IsWebMessageBatch(transport.batches[0]));
+  EXPECT_EQ(batcher.stats().messages, 3u);
+  EXPECT_EQ(batcher.stats().batches, 1u);
+  EXPECT_EQ(batcher.stats().payload_units, 7u);
+}
+
+RUNNER_TEST(WebMessageChannel, FlushWithoutMessagesPostsNothing) {
+  RecordingTransport transport;
+  WebMessageBatcher batcher(&transport);
+  EXPECT_EQ(batcher.Flush(), 0u);
+  EXPECT_TRUE(transport.batches.empty());
+  batcher.Send(1, u"a");
+  batcher.Flush();
+  EXPECT_EQ(batcher.Flush(), 0u);
+  EXPECT_EQ(transport.batches.size(), 1u);
+}
+
+RUNNER_TEST(WebMessageChannel, EachFlushStartsANewBatch) {
+  RecordingTransport transport;
+  WebMessageBatcher batcher(&transport);
+  EXPECT_TRUE(batcher.Send(1, u"first"));
+  batcher.Flush();
+  EXPECT_TRUE(batcher.Send(2, u"second"));
+  batcher.Flush();
+  ASSERT_EQ(transport.batches.size(), 2u);
+  EXPECT_EQ(transport.batches[0], Batch(u"1:5:first"));
+  EXPECT_EQ(transport.batches[1], Batch(u"2:6:second"));
+}
+
+RUNNER_TEST(WebMessageChannel, DispatchesByChannel) {
+  WebMessageDispatcher dispatcher;
+  std::vector<Received> received;
+  RecordChannels(&dispatcher, {1, 7, 65535}, &received);
+  EXPECT_TRUE(
+      dispatcher.Dispatch(Batch(u"7:3:abc1:0:2:4:lost65535:2:zz7:1:d")));
+  ASSERT_EQ(received.size(), 4u);
+  EXPECT_EQ(received[0].channel, 7);
+  EXPECT_EQ(received[0].payload, u"abc");
+  EXPECT_EQ(received[1].channel, 1);
+  EXPECT_EQ(received[1].payload, u"");
+  EXPECT_EQ(received[2].channel, 65535);
+  EXPECT_EQ(received[2].payload, u"zz");
+  EXPECT_EQ(received[3].channel, 7);
+  EXPECT_EQ(received[3].payload, u"d");
+  EXPECT_EQ(dispatcher.stats().messages, 5u);
+  EXPECT_EQ(dispatcher.stats().unhandled, 1u);
+  EXPECT_EQ(dispatcher.stats().batches, 1u);
+  EXPECT_EQ(dispatcher.stats().payload_units, 10u);
+}
+
+RUNNER_TEST(WebMessageChannel, ReplacesAndRemovesHandlers) {
+  WebMessageDispatcher dispatcher;
+  int first = 0;
+  int second = 0;
+  dispatcher.SetHandler(4, [&first](std::u16string_view) { ++first; });
+  dispatcher.Dispatch(Batch(u"4:0:"));
+  dispatcher.SetHandler(4, [&second](std::u16string_view) { ++second; });
+  dispatcher.Dispatch(Batch(u"4:0:"));
+  dispatcher.SetHandler(4, nullptr);
+  dispatcher.Dispatch(Batch(u"4:0:"));
+  // Removing a handler that was never set is harmless.
+  dispatcher.SetHandler(900, nullptr);
+  dispatcher.Dispatch(Batch(u"900:0:"));
+  EXPECT_EQ(first, 1);
+  EXPECT_EQ(second, 1);
+  EXPECT_EQ(dispatcher.stats().unhandled, 2u);
+}
+
+RUNNER_TEST(WebMessageChannel, RejectsMessagesThatAreNotBatches) {
+  WebMessageDispatcher dispatcher;
+  int calls = 0;
+  dispatcher.SetHandler(1, [&calls](std::u16string_view) { ++calls; });
+  EXPECT_FALSE(IsWebMessageBatch(u""));
+  EXPECT_FALSE(IsWebMessageBatch(u"1:1:a"));
+  EXPECT_FALSE(dispatcher.Dispatch(u"1:1:a"));
+  EXPECT_FALSE(dispatcher.Dispatch(u""));
+  EXPECT_EQ(calls, 0);
+  EXPECT_EQ(dispatcher.stats().malformed, 2u);
+  // An empty batch is well formed.
+  EXPECT_TRUE(dispatcher.Dispatch(Batch(u"")));
+}
+
+RUNNER_TEST(WebMessageChannel, StopsAtMalformedFrames) {
+  const std::u16string_view kMalformed[] = {
+      u"1",                    // No separator.
+      u"1:",                   // No length.
+      u"1:2",                  // Length without separator.
+      u":1:a",                 // Empty channel.
+      u"1::a",                 // Empty length.
+      u"x:1:a",                // Non-digit channel.
+      u"1:-1:a",               // Non-digit length.
+      u"1:5:abc",              // Length past the end.
+      u"65536:1:a",            // Channel out of range.
+      u"1:1234567890123:a",    // Too many digits.
+  };
+  for (std::u16string_view frame : kMalformed) {
+    WebMessageDispatcher dispatcher;
+    std::vector<Received> received;
+    RecordChannels(&dispatcher, {1}, &received);
+    // The frame before the malformed one is still delivered.
+    EXPECT_FALSE(dispatcher.Dispatch(Batch(u"1:2:ok" + std::u16string(frame))));
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0].payload, u"ok");
+    EXPECT_EQ(dispatcher.stats().malformed, 1u);
+  }
+}
+
+RUNNER_TEST(WebMessageChannel, PayloadsMayContainAnything) {
+  WebMessageDispatcher dispatcher;
+  std::vector<Received> received;
+  RecordChannels(&dispatcher, {2}, &received);
+  LoopbackWebMessageTransport transport(&dispatcher);
+  WebMessageBatcher batcher(&transport);
+  std::u16string tricky = u"12:3:";
+  tricky += kWebMessageBatchMarker;
+  tricky += u'\0';
+  tricky += u"\U0001F600";
+  batcher.Send(2, tricky);
+  batcher.Send(2, u"after");
+  batcher.Flush();
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[0].payload, tricky);
+  EXPECT_EQ(received[1].payload, u"after");
+}
+
+// Echoes every message back through |batcher| from inside the post.
+class EchoTransport : public WebMessageTransport {
+ public:
+  // WebMessageTransport:
+  void Post(std::u16string_view batch) override {
+    posted.emplace_back(batch);
+    if (batcher != nullptr && posted.size() == 1) {
+      batcher->Send(9, u"echo");
+    }
+    // The batch being posted must not have been touched by the send.
+    EXPECT_EQ(std::u16string(batch), posted.back());
+  }
+
+  WebMessageBatcher* batcher = nullptr;
+  std::vector<std::u16string> posted;
+};
+
+RUNNER_TEST(WebMessageChannel, SendingDuringPostStartsANewBatch) {
+  EchoTransport transport;
+  WebMessageBatcher batcher(&transport);
+  transport.batcher = &batcher;
+  batcher.Send(1, u"ping");
+  EXPECT_EQ(batcher.Flush(), 1u);
+  EXPECT_TRUE(batcher.has_pending());
+  EXPECT_EQ(batcher.Flush(), 1u);
+  ASSERT_EQ(transport.posted.size(), 2u);
+  EXPECT_EQ(transport.posted[0], Batch(u"1:4:ping"));
+  EXPECT_EQ(transport.posted[1], Batch(u"9:4:echo"));
+}
+
+RUNNER_TEST(WebMessageChannel, LoopbackPreservesRandomTraffic) {
+  std::mt19937 random(6);
+  WebMessageDispatcher dispatcher;
+  std::vector<Received> received;
+  std::vector<WebMessageChannelId> channels = {0, 1, 2, 10, 300, 65535};
+  RecordChannels(&dispatcher, channels, &received);
+  LoopbackWebMessageTransport transport(&dispatcher);
+  WebMessageBatcher batcher(&transport);
+
+  std::vector<Received> sent;
+  size_t batches = 0;
+  for (int round = 0; round < 200; ++round) {
+    size_t count = 1 + random() % 40;
+    for (size_t i = 0; i < count; ++i) {
+      Received message;
+      message.channel = channels[random() % channels.size()];
+      message.payload.resize(random() % 64);
+      for (char16_t& unit : message.payload) {
+        unit = static_cast<char16_t>(random() % 0x10000);
+      }
+      batcher.Send(message.channel, message.payload);
+      sent.push_back(std::move(message));
+    }
+    batches += batcher.Flush() > 0 ? 1 : 0;
+  }
+  ASSERT_EQ(received.size(), sent.size());
+  for (size_t i = 0; i < sent.size(); ++i) {
+    EXPECT_EQ(received[i].channel, sent[i].channel);
+    EXPECT_EQ(received[i].payload, sent[i].payload);
+  }
+  EXPECT_EQ(dispatcher.stats().batches, batches);
+  EXPECT_EQ(dispatcher.stats().malformed, 0u);
+  EXPECT_EQ(dispatcher.stats().payload_units,
+            batcher.stats().payload_units);
+}
+
+}  // namespace
@@ -0,0 +1,67 @@
+// Packs a directory of web assets into an asset pack (see asset_pack.h).
+//
+//   asset_pack_tool <input directory> <output file>
+//
+// Every regular file under the input directory is added under its path
+// relative to it, with '/' separators, and a MIME type chosen by extension.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "asset_pack.h"
+
+namespace {
+
+bool ReadFile(const std::filesystem::path& path, std::string* contents) {
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(stream),
+                   std::istreambuf_iterator<char>());
+  return !stream.bad();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::fprintf(stderr, "usage: %s <input directory> <output file>\n",
+                 argv[0]);
+    return 2;
+  }
+  std::filesystem::path input(argv[1]);
+  std::error_code error;
+  AssetPackBuilder builder;
+  for (std::filesystem::recursive_directory_iterator it(input, error), end;
+       !error && it != end; it.increment(error)) {
+    if (!it->is_regular_file()) {
+      continue;
+    }
+    std::string path =
+        std::filesystem::relative(it->path(), input).generic_string();
+    std::string contents;
+    if (!ReadFile(it->path(), &contents)) {
+      std::fprintf(stderr, "cannot read %s\n", path.c_str());
+      return 1;
+    }
+    builder.Add(path, MimeTypeForPath(path), contents);
+  }
+  if (error) {
+    std::fprintf(stderr, "cannot list %s: %s\n", argv[1],
+                 error.message().c_str());
+    return 1;
+  }
+
+  std::string pack = builder.Build();
+  std::ofstream out(argv[2], std::ios::binary | std::ios::trunc);
+  if (!out.write(pack.data(), static_cast<std::streamsize>(pack.size()))) {
+    std::fprintf(stderr, "cannot write %s\n", argv[2]);
+    return 1;
+  }
+  std::printf("Packed %zu assets, %zu bytes\n", builder.size(), pack.size());
+  return 0;
+}
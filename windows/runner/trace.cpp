@@ -0,0 +1,202 @@
+#include "trace.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace_internal {
+
+std::atomic<bool> g_enabled{false};
+
+}  // namespace trace_internal
+
+namespace {
+
+using trace_internal::Phase;
+
+// Events per thread. Startup produces a few hundred; the rest is headroom
+// for tracing a whole session.
+constexpr size_t kBufferCapacity = 32 * 1024;
+
+// Appends |ns| as microseconds with three decimals.
+void AppendMicroseconds(std::string* output, int64_t ns) {
+  // Events recorded before the latest |StartTracing| come out negative.
+  uint64_t magnitude = ns < 0 ? 0 - static_cast<uint64_t>(ns)
+                              : static_cast<uint64_t>(ns);
+  char buffer[32];
+  int size = snprintf(buffer, sizeof(buffer), "%s%llu.%03llu",
+                      ns < 0 ? "-" : "",
+                      static_cast<unsigned long long>(magnitude / 1000),
+                      static_cast<unsigned long long>(magnitude % 1000));
+  output->append(buffer, size > 0 ? size : 0);
+}
+
+struct Event {
+  const char* name;
+  int64_t start_ns;
+  int64_t duration_ns;
+  uint64_t id;
+  Phase phase;
+};
+
+// A thread's events. Only the owning thread appends; |size_| publishes
+// them to the exporter.
+class EventBuffer {
+ public:
+  explicit EventBuffer(uint32_t thread_id)
+      : events_(new Event[kBufferCapacity]), thread_id_(thread_id) {}
+
+  bool Append(const Event& event) {
+    size_t size = size_.load(std::memory_order_relaxed);
+    if (size == kBufferCapacity) {
+      return false;
+    }
+    events_[size] = event;
+    size_.store(size + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Invokes |callback| on every published event.
+  template <typename Callback>
+  void ForEach(Callback&& callback) const {
+    size_t size = size_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < size; ++i) {
+      callback(events_[i]);
+    }
+  }
+
+  uint32_t thread_id() const { return thread_id_; }
+
+ private:
+  std::unique_ptr<Event[]> events_;
+  std::atomic<size_t> size_{0};
+  const uint32_t thread_id_;
+};
+
+class TraceState {
+ public:
+  static TraceState& Get() {
+    // Intentionally leaked: threads may record during static destruction.
+    static TraceState* state = new TraceState();
+    return *state;
+  }
+
+  EventBuffer* RegisterThread() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(std::make_unique<EventBuffer>(
+        static_cast<uint32_t>(buffers_.size() + 1)));
+    return buffers_.back().get();
+  }
+
+  std::string Export() {
+    std::string output = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::unique_ptr<EventBuffer>& buffer : buffers_) {
+      buffer->ForEach([&](const Event& event) {
+        if (!first) {
+          output.push_back(',');
+        }
+        first = false;
+        AppendEvent(&output, event, buffer->thread_id());
+      });
+    }
+    output.append("]}\n");
+    return output;
+  }
+
+  std::atomic<int64_t> start_ns{0};
+  std::atomic<uint64_t> dropped{0};
+
+ private:
+  TraceState() = default;
+
+  void AppendEvent(std::string* output,
+                   const Event& event,
+                   uint32_t thread_id) const {
+    output->append("{\"name\":\"");
+    for (const char* c = event.name; *c != '\0'; ++c) {
+      if (*c == '"' || *c == '\\') {
+        output->push_back('\\');
+      }
+      output->push_back(*c);
+    }
+    // Timestamps are in microseconds, relative to |StartTracing|.
+    char buffer[160];
+    int size = snprintf(buffer, sizeof(buffer),
+                        "\",\"cat\":\"runner\",\"ph\":\"%c\",\"pid\":1,"
+                        "\"tid\":%u,\"ts\":",
+                        static_cast<char>(event.phase), thread_id);
+    output->append(buffer, size > 0 ? size : 0);
+    AppendMicroseconds(
+        output, event.start_ns - start_ns.load(std::memory_order_relaxed));
+    switch (event.phase) {
+      case Phase::kComplete:
+        output->append(",\"dur\":");
+        AppendMicroseconds(output, event.duration_ns);
+        break;
+      case Phase::kInstant:
+        output->append(",\"s\":\"t\"");
+        break;
+      case Phase::kAsyncBegin:
+      case Phase::kAsyncEnd:
+        size = snprintf(buffer, sizeof(buffer), ",\"id\":\"0x%llx\"",
+                        static_cast<unsigned long long>(event.id));
+        output->append(buffer, size > 0 ? size : 0);
+        break;
+    }
+    output->push_back('}');
+  }
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<EventBuffer>> buffers_;
+};
+
+EventBuffer* CurrentThreadBuffer() {
+  thread_local EventBuffer* buffer = TraceState::Get().RegisterThread();
+  return buffer;
+}
+
+}  // namespace
+
+void StartTracing() {
+  TraceState::Get().start_ns.store(trace_internal::NowNanoseconds(),
+                                   std::memory_order_relaxed);
+  trace_internal::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+void StopTracing() {
+  trace_internal::g_enabled.store(false, std::memory_order_relaxed);
+}
+
+std::string ExportChromeTrace() {
+  return TraceState::Get().Export();
+}
+
+uint64_t DroppedTraceEventCount() {
+  return TraceState::Get().dropped.load(std::memory_order_relaxed);
+}
+
+namespace trace_internal {
+
+void RecordEvent(Phase phase,
+                 const char* name,
+                 int64_t start_ns,
+                 int64_t duration_ns,
+                 uint64_t id) {
+  if (!CurrentThreadBuffer()->Append(
+          Event{name, start_ns, duration_ns, id, phase})) {
+    TraceState::Get().dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+int64_t NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace trace_internal
@@ -0,0 +1,118 @@
+#ifndef RUNNER_TRACE_H_
+#define RUNNER_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Timeline tracing for the runner, exported in the Chrome Trace Event
+// format (load the output in chrome://tracing or Perfetto).
+//
+// Spans and instants are recorded with monotonic timestamps into a
+// pre-allocated buffer owned by the recording thread, so recording takes no
+// locks and does not allocate. While tracing is off, every call reduces to a
+// single relaxed atomic load. Names must be string literals (or otherwise
+// outlive the trace).
+//
+//   void FlutterWindow::OnCreate() {
+//     RUNNER_TRACE_SCOPE("FlutterWindow::OnCreate");
+//     ...
+//   }
+//
+// Work that starts and finishes in different callbacks is recorded as an
+// async span with |TraceAsyncBegin| and |TraceAsyncEnd| sharing an id.
+
+#define RUNNER_TRACE_CONCAT_INNER(a, b) a##b
+#define RUNNER_TRACE_CONCAT(a, b) RUNNER_TRACE_CONCAT_INNER(a, b)
+
+// Records a span covering the rest of the enclosing scope.
+#define RUNNER_TRACE_SCOPE(name)                                   \
+  ::trace_internal::ScopedSpan RUNNER_TRACE_CONCAT(runner_trace_span_, \
+                                                   __LINE__)(name)
+
+// Records a point in time.
+#define RUNNER_TRACE_INSTANT(name) ::TraceInstant(name)
+
+// Starts recording. Exported timestamps are relative to this call.
+void StartTracing();
+
+// Stops recording. Events recorded so far are kept for export.
+void StopTracing();
+
+// Returns every recorded event as a Chrome Trace Event JSON document.
+// Events still being recorded on other threads may be missing.
+std::string ExportChromeTrace();
+
+// Returns the number of events dropped because a thread's buffer was full.
+uint64_t DroppedTraceEventCount();
+
+namespace trace_internal {
+
+extern std::atomic<bool> g_enabled;
+
+enum class Phase : char {
+  kComplete = 'X',
+  kInstant = 'i',
+  kAsyncBegin = 'b',
+  kAsyncEnd = 'e',
+};
+
+void RecordEvent(Phase phase,
+                 const char* name,
+                 int64_t start_ns,
+                 int64_t duration_ns,
+                 uint64_t id);
+
+int64_t NowNanoseconds();
+
+class ScopedSpan {
+ public:
+  explicit ScopedSpan(const char* name)
+      : name_(g_enabled.load(std::memory_order_relaxed) ? name : nullptr),
+        start_ns_(name_ ? NowNanoseconds() : 0) {}
+
+  ~ScopedSpan() {
+    if (name_) {
+      RecordEvent(Phase::kComplete, name_, start_ns_,
+                  NowNanoseconds() - start_ns_, 0);
+    }
+  }
+
+  ScopedSpan(const ScopedSpan&) = delete;
+  ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+ private:
+  const char* name_;
+  int64_t start_ns_;
+};
+
+}  // namespace trace_internal
+
+inline bool IsTracingEnabled() {
+  return trace_internal::g_enabled.load(std::memory_order_relaxed);
+}
+
+inline void TraceInstant(const char* name) {
+  if (IsTracingEnabled()) {
+    trace_internal::RecordEvent(trace_internal::Phase::kInstant, name,
+                                trace_internal::NowNanoseconds(), 0, 0);
+  }
+}
+
+// Begins the async span |name| identified by |id|.
+inline void TraceAsyncBegin(const char* name, uint64_t id) {
+  if (IsTracingEnabled()) {
+    trace_internal::RecordEvent(trace_internal::Phase::kAsyncBegin, name,
+                                trace_internal::NowNanoseconds(), 0, id);
+  }
+}
+
+// Ends the async span started by |TraceAsyncBegin| with the same arguments.
+inline void TraceAsyncEnd(const char* name, uint64_t id) {
+  if (IsTracingEnabled()) {
+    trace_internal::RecordEvent(trace_internal::Phase::kAsyncEnd, name,
+                                trace_internal::NowNanoseconds(), 0, id);
+  }
+}
+
+#endif  // RUNNER_TRACE_H_
@@ -0,0 +1,228 @@
+#include "utf_transcoder.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RUNNER_UTF_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RUNNER_UTF_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RUNNER_UTF_NEON 1
+#endif
+
+namespace {
+
+// Converts the longest prefix of |input| that is pure ASCII in whole SIMD
+// blocks and returns how many code units were consumed. The scalar loop
+// picks up from there.
+size_t ConvertAsciiBlocks(const char16_t* input, size_t length, char* output) {
+  size_t i = 0;
+#if defined(RUNNER_UTF_AVX2)
+  const __m256i avx_mask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+  for (; i + 32 <= length; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 16));
+    if (!_mm256_testz_si256(_mm256_or_si256(a, b), avx_mask)) {
+      break;
+    }
+    // packus interleaves 128-bit lanes; restore the order before storing.
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b),
+                                              0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), packed);
+  }
+#endif
+#if defined(RUNNER_UTF_SSE2)
+  const __m128i sse_mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= length; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 8));
+    __m128i high = _mm_and_si128(_mm_or_si128(a, b), sse_mask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF) {
+      break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i),
+                     _mm_packus_epi16(a, b));
+  }
+#elif defined(RUNNER_UTF_NEON)
+  for (; i + 16 <= length; i += 16) {
+    uint16x8_t a = vld1q_u16(reinterpret_cast<const uint16_t*>(input + i));
+    uint16x8_t b = vld1q_u16(reinterpret_cast<const uint16_t*>(input + i + 8));
+    if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80) {
+      break;
+    }
+    vst1q_u8(reinterpret_cast<uint8_t*>(output + i),
+             vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+  }
+#endif
+  // Scalar fallback, also used for the tail: eight units at a time.
+  for (; i + 8 <= length; i += 8) {
+    uint64_t block[2];
+    std::memcpy(block, input + i, sizeof(block));
+    if (((block[0] | block[1]) & 0xFF80FF80FF80FF80ull) != 0) {
+      break;
+    }
+    for (size_t j = 0; j < 8; ++j) {
+      output[i + j] = static_cast<char>(input[i + j]);
+    }
+  }
+  return i;
+}
+
+bool IsHighSurrogate(uint32_t unit) {
+  return unit >= 0xD800 && unit <= 0xDBFF;
+}
+
+bool IsLowSurrogate(uint32_t unit) {
+  return unit >= 0xDC00 && unit <= 0xDFFF;
+}
+
+}  // namespace
+
+size_t ConvertUtf16ToUtf8(const char16_t* input,
+                          size_t length,
+                          char* output,
+                          InvalidUtf16Policy policy) {
+  char* out = output;
+  size_t i = 0;
+  while (i < length) {
+    size_t ascii = ConvertAsciiBlocks(input + i, length - i, out);
+    i += ascii;
+    out += ascii;
+
+    // Convert scalars until the next code unit that could start a block.
+    while (i < length) {
+      uint32_t unit = input[i];
+      if (unit < 0x80) {
+        *out++ = static_cast<char>(unit);
+        ++i;
+        // Hand a long ASCII run back to the block converter.
+        if (i + 8 <= length && input[i] < 0x80) {
+          break;
+        }
+        continue;
+      }
+      ++i;
+      uint32_t code_point = unit;
+      if (IsHighSurrogate(unit) && i < length && IsLowSurrogate(input[i])) {
+        code_point = 0x10000 + ((unit - 0xD800) << 10) + (input[i] - 0xDC00);
+        ++i;
+      } else if (IsHighSurrogate(unit) || IsLowSurrogate(unit)) {
+        if (policy == InvalidUtf16Policy::kFail) {
+          return kUtf8ConversionFailed;
+        }
+        code_point = 0xFFFD;
+      }
+      if (code_point < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+      } else if (code_point < 0x10000) {
+        *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+      } else {
+        *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+      }
+    }
+  }
+  return static_cast<size_t>(out - output);
+}
+
+bool AppendUtf16AsUtf8(std::u16string_view input,
+                       std::string* output,
+                       InvalidUtf16Policy policy) {
+  if (input.empty()) {
+    return true;
+  }
+  // Growing |output| to the worst case up front would zero-fill three bytes
+  // per unit, most of which are cut off again. Convert into this thread's
+  // reusable buffer instead, and copy in only what was written.
+  thread_local Utf8Buffer buffer;
+  std::string_view utf8 = buffer.Convert(input, policy);
+  if (utf8.empty()) {
+    return false;
+  }
+  output->append(utf8);
+  return true;
+}
+
+void AppendUtf8AsUtf16(std::string_view input, std::u16string* output) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(input.data());
+  const uint8_t* end = p + input.size();
+  output->reserve(output->size() + input.size());
+  while (p < end) {
+    uint32_t lead = *p++;
+    if (lead < 0x80) {
+      output->push_back(static_cast<char16_t>(lead));
+      continue;
+    }
+    // The sequence length and the smallest code point it may encode, which
+    // rules out overlong forms.
+    size_t continuation;
+    uint32_t code_point;
+    uint32_t min;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      continuation = 1;
+      code_point = lead & 0x1F;
+      min = 0x80;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      continuation = 2;
+      code_point = lead & 0x0F;
+      min = 0x800;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      continuation = 3;
+      code_point = lead & 0x07;
+      min = 0x10000;
+    } else {
+      output->push_back(0xFFFD);
+      continue;
+    }
+    size_t i = 0;
+    for (; i < continuation && p + i < end && (p[i] & 0xC0) == 0x80; ++i) {
+      code_point = (code_point << 6) | (p[i] & 0x3F);
+    }
+    if (i < continuation || code_point < min || code_point > 0x10FFFF ||
+        (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+      output->push_back(0xFFFD);
+      continue;
+    }
+    p += continuation;
+    if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      output->push_back(static_cast<char16_t>(0xD800 + (code_point >> 10)));
+      output->push_back(static_cast<char16_t>(0xDC00 + (code_point & 0x3FF)));
+    } else {
+      output->push_back(static_cast<char16_t>(code_point));
+    }
+  }
+}
+
+std::string_view Utf8Buffer::Convert(std::u16string_view input,
+                                     InvalidUtf16Policy policy) {
+  size_t required = MaxUtf8Length(input.size());
+  if (required > capacity_) {
+    // Grow geometrically so a slowly increasing input size does not
+    // reallocate on every call.
+    size_t capacity = capacity_ * 2 > required ? capacity_ * 2 : required;
+    data_.reset(new char[capacity]);
+    capacity_ = capacity;
+  }
+  size_t written =
+      ConvertUtf16ToUtf8(input.data(), input.size(), data_.get(), policy);
+  if (written == kUtf8ConversionFailed) {
+    return std::string_view();
+  }
+  return std::string_view(data_.get(), written);
+}
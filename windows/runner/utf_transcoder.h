@@ -0,0 +1,80 @@
+#ifndef RUNNER_UTF_TRANSCODER_H_
+#define RUNNER_UTF_TRANSCODER_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Single-pass UTF-16 to UTF-8 conversion, and the reverse for the rarer
+// strings that arrive as UTF-8.
+//
+// Runs of ASCII are converted with SSE2, AVX2 or NEON when the build targets
+// them, falling back to scalar code otherwise; everything else takes the
+// scalar path. Output is written in one pass into storage sized for the
+// worst case (three bytes per UTF-16 code unit), so no length pre-pass is
+// needed.
+
+// What to do with an unpaired surrogate.
+enum class InvalidUtf16Policy {
+  // Fail the conversion, like WideCharToMultiByte with WC_ERR_INVALID_CHARS.
+  kFail,
+  // Emit U+FFFD REPLACEMENT CHARACTER and continue.
+  kReplace,
+};
+
+// The largest number of UTF-8 bytes |utf16_length| code units can produce.
+constexpr size_t MaxUtf8Length(size_t utf16_length) {
+  return utf16_length * 3;
+}
+
+// Returned by |ConvertUtf16ToUtf8| when the input cannot be converted.
+constexpr size_t kUtf8ConversionFailed = static_cast<size_t>(-1);
+
+// Converts |length| code units at |input| into |output|, which must have room
+// for |MaxUtf8Length(length)| bytes. Returns the number of bytes written, or
+// |kUtf8ConversionFailed| if |policy| is kFail and an unpaired surrogate was
+// found.
+size_t ConvertUtf16ToUtf8(const char16_t* input,
+                          size_t length,
+                          char* output,
+                          InvalidUtf16Policy policy = InvalidUtf16Policy::kFail);
+
+// Appends the UTF-8 form of |input| to |output|, growing it only by the bytes
+// actually written. Converts through a per-thread |Utf8Buffer|, which keeps
+// the storage of the largest conversion on that thread. On failure |output|
+// is left unchanged and false is returned.
+bool AppendUtf16AsUtf8(std::u16string_view input,
+                       std::string* output,
+                       InvalidUtf16Policy policy = InvalidUtf16Policy::kFail);
+
+// Appends the UTF-16 form of |input| to |output|. Invalid sequences are
+// replaced with U+FFFD, one per byte.
+void AppendUtf8AsUtf16(std::string_view input, std::u16string* output);
+
+// A growable conversion buffer for callers that convert repeatedly.
+//
+// Unlike std::string, growing the buffer does not zero-fill it, and its
+// storage is kept between conversions, so steady-state conversions do not
+// allocate.
+class Utf8Buffer {
+ public:
+  Utf8Buffer() = default;
+
+  Utf8Buffer(const Utf8Buffer&) = delete;
+  Utf8Buffer& operator=(const Utf8Buffer&) = delete;
+
+  // Converts |input| and returns a view of the result that stays valid until
+  // the next call. Returns an empty view on failure.
+  std::string_view Convert(
+      std::u16string_view input,
+      InvalidUtf16Policy policy = InvalidUtf16Policy::kFail);
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  size_t capacity_ = 0;
+};
+
+#endif  // RUNNER_UTF_TRANSCODER_H_
@@ -5,7 +5,26 @@
 #include <stdio.h>
 #include <windows.h>
 
-#include <iostream>
+#include <string>
+
+#include "command_line.h"
+#include "logging.h"
+#include "metrics.h"
+#include "trace.h"
+#include "utf_transcoder.h"
+
+namespace {
+
+// Where to write the startup trace, or empty if it was not requested.
+std::wstring g_trace_file;
+
+// Where to write runtime metrics, or empty if they were not requested.
+std::wstring g_metrics_file;
+
+// Whether --texture-views was passed.
+bool g_texture_views = false;
+
+}  // namespace
 
 void CreateAndAttachConsole() {
   if (::AllocConsole()) {
@@ -16,7 +35,6 @@ void CreateAndAttachConsole() {
     if (freopen_s(&unused, "CONOUT$", "w", stderr)) {
       _dup2(_fileno(stdout), 2);
     }
-    std::ios::sync_with_stdio();
     FlutterDesktopResyncOutputStreams();
   }
 }
@@ -29,37 +47,117 @@ std::vector<std::string> GetCommandLineArguments() {
     return std::vector<std::string>();
   }
 
-  std::vector<std::string> command_line_arguments;
-
   // Skip the first argument as it's the binary name.
+  std::vector<std::u16string_view> arguments;
   for (int i = 1; i < argc; i++) {
-    command_line_arguments.push_back(Utf8FromUtf16(argv[i]));
+    arguments.push_back(Utf16View(argv[i]));
   }
 
+  RunnerFlags flags;
+  std::vector<std::string> command_line_arguments =
+      ParseCommandLine(arguments, &flags);
+
   ::LocalFree(argv);
 
+  g_texture_views = flags.texture_views;
+  if (flags.trace_file) {
+    g_trace_file.assign(flags.trace_file->begin(), flags.trace_file->end());
+    StartTracing();
+  }
+  if (flags.metrics_file) {
+    g_metrics_file.assign(flags.metrics_file->begin(),
+                          flags.metrics_file->end());
+  }
   return command_line_arguments;
 }
 
+bool UseTextureViews() {
+  return g_texture_views;
+}
+
 std::string Utf8FromUtf16(const wchar_t* utf16_string) {
-  if (utf16_string == nullptr) {
-    return std::string();
-  }
-  int target_length = ::WideCharToMultiByte(
-      CP_UTF8, WC_ERR_INVALID_CHARS, utf16_string,
-      -1, nullptr, 0, nullptr, nullptr)
-    -1; // remove the trailing null character
-  int input_length = (int)wcslen(utf16_string);
   std::string utf8_string;
-  if (target_length <= 0 || target_length > utf8_string.max_size()) {
-    return utf8_string;
-  }
-  utf8_string.resize(target_length);
-  int converted_length = ::WideCharToMultiByte(
-      CP_UTF8, WC_ERR_INVALID_CHARS, utf16_string,
-      input_length, utf8_string.data(), target_length, nullptr, nullptr);
-  if (converted_length == 0) {
+  if (utf16_string == nullptr ||
+      !AppendUtf16AsUtf8(Utf16View(utf16_string), &utf8_string)) {
     return std::string();
   }
   return utf8_string;
 }
+
+std::u16string_view Utf16View(const wchar_t* utf16_string) {
+  static_assert(sizeof(wchar_t) == sizeof(char16_t),
+                "wchar_t must hold UTF-16 code units");
+  if (utf16_string == nullptr) {
+    return std::u16string_view();
+  }
+  return std::u16string_view(reinterpret_cast<const char16_t*>(utf16_string),
+                             wcslen(utf16_string));
+}
+
+std::wstring GetDataFilePath(const wchar_t* name) {
+  wchar_t path[MAX_PATH];
+  DWORD length = ::GetModuleFileNameW(nullptr, path, MAX_PATH);
+  if (length == 0 || length == MAX_PATH) {
+    return std::wstring();
+  }
+  std::wstring file(path, length);
+  file.erase(file.find_last_of(L'\\') + 1);
+  file.append(L"data\\").append(name);
+  return file;
+}
+
+bool ReadDataFile(const wchar_t* name, std::string* contents) {
+  std::wstring file = GetDataFilePath(name);
+  if (file.empty()) {
+    return false;
+  }
+
+  FILE* stream = nullptr;
+  if (_wfopen_s(&stream, file.c_str(), L"rb") != 0 || stream == nullptr) {
+    return false;
+  }
+  contents->clear();
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), stream)) > 0) {
+    contents->append(buffer, read);
+  }
+  bool ok = !ferror(stream);
+  fclose(stream);
+  return ok;
+}
+
+void WriteStartupTrace() {
+  if (g_trace_file.empty()) {
+    return;
+  }
+  StopTracing();
+  std::string trace = ExportChromeTrace();
+  FILE* stream = nullptr;
+  if (_wfopen_s(&stream, g_trace_file.c_str(), L"wb") != 0 || stream == nullptr) {
+    RUNNER_LOG_ERROR("Could not open {} for the startup trace", g_trace_file);
+    return;
+  }
+  fwrite(trace.data(), 1, trace.size(), stream);
+  fclose(stream);
+  RUNNER_LOG_INFO("Wrote startup trace to {} ({} events dropped)",
+                  g_trace_file, DroppedTraceEventCount());
+}
+
+bool MetricsFileRequested() {
+  return !g_metrics_file.empty();
+}
+
+void WriteMetricsFile() {
+  if (g_metrics_file.empty()) {
+    return;
+  }
+  std::string metrics = Metrics().ToJson();
+  FILE* stream = nullptr;
+  if (_wfopen_s(&stream, g_metrics_file.c_str(), L"wb") != 0 || stream == nullptr) {
+    RUNNER_LOG_ERROR("Could not open {} for metrics", g_metrics_file);
+    return;
+  }
+  fwrite(metrics.data(), 1, metrics.size(), stream);
+  fclose(stream);
+}
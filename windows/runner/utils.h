@@ -2,6 +2,7 @@
 #define RUNNER_UTILS_H_
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Creates a console for the process, and redirects stdout and stderr to
@@ -12,8 +13,46 @@ void CreateAndAttachConsole();
 // encoded in UTF-8. Returns an empty std::string on failure.
 std::string Utf8FromUtf16(const wchar_t* utf16_string);
 
+// Returns a view of the null-terminated UTF-16 |utf16_string| as char16_t
+// code units, for use with the conversions in utf_transcoder.h. Returns an
+// empty view for nullptr.
+std::u16string_view Utf16View(const wchar_t* utf16_string);
+
 // Gets the command line arguments passed in as a std::vector<std::string>,
 // encoded in UTF-8. Returns an empty std::vector<std::string> on failure.
+//
+// Runner flags are handled here and not passed on:
+//   --trace-startup[=<file>]  Starts timeline tracing (see trace.h); the trace
+//                             is written by |WriteStartupTrace|.
+//   --metrics[=<file>]        Writes runtime metrics (see metrics.h) with
+//                             |WriteMetricsFile|.
+//   --texture-views           See |UseTextureViews|.
 std::vector<std::string> GetCommandLineArguments();
 
+// Returns whether platform views should be shown as Flutter textures rather
+// than child windows. Valid after |GetCommandLineArguments|.
+bool UseTextureViews();
+
+// Stops tracing started with --trace-startup and writes the trace to the
+// requested file, runner_trace.json in the working directory by default.
+// Does nothing if tracing was not requested.
+void WriteStartupTrace();
+
+// Returns whether --metrics was passed. Valid after
+// |GetCommandLineArguments|.
+bool MetricsFileRequested();
+
+// Writes a snapshot of the runtime metrics to the file requested with
+// --metrics, runner_metrics.json in the working directory by default,
+// replacing the last one. Does nothing if no file was requested.
+void WriteMetricsFile();
+
+// Returns the path of the file |name| in the data directory next to the
+// executable, or an empty string if the executable's path is unavailable.
+std::wstring GetDataFilePath(const wchar_t* name);
+
+// Reads the file |name| from the data directory next to the executable into
+// |contents|. Returns false if it does not exist or cannot be read.
+bool ReadDataFile(const wchar_t* name, std::string* contents);
+
 #endif  // RUNNER_UTILS_H_
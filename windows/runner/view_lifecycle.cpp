@@ -0,0 +1,221 @@
+#include "view_lifecycle.h"
+
+ViewLifecycleManager::ViewLifecycleManager(ViewLifecycleDelegate* delegate,
+                                           ViewLifecycleOptions options)
+    : delegate_(delegate), options_(options) {}
+
+void ViewLifecycleManager::AddView(LifecycleViewId view,
+                                   Clock::time_point now) {
+  if (Find(view) != nullptr) {
+    return;
+  }
+  Entry entry;
+  entry.id = view;
+  entry.last_used = now;
+  entry.hidden_since = now;
+  views_.push_back(entry);
+  Update(now);
+}
+
+void ViewLifecycleManager::RemoveView(LifecycleViewId view) {
+  for (auto it = views_.begin(); it != views_.end(); ++it) {
+    if (it->id == view) {
+      views_.erase(it);
+      return;
+    }
+  }
+}
+
+void ViewLifecycleManager::SetVisible(LifecycleViewId view,
+                                      bool visible,
+                                      Clock::time_point now) {
+  Entry* entry = Find(view);
+  if (entry == nullptr || entry->visible == visible) {
+    return;
+  }
+  entry->visible = visible;
+  if (visible) {
+    entry->last_used = now;
+    Activate(entry);
+  } else {
+    entry->hidden_since = now;
+  }
+  Update(now);
+}
+
+void ViewLifecycleManager::Touch(LifecycleViewId view, Clock::time_point now) {
+  Entry* entry = Find(view);
+  if (entry == nullptr) {
+    return;
+  }
+  entry->last_used = now;
+  // A hidden view that is interacted with restarts its idle period.
+  entry->hidden_since = now;
+  Activate(entry);
+  Update(now);
+}
+
+void ViewLifecycleManager::OnSuspendFailed(LifecycleViewId view,
+                                           Clock::time_point now) {
+  Entry* entry = Find(view);
+  if (entry == nullptr || entry->state != ViewLifecycleState::kSuspended) {
+    return;
+  }
+  ++stats_.suspend_failures;
+  entry->state = ViewLifecycleState::kActive;
+  entry->retry_after = now + options_.suspend_retry_delay;
+}
+
+void ViewLifecycleManager::Update(Clock::time_point now) {
+  // Suspend views that have been hidden long enough.
+  for (Entry& entry : views_) {
+    if (entry.state == ViewLifecycleState::kActive && !entry.visible &&
+        now - entry.hidden_since >= options_.hidden_suspend_delay &&
+        CanSuspend(entry, now)) {
+      Suspend(&entry);
+    }
+  }
+
+  // Then demote the least recently used hidden views until within budget.
+  // Too many live views can only be fixed by discarding, so suspension is
+  // only tried first when memory is the problem.
+  while (true) {
+    bool over_views = OverViewBudget();
+    if (!over_views && !OverMemoryBudget()) {
+      break;
+    }
+    Entry* entry = LeastRecentlyUsedHidden();
+    if (entry == nullptr) {
+      break;
+    }
+    if (!over_views && entry->state == ViewLifecycleState::kActive &&
+        CanSuspend(*entry, now)) {
+      Suspend(entry);
+    } else {
+      Discard(entry);
+    }
+  }
+}
+
+std::optional<ViewLifecycleManager::Clock::time_point>
+ViewLifecycleManager::NextUpdateTime() const {
+  std::optional<Clock::time_point> next;
+  for (const Entry& entry : views_) {
+    if (entry.state != ViewLifecycleState::kActive || entry.visible) {
+      continue;
+    }
+    Clock::time_point due = entry.hidden_since + options_.hidden_suspend_delay;
+    if (entry.retry_after > due) {
+      due = entry.retry_after;
+    }
+    if (!next || due < *next) {
+      next = due;
+    }
+  }
+  return next;
+}
+
+std::optional<ViewLifecycleState> ViewLifecycleManager::StateOf(
+    LifecycleViewId view) const {
+  const Entry* entry = Find(view);
+  if (entry == nullptr) {
+    return std::nullopt;
+  }
+  return entry->state;
+}
+
+size_t ViewLifecycleManager::EstimatedMemory() const {
+  size_t total = 0;
+  for (const Entry& entry : views_) {
+    switch (entry.state) {
+      case ViewLifecycleState::kActive:
+        total += options_.active_view_bytes;
+        break;
+      case ViewLifecycleState::kSuspended:
+        total += options_.suspended_view_bytes;
+        break;
+      case ViewLifecycleState::kDiscarded:
+        break;
+    }
+  }
+  return total;
+}
+
+ViewLifecycleManager::Entry* ViewLifecycleManager::Find(LifecycleViewId view) {
+  for (Entry& entry : views_) {
+    if (entry.id == view) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+const ViewLifecycleManager::Entry* ViewLifecycleManager::Find(
+    LifecycleViewId view) const {
+  return const_cast<ViewLifecycleManager*>(this)->Find(view);
+}
+
+void ViewLifecycleManager::Activate(Entry* entry) {
+  switch (entry->state) {
+    case ViewLifecycleState::kActive:
+      return;
+    case ViewLifecycleState::kSuspended:
+      entry->state = ViewLifecycleState::kActive;
+      ++stats_.resumed;
+      delegate_->ResumeView(entry->id);
+      return;
+    case ViewLifecycleState::kDiscarded:
+      entry->state = ViewLifecycleState::kActive;
+      ++stats_.restored;
+      delegate_->RestoreView(entry->id);
+      return;
+  }
+}
+
+void ViewLifecycleManager::Suspend(Entry* entry) {
+  entry->state = ViewLifecycleState::kSuspended;
+  ++stats_.suspended;
+  delegate_->SuspendView(entry->id);
+}
+
+void ViewLifecycleManager::Discard(Entry* entry) {
+  entry->state = ViewLifecycleState::kDiscarded;
+  ++stats_.discarded;
+  delegate_->DiscardView(entry->id);
+}
+
+bool ViewLifecycleManager::CanSuspend(const Entry& entry,
+                                      Clock::time_point now) const {
+  return now >= entry.retry_after;
+}
+
+bool ViewLifecycleManager::OverMemoryBudget() const {
+  return options_.memory_budget_bytes != 0 &&
+         EstimatedMemory() > options_.memory_budget_bytes;
+}
+
+bool ViewLifecycleManager::OverViewBudget() const {
+  if (options_.max_live_views == 0) {
+    return false;
+  }
+  size_t live = 0;
+  for (const Entry& entry : views_) {
+    if (entry.state != ViewLifecycleState::kDiscarded) {
+      ++live;
+    }
+  }
+  return live > options_.max_live_views;
+}
+
+ViewLifecycleManager::Entry* ViewLifecycleManager::LeastRecentlyUsedHidden() {
+  Entry* best = nullptr;
+  for (Entry& entry : views_) {
+    if (entry.visible || entry.state == ViewLifecycleState::kDiscarded) {
+      continue;
+    }
+    if (best == nullptr || entry.last_used < best->last_used) {
+      best = &entry;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,149 @@
+#ifndef RUNNER_VIEW_LIFECYCLE_H_
+#define RUNNER_VIEW_LIFECYCLE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Moves web views between active, suspended and discarded states to keep
+// them within a memory and view-count budget.
+//
+// Visible views are always active. Views that have been hidden for a while
+// are suspended, and when the budget is exceeded the least recently used
+// hidden views are suspended and then discarded. A view that becomes visible
+// or gains focus again is resumed or restored. The manager only makes
+// decisions; a |ViewLifecycleDelegate| carries them out, so the policy runs
+// the same against real web views and against a simulation.
+
+using LifecycleViewId = uint64_t;
+
+enum class ViewLifecycleState : uint8_t {
+  // Rendering normally.
+  kActive,
+  // Renderer paused, document kept.
+  kSuspended,
+  // Web view released; it is recreated from its last URL when needed.
+  kDiscarded,
+};
+
+// Carries out the manager's decisions. Called from within the manager's
+// methods.
+class ViewLifecycleDelegate {
+ public:
+  virtual ~ViewLifecycleDelegate() = default;
+
+  // Starts suspending |view|. If that fails, report it through
+  // |ViewLifecycleManager::OnSuspendFailed|.
+  virtual void SuspendView(LifecycleViewId view) = 0;
+
+  // Resumes a suspended |view|.
+  virtual void ResumeView(LifecycleViewId view) = 0;
+
+  // Releases |view|'s web view, keeping what is needed to restore it.
+  virtual void DiscardView(LifecycleViewId view) = 0;
+
+  // Recreates a discarded |view|.
+  virtual void RestoreView(LifecycleViewId view) = 0;
+};
+
+struct ViewLifecycleOptions {
+  // Views that are not discarded. Zero means no limit.
+  size_t max_live_views = 0;
+  // Estimated memory of all views. Zero means no limit.
+  size_t memory_budget_bytes = 0;
+  // Estimated memory of an active and of a suspended view.
+  size_t active_view_bytes = 64 * 1024 * 1024;
+  size_t suspended_view_bytes = 16 * 1024 * 1024;
+  // How long a view stays hidden before it is suspended regardless of the
+  // budget.
+  std::chrono::milliseconds hidden_suspend_delay{5000};
+  // How long to wait before retrying a view whose suspension failed.
+  std::chrono::milliseconds suspend_retry_delay{10000};
+};
+
+struct ViewLifecycleStats {
+  uint64_t suspended = 0;
+  uint64_t resumed = 0;
+  uint64_t discarded = 0;
+  uint64_t restored = 0;
+  uint64_t suspend_failures = 0;
+};
+
+class ViewLifecycleManager {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  ViewLifecycleManager(ViewLifecycleDelegate* delegate,
+                       ViewLifecycleOptions options);
+
+  ViewLifecycleManager(const ViewLifecycleManager&) = delete;
+  ViewLifecycleManager& operator=(const ViewLifecycleManager&) = delete;
+
+  // Starts tracking |view|, which is active and visible.
+  void AddView(LifecycleViewId view, Clock::time_point now);
+
+  // Stops tracking |view|.
+  void RemoveView(LifecycleViewId view);
+
+  // Records whether |view| is on screen. Showing a view brings it back
+  // immediately; hiding it takes effect at a later |Update|.
+  void SetVisible(LifecycleViewId view, bool visible, Clock::time_point now);
+
+  // Records that |view| gained focus or was interacted with, bringing it
+  // back if needed and making it the most recently used view.
+  void Touch(LifecycleViewId view, Clock::time_point now);
+
+  // Reports that suspending |view| did not succeed; it is treated as active
+  // and not suspended again before |suspend_retry_delay| has passed.
+  void OnSuspendFailed(LifecycleViewId view, Clock::time_point now);
+
+  // Applies the idle and budget policies as of |now|.
+  void Update(Clock::time_point now);
+
+  // Returns when |Update| next has time-based work to do, if ever.
+  std::optional<Clock::time_point> NextUpdateTime() const;
+
+  std::optional<ViewLifecycleState> StateOf(LifecycleViewId view) const;
+  size_t EstimatedMemory() const;
+  size_t view_count() const { return views_.size(); }
+  const ViewLifecycleStats& stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    LifecycleViewId id;
+    ViewLifecycleState state = ViewLifecycleState::kActive;
+    bool visible = true;
+    // Last time the view was shown, focused or touched.
+    Clock::time_point last_used;
+    // When the view was last hidden.
+    Clock::time_point hidden_since;
+    // Earliest time the view may be suspended again after a failure.
+    Clock::time_point retry_after;
+  };
+
+  Entry* Find(LifecycleViewId view);
+  const Entry* Find(LifecycleViewId view) const;
+
+  // Makes |entry| active again.
+  void Activate(Entry* entry);
+  void Suspend(Entry* entry);
+  void Discard(Entry* entry);
+
+  bool CanSuspend(const Entry& entry, Clock::time_point now) const;
+  bool OverMemoryBudget() const;
+  bool OverViewBudget() const;
+
+  // Returns the least recently used hidden view that is not discarded, or
+  // null.
+  Entry* LeastRecentlyUsedHidden();
+
+  ViewLifecycleDelegate* delegate_;
+  ViewLifecycleOptions options_;
+  // A handful of views at most, so lookups and LRU selection scan linearly.
+  std::vector<Entry> views_;
+  ViewLifecycleStats stats_;
+};
+
+#endif  // RUNNER_VIEW_LIFECYCLE_H_
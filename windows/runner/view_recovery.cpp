@@ -0,0 +1,186 @@
+#include "view_recovery.h"
+
+#include <algorithm>
+#include <utility>
+
+ViewRecoveryManager::ViewRecoveryManager(ViewRecoveryDelegate* delegate,
+                                         ViewRecoveryOptions options)
+    : delegate_(delegate), options_(options) {}
+
+void ViewRecoveryManager::AddView(RecoveryViewId view) {
+  if (Find(view) != nullptr) {
+    return;
+  }
+  Entry entry;
+  entry.id = view;
+  entry.browser_generation = browser_generation_;
+  views_.push_back(std::move(entry));
+}
+
+void ViewRecoveryManager::RemoveView(RecoveryViewId view) {
+  for (auto it = views_.begin(); it != views_.end(); ++it) {
+    if (it->id == view) {
+      views_.erase(it);
+      return;
+    }
+  }
+}
+
+void ViewRecoveryManager::OnProcessFailed(RecoveryViewId view,
+                                          WebViewProcessFailure failure,
+                                          Clock::time_point now) {
+  Entry* entry = Find(view);
+  if (entry == nullptr) {
+    return;
+  }
+  // Only a view with a working controller has anything to recover; the
+  // others' controllers are already being replaced or disposed of.
+  bool recoverable =
+      entry->state == ViewRecoveryState::kHealthy ||
+      entry->state == ViewRecoveryState::kRestoring;
+  bool fatal =
+      failure == WebViewProcessFailure::kBrowserExited ||
+      failure == WebViewProcessFailure::kRendererExited ||
+      (failure == WebViewProcessFailure::kRendererUnresponsive &&
+       options_.recover_unresponsive);
+  if (!recoverable || !fatal) {
+    ++stats_.ignored_failures;
+    return;
+  }
+  if (entry->state == ViewRecoveryState::kHealthy) {
+    entry->failed_at = now;
+  }
+  if (failure != WebViewProcessFailure::kBrowserExited) {
+    ++stats_.renderer_failures;
+    Retry(entry, now);
+    return;
+  }
+  ++stats_.browser_failures;
+  if (entry->browser_generation == browser_generation_) {
+    // The first report of this browser's failure. Restarting it before
+    // any replacement is requested keeps the standby controllers it took
+    // down from being handed out.
+    ++browser_generation_;
+    ++stats_.browser_restarts;
+    delegate_->RestartBrowser();
+    entry = Find(view);
+    if (entry == nullptr) {
+      return;
+    }
+  }
+  Retry(entry, now);
+}
+
+void ViewRecoveryManager::OnReplacementAttached(RecoveryViewId view,
+                                                bool attached,
+                                                Clock::time_point now) {
+  Entry* entry = Find(view);
+  if (entry == nullptr || entry->state != ViewRecoveryState::kReplacing) {
+    return;
+  }
+  if (!attached) {
+    ++stats_.replacement_failures;
+    Retry(entry, now);
+    return;
+  }
+  entry->state = ViewRecoveryState::kRestoring;
+  entry->browser_generation = browser_generation_;
+}
+
+void ViewRecoveryManager::OnNavigationCompleted(RecoveryViewId view,
+                                                Clock::time_point now) {
+  Entry* entry = Find(view);
+  if (entry == nullptr || entry->state != ViewRecoveryState::kRestoring) {
+    return;
+  }
+  entry->state = ViewRecoveryState::kHealthy;
+  std::chrono::nanoseconds recovery_time = now - entry->failed_at;
+  ++stats_.recovered;
+  stats_.total_recovery_time += recovery_time;
+  stats_.max_recovery_time = std::max(stats_.max_recovery_time, recovery_time);
+  delegate_->ViewRecovered(view, recovery_time);
+}
+
+void ViewRecoveryManager::Update(Clock::time_point now) {
+  // Indexed, since the delegate may add or remove views.
+  for (size_t i = 0; i < views_.size(); ++i) {
+    if (views_[i].state == ViewRecoveryState::kBackingOff &&
+        views_[i].retry_at <= now) {
+      Replace(&views_[i]);
+    }
+  }
+}
+
+std::optional<ViewRecoveryManager::Clock::time_point>
+ViewRecoveryManager::NextUpdateTime() const {
+  std::optional<Clock::time_point> next;
+  for (const Entry& entry : views_) {
+    if (entry.state == ViewRecoveryState::kBackingOff &&
+        (!next || entry.retry_at < *next)) {
+      next = entry.retry_at;
+    }
+  }
+  return next;
+}
+
+std::optional<ViewRecoveryState> ViewRecoveryManager::StateOf(
+    RecoveryViewId view) const {
+  const Entry* entry = Find(view);
+  if (entry == nullptr) {
+    return std::nullopt;
+  }
+  return entry->state;
+}
+
+ViewRecoveryManager::Entry* ViewRecoveryManager::Find(RecoveryViewId view) {
+  for (Entry& entry : views_) {
+    if (entry.id == view) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+const ViewRecoveryManager::Entry* ViewRecoveryManager::Find(
+    RecoveryViewId view) const {
+  for (const Entry& entry : views_) {
+    if (entry.id == view) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void ViewRecoveryManager::Retry(Entry* entry, Clock::time_point now) {
+  std::vector<Clock::time_point>& failures = entry->failures;
+  failures.erase(
+      failures.begin(),
+      std::find_if(failures.begin(), failures.end(),
+                   [this, now](Clock::time_point failure) {
+                     return now - failure < options_.failure_window;
+                   }));
+  failures.push_back(now);
+  if (failures.size() >= options_.max_failures) {
+    entry->state = ViewRecoveryState::kAbandoned;
+    ++stats_.abandoned;
+    delegate_->AbandonView(entry->id);
+    return;
+  }
+  if (failures.size() == 1) {
+    Replace(entry);
+    return;
+  }
+  std::chrono::milliseconds delay = options_.retry_delay;
+  for (size_t i = 2; i < failures.size() && delay < options_.max_retry_delay;
+       ++i) {
+    delay *= 2;
+  }
+  entry->state = ViewRecoveryState::kBackingOff;
+  entry->retry_at = now + std::min(delay, options_.max_retry_delay);
+}
+
+void ViewRecoveryManager::Replace(Entry* entry) {
+  entry->state = ViewRecoveryState::kReplacing;
+  ++stats_.replacements;
+  delegate_->ReplaceController(entry->id);
+}
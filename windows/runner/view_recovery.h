@@ -0,0 +1,178 @@
+#ifndef RUNNER_VIEW_RECOVERY_H_
+#define RUNNER_VIEW_RECOVERY_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "web_view_backend.h"
+
+// Brings web views back after their renderer or browser process fails.
+//
+// A failed view gets a replacement controller, normally a standby one that
+// the |ControllerPool| keeps warm, and the replacement reloads the view's
+// last committed page with its scripts. A browser failure takes every
+// controller with it, standby ones included, so the first view to report
+// it also has the browser restarted. A view that keeps failing is retried
+// with exponential backoff and abandoned once it fails too often within a
+// window, so a page that crashes its renderer as it loads cannot keep the
+// runner busy.
+//
+// Like |ViewLifecycleManager|, the manager only makes decisions, which a
+// |ViewRecoveryDelegate| carries out, and takes the time from its caller,
+// so a sequence of failures always produces the same decisions.
+
+using RecoveryViewId = uint64_t;
+
+enum class ViewRecoveryState : uint8_t {
+  // Working, or recovered.
+  kHealthy,
+  // Failed again soon after an earlier failure; waiting to retry.
+  kBackingOff,
+  // Waiting for a replacement controller.
+  kReplacing,
+  // The replacement is loading the view's page.
+  kRestoring,
+  // Failed too often; left as it is.
+  kAbandoned,
+};
+
+// Carries out the manager's decisions. Called from within the manager's
+// methods.
+class ViewRecoveryDelegate {
+ public:
+  virtual ~ViewRecoveryDelegate() = default;
+
+  // Disposes of |view|'s failed controller, if it still has one, and
+  // requests a replacement that loads the view's last committed page and
+  // scripts. Report the outcome through
+  // |ViewRecoveryManager::OnReplacementAttached| and, once the page has
+  // loaded, |OnNavigationCompleted|.
+  virtual void ReplaceController(RecoveryViewId view) = 0;
+
+  // Disposes of the standby controllers of the failed browser process, and
+  // has controllers requested from now on come from a new one.
+  virtual void RestartBrowser() = 0;
+
+  // Disposes of |view|'s failed controller; the view stays empty.
+  virtual void AbandonView(RecoveryViewId view) = 0;
+
+  // Reports that |view| recovered, |recovery_time| after it failed.
+  virtual void ViewRecovered(RecoveryViewId view,
+                             std::chrono::nanoseconds recovery_time) = 0;
+};
+
+struct ViewRecoveryOptions {
+  // Whether a renderer that stops responding is replaced like one that
+  // exited. A renderer can become responsive again, but the page is
+  // unusable until it does.
+  bool recover_unresponsive = true;
+  // A view's first failure within |failure_window| is recovered at once.
+  // Each further one waits |retry_delay|, doubling per failure, up to
+  // |max_retry_delay|.
+  std::chrono::milliseconds retry_delay{500};
+  std::chrono::milliseconds max_retry_delay{8000};
+  std::chrono::milliseconds failure_window{60000};
+  // Failures within |failure_window|, including replacements that could
+  // not be created, after which a view is abandoned.
+  size_t max_failures = 5;
+};
+
+struct ViewRecoveryStats {
+  uint64_t browser_failures = 0;
+  uint64_t renderer_failures = 0;
+  // Failures that need no recovery: of subframes and helper processes, or
+  // of views already being recovered.
+  uint64_t ignored_failures = 0;
+  uint64_t browser_restarts = 0;
+  // Replacements requested, and those that could not be created.
+  uint64_t replacements = 0;
+  uint64_t replacement_failures = 0;
+  uint64_t recovered = 0;
+  uint64_t abandoned = 0;
+  // From a view's failure to its replacement loading the page, over all
+  // recoveries.
+  std::chrono::nanoseconds total_recovery_time{0};
+  std::chrono::nanoseconds max_recovery_time{0};
+};
+
+class ViewRecoveryManager {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  ViewRecoveryManager(ViewRecoveryDelegate* delegate,
+                      ViewRecoveryOptions options);
+
+  ViewRecoveryManager(const ViewRecoveryManager&) = delete;
+  ViewRecoveryManager& operator=(const ViewRecoveryManager&) = delete;
+
+  // Starts tracking |view|, whose controller is healthy.
+  void AddView(RecoveryViewId view);
+
+  // Stops tracking |view|.
+  void RemoveView(RecoveryViewId view);
+
+  // Reports that |view|'s controller raised |failure|.
+  void OnProcessFailed(RecoveryViewId view,
+                       WebViewProcessFailure failure,
+                       Clock::time_point now);
+
+  // Reports whether |view| got the replacement it was waiting for. A
+  // missing replacement counts as another failure.
+  void OnReplacementAttached(RecoveryViewId view,
+                             bool attached,
+                             Clock::time_point now);
+
+  // Reports that |view|'s page finished loading, successfully or not.
+  void OnNavigationCompleted(RecoveryViewId view, Clock::time_point now);
+
+  // Retries the views whose backoff has elapsed as of |now|.
+  void Update(Clock::time_point now);
+
+  // Returns when |Update| next has a view to retry, if ever.
+  std::optional<Clock::time_point> NextUpdateTime() const;
+
+  std::optional<ViewRecoveryState> StateOf(RecoveryViewId view) const;
+  size_t view_count() const { return views_.size(); }
+  const ViewRecoveryStats& stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    RecoveryViewId id;
+    ViewRecoveryState state = ViewRecoveryState::kHealthy;
+    // The browser the view's controller belongs to; see
+    // |browser_generation_|.
+    uint64_t browser_generation = 0;
+    // When the failure being recovered from was reported.
+    Clock::time_point failed_at;
+    // When a view backing off is retried.
+    Clock::time_point retry_at;
+    // Failures within the failure window, oldest first.
+    std::vector<Clock::time_point> failures;
+  };
+
+  Entry* Find(RecoveryViewId view);
+  const Entry* Find(RecoveryViewId view) const;
+
+  // Records a failure of |entry| at |now| and replaces its controller now
+  // or after a backoff, or abandons it.
+  void Retry(Entry* entry, Clock::time_point now);
+
+  // Requests a replacement for |entry|'s controller. |entry| may be
+  // invalid afterwards.
+  void Replace(Entry* entry);
+
+  ViewRecoveryDelegate* delegate_;
+  ViewRecoveryOptions options_;
+  // A handful of views at most, so lookups scan linearly.
+  std::vector<Entry> views_;
+  // Counts browser restarts. A browser failure reported by a view whose
+  // controller came from an earlier browser is part of a failure already
+  // handled, and does not restart the browser again.
+  uint64_t browser_generation_ = 0;
+  ViewRecoveryStats stats_;
+};
+
+#endif  // RUNNER_VIEW_RECOVERY_H_
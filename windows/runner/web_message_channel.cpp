@@ -0,0 +1,126 @@
+#include "web_message_channel.h"
+
+#include <utility>
+
+namespace {
+
+// Appends |value| in decimal without allocating.
+void AppendDecimal(std::u16string* buffer, uint64_t value) {
+  char16_t digits[20];
+  size_t count = 0;
+  do {
+    digits[count++] = static_cast<char16_t>(u'0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (count > 0) {
+    buffer->push_back(digits[--count]);
+  }
+}
+
+// Parses a decimal number terminated by ':' starting at |*position|, and
+// advances past the terminator. Returns false on malformed input.
+bool ParseDecimal(std::u16string_view text, size_t* position, uint64_t* value) {
+  // Enough digits for any length a web message can have.
+  constexpr size_t kMaxDigits = 12;
+  size_t start = *position;
+  uint64_t result = 0;
+  size_t i = start;
+  for (; i < text.size() && text[i] != u':'; ++i) {
+    char16_t c = text[i];
+    if (c < u'0' || c > u'9' || i - start >= kMaxDigits) {
+      return false;
+    }
+    result = result * 10 + (c - u'0');
+  }
+  if (i == start || i == text.size()) {
+    return false;
+  }
+  *value = result;
+  *position = i + 1;
+  return true;
+}
+
+}  // namespace
+
+bool IsWebMessageBatch(std::u16string_view message) {
+  return !message.empty() && message[0] == kWebMessageBatchMarker;
+}
+
+WebMessageBatcher::WebMessageBatcher(WebMessageTransport* transport)
+    : transport_(transport) {}
+
+bool WebMessageBatcher::Send(WebMessageChannelId channel,
+                             std::u16string_view payload) {
+  bool started = pending_messages_ == 0;
+  if (started) {
+    buffer_.clear();
+    buffer_.push_back(kWebMessageBatchMarker);
+  }
+  AppendDecimal(&buffer_, channel);
+  buffer_.push_back(u':');
+  AppendDecimal(&buffer_, payload.size());
+  buffer_.push_back(u':');
+  buffer_.append(payload);
+  ++pending_messages_;
+  ++stats_.messages;
+  stats_.payload_units += payload.size();
+  return started;
+}
+
+size_t WebMessageBatcher::Flush() {
+  size_t posted = pending_messages_;
+  if (posted == 0) {
+    return 0;
+  }
+  // Swap buffers first so a transport that sends from within |Post| (for
+  // example a loopback echo) starts a new batch instead of overwriting the
+  // one being posted. Both buffers keep their capacity.
+  pending_messages_ = 0;
+  ++stats_.batches;
+  buffer_.swap(in_flight_);
+  transport_->Post(in_flight_);
+  return posted;
+}
+
+WebMessageDispatcher::WebMessageDispatcher() = default;
+
+void WebMessageDispatcher::SetHandler(WebMessageChannelId channel,
+                                      Handler handler) {
+  if (channel >= handlers_.size()) {
+    if (!handler) {
+      return;
+    }
+    handlers_.resize(static_cast<size_t>(channel) + 1);
+  }
+  handlers_[channel] = std::move(handler);
+}
+
+bool WebMessageDispatcher::Dispatch(std::u16string_view batch) {
+  if (!IsWebMessageBatch(batch)) {
+    ++stats_.malformed;
+    return false;
+  }
+  ++stats_.batches;
+  size_t position = 1;
+  while (position < batch.size()) {
+    uint64_t channel;
+    uint64_t length;
+    if (!ParseDecimal(batch, &position, &channel) ||
+        !ParseDecimal(batch, &position, &length) ||
+        channel > UINT16_MAX || length > batch.size() - position) {
+      ++stats_.malformed;
+      return false;
+    }
+    std::u16string_view payload = batch.substr(position, length);
+    position += length;
+
+    ++stats_.messages;
+    stats_.payload_units += length;
+    if (channel < handlers_.size() && handlers_[channel]) {
+      handlers_[channel](payload);
+    } else {
+      ++stats_.unhandled;
+    }
+  }
+  return true;
+}
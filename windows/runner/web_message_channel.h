@@ -0,0 +1,129 @@
+#ifndef RUNNER_WEB_MESSAGE_CHANNEL_H_
+#define RUNNER_WEB_MESSAGE_CHANNEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Framed, batched messaging between the host and web content.
+//
+// Many logical messages, each tagged with a channel id, are packed into a
+// single web message so that a burst costs one post instead of one per
+// message. A batch is the marker character followed by frames of the form
+//
+//   <channel>:<length>:<payload>
+//
+// where |channel| and |length| are decimal and |length| counts UTF-16 code
+// units, matching JavaScript's String.length. Payloads are not escaped.
+
+using WebMessageChannelId = uint16_t;
+
+// The first code unit of every batch. Messages without it are not batches.
+constexpr char16_t kWebMessageBatchMarker = u'\x1E';
+
+// Returns true if |message| is a batch produced by |WebMessageBatcher| or by
+// the page-side encoder.
+bool IsWebMessageBatch(std::u16string_view message);
+
+// Delivers encoded batches to the other side.
+class WebMessageTransport {
+ public:
+  virtual ~WebMessageTransport() = default;
+
+  // Posts |batch|. The data is always followed by a null terminator, and is
+  // only valid for the duration of the call.
+  virtual void Post(std::u16string_view batch) = 0;
+};
+
+struct WebMessageChannelStats {
+  // Logical messages sent or delivered to a handler.
+  uint64_t messages = 0;
+  // Batches posted or dispatched.
+  uint64_t batches = 0;
+  // Payload code units sent or delivered.
+  uint64_t payload_units = 0;
+  // Incoming messages with no handler for their channel.
+  uint64_t unhandled = 0;
+  // Incoming batches that stopped at a malformed frame.
+  uint64_t malformed = 0;
+};
+
+// Accumulates outgoing messages and posts them as one batch per |Flush|.
+//
+// The encode buffer keeps its capacity between batches, so steady-state
+// sending does not allocate.
+class WebMessageBatcher {
+ public:
+  explicit WebMessageBatcher(WebMessageTransport* transport);
+
+  WebMessageBatcher(const WebMessageBatcher&) = delete;
+  WebMessageBatcher& operator=(const WebMessageBatcher&) = delete;
+
+  // Queues |payload| on |channel|. Returns true if this started a new batch,
+  // meaning the caller should schedule a |Flush|.
+  bool Send(WebMessageChannelId channel, std::u16string_view payload);
+
+  // Posts the pending batch, if any. Returns the number of messages posted.
+  size_t Flush();
+
+  bool has_pending() const { return pending_messages_ > 0; }
+  const WebMessageChannelStats& stats() const { return stats_; }
+
+ private:
+  WebMessageTransport* transport_;
+  // The batch being built, and the one most recently posted.
+  std::u16string buffer_;
+  std::u16string in_flight_;
+  size_t pending_messages_ = 0;
+  WebMessageChannelStats stats_;
+};
+
+// Splits incoming batches and routes each message to its channel's handler.
+//
+// Payloads are passed to handlers as views into the batch itself; nothing is
+// copied. Handlers are stored in a table indexed by channel id.
+class WebMessageDispatcher {
+ public:
+  using Handler = std::function<void(std::u16string_view payload)>;
+
+  WebMessageDispatcher();
+
+  WebMessageDispatcher(const WebMessageDispatcher&) = delete;
+  WebMessageDispatcher& operator=(const WebMessageDispatcher&) = delete;
+
+  // Routes messages on |channel| to |handler|, replacing any previous one.
+  // Pass an empty handler to unregister.
+  void SetHandler(WebMessageChannelId channel, Handler handler);
+
+  // Delivers every message in |batch|. Returns false if the batch is not a
+  // batch or contains a malformed frame; messages before the malformed frame
+  // are still delivered.
+  bool Dispatch(std::u16string_view batch);
+
+  const WebMessageChannelStats& stats() const { return stats_; }
+
+ private:
+  std::vector<Handler> handlers_;
+  WebMessageChannelStats stats_;
+};
+
+// A transport that hands batches straight to a dispatcher in the same
+// process, for exercising both ends without a web view.
+class LoopbackWebMessageTransport : public WebMessageTransport {
+ public:
+  explicit LoopbackWebMessageTransport(WebMessageDispatcher* receiver)
+      : receiver_(receiver) {}
+
+  // WebMessageTransport:
+  void Post(std::u16string_view batch) override {
+    receiver_->Dispatch(batch);
+  }
+
+ private:
+  WebMessageDispatcher* receiver_;
+};
+
+#endif  // RUNNER_WEB_MESSAGE_CHANNEL_H_
@@ -0,0 +1,189 @@
+#ifndef RUNNER_WEB_VIEW_BACKEND_H_
+#define RUNNER_WEB_VIEW_BACKEND_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "controller_pool.h"
+#include "geometry.h"
+#include "pixel_pipeline.h"
+#include "script_batcher.h"
+#include "web_message_channel.h"
+
+// The web view operations the runner relies on, independent of WebView2.
+//
+// |WebViewEnvironment| (webview_environment.h) implements them with WebView2
+// on Windows, and |SimulatedWebViewBackend| (simulated_web_view.h) in
+// process on a virtual clock, so code written against these interfaces can
+// be exercised and profiled on any platform.
+//
+// Everything runs on one thread. Strings passed to a controller are always
+// followed by a null terminator; strings passed to callbacks are only valid
+// for the duration of the call.
+
+// A native window handle (an HWND on Windows).
+using NativeWindow = std::uintptr_t;
+
+// Why focus moves into or out of a web view. The values match
+// COREWEBVIEW2_MOVE_FOCUS_REASON and the engine's focus reasons.
+enum class WebViewFocusReason : uint8_t {
+  kProgrammatic = 0,
+  kNext = 1,
+  kPrevious = 2,
+};
+
+// Which of a web view's processes failed. The values match
+// COREWEBVIEW2_PROCESS_FAILED_KIND; later kinds are reported as kOther.
+enum class WebViewProcessFailure : uint8_t {
+  // The browser process exited, taking every web view with it.
+  kBrowserExited = 0,
+  // The main frame's renderer exited; the page is gone.
+  kRendererExited = 1,
+  // The main frame's renderer stopped responding to input.
+  kRendererUnresponsive = 2,
+  // A subframe's renderer exited; the rest of the page still works.
+  kFrameRendererExited = 3,
+  // A helper process, such as the GPU process, exited and is restarted.
+  kOther = 4,
+};
+
+// Settings a view applies to the controller it hosts. The defaults are
+// WebView2's.
+struct WebViewSettings {
+  bool script_enabled = true;
+  bool script_dialogs_enabled = true;
+  bool context_menus_enabled = true;
+  bool dev_tools_enabled = true;
+  bool zoom_control_enabled = true;
+};
+
+// Handlers for a controller's events. Any may be empty.
+struct WebViewEvents {
+  // A top-level navigation to |uri| is starting. Returns false to cancel it.
+  std::function<bool(std::u16string_view uri)> navigation_starting;
+  // A top-level navigation finished, was cancelled or failed.
+  std::function<void(bool succeeded)> navigation_completed;
+  // One of the web view's processes failed. The controller must not be
+  // destroyed from within the handler.
+  std::function<void(WebViewProcessFailure failure)> process_failed;
+  // The page posted |message| with window.chrome.webview.postMessage.
+  std::function<void(std::u16string_view message)> web_message_received;
+  // The page posted a value other than a string; |json| is its JSON.
+  std::function<void(std::u16string_view json)> web_message_json_received;
+  // The user tabbed out of the page.
+  std::function<void(WebViewFocusReason reason)> move_focus_requested;
+  std::function<void()> got_focus;
+  std::function<void()> lost_focus;
+};
+
+// A web view and the native surface it renders into.
+class WebViewController {
+ public:
+  // Receives whether the script ran and its result as JSON.
+  using ScriptCallback = ScriptEngine::Callback;
+  // Receives whether the renderer was suspended.
+  using SuspendCallback = std::function<void(bool suspended)>;
+  // Receives a captured frame, or null if capturing failed.
+  using FrameCallback = std::function<void(const PixelFrame* frame)>;
+
+  virtual ~WebViewController() = default;
+
+  // Routes this controller's events to |events|, replacing earlier
+  // handlers. Pass empty events before handing the controller to another
+  // view.
+  virtual void SetEvents(WebViewEvents events) = 0;
+
+  // Moves the surface into |parent|, sizes it to |bounds| in the parent's
+  // coordinates and shows it.
+  virtual void Attach(NativeWindow parent, const IntRect& bounds) = 0;
+
+  // Sizes the surface to |bounds| within the window it is attached to.
+  virtual void SetBounds(const IntRect& bounds) = 0;
+
+  // Hides the surface, moves it out of its parent and unloads the current
+  // document, so it can be attached to another view.
+  virtual void Detach() = 0;
+
+  virtual void SetVisible(bool visible) = 0;
+  virtual void Navigate(std::u16string_view uri) = 0;
+
+  // Replaces the controller's settings. They apply to documents loaded
+  // from now on.
+  virtual void ApplySettings(const WebViewSettings& settings) = 0;
+
+  // Replaces the scripts run, in order, at the start of every document
+  // loaded from now on, after the runner's own.
+  virtual void SetDocumentScripts(std::vector<std::u16string> scripts) = 0;
+
+  // Returns the URI of the current document.
+  virtual std::u16string Source() = 0;
+
+  // Evaluates |script| in the current document. |callback| is invoked
+  // exactly once, possibly before this method returns.
+  virtual void ExecuteScript(std::u16string_view script,
+                             ScriptCallback callback) = 0;
+
+  // Posts |message| to the page as a string.
+  virtual void PostWebMessage(std::u16string_view message) = 0;
+
+  // Posts |json|, which must be valid JSON, to the page as the value it
+  // encodes.
+  virtual void PostWebMessageAsJson(std::u16string_view json) = 0;
+
+  // Moves keyboard focus into the page.
+  virtual void MoveFocus(WebViewFocusReason reason) = 0;
+
+  // Hides the web view and tries to suspend its renderer. |callback| is
+  // invoked exactly once, possibly before this method returns.
+  virtual void TrySuspend(SuspendCallback callback) = 0;
+
+  // Resumes a suspended renderer and shows the web view again.
+  virtual void Resume() = 0;
+
+  // Captures what the page currently shows as BGRA pixels. |callback| is
+  // invoked exactly once, possibly before this method returns.
+  virtual void CaptureFrame(FrameCallback callback) = 0;
+};
+
+// What a |ControllerPool| manages: an owned controller, empty on failure.
+using WebViewSurface = std::unique_ptr<WebViewController>;
+
+// Creates and disposes of controllers.
+using WebViewBackend = ControllerSource<WebViewSurface>;
+
+// Runs |ScriptBatcher| batches through a controller.
+class WebViewScriptEngine : public ScriptEngine {
+ public:
+  explicit WebViewScriptEngine(WebViewController* controller)
+      : controller_(controller) {}
+
+  // ScriptEngine:
+  void Execute(std::u16string_view script, Callback callback) override {
+    controller_->ExecuteScript(script, std::move(callback));
+  }
+
+ private:
+  WebViewController* controller_;
+};
+
+// Posts |WebMessageBatcher| batches through a controller.
+class WebViewMessageTransport : public WebMessageTransport {
+ public:
+  explicit WebViewMessageTransport(WebViewController* controller)
+      : controller_(controller) {}
+
+  // WebMessageTransport:
+  void Post(std::u16string_view batch) override {
+    controller_->PostWebMessage(batch);
+  }
+
+ private:
+  WebViewController* controller_;
+};
+
+#endif  // RUNNER_WEB_VIEW_BACKEND_H_
@@ -0,0 +1,106 @@
+#include "web_view_creation_params.h"
+
+#include <limits>
+
+namespace {
+
+bool ReadBool(StandardValue value, bool* out) {
+  if (value.IsNull()) {
+    return true;
+  }
+  if (!value.IsBool()) {
+    return false;
+  }
+  *out = value.GetBool();
+  return true;
+}
+
+// Reads a size in pixels, which must be non-negative and fit a window.
+bool ReadSize(StandardValue value, int32_t* out) {
+  if (value.IsNull()) {
+    return true;
+  }
+  if (!value.IsInt() || value.GetInt() < 0 ||
+      value.GetInt() > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  *out = static_cast<int32_t>(value.GetInt());
+  return true;
+}
+
+bool ReadSettings(StandardValue value, WebViewSettings* settings) {
+  if (value.IsNull()) {
+    return true;
+  }
+  if (value.type() != StandardType::kMap) {
+    return false;
+  }
+  return ReadBool(value.Find("scriptEnabled"), &settings->script_enabled) &&
+         ReadBool(value.Find("scriptDialogsEnabled"),
+                  &settings->script_dialogs_enabled) &&
+         ReadBool(value.Find("contextMenusEnabled"),
+                  &settings->context_menus_enabled) &&
+         ReadBool(value.Find("devToolsEnabled"),
+                  &settings->dev_tools_enabled) &&
+         ReadBool(value.Find("zoomControlEnabled"),
+                  &settings->zoom_control_enabled);
+}
+
+bool ReadScripts(StandardValue value, std::vector<std::string_view>* scripts) {
+  if (value.IsNull()) {
+    return true;
+  }
+  if (value.type() != StandardType::kList) {
+    return false;
+  }
+  bool valid = true;
+  scripts->reserve(value.size());
+  value.ForEachElement([&](StandardValue script) {
+    valid = valid && script.type() == StandardType::kString;
+    scripts->push_back(script.GetString());
+  });
+  return valid;
+}
+
+}  // namespace
+
+bool ReadWebViewCreationParams(StandardValue value,
+                               WebViewCreationParams* params,
+                               std::string* error) {
+  *params = WebViewCreationParams();
+  if (value.IsNull()) {
+    return true;
+  }
+  if (value.type() != StandardType::kMap) {
+    *error = "creation params are not a map";
+    return false;
+  }
+  // One pass over the entries rather than a lookup per key.
+  std::string_view invalid;
+  value.ForEachEntry([&](StandardValue key, StandardValue entry) {
+    std::string_view name = key.GetString();
+    bool valid = true;
+    if (name == "url") {
+      valid = entry.IsNull() || entry.type() == StandardType::kString;
+      params->url = entry.GetString();
+    } else if (name == "width") {
+      valid = ReadSize(entry, &params->width);
+    } else if (name == "height") {
+      valid = ReadSize(entry, &params->height);
+    } else if (name == "settings") {
+      valid = ReadSettings(entry, &params->settings);
+    } else if (name == "scripts") {
+      valid = ReadScripts(entry, &params->scripts);
+    }
+    if (!valid && invalid.empty()) {
+      invalid = name;
+    }
+  });
+  if (!invalid.empty()) {
+    *error = std::string(invalid);
+    error->append(" has the wrong type");
+    *params = WebViewCreationParams();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,43 @@
+#ifndef RUNNER_WEB_VIEW_CREATION_PARAMS_H_
+#define RUNNER_WEB_VIEW_CREATION_PARAMS_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "standard_codec.h"
+#include "web_view_backend.h"
+
+// What the app asks of a web view it creates, sent as a map encoded with
+// the standard message codec:
+//
+//   {
+//     'url': 'https://appassets.local/index.html',
+//     'width': 640, 'height': 480,
+//     'settings': {'scriptEnabled': true, 'scriptDialogsEnabled': false,
+//                  'contextMenusEnabled': false, 'devToolsEnabled': false,
+//                  'zoomControlEnabled': true},
+//     'scripts': ['window.appMode = "embedded";'],
+//   }
+//
+// Every entry is optional. Unknown keys are ignored, so the app can send
+// parameters a newer runner understands.
+struct WebViewCreationParams {
+  // The first page to load; empty for the runner's start page.
+  std::string_view url;
+  // The view's initial size in physical pixels; 0 to fill the parent.
+  int32_t width = 0;
+  int32_t height = 0;
+  WebViewSettings settings;
+  // Run, in order, at the start of every document the view loads.
+  std::vector<std::string_view> scripts;
+};
+
+// Reads |value| into |params|, whose strings then point into the message
+// |value| was decoded from. On failure returns false and sets |error|.
+bool ReadWebViewCreationParams(StandardValue value,
+                               WebViewCreationParams* params,
+                               std::string* error);
+
+#endif  // RUNNER_WEB_VIEW_CREATION_PARAMS_H_
@@ -0,0 +1,58 @@
+#ifndef RUNNER_WEB_VIEW_TASKS_H_
+#define RUNNER_WEB_VIEW_TASKS_H_
+
+#include <string>
+#include <utility>
+
+#include "coroutine.h"
+#include "web_view_backend.h"
+
+// Awaitable versions of the callback-based web view operations, for use in
+// |Task|s (coroutine.h). Each evaluates to an empty optional if the task is
+// cancelled before the operation completes.
+//
+//   std::optional<WebViewSurface> surface =
+//       co_await CreateControllerAsync(backend);
+//   std::optional<ScriptResult> title =
+//       co_await ExecuteScriptAsync(surface->get(), u"document.title");
+
+// The outcome of running a script.
+struct ScriptResult {
+  bool succeeded = false;
+  // The script's result as JSON.
+  std::u16string json;
+};
+
+// Creates a controller, which is empty if creation failed. If the task is
+// cancelled first, a controller created afterwards is destroyed.
+inline auto CreateControllerAsync(WebViewBackend* backend) {
+  return Async<WebViewSurface>([backend](Resolver<WebViewSurface> resolve) {
+    backend->CreateController([resolve](WebViewSurface surface) {
+      resolve(std::move(surface));
+    });
+  });
+}
+
+// Runs |script| in the current document of |controller|, which must
+// outlive the operation.
+inline auto ExecuteScriptAsync(WebViewController* controller,
+                               std::u16string script) {
+  return Async<ScriptResult>(
+      [controller,
+       script = std::move(script)](Resolver<ScriptResult> resolve) {
+        controller->ExecuteScript(
+            script, [resolve](bool succeeded, std::u16string_view json) {
+              resolve(ScriptResult{succeeded, std::u16string(json)});
+            });
+      });
+}
+
+// Hides |controller| and tries to suspend its renderer. Evaluates to
+// whether it was suspended.
+inline auto TrySuspendAsync(WebViewController* controller) {
+  return Async<bool>([controller](Resolver<bool> resolve) {
+    controller->TrySuspend([resolve](bool suspended) { resolve(suspended); });
+  });
+}
+
+#endif  // RUNNER_WEB_VIEW_TASKS_H_
@@ -0,0 +1,65 @@
+#include "web_view_texture.h"
+
+#include <mutex>
+#include <vector>
+
+#include "logging.h"
+#include "trace.h"
+
+struct WebViewTexture::State {
+  FramePipeline pipeline{FramePipelineOptions()};
+  // Guards |pipeline|'s output. Held from |CopyPixelBuffer| until the
+  // engine calls the buffer's release callback.
+  std::mutex mutex;
+  FlutterDesktopPixelBuffer buffer = {};
+  std::unique_ptr<flutter::TextureVariant> texture;
+
+  // Called by the engine on its raster thread.
+  const FlutterDesktopPixelBuffer* CopyPixelBuffer(size_t width,
+                                                   size_t height) {
+    mutex.lock();
+    if (pipeline.width() == 0) {
+      mutex.unlock();
+      return nullptr;
+    }
+    buffer.buffer = pipeline.pixels();
+    buffer.width = static_cast<size_t>(pipeline.width());
+    buffer.height = static_cast<size_t>(pipeline.height());
+    buffer.release_callback = [](void* context) {
+      static_cast<std::mutex*>(context)->unlock();
+    };
+    buffer.release_context = &mutex;
+    return &buffer;
+  }
+};
+
+WebViewTexture::WebViewTexture(flutter::TextureRegistrar* registrar)
+    : registrar_(registrar), state_(std::make_shared<State>()) {
+  State* state = state_.get();
+  state->texture = std::make_unique<flutter::TextureVariant>(
+      flutter::PixelBufferTexture([state](size_t width, size_t height) {
+        return state->CopyPixelBuffer(width, height);
+      }));
+  id_ = registrar_->RegisterTexture(state->texture.get());
+  RUNNER_LOG_DEBUG("Registered web view texture {}", id_);
+}
+
+WebViewTexture::~WebViewTexture() {
+  const FramePipelineStats& stats = state_->pipeline.stats();
+  RUNNER_LOG_DEBUG("Texture {}: {} frames, {} unchanged, {} tiles converted",
+                   id_, stats.frames, stats.unchanged_frames,
+                   stats.tiles_converted);
+  registrar_->UnregisterTexture(id_, [state = state_] {});
+}
+
+void WebViewTexture::Update(const PixelFrame& frame) {
+  RUNNER_TRACE_SCOPE("UpdateWebViewTexture");
+  bool changed;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    changed = !state_->pipeline.Process(frame).empty();
+  }
+  if (changed) {
+    registrar_->MarkTextureFrameAvailable(id_);
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef RUNNER_WEB_VIEW_TEXTURE_H_
+#define RUNNER_WEB_VIEW_TEXTURE_H_
+
+#include <flutter/texture_registrar.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "pixel_pipeline.h"
+
+// A Flutter texture showing captured frames of a web view, for
+// --texture-views mode.
+//
+// Unlike a child window, the texture is composited by the engine, so
+// Flutter widgets can draw over the page. Frames go through a
+// |FramePipeline|, so only changed tiles are converted, and the engine is
+// only told about frames in which something changed. The engine copies the
+// pixels on its raster thread; the buffer is locked from the copy callback
+// until the engine releases it.
+class WebViewTexture {
+ public:
+  // Registers the texture with |registrar|, which must outlive this object.
+  explicit WebViewTexture(flutter::TextureRegistrar* registrar);
+
+  // Unregisters the texture. The pixels are freed once the engine is done
+  // with them.
+  ~WebViewTexture();
+
+  WebViewTexture(const WebViewTexture&) = delete;
+  WebViewTexture& operator=(const WebViewTexture&) = delete;
+
+  // Brings the texture up to date with |frame|.
+  void Update(const PixelFrame& frame);
+
+  int64_t id() const { return id_; }
+
+ private:
+  struct State;
+
+  flutter::TextureRegistrar* registrar_;
+  // Shared with the unregistration callback, which releases it.
+  std::shared_ptr<State> state_;
+  int64_t id_ = -1;
+};
+
+#endif  // RUNNER_WEB_VIEW_TEXTURE_H_
@@ -0,0 +1,874 @@
+#include "webview_environment.h"
+
+#include <wincodec.h>
+#include <wrl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "logging.h"
+#include "metrics.h"
+#include "trace.h"
+#include "utils.h"
+
+struct WebViewAssets {
+  std::string origin;
+  // The WebResourceRequested filter matching |origin|.
+  std::wstring filter;
+  std::shared_ptr<const MappedFile> file;
+  AssetPack pack;
+};
+
+namespace {
+
+// Page side of the batched message channel (see web_message_channel.h).
+// runnerChannel.send() queues messages and posts them as one batch per
+// animation frame; incoming batches are split and routed to the handler
+// registered for each channel with runnerChannel.on().
+constexpr wchar_t kWebMessageChannelScript[] =
+    L"(() => {"
+    L"  const marker = '\\x1E';"
+    L"  const handlers = new Map();"
+    L"  let queue = [];"
+    L"  let scheduled = false;"
+    L"  const flush = () => {"
+    L"    scheduled = false;"
+    L"    let batch = marker;"
+    L"    for (const [channel, payload] of queue) {"
+    L"      batch += channel + ':' + payload.length + ':' + payload;"
+    L"    }"
+    L"    queue = [];"
+    L"    window.chrome.webview.postMessage(batch);"
+    L"  };"
+    L"  window.runnerChannel = {"
+    L"    send(channel, payload) {"
+    L"      queue.push([channel, String(payload)]);"
+    L"      if (!scheduled) {"
+    L"        scheduled = true;"
+    L"        requestAnimationFrame(flush);"
+    L"      }"
+    L"    },"
+    L"    on(channel, handler) { handlers.set(channel, handler); },"
+    L"  };"
+    L"  window.chrome.webview.addEventListener('message', event => {"
+    L"    const batch = event.data;"
+    L"    if (typeof batch !== 'string' || batch[0] !== marker) return;"
+    L"    for (let i = 1; i < batch.length;) {"
+    L"      const a = batch.indexOf(':', i);"
+    L"      const b = batch.indexOf(':', a + 1);"
+    L"      if (a < 0 || b < 0) return;"
+    L"      const length = Number(batch.slice(a + 1, b));"
+    L"      const handler = handlers.get(Number(batch.slice(i, a)));"
+    L"      if (handler) handler(batch.substr(b + 1, length));"
+    L"      i = b + 1 + length;"
+    L"    }"
+    L"  });"
+    L"})();";
+
+// Page side of the RPC router (see rpc_router.h). runnerRpc.call() posts a
+// request object and returns a promise settled by the reply with the same
+// id; runnerRpc.notify() posts a request that gets no reply.
+constexpr wchar_t kRpcScript[] =
+    L"(() => {"
+    L"  const pending = new Map();"
+    L"  let nextId = 1;"
+    L"  window.runnerRpc = {"
+    L"    call(method, ...params) {"
+    L"      const id = nextId++;"
+    L"      return new Promise((resolve, reject) => {"
+    L"        pending.set(id, {resolve, reject});"
+    L"        window.chrome.webview.postMessage({id, method, params});"
+    L"      });"
+    L"    },"
+    L"    notify(method, ...params) {"
+    L"      window.chrome.webview.postMessage({method, params});"
+    L"    },"
+    L"  };"
+    L"  window.chrome.webview.addEventListener('message', event => {"
+    L"    const reply = event.data;"
+    L"    if (reply === null || typeof reply !== 'object') return;"
+    L"    const call = pending.get(reply.id);"
+    L"    if (!call) return;"
+    L"    pending.delete(reply.id);"
+    L"    if ('error' in reply) {"
+    L"      const error = new Error(reply.error.message);"
+    L"      error.code = reply.error.code;"
+    L"      call.reject(error);"
+    L"    } else {"
+    L"      call.resolve(reply.result);"
+    L"    }"
+    L"  });"
+    L"})();";
+
+// Runtime metrics (see metrics.h) for controller creation and asset
+// requests.
+Histogram* const g_controller_create_us =
+    Metrics().GetHistogram("webview.controller_create_us");
+Counter* const g_controller_create_failed =
+    Metrics().GetCounter("webview.controller_create_failed");
+Counter* const g_assets_served = Metrics().GetCounter("assets.served");
+Counter* const g_assets_not_found = Metrics().GetCounter("assets.not_found");
+
+// The outcome of a WebView2 operation that completes with an object.
+template <typename T>
+struct ComResult {
+  HRESULT result;
+  wil::com_ptr<T> object;
+};
+
+// Applies the configuration shared by every controller, regardless of which
+// view ends up hosting it.
+void ConfigureController(ICoreWebView2Controller* controller) {
+  wil::com_ptr<ICoreWebView2> webview;
+  controller->get_CoreWebView2(&webview);
+
+  // Add a few settings for the webview
+  // The demo step is redundant since the values are the default settings
+  wil::com_ptr<ICoreWebView2Settings> settings;
+  webview->get_Settings(&settings);
+  settings->put_IsScriptEnabled(TRUE);
+  settings->put_AreDefaultScriptDialogsEnabled(TRUE);
+  settings->put_IsWebMessageEnabled(TRUE);
+
+  // Schedule an async task to add initialization script that
+  // 1) Add an listener to print message from the host
+  // 2) Post document URL to the host
+  webview->AddScriptToExecuteOnDocumentCreated(kWebMessageChannelScript,
+                                               nullptr);
+  webview->AddScriptToExecuteOnDocumentCreated(kRpcScript, nullptr);
+  webview->AddScriptToExecuteOnDocumentCreated(
+      L"window.chrome.webview.addEventListener(\'message\', event => {"
+      L"  if (typeof event.data === 'string' && event.data[0] !== '\\x1E') alert(event.data);"
+      L"});"
+      L"window.chrome.webview.postMessage(window.document.URL);",
+      nullptr);
+}
+
+// Decodes the image in |stream| into BGRA |pixels| described by |frame|.
+bool DecodeBgra(IStream* stream,
+                std::vector<uint8_t>* pixels,
+                PixelFrame* frame) {
+  wil::com_ptr<IWICImagingFactory> factory;
+  wil::com_ptr<IWICBitmapDecoder> decoder;
+  wil::com_ptr<IWICBitmapFrameDecode> source;
+  wil::com_ptr<IWICFormatConverter> converter;
+  UINT width = 0;
+  UINT height = 0;
+  if (FAILED(stream->Seek(LARGE_INTEGER{}, STREAM_SEEK_SET, nullptr)) ||
+      FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr,
+                              CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))) ||
+      FAILED(factory->CreateDecoderFromStream(
+          stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder)) ||
+      FAILED(decoder->GetFrame(0, &source)) ||
+      FAILED(factory->CreateFormatConverter(&converter)) ||
+      FAILED(converter->Initialize(source.get(), GUID_WICPixelFormat32bppBGRA,
+                                   WICBitmapDitherTypeNone, nullptr, 0.0,
+                                   WICBitmapPaletteTypeCustom)) ||
+      FAILED(converter->GetSize(&width, &height)) || width == 0 ||
+      height == 0) {
+    return false;
+  }
+  UINT stride = width * 4;
+  pixels->resize(static_cast<size_t>(stride) * height);
+  if (FAILED(converter->CopyPixels(nullptr, stride,
+                                   static_cast<UINT>(pixels->size()),
+                                   pixels->data()))) {
+    return false;
+  }
+  *frame = PixelFrame{pixels->data(), stride, static_cast<int32_t>(width),
+                      static_cast<int32_t>(height)};
+  return true;
+}
+
+// A read-only stream over one asset's bytes in the mapped pack. WebView2
+// reads response bodies from it directly, so an asset is never copied into
+// a buffer of the runner's own. Holds the pack alive until released.
+class AssetStream
+    : public Microsoft::WRL::RuntimeClass<
+          Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+          IStream> {
+ public:
+  AssetStream(std::shared_ptr<const WebViewAssets> assets,
+              std::string_view data)
+      : assets_(std::move(assets)), data_(data) {}
+
+  // ISequentialStream:
+  HRESULT STDMETHODCALLTYPE Read(void* buffer,
+                                 ULONG size,
+                                 ULONG* read) override {
+    size_t available = position_ < data_.size() ? data_.size() - position_ : 0;
+    ULONG count = static_cast<ULONG>(std::min<size_t>(size, available));
+    std::memcpy(buffer, data_.data() + position_, count);
+    position_ += count;
+    if (read != nullptr) {
+      *read = count;
+    }
+    return count < size ? S_FALSE : S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE Write(const void* buffer,
+                                  ULONG size,
+                                  ULONG* written) override {
+    return STG_E_ACCESSDENIED;
+  }
+
+  // IStream:
+  HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move,
+                                 DWORD origin,
+                                 ULARGE_INTEGER* new_position) override {
+    int64_t base = 0;
+    if (origin == STREAM_SEEK_CUR) {
+      base = static_cast<int64_t>(position_);
+    } else if (origin == STREAM_SEEK_END) {
+      base = static_cast<int64_t>(data_.size());
+    } else if (origin != STREAM_SEEK_SET) {
+      return STG_E_INVALIDFUNCTION;
+    }
+    int64_t position = base + move.QuadPart;
+    if (position < 0) {
+      return STG_E_INVALIDFUNCTION;
+    }
+    position_ = static_cast<size_t>(position);
+    if (new_position != nullptr) {
+      new_position->QuadPart = position_;
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER size) override {
+    return STG_E_ACCESSDENIED;
+  }
+
+  HRESULT STDMETHODCALLTYPE CopyTo(IStream* stream,
+                                   ULARGE_INTEGER size,
+                                   ULARGE_INTEGER* read,
+                                   ULARGE_INTEGER* written) override {
+    return E_NOTIMPL;
+  }
+
+  HRESULT STDMETHODCALLTYPE Commit(DWORD flags) override { return S_OK; }
+
+  HRESULT STDMETHODCALLTYPE Revert() override { return S_OK; }
+
+  HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER offset,
+                                       ULARGE_INTEGER size,
+                                       DWORD type) override {
+    return STG_E_INVALIDFUNCTION;
+  }
+
+  HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER offset,
+                                         ULARGE_INTEGER size,
+                                         DWORD type) override {
+    return STG_E_INVALIDFUNCTION;
+  }
+
+  HRESULT STDMETHODCALLTYPE Stat(STATSTG* stat, DWORD flags) override {
+    *stat = {};
+    stat->type = STGTY_STREAM;
+    stat->cbSize.QuadPart = data_.size();
+    stat->grfMode = STGM_READ;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE Clone(IStream** stream) override {
+    Microsoft::WRL::ComPtr<AssetStream> clone =
+        Microsoft::WRL::Make<AssetStream>(assets_, data_);
+    if (!clone) {
+      return E_OUTOFMEMORY;
+    }
+    clone->position_ = position_;
+    *stream = clone.Detach();
+    return S_OK;
+  }
+
+ private:
+  std::shared_ptr<const WebViewAssets> assets_;
+  std::string_view data_;
+  size_t position_ = 0;
+};
+
+WebViewProcessFailure ToProcessFailure(COREWEBVIEW2_PROCESS_FAILED_KIND kind) {
+  switch (kind) {
+    case COREWEBVIEW2_PROCESS_FAILED_KIND_BROWSER_PROCESS_EXITED:
+    case COREWEBVIEW2_PROCESS_FAILED_KIND_RENDER_PROCESS_EXITED:
+    case COREWEBVIEW2_PROCESS_FAILED_KIND_RENDER_PROCESS_UNRESPONSIVE:
+    case COREWEBVIEW2_PROCESS_FAILED_KIND_FRAME_RENDER_PROCESS_EXITED:
+      return static_cast<WebViewProcessFailure>(kind);
+    default:
+      return WebViewProcessFailure::kOther;
+  }
+}
+
+// A WebView2 controller hosted in its own child window.
+//
+// Event handlers are registered once, when the controller is created, and
+// forward to whichever |WebViewEvents| the current view installed, so
+// handing the controller to another view costs no COM calls.
+class WebView2Controller : public WebViewController {
+ public:
+  WebView2Controller(HWND window,
+                     HWND parking_window,
+                     ICoreWebView2Environment* environment,
+                     ICoreWebView2Controller* controller,
+                     std::shared_ptr<const WebViewAssets> assets);
+  ~WebView2Controller() override;
+
+  WebView2Controller(const WebView2Controller&) = delete;
+  WebView2Controller& operator=(const WebView2Controller&) = delete;
+
+  // WebViewController:
+  void SetEvents(WebViewEvents events) override;
+  void Attach(NativeWindow parent, const IntRect& bounds) override;
+  void SetBounds(const IntRect& bounds) override;
+  void Detach() override;
+  void SetVisible(bool visible) override;
+  void Navigate(std::u16string_view uri) override;
+  void ApplySettings(const WebViewSettings& settings) override;
+  void SetDocumentScripts(std::vector<std::u16string> scripts) override;
+  std::u16string Source() override;
+  void ExecuteScript(std::u16string_view script,
+                     ScriptCallback callback) override;
+  void PostWebMessage(std::u16string_view message) override;
+  void PostWebMessageAsJson(std::u16string_view json) override;
+  void MoveFocus(WebViewFocusReason reason) override;
+  void TrySuspend(SuspendCallback callback) override;
+  void Resume() override;
+  void CaptureFrame(FrameCallback callback) override;
+
+ private:
+  void AddEventHandlers();
+
+  // Answers a request on the assets' origin from the pack, with a 404 for
+  // paths it does not contain.
+  void ServeAsset(ICoreWebView2WebResourceRequestedEventArgs* args);
+
+  HWND window_;
+  HWND parking_window_;
+  wil::com_ptr<ICoreWebView2Environment> environment_;
+  wil::com_ptr<ICoreWebView2Controller> controller_;
+  wil::com_ptr<ICoreWebView2> webview_;
+  WebViewEvents events_;
+  std::shared_ptr<const WebViewAssets> assets_;
+  // Reused for every request's asset path.
+  std::string asset_path_;
+
+  // The ids of the scripts |SetDocumentScripts| added, as WebView2 reports
+  // them. Shared with the handlers reporting them, which remove scripts
+  // replaced in the meantime instead of recording them.
+  struct DocumentScripts {
+    uint64_t generation = 0;
+    std::vector<std::wstring> ids;
+  };
+  std::shared_ptr<DocumentScripts> document_scripts_ =
+      std::make_shared<DocumentScripts>();
+
+  EventRegistrationToken navigation_starting_token_ = {};
+  EventRegistrationToken navigation_completed_token_ = {};
+  EventRegistrationToken process_failed_token_ = {};
+  EventRegistrationToken web_resource_requested_token_ = {};
+  EventRegistrationToken web_message_received_token_ = {};
+  EventRegistrationToken move_focus_requested_token_ = {};
+  EventRegistrationToken got_focus_token_ = {};
+  EventRegistrationToken lost_focus_token_ = {};
+};
+
+WebView2Controller::WebView2Controller(
+    HWND window,
+    HWND parking_window,
+    ICoreWebView2Environment* environment,
+    ICoreWebView2Controller* controller,
+    std::shared_ptr<const WebViewAssets> assets)
+    : window_(window),
+      parking_window_(parking_window),
+      environment_(environment),
+      controller_(controller),
+      assets_(std::move(assets)) {
+  controller_->get_CoreWebView2(&webview_);
+  AddEventHandlers();
+}
+
+WebView2Controller::~WebView2Controller() {
+  if (webview_) {
+    webview_->remove_NavigationStarting(navigation_starting_token_);
+    webview_->remove_NavigationCompleted(navigation_completed_token_);
+    webview_->remove_ProcessFailed(process_failed_token_);
+    webview_->remove_WebMessageReceived(web_message_received_token_);
+    if (assets_) {
+      webview_->remove_WebResourceRequested(web_resource_requested_token_);
+    }
+  }
+  controller_->remove_MoveFocusRequested(move_focus_requested_token_);
+  controller_->remove_GotFocus(got_focus_token_);
+  controller_->remove_LostFocus(lost_focus_token_);
+  controller_->Close();
+  DestroyWindow(window_);
+}
+
+void WebView2Controller::SetEvents(WebViewEvents events) {
+  events_ = std::move(events);
+}
+
+void WebView2Controller::Attach(NativeWindow parent, const IntRect& bounds) {
+  SetParent(window_, reinterpret_cast<HWND>(parent));
+  SetBounds(bounds);
+  ShowWindow(window_, SW_SHOWNA);
+  controller_->put_IsVisible(TRUE);
+}
+
+void WebView2Controller::SetBounds(const IntRect& bounds) {
+  SetWindowPos(window_, nullptr, bounds.left, bounds.top, bounds.width(),
+               bounds.height(), SWP_NOZORDER | SWP_NOACTIVATE);
+  controller_->put_Bounds(RECT{0, 0, bounds.width(), bounds.height()});
+}
+
+void WebView2Controller::Detach() {
+  controller_->put_IsVisible(FALSE);
+  ShowWindow(window_, SW_HIDE);
+  SetParent(window_, parking_window_);
+  if (webview_) {
+    webview_->Navigate(L"about:blank");
+  }
+}
+
+void WebView2Controller::SetVisible(bool visible) {
+  controller_->put_IsVisible(visible);
+}
+
+void WebView2Controller::Navigate(std::u16string_view uri) {
+  webview_->Navigate(reinterpret_cast<LPCWSTR>(uri.data()));
+}
+
+void WebView2Controller::ApplySettings(const WebViewSettings& settings) {
+  wil::com_ptr<ICoreWebView2Settings> webview_settings;
+  if (FAILED(webview_->get_Settings(&webview_settings))) {
+    return;
+  }
+  webview_settings->put_IsScriptEnabled(settings.script_enabled);
+  webview_settings->put_AreDefaultScriptDialogsEnabled(
+      settings.script_dialogs_enabled);
+  webview_settings->put_AreDefaultContextMenusEnabled(
+      settings.context_menus_enabled);
+  webview_settings->put_AreDevToolsEnabled(settings.dev_tools_enabled);
+  webview_settings->put_IsZoomControlEnabled(settings.zoom_control_enabled);
+}
+
+void WebView2Controller::SetDocumentScripts(
+    std::vector<std::u16string> scripts) {
+  for (const std::wstring& id : document_scripts_->ids) {
+    webview_->RemoveScriptToExecuteOnDocumentCreated(id.c_str());
+  }
+  document_scripts_->ids.clear();
+  uint64_t generation = ++document_scripts_->generation;
+  for (const std::u16string& script : scripts) {
+    webview_->AddScriptToExecuteOnDocumentCreated(
+        reinterpret_cast<LPCWSTR>(script.c_str()),
+        Microsoft::WRL::Callback<
+            ICoreWebView2AddScriptToExecuteOnDocumentCreatedCompletedHandler>(
+            [state = document_scripts_, webview = webview_, generation](
+                HRESULT error, LPCWSTR id) -> HRESULT {
+              if (FAILED(error) || id == nullptr) {
+                return S_OK;
+              }
+              if (generation == state->generation) {
+                state->ids.emplace_back(id);
+              } else {
+                webview->RemoveScriptToExecuteOnDocumentCreated(id);
+              }
+              return S_OK;
+            })
+            .Get());
+  }
+}
+
+std::u16string WebView2Controller::Source() {
+  wil::unique_cotaskmem_string source;
+  if (FAILED(webview_->get_Source(&source)) || !source) {
+    return std::u16string();
+  }
+  return std::u16string(Utf16View(source.get()));
+}
+
+void WebView2Controller::ExecuteScript(std::u16string_view script,
+                                       ScriptCallback callback) {
+  HRESULT hr = webview_->ExecuteScript(
+      reinterpret_cast<LPCWSTR>(script.data()),
+      Microsoft::WRL::Callback<ICoreWebView2ExecuteScriptCompletedHandler>(
+          [callback](HRESULT error, LPCWSTR result_json) -> HRESULT {
+            callback(SUCCEEDED(error) && result_json != nullptr,
+                     Utf16View(result_json));
+            return S_OK;
+          })
+          .Get());
+  if (FAILED(hr)) {
+    callback(false, std::u16string_view());
+  }
+}
+
+void WebView2Controller::PostWebMessage(std::u16string_view message) {
+  webview_->PostWebMessageAsString(reinterpret_cast<LPCWSTR>(message.data()));
+}
+
+void WebView2Controller::PostWebMessageAsJson(std::u16string_view json) {
+  webview_->PostWebMessageAsJson(reinterpret_cast<LPCWSTR>(json.data()));
+}
+
+void WebView2Controller::MoveFocus(WebViewFocusReason reason) {
+  controller_->MoveFocus(static_cast<COREWEBVIEW2_MOVE_FOCUS_REASON>(reason));
+}
+
+void WebView2Controller::TrySuspend(SuspendCallback callback) {
+  wil::com_ptr<ICoreWebView2_3> webview =
+      webview_.try_query<ICoreWebView2_3>();
+  if (!webview) {
+    callback(false);
+    return;
+  }
+  // TrySuspend only succeeds on an invisible controller.
+  controller_->put_IsVisible(FALSE);
+  HRESULT hr = webview->TrySuspend(
+      Microsoft::WRL::Callback<ICoreWebView2TrySuspendCompletedHandler>(
+          [callback](HRESULT result, BOOL suspended) -> HRESULT {
+            callback(SUCCEEDED(result) && suspended);
+            return S_OK;
+          })
+          .Get());
+  if (FAILED(hr)) {
+    callback(false);
+  }
+}
+
+void WebView2Controller::Resume() {
+  if (wil::com_ptr<ICoreWebView2_3> webview =
+          webview_.try_query<ICoreWebView2_3>()) {
+    webview->Resume();
+  }
+  controller_->put_IsVisible(TRUE);
+}
+
+void WebView2Controller::CaptureFrame(FrameCallback callback) {
+  // CapturePreview only produces encoded images; PNG decodes losslessly.
+  wil::com_ptr<IStream> stream;
+  if (FAILED(CreateStreamOnHGlobal(nullptr, TRUE, &stream))) {
+    callback(nullptr);
+    return;
+  }
+  HRESULT hr = webview_->CapturePreview(
+      COREWEBVIEW2_CAPTURE_PREVIEW_IMAGE_FORMAT_PNG, stream.get(),
+      Microsoft::WRL::Callback<ICoreWebView2CapturePreviewCompletedHandler>(
+          [callback, stream](HRESULT result) -> HRESULT {
+            std::vector<uint8_t> pixels;
+            PixelFrame frame;
+            if (SUCCEEDED(result) && DecodeBgra(stream.get(), &pixels, &frame)) {
+              callback(&frame);
+            } else {
+              callback(nullptr);
+            }
+            return S_OK;
+          })
+          .Get());
+  if (FAILED(hr)) {
+    callback(nullptr);
+  }
+}
+
+void WebView2Controller::ServeAsset(
+    ICoreWebView2WebResourceRequestedEventArgs* args) {
+  RUNNER_TRACE_SCOPE("ServeAsset");
+  wil::com_ptr<ICoreWebView2WebResourceRequest> request;
+  wil::unique_cotaskmem_string uri;
+  if (FAILED(args->get_Request(&request)) || FAILED(request->get_Uri(&uri)) ||
+      !AssetPathFromUrl(Utf16View(uri.get()), assets_->origin,
+                        &asset_path_)) {
+    return;
+  }
+  std::optional<Asset> asset = assets_->pack.Find(asset_path_);
+  wil::com_ptr<ICoreWebView2WebResourceResponse> response;
+  HRESULT hr;
+  if (asset) {
+    g_assets_served->Increment();
+    // MIME types are ASCII.
+    std::wstring headers = L"Content-Type: ";
+    headers.append(asset->mime_type.begin(), asset->mime_type.end());
+    headers.append(L"\r\nContent-Length: ")
+        .append(std::to_wstring(asset->data.size()));
+    hr = environment_->CreateWebResourceResponse(
+        Microsoft::WRL::Make<AssetStream>(assets_, asset->data).Get(), 200,
+        L"OK", headers.c_str(), &response);
+  } else {
+    RUNNER_LOG_DEBUG("No asset at {}", asset_path_);
+    g_assets_not_found->Increment();
+    hr = environment_->CreateWebResourceResponse(nullptr, 404, L"Not Found",
+                                                 L"", &response);
+  }
+  if (SUCCEEDED(hr)) {
+    args->put_Response(response.get());
+  }
+}
+
+void WebView2Controller::AddEventHandlers() {
+  // Each handler copies the current one before invoking it, so a handler
+  // may replace the events, e.g. by releasing the view.
+  webview_->add_NavigationStarting(
+      Microsoft::WRL::Callback<ICoreWebView2NavigationStartingEventHandler>(
+          [this](ICoreWebView2* sender,
+                 ICoreWebView2NavigationStartingEventArgs* args) -> HRESULT {
+            auto handler = events_.navigation_starting;
+            wil::unique_cotaskmem_string uri;
+            if (handler && SUCCEEDED(args->get_Uri(&uri)) &&
+                !handler(Utf16View(uri.get()))) {
+              args->put_Cancel(TRUE);
+            }
+            return S_OK;
+          })
+          .Get(),
+      &navigation_starting_token_);
+  webview_->add_NavigationCompleted(
+      Microsoft::WRL::Callback<ICoreWebView2NavigationCompletedEventHandler>(
+          [this](ICoreWebView2* sender,
+                 ICoreWebView2NavigationCompletedEventArgs* args) -> HRESULT {
+            auto handler = events_.navigation_completed;
+            BOOL succeeded = FALSE;
+            if (handler && SUCCEEDED(args->get_IsSuccess(&succeeded))) {
+              handler(succeeded != FALSE);
+            }
+            return S_OK;
+          })
+          .Get(),
+      &navigation_completed_token_);
+  webview_->add_ProcessFailed(
+      Microsoft::WRL::Callback<ICoreWebView2ProcessFailedEventHandler>(
+          [this](ICoreWebView2* sender,
+                 ICoreWebView2ProcessFailedEventArgs* args) -> HRESULT {
+            auto handler = events_.process_failed;
+            COREWEBVIEW2_PROCESS_FAILED_KIND kind;
+            if (handler && SUCCEEDED(args->get_ProcessFailedKind(&kind))) {
+              handler(ToProcessFailure(kind));
+            }
+            return S_OK;
+          })
+          .Get(),
+      &process_failed_token_);
+  if (assets_) {
+    webview_->AddWebResourceRequestedFilter(
+        assets_->filter.c_str(), COREWEBVIEW2_WEB_RESOURCE_CONTEXT_ALL);
+    webview_->add_WebResourceRequested(
+        Microsoft::WRL::Callback<ICoreWebView2WebResourceRequestedEventHandler>(
+            [this](ICoreWebView2* sender,
+                   ICoreWebView2WebResourceRequestedEventArgs* args)
+                -> HRESULT {
+              ServeAsset(args);
+              return S_OK;
+            })
+            .Get(),
+        &web_resource_requested_token_);
+  }
+  webview_->add_WebMessageReceived(
+      Microsoft::WRL::Callback<ICoreWebView2WebMessageReceivedEventHandler>(
+          [this](ICoreWebView2* sender,
+                 ICoreWebView2WebMessageReceivedEventArgs* args) -> HRESULT {
+            wil::unique_cotaskmem_string message;
+            if (SUCCEEDED(args->TryGetWebMessageAsString(&message))) {
+              if (auto handler = events_.web_message_received) {
+                handler(Utf16View(message.get()));
+              }
+            } else if (auto handler = events_.web_message_json_received) {
+              // Anything but a string, such as a runnerRpc request.
+              if (SUCCEEDED(args->get_WebMessageAsJson(&message))) {
+                handler(Utf16View(message.get()));
+              }
+            }
+            return S_OK;
+          })
+          .Get(),
+      &web_message_received_token_);
+  controller_->add_MoveFocusRequested(
+      Microsoft::WRL::Callback<ICoreWebView2MoveFocusRequestedEventHandler>(
+          [this](ICoreWebView2Controller* sender,
+                 ICoreWebView2MoveFocusRequestedEventArgs* args) -> HRESULT {
+            auto handler = events_.move_focus_requested;
+            COREWEBVIEW2_MOVE_FOCUS_REASON reason;
+            if (handler && SUCCEEDED(args->get_Reason(&reason))) {
+              handler(static_cast<WebViewFocusReason>(reason));
+            }
+            return S_OK;
+          })
+          .Get(),
+      &move_focus_requested_token_);
+  controller_->add_GotFocus(
+      Microsoft::WRL::Callback<ICoreWebView2FocusChangedEventHandler>(
+          [this](ICoreWebView2Controller* sender, IUnknown* args) -> HRESULT {
+            if (auto handler = events_.got_focus) {
+              handler();
+            }
+            return S_OK;
+          })
+          .Get(),
+      &got_focus_token_);
+  controller_->add_LostFocus(
+      Microsoft::WRL::Callback<ICoreWebView2FocusChangedEventHandler>(
+          [this](ICoreWebView2Controller* sender, IUnknown* args) -> HRESULT {
+            if (auto handler = events_.lost_focus) {
+              handler();
+            }
+            return S_OK;
+          })
+          .Get(),
+      &lost_focus_token_);
+}
+
+}  // namespace
+
+WebViewEnvironment::WebViewEnvironment(TaskScheduler* scheduler)
+    : scheduler_(scheduler) {
+  parking_window_ = CreateWindowEx(0, L"STATIC", L"webview_parking", WS_POPUP,
+                                   0, 0, 0, 0, nullptr, nullptr,
+                                   GetModuleHandle(nullptr), nullptr);
+}
+
+WebViewEnvironment::~WebViewEnvironment() {
+  // Outstanding requests can no longer be satisfied; their tasks fail them
+  // as they resume.
+  cancellation_.Cancel();
+  if (parking_window_) {
+    DestroyWindow(parking_window_);
+  }
+}
+
+void WebViewEnvironment::CreateController(CreateCallback callback) {
+  Spawn(CreateControllerTask(std::move(callback)),
+        TaskContext{scheduler_, cancellation_.token()});
+}
+
+void WebViewEnvironment::DestroyController(WebViewSurface surface) {
+  // Closes the controller and destroys its window.
+  surface.reset();
+}
+
+void WebViewEnvironment::RestartBrowser() {
+  if (environment_requested_ && !environment_ && !environment_failed_) {
+    // Being started already; the new browser is the one starting.
+    return;
+  }
+  RUNNER_LOG_INFO("Restarting webview environment");
+  environment_.reset();
+  environment_requested_ = false;
+  environment_failed_ = false;
+}
+
+void WebViewEnvironment::ServeAssets(std::string origin,
+                                     std::shared_ptr<const MappedFile> file,
+                                     AssetPack pack) {
+  std::wstring filter(origin.begin(), origin.end());
+  filter.append(L"/*");
+  assets_ = std::make_shared<const WebViewAssets>(WebViewAssets{
+      std::move(origin), std::move(filter), std::move(file), pack});
+}
+
+Task<ICoreWebView2Environment*> WebViewEnvironment::AwaitEnvironment() {
+  if (!environment_ && !environment_failed_) {
+    co_await Async<bool>([this](Resolver<bool> resolve) {
+      environment_waiters_.push_back(std::move(resolve));
+      if (!environment_requested_) {
+        environment_requested_ = true;
+        Spawn(CreateEnvironment(),
+              TaskContext{scheduler_, cancellation_.token()});
+      }
+    });
+  }
+  co_return environment_.get();
+}
+
+Task<> WebViewEnvironment::CreateEnvironment() {
+  RUNNER_LOG_INFO("Creating webview environment");
+  TraceAsyncBegin("CreateWebViewEnvironment", 0);
+  std::optional<ComResult<ICoreWebView2Environment>> created =
+      co_await Async<ComResult<ICoreWebView2Environment>>(
+          [](Resolver<ComResult<ICoreWebView2Environment>> resolve) {
+            HRESULT hr = CreateCoreWebView2EnvironmentWithOptions(
+                nullptr, nullptr, nullptr,
+                Microsoft::WRL::Callback<
+                    ICoreWebView2CreateCoreWebView2EnvironmentCompletedHandler>(
+                    [resolve](HRESULT result,
+                              ICoreWebView2Environment* env) -> HRESULT {
+                      resolve({result, env});
+                      return S_OK;
+                    })
+                    .Get());
+            if (FAILED(hr)) {
+              resolve({hr, nullptr});
+            }
+          });
+  RUNNER_LOG_DEBUG("Creation callback");
+  TraceAsyncEnd("CreateWebViewEnvironment", 0);
+  if (!created) {
+    // Cancelled; the waiters were woken by the same cancellation.
+    co_return;
+  }
+  if (FAILED(created->result) || !created->object) {
+    environment_failed_ = true;
+  } else {
+    environment_ = std::move(created->object);
+  }
+  std::vector<Resolver<bool>> waiters = std::move(environment_waiters_);
+  environment_waiters_.clear();
+  for (const Resolver<bool>& resolve : waiters) {
+    resolve(true);
+  }
+}
+
+Task<> WebViewEnvironment::CreateControllerTask(CreateCallback callback) {
+  ICoreWebView2Environment* environment = co_await AwaitEnvironment();
+  if (environment == nullptr) {
+    callback(WebViewSurface());
+    co_return;
+  }
+  HWND window = CreateWindowEx(0, L"STATIC", L"webview_surface", WS_CHILD,
+                               0, 0, 0, 0, parking_window_, nullptr,
+                               GetModuleHandle(nullptr), nullptr);
+  if (window == nullptr) {
+    callback(WebViewSurface());
+    co_return;
+  }
+  uint64_t trace_id = ++controllers_requested_;
+  TraceAsyncBegin("CreateWebViewController", trace_id);
+  auto start = std::chrono::steady_clock::now();
+  std::optional<ComResult<ICoreWebView2Controller>> created =
+      co_await Async<ComResult<ICoreWebView2Controller>>(
+          [environment, window](
+              Resolver<ComResult<ICoreWebView2Controller>> resolve) {
+            HRESULT hr = environment->CreateCoreWebView2Controller(
+                window,
+                Microsoft::WRL::Callback<
+                    ICoreWebView2CreateCoreWebView2ControllerCompletedHandler>(
+                    [resolve](HRESULT result,
+                              ICoreWebView2Controller* controller) -> HRESULT {
+                      resolve({result, controller});
+                      return S_OK;
+                    })
+                    .Get());
+            if (FAILED(hr)) {
+              resolve({hr, nullptr});
+            }
+          });
+  RUNNER_LOG_DEBUG("Create core callback");
+  TraceAsyncEnd("CreateWebViewController", trace_id);
+  if (!created || FAILED(created->result) || !created->object) {
+    g_controller_create_failed->Increment();
+    DestroyWindow(window);
+    callback(WebViewSurface());
+    co_return;
+  }
+  g_controller_create_us->Record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count()));
+  ConfigureController(created->object.get());
+  callback(std::make_unique<WebView2Controller>(
+      window, parking_window_, environment, created->object.get(), assets_));
+}
@@ -0,0 +1,94 @@
+#ifndef RUNNER_WEBVIEW_ENVIRONMENT_H_
+#define RUNNER_WEBVIEW_ENVIRONMENT_H_
+
+#include <windows.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "WebView2.h"
+#include "wil/com.h"
+
+#include "asset_pack.h"
+#include "coroutine.h"
+#include "mapped_file.h"
+#include "task_scheduler.h"
+#include "web_view_backend.h"
+
+// An asset pack served to web views; see |WebViewEnvironment::ServeAssets|.
+struct WebViewAssets;
+
+// The process-wide WebView2 environment.
+//
+// The environment is created on first use and shared by every platform view,
+// so the browser process is only started once. Each controller is hosted in
+// a child window of its own, created inside a hidden parking window; the
+// controller stays parented to that window for its whole life, so moving it
+// between platform views only re-parents the window within this process
+// instead of re-parenting the browser's window.
+class WebViewEnvironment : public WebViewBackend {
+ public:
+  // Runs its tasks on |scheduler|, which must outlive it.
+  explicit WebViewEnvironment(TaskScheduler* scheduler);
+  // Fails controller requests still in flight.
+  ~WebViewEnvironment() override;
+
+  WebViewEnvironment(const WebViewEnvironment&) = delete;
+  WebViewEnvironment& operator=(const WebViewEnvironment&) = delete;
+
+  // ControllerSource:
+  void CreateController(CreateCallback callback) override;
+  void DestroyController(WebViewSurface surface) override;
+
+  // Drops the environment after its browser process failed, or forgets
+  // that creating it failed, so controllers requested from now on start a
+  // new one. Controllers of the old browser no longer work and should be
+  // destroyed.
+  void RestartBrowser();
+
+  // Answers requests for URLs on |origin|, e.g. "https://appassets.local",
+  // from |pack| in every controller created afterwards. Assets are streamed
+  // straight from |file|, which holds the pack's bytes and is kept alive
+  // until the last response has been read.
+  void ServeAssets(std::string origin,
+                   std::shared_ptr<const MappedFile> file,
+                   AssetPack pack);
+
+ private:
+  // Evaluates to the environment, creating it on first use, or to null if
+  // creation failed or this object is being destroyed.
+  Task<ICoreWebView2Environment*> AwaitEnvironment();
+
+  // Creates the environment and wakes the tasks waiting for it.
+  Task<> CreateEnvironment();
+
+  // Creates a controller and passes it, or an empty surface on failure, to
+  // |callback|.
+  Task<> CreateControllerTask(CreateCallback callback);
+
+  TaskScheduler* scheduler_;
+
+  wil::com_ptr<ICoreWebView2Environment> environment_;
+  bool environment_requested_ = false;
+  bool environment_failed_ = false;
+
+  // Tasks waiting for the environment to be created.
+  std::vector<Resolver<bool>> environment_waiters_;
+
+  // Number of controllers requested from the environment, used to pair up
+  // their trace events.
+  uint64_t controllers_requested_ = 0;
+
+  // The assets served to controllers, if any.
+  std::shared_ptr<const WebViewAssets> assets_;
+
+  // Hidden window that owns surfaces not attached to any view.
+  HWND parking_window_ = nullptr;
+
+  // Cancelled on destruction, which winds down every task in flight
+  // before the members they use go away.
+  CancellationSource cancellation_;
+};
+
+#endif  // RUNNER_WEBVIEW_ENVIRONMENT_H_
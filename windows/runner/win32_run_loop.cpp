@@ -0,0 +1,65 @@
+#include "win32_run_loop.h"
+
+#include <algorithm>
+#include <optional>
+
+Win32RunLoop::Win32RunLoop(RunLoopBudget budget)
+    : budget_(budget),
+      wake_event_(CreateEvent(nullptr, FALSE, FALSE, nullptr)),
+      scheduler_([this] { SetEvent(wake_event_); }) {}
+
+Win32RunLoop::~Win32RunLoop() {
+  if (wake_event_ != nullptr) {
+    CloseHandle(wake_event_);
+  }
+}
+
+int Win32RunLoop::Run() {
+  using Clock = TaskScheduler::Clock;
+  int exit_code = 0;
+  while (true) {
+    if (!DispatchMessages(&exit_code)) {
+      return exit_code;
+    }
+    if (scheduler_.RunUntil(Clock::now() + budget_.tasks)) {
+      // Out of budget; let messages in before continuing.
+      continue;
+    }
+
+    std::optional<Clock::time_point> wake_time = scheduler_.NextWakeTime();
+    Clock::time_point now = Clock::now();
+    if (wake_time && *wake_time <= now) {
+      continue;
+    }
+    if (scheduler_.HasIdleTasks() &&
+        HIWORD(GetQueueStatus(QS_ALLINPUT)) == 0) {
+      scheduler_.RunIdleTasks(now + budget_.idle);
+      continue;
+    }
+
+    DWORD timeout = INFINITE;
+    if (wake_time) {
+      auto delay =
+          std::chrono::ceil<std::chrono::milliseconds>(*wake_time - now);
+      timeout = static_cast<DWORD>(
+          std::min<int64_t>(delay.count(), INFINITE - 1));
+    }
+    // MWMO_INPUTAVAILABLE also returns for messages that arrived before the
+    // wait but were not yet removed from the queue.
+    MsgWaitForMultipleObjectsEx(wake_event_ != nullptr ? 1 : 0, &wake_event_,
+                                timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+  }
+}
+
+bool Win32RunLoop::DispatchMessages(int* exit_code) {
+  ::MSG msg;
+  while (::PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+    if (msg.message == WM_QUIT) {
+      *exit_code = static_cast<int>(msg.wParam);
+      return false;
+    }
+    ::TranslateMessage(&msg);
+    ::DispatchMessage(&msg);
+  }
+  return true;
+}
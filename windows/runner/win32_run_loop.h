@@ -0,0 +1,43 @@
+#ifndef RUNNER_WIN32_RUN_LOOP_H_
+#define RUNNER_WIN32_RUN_LOOP_H_
+
+#include <windows.h>
+
+#include "task_scheduler.h"
+
+// The runner's main loop: dispatches window messages and runs the tasks of
+// its |TaskScheduler| in between.
+//
+// Pending messages are always dispatched first. Due tasks then run for at
+// most |RunLoopBudget::tasks| before the loop checks for messages again, and
+// idle tasks only run when neither messages nor due tasks are waiting. The
+// loop sleeps in MsgWaitForMultipleObjectsEx until a message arrives, the
+// next delayed task is due, or another thread posts a task.
+//
+// Tasks do not run while a modal loop (a message box, or a window being
+// moved or resized) is pumping messages in place of this one.
+class Win32RunLoop {
+ public:
+  explicit Win32RunLoop(RunLoopBudget budget = RunLoopBudget());
+  ~Win32RunLoop();
+
+  Win32RunLoop(const Win32RunLoop&) = delete;
+  Win32RunLoop& operator=(const Win32RunLoop&) = delete;
+
+  TaskScheduler& scheduler() { return scheduler_; }
+
+  // Runs until WM_QUIT is received, and returns its exit code.
+  int Run();
+
+ private:
+  // Dispatches every pending message. Returns false on WM_QUIT, storing its
+  // exit code in |exit_code|.
+  bool DispatchMessages(int* exit_code);
+
+  RunLoopBudget budget_;
+  // Auto-reset event set by the scheduler to interrupt the wait.
+  HANDLE wake_event_;
+  TaskScheduler scheduler_;
+};
+
+#endif  // RUNNER_WIN32_RUN_LOOP_H_
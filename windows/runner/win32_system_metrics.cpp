@@ -0,0 +1,81 @@
+#include "win32_system_metrics.h"
+
+#include <flutter_windows.h>
+
+namespace {
+
+// Registry key for app theme preference.
+//
+// A value of 0 indicates apps should use dark mode. A non-zero or missing
+// value indicates apps should use light mode.
+constexpr const wchar_t kGetPreferredBrightnessRegKey[] =
+    L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize";
+constexpr const wchar_t kGetPreferredBrightnessRegValue[] = L"AppsUseLightTheme";
+
+BOOL CALLBACK AddMonitor(HMONITOR monitor, HDC, LPRECT, LPARAM data) {
+  MONITORINFO info = {};
+  info.cbSize = sizeof(info);
+  if (GetMonitorInfo(monitor, &info)) {
+    MonitorInfo entry;
+    entry.id = reinterpret_cast<uintptr_t>(monitor);
+    entry.bounds = IntRect{info.rcMonitor.left, info.rcMonitor.top,
+                           info.rcMonitor.right, info.rcMonitor.bottom};
+    entry.dpi = FlutterDesktopGetDpiForMonitor(monitor);
+    reinterpret_cast<std::vector<MonitorInfo>*>(data)->push_back(entry);
+  }
+  return TRUE;
+}
+
+}  // namespace
+
+std::vector<MonitorInfo> Win32SystemMetricsProvider::EnumerateMonitors() {
+  std::vector<MonitorInfo> monitors;
+  EnumDisplayMonitors(nullptr, nullptr, AddMonitor,
+                      reinterpret_cast<LPARAM>(&monitors));
+  return monitors;
+}
+
+std::optional<bool> Win32SystemMetricsProvider::ReadPrefersDarkMode() {
+  DWORD light_mode;
+  DWORD light_mode_size = sizeof(light_mode);
+  LSTATUS result = RegGetValue(HKEY_CURRENT_USER, kGetPreferredBrightnessRegKey,
+                               kGetPreferredBrightnessRegValue,
+                               RRF_RT_REG_DWORD, nullptr, &light_mode,
+                               &light_mode_size);
+  if (result != ERROR_SUCCESS) {
+    return std::nullopt;
+  }
+  return light_mode == 0;
+}
+
+void* Win32SystemMetricsProvider::LoadSystemFunction(const char* name) {
+  // User32 is loaded for the life of any process that creates windows.
+  HMODULE user32_module = GetModuleHandle(L"user32.dll");
+  if (user32_module == nullptr) {
+    return nullptr;
+  }
+  return reinterpret_cast<void*>(GetProcAddress(user32_module, name));
+}
+
+SystemMetricsCache& GetSystemMetricsCache() {
+  static Win32SystemMetricsProvider provider;
+  static SystemMetricsCache cache(&provider);
+  return cache;
+}
+
+void InvalidateSystemMetricsFor(UINT message, LPARAM lparam) {
+  switch (message) {
+    case WM_DISPLAYCHANGE:
+    case WM_DPICHANGED:
+      GetSystemMetricsCache().InvalidateMonitors();
+      break;
+    case WM_SETTINGCHANGE:
+      // Sent with "ImmersiveColorSet" when the app theme preference changes.
+      if (lparam != 0 &&
+          wcscmp(reinterpret_cast<const wchar_t*>(lparam),
+                 L"ImmersiveColorSet") == 0) {
+        GetSystemMetricsCache().InvalidateTheme();
+      }
+      break;
+  }
+}
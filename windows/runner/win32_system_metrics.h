@@ -0,0 +1,25 @@
+#ifndef RUNNER_WIN32_SYSTEM_METRICS_H_
+#define RUNNER_WIN32_SYSTEM_METRICS_H_
+
+#include <windows.h>
+
+#include "system_metrics.h"
+
+// Answers |SystemMetricsCache| queries from Win32, the Flutter DPI helper
+// and the registry.
+class Win32SystemMetricsProvider : public SystemMetricsProvider {
+ public:
+  // SystemMetricsProvider:
+  std::vector<MonitorInfo> EnumerateMonitors() override;
+  std::optional<bool> ReadPrefersDarkMode() override;
+  void* LoadSystemFunction(const char* name) override;
+};
+
+// Returns the cache shared by every window on the UI thread.
+SystemMetricsCache& GetSystemMetricsCache();
+
+// Updates the shared cache for |message|, if it reports a change to the
+// cached data.
+void InvalidateSystemMetricsFor(UINT message, LPARAM lparam);
+
+#endif  // RUNNER_WIN32_SYSTEM_METRICS_H_
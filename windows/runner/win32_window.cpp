@@ -1,9 +1,11 @@
 #include "win32_window.h"
 
 #include <dwmapi.h>
-#include <flutter_windows.h>
+
+#include <optional>
 
 #include "resource.h"
+#include "win32_system_metrics.h"
 
 namespace {
 
@@ -18,39 +20,20 @@ namespace {
 
 constexpr const wchar_t kWindowClassName[] = L"FLUTTER_RUNNER_WIN32_WINDOW";
 
-/// Registry key for app theme preference.
-///
-/// A value of 0 indicates apps should use dark mode. A non-zero or missing
-/// value indicates apps should use light mode.
-constexpr const wchar_t kGetPreferredBrightnessRegKey[] =
-  L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize";
-constexpr const wchar_t kGetPreferredBrightnessRegValue[] = L"AppsUseLightTheme";
-
 // The number of Win32Window objects that currently exist.
 static int g_active_window_count = 0;
 
 using EnableNonClientDpiScaling = BOOL __stdcall(HWND hwnd);
 
-// Scale helper to convert logical scaler values to physical using passed in
-// scale factor
-int Scale(int source, double scale_factor) {
-  return static_cast<int>(source * scale_factor);
-}
-
-// Dynamically loads the |EnableNonClientDpiScaling| from the User32 module.
+// Calls |EnableNonClientDpiScaling|, looked up once from the User32 module.
 // This API is only needed for PerMonitor V1 awareness mode.
 void EnableFullDpiSupportIfAvailable(HWND hwnd) {
-  HMODULE user32_module = LoadLibraryA("User32.dll");
-  if (!user32_module) {
-    return;
-  }
   auto enable_non_client_dpi_scaling =
       reinterpret_cast<EnableNonClientDpiScaling*>(
-          GetProcAddress(user32_module, "EnableNonClientDpiScaling"));
+          GetSystemMetricsCache().SystemFunction("EnableNonClientDpiScaling"));
   if (enable_non_client_dpi_scaling != nullptr) {
     enable_non_client_dpi_scaling(hwnd);
   }
-  FreeLibrary(user32_module);
 }
 
 }  // namespace
@@ -128,16 +111,15 @@ bool Win32Window::Create(const std::wstring& title,
   const wchar_t* window_class =
       WindowClassRegistrar::GetInstance()->GetWindowClass();
 
-  const POINT target_point = {static_cast<LONG>(origin.x),
-                              static_cast<LONG>(origin.y)};
-  HMONITOR monitor = MonitorFromPoint(target_point, MONITOR_DEFAULTTONEAREST);
-  UINT dpi = FlutterDesktopGetDpiForMonitor(monitor);
-  double scale_factor = dpi / 96.0;
+  int32_t x = static_cast<int32_t>(origin.x);
+  int32_t y = static_cast<int32_t>(origin.y);
+  uint32_t dpi = GetSystemMetricsCache().DpiForPoint(x, y);
 
   HWND window = CreateWindow(
       window_class, title.c_str(), WS_OVERLAPPEDWINDOW,
-      Scale(origin.x, scale_factor), Scale(origin.y, scale_factor),
-      Scale(size.width, scale_factor), Scale(size.height, scale_factor),
+      ScaleForDpi(x, dpi), ScaleForDpi(y, dpi),
+      ScaleForDpi(static_cast<int32_t>(size.width), dpi),
+      ScaleForDpi(static_cast<int32_t>(size.height), dpi),
       nullptr, nullptr, GetModuleHandle(nullptr), this);
 
   if (!window) {
@@ -167,6 +149,8 @@ LRESULT CALLBACK Win32Window::WndProc(HWND const window,
     EnableFullDpiSupportIfAvailable(window);
     that->window_handle_ = window;
   } else if (Win32Window* that = GetThisFromHandle(window)) {
+    // Before any handler, which may consult the cache or not call through.
+    InvalidateSystemMetricsFor(message, lparam);
     return that->MessageHandler(window, message, wparam, lparam);
   }
 
@@ -216,6 +200,10 @@ Win32Window::MessageHandler(HWND hwnd,
     case WM_DWMCOLORIZATIONCOLORCHANGED:
       UpdateTheme(hwnd);
       return 0;
+
+    case WM_SETTINGCHANGE:
+      UpdateTheme(hwnd);
+      break;
   }
 
   return DefWindowProc(window_handle_, message, wparam, lparam);
@@ -273,15 +261,10 @@ void Win32Window::OnDestroy() {
 }
 
 void Win32Window::UpdateTheme(HWND const window) {
-  DWORD light_mode;
-  DWORD light_mode_size = sizeof(light_mode);
-  LSTATUS result = RegGetValue(HKEY_CURRENT_USER, kGetPreferredBrightnessRegKey,
-                               kGetPreferredBrightnessRegValue,
-                               RRF_RT_REG_DWORD, nullptr, &light_mode,
-                               &light_mode_size);
-
-  if (result == ERROR_SUCCESS) {
-    BOOL enable_dark_mode = light_mode == 0;
+  std::optional<bool> prefers_dark_mode =
+      GetSystemMetricsCache().PrefersDarkMode();
+  if (prefers_dark_mode) {
+    BOOL enable_dark_mode = *prefers_dark_mode;
     DwmSetWindowAttribute(window, DWMWA_USE_IMMERSIVE_DARK_MODE,
                           &enable_dark_mode, sizeof(enable_dark_mode));
   }